@@ -0,0 +1,203 @@
+#!/bin/sh
+# Run the benchmarks of every variant of Nachos, and compare what they took
+# with a baseline recorded before.
+#
+#     bench.sh [-u] [-t <percent>] [-w <percent>] [-n <percent>]
+#
+# Each case runs one suite on one variant, already built, and records the
+# host time it took, in milliseconds, and the main counters of `Statistics`,
+# from the file written with `-sj`:
+#
+# * `threads/sync`: the synchronization benchmarks of `-tt`.
+# * `filesys/fsbench`: the file system benchmarks of `-tf`, on a disk of its
+#   own.
+# * `network/netbench`: the network benchmarks of `-tb`, between two
+#   machines.
+# * `userprog/suite`, `vmem/suite`: the userland benchmarks, run by
+#   `userland/bench`; skipped unless it has been built.
+#
+# Results go to `bench/last`, one `<case> <metric> <value>` per line.  With
+# `-u`, they become the baseline, `bench/baseline`; otherwise each is
+# compared with it, and reported if it grew by more than the tolerance:
+# `-t` for the counters (5% by default) and `-w` for the host time (25%).
+# Simulated time does not depend on the host, so the counters only change
+# with the code; except for the network, whose retransmissions depend on
+# how the two machines are scheduled by the host, so its metrics are only
+# shown, unless `-n` gives them a tolerance too.
+#
+# The exit status is 1 if anything grew past its tolerance or failed to
+# run.
+#
+# Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+# All rights reserved.  See `copyright.h` for copyright notice and
+# limitation of liability and disclaimer of warranty provisions.
+
+update=0
+tolerance=5
+wallTolerance=25
+netTolerance=
+while getopts ut:w:n: option; do
+    case $option in
+        u) update=1 ;;
+        t) tolerance=$OPTARG ;;
+        w) wallTolerance=$OPTARG ;;
+        n) netTolerance=$OPTARG ;;
+        *) echo "usage: $0 [-u] [-t <percent>] [-w <percent>]" \
+                "[-n <percent>]" >&2
+           exit 2 ;;
+    esac
+done
+
+code=$(cd "$(dirname "$0")/.." && pwd)
+baseline=$code/bench/baseline
+last=$code/bench/last
+work=$(mktemp -d)
+holder=
+trap 'rm -rf "$work"; [ -n "$holder" ] && kill $holder 2>/dev/null' EXIT
+
+# How long a case may run before it counts as failed, in seconds.
+TIMEOUT=300
+
+: > "$last"
+status=0
+
+# Nachos reads the console from standard input, and stops at its end, so
+# it is given a pipe that never ends instead.
+mkfifo "$work/stdin"
+sleep 1000000 > "$work/stdin" &
+holder=$!
+
+now() {
+    echo $(($(date +%s%N) / 1000000))
+}
+
+# Print the value of `key` in the object `section` of the statistics in the
+# JSON file `json`, or nothing if there is none.
+counter() {
+    sed -n "s/.*\"$2\":{[^}]*\"$3\":\([0-9]*\).*/\1/p" "$1" | head -n 1
+}
+
+# Record the metrics of case `name`, which started at `start` and wrote
+# its statistics to `json`.
+record() {
+    name=$1 start=$2 json=$3
+    echo "$name wall_ms $(($(now) - start))" >> "$last"
+    for metric in ticks:total:ticks_total ticks:system:ticks_system \
+                  ticks:user:ticks_user \
+                  scheduling:contextSwitches:context_switches \
+                  disk:reads:disk_reads disk:writes:disk_writes \
+                  paging:faults:page_faults; do
+        value=$(counter "$json" "${metric%%:*}" \
+                        "$(echo "$metric" | cut -d: -f2)")
+        if [ -n "$value" ]; then
+            echo "$name ${metric##*:} $value" >> "$last"
+        fi
+    done
+}
+
+# Run `nachos` of variant `variant` with the arguments after, in the
+# scratch directory, as case `name`.
+run() {
+    name=$1 variant=$2
+    shift 2
+    echo ":: Running $name"
+    start=$(now)
+    if timeout $TIMEOUT "$code/$variant/nachos" "$@" -sj "$work/$$.json" \
+         < "$work/stdin" > "$work/output" 2>&1 \
+       && [ -s "$work/$$.json" ]; then
+        record "$name" "$start" "$work/$$.json"
+    else
+        echo "$name: failed; see the end of its output:" >&2
+        tail -n 5 "$work/output" >&2
+        status=1
+    fi
+    rm -f "$work/$$.json"
+}
+
+cd "$work" || exit 1
+
+echo 4 > "$work/choice"
+echo ":: Running threads/sync"
+start=$(now)
+if timeout $TIMEOUT "$code/threads/nachos" -tt -sj "$work/$$.json" \
+     < "$work/choice" > "$work/output" 2>&1 && [ -s "$work/$$.json" ]; then
+    record threads/sync "$start" "$work/$$.json"
+else
+    echo "threads/sync: failed" >&2
+    status=1
+fi
+rm -f "$work/$$.json"
+
+run filesys/fsbench filesys -f -tf -q
+rm -f DISK
+
+# The server goes first, and halts once the client is done.
+timeout $TIMEOUT "$code/network/nachos" -dr -id 1 -tb 0 4 \
+    < "$work/stdin" > "$work/server" 2>&1 &
+server=$!
+run network/netbench network -dr -id 0 -tb 1 4
+wait $server
+
+if [ -x "$code/userland/bench" ]; then
+    echo "0 0 bench" > "$work/suite"
+    cd "$code/userland" || exit 1
+    run userprog/suite userprog -wl "$work/suite"
+    run vmem/suite vmem -wl "$work/suite"
+    rm -f SWAP.*
+    cd "$work" || exit 1
+else
+    echo ":: Skipping the userland suite: userland/bench is not built"
+fi
+
+if [ $update = 1 ]; then
+    cp "$last" "$baseline"
+    echo ":: Recorded the baseline in bench/baseline"
+    exit $status
+fi
+if [ ! -f "$baseline" ]; then
+    echo ":: No baseline to compare with; record one with \`make" \
+         "bench-baseline\`"
+    exit $status
+fi
+
+# A metric is reported if it grew by more than its tolerance, with a
+# little slack for those so small that any change is a large one.
+awk -v tolerance="$tolerance" -v wallTolerance="$wallTolerance" \
+    -v netTolerance="$netTolerance" '
+    NR == FNR {
+        base[$1 " " $2] = $3
+        next
+    }
+    {
+        key = $1 " " $2
+        if (!(key in base)) {
+            printf "%-18s %-17s %12d  (new)\n", $1, $2, $3
+            next
+        }
+        if ($1 ~ /^network\// && netTolerance == "") {
+            printf "%-18s %-17s %12d %12d\n", $1, $2, base[key], $3
+            next
+        }
+        t = $1 ~ /^network\// ? netTolerance \
+            : $2 == "wall_ms" ? wallTolerance : tolerance
+        slack = $2 == "wall_ms" ? 20 : 1
+        limit = base[key] * (100 + t) / 100
+        if (limit < base[key] + slack) {
+            limit = base[key] + slack
+        }
+        change = base[key] > 0 ? 100 * ($3 - base[key]) / base[key] : 0
+        mark = $3 > limit ? "  REGRESSION" : ""
+        printf "%-18s %-17s %12d %12d %+8.1f%%%s\n",
+               $1, $2, base[key], $3, change, mark
+        if ($3 > limit) {
+            regressions++
+        }
+    }
+    END {
+        if (regressions > 0) {
+            printf "%d metrics grew past their tolerance\n", regressions
+            exit 1
+        }
+    }' "$baseline" "$last" || status=1
+
+exit $status
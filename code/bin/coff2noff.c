@@ -13,6 +13,18 @@
 ///    .data      -- initialized data
 ///    .bss/.sbss -- uninitialized data (should be zeroed on program startup)
 ///
+/// With `-p`, the segments are laid out page-aligned in the NOFF file, which
+/// is marked `NOFF_MAGIC_PAGED`, and carry their permissions.  The program
+/// must have been linked with its segments starting on page boundaries, as
+/// `arrangement.ld` does.
+///
+/// With `-s`, the procedures of the program, from the external symbols of
+/// the COFF file, are written after the segments as the symbol table of the
+/// NOFF file.
+///
+/// With `-z`, the code and initialized data segments are compressed, each
+/// page on its own, as described in `noff_lz.h`.
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -22,6 +34,7 @@
 #include "coff_reader.h"
 #include "coff_section.h"
 #include "noff.h"
+#include "noff_lz.h"
 #include "threads/copyright.h"
 
 #include <sys/types.h>
@@ -32,6 +45,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -80,6 +94,109 @@ WriteOrDie(FILE *f, const char *buffer, size_t numBytes)
     }
 }
 
+/// Write the `size` bytes of a segment at `buffer` at `*offset`, and move
+/// `*offset` past them.  If `compress`, write the table of blocks and the
+/// blocks instead.
+static void
+WriteSegmentOrDie(FILE *f, int *offset, const char *buffer, size_t size,
+                  bool compress)
+{
+    assert(f != NULL);
+    assert(offset != NULL);
+    assert(buffer != NULL);
+
+    if (!compress) {
+        WriteOrDie(f, buffer, size);
+        *offset += size;
+        return;
+    }
+
+    unsigned numBlocks = NoffBlockCount(size);
+    uint32_t *table = malloc((numBlocks + 1) * sizeof *table);
+    char *blocks = malloc(numBlocks * NOFF_LZ_MAX_SIZE(NOFF_BLOCK_SIZE) + 1);
+    if (table == NULL || blocks == NULL) {
+        Die("Could not allocate memory");
+    }
+    uint32_t stored = (numBlocks + 1) * sizeof *table;
+    char *next = blocks;
+    for (unsigned b = 0; b < numBlocks; b++) {
+        const char *block = buffer + b * NOFF_BLOCK_SIZE;
+        unsigned length = size - b * NOFF_BLOCK_SIZE < NOFF_BLOCK_SIZE
+                          ? size - b * NOFF_BLOCK_SIZE : NOFF_BLOCK_SIZE;
+        unsigned n = NoffLzCompress(block, length, next);
+        if (n >= length) {
+            memcpy(next, block, length);  // Stored as is.
+            n = length;
+        }
+        table[b] = stored;
+        stored += n;
+        next   += n;
+    }
+    table[numBlocks] = stored;
+    WriteOrDie(f, (const char *) table, (numBlocks + 1) * sizeof *table);
+    if (next > blocks) {
+        WriteOrDie(f, blocks, next - blocks);
+    }
+    printf("Compressed %zu bytes into %u.\n", size, stored);
+    *offset += stored;
+    free(table);
+    free(blocks);
+}
+
+/// Write the symbol table made of `procedures` at `*offset`, and record it
+/// in `h`.
+static void
+WriteSymbolsOrDie(FILE *f, int *offset, noffHeader *h,
+                  const coffProcedure *procedures, unsigned count)
+{
+    assert(f != NULL);
+    assert(offset != NULL);
+    assert(h != NULL);
+
+    uint32_t stringsSize = 0;
+    for (unsigned i = 0; i < count; i++) {
+        noffSymbol s;
+        s.address = procedures[i].address;
+        s.name    = stringsSize;
+        WriteOrDie(f, (const char *) &s, sizeof s);
+        stringsSize += strlen(procedures[i].name) + 1;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        WriteOrDie(f, procedures[i].name, strlen(procedures[i].name) + 1);
+    }
+
+    h->symbolsInFileAddr = *offset;
+    h->numSymbols        = count;
+    h->stringsSize       = stringsSize;
+    *offset += count * sizeof (noffSymbol) + stringsSize;
+}
+
+/// If `paged`, write zeros up to the next page boundary of the file, where
+/// `*offset` is now, and check that the segment to go there, at `addr`, is
+/// on a page boundary in memory too.
+static void
+AlignOrDie(FILE *f, int *offset, size_t addr, const char *name, bool paged)
+{
+    assert(f != NULL);
+    assert(offset != NULL);
+
+    if (!paged) {
+        return;
+    }
+    if (addr % NOFF_PAGE_SIZE != 0) {
+        Die("Segment %s at 0x%zX is not page aligned; link the program "
+            "with its segments aligned to %u bytes", name, addr,
+            NOFF_PAGE_SIZE);
+    }
+    static const char zeros[NOFF_PAGE_SIZE];
+    unsigned pad = (NOFF_PAGE_SIZE - *offset % NOFF_PAGE_SIZE)
+                   % NOFF_PAGE_SIZE;
+    if (pad > 0) {
+        WriteOrDie(f, zeros, pad);
+        *offset += pad;
+    }
+}
+
 void
 main(int argc, char *argv[])
 {
@@ -89,9 +206,24 @@ main(int argc, char *argv[])
     char      *buffer;
     noffHeader noffH;
 
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <coffFileName> <noffFileName>\n",
-                argv[0]);
+    bool paged = false, symbols = false, compress = false;
+    const char *program = argv[0];
+    for (; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
+        if (!strcmp(argv[1], "-p")) {
+            paged = true;
+        } else if (!strcmp(argv[1], "-s")) {
+            symbols = true;
+        } else if (!strcmp(argv[1], "-z")) {
+            compress = true;
+        } else {
+            argc = 0;
+            break;
+        }
+    }
+    if (argc < 3) {
+        fprintf(stderr,
+                "Usage: %s [-p] [-s] [-z] <coffFileName> <noffFileName>\n",
+                program);
         exit(1);
     }
 
@@ -119,10 +251,15 @@ main(int argc, char *argv[])
 
     /// Initialize the NOFF header, in case not all the segments are defined
     /// in the COFF file.
-    noffH.noffMagic       = NOFF_MAGIC;
-    noffH.code.size       = 0;
-    noffH.initData.size   = 0;
-    noffH.uninitData.size = 0;
+    memset(&noffH, 0, sizeof noffH);
+    noffH.noffMagic  = paged ? NOFF_MAGIC_PAGED : NOFF_MAGIC;
+    noffH.compressed = compress;
+    if (paged) {
+        noffH.pageSize        = NOFF_PAGE_SIZE;
+        noffH.codePerms       = NOFF_READ | NOFF_EXEC;
+        noffH.initDataPerms   = NOFF_READ | NOFF_WRITE;
+        noffH.uninitDataPerms = NOFF_READ | NOFF_WRITE;
+    }
 
     /// Copy the segments in.
     CoffSection *sc;
@@ -141,15 +278,15 @@ main(int argc, char *argv[])
         size_t size = CoffSectionSize(sc);
 
         if (!strcmp(name, ".text")) {
+            AlignOrDie(out, &inNoffFile, addr, name, paged);
             noffH.code.virtualAddr = addr;
             noffH.code.inFileAddr  = inNoffFile;
             noffH.code.size        = size;
             if ((buffer = CoffSectionRead(sc, in, &errorS)) == NULL) {
                 Die(errorS);
             }
-            WriteOrDie(out, buffer, size);
+            WriteSegmentOrDie(out, &inNoffFile, buffer, size, compress);
             free(buffer);
-            inNoffFile += size;
         } else if (!strcmp(name, ".data")
                      || !strcmp(name, ".rdata")) {
             /// Need to check if we have both `.data` and `.rdata` -- make
@@ -157,15 +294,15 @@ main(int argc, char *argv[])
             if (noffH.initData.size != 0) {
                 Die("Cannot handle both data and rdata");
             }
+            AlignOrDie(out, &inNoffFile, addr, name, paged);
             noffH.initData.virtualAddr = addr;
             noffH.initData.inFileAddr  = inNoffFile;
             noffH.initData.size        = size;
             if ((buffer = CoffSectionRead(sc, in, &errorS)) == NULL) {
                 Die(errorS);
             }
-            WriteOrDie(out, buffer, size);
+            WriteSegmentOrDie(out, &inNoffFile, buffer, size, compress);
             free(buffer);
-            inNoffFile += size;
         } else if (!strcmp(name, ".bss") || !strcmp(name, ".sbss")) {
             /// Need to check if we have both `.bss` and `.sbss` -- make sure
             /// they are contiguous.
@@ -176,6 +313,10 @@ main(int argc, char *argv[])
                 }
                 noffH.uninitData.size += size;
             } else {
+                if (paged && noffH.initData.size == 0) {
+                    // Otherwise it may follow the data in its last page.
+                    AlignOrDie(out, &inNoffFile, addr, name, paged);
+                }
                 noffH.uninitData.virtualAddr = addr;
                 noffH.uninitData.size        = size;
             }
@@ -205,6 +346,18 @@ main(int argc, char *argv[])
         free(name);
     }
 
+    if (symbols) {
+        coffProcedure *procedures;
+        unsigned count;
+        if (!CoffReaderLoadProcedures(&d, in, &procedures, &count,
+                                      &errorS)) {
+            Die(errorS);
+        }
+        WriteSymbolsOrDie(out, &inNoffFile, &noffH, procedures, count);
+        printf("Wrote %u symbols.\n", count);
+        CoffReaderFreeProcedures(procedures, count);
+    }
+
     fseek(out, 0, SEEK_SET);
     WriteOrDie(out, (const char *) &noffH, sizeof noffH);
     fclose(in);
@@ -5,8 +5,10 @@
 
 
 #include "coff_reader.h"
+#include "extern/syms.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 /// Routines for converting words and short words to and from the simulated
@@ -121,3 +123,88 @@ CoffReaderNextSection(coffReaderData *d)
     } else
         return &d->sections[d->current++];
 }
+
+static int
+CompareProcedures(const void *a, const void *b)
+{
+    uint32_t x = ((const coffProcedure *) a)->address;
+    uint32_t y = ((const coffProcedure *) b)->address;
+    return x < y ? -1 : x > y;
+}
+
+/// Procedures are the external symbols of type `stProc` or `stStaticProc`
+/// in the text section; their names come from the external string space.
+bool
+CoffReaderLoadProcedures(coffReaderData *d, FILE *f,
+                         coffProcedure **procedures, unsigned *count,
+                         char **error)
+{
+    assert(d != NULL);
+    assert(f != NULL);
+    assert(procedures != NULL);
+    assert(count != NULL);
+
+    HDRR h;
+    if (WordToHost(d->fileH.symbolPtr) == 0) {
+        FAIL(false, "File has no symbols");
+    }
+    if (fseek(f, WordToHost(d->fileH.symbolPtr), SEEK_SET) != 0
+          || fread(&h, sizeof h, 1, f) != 1) {
+        FAIL(false, "File is too short");
+    }
+    unsigned numExternals = WordToHost(h.iextMax);
+    unsigned stringsSize  = WordToHost(h.issExtMax);
+
+    char *strings = malloc(stringsSize + 1);
+    EXTR *externals = malloc(numExternals * sizeof *externals + 1);
+    *procedures = malloc(numExternals * sizeof **procedures + 1);
+    if (strings == NULL || externals == NULL || *procedures == NULL) {
+        free(strings);
+        free(externals);
+        free(*procedures);
+        FAIL(false, "Could not allocate memory");
+    }
+    if (fseek(f, WordToHost(h.cbSsExtOffset), SEEK_SET) != 0
+          || fread(strings, 1, stringsSize, f) != stringsSize
+          || fseek(f, WordToHost(h.cbExtOffset), SEEK_SET) != 0
+          || fread(externals, sizeof *externals, numExternals, f)
+               != numExternals) {
+        free(strings);
+        free(externals);
+        free(*procedures);
+        FAIL(false, "File is too short");
+    }
+    strings[stringsSize] = '\0';
+
+    *count = 0;
+    for (unsigned i = 0; i < numExternals; i++) {
+        const SYMR *s = &externals[i].asym;
+        unsigned iss = WordToHost(s->iss);
+        if ((s->st != stProc && s->st != stStaticProc) || s->sc != scText
+              || iss >= stringsSize) {
+            continue;
+        }
+        coffProcedure *p = &(*procedures)[*count];
+        p->address = WordToHost(s->value);
+        p->name    = malloc(strlen(&strings[iss]) + 1);
+        if (p->name == NULL) {
+            continue;
+        }
+        strcpy(p->name, &strings[iss]);
+        (*count)++;
+    }
+    qsort(*procedures, *count, sizeof **procedures, CompareProcedures);
+
+    free(strings);
+    free(externals);
+    return true;
+}
+
+void
+CoffReaderFreeProcedures(coffProcedure *procedures, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++) {
+        free(procedures[i].name);
+    }
+    free(procedures);
+}
@@ -25,5 +25,20 @@ void CoffReaderUnload(coffReaderData *d);
 
 coffSectionHeader *CoffReaderNextSection(coffReaderData *d);
 
+/// A procedure of the program, from the external symbols of the file.
+typedef struct coffProcedure {
+    uint32_t address;
+    char *name;
+} coffProcedure;
+
+/// Read the procedures of the file loaded into `d`, sorted by address,
+/// into an array allocated for them.  The file must not have been stripped
+/// of its symbols.  Free the array with `CoffReaderFreeProcedures`.
+bool CoffReaderLoadProcedures(coffReaderData *d, FILE *f,
+                              coffProcedure **procedures, unsigned *count,
+                              char **error);
+
+void CoffReaderFreeProcedures(coffProcedure *procedures, unsigned count);
+
 
 #endif
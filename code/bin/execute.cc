@@ -0,0 +1,451 @@
+/// Program that runs a Nachos executable on its own, without the kernel.
+///
+/// The program is loaded from its NOFF file into a flat memory, and run by
+/// the execution core of the Nachos simulator (see `machine/mips_core.hh`),
+/// so that both run user code alike, and whatever makes one faster makes
+/// the other faster too.  The code segment is predecoded once, as it is
+/// loaded; a word of it is only decoded again if the program writes over
+/// it.
+///
+/// System calls are served straight by the host, and only those that need
+/// no kernel are: `Halt`, `Exit`, `Read` and `Write` on the console, which
+/// is the standard input and output, `Sbrk` and `GetTicks`, which counts
+/// every instruction as a user tick.  Any other stops the program.
+///
+/// With `-t`, every instruction is printed before it runs; with `-s`, the
+/// number of instructions run is printed at the end.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+extern "C" {
+#include "noff_reader.h"
+}
+#include "machine/endianness.hh"
+#include "machine/mips_core.hh"
+#include "userprog/syscall.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Room left for the stack above the segments, and most arguments passed.
+static const unsigned STACK_SIZE = 64 * 1024;
+static const unsigned MAX_ARGS = 32;
+
+/// The host of the execution core: a flat memory from address 0 on, and
+/// exceptions that are only recorded, for `Run` to deal with once the
+/// faulting instruction has returned.
+class Interpreter {
+public:
+
+    Interpreter();
+
+    ~Interpreter();
+
+    /// Load the NOFF file `f`, whose header is `*h`, and set the program
+    /// up to start with the `argc` arguments of `argv`.  Return false if
+    /// the file is too short.
+    bool Load(FILE *f, const noffHeader *h, int argc, char **argv);
+
+    /// Run the program until it exits or halts, or an exception that no
+    /// one can handle happens; return its exit status.
+    int Run(bool tracing);
+
+    unsigned long GetInstructionCount() const;
+
+    bool ReadMem(unsigned addr, unsigned size, int *value);
+    bool WriteMem(unsigned addr, unsigned size, int value);
+    void RaiseException(ExceptionType which, unsigned badVAddr);
+
+private:
+
+    /// Return the instruction at the current PC, or null if it cannot be
+    /// fetched.
+    const Instruction *Fetch();
+
+    /// Serve the system call the program made; return false if it is done.
+    bool HandleSyscall(int *status);
+
+    /// Return whether the `size` bytes at `addr` are in memory, and raise
+    /// an address error if not.
+    bool Check(unsigned addr, unsigned size);
+
+    /// Have the code words among the `size` bytes at `addr` decoded again,
+    /// because they were written.
+    void Invalidate(unsigned addr, unsigned size);
+
+    int registers[NUM_TOTAL_REGS];
+
+    char *memory;
+    unsigned memorySize;  ///< Also the break, as moved by `Sbrk`.
+
+    /// Predecoded code segment, and whether each word is still valid.
+    uint32_t codeStart, codeEnd;
+    Instruction *code;
+    bool *decoded;
+
+    /// Instruction decoded outside the code segment.
+    Instruction scratch;
+
+    ExceptionType exception;  ///< Raised by the last instruction.
+    unsigned long count;
+};
+
+Interpreter::Interpreter()
+{
+    memset(registers, 0, sizeof registers);
+    memory     = nullptr;
+    memorySize = 0;
+    codeStart  = 0;
+    codeEnd    = 0;
+    code       = nullptr;
+    decoded    = nullptr;
+    exception  = NO_EXCEPTION;
+    count      = 0;
+}
+
+Interpreter::~Interpreter()
+{
+    free(memory);
+    delete [] code;
+    delete [] decoded;
+}
+
+/// Arguments are laid out on the stack as the kernel does for `Exec`.
+bool
+Interpreter::Load(FILE *f, const noffHeader *h, int argc, char **argv)
+{
+    ASSERT(f != nullptr);
+    ASSERT(h != nullptr);
+    ASSERT(argc >= 0 && (unsigned) argc <= MAX_ARGS);
+
+    uint32_t end = h->code.virtualAddr + h->code.size;
+    if (h->initData.virtualAddr + h->initData.size > end) {
+        end = h->initData.virtualAddr + h->initData.size;
+    }
+    if (h->uninitData.virtualAddr + h->uninitData.size > end) {
+        end = h->uninitData.virtualAddr + h->uninitData.size;
+    }
+    memorySize = (end + STACK_SIZE + 15) & ~15u;
+    memory = (char *) calloc(memorySize, 1);
+    if (memory == nullptr) {
+        return false;
+    }
+
+    const noffSegment *segments[] = { &h->code, &h->initData };
+    for (unsigned i = 0; i < 2; i++) {
+        const noffSegment *s = segments[i];
+        if (!NoffReaderLoadSegment(f, h, s, &memory[s->virtualAddr],
+                                   nullptr)) {
+            return false;
+        }
+    }
+
+    codeStart = h->code.virtualAddr;
+    codeEnd   = codeStart + h->code.size / 4 * 4;
+    unsigned numWords = (codeEnd - codeStart) / 4;
+    code    = new Instruction [numWords];
+    decoded = new bool [numWords];
+    for (unsigned i = 0; i < numWords; i++) {
+        code[i].value = WordToHost(*(unsigned *) &memory[codeStart + 4 * i]);
+        code[i].Decode();
+        decoded[i] = true;
+    }
+
+    int sp = memorySize;
+    int addresses[MAX_ARGS];
+    for (int i = 0; i < argc; i++) {
+        sp -= strlen(argv[i]) + 1;
+        strcpy(&memory[sp], argv[i]);
+        addresses[i] = sp;
+    }
+    sp -= sp % 4;
+    sp -= argc * 4 + 4;
+    for (int i = 0; i <= argc; i++) {
+        *(unsigned *) &memory[sp + 4 * i]
+            = WordToHost(i < argc ? addresses[i] : 0);
+    }
+    registers[4] = argc;
+    registers[5] = sp;
+    registers[STACK_REG]   = sp - 16;
+    registers[PC_REG]      = 0;
+    registers[NEXT_PC_REG] = 4;
+    registers[LOAD_REG]    = 0;
+    return true;
+}
+
+unsigned long
+Interpreter::GetInstructionCount() const
+{
+    return count;
+}
+
+bool
+Interpreter::Check(unsigned addr, unsigned size)
+{
+    if ((addr & (size - 1)) != 0 || addr >= memorySize
+          || size > memorySize - addr) {
+        RaiseException(ADDRESS_ERROR_EXCEPTION, addr);
+        return false;
+    }
+    return true;
+}
+
+bool
+Interpreter::ReadMem(unsigned addr, unsigned size, int *value)
+{
+    ASSERT(value != nullptr);
+
+    if (!Check(addr, size)) {
+        return false;
+    }
+    switch (size) {
+        case 1:
+            *value = memory[addr];
+            break;
+        case 2:
+            *value = ShortToHost(*(unsigned short *) &memory[addr]);
+            break;
+        case 4:
+            *value = WordToHost(*(unsigned *) &memory[addr]);
+            break;
+        default:
+            ASSERT(false);
+    }
+    return true;
+}
+
+/// A write over the code segment has the words it touches decoded again.
+bool
+Interpreter::WriteMem(unsigned addr, unsigned size, int value)
+{
+    if (!Check(addr, size)) {
+        return false;
+    }
+    switch (size) {
+        case 1:
+            memory[addr] = (char) (value & 0xFF);
+            break;
+        case 2:
+            *(unsigned short *) &memory[addr]
+                = ShortToHost((unsigned short) (value & 0xFFFF));
+            break;
+        case 4:
+            *(unsigned *) &memory[addr] = WordToHost((unsigned) value);
+            break;
+        default:
+            ASSERT(false);
+    }
+    Invalidate(addr, size);
+    return true;
+}
+
+void
+Interpreter::Invalidate(unsigned addr, unsigned size)
+{
+    unsigned first = addr < codeStart ? codeStart : addr & ~3u;
+    for (unsigned a = first; a < addr + size && a < codeEnd; a += 4) {
+        decoded[(a - codeStart) / 4] = false;
+    }
+}
+
+/// As the machine does, any delayed load is finished before the trap.
+void
+Interpreter::RaiseException(ExceptionType which, unsigned badVAddr)
+{
+    exception = which;
+    registers[BAD_VADDR_REG] = badVAddr;
+    MipsDelayedLoad(registers, 0, 0);
+}
+
+const Instruction *
+Interpreter::Fetch()
+{
+    unsigned pc = registers[PC_REG];
+    int value;
+    if (pc >= codeStart && pc < codeEnd && pc % 4 == 0) {
+        unsigned i = (pc - codeStart) / 4;
+        if (!decoded[i]) {
+            code[i].value = WordToHost(*(unsigned *) &memory[pc]);
+            code[i].Decode();
+            decoded[i] = true;
+        }
+        return &code[i];
+    }
+    if (!ReadMem(pc, 4, &value)) {
+        return nullptr;
+    }
+    scratch.value = value;
+    scratch.Decode();
+    return &scratch;
+}
+
+/// Results are returned in register 2, and the PC is advanced past the
+/// `syscall` instruction, as the kernel does.
+bool
+Interpreter::HandleSyscall(int *status)
+{
+    ASSERT(status != nullptr);
+
+    int id = registers[2];
+    int a0 = registers[4], a1 = registers[5], a2 = registers[6];
+    int result = 0;
+    switch (id) {
+        case SC_HALT:
+            *status = 0;
+            return false;
+
+        case SC_EXIT:
+            *status = a0;
+            return false;
+
+        case SC_READ:
+        case SC_WRITE: {
+            bool reading = id == SC_READ;
+            if (a2 != (reading ? CONSOLE_INPUT : CONSOLE_OUTPUT) || a1 < 0
+                  || (unsigned) a0 >= memorySize
+                  || (unsigned) a1 > memorySize - a0) {
+                result = -1;
+                break;
+            }
+            if (reading) {
+                result = fread(&memory[a0], 1, a1, stdin);
+                Invalidate(a0, result);
+            } else {
+                result = fwrite(&memory[a0], 1, a1, stdout);
+                fflush(stdout);
+            }
+            break;
+        }
+
+        case SC_SBRK: {
+            unsigned newSize = memorySize + a0;
+            char *newMemory = a0 < 0 && (unsigned) -a0 > memorySize
+                              ? nullptr
+                              : (char *) realloc(memory, newSize);
+            if (newMemory == nullptr) {
+                result = -1;
+                break;
+            }
+            if (a0 > 0) {
+                memset(&newMemory[memorySize], 0, a0);
+            }
+            result     = memorySize;
+            memory     = newMemory;
+            memorySize = newSize;
+            break;
+        }
+
+        case SC_GET_TICKS: {
+            int words[] = { (int) count, 0, 0, (int) count, (int) count, 0 };
+            result = 0;
+            for (unsigned i = 0; i < sizeof words / sizeof *words; i++) {
+                if (!WriteMem(a0 + 4 * i, 4, words[i])) {
+                    exception = NO_EXCEPTION;
+                    result = -1;
+                    break;
+                }
+            }
+            break;
+        }
+
+        default:
+            fprintf(stderr, "execute: system call %d is not supported "
+                            "without the kernel.\n", id);
+            *status = 1;
+            return false;
+    }
+
+    registers[2] = result;
+    registers[PREV_PC_REG] = registers[PC_REG];
+    registers[PC_REG]      = registers[NEXT_PC_REG];
+    registers[NEXT_PC_REG] += 4;
+    return true;
+}
+
+int
+Interpreter::Run(bool tracing)
+{
+    for (;;) {
+        exception = NO_EXCEPTION;
+        const Instruction *instr = Fetch();
+        if (instr != nullptr) {
+            if (tracing) {
+                const OpString *s = &OP_STRINGS[instr->opCode];
+                fprintf(stderr, "0x%08X: ", registers[PC_REG]);
+                fprintf(stderr, s->string, instr->RegFromType(s->args[0]),
+                        instr->RegFromType(s->args[1]),
+                        instr->RegFromType(s->args[2]));
+                fprintf(stderr, "\n");
+            }
+            MipsExecute(this, registers, instr);
+            count++;
+        }
+
+        int status;
+        if (exception == SYSCALL_EXCEPTION) {
+            if (!HandleSyscall(&status)) {
+                return status;
+            }
+        } else if (exception != NO_EXCEPTION) {
+            fprintf(stderr, "execute: %s at PC 0x%X, address 0x%X.\n",
+                    ExceptionTypeToString(exception),
+                    registers[PC_REG], registers[BAD_VADDR_REG]);
+            return 1;
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    bool tracing = false, summary = false;
+    const char *program = argv[0];
+    for (; argc > 1 && argv[1][0] == '-'; argc--, argv++) {
+        if (!strcmp(argv[1], "-t")) {
+            tracing = true;
+        } else if (!strcmp(argv[1], "-s")) {
+            summary = true;
+        } else {
+            argc = 0;
+            break;
+        }
+    }
+    if (argc < 2 || (unsigned) argc - 1 > MAX_ARGS) {
+        fprintf(stderr,
+                "Usage: %s [-t] [-s] <NOFF file> [<argument>...]\n",
+                program);
+        return 1;
+    }
+
+    const char *path = argv[1];
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        perror(path);
+        return 1;
+    }
+    noffHeader h;
+    if (!NoffReaderLoadHeader(f, &h)) {
+        fprintf(stderr, "execute: %s is not a NOFF file.\n", path);
+        return 1;
+    }
+
+    // The program gets its own name as its first argument.
+    Interpreter interpreter;
+    if (!interpreter.Load(f, &h, argc - 1, argv + 1)) {
+        fprintf(stderr, "execute: could not load %s.\n", path);
+        return 1;
+    }
+    fclose(f);
+
+    int status = interpreter.Run(tracing);
+    if (summary) {
+        fprintf(stderr, "execute: exit status %d, %lu instructions.\n",
+                status, interpreter.GetInstructionCount());
+    }
+    return status;
+}
@@ -0,0 +1,355 @@
+/// A FUSE client the Nachos file system.
+///
+/// FUSE (Filesystem in Userspace) is a mechanism for integrating custom
+/// file systems from userspace in POSIX operating systems.  This program
+/// allows the user to mount Nachos' file system in a directory and then
+/// access it using all the standard tools (e.g. commands like `ls` and
+/// `cat`, or graphical file managers).
+///
+/// The client is linked with the Nachos kernel built in `filesys`, which it
+/// boots once, and then serves every request by calling the file system
+/// directly, from the main thread, as `main.cc` does for `-cp` or `-pr`.
+/// Files and directories can be created, read, written and removed; a file
+/// can only be truncated to no length at all, or made longer.  What changes
+/// is committed to the journal, and the disk cache written back, once each
+/// operation that changes the file system ends, and when a file written is
+/// closed.
+///
+/// Nachos options go before a `--`, and FUSE options after it:
+///
+///     nachosfuse [<nachos options> --] <fuse options> <mount point>
+///
+/// The disk is mapped into memory and served immediately (`-dm -dt
+/// immediate`) unless told otherwise.  FUSE always runs in the foreground
+/// and in one thread, since there is just one Nachos kernel, and its
+/// console reads the standard input.
+///
+/// The `DISK` file, which contains the whole simulated disk content, must
+/// be available in the same directory where the FUSE client is executed.
+/// It is recommended to set up a symbolic link to the original in the
+/// `filesys` directory.  If you launch the client with `make mount`, the
+/// link gets created automatically.
+///
+/// Copyright (c) 2018-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#define FUSE_USE_VERSION 26
+#include <fuse.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "threads/system.hh"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Options given to Nachos before those of the command line.
+static const char *NACHOS_DEFAULTS[] = { "-dm", "-dt", "immediate" };
+
+/// Commit what the last operation changed, and write it to the disk.
+static void
+Sync()
+{
+    journal->Commit();
+    synchDisk->Flush();
+}
+
+static OpenFile *
+FileOf(struct fuse_file_info *fi)
+{
+    ASSERT(fi != nullptr && fi->fh != 0);
+    return (OpenFile *) fi->fh;
+}
+
+static int
+do_getattr(const char *path, struct stat *st)
+{
+    fprintf(stderr, "[getattr] %s\n", path);
+
+    bool isDirectory;
+    unsigned length;
+    if (!fileSystem->Stat(path, &isDirectory, &length)) {
+        return -ENOENT;
+    }
+
+    time_t t = time(nullptr);
+    memset(st, 0, sizeof *st);
+    st->st_uid = getuid();
+    st->st_gid = getgid();
+    st->st_atime = t;
+    st->st_mtime = t;
+    st->st_size  = length;
+    if (isDirectory) {
+        st->st_mode = S_IFDIR | 0755;
+        st->st_nlink = 2;
+    } else {
+        st->st_mode = S_IFREG | 0644;
+        st->st_nlink = 1;
+    }
+
+    return 0;
+}
+
+static int
+do_readdir(const char *path, void *buffer, fuse_fill_dir_t fill,
+           off_t offset, struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[readdir] %s\n", path);
+
+    DirectoryEntry entries[NUM_DIR_ENTRIES];
+    int n = fileSystem->ReadDirectory(path, entries, NUM_DIR_ENTRIES);
+    if (n < 0) {
+        return -ENOTDIR;
+    }
+
+    (*fill)(buffer, ".", nullptr, 0);
+    (*fill)(buffer, "..", nullptr, 0);
+    for (int i = 0; i < n; i++) {
+        fprintf(stderr, "    %s\n", entries[i].name);
+        (*fill)(buffer, entries[i].name, nullptr, 0);
+    }
+    return 0;
+}
+
+static int
+do_open(const char *path, struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[open] %s\n", path);
+
+    OpenFile *file = fileSystem->Open(path);
+    if (file == nullptr) {
+        return -ENOENT;
+    }
+    fi->fh = (uint64_t) file;
+    return 0;
+}
+
+static int
+do_create(const char *path, mode_t mode, struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[create] %s\n", path);
+
+    bool isDirectory;
+    unsigned length;
+    if (fileSystem->Stat(path, &isDirectory, &length)) {
+        return -EEXIST;
+    }
+    if (!fileSystem->Create(path, 0)) {
+        return -ENOSPC;
+    }
+    Sync();
+    return do_open(path, fi);
+}
+
+static int
+do_read(const char *path, char *buffer, size_t size, off_t offset,
+        struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[read] %s\n"
+                    "    size: %zu, start: %zu\n",
+            path, size, offset);
+
+    if (size == 0) {
+        return 0;
+    }
+    return FileOf(fi)->ReadAt(buffer, size, offset);
+}
+
+static int
+do_write(const char *path, const char *buffer, size_t size, off_t offset,
+         struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[write] %s\n"
+                    "    size: %zu, start: %zu\n",
+            path, size, offset);
+
+    if (size == 0) {
+        return 0;
+    }
+    int written = FileOf(fi)->WriteAt(buffer, size, offset);
+    return written == 0 ? -ENOSPC : written;
+}
+
+/// Truncating to no length at all makes a new, empty file in place of the
+/// old one.
+static int
+do_truncate(const char *path, off_t size)
+{
+    fprintf(stderr, "[truncate] %s\n"
+                    "    size: %zu\n",
+            path, size);
+
+    bool isDirectory;
+    unsigned length;
+    if (!fileSystem->Stat(path, &isDirectory, &length)) {
+        return -ENOENT;
+    }
+    if (isDirectory) {
+        return -EISDIR;
+    }
+    if ((unsigned) size == length) {
+        return 0;
+    }
+    if (size == 0) {
+        if (!fileSystem->Remove(path) || !fileSystem->Create(path, 0)) {
+            return -EIO;
+        }
+        Sync();
+        return 0;
+    }
+    if ((unsigned) size < length) {
+        return -EPERM;
+    }
+
+    // Writing past the end fills the gap with zeros.
+    OpenFile *file = fileSystem->Open(path);
+    ASSERT(file != nullptr);
+    char zero = 0;
+    int result = file->WriteAt(&zero, 1, size - 1) == 1 ? 0 : -ENOSPC;
+    delete file;
+    Sync();
+    return result;
+}
+
+static int
+do_utimens(const char *path, const struct timespec tv[2])
+{
+    // Nachos keeps no times.
+    return 0;
+}
+
+static int
+do_release(const char *path, struct fuse_file_info *fi)
+{
+    fprintf(stderr, "[release] %s\n", path);
+
+    delete FileOf(fi);
+    fi->fh = 0;
+    Sync();
+    return 0;
+}
+
+static int
+do_fsync(const char *path, int datasync, struct fuse_file_info *fi)
+{
+    Sync();
+    return 0;
+}
+
+static int
+do_mkdir(const char *path, mode_t mode)
+{
+    fprintf(stderr, "[mkdir] %s\n", path);
+
+    if (!fileSystem->MakeDirectory(path)) {
+        return -EEXIST;
+    }
+    Sync();
+    return 0;
+}
+
+static int
+do_unlink(const char *path)
+{
+    fprintf(stderr, "[unlink] %s\n", path);
+
+    bool isDirectory;
+    unsigned length;
+    if (!fileSystem->Stat(path, &isDirectory, &length)) {
+        return -ENOENT;
+    }
+    if (isDirectory) {
+        return -EISDIR;
+    }
+    if (!fileSystem->Remove(path)) {
+        return -EIO;
+    }
+    Sync();
+    return 0;
+}
+
+static int
+do_rmdir(const char *path)
+{
+    fprintf(stderr, "[rmdir] %s\n", path);
+
+    bool isDirectory;
+    unsigned length;
+    if (!fileSystem->Stat(path, &isDirectory, &length)) {
+        return -ENOENT;
+    }
+    if (!isDirectory) {
+        return -ENOTDIR;
+    }
+    if (!fileSystem->Remove(path)) {
+        return -ENOTEMPTY;
+    }
+    Sync();
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    // Split the options for Nachos from those for FUSE.
+    int split = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--")) {
+            split = i;
+            break;
+        }
+    }
+
+    const unsigned numDefaults = sizeof NACHOS_DEFAULTS
+                                 / sizeof *NACHOS_DEFAULTS;
+    char **nachosArgv = new char * [numDefaults + argc + 1];
+    int nachosArgc = 0;
+    nachosArgv[nachosArgc++] = argv[0];
+    for (unsigned i = 0; i < numDefaults; i++) {
+        nachosArgv[nachosArgc++] = (char *) NACHOS_DEFAULTS[i];
+    }
+    for (int i = 1; i < split; i++) {
+        nachosArgv[nachosArgc++] = argv[i];
+    }
+    nachosArgv[nachosArgc] = nullptr;
+
+    char **fuseArgv = new char * [argc + 3];
+    int fuseArgc = 0;
+    fuseArgv[fuseArgc++] = argv[0];
+    fuseArgv[fuseArgc++] = (char *) "-f";
+    fuseArgv[fuseArgc++] = (char *) "-s";
+    for (int i = split + 1; i < argc; i++) {
+        fuseArgv[fuseArgc++] = argv[i];
+    }
+    fuseArgv[fuseArgc] = nullptr;
+
+    struct fuse_operations operations;
+    memset(&operations, 0, sizeof operations);
+    operations.getattr  = do_getattr;
+    operations.readdir  = do_readdir;
+    operations.open     = do_open;
+    operations.create   = do_create;
+    operations.read     = do_read;
+    operations.write    = do_write;
+    operations.truncate = do_truncate;
+    operations.utimens  = do_utimens;
+    operations.release  = do_release;
+    operations.fsync    = do_fsync;
+    operations.mkdir    = do_mkdir;
+    operations.unlink   = do_unlink;
+    operations.rmdir    = do_rmdir;
+
+    Initialize(nachosArgc, nachosArgv);
+    int result = fuse_main(fuseArgc, fuseArgv, &operations, nullptr);
+    delete [] fuseArgv;
+    delete [] nachosArgv;
+    if (result != 0) {
+        exit(result);
+    }
+    Cleanup();  // Writes everything back, and exits.
+}
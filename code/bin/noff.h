@@ -3,6 +3,24 @@
 /// Basically, we only know about three types of segments: code (read-only),
 /// initialized data, and unitialized data.
 ///
+/// Segments are packed one after the other, unless the magic number is
+/// `NOFF_MAGIC_PAGED`.  Then each starts at a multiple of `pageSize`, both
+/// in memory and in the file, so that no page holds parts of two of them
+/// and each page of the file can be read with a single transfer; and
+/// segments carry the permissions their pages are to be mapped with.
+///
+/// A file may also carry a table of the procedures of the program, so that
+/// program counters can be told by name without the COFF file it came
+/// from: `numSymbols` entries sorted by address, followed by `stringsSize`
+/// bytes of null-terminated names.
+///
+/// The code and initialized data segments may also be compressed, by blocks
+/// of a page; see `noff_lz.h`.  Their `size` is still the one they expand
+/// to.
+///
+/// Files made before the header had its last fields have their segments
+/// right after the first ones; readers take the last fields as zero then.
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -17,6 +35,16 @@
 
 #define NOFF_MAGIC  0xBADFAD  // Magic number denoting Nachos object code
                               // file.
+#define NOFF_MAGIC_PAGED  0xBADFAE  // Same, with page-aligned segments.
+
+/// Size of the pages of the Nachos machine, that segments are aligned to by
+/// `coff2noff -p`.
+#define NOFF_PAGE_SIZE  128
+
+/// Permissions of a segment.
+#define NOFF_READ   1
+#define NOFF_WRITE  2
+#define NOFF_EXEC   4
 
 typedef struct noffSegment {
     uint32_t virtualAddr;  // Location of segment in virtual address space.
@@ -30,7 +58,26 @@ typedef struct noffHeader {
     noffSegment initData;    // Initialized data segment.
     noffSegment uninitData;  // Uninitialized data segment -- should be
                              // zeroed before use.
+
+    // Only meaningful with `NOFF_MAGIC_PAGED`.
+    uint32_t pageSize;         // Alignment of the segments.
+    uint32_t codePerms;        // `NOFF_READ`, `NOFF_WRITE` and `NOFF_EXEC`.
+    uint32_t initDataPerms;
+    uint32_t uninitDataPerms;
+
+    // Symbol table, if `numSymbols` is not 0.
+    uint32_t symbolsInFileAddr;
+    uint32_t numSymbols;
+    uint32_t stringsSize;
+
+    uint32_t compressed;  // Whether segments are compressed, if not 0.
 } noffHeader;
 
+/// A procedure, in the symbol table.
+typedef struct noffSymbol {
+    uint32_t address;  // Where it starts.
+    uint32_t name;     // Offset of its name in the strings.
+} noffSymbol;
+
 
 #endif
@@ -0,0 +1,135 @@
+/// Compression of the segments of NOFF files.
+///
+/// `coff2noff -z` cuts the code and initialized data segments into blocks
+/// of `NOFF_BLOCK_SIZE` bytes, the size of a page, and compresses each
+/// block on its own, so that any page can be loaded by reading and
+/// expanding its block alone.  A compressed segment starts, at its
+/// `inFileAddr`, with a table of the offset of each block from the start of
+/// the table, and one more for where the last block ends; the blocks
+/// follow.  A block stored in as many bytes as it expands to is stored as
+/// is.
+///
+/// Blocks are compressed with a simple LZ77 scheme, cheap to expand: a
+/// sequence of tokens, each a byte `c` followed by
+/// * if `c` is below 0x80, `c + 1` bytes to copy as they are;
+/// * otherwise a byte `d`, for `(c & 0x7F) + 3` bytes to copy from `d + 1`
+///   bytes back in the output, which may overlap the bytes being copied.
+///
+/// The routines are in this header so that the tools, in C, and the
+/// kernel, in C++, share them.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_BIN_NOFF_LZ__H
+#define NACHOS_BIN_NOFF_LZ__H
+
+
+#include "noff.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+
+/// Bytes of a segment in each compressed block.
+#define NOFF_BLOCK_SIZE  NOFF_PAGE_SIZE
+
+/// Room to leave for compressing `size` bytes, at worst.
+#define NOFF_LZ_MAX_SIZE(size)  ((size) + ((size) + 127) / 128)
+
+/// Shortest and longest copies, and farthest back they reach.
+#define NOFF_LZ_MIN_MATCH  3
+#define NOFF_LZ_MAX_MATCH  (0x7F + NOFF_LZ_MIN_MATCH)
+#define NOFF_LZ_WINDOW     256
+
+/// Return the number of blocks of a segment of `size` bytes.
+static inline unsigned
+NoffBlockCount(unsigned size)
+{
+    return (size + NOFF_BLOCK_SIZE - 1) / NOFF_BLOCK_SIZE;
+}
+
+/// Compress the `size` bytes at `in` into `out`, which has room for
+/// `NOFF_LZ_MAX_SIZE(size)` bytes; return the size of the result.
+///
+/// The longest match is searched for greedily, at every position.
+static inline unsigned
+NoffLzCompress(const char *in, unsigned size, char *out)
+{
+    unsigned outSize = 0;
+    unsigned literals = 0;  // Pending, right before `i`.
+    unsigned i = 0;
+    while (i < size) {
+        unsigned bestLength = 0, bestDistance = 0;
+        unsigned first = i > NOFF_LZ_WINDOW ? i - NOFF_LZ_WINDOW : 0;
+        for (unsigned j = first; j < i; j++) {
+            unsigned length = 0;
+            while (length < NOFF_LZ_MAX_MATCH && i + length < size
+                   && in[j + length] == in[i + length]) {
+                length++;
+            }
+            if (length > bestLength) {
+                bestLength   = length;
+                bestDistance = i - j;
+            }
+        }
+
+        if (bestLength < NOFF_LZ_MIN_MATCH) {
+            literals++;
+            i++;
+            if (literals < 0x80 && i < size) {
+                continue;
+            }
+        }
+        if (literals > 0) {
+            out[outSize++] = (char) (literals - 1);
+            memcpy(&out[outSize], &in[i - literals], literals);
+            outSize += literals;
+            literals = 0;
+        }
+        if (bestLength >= NOFF_LZ_MIN_MATCH) {
+            out[outSize++] = (char) (0x80
+                                     | (bestLength - NOFF_LZ_MIN_MATCH));
+            out[outSize++] = (char) (bestDistance - 1);
+            i += bestLength;
+        }
+    }
+    return outSize;
+}
+
+/// Expand the `inSize` bytes at `in` into the `outSize` bytes at `out`.
+/// Return false if they do not expand to exactly that many.
+static inline bool
+NoffLzExpand(const char *in, unsigned inSize, char *out, unsigned outSize)
+{
+    unsigned i = 0, o = 0;
+    while (i < inSize) {
+        unsigned c = (unsigned char) in[i++];
+        if (c < 0x80) {
+            unsigned n = c + 1;
+            if (n > inSize - i || n > outSize - o) {
+                return false;
+            }
+            memcpy(&out[o], &in[i], n);
+            i += n;
+            o += n;
+        } else {
+            if (i == inSize) {
+                return false;
+            }
+            unsigned n = (c & 0x7F) + NOFF_LZ_MIN_MATCH;
+            unsigned distance = (unsigned char) in[i++] + 1;
+            if (distance > o || n > outSize - o) {
+                return false;
+            }
+            for (unsigned k = 0; k < n; k++, o++) {
+                out[o] = out[o - distance];
+            }
+        }
+    }
+    return o == outSize;
+}
+
+
+#endif
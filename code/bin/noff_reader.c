@@ -0,0 +1,160 @@
+/// Routines for the tools to read NOFF files.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "noff_reader.h"
+#include "noff_lz.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define FAIL(rv, s)           \
+    {                         \
+        if (error != NULL) {  \
+            *error = (s);     \
+        }                     \
+        return (rv);          \
+    }
+
+/// The lowest file offset of a segment is where the header ends.
+bool
+NoffReaderLoadHeader(FILE *f, noffHeader *h)
+{
+    assert(f != NULL);
+    assert(h != NULL);
+
+    memset(h, 0, sizeof *h);
+    if (fseek(f, 0, SEEK_SET) != 0) {
+        return false;
+    }
+    size_t read = fread(h, 1, sizeof *h, f);
+    if (read < offsetof(noffHeader, pageSize)
+          || (h->noffMagic != NOFF_MAGIC
+              && h->noffMagic != NOFF_MAGIC_PAGED)) {
+        return false;
+    }
+
+    uint32_t end = sizeof *h;
+    if (h->code.size > 0 && h->code.inFileAddr < end) {
+        end = h->code.inFileAddr;
+    }
+    if (h->initData.size > 0 && h->initData.inFileAddr < end) {
+        end = h->initData.inFileAddr;
+    }
+    if (end > read) {
+        end = read;
+    }
+    memset((char *) h + end, 0, sizeof *h - end);
+    return true;
+}
+
+bool
+NoffReaderLoadSegment(FILE *f, const noffHeader *h, const noffSegment *s,
+                      char *dest, uint32_t *stored)
+{
+    assert(f != NULL);
+    assert(h != NULL);
+    assert(s != NULL);
+    assert(dest != NULL);
+
+    if (s->size == 0) {
+        if (stored != NULL) {
+            *stored = 0;
+        }
+        return true;
+    }
+    if (fseek(f, s->inFileAddr, SEEK_SET) != 0) {
+        return false;
+    }
+    if (!h->compressed) {
+        if (stored != NULL) {
+            *stored = s->size;
+        }
+        return fread(dest, 1, s->size, f) == s->size;
+    }
+
+    unsigned numBlocks = NoffBlockCount(s->size);
+    uint32_t *table = malloc((numBlocks + 1) * sizeof *table);
+    if (table == NULL
+          || fread(table, sizeof *table, numBlocks + 1, f) != numBlocks + 1) {
+        free(table);
+        return false;
+    }
+    char block[NOFF_BLOCK_SIZE];
+    bool ok = true;
+    for (unsigned b = 0; ok && b < numBlocks; b++) {
+        unsigned length = s->size - b * NOFF_BLOCK_SIZE < NOFF_BLOCK_SIZE
+                          ? s->size - b * NOFF_BLOCK_SIZE : NOFF_BLOCK_SIZE;
+        uint32_t n = table[b + 1] - table[b];
+        char *into = dest + b * NOFF_BLOCK_SIZE;
+        ok = table[b + 1] >= table[b] && n <= length
+             && fseek(f, s->inFileAddr + table[b], SEEK_SET) == 0
+             && fread(n == length ? into : block, 1, n, f) == n
+             && (n == length || NoffLzExpand(block, n, into, length));
+    }
+    if (ok && stored != NULL) {
+        *stored = table[numBlocks];
+    }
+    free(table);
+    return ok;
+}
+
+bool
+NoffReaderLoadProcedures(FILE *f, const noffHeader *h,
+                         coffProcedure **procedures, unsigned *count,
+                         char **error)
+{
+    assert(f != NULL);
+    assert(h != NULL);
+    assert(procedures != NULL);
+    assert(count != NULL);
+
+    if (h->numSymbols == 0) {
+        FAIL(false, "File has no symbols");
+    }
+    noffSymbol *symbols = malloc(h->numSymbols * sizeof *symbols);
+    char *strings = malloc(h->stringsSize + 1);
+    *procedures = malloc(h->numSymbols * sizeof **procedures);
+    if (symbols == NULL || strings == NULL || *procedures == NULL) {
+        free(symbols);
+        free(strings);
+        free(*procedures);
+        FAIL(false, "Could not allocate memory");
+    }
+    if (fseek(f, h->symbolsInFileAddr, SEEK_SET) != 0
+          || fread(symbols, sizeof *symbols, h->numSymbols, f)
+               != h->numSymbols
+          || fread(strings, 1, h->stringsSize, f) != h->stringsSize) {
+        free(symbols);
+        free(strings);
+        free(*procedures);
+        FAIL(false, "File is too short");
+    }
+    strings[h->stringsSize] = '\0';
+
+    // Already sorted.
+    *count = 0;
+    for (unsigned i = 0; i < h->numSymbols; i++) {
+        if (symbols[i].name >= h->stringsSize) {
+            continue;
+        }
+        coffProcedure *p = &(*procedures)[*count];
+        p->address = symbols[i].address;
+        p->name    = malloc(strlen(&strings[symbols[i].name]) + 1);
+        if (p->name == NULL) {
+            continue;
+        }
+        strcpy(p->name, &strings[symbols[i].name]);
+        (*count)++;
+    }
+
+    free(symbols);
+    free(strings);
+    return true;
+}
@@ -0,0 +1,39 @@
+/// Routines for the tools to read NOFF files.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_BIN_NOFF_READER__H
+#define NACHOS_BIN_NOFF_READER__H
+
+
+#include "coff_reader.h"
+#include "noff.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+
+/// Read the header of the NOFF file `f` into `*h`, with the fields a file
+/// made before them lacks set to zero.  Return false if `f` is not a NOFF
+/// file.
+bool NoffReaderLoadHeader(FILE *f, noffHeader *h);
+
+/// Read the whole segment `s` of the NOFF file `f`, whose header is `*h`,
+/// into `dest`, which has room for `s->size` bytes, expanding it if it is
+/// compressed.  If `stored` is not null, set `*stored` to the bytes it
+/// takes in the file.  Return false if the file is too short or damaged.
+bool NoffReaderLoadSegment(FILE *f, const noffHeader *h,
+                           const noffSegment *s, char *dest,
+                           uint32_t *stored);
+
+/// Read the procedures of the symbol table of the NOFF file `f`, whose
+/// header is `*h`, sorted by address, into an array allocated for them, as
+/// `CoffReaderLoadProcedures` does.  Free it with `CoffReaderFreeProcedures`.
+bool NoffReaderLoadProcedures(FILE *f, const noffHeader *h,
+                              coffProcedure **procedures, unsigned *count,
+                              char **error);
+
+
+#endif
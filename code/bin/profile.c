@@ -0,0 +1,200 @@
+/// Program that maps the PC samples taken by `nachos -prof` to the
+/// procedures of a user program.
+///
+/// Samples are attributed to the procedure with the highest address not
+/// above them, from the external symbols of the COFF file the program was
+/// converted from; so the COFF file must be linked without stripping it.
+/// The NOFF file itself may be given instead, if `coff2noff -s` embedded
+/// the symbol table in it.
+/// Either a flat profile is printed for each process, with the share of its
+/// samples in each procedure, or, with `-f`, one line per program and
+/// procedure with the samples in it, in the folded stacks format read by
+/// `flamegraph.pl` and similar tools.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "coff_reader.h"
+#include "noff_reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define MAX_LINE  256
+
+static coffProcedure *procedures;
+static unsigned numProcedures;
+
+/// Samples in each procedure, and, past them, in no known procedure.
+static unsigned long *counts;
+
+/// Return the procedure `address` lies in, or `numProcedures`.
+static unsigned
+FindProcedure(uint32_t address)
+{
+    unsigned low = 0, high = numProcedures;
+    while (low < high) {                 // Find the first one above it...
+        unsigned middle = (low + high) / 2;
+        if (procedures[middle].address <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low == 0 ? numProcedures : low - 1;  // ...and take the previous.
+}
+
+static const char *
+BaseName(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash == NULL ? path : slash + 1;
+}
+
+static int
+CompareCounts(const void *a, const void *b)
+{
+    unsigned long x = counts[*(const unsigned *) a];
+    unsigned long y = counts[*(const unsigned *) b];
+    return x > y ? -1 : x < y;
+}
+
+/// Print the samples counted for one process, and clear them.
+static void
+PrintProcess(unsigned id, const char *program, unsigned long samples,
+             unsigned long outside, int folded)
+{
+    unsigned *order = malloc((numProcedures + 1) * sizeof *order);
+    if (order == NULL) {
+        fprintf(stderr, "profile: could not allocate memory.\n");
+        exit(1);
+    }
+    for (unsigned i = 0; i <= numProcedures; i++) {
+        order[i] = i;
+    }
+    qsort(order, numProcedures + 1, sizeof *order, CompareCounts);
+
+    if (!folded) {
+        printf("Process %u, %s: %lu samples, %lu outside the code\n"
+               "  %%time   samples  procedure\n",
+               id, program, samples, outside);
+    }
+    for (unsigned i = 0; i <= numProcedures && counts[order[i]] != 0; i++) {
+        unsigned p = order[i];
+        const char *name = p < numProcedures ? procedures[p].name : "??";
+        if (folded) {
+            printf("%s;%s %lu\n", BaseName(program), name, counts[p]);
+        } else {
+            printf("%7.2f %9lu  %s\n",
+                   100.0 * counts[p] / (samples == 0 ? 1 : samples),
+                   counts[p], name);
+        }
+        counts[p] = 0;
+    }
+    if (!folded) {
+        printf("\n");
+    }
+    free(order);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int folded = argc > 1 && strcmp(argv[1], "-f") == 0;
+    if (argc - folded < 3 || argc - folded > 4) {
+        fprintf(stderr,
+                "Usage: %s [-f] <COFF or NOFF file> <profile file> "
+                "[<program>]\n",
+                argv[0]);
+        return 1;
+    }
+    const char *coffPath    = argv[1 + folded];
+    const char *profilePath = argv[2 + folded];
+    const char *only        = argc - folded == 4 ? argv[3 + folded] : NULL;
+
+    FILE *f = fopen(coffPath, "rb");
+    if (f == NULL) {
+        perror(coffPath);
+        return 1;
+    }
+    noffHeader h;
+    coffReaderData d;
+    char *error;
+    if (NoffReaderLoadHeader(f, &h)) {
+        if (!NoffReaderLoadProcedures(f, &h, &procedures, &numProcedures,
+                                      &error)) {
+            fprintf(stderr, "profile: %s: %s.\n", coffPath, error);
+            return 1;
+        }
+    } else {
+        fseek(f, 0, SEEK_SET);
+        if (!CoffReaderLoad(&d, f, &error)
+              || !CoffReaderLoadProcedures(&d, f, &procedures,
+                                           &numProcedures, &error)) {
+            fprintf(stderr, "profile: %s: %s.\n", coffPath, error);
+            return 1;
+        }
+        CoffReaderUnload(&d);
+    }
+    fclose(f);
+
+    counts = calloc(numProcedures + 1, sizeof *counts);
+    if (counts == NULL) {
+        fprintf(stderr, "profile: could not allocate memory.\n");
+        return 1;
+    }
+
+    FILE *p = fopen(profilePath, "r");
+    if (p == NULL) {
+        perror(profilePath);
+        return 1;
+    }
+
+    // Samples of a process are counted until the next process starts.
+    char line[MAX_LINE];
+    char program[MAX_LINE];
+    int inProcess = 0, counting = 0;
+    unsigned id = 0;
+    unsigned long samples = 0, outside = 0;
+    while (fgets(line, sizeof line, p) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        unsigned address, nextId;
+        unsigned long count, nextSamples, nextOutside;
+        int skip;
+        if (line[0] == '#') {
+            continue;
+        } else if (sscanf(line, "process %u %lu %lu %n",
+                          &nextId, &nextSamples, &nextOutside, &skip) == 3) {
+            if (counting) {
+                PrintProcess(id, program, samples, outside, folded);
+            }
+            id      = nextId;
+            samples = nextSamples;
+            outside = nextOutside;
+            strcpy(program, line + skip);
+            inProcess = 1;
+            counting  = only == NULL || strcmp(program, only) == 0;
+        } else if (sscanf(line, "%x %lu", &address, &count) == 2
+                   && inProcess) {
+            if (counting) {
+                counts[FindProcedure(address)] += count;
+            }
+        } else {
+            fprintf(stderr, "profile: %s: bad line `%s`.\n",
+                    profilePath, line);
+            return 1;
+        }
+    }
+    if (counting) {
+        PrintProcess(id, program, samples, outside, folded);
+    }
+    fclose(p);
+
+    free(counts);
+    CoffReaderFreeProcedures(procedures, numProcedures);
+    return 0;
+}
@@ -5,14 +5,17 @@
 /// limitation of liability and disclaimer of warranty provisions.
 
 
-#include "noff.h"
+#include "noff_reader.h"
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 
+/// A compressed segment is read whole, to tell how much it takes.
 static void
-PrintSegment(noffSegment *s, const char *description)
+PrintSegment(FILE *f, const noffHeader *h, const noffSegment *s,
+             const char *description, bool paged, uint32_t perms)
 {
     printf("    %s segment:\n"
            "        Virtual address: %u (0x%X)\n"
@@ -22,6 +25,23 @@ PrintSegment(noffSegment *s, const char *description)
            s->virtualAddr, s->virtualAddr,
            s->inFileAddr, s->inFileAddr,
            s->size);
+    if (paged) {
+        printf("        Permissions: %c%c%c\n",
+               perms & NOFF_READ  ? 'r' : '-',
+               perms & NOFF_WRITE ? 'w' : '-',
+               perms & NOFF_EXEC  ? 'x' : '-');
+    }
+    if (!h->compressed || s == &h->uninitData || s->size == 0) {
+        return;
+    }
+    char *buffer = malloc(s->size);
+    uint32_t stored;
+    if (buffer != NULL && NoffReaderLoadSegment(f, h, s, buffer, &stored)) {
+        printf("        Compressed: %u bytes in the file\n", stored);
+    } else {
+        printf("        Compressed, but damaged\n");
+    }
+    free(buffer);
 }
 
 int
@@ -42,25 +62,55 @@ main(int argc, char *argv[])
 
     // Read the file's header.
     noffHeader h;
-    int rv = fread(&h, sizeof h, 1, f);
-    if (rv != 1) {
+    bool noff = NoffReaderLoadHeader(f, &h);
+    if (!noff && ferror(f)) {
         perror(path);
         fclose(f);
         return 1;
     }
 
     // Analyze the header and print the results.
+    bool paged = h.noffMagic == NOFF_MAGIC_PAGED;
     if (h.noffMagic == NOFF_MAGIC) {
         printf("%s: NOFF file\n"
                "    Magic: 0x%X\n",
                path, h.noffMagic);
+    } else if (paged) {
+        printf("%s: NOFF file, page-aligned\n"
+               "    Magic: 0x%X\n"
+               "    Page size: %u bytes\n",
+               path, h.noffMagic, h.pageSize);
     } else {
         printf("%s: not a NOFF file\n"
                "    Magic: 0x%X (should be 0x%X)\n",
                path, h.noffMagic, NOFF_MAGIC);
     }
-    PrintSegment(&h.code, "Code");
-    PrintSegment(&h.initData, "Initialized data");
-    PrintSegment(&h.uninitData, "Uninitialized data");
+    PrintSegment(f, &h, &h.code, "Code", paged, h.codePerms);
+    PrintSegment(f, &h, &h.initData, "Initialized data", paged,
+                 h.initDataPerms);
+    PrintSegment(f, &h, &h.uninitData, "Uninitialized data", paged,
+                 h.uninitDataPerms);
+    if (!noff || h.numSymbols == 0) {
+        fclose(f);
+        return 0;
+    }
+
+    // Print the symbol table.
+    printf("    Symbols: %u, at in-file address %u (0x%X)\n",
+           h.numSymbols, h.symbolsInFileAddr, h.symbolsInFileAddr);
+    coffProcedure *procedures;
+    unsigned count;
+    char *error;
+    if (!NoffReaderLoadProcedures(f, &h, &procedures, &count, &error)) {
+        fprintf(stderr, "%s: %s.\n", path, error);
+        fclose(f);
+        return 1;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        printf("        0x%08X  %s\n",
+               procedures[i].address, procedures[i].name);
+    }
+    CoffReaderFreeProcedures(procedures, count);
+    fclose(f);
     return 0;
 }
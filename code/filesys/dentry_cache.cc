@@ -0,0 +1,131 @@
+/// Routines to cache the lookups of names in directories.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "dentry_cache.hh"
+#include "directory.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+DentryCache::DentryCache(unsigned size_)
+{
+    ASSERT(size_ > 0);
+
+    size    = size_;
+    entries = new Dentry [size];
+    for (unsigned i = 0; i < size; i++) {
+        entries[i].inUse = false;
+    }
+
+    index = new HashIndex(size);
+
+    clock = 0;
+    lock  = new Lock("dentry cache");
+}
+
+DentryCache::~DentryCache()
+{
+    delete lock;
+    delete index;
+    delete [] entries;
+}
+
+unsigned
+DentryCache::Hash(unsigned dirSector, const char *name)
+{
+    return Directory::Hash(name) ^ dirSector * 2654435761U;
+}
+
+void
+DentryCache::Unindex(unsigned i)
+{
+    ASSERT(i < size && entries[i].inUse);
+
+    index->Remove(i, Hash(entries[i].dirSector, entries[i].name));
+}
+
+int
+DentryCache::Find(unsigned dirSector, const char *name) const
+{
+    ASSERT(name != nullptr);
+
+    int i = index->First(Hash(dirSector, name));
+    for (; i != -1; i = index->Next(i)) {
+        if (entries[i].dirSector == dirSector
+              && !strncmp(entries[i].name, name, FILE_NAME_MAX_LEN)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool
+DentryCache::Lookup(unsigned dirSector, const char *name,
+                    int *sector, bool *isDirectory)
+{
+    ASSERT(sector != nullptr && isDirectory != nullptr);
+
+    lock->Acquire();
+    int i = Find(dirSector, name);
+    if (i != -1) {
+        entries[i].lastUsed = ++clock;
+        *sector      = entries[i].sector;
+        *isDirectory = entries[i].isDirectory;
+        stats->numDentryHits++;
+    } else {
+        stats->numDentryMisses++;
+    }
+    lock->Release();
+    return i != -1;
+}
+
+/// A free entry is taken if there is one, or else the least recently used.
+void
+DentryCache::Insert(unsigned dirSector, const char *name,
+                    int sector, bool isDirectory)
+{
+    lock->Acquire();
+    int i = Find(dirSector, name);
+    if (i == -1) {
+        i = 0;
+        for (unsigned j = 0; j < size; j++) {
+            if (!entries[j].inUse) {
+                i = j;
+                break;
+            }
+            if (entries[j].lastUsed < entries[i].lastUsed) {
+                i = j;
+            }
+        }
+        if (entries[i].inUse) {
+            Unindex(i);
+        }
+        entries[i].inUse     = true;
+        entries[i].dirSector = dirSector;
+        strncpy(entries[i].name, name, FILE_NAME_MAX_LEN);
+        entries[i].name[FILE_NAME_MAX_LEN] = '\0';
+        index->Insert(i, Hash(dirSector, entries[i].name));
+    }
+    entries[i].sector      = sector;
+    entries[i].isDirectory = isDirectory;
+    entries[i].lastUsed    = ++clock;
+    lock->Release();
+}
+
+void
+DentryCache::ForgetDirectory(unsigned dirSector)
+{
+    lock->Acquire();
+    for (unsigned i = 0; i < size; i++) {
+        if (entries[i].inUse && entries[i].dirSector == dirSector) {
+            Unindex(i);
+            entries[i].inUse = false;
+        }
+    }
+    lock->Release();
+}
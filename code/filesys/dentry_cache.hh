@@ -0,0 +1,93 @@
+/// Data structures to cache the lookups of names in directories.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_DENTRYCACHE__HH
+#define NACHOS_FILESYS_DENTRYCACHE__HH
+
+
+#include "directory_entry.hh"
+#include "lib/hash_index.hh"
+#include "threads/lock.hh"
+
+
+/// A cache of what each name stands for in each directory, so that looking
+/// up a path does not read every directory along it from the disk again.
+///
+/// An entry maps the name of a component, in the directory whose header is
+/// at some sector, to the sector of the header of what it names, and to
+/// whether that is a directory.  Names known not to be in a directory are
+/// cached too, as negative entries, so that lookups that fail are cheap as
+/// well.
+///
+/// The file system must keep the cache up to date as it changes
+/// directories.  The least recently used entry makes room for a new one.
+class DentryCache {
+public:
+
+    /// Entries cached unless told otherwise.
+    static const unsigned DEFAULT_SIZE = 64;
+
+    /// Initialize an empty cache of `size` entries.
+    DentryCache(unsigned size = DEFAULT_SIZE);
+
+    ~DentryCache();
+
+    /// Look `name` up in the directory whose header is at `dirSector`.
+    /// Return false if nothing is cached about it; otherwise set `*sector`
+    /// to the sector of its header, or to -1 if it is known not to be in
+    /// the directory, and `*isDirectory`.
+    bool Lookup(unsigned dirSector, const char *name,
+                int *sector, bool *isDirectory);
+
+    /// Record that `name`, in the directory whose header is at
+    /// `dirSector`, has its header at `sector`, or is not there if
+    /// `sector` is -1.  Anything cached about it before is replaced.
+    void Insert(unsigned dirSector, const char *name,
+                int sector, bool isDirectory);
+
+    /// Forget every name cached in the directory whose header is at
+    /// `dirSector`, which is gone.
+    void ForgetDirectory(unsigned dirSector);
+
+private:
+
+    /// A cached name.
+    class Dentry {
+    public:
+        bool inUse;
+        unsigned dirSector;
+        char name[FILE_NAME_MAX_LEN + 1];
+        int sector;  ///< -1 for a negative entry.
+        bool isDirectory;
+        unsigned long lastUsed;
+    };
+
+    /// The entry for `name` in `dirSector`, or -1 if none.  The lock must
+    /// be held.
+    int Find(unsigned dirSector, const char *name) const;
+
+    /// Hash of `name` in `dirSector`.
+    static unsigned Hash(unsigned dirSector, const char *name);
+
+    /// Take entry `i`, which must be in use, out of the index.
+    void Unindex(unsigned i);
+
+    Dentry *entries;
+    unsigned size;
+
+    /// The entries in use, by directory and name.
+    HashIndex *index;
+
+    /// Counts uses, to find the least recently used entry.
+    unsigned long clock;
+
+    /// Lookups happen with the file system held only for reading, so
+    /// several threads may be at the cache at once.
+    Lock *lock;
+};
+
+
+#endif
@@ -39,14 +39,19 @@ Directory::Directory(unsigned size)
     ASSERT(size > 0);
     raw.table = new DirectoryEntry [size];
     raw.tableSize = size;
+    dirty = new bool [size];
     for (unsigned i = 0; i < raw.tableSize; i++) {
         raw.table[i].inUse = false;
+        dirty[i] = true;
     }
+    index = new HashIndex(size);
 }
 
 /// De-allocate directory data structure.
 Directory::~Directory()
 {
+    delete [] dirty;
+    delete index;
     delete [] raw.table;
 }
 
@@ -59,31 +64,67 @@ Directory::FetchFrom(OpenFile *file)
     ASSERT(file != nullptr);
     file->ReadAt((char *) raw.table,
                  raw.tableSize * sizeof (DirectoryEntry), 0);
+
+    index->Clear();
+    for (unsigned i = 0; i < raw.tableSize; i++) {
+        dirty[i] = false;
+        if (raw.table[i].inUse) {
+            index->Insert(i, Hash(raw.table[i].name));
+        }
+    }
 }
 
-/// Write any modifications to the directory back to disk.
+/// Write any modifications to the directory back to disk.  Consecutive
+/// entries changed are written together.
 ///
 /// * `file` is a file to contain the new directory contents.
 void
 Directory::WriteBack(OpenFile *file)
 {
     ASSERT(file != nullptr);
-    file->WriteAt((char *) raw.table,
-                  raw.tableSize * sizeof (DirectoryEntry), 0);
+
+    for (unsigned i = 0; i < raw.tableSize; i++) {
+        if (!dirty[i]) {
+            continue;
+        }
+        unsigned end = i + 1;
+        while (end < raw.tableSize && dirty[end]) {
+            end++;
+        }
+        file->WriteAt((char *) &raw.table[i],
+                      (end - i) * sizeof (DirectoryEntry),
+                      i * sizeof (DirectoryEntry));
+        for (; i < end; i++) {
+            dirty[i] = false;
+        }
+    }
+}
+
+/// FNV-1a.
+unsigned
+Directory::Hash(const char *name)
+{
+    unsigned hash = 2166136261U;
+    for (unsigned i = 0; i < FILE_NAME_MAX_LEN && name[i] != '\0'; i++) {
+        hash = (hash ^ (unsigned char) name[i]) * 16777619U;
+    }
+    return hash;
 }
 
 /// Look up file name in directory, and return its location in the table of
 /// directory entries.  Return -1 if the name is not in the directory.
 ///
+/// Only the entries in the bucket of `name` are compared.
+///
 /// * `name` is the file name to look up.
 int
 Directory::FindIndex(const char *name)
 {
     ASSERT(name != nullptr);
 
-    for (unsigned i = 0; i < raw.tableSize; i++) {
-        if (raw.table[i].inUse
-              && !strncmp(raw.table[i].name, name, FILE_NAME_MAX_LEN)) {
+    int i = index->First(Hash(name));
+    for (; i != -1; i = index->Next(i)) {
+        if (!strncmp(raw.table[i].name, name, FILE_NAME_MAX_LEN)) {
             return i;
         }
     }
@@ -95,13 +136,18 @@ Directory::FindIndex(const char *name)
 /// directory.
 ///
 /// * `name` is the file name to look up.
+/// * `isDirectory` is set to whether the file is a directory, if found and
+///   not null.
 int
-Directory::Find(const char *name)
+Directory::Find(const char *name, bool *isDirectory)
 {
     ASSERT(name != nullptr);
 
     int i = FindIndex(name);
     if (i != -1) {
+        if (isDirectory != nullptr) {
+            *isDirectory = raw.table[i].isDirectory;
+        }
         return raw.table[i].sector;
     }
     return -1;
@@ -113,8 +159,9 @@ Directory::Find(const char *name)
 ///
 /// * `name` is the name of the file being added.
 /// * `newSector` is the disk sector containing the added file's header.
+/// * `isDirectory` tells whether the added file is a directory.
 bool
-Directory::Add(const char *name, int newSector)
+Directory::Add(const char *name, int newSector, bool isDirectory)
 {
     ASSERT(name != nullptr);
 
@@ -127,6 +174,9 @@ Directory::Add(const char *name, int newSector)
             raw.table[i].inUse = true;
             strncpy(raw.table[i].name, name, FILE_NAME_MAX_LEN);
             raw.table[i].sector = newSector;
+            raw.table[i].isDirectory = isDirectory;
+            dirty[i] = true;
+            index->Insert(i, Hash(raw.table[i].name));
             return true;
         }
     }
@@ -146,23 +196,39 @@ Directory::Remove(const char *name)
     if (i == -1) {
         return false;  // name not in directory
     }
+    index->Remove(i, Hash(raw.table[i].name));
     raw.table[i].inUse = false;
+    dirty[i] = true;
+    return true;
+}
+
+bool
+Directory::IsEmpty() const
+{
+    for (unsigned i = 0; i < raw.tableSize; i++) {
+        if (raw.table[i].inUse) {
+            return false;
+        }
+    }
     return true;
 }
 
-/// List all the file names in the directory.
+/// List all the file names in the directory; those of directories end in
+/// a slash.
 void
 Directory::List() const
 {
     for (unsigned i = 0; i < raw.tableSize; i++) {
         if (raw.table[i].inUse) {
-            printf("%s\n", raw.table[i].name);
+            printf("%s%s\n", raw.table[i].name,
+                   raw.table[i].isDirectory ? "/" : "");
         }
     }
 }
 
 /// List all the file names in the directory, their `FileHeader` locations,
-/// and the contents of each file.  For debugging.
+/// and the contents of each file, going into subdirectories.  For
+/// debugging.
 void
 Directory::Print() const
 {
@@ -172,11 +238,21 @@ Directory::Print() const
     for (unsigned i = 0; i < raw.tableSize; i++) {
         if (raw.table[i].inUse) {
             printf("\nDirectory entry:\n"
-                   "    name: %s\n"
+                   "    name: %s%s\n"
                    "    sector: %u\n",
-                   raw.table[i].name, raw.table[i].sector);
-            hdr->FetchFrom(raw.table[i].sector);
-            hdr->Print(nullptr);
+                   raw.table[i].name, raw.table[i].isDirectory ? "/" : "",
+                   raw.table[i].sector);
+            if (raw.table[i].isDirectory) {
+                OpenFile *file = new OpenFile(raw.table[i].sector);
+                Directory *sub = new Directory(raw.tableSize);
+                sub->FetchFrom(file);
+                sub->Print();
+                delete sub;
+                delete file;
+            } else {
+                hdr->FetchFrom(raw.table[i].sector);
+                hdr->Print(nullptr);
+            }
         }
     }
     printf("\n");
@@ -17,6 +17,7 @@
 
 #include "raw_directory.hh"
 #include "open_file.hh"
+#include "lib/hash_index.hh"
 
 
 /// The following class defines a UNIX-like “directory”.  Each entry in the
@@ -28,6 +29,10 @@
 /// The constructor initializes a directory structure in memory; the
 /// `FetchFrom`/`WriteBack` operations shuffle the directory information
 /// from/to disk.
+///
+/// Names are looked up through a hash table of the entries in use, built
+/// when the directory is fetched and kept up to date by `Add`/`Remove`, so
+/// that lookups do not go over the whole table.
 class Directory {
 public:
 
@@ -40,18 +45,24 @@ public:
     /// Initialize directory contents from disk.
     void FetchFrom(OpenFile *file);
 
-    /// Write modifications to directory contents back to disk.
+    /// Write modifications to directory contents back to disk.  Only the
+    /// entries changed since the last `FetchFrom` or `WriteBack` are
+    /// written; all of them, for a new directory.
     void WriteBack(OpenFile *file);
 
-    /// Find the sector number of the `FileHeader` for file: `name`.
-    int Find(const char *name);
+    /// Find the sector number of the `FileHeader` for file: `name`, and
+    /// whether it is a directory, if `isDirectory` is not null.
+    int Find(const char *name, bool *isDirectory = nullptr);
 
     /// Add a file name into the directory.
-    bool Add(const char *name, int newSector);
+    bool Add(const char *name, int newSector, bool isDirectory = false);
 
     /// Remove a file from the directory.
     bool Remove(const char *name);
 
+    /// Whether no file is in the directory.
+    bool IsEmpty() const;
+
     /// Print the names of all the files in the directory.
     void List() const;
 
@@ -65,11 +76,20 @@ public:
     /// system at a low level.
     const RawDirectory *GetRaw() const;
 
+    /// Hash of `name`, up to `FILE_NAME_MAX_LEN` characters.
+    static unsigned Hash(const char *name);
+
 private:
     /// Find the index into the directory table corresponding to `name`.
     int FindIndex(const char *name);
 
     RawDirectory raw;
+
+    /// The entries in use, by name.
+    HashIndex *index;
+
+    /// Whether each entry differs from what is on disk.
+    bool *dirty;
 };
 
 
@@ -12,7 +12,8 @@ const unsigned FILE_NAME_MAX_LEN = 32;
 
 /// The following class defines a "directory entry", representing a file in
 /// the directory.  Each entry gives the name of the file, and where the
-/// file's header is to be found on disk.
+/// file's header is to be found on disk.  The file may be a directory
+/// itself.
 ///
 /// Internal data structures kept public so that Directory operations can
 /// access them directly.
@@ -20,6 +21,8 @@ class DirectoryEntry {
 public:
     /// Is this directory entry in use?
     bool inUse;
+    /// Is the file a directory?
+    bool isDirectory;
     /// Location on disk to find the `FileHeader` for this file.
     unsigned sector;
     /// Text name for file, with +1 for the trailing `'\0'`.
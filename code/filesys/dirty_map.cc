@@ -0,0 +1,121 @@
+/// Routines to keep track of the metadata changed since it was last
+/// checked.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "dirty_map.hh"
+#include "lib/utility.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+static const unsigned DIRTY_MAP_MAGIC = 0x44495254;
+
+/// Bytes of the bits kept on the disk, the most that fit in the sector.
+static const unsigned RAW_MAP_SIZE = SECTOR_SIZE - sizeof (unsigned);
+
+struct RawDirtyMap {
+    unsigned magic;
+    unsigned char dirty[RAW_MAP_SIZE];
+};
+
+DirtyMap::DirtyMap()
+{
+    mapSize = DivRoundUp(diskSectors, REGION_SECTORS * BITS_IN_BYTE);
+    ASSERT(mapSize <= RAW_MAP_SIZE);
+      // The disk is too big for the map to fit in a sector.
+
+    sector    = -1;
+    dirty     = new unsigned char [mapSize];
+    memset(dirty, 0, mapSize);
+    numMarked = 0;
+    lock      = new Lock("dirty map");
+}
+
+DirtyMap::~DirtyMap()
+{
+    delete lock;
+    delete [] dirty;
+}
+
+void
+DirtyMap::Open(int sector_, bool format)
+{
+    ASSERT(sector_ >= 0 && (unsigned) sector_ < diskSectors);
+
+    lock->Acquire();
+    sector = sector_;
+    if (format) {
+        memset(dirty, 0, mapSize);
+        WriteBack();
+    } else {
+        char buffer[SECTOR_SIZE];
+        const RawDirtyMap *raw = (const RawDirtyMap *) buffer;
+        synchDisk->ReadSector(sector, buffer);
+        if (raw->magic == DIRTY_MAP_MAGIC) {
+            memcpy(dirty, raw->dirty, mapSize);
+        } else {
+            DEBUG('f', "No dirty map at sector %d, checking everything.\n",
+                  sector);
+            memset(dirty, 0xFF, mapSize);
+        }
+    }
+    lock->Release();
+}
+
+/// Marking a region costs a write to the disk, but only the first time.
+void
+DirtyMap::Note(int s)
+{
+    ASSERT(s >= 0 && (unsigned) s < diskSectors);
+
+    unsigned region = s / REGION_SECTORS;
+    unsigned char bit = 1 << region % BITS_IN_BYTE;
+    if (sector == -1 || dirty[region / BITS_IN_BYTE] & bit) {
+        return;
+    }
+    lock->Acquire();
+    if (!(dirty[region / BITS_IN_BYTE] & bit)) {
+        DEBUG('f', "Marking region %u as dirty.\n", region);
+        dirty[region / BITS_IN_BYTE] |= bit;
+        numMarked++;
+        WriteBack();
+    }
+    lock->Release();
+}
+
+bool
+DirtyMap::IsDirty(int s) const
+{
+    ASSERT(s >= 0 && (unsigned) s < diskSectors);
+
+    unsigned region = s / REGION_SECTORS;
+    return dirty[region / BITS_IN_BYTE] & 1 << region % BITS_IN_BYTE;
+}
+
+void
+DirtyMap::Clear(unsigned long since)
+{
+    lock->Acquire();
+    if (sector != -1 && numMarked == since) {
+        memset(dirty, 0, mapSize);
+        WriteBack();
+    }
+    lock->Release();
+}
+
+void
+DirtyMap::WriteBack()
+{
+    char buffer[SECTOR_SIZE];
+    RawDirtyMap *raw = (RawDirtyMap *) buffer;
+    memset(buffer, 0, SECTOR_SIZE);
+    raw->magic = DIRTY_MAP_MAGIC;
+    memcpy(raw->dirty, dirty, mapSize);
+    synchDisk->WriteSector(sector, buffer);
+    synchDisk->FlushSector(sector);
+}
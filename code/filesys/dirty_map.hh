@@ -0,0 +1,68 @@
+/// Data structures to keep track of the metadata changed since it was last
+/// checked.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_DIRTYMAP__HH
+#define NACHOS_FILESYS_DIRTYMAP__HH
+
+
+#include "machine/disk.hh"
+#include "threads/lock.hh"
+
+
+/// The regions of the disk where metadata was written since the file
+/// system was last checked, so that a check may look only at the files
+/// whose headers are in them.
+///
+/// The map is kept in a sector of its own.  A region is marked there, and
+/// the sector written to the disk, before the first write to it reaches the
+/// journal; so the map on the disk never misses a change, crash or not.
+/// Once a check succeeds, the map is cleared.
+class DirtyMap {
+public:
+
+    /// Sectors in each region.
+    static const unsigned REGION_SECTORS = 4;
+
+    /// Initialize a map that is not kept anywhere yet, and marks nothing.
+    DirtyMap();
+
+    ~DirtyMap();
+
+    /// Keep the map in `sector`.  If `format`, start it with nothing
+    /// marked; otherwise read it, taking every region as changed if what is
+    /// there is not a map.
+    void Open(int sector, bool format);
+
+    /// Tell that metadata is about to be written to `sector`.
+    void Note(int sector);
+
+    /// Is the region holding `sector` marked?
+    bool IsDirty(int sector) const;
+
+    /// Number of regions marked so far, so that a check can tell whether
+    /// any were while it ran.
+    unsigned long NumMarked() const { return numMarked; }
+
+    /// Clear the map, if no region was marked after `NumMarked` returned
+    /// `since`.
+    void Clear(unsigned long since);
+
+private:
+
+    /// Write the map to its sector, and wait until it is on the disk.  The
+    /// lock must be held.
+    void WriteBack();
+
+    int sector;  ///< Where the map is kept, or -1 until `Open`.
+    unsigned char *dirty;  ///< A bit for each region.
+    unsigned mapSize;      ///< Bytes of `dirty`.
+    unsigned long numMarked;
+    Lock *lock;
+};
+
+
+#endif
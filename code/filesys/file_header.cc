@@ -2,11 +2,17 @@
 /// the i-node).
 ///
 /// The file header is used to locate where on disk the file's data is
-/// stored.  We implement this as a fixed size table of pointers -- each
-/// entry in the table points to the disk sector containing that portion of
-/// the file data (in other words, there are no indirect or doubly indirect
-/// blocks). The table size is chosen so that the file header will be just
-/// big enough to fit in one disk sector,
+/// stored, which may be more than the file holds, so that it can grow into
+/// room reserved before.  A file of up to `INLINE_SIZE` bytes has its data
+/// in the header itself, instead of the table, so that it takes no more
+/// sectors, and a read of the header brings the data along; it moves to a
+/// data block once it grows past that.
+///
+/// Otherwise, the data is in data blocks.  We implement this as a table of extents -- each entry in the
+/// table tells the consecutive disk sectors containing that portion of the
+/// file data.  The first ones are in the header sector itself; the next
+/// ones, in an indirect index block; and the rest, in index blocks listed by
+/// a doubly indirect block.
 ///
 /// Unlike in a real system, we do not keep track of file permissions,
 /// ownership, last modification date, etc., in the file header.
@@ -25,39 +31,375 @@
 
 #include "file_header.hh"
 #include "threads/system.hh"
+#include "lib/slab.hh"
 
 #include <ctype.h>
 #include <stdio.h>
+#include <string.h>
+
+
+FileHeader::FileHeader()
+{
+    raw.numBytes   = 0;
+    raw.numSectors = 0;
+    raw.numExtents = 0;
+    raw.indirect = raw.doublyIndirect = 0;
+    for (unsigned i = 0; i < NUM_DOUBLY_INDIRECT; i++) {
+        doublyBlock[i] = 0;
+    }
+    extents  = nullptr;
+    sectorOf = nullptr;
+    numWritten = 0;
+}
+
+FileHeader::~FileHeader()
+{
+    Clear();
+}
 
+static Slab headerSlab("FileHeader", sizeof (FileHeader));
+
+void *
+FileHeader::operator new(size_t size)
+{
+    ASSERT(size == sizeof (FileHeader));
+    return headerSlab.Allocate();
+}
+
+void
+FileHeader::operator delete(void *p)
+{
+    if (p != nullptr) {
+        headerSlab.Free(p);
+    }
+}
+
+void
+FileHeader::Clear()
+{
+    delete [] extents;
+    delete [] sectorOf;
+    extents  = nullptr;
+    sectorOf = nullptr;
+    numWritten = 0;
+}
 
 /// Initialize a fresh file header for a newly created file.  Allocate data
 /// blocks for the file out of the map of free disk blocks.  Return false if
 /// there are not enough free blocks to accomodate the new file.
 ///
 /// * `freeMap` is the bit map of free disk sectors.
-/// * `fileSize` is the bit map of free disk sectors.
+/// * `fileSize` is the number of bytes in the file.
+/// * `near` is where on disk the file should be, usually its header.
+/// * `sparse` tells to leave the blocks as holes, to be taken when written.
+bool
+FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize, unsigned near,
+                     bool sparse)
+{
+    Clear();
+    raw.numBytes   = 0;
+    raw.numSectors = 0;
+    raw.numExtents = 0;
+    memset(raw.data, 0, sizeof raw.data);
+    bool success = sparse ? ExtendSparse(freeMap, fileSize, near)
+                          : Extend(freeMap, fileSize, near);
+    if (!success) {
+        return false;
+    }
+    raw.numBytes = fileSize;
+    return true;
+}
+
+/// Blocks are taken in runs as long as there are, starting with the first
+/// free one after the last block of the file, or after `near` if it has
+/// none, and each run after the previous one, so that the file is close to
+/// its header and can be read with few seeks.  A run right after the last
+/// block just makes the last extent longer.  Index blocks, if more are
+/// needed, come after the data.
+///
+/// A file kept in its header needs no blocks while it fits there; once it
+/// does not, its data is moved to the first block, through the journal.
+///
+/// If there is not enough room, nothing is taken.
 bool
-FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize)
+FileHeader::Extend(Bitmap *freeMap, unsigned numBytes, unsigned near)
 {
     ASSERT(freeMap != nullptr);
+    ASSERT(near < diskSectors);
 
-    if (fileSize > MAX_FILE_SIZE) {
+    if (numBytes > MaxFileSize()) {
         return false;
     }
-
-    raw.numBytes = fileSize;
-    raw.numSectors = DivRoundUp(fileSize, SECTOR_SIZE);
-    if (freeMap->CountClear() < raw.numSectors) {
+    if (numBytes <= AllocatedLength()) {
+        return true;
+    }
+    unsigned numSectors = DivRoundUp(numBytes, SECTOR_SIZE);
+    if (numSectors <= raw.numSectors) {
+        return true;
+    }
+    if (freeMap->CountClear() < numSectors - raw.numSectors) {
         return false;  // Not enough space.
     }
 
-    for (unsigned i = 0; i < raw.numSectors; i++) {
-        raw.dataSectors[i] = freeMap->Find();
+    Extent *grown = new Extent [NUM_EXTENTS];
+    unsigned numExtents = raw.numExtents;
+    for (unsigned i = 0; i < numExtents; i++) {
+        grown[i] = extents[i];
+    }
+
+    // Runs taken, to give them back if the rest cannot be.
+    Extent *taken = new Extent [NUM_EXTENTS + 1];
+    unsigned numTaken = 0;
+
+    unsigned from = NextSector(near);
+    bool success = true;
+    for (unsigned left = numSectors - raw.numSectors; left > 0;) {
+        unsigned length;
+        int start = freeMap->FindRun(from, left, &length);
+        Extent *last = numExtents > 0 ? &grown[numExtents - 1] : nullptr;
+        bool adjacent = start >= 0 && last != nullptr
+                        && Follows(last, start);
+        if (start < 0 || (!adjacent && numExtents == NUM_EXTENTS)) {
+            success = false;  // The free space is too scattered.
+            break;
+        }
+        for (unsigned i = 0; i < length; i++) {
+            freeMap->Mark(start + i);
+        }
+        taken[numTaken].start  = start;
+        taken[numTaken].length = length;
+        numTaken++;
+        if (adjacent) {
+            last->length += length;
+        } else {
+            grown[numExtents].start  = start;
+            grown[numExtents].length = length;
+            numExtents++;
+        }
+
+        left -= length;
+        from  = (start + length) % diskSectors;
+    }
+
+    unsigned oldIndex = IndexSectorsFor(raw.numExtents);
+    unsigned newIndex = success ? IndexSectorsFor(numExtents) : oldIndex;
+    unsigned index[NUM_DOUBLY_INDIRECT + 2];
+    for (unsigned i = oldIndex; i < newIndex; i++) {
+        unsigned length;
+        int sector = freeMap->FindRun(from, 1, &length);
+        if (sector < 0) {
+            // Give back what was taken so far.
+            for (unsigned j = oldIndex; j < i; j++) {
+                freeMap->Clear(index[j]);
+            }
+            success = false;
+            break;
+        }
+        freeMap->Mark(sector);
+        index[i] = sector;
+        from = sector;
+    }
+
+    if (!success) {
+        for (unsigned i = 0; i < numTaken; i++) {
+            for (unsigned j = 0; j < taken[i].length; j++) {
+                freeMap->Clear(taken[i].start + j);
+            }
+        }
+        delete [] taken;
+        delete [] grown;
+        return false;
+    }
+    delete [] taken;
+
+    for (unsigned i = oldIndex; i < newIndex; i++) {
+        if (i == 0) {
+            raw.indirect = index[i];
+        } else if (i == 1) {
+            raw.doublyIndirect = index[i];
+        } else {
+            doublyBlock[i - 2] = index[i];
+        }
+    }
+    bool wasInline = IsInline();
+    delete [] extents;
+    delete [] sectorOf;
+    extents        = grown;
+    raw.numExtents = numExtents;
+    raw.numSectors = numSectors;
+    MapSectors();
+
+    if (wasInline && raw.numBytes > 0) {
+        char block[SECTOR_SIZE];
+        memset(block, 0, sizeof block);
+        memcpy(block, raw.data, raw.numBytes);
+        journal->WriteSector(sectorOf[0], block);
+    }
+    if (wasInline) {
+        memset(raw.data, 0, sizeof raw.data);  // Extents go there now.
     }
     return true;
 }
 
-/// De-allocate all the space allocated for data blocks for this file.
+/// The blocks added are holes, so that nothing is taken for them but index
+/// blocks, if the header has no room for one more extent.  A file kept in
+/// its header moves to a block of its own first, if it holds anything.
+bool
+FileHeader::ExtendSparse(Bitmap *freeMap, unsigned numBytes, unsigned near)
+{
+    ASSERT(freeMap != nullptr);
+
+    if (numBytes > MaxFileSize()) {
+        return false;
+    }
+    if (numBytes <= AllocatedLength()) {
+        return true;
+    }
+    if (IsInline() && raw.numBytes > 0
+          && !Extend(freeMap, INLINE_SIZE + 1, near)) {
+        return false;
+    }
+    unsigned numSectors = DivRoundUp(numBytes, SECTOR_SIZE);
+    if (numSectors <= raw.numSectors) {
+        return true;
+    }
+    unsigned *sectors = new unsigned [numSectors];
+    for (unsigned i = 0; i < numSectors; i++) {
+        sectors[i] = i < raw.numSectors ? sectorOf[i] : HOLE;
+    }
+    bool success = Remap(freeMap, sectors, numSectors, near);
+    delete [] sectors;
+    return success;
+}
+
+/// Sectors are taken in runs as long as there are, each first looked for
+/// right after the block before, so that the blocks written together end up
+/// together.
+bool
+FileHeader::FillHoles(Bitmap *freeMap, unsigned first, unsigned last,
+                      unsigned near)
+{
+    ASSERT(freeMap != nullptr);
+    ASSERT(first <= last && last < raw.numSectors);
+
+    unsigned *sectors = new unsigned [raw.numSectors];
+    memcpy(sectors, sectorOf, raw.numSectors * sizeof *sectors);
+    unsigned from = near;
+    for (unsigned i = first; i > 0; i--) {
+        if (sectors[i - 1] != HOLE) {
+            from = (sectors[i - 1] + 1) % diskSectors;
+            break;
+        }
+    }
+
+    bool success = true;
+    unsigned i = first;
+    while (i <= last) {
+        if (sectors[i] != HOLE) {
+            from = (sectors[i] + 1) % diskSectors;
+            i++;
+            continue;
+        }
+        unsigned count = 0;
+        while (i + count <= last && sectors[i + count] == HOLE) {
+            count++;
+        }
+        unsigned length;
+        int start = freeMap->FindRun(from, count, &length);
+        if (start < 0) {
+            success = false;  // The disk is full.
+            break;
+        }
+        for (unsigned j = 0; j < length; j++) {
+            freeMap->Mark(start + j);
+            sectors[i + j] = start + j;
+        }
+        i   += length;
+        from = (start + length) % diskSectors;
+    }
+
+    if (success) {
+        success = Remap(freeMap, sectors, raw.numSectors, near);
+    }
+    if (!success) {
+        // Give back what was taken.
+        for (unsigned j = first; j < i; j++) {
+            if (sectors[j] != sectorOf[j]) {
+                freeMap->Clear(sectors[j]);
+            }
+        }
+    }
+    delete [] sectors;
+    return success;
+}
+
+bool
+FileHeader::PunchHoles(Bitmap *freeMap, unsigned first, unsigned last,
+                       unsigned near)
+{
+    ASSERT(freeMap != nullptr);
+    ASSERT(first <= last && last < raw.numSectors);
+
+    unsigned *sectors = new unsigned [raw.numSectors];
+    unsigned *freed   = new unsigned [raw.numSectors];
+    unsigned numFreed = 0;
+    for (unsigned i = 0; i < raw.numSectors; i++) {
+        sectors[i] = sectorOf[i];
+        if (i >= first && i <= last && sectors[i] != HOLE) {
+            freed[numFreed++] = sectors[i];
+            sectors[i] = HOLE;
+        }
+    }
+    bool success = Remap(freeMap, sectors, raw.numSectors, near);
+    for (unsigned i = 0; success && i < numFreed; i++) {
+        ASSERT(freeMap->Test(freed[i]));
+        freeMap->Clear(freed[i]);
+    }
+    delete [] freed;
+    delete [] sectors;
+    return success;
+}
+
+void
+FileHeader::SetLength(unsigned numBytes)
+{
+    ASSERT(numBytes <= AllocatedLength());
+    raw.numBytes = numBytes;
+}
+
+unsigned
+FileHeader::AllocatedLength() const
+{
+    return IsInline() ? INLINE_SIZE : raw.numSectors * SECTOR_SIZE;
+}
+
+bool
+FileHeader::IsInline() const
+{
+    return raw.numExtents == 0;
+}
+
+void
+FileHeader::ReadInline(char *into, unsigned numBytes, unsigned position) const
+{
+    ASSERT(into != nullptr);
+    ASSERT(IsInline() && position + numBytes <= INLINE_SIZE);
+
+    memcpy(into, &raw.data[position], numBytes);
+}
+
+void
+FileHeader::WriteInline(const char *from, unsigned numBytes,
+                        unsigned position)
+{
+    ASSERT(from != nullptr);
+    ASSERT(IsInline() && position + numBytes <= INLINE_SIZE);
+
+    memcpy(&raw.data[position], from, numBytes);
+}
+
+/// De-allocate all the space allocated for data blocks for this file, and
+/// for its index blocks.
 ///
 /// * `freeMap` is the bit map of free disk sectors.
 void
@@ -65,28 +407,235 @@ FileHeader::Deallocate(Bitmap *freeMap)
 {
     ASSERT(freeMap != nullptr);
 
-    for (unsigned i = 0; i < raw.numSectors; i++) {
-        ASSERT(freeMap->Test(raw.dataSectors[i]));  // ought to be marked!
-        freeMap->Clear(raw.dataSectors[i]);
+    for (unsigned i = 0; i < raw.numExtents; i++) {
+        const Extent *e = &extents[i];
+        for (unsigned j = 0; j < e->length && e->start != HOLE; j++) {
+            ASSERT(freeMap->Test(e->start + j));  // ought to be marked!
+            freeMap->Clear(e->start + j);
+        }
+    }
+    for (unsigned i = 0; i < NumIndexSectors(); i++) {
+        ASSERT(freeMap->Test(GetIndexSector(i)));
+        freeMap->Clear(GetIndexSector(i));
+    }
+}
+
+/// Move the data blocks of the file to `sectors`, one for each of them, in
+/// order.  Nothing is read or written: the blocks must be copied, and the
+/// header written, by the caller.  The file is left without index blocks,
+/// so the new sectors must make up no more than `NUM_DIRECT` runs.
+///
+/// * `sectors` is where each block of the file goes.
+void
+FileHeader::SetSectors(const unsigned *sectors)
+{
+    ASSERT(sectors != nullptr);
+    ASSERT(!IsInline());
+
+    unsigned numSectors = raw.numSectors;
+    delete [] extents;
+    delete [] sectorOf;
+    extents = new Extent [NUM_DIRECT];
+    raw.numExtents = 0;
+    for (unsigned i = 0; i < numSectors; i++) {
+        if (raw.numExtents > 0
+              && Follows(&extents[raw.numExtents - 1], sectors[i])) {
+            extents[raw.numExtents - 1].length++;
+            continue;
+        }
+        ASSERT(raw.numExtents < NUM_DIRECT);
+        extents[raw.numExtents].start  = sectors[i];
+        extents[raw.numExtents].length = 1;
+        raw.numExtents++;
+    }
+    raw.indirect       = 0;
+    raw.doublyIndirect = 0;
+    for (unsigned i = 0; i < raw.numExtents; i++) {
+        raw.extents[i] = extents[i];
     }
+    numWritten = raw.numExtents;
+    MapSectors();
 }
 
-/// Fetch contents of file header from disk.
+/// Fetch contents of file header from disk, along with its index blocks.
 ///
 /// * `sector` is the disk sector containing the file header.
 void
 FileHeader::FetchFrom(unsigned sector)
 {
+    Clear();
     synchDisk->ReadSector(sector, (char *) &raw);
+    ASSERT(raw.numExtents <= NUM_EXTENTS);
+
+    extents = new Extent [raw.numExtents];
+    Extent block[NUM_INDIRECT];
+    for (unsigned i = 0; i < raw.numExtents; i++) {
+        if (i < NUM_DIRECT) {
+            extents[i] = raw.extents[i];
+            continue;
+        }
+        unsigned k = (i - NUM_DIRECT) % NUM_INDIRECT;
+        if (k == 0) {
+            if (i == NUM_DIRECT + NUM_INDIRECT) {
+                synchDisk->ReadSector(raw.doublyIndirect,
+                                      (char *) doublyBlock);
+            }
+            unsigned index = (i - NUM_DIRECT) / NUM_INDIRECT;
+            synchDisk->ReadSector(index == 0 ? raw.indirect
+                                             : doublyBlock[index - 1],
+                                  (char *) block);
+        }
+        extents[i] = block[k];
+    }
+    numWritten = raw.numExtents;
+    MapSectors();
 }
 
-/// Write the modified contents of the file header back to disk.
+/// Write the modified contents of the file header back to disk, along with
+/// its index blocks, through the journal.
+///
+/// Extents are only ever added, or the last one made longer, so only the
+/// index blocks from the one with the last extent written before on are
+/// written, and the doubly indirect block only if it lists more of them.
 ///
 /// * `sector` is the disk sector to contain the file header.
 void
 FileHeader::WriteBack(unsigned sector)
 {
-    synchDisk->WriteSector(sector, (char *) &raw);
+    unsigned from = numWritten > 0 ? numWritten - 1 : 0;
+    Extent block[NUM_INDIRECT];
+    for (unsigned i = 0; i < raw.numExtents; i++) {
+        if (i < NUM_DIRECT) {
+            raw.extents[i] = extents[i];
+            continue;
+        }
+        unsigned k = (i - NUM_DIRECT) % NUM_INDIRECT;
+        block[k] = extents[i];
+        if ((k == NUM_INDIRECT - 1 || i == raw.numExtents - 1)
+              && i >= from) {
+            unsigned index = (i - NUM_DIRECT) / NUM_INDIRECT;
+            journal->WriteSector(index == 0 ? raw.indirect
+                                            : doublyBlock[index - 1],
+                                 (char *) block);
+        }
+    }
+    if (raw.numExtents > NUM_DIRECT + NUM_INDIRECT
+          && IndexSectorsFor(raw.numExtents) > IndexSectorsFor(numWritten)) {
+        journal->WriteSector(raw.doublyIndirect, (char *) doublyBlock);
+    }
+    journal->WriteSector(sector, (char *) &raw);
+    numWritten = raw.numExtents;
+}
+
+/// Whether sector `sector`, or a hole, goes right after the extent `e`.
+bool
+FileHeader::Follows(const Extent *e, unsigned sector)
+{
+    ASSERT(e != nullptr);
+
+    if (sector == HOLE || e->start == HOLE) {
+        return sector == e->start;
+    }
+    return e->start + e->length == sector;
+}
+
+unsigned
+FileHeader::NextSector(unsigned near) const
+{
+    for (unsigned i = raw.numExtents; i > 0; i--) {
+        const Extent *e = &extents[i - 1];
+        if (e->start != HOLE) {
+            return (e->start + e->length) % diskSectors;
+        }
+    }
+    return near;
+}
+
+/// The extents are made anew from `sectors`, and index blocks taken, or
+/// given back, so that there are as many as they need; nothing changes if
+/// there is no room for those.  Every index block is written on the next
+/// `WriteBack`, as extents may have changed anywhere.
+bool
+FileHeader::Remap(Bitmap *freeMap, const unsigned *sectors,
+                  unsigned numSectors, unsigned near)
+{
+    ASSERT(freeMap != nullptr);
+    ASSERT(sectors != nullptr && numSectors > 0);
+
+    Extent *remapped = new Extent [NUM_EXTENTS];
+    unsigned numExtents = 0;
+    for (unsigned i = 0; i < numSectors; i++) {
+        if (numExtents > 0 && Follows(&remapped[numExtents - 1], sectors[i])) {
+            remapped[numExtents - 1].length++;
+            continue;
+        }
+        if (numExtents == NUM_EXTENTS) {
+            delete [] remapped;
+            return false;  // Too scattered.
+        }
+        remapped[numExtents].start  = sectors[i];
+        remapped[numExtents].length = 1;
+        numExtents++;
+    }
+
+    unsigned oldIndex = IndexSectorsFor(raw.numExtents);
+    unsigned newIndex = IndexSectorsFor(numExtents);
+    unsigned index[NUM_DOUBLY_INDIRECT + 2];
+    for (unsigned i = 0; i < oldIndex; i++) {
+        index[i] = GetIndexSector(i);
+    }
+    unsigned from = near;
+    for (unsigned i = oldIndex; i < newIndex; i++) {
+        unsigned length;
+        int sector = freeMap->FindRun(from, 1, &length);
+        if (sector < 0) {
+            for (unsigned j = oldIndex; j < i; j++) {
+                freeMap->Clear(index[j]);
+            }
+            delete [] remapped;
+            return false;
+        }
+        freeMap->Mark(sector);
+        index[i] = sector;
+        from = sector;
+    }
+    for (unsigned i = newIndex; i < oldIndex; i++) {
+        journal->Revoke(index[i]);
+        freeMap->Clear(index[i]);
+    }
+
+    for (unsigned i = 0; i < newIndex; i++) {
+        if (i == 0) {
+            raw.indirect = index[i];
+        } else if (i == 1) {
+            raw.doublyIndirect = index[i];
+        } else {
+            doublyBlock[i - 2] = index[i];
+        }
+    }
+    delete [] extents;
+    delete [] sectorOf;
+    extents        = remapped;
+    raw.numExtents = numExtents;
+    raw.numSectors = numSectors;
+    numWritten     = 0;
+    MapSectors();
+    return true;
+}
+
+void
+FileHeader::MapSectors()
+{
+    sectorOf = new unsigned [raw.numSectors];
+    unsigned n = 0;
+    for (unsigned i = 0; i < raw.numExtents; i++) {
+        for (unsigned j = 0; j < extents[i].length; j++) {
+            ASSERT(n < raw.numSectors);
+            sectorOf[n++] = extents[i].start == HOLE ? HOLE
+                                                     : extents[i].start + j;
+        }
+    }
+    ASSERT(n == raw.numSectors);
 }
 
 /// Return which disk sector is storing a particular byte within the file.
@@ -98,7 +647,8 @@ FileHeader::WriteBack(unsigned sector)
 unsigned
 FileHeader::ByteToSector(unsigned offset)
 {
-    return raw.dataSectors[offset / SECTOR_SIZE];
+    ASSERT(!IsInline() && offset / SECTOR_SIZE < raw.numSectors);
+    return sectorOf[offset / SECTOR_SIZE];
 }
 
 /// Return the number of bytes in the file.
@@ -108,6 +658,20 @@ FileHeader::FileLength() const
     return raw.numBytes;
 }
 
+/// Print `numBytes` bytes of `data`, escaping those that are not printable.
+static void
+PrintBytes(const char *data, unsigned numBytes)
+{
+    for (unsigned j = 0; j < numBytes; j++) {
+        if (isprint(data[j])) {
+            printf("%c", data[j]);
+        } else {
+            printf("\\%X", (unsigned char) data[j]);
+        }
+    }
+    printf("\n");
+}
+
 /// Print the contents of the file header, and the contents of all the data
 /// blocks pointed to by the file header.
 void
@@ -122,25 +686,43 @@ FileHeader::Print(const char *title)
     }
 
     printf("    size: %u bytes\n"
-           "    block indexes: ",
+           "    extents: ",
            raw.numBytes);
 
-    for (unsigned i = 0; i < raw.numSectors; i++) {
-        printf("%u ", raw.dataSectors[i]);
+    for (unsigned i = 0; i < raw.numExtents; i++) {
+        if (extents[i].start == HOLE) {
+            printf("hole of %u ", extents[i].length);
+            continue;
+        }
+        printf("%u-%u ", extents[i].start,
+               extents[i].start + extents[i].length - 1);
     }
     printf("\n");
+    if (NumIndexSectors() > 0) {
+        printf("    index blocks: ");
+        for (unsigned i = 0; i < NumIndexSectors(); i++) {
+            printf("%u ", GetIndexSector(i));
+        }
+        printf("\n");
+    }
 
+    if (IsInline()) {
+        printf("    contents, in the header:\n");
+        PrintBytes(raw.data, raw.numBytes);
+    }
     for (unsigned i = 0, k = 0; i < raw.numSectors; i++) {
-        printf("    contents of block %u:\n", raw.dataSectors[i]);
-        synchDisk->ReadSector(raw.dataSectors[i], data);
-        for (unsigned j = 0; j < SECTOR_SIZE && k < raw.numBytes; j++, k++) {
-            if (isprint(data[j])) {
-                printf("%c", data[j]);
-            } else {
-                printf("\\%X", (unsigned char) data[j]);
-            }
+        unsigned sector = ByteToSector(i * SECTOR_SIZE);
+        if (sector == HOLE) {
+            printf("    contents of a hole:\n");
+            memset(data, 0, SECTOR_SIZE);
+        } else {
+            printf("    contents of block %u:\n", sector);
+            synchDisk->ReadSector(sector, data);
         }
-        printf("\n");
+        unsigned n = raw.numBytes - k < SECTOR_SIZE ? raw.numBytes - k
+                                                    : SECTOR_SIZE;
+        PrintBytes(data, n);
+        k += n;
     }
     delete [] data;
 }
@@ -150,3 +732,44 @@ FileHeader::GetRaw() const
 {
     return &raw;
 }
+
+const Extent *
+FileHeader::GetExtent(unsigned i) const
+{
+    ASSERT(i < raw.numExtents);
+    return &extents[i];
+}
+
+unsigned
+FileHeader::IndexSectorsFor(unsigned numExtents)
+{
+    if (numExtents <= NUM_DIRECT) {
+        return 0;
+    }
+    if (numExtents <= NUM_DIRECT + NUM_INDIRECT) {
+        return 1;
+    }
+    return 2 + DivRoundUp(numExtents - NUM_DIRECT - NUM_INDIRECT,
+                          NUM_INDIRECT);
+}
+
+unsigned
+FileHeader::NumIndexSectors() const
+{
+    return IndexSectorsFor(raw.numExtents);
+}
+
+/// The indirect block comes first, then the doubly indirect one, and then
+/// those it lists.
+unsigned
+FileHeader::GetIndexSector(unsigned i) const
+{
+    ASSERT(i < NumIndexSectors());
+    if (i == 0) {
+        return raw.indirect;
+    }
+    if (i == 1) {
+        return raw.doublyIndirect;
+    }
+    return doublyBlock[i - 2];
+}
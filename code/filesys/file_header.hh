@@ -19,28 +19,77 @@
 
 /// The following class defines the Nachos "file header" (in UNIX terms, the
 /// “i-node”), describing where on disk to find all of the data in the file.
-/// The file header is organized as a simple table of pointers to data
-/// blocks.
+/// The file header is organized as a table of extents: runs of consecutive
+/// data blocks, each given by its first block and its length.
 ///
 /// The file header data structure can be stored in memory or on disk.  When
 /// it is on disk, it is stored in a single sector -- this means that we
 /// assume the size of this data structure to be the same as one disk sector.
-/// Without indirect addressing, this limits the maximum file length to just
-/// under 4K bytes.
+/// Only the first `NUM_DIRECT` extents fit there; the rest are in index
+/// blocks: an indirect one, and those listed by a doubly indirect one.
 ///
-/// There is no constructor; rather the file header can be initialized
-/// by allocating blocks for the file (if it is a new file), or by
-/// reading it from disk.
+/// Index blocks are all read in along with the header, and every extent is
+/// kept in memory, as well as the sector of every block, so that
+/// `ByteToSector` takes no disk access, nor a search.
+///
+/// A file with no extents has its data, up to `INLINE_SIZE` bytes, in the
+/// header instead, read and written with `ReadInline` and `WriteInline`.
+///
+/// The file header can be initialized by allocating blocks for the file (if
+/// it is a new file), or by reading it from disk.
 class FileHeader {
 public:
 
+    FileHeader();
+    ~FileHeader();
+
+    /// Headers come from a slab of their own (see `lib/slab.hh`).
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     /// Initialize a file header, including allocating space on disk for the
-    /// file data.
-    bool Allocate(Bitmap *bitMap, unsigned fileSize);
+    /// file data, as close after `near` as possible, unless `sparse`.
+    bool Allocate(Bitmap *bitMap, unsigned fileSize, unsigned near,
+                  bool sparse = false);
+
+    /// Allocate more space on disk, so that the file has room for
+    /// `numBytes` bytes; its length stays as it is.  Return false, taking
+    /// nothing, if there is not enough.
+    bool Extend(Bitmap *bitMap, unsigned numBytes, unsigned near);
+
+    /// Make room in the file for `numBytes` bytes, as it is done by
+    /// `Extend`, but with holes instead of blocks.
+    bool ExtendSparse(Bitmap *bitMap, unsigned numBytes, unsigned near);
+
+    /// Take a sector for every hole among blocks `first` to `last`, or
+    /// give back the sectors of those blocks, which become holes.  Return
+    /// false, changing nothing, if there is not enough room.
+    bool FillHoles(Bitmap *bitMap, unsigned first, unsigned last,
+                   unsigned near);
+    bool PunchHoles(Bitmap *bitMap, unsigned first, unsigned last,
+                    unsigned near);
+
+    /// Set the length of the file, which must fit in the space allocated.
+    void SetLength(unsigned numBytes);
+
+    /// Return how many bytes fit in the space allocated for the file.
+    unsigned AllocatedLength() const;
+
+    /// Whether the data of the file is kept in the header.
+    bool IsInline() const;
+
+    /// Read/write `numBytes` bytes at `position` of a file kept in the
+    /// header.  Writes are only in memory until `WriteBack`.
+    void ReadInline(char *into, unsigned numBytes, unsigned position) const;
+    void WriteInline(const char *from, unsigned numBytes, unsigned position);
 
     /// De-allocate this file's data blocks.
     void Deallocate(Bitmap *bitMap);
 
+    /// Place the file's data blocks at `sectors` instead, which must take
+    /// no index blocks.
+    void SetSectors(const unsigned *sectors);
+
     /// Initialize file header from disk.
     void FetchFrom(unsigned sectorNumber);
 
@@ -48,7 +97,7 @@ public:
     void WriteBack(unsigned sectorNumber);
 
     /// Convert a byte offset into the file to the disk sector containing the
-    /// byte.
+    /// byte, or `HOLE`.
     unsigned ByteToSector(unsigned offset);
 
     /// Return the length of the file in bytes
@@ -63,8 +112,48 @@ public:
     /// system at a low level.
     const RawFileHeader *GetRaw() const;
 
+    /// Get extent `i` of the file, of `GetRaw()->numExtents`, wherever it
+    /// is kept on disk.
+    const Extent *GetExtent(unsigned i) const;
+
+    /// Return the number of index blocks, and each of them.
+    unsigned NumIndexSectors() const;
+    unsigned GetIndexSector(unsigned i) const;
+
 private:
+
+    /// Number of index blocks needed for `numExtents` extents.
+    static unsigned IndexSectorsFor(unsigned numExtents);
+
+    /// Whether `sector` goes right after extent `e`, in the same extent.
+    static bool Follows(const Extent *e, unsigned sector);
+
+    /// Where the next blocks of the file are first looked for.
+    unsigned NextSector(unsigned near) const;
+
+    /// Make `sectors`, with `HOLE` for holes, the blocks of the file.
+    bool Remap(Bitmap *bitMap, const unsigned *sectors, unsigned numSectors,
+               unsigned near);
+
+    /// Fill in `sectorOf` from `extents`.
+    void MapSectors();
+
+    /// Forget about the blocks of the file.
+    void Clear();
+
     RawFileHeader raw;
+
+    /// Every extent of the file, `raw.numExtents` of them.
+    Extent *extents;
+
+    /// Contents of the doubly indirect block: the index blocks it lists.
+    unsigned doublyBlock[NUM_DOUBLY_INDIRECT];
+
+    /// Sector of every block of the file, `raw.numSectors` of them.
+    unsigned *sectorOf;
+
+    /// Number of extents when the header was last read or written.
+    unsigned numWritten;
 };
 
 
@@ -5,36 +5,53 @@
 /// * a file header, stored in a sector on disk (the size of the file header
 ///   data structure is arranged to be precisely the size of 1 disk sector);
 /// * a number of data blocks;
-/// * an entry in the file system directory.
+/// * an entry in a directory of the file system.
 ///
 /// The file system consists of several data structures:
 /// * A bitmap of free disk sectors (cf. `bitmap.h`).
-/// * A directory of file names and file headers.
+/// * A root directory of file names and file headers, some of which may be
+///   directories in turn.
 ///
-/// Both the bitmap and the directory are represented as normal files.  Their
-/// file headers are located in specific sectors (sector 0 and sector 1), so
-/// that the file system can find them on bootup.
+/// Both the bitmap and the root directory are represented as normal files.
+/// Their file headers are located in specific sectors (sector 0 and sector
+/// 1), so that the file system can find them on bootup.  Other directories
+/// are files like any other, found through the directory they are in.  So
+/// is the journal (cf. `journal.hh`), with its header at sector 2, in
+/// consecutive sectors taken when formatting.
+/// Sector 3 holds the map of the regions where metadata changed since the
+/// last check (cf. `dirty_map.hh`), so that a check may look at just those.
+///
+/// Paths are looked up one component at a time, from the root; what each
+/// name stands for in each directory, or that it is not there, is kept in a
+/// `DentryCache`, so that directories along paths used again are not read
+/// again.
 ///
 /// The file system assumes that the bitmap and directory files are kept
 /// “open” continuously while Nachos is running.
 ///
+/// The bitmap and the root directory are also kept in memory, so that
+/// operations on them do not read them from the disk every time.
+///
 /// For those operations (such as `Create`, `Remove`) that modify the
 /// directory and/or bitmap, if the operation succeeds, the changes are
 /// written immediately back to disk (the two files are kept open during all
-/// this time).  If the operation fails, and we have modified part of the
-/// directory and/or bitmap, we simply discard the changed version, without
-/// writing it back to disk.
+/// this time), although only the sectors changed, and through the journal,
+/// so that they reach the disk all of them or none.  If the operation fails,
+/// and we have modified part of the directory and/or bitmap, we simply
+/// discard the changed version, reading back what is on disk.
+///
+/// Directories are kept under one reader/writer lock, and the bitmap under a
+/// lock of its own, taken after the former when both are needed; the
+/// contents of each file are under yet another lock, in its inode (cf.
+/// `inode_table.hh`).  So threads reading and writing different files only
+/// meet at the disk queue, and at the bitmap when their files grow.
 ///
 /// Our implementation at this point has the following restrictions:
 ///
-/// * there is no synchronization for concurrent accesses;
-/// * files have a fixed size, set when the file is created;
-/// * files cannot be bigger than about 3KB in size;
-/// * there is no hierarchical directory structure, and only a limited number
-///   of files can be added to the system;
-/// * there is no attempt to make the system robust to failures (if Nachos
-///   exits in the middle of an operation that modifies the file system, it
-///   may corrupt the disk).
+/// * only a limited number of files can be added to each directory;
+/// * only the metadata is journaled: if Nachos exits in the middle of
+///   writing a file, some of what was written may be lost, although the
+///   file system stays consistent.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -43,19 +60,41 @@
 
 
 #include "file_system.hh"
+#include "threads/rw_lock.hh"
+#include "dentry_cache.hh"
 #include "directory.hh"
 #include "file_header.hh"
 #include "lib/bitmap.hh"
+#include "threads/system.hh"
 
 #include <stdio.h>
 #include <string.h>
 
 
-/// Sectors containing the file headers for the bitmap of free sectors, and
-/// the directory of files.  These file headers are placed in well-known
-/// sectors, so that they can be located on boot-up.
+/// Sectors containing the file headers for the bitmap of free sectors, the
+/// directory of files, and the journal, and the map of the regions changed
+/// since the last check (cf. `dirty_map.hh`).  These are placed in
+/// well-known sectors, so that they can be located on boot-up.
 static const unsigned FREE_MAP_SECTOR = 0;
 static const unsigned DIRECTORY_SECTOR = 1;
+static const unsigned JOURNAL_SECTOR = 2;
+static const unsigned DIRTY_MAP_SECTOR = 3;
+
+/// Threads that read file headers at once during a check.
+static const unsigned CHECK_WORKERS = 4;
+
+/// Start using the journal whose header is `jrnH`.
+static void
+OpenJournal(const FileHeader *jrnH, bool format)
+{
+    ASSERT(jrnH != nullptr);
+
+    // The journal is written a group at a time, so its sectors must follow
+    // each other.
+    ASSERT(jrnH->GetRaw()->numExtents == 1);
+    const Extent *e = jrnH->GetExtent(0);
+    journal->Open(e->start, e->length, format);
+}
 
 /// Initialize the file system.  If `format == true`, the disk has nothing on
 /// it, and we need to initialize the disk to contain an empty directory, and
@@ -63,17 +102,24 @@ static const unsigned DIRECTORY_SECTOR = 1;
 /// as free).
 ///
 /// If `format == false`, we just have to open the files representing the
-/// bitmap and the directory.
+/// bitmap and the directory, once the journal is recovered.
 ///
 /// * `format` -- should we initialize the disk?
 FileSystem::FileSystem(bool format)
 {
     DEBUG('f', "Initializing the file system.\n");
+    lock = new RWLock("file system");
+    freeMapLock = new Lock("free map");
+    dentries = new DentryCache;
+    freeMap       = new Bitmap(diskSectors);
+    rootDirectory = new Directory(NUM_DIR_ENTRIES);
+
+    // The dirty map goes first, so that it sees every metadata write.
+    dirtyMap->Open(DIRTY_MAP_SECTOR, format);
     if (format) {
-        Bitmap     *freeMap = new Bitmap(NUM_SECTORS);
-        Directory  *dir     = new Directory(NUM_DIR_ENTRIES);
         FileHeader *mapH    = new FileHeader;
         FileHeader *dirH    = new FileHeader;
+        FileHeader *jrnH    = new FileHeader;
 
         DEBUG('f', "Formatting the file system.\n");
 
@@ -81,12 +127,18 @@ FileSystem::FileSystem(bool format)
         // (make sure no one else grabs these!)
         freeMap->Mark(FREE_MAP_SECTOR);
         freeMap->Mark(DIRECTORY_SECTOR);
+        freeMap->Mark(JOURNAL_SECTOR);
+        freeMap->Mark(DIRTY_MAP_SECTOR);
 
         // Second, allocate space for the data blocks containing the contents
-        // of the directory and bitmap files.  There better be enough space!
+        // of the directory and bitmap files, and the journal.  There better
+        // be enough space!
 
-        ASSERT(mapH->Allocate(freeMap, FREE_MAP_FILE_SIZE));
-        ASSERT(dirH->Allocate(freeMap, DIRECTORY_FILE_SIZE));
+        ASSERT(jrnH->Allocate(freeMap,
+                              Journal::NUM_JOURNAL_SECTORS * SECTOR_SIZE,
+                              JOURNAL_SECTOR));
+        ASSERT(mapH->Allocate(freeMap, FreeMapFileSize(), FREE_MAP_SECTOR));
+        ASSERT(dirH->Allocate(freeMap, DIRECTORY_FILE_SIZE, DIRECTORY_SECTOR));
 
         // Flush the bitmap and directory `FileHeader`s back to disk.
         // We need to do this before we can `Open` the file, since open reads
@@ -96,13 +148,14 @@ FileSystem::FileSystem(bool format)
         DEBUG('f', "Writing headers back to disk.\n");
         mapH->WriteBack(FREE_MAP_SECTOR);
         dirH->WriteBack(DIRECTORY_SECTOR);
+        jrnH->WriteBack(JOURNAL_SECTOR);
 
         // OK to open the bitmap and directory files now.
         // The file system operations assume these two files are left open
         // while Nachos is running.
 
-        freeMapFile   = new OpenFile(FREE_MAP_SECTOR);
-        directoryFile = new OpenFile(DIRECTORY_SECTOR);
+        freeMapFile   = new OpenFile(FREE_MAP_SECTOR, true);
+        directoryFile = new OpenFile(DIRECTORY_SECTOR, true);
 
         // Once we have the files “open”, we can write the initial version of
         // each file back to disk.  The directory at this point is completely
@@ -112,175 +165,611 @@ FileSystem::FileSystem(bool format)
 
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
         freeMap->WriteBack(freeMapFile);     // flush changes to disk
-        dir->WriteBack(directoryFile);
+        rootDirectory->WriteBack(directoryFile);
 
-        if (debug.IsEnabled('f')) {
-            freeMap->Print();
-            dir->Print();
+        // The journal is started last, as what is written while formatting
+        // is not journaled.
+        OpenJournal(jrnH, true);
 
-            delete freeMap;
-            delete dir;
-            delete mapH;
-            delete dirH;
+        if (debug.IsEnabled('f')) {
+            freeMapLock->Acquire();
+    freeMap->Print();
+    freeMapLock->Release();
+            rootDirectory->Print();
         }
+        delete mapH;
+        delete dirH;
+        delete jrnH;
     } else {
+        // The journal is redone first, so that what is read next is as the
+        // last operations committed left it.
+        FileHeader *jrnH = new FileHeader;
+        jrnH->FetchFrom(JOURNAL_SECTOR);
+        OpenJournal(jrnH, false);
+        delete jrnH;
+
         // If we are not formatting the disk, just open the files
-        // representing the bitmap and directory; these are left open while
-        // Nachos is running.
-        freeMapFile   = new OpenFile(FREE_MAP_SECTOR);
-        directoryFile = new OpenFile(DIRECTORY_SECTOR);
+        // representing the bitmap and directory, and read them; these are
+        // left open, and in memory, while Nachos is running.
+        freeMapFile   = new OpenFile(FREE_MAP_SECTOR, true);
+        directoryFile = new OpenFile(DIRECTORY_SECTOR, true);
+        freeMap->FetchFrom(freeMapFile);
+        rootDirectory->FetchFrom(directoryFile);
     }
 }
 
 FileSystem::~FileSystem()
 {
+    delete freeMap;
+    delete rootDirectory;
     delete freeMapFile;
     delete directoryFile;
+    delete dentries;
+    delete freeMapLock;
+    delete lock;
+}
+
+/// Copy the next component of `*path` into `name`, and advance `*path`
+/// past it.  Return false if there is none, or if it is too long.
+static bool
+NextComponent(const char **path, char *name)
+{
+    const char *p = *path;
+    while (*p == '/') {
+        p++;
+    }
+    unsigned length = 0;
+    while (p[length] != '/' && p[length] != '\0') {
+        length++;
+    }
+    if (length == 0 || length > FILE_NAME_MAX_LEN) {
+        return false;
+    }
+    memcpy(name, p, length);
+    name[length] = '\0';
+    *path = p + length;
+    return true;
+}
+
+/// Whether nothing but slashes is left of `path`.
+static bool
+IsLast(const char *path)
+{
+    while (*path == '/') {
+        path++;
+    }
+    return *path == '\0';
+}
+
+Directory *
+FileSystem::OpenDirectory(unsigned sector, OpenFile **file)
+{
+    ASSERT(file != nullptr);
+
+    if (sector == DIRECTORY_SECTOR) {
+        *file = directoryFile;
+        return rootDirectory;
+    }
+    *file = new OpenFile(sector, true);
+    Directory *dir = new Directory(NUM_DIR_ENTRIES);
+    dir->FetchFrom(*file);
+    return dir;
+}
+
+void
+FileSystem::CloseDirectory(Directory *dir, OpenFile *file)
+{
+    if (dir != rootDirectory) {
+        delete dir;
+        delete file;
+    }
+}
+
+/// The directory is read only if the dentry cache knows nothing of `name`
+/// in it; what is found, or not, is cached.
+///
+/// The file system lock must be held, at least for reading.
+int
+FileSystem::LookupIn(unsigned dirSector, const char *name, bool *isDirectory)
+{
+    int sector;
+    if (dentries->Lookup(dirSector, name, &sector, isDirectory)) {
+        return sector;
+    }
+
+    OpenFile  *dirFile;
+    Directory *dir = OpenDirectory(dirSector, &dirFile);
+    *isDirectory = false;
+    sector = dir->Find(name, isDirectory);
+    CloseDirectory(dir, dirFile);
+
+    dentries->Insert(dirSector, name, sector, *isDirectory);
+    return sector;
+}
+
+/// The file system lock must be held, at least for reading.
+int
+FileSystem::FindParent(const char *path, char *name)
+{
+    ASSERT(path != nullptr);
+    ASSERT(name != nullptr);
+
+    unsigned dirSector = DIRECTORY_SECTOR;
+    if (!NextComponent(&path, name)) {
+        return -1;
+    }
+    while (!IsLast(path)) {
+        bool isDirectory;
+        int sector = LookupIn(dirSector, name, &isDirectory);
+        if (sector == -1 || !isDirectory) {
+            return -1;
+        }
+        dirSector = sector;
+        if (!NextComponent(&path, name)) {
+            return -1;
+        }
+    }
+    return dirSector;
 }
 
 /// Create a file in the Nachos file system (similar to UNIX `create`).
-/// Since we cannot increase the size of files dynamically, we have to give
-/// `Create` the initial size of the file.
+/// The file starts with `initialSize` bytes, which are a hole: they read as
+/// zeros, and take no sectors until written.  It grows as it is written
+/// past its end.
+///
+/// Return true if everything goes ok, otherwise, return false.
+///
+/// * `name` is the path of the file to be created.
+/// * `initialSize` is the size of file to be created.
+bool
+FileSystem::Create(const char *name, unsigned initialSize)
+{
+    ASSERT(name != nullptr);
+    ASSERT(initialSize < MaxFileSize());
+
+    DEBUG('f', "Creating file %s, size %u\n", name, initialSize);
+    return CreateEntry(name, initialSize, false);
+}
+
+/// Create an empty directory in the Nachos file system (similar to UNIX
+/// `mkdir`).  It has room for `NUM_DIR_ENTRIES` files.
+///
+/// Return true if everything goes ok, otherwise, return false.
 ///
+/// * `name` is the path of the directory to be created.
+bool
+FileSystem::MakeDirectory(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    DEBUG('f', "Creating directory %s\n", name);
+    return CreateEntry(name, DIRECTORY_FILE_SIZE, true);
+}
+
+/// Return the number of free sectors in allocation group `group`, of
+/// `groupSectors` sectors, and set `*begin` and `*end` to its first sector
+/// and the one past its last.
+static unsigned
+GroupFree(const Bitmap *freeMap, unsigned group, unsigned groupSectors,
+          unsigned *begin, unsigned *end)
+{
+    *begin = group * groupSectors;
+    *end   = *begin + groupSectors < diskSectors ? *begin + groupSectors
+                                                 : diskSectors;
+    return freeMap->CountClear(*begin, *end);
+}
+
+/// Within the group, the header goes in the first free sector after the
+/// directory's, if it is there, or else in the first free one; if the
+/// group is full after all, anywhere.
+int
+FileSystem::AllocateHeader(unsigned dirSector, unsigned numSectors,
+                           bool isDirectory)
+{
+    const unsigned groupSectors = GROUP_TRACKS * SECTORS_PER_TRACK;
+    unsigned numGroups = DivRoundUp(diskSectors, groupSectors);
+    unsigned dirGroup  = dirSector / groupSectors;
+
+    unsigned begin, end;
+    unsigned dirFree = GroupFree(freeMap, dirGroup, groupSectors,
+                                 &begin, &end);
+    unsigned group = dirGroup;
+    if (dirFree < (isDirectory ? groupSectors / 4 : numSectors + 1)) {
+        // The nearest group with at least as much room as the average.
+        unsigned average = freeMap->CountClear() / numGroups;
+        for (unsigned d = 1; d < numGroups; d++) {
+            if (dirGroup + d < numGroups
+                  && GroupFree(freeMap, dirGroup + d, groupSectors,
+                               &begin, &end) >= average) {
+                group = dirGroup + d;
+                break;
+            }
+            if (d <= dirGroup
+                  && GroupFree(freeMap, dirGroup - d, groupSectors,
+                               &begin, &end) >= average) {
+                group = dirGroup - d;
+                break;
+            }
+        }
+    }
+
+    GroupFree(freeMap, group, groupSectors, &begin, &end);
+    int sector = -1;
+    if (group == dirGroup) {
+        sector = freeMap->Find(dirSector + 1, end);
+    }
+    if (sector == -1) {
+        sector = freeMap->Find(begin, end);
+    }
+    if (sector == -1) {
+        sector = freeMap->Find();
+    }
+    DEBUG('f', "Header of a new %s in sector %d, group %u\n",
+          isDirectory ? "directory" : "file", sector, group);
+    return sector;
+}
+
 /// The steps to create a file are:
-/// 1. Make sure the file does not already exist.
+/// 1. Find the directory to hold it, and make sure the file does not
+///    already exist there.
 /// 2. Allocate a sector for the file header.
 /// 3. Allocate space on disk for the data blocks for the file.
 /// 4. Add the name to the directory.
-/// 5. Store the new file header on disk.
+/// 5. Store the new file header on disk, and an empty directory in the
+///    file, if it is one.
 /// 6. Flush the changes to the bitmap and the directory back to disk.
 ///
-/// Return true if everything goes ok, otherwise, return false.
+/// All of it is one operation for the journal.
 ///
-/// Create fails if:
+/// Creation fails if:
+/// * some directory along `path` does not exist;
 /// * file is already in directory;
 /// * no free space for file header;
 /// * no free entry for file in directory;
 /// * no free space for data blocks for the file.
-///
-/// Note that this implementation assumes there is no concurrent access to
-/// the file system!
-///
-/// * `name` is the name of file to be created.
-/// * `initialSize` is the size of file to be created.
 bool
-FileSystem::Create(const char *name, unsigned initialSize)
+FileSystem::CreateEntry(const char *path, unsigned initialSize,
+                        bool isDirectory)
 {
-    ASSERT(name != nullptr);
-    ASSERT(initialSize < MAX_FILE_SIZE);
-
-    DEBUG('f', "Creating file %s, size %u\n", name, initialSize);
+    char name[FILE_NAME_MAX_LEN + 1];
+
+    journal->Begin();
+    lock->AcquireWrite();
+    int dirSector = FindParent(path, name);
+    if (dirSector == -1) {
+        lock->ReleaseWrite();
+        journal->End();
+        return false;
+    }
 
-    Directory *dir = new Directory(NUM_DIR_ENTRIES);
-    dir->FetchFrom(directoryFile);
+    OpenFile  *dirFile;
+    Directory *dir = OpenDirectory(dirSector, &dirFile);
 
     bool success;
 
     if (dir->Find(name) != -1) {
         success = false;  // File is already in directory.
     } else {
-        Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-        freeMap->FetchFrom(freeMapFile);
-        int sector = freeMap->Find();
+        freeMapLock->Acquire();
+        int sector = AllocateHeader(dirSector,
+                                    DivRoundUp(initialSize, SECTOR_SIZE),
+                                    isDirectory);
           // Find a sector to hold the file header.
         if (sector == -1) {
             success = false;  // No free block for file header.
-        } else if (!dir->Add(name, sector)) {
+        } else if (!dir->Add(name, sector, isDirectory)) {
             success = false;  // No space in directory.
         } else {
             FileHeader *h = new FileHeader;
-            success = h->Allocate(freeMap, initialSize);
-              // Fails if no space on disk for data.
+            success = h->Allocate(freeMap, initialSize, sector,
+                                  !isDirectory);
+              // Fails if no space on disk for data, or for index blocks.
             if (success) {
                 // Everything worked, flush all changes back to disk.
                 h->WriteBack(sector);
-                dir->WriteBack(directoryFile);
+                if (isDirectory) {
+                    OpenFile  *subFile = new OpenFile(sector, true);
+                    Directory *sub     = new Directory(NUM_DIR_ENTRIES);
+                    sub->WriteBack(subFile);
+                    delete sub;
+                    delete subFile;
+                }
+                dir->WriteBack(dirFile);
                 freeMap->WriteBack(freeMapFile);
+                dentries->Insert(dirSector, name, sector, isDirectory);
             }
             delete h;
         }
-        delete freeMap;
+        if (!success) {
+            // Discard the changes made to what is kept in memory.
+            freeMap->FetchFrom(freeMapFile);
+            if (dir == rootDirectory) {
+                rootDirectory->FetchFrom(directoryFile);
+            }
+        }
+        freeMapLock->Release();
     }
-    delete dir;
+    CloseDirectory(dir, dirFile);
+    lock->ReleaseWrite();
+    journal->End();
     return success;
 }
 
 /// Open a file for reading and writing.
 ///
 /// To open a file:
-/// 1. Find the location of the file's header, using the directory.
+/// 1. Find the location of the file's header, going down the directories
+///    along its path.
 /// 2. Bring the header into memory.
 ///
-/// * `name` is the text name of the file to be opened.
+/// * `name` is the path of the file to be opened.
 OpenFile *
 FileSystem::Open(const char *name)
 {
     ASSERT(name != nullptr);
 
-    Directory *dir = new Directory(NUM_DIR_ENTRIES);
-    OpenFile  *openFile = nullptr;
+    char component[FILE_NAME_MAX_LEN + 1];
+    OpenFile *openFile = nullptr;
 
     DEBUG('f', "Opening file %s\n", name);
-    dir->FetchFrom(directoryFile);
-    int sector = dir->Find(name);
-    if (sector >= 0) {
-        openFile = new OpenFile(sector);  // `name` was found in directory.
+    lock->AcquireRead();
+    int dirSector = FindParent(name, component);
+    if (dirSector != -1) {
+        bool isDirectory;
+        int sector = LookupIn(dirSector, component, &isDirectory);
+        if (sector >= 0 && !isDirectory) {
+            openFile = new OpenFile(sector);  // `name` was found.
+        }
     }
-    delete dir;
+    lock->ReleaseRead();
     return openFile;  // Return null if not found.
 }
 
+/// The file system lock must be held, at least for reading.
+int
+FileSystem::FindEntry(const char *path, bool *isDirectory)
+{
+    ASSERT(path != nullptr);
+    ASSERT(isDirectory != nullptr);
+
+    if (IsLast(path)) {
+        *isDirectory = true;
+        return DIRECTORY_SECTOR;
+    }
+    char component[FILE_NAME_MAX_LEN + 1];
+    int dirSector = FindParent(path, component);
+    if (dirSector == -1) {
+        return -1;
+    }
+    return LookupIn(dirSector, component, isDirectory);
+}
+
+/// The length is that of the header shared by those who have the file
+/// open, so that what they wrote counts, even if not on disk yet.
+bool
+FileSystem::Stat(const char *path, bool *isDirectory, unsigned *length)
+{
+    ASSERT(isDirectory != nullptr);
+    ASSERT(length != nullptr);
+
+    lock->AcquireRead();
+    int sector = FindEntry(path, isDirectory);
+    if (sector != -1) {
+        Inode *inode = inodeTable->Acquire(sector);
+        *length = inode->hdr->FileLength();
+        inodeTable->Release(inode);
+    }
+    lock->ReleaseRead();
+    return sector != -1;
+}
+
+/// Lengths come from the header shared by those who have each file open,
+/// like in `Stat`, and otherwise from the header read through the disk
+/// cache, so that listing a directory with its lengths takes one call.
+int
+FileSystem::ReadDirectory(const char *path, DirectoryEntry *entries,
+                          unsigned count, unsigned *lengths)
+{
+    ASSERT(entries != nullptr);
+
+    lock->AcquireRead();
+    bool isDirectory;
+    int sector = FindEntry(path, &isDirectory);
+    if (sector == -1 || !isDirectory) {
+        lock->ReleaseRead();
+        return -1;
+    }
+    OpenFile  *dirFile;
+    Directory *dir = OpenDirectory(sector, &dirFile);
+    const RawDirectory *rd = dir->GetRaw();
+    unsigned found = 0;
+    for (unsigned i = 0; i < rd->tableSize && found < count; i++) {
+        if (!rd->table[i].inUse) {
+            continue;
+        }
+        if (lengths != nullptr) {
+            Inode *inode = inodeTable->Acquire(rd->table[i].sector);
+            lengths[found] = inode->hdr->FileLength();
+            inodeTable->Release(inode);
+        }
+        entries[found++] = rd->table[i];
+    }
+    CloseDirectory(dir, dirFile);
+    lock->ReleaseRead();
+    return found;
+}
+
+/// Tell the journal that the sectors of the file whose header is `hdr`,
+/// kept at `sector`, are to be freed: the header, the index blocks and the
+/// data, which is metadata for a directory, and was for a file moved out of
+/// its header.
+static void
+RevokeSectors(const FileHeader *hdr, unsigned sector)
+{
+    ASSERT(hdr != nullptr);
+
+    journal->Revoke(sector);
+    for (unsigned i = 0; i < hdr->NumIndexSectors(); i++) {
+        journal->Revoke(hdr->GetIndexSector(i));
+    }
+    for (unsigned i = 0; i < hdr->GetRaw()->numExtents; i++) {
+        const Extent *e = hdr->GetExtent(i);
+        for (unsigned j = 0; j < e->length && e->start != HOLE; j++) {
+            journal->Revoke(e->start + j);
+        }
+    }
+}
+
 /// Delete a file from the file system.
 ///
 /// This requires:
-/// 1. Remove it from the directory.
+/// 1. Remove it from its directory.
 /// 2. Delete the space for its header.
 /// 3. Delete the space for its data blocks.
 /// 4. Write changes to directory, bitmap back to disk.
 ///
 /// Return true if the file was deleted, false if the file was not in the
-/// file system.
+/// file system, or if it is a directory that is not empty.
 ///
-/// * `name` is the text name of the file to be removed.
+/// * `name` is the path of the file to be removed.
 bool
 FileSystem::Remove(const char *name)
 {
     ASSERT(name != nullptr);
 
-    Directory *dir = new Directory(NUM_DIR_ENTRIES);
-    dir->FetchFrom(directoryFile);
-    int sector = dir->Find(name);
-    if (sector == -1) {
-       delete dir;
-       return false;  // file not found
+    char component[FILE_NAME_MAX_LEN + 1];
+
+    journal->Begin();
+    lock->AcquireWrite();
+    int dirSector = FindParent(name, component);
+    if (dirSector == -1) {
+        lock->ReleaseWrite();
+        journal->End();
+        return false;  // Some directory on the way is not there.
+    }
+    OpenFile  *dirFile;
+    Directory *dir = OpenDirectory(dirSector, &dirFile);
+    bool isDirectory;
+    int sector = dir->Find(component, &isDirectory);
+    bool removable = sector != -1;
+    if (removable && isDirectory) {
+        OpenFile  *subFile = new OpenFile(sector, true);
+        Directory *sub     = new Directory(NUM_DIR_ENTRIES);
+        sub->FetchFrom(subFile);
+        removable = sub->IsEmpty();
+        delete sub;
+        delete subFile;
+    }
+    if (!removable) {
+       CloseDirectory(dir, dirFile);
+       lock->ReleaseWrite();
+       journal->End();
+       return false;  // file not found, or directory not empty
     }
     FileHeader *fileH = new FileHeader;
     fileH->FetchFrom(sector);
+    RevokeSectors(fileH, sector);
 
-    Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-    freeMap->FetchFrom(freeMapFile);
-
+    freeMapLock->Acquire();
     fileH->Deallocate(freeMap);  // Remove data blocks.
     freeMap->Clear(sector);      // Remove header block.
-    dir->Remove(name);
-
     freeMap->WriteBack(freeMapFile);  // Flush to disk.
-    dir->WriteBack(directoryFile);    // Flush to disk.
+    freeMapLock->Release();
+
+    dir->Remove(component);
+    dir->WriteBack(dirFile);          // Flush to disk.
+    inodeTable->Forget(sector);
+    pageCache->ForgetFile(sector);
+    dentries->Insert(dirSector, component, -1, false);
+    if (isDirectory) {
+        dentries->ForgetDirectory(sector);
+    }
     delete fileH;
-    delete dir;
-    delete freeMap;
+    CloseDirectory(dir, dirFile);
+    lock->ReleaseWrite();
+    journal->End();
+#ifdef USER_PROGRAM
+    InvalidateImage(name, sector);
+#endif
     return true;
 }
 
-/// List all the files in the file system directory.
+/// Take room for `numBytes` bytes of the file whose header is `hdr`, kept
+/// at `headerSector`, out of the free map, and write the free map back.  The
+/// header is left for the caller to write back, along with the new length of
+/// the file.
+///
+/// The caller must hold the lock of the file, but not that of the
+/// directories: files grow while other threads look names up.  It must be
+/// within an operation of the journal.
+bool
+FileSystem::Extend(FileHeader *hdr, unsigned headerSector, unsigned numBytes)
+{
+    ASSERT(hdr != nullptr);
+
+    freeMapLock->Acquire();
+    bool success = hdr->Extend(freeMap, numBytes, headerSector);
+    if (success) {
+        freeMap->WriteBack(freeMapFile);
+    }
+    freeMapLock->Release();
+    return success;
+}
+
+bool
+FileSystem::ExtendSparse(FileHeader *hdr, unsigned headerSector,
+                         unsigned numBytes)
+{
+    ASSERT(hdr != nullptr);
+
+    freeMapLock->Acquire();
+    bool success = hdr->ExtendSparse(freeMap, numBytes, headerSector);
+    if (success) {
+        freeMap->WriteBack(freeMapFile);
+    }
+    freeMapLock->Release();
+    return success;
+}
+
+/// Sectors for the holes of a file, or those given back, are taken out of
+/// the free map, or put back, as those by `Extend`.
+bool
+FileSystem::FillHoles(FileHeader *hdr, unsigned headerSector,
+                      unsigned first, unsigned last)
+{
+    ASSERT(hdr != nullptr);
+
+    freeMapLock->Acquire();
+    bool success = hdr->FillHoles(freeMap, first, last, headerSector);
+    if (success) {
+        freeMap->WriteBack(freeMapFile);
+    }
+    freeMapLock->Release();
+    return success;
+}
+
+bool
+FileSystem::PunchHoles(FileHeader *hdr, unsigned headerSector,
+                       unsigned first, unsigned last)
+{
+    ASSERT(hdr != nullptr);
+
+    freeMapLock->Acquire();
+    bool success = hdr->PunchHoles(freeMap, first, last, headerSector);
+    if (success) {
+        freeMap->WriteBack(freeMapFile);
+    }
+    freeMapLock->Release();
+    return success;
+}
+
+/// List all the files in the root directory.
 void
 FileSystem::List()
 {
-    Directory *dir = new Directory(NUM_DIR_ENTRIES);
-
-    dir->FetchFrom(directoryFile);
-    dir->List();
-    delete dir;
+    lock->AcquireRead();
+    rootDirectory->List();
+    lock->ReleaseRead();
 }
 
 static bool
@@ -309,7 +798,7 @@ CheckForError(bool value, const char *message)
 static bool
 CheckSector(unsigned sector, Bitmap *shadowMap)
 {
-    if (CheckForError(sector < NUM_SECTORS,
+    if (CheckForError(sector < diskSectors,
                       "sector number too big.  Skipping bitmap check.")) {
         return true;
     }
@@ -318,22 +807,35 @@ CheckSector(unsigned sector, Bitmap *shadowMap)
 }
 
 static bool
-CheckFileHeader(const RawFileHeader *rh, unsigned num, Bitmap *shadowMap)
+CheckFileHeader(const FileHeader *h, unsigned num, Bitmap *shadowMap)
 {
-    ASSERT(rh != nullptr);
+    ASSERT(h != nullptr);
 
+    const RawFileHeader *rh = h->GetRaw();
     bool error = false;
 
     DEBUG('f', "Checking file header %u.  File size: %u bytes, number of sectors: %u.\n",
           num, rh->numBytes, rh->numSectors);
-    error |= CheckForError(rh->numSectors >= DivRoundUp(rh->numBytes,
-                                                        SECTOR_SIZE),
-                           "sector count not compatible with file size.");
-    error |= CheckForError(rh->numSectors < NUM_DIRECT,
-                           "too many blocks.");
-    for (unsigned i = 0; i < rh->numSectors; i++) {
-        unsigned s = rh->dataSectors[i];
-        error |= CheckSector(s, shadowMap);
+    if (h->IsInline()) {
+        error |= CheckForError(rh->numBytes <= INLINE_SIZE,
+                               "file too long to be in its header.");
+    } else {
+        error |= CheckForError(rh->numSectors >= DivRoundUp(rh->numBytes,
+                                                            SECTOR_SIZE),
+                               "sector count not compatible with file size.");
+    }
+    unsigned numSectors = 0;
+    for (unsigned i = 0; i < rh->numExtents; i++) {
+        const Extent *e = h->GetExtent(i);
+        for (unsigned j = 0; j < e->length && e->start != HOLE; j++) {
+            error |= CheckSector(e->start + j, shadowMap);
+        }
+        numSectors += e->length;
+    }
+    error |= CheckForError(numSectors == rh->numSectors,
+                           "extents not compatible with sector count.");
+    for (unsigned i = 0; i < h->NumIndexSectors(); i++) {
+        error |= CheckSector(h->GetIndexSector(i), shadowMap);
     }
     return error;
 }
@@ -342,7 +844,7 @@ static bool
 CheckBitmaps(const Bitmap *freeMap, const Bitmap *shadowMap)
 {
     bool error = false;
-    for (unsigned i = 0; i < NUM_SECTORS; i++) {
+    for (unsigned i = 0; i < diskSectors; i++) {
         DEBUG('f', "Checking sector %u. Original: %u, shadow: %u.\n",
               i, freeMap->Test(i), shadowMap->Test(i));
         error |= CheckForError(freeMap->Test(i) == shadowMap->Test(i),
@@ -351,12 +853,72 @@ CheckBitmaps(const Bitmap *freeMap, const Bitmap *shadowMap)
     return error;
 }
 
+/// Only the sectors of the files checked are in `shadowMap`, so only that
+/// those are taken can be checked.
+static bool
+CheckBitmapsIncremental(const Bitmap *freeMap, const Bitmap *shadowMap)
+{
+    bool error = false;
+    for (unsigned i = 0; i < diskSectors; i++) {
+        if (shadowMap->Test(i)) {
+            error |= CheckForError(freeMap->Test(i),
+                                   "sector in use marked as free.");
+        }
+    }
+    return error;
+}
+
+/// What a check shares between the walk over the directories and the
+/// threads that check the headers of the files found.
+struct CheckState {
+    bool incremental;
+    Bitmap *shadowMap;
+
+    /// Headers of the files found, and the next one to check.
+    unsigned *pending;
+    unsigned numPending;
+    unsigned next;
+
+    bool error;
+    Lock *lock;  ///< Over all the above, once the workers run.
+};
+
+/// Check the headers found by the walk, one at a time: reading it with the
+/// lock let go, so that several workers reading at once keep the disk busy,
+/// and checking it with the lock held.
+static void
+CheckWorker(void *state_)
+{
+    CheckState *state = (CheckState *) state_;
+
+    for (;;) {
+        state->lock->Acquire();
+        if (state->next == state->numPending) {
+            state->lock->Release();
+            return;
+        }
+        unsigned sector = state->pending[state->next++];
+        state->lock->Release();
+
+        FileHeader *h = new FileHeader;
+        h->FetchFrom(sector);
+        state->lock->Acquire();
+        state->error |= CheckFileHeader(h, sector, state->shadowMap);
+        state->lock->Release();
+        delete h;
+    }
+}
+
+/// Directories are checked as they are walked, since they must be read to
+/// go on; the headers of the other files are left for `CheckWorker`.  In
+/// an incremental check, only those in a dirty region are.
 static bool
-CheckDirectory(const RawDirectory *rd, Bitmap *shadowMap)
+CheckDirectory(const RawDirectory *rd, CheckState *state)
 {
     ASSERT(rd != nullptr);
-    ASSERT(shadowMap != nullptr);
+    ASSERT(state != nullptr);
 
+    Bitmap *shadowMap = state->shadowMap;
     bool error = false;
     unsigned nameCount = 0;
     const char *knownNames[NUM_DIR_ENTRIES];
@@ -390,29 +952,66 @@ CheckDirectory(const RawDirectory *rd, Bitmap *shadowMap)
                 nameCount++;
             }
 
-            // Check sector.
-            error |= CheckSector(e->sector, shadowMap);
+            // Check sector.  A sector used twice is not looked into, so
+            // that a directory in itself is not gone into forever.
+            if (CheckSector(e->sector, shadowMap)) {
+                error = true;
+                continue;
+            }
 
-            // Check file header.
+            if (!e->isDirectory) {
+                if (!state->incremental || dirtyMap->IsDirty(e->sector)) {
+                    state->pending[state->numPending++] = e->sector;
+                }
+                continue;
+            }
+
+            // Check the header of a subdirectory, and the files in it.
             FileHeader *h = new FileHeader;
-            const RawFileHeader *rh = h->GetRaw();
             h->FetchFrom(e->sector);
-            error |= CheckFileHeader(rh, e->sector, shadowMap);
+            error |= CheckFileHeader(h, e->sector, shadowMap);
             delete h;
+
+            DEBUG('f', "Checking directory \"%s\".\n", e->name);
+            OpenFile  *file = new OpenFile(e->sector);
+            Directory *sub  = new Directory(NUM_DIR_ENTRIES);
+            sub->FetchFrom(file);
+            error |= CheckDirectory(sub->GetRaw(), state);
+            delete sub;
+            delete file;
         }
     }
     return error;
 }
 
+/// A full check walks every file; an incremental one still walks every
+/// directory, but only looks at the headers of the other files if they are
+/// in a region marked in the dirty map, and so cannot tell sectors taken
+/// but used by no file.  Either way, once all is well, the dirty map is
+/// cleared.
 bool
-FileSystem::Check()
+FileSystem::Check(bool incremental)
 {
-    DEBUG('f', "Performing filesystem check\n");
+    DEBUG('f', "Performing %s filesystem check\n",
+          incremental ? "incremental" : "full");
     bool error = false;
-
-    Bitmap *shadowMap = new Bitmap(NUM_SECTORS);
+    lock->AcquireRead();
+    freeMapLock->Acquire();
+    unsigned long numMarked = dirtyMap->NumMarked();
+
+    CheckState *state = new CheckState;
+    state->incremental = incremental;
+    state->shadowMap   = new Bitmap(diskSectors);
+    state->pending     = new unsigned [diskSectors];
+    state->numPending  = 0;
+    state->next        = 0;
+    state->error       = false;
+    state->lock        = new Lock("check");
+    Bitmap *shadowMap = state->shadowMap;
     shadowMap->Mark(FREE_MAP_SECTOR);
     shadowMap->Mark(DIRECTORY_SECTOR);
+    shadowMap->Mark(JOURNAL_SECTOR);
+    shadowMap->Mark(DIRTY_MAP_SECTOR);
 
     DEBUG('f', "Checking bitmap's file header.\n");
 
@@ -421,36 +1020,67 @@ FileSystem::Check()
     bitH->FetchFrom(FREE_MAP_SECTOR);
     DEBUG('f', "  File size: %u bytes, expected %u bytes.\n"
                "  Number of sectors: %u, expected %u.\n",
-          bitRH->numBytes, FREE_MAP_FILE_SIZE,
-          bitRH->numSectors, FREE_MAP_FILE_SIZE / SECTOR_SIZE);
-    error |= CheckForError(bitRH->numBytes == FREE_MAP_FILE_SIZE,
+          bitRH->numBytes, FreeMapFileSize(),
+          bitRH->numSectors, DivRoundUp(FreeMapFileSize(), SECTOR_SIZE));
+    error |= CheckForError(bitRH->numBytes == FreeMapFileSize(),
                            "bad bitmap header: wrong file size.");
-    error |= CheckForError(bitRH->numSectors == FREE_MAP_FILE_SIZE / SECTOR_SIZE,
+    error |= CheckForError(bitRH->numSectors
+                             == DivRoundUp(FreeMapFileSize(), SECTOR_SIZE),
                            "bad bitmap header: wrong number of sectors.");
-    error |= CheckFileHeader(bitRH, FREE_MAP_SECTOR, shadowMap);
+    error |= CheckFileHeader(bitH, FREE_MAP_SECTOR, shadowMap);
     delete bitH;
 
     DEBUG('f', "Checking directory.\n");
 
     FileHeader *dirH = new FileHeader;
-    const RawFileHeader *dirRH = dirH->GetRaw();
     dirH->FetchFrom(DIRECTORY_SECTOR);
-    error |= CheckFileHeader(dirRH, DIRECTORY_SECTOR, shadowMap);
+    error |= CheckFileHeader(dirH, DIRECTORY_SECTOR, shadowMap);
     delete dirH;
 
-    Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-    freeMap->FetchFrom(freeMapFile);
+    DEBUG('f', "Checking journal.\n");
+
+    FileHeader *jrnH = new FileHeader;
+    jrnH->FetchFrom(JOURNAL_SECTOR);
+    error |= CheckForError(jrnH->GetRaw()->numExtents == 1,
+                           "bad journal header: not consecutive.");
+    error |= CheckFileHeader(jrnH, JOURNAL_SECTOR, shadowMap);
+    delete jrnH;
+
+    // What is on disk is checked, rather than the copies in memory.
+    Bitmap *diskMap = new Bitmap(diskSectors);
+    diskMap->FetchFrom(freeMapFile);
     Directory *dir = new Directory(NUM_DIR_ENTRIES);
     const RawDirectory *rdir = dir->GetRaw();
     dir->FetchFrom(directoryFile);
-    error |= CheckDirectory(rdir, shadowMap);
+    error |= CheckDirectory(rdir, state);
     delete dir;
 
+    // Check the headers of the files found.
+    DEBUG('f', "Checking %u file headers.\n", state->numPending);
+    Thread *workers[CHECK_WORKERS];
+    for (unsigned i = 0; i < CHECK_WORKERS; i++) {
+        workers[i] = new Thread("check worker", true, PRIORITY_DEFAULT);
+        workers[i]->Fork(CheckWorker, state);
+    }
+    for (unsigned i = 0; i < CHECK_WORKERS; i++) {
+        workers[i]->Join();
+    }
+    error |= state->error;
+
     // The two bitmaps should match.
     DEBUG('f', "Checking bitmap consistency.\n");
-    error |= CheckBitmaps(freeMap, shadowMap);
+    error |= incremental ? CheckBitmapsIncremental(diskMap, shadowMap)
+                         : CheckBitmaps(diskMap, shadowMap);
+    delete state->lock;
+    delete [] state->pending;
     delete shadowMap;
-    delete freeMap;
+    delete state;
+    delete diskMap;
+    if (!error) {
+        dirtyMap->Clear(numMarked);
+    }
+    freeMapLock->Release();
+    lock->ReleaseRead();
 
     DEBUG('f', error ? "Filesystem check failed.\n"
                      : "Filesystem check succeeded.\n");
@@ -458,6 +1088,236 @@ FileSystem::Check()
     return !error;
 }
 
+struct DefragState {
+    const char *image;  ///< The disk as it was.
+    char *newImage;     ///< The disk as it is to be.
+
+    /// Sectors that stay where they are, and those taken so far by what
+    /// was moved.
+    Bitmap *pinned;
+    Bitmap *used;
+
+    /// Where the next sector moved goes, or after.
+    unsigned cursor;
+
+    unsigned numFiles;
+    unsigned extentsBefore, extentsAfter;
+    unsigned breaksBefore, breaksAfter;
+};
+
+/// Number of times the blocks of the file whose header is `hdr`, at
+/// `sector`, do not follow the header, or each other, on the disk.
+static unsigned
+CountBreaks(FileHeader *hdr, unsigned sector)
+{
+    ASSERT(hdr != nullptr);
+
+    unsigned breaks = 0, last = sector;
+    for (unsigned i = 0; i < hdr->GetRaw()->numSectors; i++) {
+        unsigned next = hdr->ByteToSector(i * SECTOR_SIZE);
+        if (next == HOLE) {
+            continue;
+        }
+        if (next != last + 1) {
+            breaks++;
+        }
+        last = next;
+    }
+    return breaks;
+}
+
+/// Return where the sector at `old` goes: where it is, if pinned, or the
+/// next sector free.
+static unsigned
+PlaceSector(unsigned old, DefragState *state)
+{
+    unsigned sector = old;
+    if (!state->pinned->Test(old)) {
+        while (state->pinned->Test(state->cursor)) {
+            state->cursor++;
+        }
+        ASSERT(state->cursor < diskSectors);
+        sector = state->cursor++;
+    }
+    state->used->Mark(sector);
+    return sector;
+}
+
+/// Move the file whose header is at `sector`, and its blocks, to the next
+/// sectors free, in order, and then, if it is a directory, everything in
+/// it; return where its header goes.  Holes stay holes.  The headers are read from the disk,
+/// which has not changed yet; the blocks are copied between the images.
+static unsigned
+DefragFile(unsigned sector, bool isDirectory, DefragState *state)
+{
+    ASSERT(state != nullptr);
+
+    FileHeader *h = new FileHeader;
+    h->FetchFrom(sector);
+    const RawFileHeader *rh = h->GetRaw();
+    unsigned newSector = PlaceSector(sector, state);
+    state->numFiles++;
+
+    if (!h->IsInline()) {
+        state->extentsBefore += rh->numExtents;
+        state->breaksBefore  += CountBreaks(h, sector);
+        unsigned *sectors = new unsigned [rh->numSectors];
+        for (unsigned i = 0; i < rh->numSectors; i++) {
+            unsigned old = h->ByteToSector(i * SECTOR_SIZE);
+            if (old == HOLE) {
+                sectors[i] = HOLE;
+                continue;
+            }
+            sectors[i] = PlaceSector(old, state);
+            memcpy(&state->newImage[sectors[i] * SECTOR_SIZE],
+                   &state->image[old * SECTOR_SIZE], SECTOR_SIZE);
+        }
+        h->SetSectors(sectors);
+        delete [] sectors;
+        state->extentsAfter += rh->numExtents;
+        state->breaksAfter  += CountBreaks(h, newSector);
+    }
+
+    // The entries are patched once those they name are placed.
+    if (isDirectory) {
+        ASSERT(!h->IsInline());
+        unsigned numSectors = rh->numSectors;
+        char *data = new char [numSectors * SECTOR_SIZE];
+        for (unsigned i = 0; i < numSectors; i++) {
+            memcpy(&data[i * SECTOR_SIZE],
+                   &state->newImage[h->ByteToSector(i * SECTOR_SIZE)
+                                    * SECTOR_SIZE], SECTOR_SIZE);
+        }
+        DirectoryEntry *table = (DirectoryEntry *) data;
+        for (unsigned i = 0; i < h->FileLength() / sizeof *table; i++) {
+            if (table[i].inUse) {
+                table[i].sector = DefragFile(table[i].sector,
+                                             table[i].isDirectory, state);
+            }
+        }
+        for (unsigned i = 0; i < numSectors; i++) {
+            memcpy(&state->newImage[h->ByteToSector(i * SECTOR_SIZE)
+                                    * SECTOR_SIZE],
+                   &data[i * SECTOR_SIZE], SECTOR_SIZE);
+        }
+        delete [] data;
+    }
+
+    char *header = &state->newImage[newSector * SECTOR_SIZE];
+    memset(header, 0, SECTOR_SIZE);
+    memcpy(header, rh, sizeof *rh);
+    delete h;
+#ifdef USER_PROGRAM
+    if (newSector != sector) {
+        InvalidateImage(nullptr, sector);
+    }
+#endif
+    return newSector;
+}
+
+/// The whole disk is read into memory, and laid out again there, walking
+/// the directories from the root: each file goes in the sectors free next,
+/// its header first and then its blocks, in order, and those of a directory
+/// before what is in it.  Only the free map, the root directory, the
+/// journal and the dirty map stay where they are.  Then the sectors that
+/// changed are written, and the free map.
+///
+/// The journal is emptied first, so that nothing in it is written over the
+/// new layout; the layout itself is not journaled, so a crash meanwhile
+/// may leave the file system broken.  This is meant to be run with nothing
+/// else going on.
+bool
+FileSystem::Defragment()
+{
+    if (!Check()) {
+        printf("Filesystem check failed, not defragmenting.\n");
+        return false;
+    }
+    journal->Flush();
+    lock->AcquireWrite();
+    freeMapLock->Acquire();
+
+    DefragState *state = new DefragState;
+    char *image = new char [diskSectors * SECTOR_SIZE];
+    synchDisk->ReadSectors(0, diskSectors, image);
+    state->image    = image;
+    state->newImage = new char [diskSectors * SECTOR_SIZE];
+    memcpy(state->newImage, image, diskSectors * SECTOR_SIZE);
+    state->pinned = new Bitmap(diskSectors);
+    state->used   = new Bitmap(diskSectors);
+    state->cursor = 0;
+    state->numFiles = 0;
+    state->extentsBefore = state->extentsAfter = 0;
+    state->breaksBefore  = state->breaksAfter  = 0;
+
+    const unsigned fixed[] = {
+        FREE_MAP_SECTOR, DIRECTORY_SECTOR, JOURNAL_SECTOR
+    };
+    state->pinned->Mark(DIRTY_MAP_SECTOR);
+    state->used->Mark(DIRTY_MAP_SECTOR);
+    for (unsigned i = 0; i < sizeof fixed / sizeof *fixed; i++) {
+        FileHeader *h = new FileHeader;
+        h->FetchFrom(fixed[i]);
+        state->pinned->Mark(fixed[i]);
+        for (unsigned j = 0; j < h->GetRaw()->numSectors; j++) {
+            state->pinned->Mark(h->ByteToSector(j * SECTOR_SIZE));
+        }
+        for (unsigned j = 0; j < h->NumIndexSectors(); j++) {
+            state->pinned->Mark(h->GetIndexSector(j));
+        }
+        delete h;
+    }
+    for (unsigned i = 0; i < diskSectors; i++) {
+        if (state->pinned->Test(i)) {
+            state->used->Mark(i);
+        }
+    }
+    DefragFile(DIRECTORY_SECTOR, true, state);
+
+    // The disk cache takes the sectors, and writes them behind.
+    unsigned numWritten = 0;
+    for (unsigned s = 0; s < diskSectors; s++) {
+        const char *data = &state->newImage[s * SECTOR_SIZE];
+        if (state->used->Test(s)
+              && memcmp(data, &image[s * SECTOR_SIZE], SECTOR_SIZE) != 0) {
+            dirtyMap->Note(s);
+            synchDisk->WriteSector(s, data);
+            numWritten++;
+        }
+        if (state->used->Test(s)) {
+            freeMap->Mark(s);
+        } else if (freeMap->Test(s)) {
+            freeMap->Clear(s);
+        }
+    }
+    rootDirectory->FetchFrom(directoryFile);
+    delete dentries;
+    dentries = new DentryCache;
+    pageCache->ForgetAll();  // Blocks are cached by header sector.
+
+    printf("Defragmented %u files: extents %u -> %u, breaks %u -> %u, "
+           "%u sectors written.\n",
+           state->numFiles, state->extentsBefore, state->extentsAfter,
+           state->breaksBefore, state->breaksAfter, numWritten);
+    delete state->used;
+    delete state->pinned;
+    delete [] state->newImage;
+    delete [] image;
+    delete state;
+    freeMapLock->Release();
+    lock->ReleaseWrite();
+
+    // The free map goes through the journal, as any other change to it.
+    journal->Begin();
+    freeMapLock->Acquire();
+    freeMap->WriteBack(freeMapFile);
+    freeMapLock->Release();
+    journal->End();
+    journal->Commit();
+    synchDisk->Flush();
+    return true;
+}
+
 /// Print everything about the file system:
 /// * the contents of the bitmap;
 /// * the contents of the directory;
@@ -467,11 +1327,10 @@ FileSystem::Check()
 void
 FileSystem::Print()
 {
-    FileHeader *bitH    = new FileHeader;
-    FileHeader *dirH    = new FileHeader;
-    Bitmap     *freeMap = new Bitmap(NUM_SECTORS);
-    Directory  *dir     = new Directory(NUM_DIR_ENTRIES);
+    FileHeader *bitH = new FileHeader;
+    FileHeader *dirH = new FileHeader;
 
+    lock->AcquireRead();
     printf("--------------------------------\n");
     bitH->FetchFrom(FREE_MAP_SECTOR);
     bitH->Print("Bitmap");
@@ -481,16 +1340,13 @@ FileSystem::Print()
     dirH->Print("Directory");
 
     printf("--------------------------------\n");
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
 
     printf("--------------------------------\n");
-    dir->FetchFrom(directoryFile);
-    dir->Print();
+    rootDirectory->Print();
     printf("--------------------------------\n");
+    lock->ReleaseRead();
 
     delete bitH;
     delete dirH;
-    delete freeMap;
-    delete dir;
 }
@@ -43,10 +43,17 @@
                      // UNIX, until the real file system implementation is
                      // available.
 
+
+#include "directory_entry.hh"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
 /// Constant definitions with dummy values.  For the stub filesystem they
 /// are not required, but system information tools expects them to be
 /// defined.
-static const unsigned FREE_MAP_FILE_SIZE = 0;
+inline unsigned FreeMapFileSize() { return 0; }
 static const unsigned NUM_DIR_ENTRIES = 0;
 static const unsigned DIRECTORY_FILE_SIZE = 0;
 
@@ -62,11 +69,14 @@ public:
     {
         ASSERT(name != nullptr);
 
-        int fileDescriptor = SystemDep::OpenForWrite(name);
+        int fileDescriptor = SystemDep::OpenForWrite(name, false);
         if (fileDescriptor == -1) {
             return false;
         }
         SystemDep::Close(fileDescriptor);
+#ifdef USER_PROGRAM
+        InvalidateImage(name, -1);  // Truncated, if it existed.
+#endif
         return true;
     }
 
@@ -78,13 +88,81 @@ public:
         if (fileDescriptor == -1) {
             return nullptr;
         }
-        return new OpenFile(fileDescriptor);
+        return new OpenFile(fileDescriptor, name);
     }
 
     bool Remove(const char *name)
     {
         ASSERT(name != nullptr);
-        return SystemDep::Unlink(name) == 0;
+        if (SystemDep::Unlink(name) != 0) {
+            return false;
+        }
+#ifdef USER_PROGRAM
+        InvalidateImage(name, -1);
+#endif
+        return true;
+    }
+
+    bool Stat(const char *path, bool *isDirectory, unsigned *length)
+    {
+        ASSERT(path != nullptr);
+        return SystemDep::Stat(path[0] == '\0' ? "." : path,
+                               isDirectory, length);
+    }
+
+    /// Entries are taken from the host directory, in the order it lists
+    /// them; those with names too long for a `DirectoryEntry` are left
+    /// out.  Every entry has sector 0.
+    int ReadDirectory(const char *path, DirectoryEntry *entries,
+                      unsigned count, unsigned *lengths = nullptr)
+    {
+        ASSERT(path != nullptr);
+        ASSERT(entries != nullptr);
+
+        HostListing listing = { path[0] == '\0' ? "." : path,
+                                entries, count, lengths, 0 };
+        if (!SystemDep::ListDirectory(listing.path, &AddHostEntry,
+                                      &listing)) {
+            return -1;
+        }
+        return listing.found;
+    }
+
+private:
+
+    /// What `ReadDirectory` is filling.
+    struct HostListing {
+        const char *path;
+        DirectoryEntry *entries;
+        unsigned count;
+        unsigned *lengths;
+        unsigned found;
+    };
+
+    static void AddHostEntry(const char *name, void *arg)
+    {
+        HostListing *listing = (HostListing *) arg;
+        if (listing->found == listing->count
+              || strlen(name) > FILE_NAME_MAX_LEN) {
+            return;
+        }
+        char entryPath[PATH_MAX];
+        snprintf(entryPath, sizeof entryPath, "%s/%s", listing->path, name);
+        bool isDirectory;
+        unsigned length;
+        if (!SystemDep::Stat(entryPath, &isDirectory, &length)) {
+            return;  // Gone meanwhile.
+        }
+
+        DirectoryEntry *e = &listing->entries[listing->found];
+        e->inUse       = true;
+        e->isDirectory = isDirectory;
+        e->sector      = 0;
+        strcpy(e->name, name);
+        if (listing->lengths != nullptr) {
+            listing->lengths[listing->found] = length;
+        }
+        listing->found++;
     }
 
 };
@@ -96,15 +174,27 @@ public:
 #include "machine/disk.hh"
 
 
-/// Initial file sizes for the bitmap and directory; until the file system
-/// supports extensible files, the directory size sets the maximum number of
-/// files that can be loaded onto the disk.
-static const unsigned FREE_MAP_FILE_SIZE = NUM_SECTORS / BITS_IN_BYTE;
+class Bitmap;
+class DentryCache;
+class Directory;
+class FileHeader;
+class Lock;
+class RWLock;
+
+
+/// Initial file sizes for the bitmap and directories; since directories do
+/// not grow, the directory size sets the maximum number of files that can
+/// be kept in each directory.
+inline unsigned FreeMapFileSize() { return diskSectors / BITS_IN_BYTE; }
 static const unsigned NUM_DIR_ENTRIES = 10;
 static const unsigned DIRECTORY_FILE_SIZE
   = sizeof (DirectoryEntry) * NUM_DIR_ENTRIES;
 
 
+/// Files are named by paths: the names of the directories to go through
+/// from the root, and last that of the file, separated by slashes, such as
+/// `a/b/c`.  A leading slash is optional, since every path starts at the
+/// root.
 class FileSystem {
 public:
 
@@ -120,26 +210,119 @@ public:
     /// Create a file (UNIX `creat`).
     bool Create(const char *name, unsigned initialSize);
 
-    /// Open a file (UNIX `open`).
+    /// Create an empty directory (UNIX `mkdir`).
+    bool MakeDirectory(const char *name);
+
+    /// Open a file (UNIX `open`).  Directories cannot be opened.
     OpenFile *Open(const char *name);
 
-    /// Delete a file (UNIX `unlink`).
+    /// Delete a file, or an empty directory (UNIX `unlink`, `rmdir`).
     bool Remove(const char *name);
 
-    /// List all the files in the file system.
+    /// Tell whether there is a file or directory at `path`, and if so,
+    /// whether it is a directory, and its length in bytes.
+    bool Stat(const char *path, bool *isDirectory, unsigned *length);
+
+    /// Copy the entries in use of the directory at `path` into `entries`,
+    /// up to `count` of them, and if `lengths` is not null, their lengths
+    /// in bytes into it; return how many, or -1 if there is no such
+    /// directory.
+    int ReadDirectory(const char *path, DirectoryEntry *entries,
+                      unsigned count, unsigned *lengths = nullptr);
+
+    /// List all the files in the root directory.
     void List();
 
-    /// Check the filesystem.
-    bool Check();
+    /// Make room in a file for `numBytes` bytes, taking blocks after those
+    /// it has.
+    bool Extend(FileHeader *hdr, unsigned headerSector, unsigned numBytes);
+
+    /// The same, with holes rather than blocks.
+    bool ExtendSparse(FileHeader *hdr, unsigned headerSector,
+                      unsigned numBytes);
+
+    /// Take sectors for the holes among blocks `first` to `last` of a file,
+    /// or make holes of them, giving their sectors back; the header is left
+    /// for the caller to write back, as by `Extend`.
+    bool FillHoles(FileHeader *hdr, unsigned headerSector,
+                   unsigned first, unsigned last);
+    bool PunchHoles(FileHeader *hdr, unsigned headerSector,
+                    unsigned first, unsigned last);
+
+    /// Check the filesystem; if `incremental`, only the files whose headers
+    /// changed since the last check.
+    bool Check(bool incremental = false);
+
+    /// Move every file to consecutive sectors, right after its header, once
+    /// the file system is checked; print how fragmented it was, and is.
+    bool Defragment();
 
     /// List all the files and their contents.
     void Print();
 
 private:
+    /// Tracks in each allocation group.
+    ///
+    /// The free map is divided into groups of whole tracks.  The header of
+    /// a new file is taken in the group of its directory, so that looking
+    /// the file up and then reading it stays within a few tracks, and its
+    /// blocks follow the header.  A file that does not fit there, or a
+    /// new directory once a quarter of the group is all that is left,
+    /// goes to the nearest group with at least the average room instead,
+    /// so that groups fill up evenly.
+    static const unsigned GROUP_TRACKS = 4;
+
+    /// Take a sector for the header of a new file or directory in the
+    /// directory whose header is at `dirSector`, expected to need
+    /// `numSectors` more; return -1 if the disk is full.
+    int AllocateHeader(unsigned dirSector, unsigned numSectors,
+                       bool isDirectory);
+
+    /// Create a file or directory at `path`, of `initialSize` bytes.
+    bool CreateEntry(const char *path, unsigned initialSize,
+                     bool isDirectory);
+
+    /// Return the sector of the header of the directory holding the last
+    /// component of `path`, and copy that component into `name`, which
+    /// must have room for `FILE_NAME_MAX_LEN + 1` characters.  Return -1 if
+    /// some directory along the way does not exist, or if `path` is not
+    /// well formed.
+    int FindParent(const char *path, char *name);
+
+    /// Return the sector of the header of the file or directory at `path`,
+    /// the root included, and set `*isDirectory`; return -1 if there is
+    /// none.
+    int FindEntry(const char *path, bool *isDirectory);
+
+    /// Return the sector of the header of `name` in the directory whose
+    /// header is at `dirSector`, and set `*isDirectory`; return -1 if it is
+    /// not there.  What the directory holds is cached in `dentries`.
+    int LookupIn(unsigned dirSector, const char *name, bool *isDirectory);
+
+    /// Get the directory whose header is at `sector`, read through the
+    /// file set in `*file`, and let go of it; the root directory is kept
+    /// in memory, and not read.
+    Directory *OpenDirectory(unsigned sector, OpenFile **file);
+    void CloseDirectory(Directory *dir, OpenFile *file);
+
     OpenFile *freeMapFile;  ///< Bit map of free disk blocks, represented as a
                             ///< file.
     OpenFile *directoryFile;  ///< “Root” directory -- list of file names,
                               ///< represented as a file.
+
+    /// Contents of the two files above, kept in memory.
+    Bitmap *freeMap;
+    Directory *rootDirectory;
+
+    /// Held for reading while looking at the directories, and for writing
+    /// while changing them.
+    RWLock *lock;
+
+    /// Held while using the free map; after `lock`, if both are.
+    Lock *freeMapLock;
+
+    /// Names looked up in directories.
+    DentryCache *dentries;
 };
 
 #endif
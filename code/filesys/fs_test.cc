@@ -6,9 +6,11 @@
 ///     Copy a file from UNIX to Nachos.
 /// Print
 ///     Cat the contents of a Nachos file.
+/// Import, Export
+///     Copy a whole tree of files from UNIX to Nachos, or back, at once.
 /// Perftest
-///     A stress test for the Nachos file system read and write a really
-///     really large file in tiny chunks (will not work on baseline system!)
+///     A suite of benchmarks of the Nachos file system, with what each
+///     workload costs in a form that can be compared between builds.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -23,8 +25,11 @@
 #include "threads/thread.hh"
 #include "threads/system.hh"
 
+#include <dirent.h>
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 
 static const unsigned TRANSFER_SIZE = 10;  // Make it small, just to be
@@ -100,85 +105,515 @@ Print(const char *name)
 }
 
 
-/// Performance test
+/// Bulk import and export
 ///
-/// Stress the Nachos file system by creating a large file, writing it out a
-/// bit at a time, reading it back a bit at a time, and then deleting the
-/// file.
+/// Whole trees of files are copied between a UNIX directory and a Nachos
+/// one in a single run, so that the free map and the directories are read
+/// once, kept in memory and in the disk cache while every file goes
+/// through, and reach the disk in a few groups of the journal rather than
+/// once per file.  Each file is created with its whole length, so that its
+/// blocks are taken at once, in as few runs as there are, right after its
+/// header; and then written with one request.
+
+/// Longest path made while walking a tree, on either side.
+static const unsigned MAX_BULK_PATH = 1024;
+
+struct BulkCount {
+    unsigned numFiles;
+    unsigned numDirectories;
+    unsigned long numBytes;
+    unsigned numFailed;
+};
+
+/// Join `dir` and `name` into `path`, which has room for `MAX_BULK_PATH`
+/// characters; return false if there is not enough.
+static bool
+JoinPath(char *path, const char *dir, const char *name)
+{
+    unsigned n = snprintf(path, MAX_BULK_PATH, "%s/%s", dir, name);
+    return n < MAX_BULK_PATH;
+}
+
+/// Copy the whole UNIX file `from`, of `length` bytes, to the new Nachos
+/// file `to`.
+static bool
+ImportFile(const char *from, const char *to, unsigned length)
+{
+    FILE *fp = fopen(from, "r");
+    if (fp == nullptr) {
+        return false;
+    }
+    char *buffer = new char [length > 0 ? length : 1];
+    bool ok = fread(buffer, 1, length, fp) == length
+              && fileSystem->Create(to, length);
+    fclose(fp);
+    if (ok && length > 0) {
+        OpenFile *openFile = fileSystem->Open(to);
+        ASSERT(openFile != nullptr);
+        ok = openFile->WriteAt(buffer, length, 0) == (int) length;
+        delete openFile;
+    }
+    delete [] buffer;
+    return ok;
+}
+
+static void
+ImportTree(const char *from, const char *to, BulkCount *count)
+{
+    DIR *dir = opendir(from);
+    if (dir == nullptr) {
+        fprintf(stderr, "Import: could not open directory %s\n", from);
+        count->numFailed++;
+        return;
+    }
+    struct dirent *d;
+    while ((d = readdir(dir)) != nullptr) {
+        if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, "..")) {
+            continue;
+        }
+        char unixPath[MAX_BULK_PATH], nachosPath[MAX_BULK_PATH];
+        struct stat st;
+        if (!JoinPath(unixPath, from, d->d_name)
+              || !JoinPath(nachosPath, to, d->d_name)
+              || stat(unixPath, &st) != 0) {
+            fprintf(stderr, "Import: could not copy %s\n", d->d_name);
+            count->numFailed++;
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            if (!fileSystem->MakeDirectory(nachosPath)) {
+                fprintf(stderr, "Import: could not make directory %s\n",
+                        nachosPath);
+                count->numFailed++;
+                continue;
+            }
+            count->numDirectories++;
+            ImportTree(unixPath, nachosPath, count);
+        } else if (S_ISREG(st.st_mode)) {
+            if (st.st_size > MaxFileSize()
+                  || !ImportFile(unixPath, nachosPath, st.st_size)) {
+                fprintf(stderr, "Import: could not copy %s to %s\n",
+                        unixPath, nachosPath);
+                count->numFailed++;
+                continue;
+            }
+            count->numFiles++;
+            count->numBytes += st.st_size;
+        }
+    }
+    closedir(dir);
+}
+
+/// Copy the files and directories in the UNIX directory `from` into the
+/// Nachos directory `to`, which is made if it is not there.
+void
+Import(const char *from, const char *to)
+{
+    ASSERT(from != nullptr);
+    ASSERT(to != nullptr);
+
+    bool isDirectory;
+    unsigned length;
+    if (!fileSystem->Stat(to, &isDirectory, &length)) {
+        fileSystem->MakeDirectory(to);
+    }
+    if (!fileSystem->Stat(to, &isDirectory, &length) || !isDirectory) {
+        fprintf(stderr, "Import: %s is not a Nachos directory\n", to);
+        return;
+    }
+    BulkCount count = { 0, 0, 0, 0 };
+    ImportTree(from, to, &count);
+    journal->Commit();
+    printf("Imported %u files, %u directories, %lu bytes; %u failed.\n",
+           count.numFiles, count.numDirectories, count.numBytes,
+           count.numFailed);
+}
+
+static void
+ExportTree(const char *from, const char *to, BulkCount *count)
+{
+    if (mkdir(to, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Export: could not make directory %s\n", to);
+        count->numFailed++;
+        return;
+    }
+    DirectoryEntry entries[NUM_DIR_ENTRIES];
+    int n = fileSystem->ReadDirectory(from, entries, NUM_DIR_ENTRIES);
+    ASSERT(n >= 0);
+    for (int i = 0; i < n; i++) {
+        char nachosPath[MAX_BULK_PATH], unixPath[MAX_BULK_PATH];
+        if (!JoinPath(nachosPath, from, entries[i].name)
+              || !JoinPath(unixPath, to, entries[i].name)) {
+            fprintf(stderr, "Export: could not copy %s\n", entries[i].name);
+            count->numFailed++;
+            continue;
+        }
+        if (entries[i].isDirectory) {
+            count->numDirectories++;
+            ExportTree(nachosPath, unixPath, count);
+            continue;
+        }
+
+        OpenFile *openFile = fileSystem->Open(nachosPath);
+        ASSERT(openFile != nullptr);
+        unsigned length = openFile->Length();
+        char *buffer = new char [length > 0 ? length : 1];
+        FILE *fp = fopen(unixPath, "w");
+        bool ok = fp != nullptr
+                  && (length == 0
+                      || openFile->ReadAt(buffer, length, 0) == (int) length)
+                  && fwrite(buffer, 1, length, fp) == length;
+        if (fp != nullptr) {
+            ok &= fclose(fp) == 0;
+        }
+        delete [] buffer;
+        delete openFile;
+        if (!ok) {
+            fprintf(stderr, "Export: could not copy %s to %s\n",
+                    nachosPath, unixPath);
+            count->numFailed++;
+            continue;
+        }
+        count->numFiles++;
+        count->numBytes += length;
+    }
+}
+
+/// Copy the files and directories in the Nachos directory `from` into the
+/// UNIX directory `to`, which is made if it is not there.
+void
+Export(const char *from, const char *to)
+{
+    ASSERT(from != nullptr);
+    ASSERT(to != nullptr);
+
+    bool isDirectory;
+    unsigned length;
+    if (!fileSystem->Stat(from, &isDirectory, &length) || !isDirectory) {
+        fprintf(stderr, "Export: %s is not a Nachos directory\n", from);
+        return;
+    }
+    BulkCount count = { 0, 0, 0, 0 };
+    ExportTree(from, to, &count);
+    printf("Exported %u files, %u directories, %lu bytes; %u failed.\n",
+           count.numFiles, count.numDirectories, count.numBytes,
+           count.numFailed);
+}
+
+
+/// Performance test
 ///
-/// Implemented as three separate routines:
-/// * `FileWrite` -- write the file.
-/// * `FileRead` -- read the file.
-/// * `PerformanceTest` -- overall control, and print out performance #'s.
+/// A suite of workloads that stress the Nachos file system: sequential and
+/// random writes and reads of files of several sizes, a storm of small
+/// files created and removed, and several threads writing and reading files
+/// of their own at once.  Each workload prints one line of `key=value`
+/// pairs, with what it cost, so that the output of two builds can be
+/// compared with `diff`.  Random offsets come from a generator of our own,
+/// so that every run does the same.
 
-static const char FILE_NAME[] = "TestFile";
 static const char CONTENTS[] = "1234567890";
 static const unsigned CONTENT_SIZE = sizeof CONTENTS - 1;
-static const unsigned FILE_SIZE = CONTENT_SIZE * 5000;
 
+/// Sizes of the files written and read, and the chunks they are written
+/// and read in; the first chunk is small, just to be difficult.
+static const unsigned FILE_SIZES[] = { 1000, 8000, 32000 };
+static const unsigned CHUNK_SIZES[] = { CONTENT_SIZE, SECTOR_SIZE };
+
+/// Files in the storm of small files, which must fit in a directory; the
+/// bytes written to each; and the times they are created and removed.
+static const unsigned STORM_FILES  = 8;
+static const unsigned STORM_SIZE   = 60;
+static const unsigned STORM_ROUNDS = 4;
+
+/// Threads writing and reading at once, and the size of each one's file.
+static const unsigned NUM_WORKERS = 4;
+static const unsigned WORKER_FILE_SIZE = 8000;
+
+static const unsigned MAX_CHUNK_SIZE = SECTOR_SIZE;
+
+/// What the machine had done when a workload started.
+typedef struct {
+    unsigned long ticks;
+    unsigned long reads;
+    unsigned long writes;
+    unsigned long sectors;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long seekTracks;
+} Snapshot;
+
+static void
+TakeSnapshot(Snapshot *s)
+{
+    s->ticks      = stats->totalTicks;
+    s->reads      = stats->numDiskReads;
+    s->writes     = stats->numDiskWrites;
+    s->sectors    = stats->numDiskSectors;
+    s->hits       = stats->numDiskCacheHits;
+    s->misses     = stats->numDiskCacheMisses;
+    s->seekTracks = stats->numDiskSeekTracks;
+}
+
+/// Print what the workload `name`, on files of `size` bytes in chunks of
+/// `chunk`, cost since `start`, for `ops` operations.  Writes are committed
+/// and flushed first, so that they count against the workload that made
+/// them.  Ticks are simulated; the rate is given per million of them.
 static void
-FileWrite()
+Report(const char *name, unsigned size, unsigned chunk, unsigned ops,
+       bool ok, const Snapshot *start)
 {
-    printf("Sequential write of %u byte file, in %u byte chunks\n",
-           FILE_SIZE, CONTENT_SIZE);
+    journal->Commit();
+    synchDisk->Flush();
 
-    if (!fileSystem->Create(FILE_NAME, 0)) {
-        fprintf(stderr, "Perf test: cannot create %s\n", FILE_NAME);
-        return;
+    Snapshot end;
+    TakeSnapshot(&end);
+    unsigned long ticks = end.ticks - start->ticks;
+    printf("fsbench workload=%s size=%u chunk=%u ops=%u ok=%d ticks=%lu "
+           "ops_per_mtick=%.1f disk_reads=%lu disk_writes=%lu sectors=%lu "
+           "cache_hits=%lu cache_misses=%lu seek_tracks=%lu\n",
+           name, size, chunk, ops, ok, ticks,
+           ticks == 0 ? 0.0 : ops * 1000000.0 / ticks,
+           end.reads - start->reads, end.writes - start->writes,
+           end.sectors - start->sectors,
+           end.hits - start->hits, end.misses - start->misses,
+           end.seekTracks - start->seekTracks);
+}
+
+static unsigned randomState;
+
+/// A linear congruential generator, started over by every workload.
+static unsigned
+NextRandom()
+{
+    randomState = randomState * 1103515245 + 12345;
+    return randomState >> 16;
+}
+
+/// Fill `buffer` with `n` bytes of the contents expected at `position`.
+static void
+Expected(char *buffer, unsigned n, unsigned position)
+{
+    for (unsigned i = 0; i < n; i++) {
+        buffer[i] = CONTENTS[(position + i) % CONTENT_SIZE];
     }
+}
 
-    OpenFile *openFile = fileSystem->Open(FILE_NAME);
+/// Write `size` bytes to a new file `name`, in chunks of `chunk`.
+static bool
+FileWrite(const char *name, unsigned size, unsigned chunk)
+{
+    if (!fileSystem->Create(name, 0)) {
+        fprintf(stderr, "Perf test: cannot create %s\n", name);
+        return false;
+    }
+    OpenFile *openFile = fileSystem->Open(name);
     if (openFile == nullptr) {
-        fprintf(stderr, "Perf test: unable to open %s\n", FILE_NAME);
-        return;
+        fprintf(stderr, "Perf test: unable to open %s\n", name);
+        return false;
+    }
+
+    char buffer[MAX_CHUNK_SIZE];
+    bool ok = true;
+    for (unsigned i = 0; i < size && ok; i += chunk) {
+        unsigned n = size - i < chunk ? size - i : chunk;
+        Expected(buffer, n, i);
+        if (openFile->Write(buffer, n) < (int) n) {
+            fprintf(stderr, "Perf test: unable to write %s\n", name);
+            ok = false;
+        }
+    }
+    delete openFile;
+    return ok;
+}
+
+/// Read the `size` bytes of file `name`, in chunks of `chunk`, and check
+/// them.
+static bool
+FileRead(const char *name, unsigned size, unsigned chunk)
+{
+    OpenFile *openFile = fileSystem->Open(name);
+    if (openFile == nullptr) {
+        fprintf(stderr, "Perf test: unable to open file %s\n", name);
+        return false;
     }
 
-    for (unsigned i = 0; i < FILE_SIZE; i += CONTENT_SIZE) {
-        int numBytes = openFile->Write(CONTENTS, CONTENT_SIZE);
-        if (numBytes < 10) {
-            fprintf(stderr, "Perf test: unable to write %s\n", FILE_NAME);
-            break;
+    char buffer[MAX_CHUNK_SIZE], expected[MAX_CHUNK_SIZE];
+    bool ok = true;
+    for (unsigned i = 0; i < size && ok; i += chunk) {
+        unsigned n = size - i < chunk ? size - i : chunk;
+        Expected(expected, n, i);
+        if (openFile->Read(buffer, n) < (int) n
+              || memcmp(buffer, expected, n)) {
+            fprintf(stderr, "Perf test: unable to read %s\n", name);
+            ok = false;
         }
     }
+    delete openFile;
+    return ok;
+}
 
+/// Write or read, and check, `size / chunk` chunks of file `name` at
+/// random, each where a chunk starts.
+static bool
+FileRandom(const char *name, unsigned size, unsigned chunk, bool writing)
+{
+    OpenFile *openFile = fileSystem->Open(name);
+    if (openFile == nullptr) {
+        fprintf(stderr, "Perf test: unable to open file %s\n", name);
+        return false;
+    }
+
+    char buffer[MAX_CHUNK_SIZE], expected[MAX_CHUNK_SIZE];
+    unsigned numChunks = DivRoundUp(size, chunk);
+    bool ok = true;
+    randomState = size + chunk;
+    for (unsigned i = 0; i < numChunks && ok; i++) {
+        unsigned position = NextRandom() % numChunks * chunk;
+        unsigned n = size - position < chunk ? size - position : chunk;
+        Expected(expected, n, position);
+        if (writing) {
+            ok = openFile->WriteAt(expected, n, position) == (int) n;
+        } else {
+            ok = openFile->ReadAt(buffer, n, position) == (int) n
+                 && !memcmp(buffer, expected, n);
+        }
+        if (!ok) {
+            fprintf(stderr, "Perf test: unable to %s %s\n",
+                    writing ? "write" : "read", name);
+        }
+    }
     delete openFile;
+    return ok;
+}
+
+static bool
+FileRemove(const char *name)
+{
+    if (!fileSystem->Remove(name)) {
+        fprintf(stderr, "Perf test: unable to remove %s\n", name);
+        return false;
+    }
+    return true;
 }
 
+/// Sequential and random writes and reads of a file of `size` bytes, in
+/// chunks of `chunk`.
 static void
-FileRead()
+FileWorkloads(unsigned size, unsigned chunk)
 {
-    printf("Sequential read of %u byte file, in %u byte chunks\n",
-           FILE_SIZE, CONTENT_SIZE);
+    static const char NAME[] = "TestFile";
+    unsigned ops = DivRoundUp(size, chunk);
+    Snapshot start;
+    bool ok;
 
-    OpenFile *openFile = fileSystem->Open(FILE_NAME);
-    if (openFile == nullptr) {
-        fprintf(stderr, "Perf test: unable to open file %s\n", FILE_NAME);
+    TakeSnapshot(&start);
+    ok = FileWrite(NAME, size, chunk);
+    Report("seq-write", size, chunk, ops, ok, &start);
+    if (!ok) {
+        FileRemove(NAME);
         return;
     }
 
-    char *buffer = new char [CONTENT_SIZE];
-    for (unsigned i = 0; i < FILE_SIZE; i += CONTENT_SIZE) {
-        int numBytes = openFile->Read(buffer, CONTENT_SIZE);
-        if (numBytes < 10 || strncmp(buffer, CONTENTS, CONTENT_SIZE)) {
-            printf("Perf test: unable to read %s\n", FILE_NAME);
-            break;
+    TakeSnapshot(&start);
+    ok = FileRead(NAME, size, chunk);
+    Report("seq-read", size, chunk, ops, ok, &start);
+
+    TakeSnapshot(&start);
+    ok = FileRandom(NAME, size, chunk, true);
+    Report("rand-write", size, chunk, ops, ok, &start);
+
+    TakeSnapshot(&start);
+    ok = FileRandom(NAME, size, chunk, false);
+    Report("rand-read", size, chunk, ops, ok, &start);
+
+    TakeSnapshot(&start);
+    ok = FileRemove(NAME);
+    Report("remove", size, chunk, 1, ok, &start);
+}
+
+static void
+StormName(char *name, unsigned i)
+{
+    snprintf(name, FILE_NAME_MAX_LEN + 1, "Storm%u", i);
+}
+
+/// Create and write `STORM_FILES` small files, then remove them all, over
+/// and over.
+static void
+StormWorkload()
+{
+    char name[FILE_NAME_MAX_LEN + 1];
+    Snapshot start;
+    bool ok = true;
+
+    TakeSnapshot(&start);
+    for (unsigned r = 0; r < STORM_ROUNDS && ok; r++) {
+        for (unsigned i = 0; i < STORM_FILES && ok; i++) {
+            StormName(name, i);
+            ok = FileWrite(name, STORM_SIZE, STORM_SIZE);
+        }
+        for (unsigned i = 0; i < STORM_FILES; i++) {
+            StormName(name, i);
+            ok = FileRemove(name) && ok;
         }
     }
+    Report("storm", STORM_SIZE, STORM_SIZE, 2 * STORM_ROUNDS * STORM_FILES,
+           ok, &start);
+}
 
-    delete [] buffer;
-    delete openFile;
+static const char *WORKER_NAMES[NUM_WORKERS] = {
+    "fs worker 0", "fs worker 1", "fs worker 2", "fs worker 3"
+};
+static const char *WORKER_FILES[NUM_WORKERS] = {
+    "Worker0", "Worker1", "Worker2", "Worker3"
+};
+static bool workerOk[NUM_WORKERS];
+
+/// Write a file of its own, read it back, and remove it.
+static void
+Worker(void *n_)
+{
+    unsigned n = (unsigned) (uintptr_t) n_;
+    const char *name = WORKER_FILES[n];
+
+    workerOk[n] = FileWrite(name, WORKER_FILE_SIZE, CONTENT_SIZE)
+                  && FileRead(name, WORKER_FILE_SIZE, CONTENT_SIZE)
+                  && FileRemove(name);
+}
+
+/// Have `NUM_WORKERS` threads go through `Worker` at once.
+static void
+ConcurrentWorkload()
+{
+    Snapshot start;
+    TakeSnapshot(&start);
+
+    Thread *t[NUM_WORKERS];
+    for (unsigned i = 0; i < NUM_WORKERS; i++) {
+        t[i] = new Thread(WORKER_NAMES[i], true, PRIORITY_DEFAULT);
+        t[i]->Fork(Worker, (void *) (uintptr_t) i);
+    }
+    bool ok = true;
+    for (unsigned i = 0; i < NUM_WORKERS; i++) {
+        t[i]->Join();
+        ok = ok && workerOk[i];
+    }
+    Report("concurrent", WORKER_FILE_SIZE, CONTENT_SIZE,
+           2 * NUM_WORKERS * DivRoundUp(WORKER_FILE_SIZE, CONTENT_SIZE),
+           ok, &start);
 }
 
 void
 PerformanceTest()
 {
     printf("Starting file system performance test:\n");
-    stats->Print();
-    FileWrite();
-    FileRead();
-    if (!fileSystem->Remove(FILE_NAME)) {
-        printf("Perf test: unable to remove %s\n", FILE_NAME);
-        return;
+    for (unsigned i = 0; i < sizeof FILE_SIZES / sizeof *FILE_SIZES; i++) {
+        for (unsigned j = 0; j < sizeof CHUNK_SIZES / sizeof *CHUNK_SIZES;
+             j++) {
+            FileWorkloads(FILE_SIZES[i], CHUNK_SIZES[j]);
+        }
     }
+    StormWorkload();
+    ConcurrentWorkload();
     stats->Print();
 }
@@ -0,0 +1,93 @@
+/// Routines to share the headers of open files.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "inode_table.hh"
+#include "machine/disk.hh"
+
+
+Inode::Inode(int sector_)
+{
+    sector   = sector_;
+    hdr      = new FileHeader;
+    lock     = new RWLock("inode");
+    refCount = 0;
+    inTable  = true;
+    hdr->FetchFrom(sector);
+}
+
+Inode::~Inode()
+{
+    delete lock;
+    delete hdr;
+}
+
+InodeTable::InodeTable()
+{
+    inodeOf = new Inode * [diskSectors];
+    for (unsigned i = 0; i < diskSectors; i++) {
+        inodeOf[i] = nullptr;
+    }
+    lock = new Lock("inode table");
+}
+
+InodeTable::~InodeTable()
+{
+    for (unsigned i = 0; i < diskSectors; i++) {
+        delete inodeOf[i];
+    }
+    delete [] inodeOf;
+    delete lock;
+}
+
+/// The header is read with the lock held, so that a file opened by several
+/// threads at once is read once.
+Inode *
+InodeTable::Acquire(int sector)
+{
+    ASSERT(sector >= 0 && (unsigned) sector < diskSectors);
+
+    lock->Acquire();
+    Inode *inode = inodeOf[sector];
+    if (inode == nullptr) {
+        inode = new Inode(sector);
+        inodeOf[sector] = inode;
+    }
+    inode->refCount++;
+    lock->Release();
+    return inode;
+}
+
+void
+InodeTable::Release(Inode *inode)
+{
+    ASSERT(inode != nullptr);
+
+    lock->Acquire();
+    ASSERT(inode->refCount > 0);
+    inode->refCount--;
+    if (inode->refCount == 0) {
+        if (inode->inTable) {
+            inodeOf[inode->sector] = nullptr;
+        }
+        delete inode;
+    }
+    lock->Release();
+}
+
+void
+InodeTable::Forget(int sector)
+{
+    ASSERT(sector >= 0 && (unsigned) sector < diskSectors);
+
+    lock->Acquire();
+    Inode *inode = inodeOf[sector];
+    if (inode != nullptr) {
+        inode->inTable = false;
+        inodeOf[sector] = nullptr;
+    }
+    lock->Release();
+}
@@ -0,0 +1,69 @@
+/// Data structures to share the headers of open files.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_INODETABLE__HH
+#define NACHOS_FILESYS_INODETABLE__HH
+
+
+#include "file_header.hh"
+#include "threads/lock.hh"
+#include "threads/rw_lock.hh"
+
+
+/// What every `OpenFile` for the same file shares: its header, read from
+/// the disk once, and the lock on its contents.
+class Inode {
+public:
+    Inode(int sector_);
+    ~Inode();
+
+    int sector;  ///< Where `hdr` is kept on disk.
+    FileHeader *hdr;
+
+    /// Held for reading while reading the file, and for writing while
+    /// writing it, so that a read never sees half of a write.
+    RWLock *lock;
+
+    /// Number of `OpenFile`s using the inode.
+    unsigned refCount;
+
+    /// Whether the inode is still in the table; it is not once the file is
+    /// removed.
+    bool inTable;
+};
+
+/// The table of the inodes of the files open in the whole system, by the
+/// sector of their header.  An inode is made on the first open of its file,
+/// and goes away on the last close.
+class InodeTable {
+public:
+
+    /// Initialize an empty table.
+    InodeTable();
+
+    ~InodeTable();
+
+    /// Return the inode of the file whose header is at `sector`, reading
+    /// the header if the file is not open yet, and count one more user.
+    Inode *Acquire(int sector);
+
+    /// Count one less user of `inode`; free it if it was the last.
+    void Release(Inode *inode);
+
+    /// Take the inode of the file whose header is at `sector`, if open,
+    /// out of the table, since the file is removed and the sector may be
+    /// reused.  Users go on with the old header until they close it.
+    void Forget(int sector);
+
+private:
+    /// Inode of the file whose header is at each sector, or null.
+    Inode **inodeOf;
+
+    Lock *lock;
+};
+
+
+#endif
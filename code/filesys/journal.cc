@@ -0,0 +1,506 @@
+/// Routines for the journal of changes to the file system metadata.
+///
+/// The journal takes consecutive sectors.  The first one says the sequence
+/// of the group that goes right after it; the groups follow, in order, each
+/// one the sequence of the one before plus one.  A group is:
+///
+/// * descriptors, which list the sectors the group changed, and those it
+///   revoked, marked with `REVOKED`;
+/// * a copy of every sector changed, in the order listed;
+/// * a commit block, with a checksum of all the above.
+///
+/// Recovery takes groups from the start of the journal, as long as they
+/// have the sequence expected and a commit block that checks.  A sector
+/// revoked by a group is not written from a copy in a group before.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "journal.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+static const unsigned START_MAGIC      = 0x4A524E4C;
+static const unsigned DESCRIPTOR_MAGIC = 0x4A44534B;
+static const unsigned COMMIT_MAGIC     = 0x4A434D54;
+
+/// Marks an entry of a descriptor as revoked.
+static const unsigned REVOKED = 1U << 31;
+
+struct JournalStart {
+    unsigned magic;
+    unsigned sequence;
+};
+
+/// Entries listed by each descriptor.
+static const unsigned DESCRIPTOR_ENTRIES
+  = SECTOR_SIZE / sizeof (unsigned) - 4;
+
+struct JournalDescriptor {
+    unsigned magic;
+    unsigned sequence;
+    unsigned numEntries;  ///< Of the whole group.
+    unsigned numImages;
+    unsigned entries[DESCRIPTOR_ENTRIES];
+};
+
+struct JournalCommit {
+    unsigned magic;
+    unsigned sequence;
+    unsigned checksum;
+};
+
+/// FNV-1a of `length` bytes.
+static unsigned
+Checksum(const char *data, unsigned length)
+{
+    unsigned hash = 2166136261U;
+    for (unsigned i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) data[i]) * 16777619U;
+    }
+    return hash;
+}
+
+static void
+CommitHelper(void *journal_)
+{
+    ASSERT(journal_ != nullptr);
+    ((Journal *) journal_)->CommitLoop();
+}
+
+Journal::Journal()
+{
+    enabled  = false;
+    first    = 0;
+    size     = 0;
+    head     = 0;
+    sequence = 0;
+
+    lock    = new Lock("journal");
+    changed = new Condition("journal changed", lock);
+
+    active     = 0;
+    committing = false;
+    writing    = false;
+
+    group     = new int [diskSectors];
+    groupSize = 0;
+    inGroup   = new bool [diskSectors];
+    inFlight  = new bool [diskSectors];
+    revoked    = new int [diskSectors];
+    numRevoked = 0;
+    loggedAt  = new int [diskSectors];
+    for (unsigned i = 0; i < diskSectors; i++) {
+        inGroup[i]  = false;
+        inFlight[i] = false;
+        loggedAt[i] = -1;
+    }
+
+    commitScheduled = false;
+    commitPending   = new Semaphore("journal commit", 0);
+}
+
+Journal::~Journal()
+{
+    delete commitPending;
+    delete [] loggedAt;
+    delete [] revoked;
+    delete [] inFlight;
+    delete [] inGroup;
+    delete [] group;
+    delete changed;
+    delete lock;
+}
+
+void
+Journal::Open(unsigned first_, unsigned count, bool format)
+{
+    ASSERT(count >= 2 && first_ + count <= diskSectors);
+
+    first = first_;
+    size  = count;
+    if (format) {
+        char *zeros = new char [size * SECTOR_SIZE];
+        memset(zeros, 0, size * SECTOR_SIZE);
+        synchDisk->WaitFor(synchDisk->Submit(first, zeros, true, size));
+        delete [] zeros;
+        sequence = 1;
+        WriteStart();
+    } else {
+        Recover();
+    }
+    head = 1;
+
+    enabled = synchDisk->GetCacheSize() >= MIN_CACHE_SIZE;
+    if (enabled) {
+        Thread *t = new Thread("journal", false, PRIORITY_DEFAULT);
+        t->Fork(CommitHelper, this);
+    }
+}
+
+/// An operation that would start a group too large commits the running one
+/// first.  No lock of the file system is held, so that the operations going
+/// on can end.
+void
+Journal::Begin()
+{
+    if (!enabled) {
+        return;
+    }
+    lock->Acquire();
+    while (committing) {
+        changed->Wait();
+    }
+    if (groupSize >= GROUP_SECTORS) {
+        lock->Release();
+        Commit();
+        lock->Acquire();
+        while (committing) {
+            changed->Wait();
+        }
+    }
+    active++;
+    lock->Release();
+}
+
+void
+Journal::End()
+{
+    if (!enabled) {
+        return;
+    }
+    lock->Acquire();
+    ASSERT(active > 0);
+    active--;
+    if (active == 0) {
+        changed->Broadcast();
+    }
+    if ((groupSize > 0 || numRevoked > 0) && !commitScheduled) {
+        commitScheduled = true;
+        commitPending->V();
+    }
+    lock->Release();
+}
+
+void
+Journal::WriteSector(int sector, const char *data)
+{
+    ASSERT(sector >= 0 && (unsigned) sector < diskSectors);
+    ASSERT(data != nullptr);
+
+    dirtyMap->Note(sector);
+    if (!enabled) {
+        synchDisk->WriteSector(sector, data);
+        return;
+    }
+    lock->Acquire();
+    ASSERT(active > 0);
+    if (!inGroup[sector]) {
+        ASSERT(GroupLength(groupSize + numRevoked + 1, groupSize + 1)
+               < size);
+        inGroup[sector] = true;
+        group[groupSize++] = sector;
+    }
+    synchDisk->WriteHeld(sector, data);
+    lock->Release();
+}
+
+void
+Journal::WriteSectors(int firstSector, unsigned count, const char *data)
+{
+    ASSERT(data != nullptr);
+
+    for (unsigned i = 0; i < count; i++) {
+        WriteSector(firstSector + i, &data[i * SECTOR_SIZE]);
+    }
+}
+
+/// A sector only changed by the running group just leaves it; one with a
+/// copy committed, or on its way, needs to be listed.  A sector on its way
+/// stays held until it gets there.
+void
+Journal::Revoke(int sector)
+{
+    ASSERT(sector >= 0 && (unsigned) sector < diskSectors);
+
+    if (!enabled) {
+        return;
+    }
+    lock->Acquire();
+    ASSERT(active > 0);
+    if (inGroup[sector]) {
+        unsigned i = 0;
+        while (group[i] != sector) {
+            i++;
+        }
+        group[i] = group[--groupSize];
+        inGroup[sector] = false;
+        if (!inFlight[sector]) {
+            synchDisk->Unhold(sector);
+        }
+    }
+    if (loggedAt[sector] >= 0 || inFlight[sector]) {
+        bool listed = false;
+        for (unsigned i = 0; i < numRevoked && !listed; i++) {
+            listed = revoked[i] == sector;
+        }
+        if (!listed) {
+            ASSERT(GroupLength(groupSize + numRevoked + 1, groupSize)
+                   < size);
+            revoked[numRevoked++] = sector;
+        }
+    }
+    lock->Release();
+}
+
+/// Only one thread commits at a time; one coming meanwhile commits what
+/// gathered since, if anything, once the group before is written.
+void
+Journal::Commit()
+{
+    if (!enabled) {
+        return;
+    }
+    lock->Acquire();
+    while (committing || writing) {
+        changed->Wait();
+    }
+    if (groupSize > 0 || numRevoked > 0) {
+        committing = true;
+        while (active > 0) {
+            changed->Wait();
+        }
+        WriteGroup();
+    }
+    lock->Release();
+}
+
+void
+Journal::Flush()
+{
+    if (!enabled) {
+        return;
+    }
+    Commit();
+    lock->Acquire();
+    while (committing || writing) {
+        changed->Wait();
+    }
+    Checkpoint();
+    lock->Release();
+}
+
+void
+Journal::CommitLoop()
+{
+    for (;;) {
+        commitPending->P();
+        alarmClock->WaitUntil(COMMIT_TICKS);
+        commitScheduled = false;
+        DEBUG('f', "Committing %u sectors to the journal\n", groupSize);
+        Commit();
+    }
+}
+
+unsigned
+Journal::GroupLength(unsigned numEntries, unsigned numImages)
+{
+    return DivRoundUp(numEntries, DESCRIPTOR_ENTRIES) + numImages + 1;
+}
+
+/// The copies are taken from the cache, where the sectors are held; they
+/// are let go once the group is on the disk, unless the next group changed
+/// them meanwhile.
+void
+Journal::WriteGroup()
+{
+    unsigned numEntries = groupSize + numRevoked;
+    unsigned numDescriptors = DivRoundUp(numEntries, DESCRIPTOR_ENTRIES);
+    unsigned length = GroupLength(numEntries, groupSize);
+    ASSERT(length < size);
+    if (head + length > size) {
+        Checkpoint();
+    }
+
+    char *buffer = new char [length * SECTOR_SIZE];
+    memset(buffer, 0, numDescriptors * SECTOR_SIZE);
+    for (unsigned i = 0; i < numEntries; i++) {
+        JournalDescriptor *d
+          = (JournalDescriptor *) &buffer[i / DESCRIPTOR_ENTRIES
+                                          * SECTOR_SIZE];
+        d->magic      = DESCRIPTOR_MAGIC;
+        d->sequence   = sequence;
+        d->numEntries = numEntries;
+        d->numImages  = groupSize;
+        d->entries[i % DESCRIPTOR_ENTRIES]
+          = i < groupSize ? group[i] : revoked[i - groupSize] | REVOKED;
+    }
+    for (unsigned i = 0; i < groupSize; i++) {
+        synchDisk->ReadSector(group[i],
+                              &buffer[(numDescriptors + i) * SECTOR_SIZE]);
+    }
+    JournalCommit *c
+      = (JournalCommit *) &buffer[(length - 1) * SECTOR_SIZE];
+    memset(c, 0, SECTOR_SIZE);
+    c->magic    = COMMIT_MAGIC;
+    c->sequence = sequence;
+    c->checksum = Checksum(buffer, (length - 1) * SECTOR_SIZE);
+
+    // Make way for the next group.
+    unsigned numImages = groupSize, numGone = numRevoked;
+    int *images = new int [numImages];
+    int *gone   = new int [numGone];
+    memcpy(images, group, numImages * sizeof (int));
+    memcpy(gone, revoked, numGone * sizeof (int));
+    for (unsigned i = 0; i < numImages; i++) {
+        inGroup[images[i]]  = false;
+        inFlight[images[i]] = true;
+    }
+    unsigned at = head;
+    head += length;
+    sequence++;
+    groupSize  = 0;
+    numRevoked = 0;
+    committing = false;
+    writing    = true;
+    changed->Broadcast();
+
+    lock->Release();
+    synchDisk->WaitFor(synchDisk->Submit(first + at, buffer, true, length));
+    lock->Acquire();
+    delete [] buffer;
+
+    for (unsigned i = 0; i < numGone; i++) {
+        loggedAt[gone[i]] = -1;
+    }
+    for (unsigned i = 0; i < numImages; i++) {
+        loggedAt[images[i]] = at + numDescriptors + i;
+        inFlight[images[i]] = false;
+        if (!inGroup[images[i]]) {
+            synchDisk->Unhold(images[i]);
+        }
+    }
+    delete [] images;
+    delete [] gone;
+    stats->numJournalCommits++;
+    stats->numJournalSectors += length;
+    writing = false;
+    changed->Broadcast();
+}
+
+/// A sector changed again by the running group is held in the cache with
+/// what is not committed yet, so the copy in the journal is written to its
+/// place instead.
+void
+Journal::Checkpoint()
+{
+    DEBUG('f', "Checkpointing the journal\n");
+    char data[SECTOR_SIZE];
+    for (unsigned s = 0; s < diskSectors; s++) {
+        if (loggedAt[s] < 0) {
+            continue;
+        }
+        if (inGroup[s]) {
+            synchDisk->WaitFor(synchDisk->Submit(first + loggedAt[s], data,
+                                                 false));
+            synchDisk->WaitFor(synchDisk->Submit(s, data, true));
+        } else {
+            synchDisk->FlushSector(s);
+        }
+        loggedAt[s] = -1;
+    }
+    WriteStart();
+    head = 1;
+    stats->numJournalCheckpoints++;
+}
+
+/// The whole journal is read at once.  Groups are looked at twice: first to
+/// find how far they go and what they revoke, and then to write them.
+void
+Journal::Recover()
+{
+    char *buffer = new char [size * SECTOR_SIZE];
+    synchDisk->WaitFor(synchDisk->Submit(first, buffer, false, size));
+
+    const JournalStart *start = (const JournalStart *) buffer;
+    unsigned firstSequence = start->magic == START_MAGIC ? start->sequence
+                                                         : 1;
+
+    // Sequence of the last group revoking each sector, or 0 if none.
+    unsigned *revokedBy = new unsigned [diskSectors];
+    for (unsigned i = 0; i < diskSectors; i++) {
+        revokedBy[i] = 0;
+    }
+
+    unsigned end = 1;
+    sequence = firstSequence;
+    while (start->magic == START_MAGIC && end < size) {
+        const JournalDescriptor *d
+          = (const JournalDescriptor *) &buffer[end * SECTOR_SIZE];
+        if (d->magic != DESCRIPTOR_MAGIC || d->sequence != sequence
+              || d->numImages > d->numEntries
+              || end + GroupLength(d->numEntries, d->numImages) > size) {
+            break;
+        }
+        unsigned length = GroupLength(d->numEntries, d->numImages);
+        const JournalCommit *c = (const JournalCommit *)
+                                   &buffer[(end + length - 1) * SECTOR_SIZE];
+        if (c->magic != COMMIT_MAGIC || c->sequence != sequence
+              || c->checksum != Checksum(&buffer[end * SECTOR_SIZE],
+                                         (length - 1) * SECTOR_SIZE)) {
+            break;
+        }
+        for (unsigned i = d->numImages; i < d->numEntries; i++) {
+            const JournalDescriptor *di = (const JournalDescriptor *)
+              &buffer[(end + i / DESCRIPTOR_ENTRIES) * SECTOR_SIZE];
+            unsigned sector = di->entries[i % DESCRIPTOR_ENTRIES] & ~REVOKED;
+            ASSERT(sector < diskSectors);
+            revokedBy[sector] = sequence;
+        }
+        end += length;
+        sequence++;
+    }
+
+    unsigned numGroups = sequence - firstSequence;
+    unsigned at = 1;
+    for (unsigned g = firstSequence; g < sequence; g++) {
+        const JournalDescriptor *d
+          = (const JournalDescriptor *) &buffer[at * SECTOR_SIZE];
+        unsigned numDescriptors = DivRoundUp(d->numEntries,
+                                             DESCRIPTOR_ENTRIES);
+        for (unsigned i = 0; i < d->numImages; i++) {
+            const JournalDescriptor *di = (const JournalDescriptor *)
+              &buffer[(at + i / DESCRIPTOR_ENTRIES) * SECTOR_SIZE];
+            unsigned sector = di->entries[i % DESCRIPTOR_ENTRIES];
+            ASSERT(sector < diskSectors);
+            if (revokedBy[sector] <= g) {
+                synchDisk->WriteSector(sector,
+                  &buffer[(at + numDescriptors + i) * SECTOR_SIZE]);
+            }
+        }
+        at += GroupLength(d->numEntries, d->numImages);
+    }
+    delete [] revokedBy;
+    delete [] buffer;
+
+    if (numGroups > 0) {
+        DEBUG('f', "Recovered %u groups from the journal\n", numGroups);
+        synchDisk->Flush();
+    }
+    WriteStart();
+}
+
+void
+Journal::WriteStart()
+{
+    char data[SECTOR_SIZE];
+    memset(data, 0, sizeof data);
+    JournalStart *start = (JournalStart *) data;
+    start->magic    = START_MAGIC;
+    start->sequence = sequence;
+    synchDisk->WaitFor(synchDisk->Submit(first, data, true));
+}
@@ -0,0 +1,159 @@
+/// Data structures for the journal of changes to the file system metadata.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_JOURNAL__HH
+#define NACHOS_FILESYS_JOURNAL__HH
+
+
+#include "threads/condition.hh"
+#include "threads/lock.hh"
+#include "threads/semaphore.hh"
+
+
+/// A write-ahead journal of the metadata: file headers, index blocks,
+/// directories and the free map.  An operation that changes them, such as
+/// creating a file, writes the sectors it changes through the journal,
+/// between `Begin` and `End`.
+///
+/// Those sectors are held in the disk cache, and do not reach their place
+/// on the disk, until they are in the journal.  Operations join the
+/// running group; a whole group is committed at once, `COMMIT_TICKS` after
+/// its first operation ends, by writing a copy of every sector it changed,
+/// and a commit block, in one request to the consecutive sectors of the
+/// journal.  Operations only wait while the copies are taken: the next
+/// group starts while the request is on its way.  After a crash, the groups committed are written again to their
+/// places, and those that were not are lost whole, so that the file system
+/// is never left half changed; this takes reading the journal, not checking
+/// the whole disk.
+///
+/// Once the journal is full, the sectors in it are written to their places
+/// for good, and it starts over.
+///
+/// Holding sectors takes room in the cache: the journal is off, and
+/// metadata is written as any other sector, with a cache of fewer than
+/// `MIN_CACHE_SIZE` sectors.
+class Journal {
+public:
+
+    /// Sectors taken by the journal on the disk.
+    static const unsigned NUM_JOURNAL_SECTORS = 64;
+
+    /// Sectors a group may hold before an operation starting commits it
+    /// first.
+    static const unsigned GROUP_SECTORS = 16;
+
+    /// Ticks a group of changes may wait before being committed.
+    static const unsigned long COMMIT_TICKS = 20000;
+
+    /// Smallest disk cache the journal is used with.
+    static const unsigned MIN_CACHE_SIZE = 64;
+
+    /// Initialize a journal that is off, and writes straight to the disk,
+    /// until `Open`.
+    Journal();
+
+    ~Journal();
+
+    /// Keep the journal in the `count` consecutive sectors from `first` on.
+    /// If `format`, start it empty; otherwise, redo the groups committed in
+    /// it first.
+    void Open(unsigned first, unsigned count, bool format);
+
+    /// Start and end an operation that changes metadata.  `Begin` must be
+    /// called before taking any lock of the file system, as it may wait for
+    /// the running group to commit.
+    void Begin();
+    void End();
+
+    /// Write metadata, within an operation.
+    void WriteSector(int sector, const char *data);
+    void WriteSectors(int firstSector, unsigned count, const char *data);
+
+    /// Tell that `sector`, which held metadata, is free now, so that what
+    /// the journal has of it is not written over whatever it holds next.
+    /// Within an operation.
+    void Revoke(int sector);
+
+    /// Commit the running group, and return once it is in the journal.  Not
+    /// within an operation.
+    void Commit();
+
+    /// Commit the running group, and write every sector in the journal to
+    /// its place, so that nothing in it is redone after a crash.  Not within
+    /// an operation.
+    void Flush();
+
+    /// Commit groups behind, forever.  Run by the journal thread.
+    void CommitLoop();
+
+private:
+
+    /// Commit the running group, which must have no operation going.  The
+    /// lock must be held; it is let go while writing, once the next group
+    /// may start.
+    void WriteGroup();
+
+    /// Write every sector in the journal to its place, and start the
+    /// journal over.  The lock must be held.
+    void Checkpoint();
+
+    /// Write the groups committed in the journal to their places, and
+    /// start it over.
+    void Recover();
+
+    /// Write the first sector of the journal, which says the sequence of
+    /// the group that goes next to it.
+    void WriteStart();
+
+    /// Sectors taken by a group of `numEntries` sectors changed or revoked,
+    /// of which `numImages` changed.
+    static unsigned GroupLength(unsigned numEntries, unsigned numImages);
+
+    bool enabled;
+
+    /// Where the journal is, and how long it is.
+    unsigned first;
+    unsigned size;
+
+    /// Where in the journal the next group goes, and its sequence.
+    unsigned head;
+    unsigned sequence;
+
+    Lock *lock;
+    Condition *changed;  ///< Signalled when `active` or `committing` do.
+
+    /// Number of operations of the running group going on; whether the
+    /// group is being committed, in which case no operation may begin; and
+    /// whether the group before is still being written, in which case no
+    /// other may be committed.
+    unsigned active;
+    bool committing;
+    bool writing;
+
+    /// Sectors changed by the running group, and whether each sector is.
+    int *group;
+    unsigned groupSize;
+    bool *inGroup;
+
+    /// Whether each sector is in the group being written.
+    bool *inFlight;
+
+    /// Sectors revoked by the running group.
+    int *revoked;
+    unsigned numRevoked;
+
+    /// Where in the journal the latest copy of each sector is, or -1 if
+    /// there is none.
+    int *loggedAt;
+
+    /// Whether the journal thread has been told to commit the running
+    /// group, and what tells it.
+    bool commitScheduled;
+    Semaphore *commitPending;
+};
+
+
+#endif
@@ -13,7 +13,10 @@
 
 #include "open_file.hh"
 #include "file_header.hh"
+#include "inode_table.hh"
+#include "threads/rw_lock.hh"
 #include "threads/system.hh"
+#include "lib/slab.hh"
 
 #include <string.h>
 
@@ -22,17 +25,48 @@
 /// memory while the file is open.
 ///
 /// * `sector` is the location on disk of the file header for this file.
-OpenFile::OpenFile(int sector)
+/// * `metadata_` tells whether the file holds metadata of the file system.
+OpenFile::OpenFile(int sector, bool metadata_)
 {
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    inode = inodeTable->Acquire(sector);
+    hdr = inode->hdr;
     seekPosition = 0;
+    headerSector = sector;
+    metadata     = metadata_;
+    direct       = false;
+    generation   = pageCache->Generation(sector);
+    nextSector      = 0;
+    readAheadWindow = 0;
+    readAheadEnd    = 0;
 }
 
 /// Close a Nachos file, de-allocating any in-memory data structures.
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    inodeTable->Release(inode);
+}
+
+static Slab openFileSlab("OpenFile", sizeof (OpenFile));
+
+void *
+OpenFile::operator new(size_t size)
+{
+    ASSERT(size == sizeof (OpenFile));
+    return openFileSlab.Allocate();
+}
+
+void
+OpenFile::operator delete(void *p)
+{
+    if (p != nullptr) {
+        openFileSlab.Free(p);
+    }
+}
+
+int
+OpenFile::GetSector() const
+{
+    return headerSector;
 }
 
 /// Change the current location within the open file -- the point at which
@@ -90,13 +124,20 @@ OpenFile::Write(const char *into, unsigned numBytes)
 /// sector at a time.  Thus:
 ///
 /// For ReadAt:
-///     We read in all of the full or partial sectors that are part of the
-///     request, but we only copy the part we are interested in.
+///     Whole sectors are read straight into the caller's buffer; a
+///     sector only part of which is wanted is read into a sector on the
+///     stack, and only that part copied.  A file kept in its header is
+///     copied from there.  Holes are not read, but filled with zeros.
+///     Blocks in the page cache are copied from there instead.
 /// For WriteAt:
 ///     We must first read in any sectors that will be partially written, so
-///     that we do not overwrite the unmodified portion.  We then copy in the
-///     data that will be modified, and write back all the full or partial
-///     sectors that are part of the request.
+///     that we do not overwrite the unmodified portion; there are two at
+///     most, the first and the last, read in one request if they are next
+///     to each other.  We then copy in the data that will be modified, and
+///     write them back; whole sectors are written straight from the
+///     caller's buffer.  A file kept in its header is written there, and
+///     the header written back.  Holes written to get sectors first, and
+///     read as zeros.
 ///
 /// * `into` is the buffer to contain the data to be read from disk.
 /// * `from` is the buffer containing the data to be written to disk.
@@ -110,11 +151,12 @@ OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
     ASSERT(into != nullptr);
     ASSERT(numBytes > 0);
 
+    inode->lock->AcquireRead();
     unsigned fileLength = hdr->FileLength();
-    unsigned firstSector, lastSector, numSectors;
-    char *buf;
+    unsigned firstSector, lastSector;
 
     if (position >= fileLength) {
+        inode->lock->ReleaseRead();
         return 0;  // Check request.
     }
     if (position + numBytes > fileLength) {
@@ -123,34 +165,376 @@ OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
     DEBUG('f', "Reading %u bytes at %u, from file of length %u.\n",
           numBytes, position, fileLength);
 
+    if (hdr->IsInline()) {
+        hdr->ReadInline(into, numBytes, position);
+        inode->lock->ReleaseRead();
+        return numBytes;
+    }
+
     firstSector = DivRoundDown(position, SECTOR_SIZE);
     lastSector = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
-    numSectors = 1 + lastSector - firstSector;
+    unsigned end = position + numBytes;
+    char partial[SECTOR_SIZE];
+    unsigned i = firstSector;
 
-    // Read in all the full and partial sectors that we need.
-    buf = new char [numSectors * SECTOR_SIZE];
-    for (unsigned i = firstSector; i <= lastSector; i++) {
-        synchDisk->ReadSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                              &buf[(i - firstSector) * SECTOR_SIZE]);
+    // The first sector, if only part of it is wanted.
+    unsigned offset = position % SECTOR_SIZE;
+    if (offset != 0 || end < (firstSector + 1) * SECTOR_SIZE) {
+        unsigned n = SECTOR_SIZE - offset < numBytes ? SECTOR_SIZE - offset
+                                                     : numBytes;
+        ReadBlock(i, partial);
+        memcpy(into, &partial[offset], n);
+        into += n;
+        i++;
+    }
+
+    // The whole sectors, a run of consecutive ones at a time.
+    while (i < end / SECTOR_SIZE) {
+        unsigned n = RunLength(i, end / SECTOR_SIZE - 1);
+        ReadBlocks(i, n, into);
+        into += n * SECTOR_SIZE;
+        i += n;
     }
 
-    // Copy the part we want.
-    memcpy(into, &buf[position - firstSector * SECTOR_SIZE], numBytes);
-    delete [] buf;
+    // The last sector, if only part of it is wanted.
+    if (i <= lastSector) {
+        ReadBlock(i, partial);
+        memcpy(into, partial, end % SECTOR_SIZE);
+    }
+
+    ReadAhead(firstSector, lastSector);
+    inode->lock->ReleaseRead();
     return numBytes;
 }
 
+void
+OpenFile::ReadBlock(unsigned block, char *data)
+{
+    ReadBlocks(block, 1, data);
+}
+
+/// Blocks found in the page cache split the run, and what is left of it
+/// between them is read in one request each.
+void
+OpenFile::ReadBlocks(unsigned first, unsigned count, char *data)
+{
+    unsigned sector = hdr->ByteToSector(first * SECTOR_SIZE);
+    if (sector == HOLE) {
+        memset(data, 0, count * SECTOR_SIZE);
+        return;
+    }
+    if (!Cached()) {
+        ReadSectors(sector, count, data);
+        return;
+    }
+
+    unsigned i = 0;
+    while (i < count) {
+        unsigned start = i;
+        while (i < count
+               && !pageCache->Read(headerSector, generation, first + i,
+                                   &data[i * SECTOR_SIZE])) {
+            i++;
+        }
+        if (i > start) {
+            ReadSectors(sector + start, i - start,
+                        &data[start * SECTOR_SIZE]);
+            for (unsigned j = start; j < i && !direct; j++) {
+                pageCache->Insert(headerSector, generation, first + j,
+                                  &data[j * SECTOR_SIZE]);
+            }
+        }
+        i++;  // Found in the cache, or past the end.
+    }
+}
+
+bool
+OpenFile::Cached() const
+{
+    return !metadata;
+}
+
+void
+OpenFile::SetDirect(bool direct_)
+{
+    direct = direct_ && !metadata;
+}
+
+bool
+OpenFile::IsDirect() const
+{
+    return direct;
+}
+
+int
+OpenFile::ReadScattered(char *const *blocks, unsigned count)
+{
+    ASSERT(blocks != nullptr);
+
+    inode->lock->AcquireRead();
+    unsigned fileLength = hdr->FileLength();
+    if (seekPosition % SECTOR_SIZE != 0 || seekPosition >= fileLength
+          || hdr->IsInline()) {
+        inode->lock->ReleaseRead();
+        return 0;
+    }
+    unsigned first = seekPosition / SECTOR_SIZE;
+    if (count > (fileLength - seekPosition) / SECTOR_SIZE) {
+        count = (fileLength - seekPosition) / SECTOR_SIZE;
+    }
+    for (unsigned i = 0; i < count;) {
+        unsigned n = RunLength(first + i, first + count - 1);
+        ReadBlockList(first + i, n, &blocks[i]);
+        i += n;
+    }
+    if (count > 0) {
+        ReadAhead(first, first + count - 1);
+    }
+    inode->lock->ReleaseRead();
+
+    seekPosition += count * SECTOR_SIZE;
+    return count * SECTOR_SIZE;
+}
+
+/// Writing over blocks the file already has changes no metadata, so,
+/// unlike `WriteAt`, this is no operation for the journal.  Metadata is
+/// never written this way.
+int
+OpenFile::WriteGathered(const char *const *blocks, unsigned count)
+{
+    ASSERT(blocks != nullptr);
+
+    inode->lock->AcquireWrite();
+    unsigned fileLength = hdr->FileLength();
+    if (seekPosition % SECTOR_SIZE != 0 || seekPosition >= fileLength
+          || hdr->IsInline() || metadata) {
+        inode->lock->ReleaseWrite();
+        return 0;
+    }
+    unsigned first = seekPosition / SECTOR_SIZE;
+    if (count > (fileLength - seekPosition) / SECTOR_SIZE) {
+        count = (fileLength - seekPosition) / SECTOR_SIZE;
+    }
+    unsigned i = 0;
+    while (i < count
+           && hdr->ByteToSector((first + i) * SECTOR_SIZE) != HOLE) {
+        unsigned n = RunLength(first + i, first + count - 1);
+        WriteBlockList(first + i, n, &blocks[i]);
+        i += n;
+    }
+    inode->lock->ReleaseWrite();
+#ifdef USER_PROGRAM
+    if (i > 0) {
+        InvalidateImage(nullptr, headerSector);
+    }
+#endif
+
+    seekPosition += i * SECTOR_SIZE;
+    return i * SECTOR_SIZE;
+}
+
+/// A direct file reads its run in one request, but for the blocks found
+/// in the page cache.  Any other reads one block at a time, as it has no
+/// use for the buffers being apart.
+void
+OpenFile::ReadBlockList(unsigned first, unsigned count, char *const *blocks)
+{
+    unsigned sector = hdr->ByteToSector(first * SECTOR_SIZE);
+    if (!direct || sector == HOLE) {
+        for (unsigned i = 0; i < count; i++) {
+            ReadBlock(first + i, blocks[i]);
+        }
+        return;
+    }
+
+    unsigned i = 0;
+    while (i < count) {
+        unsigned start = i;
+        while (i < count
+               && !pageCache->Read(headerSector, generation, first + i,
+                                   blocks[i])) {
+            i++;
+        }
+        if (i > start) {
+            synchDisk->ReadScattered(sector + start, i - start,
+                                     &blocks[start]);
+        }
+        i++;  // Found in the cache, or past the end.
+    }
+}
+
+void
+OpenFile::WriteBlockList(unsigned first, unsigned count,
+                         const char *const *blocks)
+{
+    if (!direct) {
+        for (unsigned i = 0; i < count; i++) {
+            WriteBlocks(first + i, 1, blocks[i]);
+        }
+        return;
+    }
+
+    synchDisk->WriteGathered(hdr->ByteToSector(first * SECTOR_SIZE), count,
+                             blocks);
+    for (unsigned i = 0; i < count; i++) {
+        pageCache->Update(headerSector, generation, first + i, blocks[i]);
+    }
+}
+
+void
+OpenFile::ReadSectors(unsigned sector, unsigned count, char *data) const
+{
+    if (direct) {
+        synchDisk->ReadDirect(sector, count, data);
+    } else {
+        synchDisk->ReadSectors(sector, count, data);
+    }
+}
+
+void
+OpenFile::WriteSectors(unsigned sector, unsigned count,
+                       const char *data) const
+{
+    if (direct) {
+        synchDisk->WriteDirect(sector, count, data);
+    } else {
+        synchDisk->WriteSectors(sector, count, data);
+    }
+}
+
+/// A run of holes counts as a run too.
+unsigned
+OpenFile::RunLength(unsigned first, unsigned last)
+{
+    unsigned sector = hdr->ByteToSector(first * SECTOR_SIZE);
+    unsigned n = 1;
+    for (; first + n <= last; n++) {
+        unsigned next = hdr->ByteToSector((first + n) * SECTOR_SIZE);
+        if (sector == HOLE ? next != HOLE : next != sector + n) {
+            break;
+        }
+    }
+    return n;
+}
+
+/// A read that starts where the last one ended, or in its last sector, is
+/// sequential, and doubles the window read ahead, up to `MAX_READ_AHEAD`;
+/// any other read closes it, unless it starts the file over.  Sectors
+/// already asked for are not asked for again, so that each read only tops
+/// up the window.  Nothing is read ahead for direct reads, which would not
+/// find it in the cache.
+void
+OpenFile::ReadAhead(unsigned first, unsigned last)
+{
+    if (direct) {
+        return;
+    }
+    bool sequential = first == nextSector || first + 1 == nextSector;
+    if (sequential && last + 1 == nextSector) {
+        return;  // Nothing new was read.
+    }
+    if (!sequential) {
+        readAheadWindow = first == 0 ? MIN_READ_AHEAD : 0;
+        readAheadEnd    = 0;
+    } else if (readAheadWindow == 0) {
+        readAheadWindow = MIN_READ_AHEAD;
+    } else if (2 * readAheadWindow <= MAX_READ_AHEAD) {
+        readAheadWindow *= 2;
+    }
+    nextSector = last + 1;
+
+    unsigned numSectors = DivRoundUp(hdr->FileLength(), SECTOR_SIZE);
+    unsigned end = nextSector + readAheadWindow;
+    if (end > numSectors) {
+        end = numSectors;
+    }
+    unsigned i = readAheadEnd > nextSector ? readAheadEnd : nextSector;
+    for (; i < end; i++) {
+        unsigned sector = hdr->ByteToSector(i * SECTOR_SIZE);
+        if (sector != HOLE) {
+            synchDisk->ReadAhead(sector);
+        }
+    }
+    if (end > readAheadEnd) {
+        readAheadEnd = end;
+    }
+}
+
+/// A write past the end of the file makes it grow; the bytes between the
+/// end and `position`, if any, read as zeros.  Those in blocks of their own
+/// are left as holes, but for blocks the file already had room in.
+///
+/// A write to a file that is not metadata is an operation of its own for
+/// the journal, as the file may grow; a file of metadata is written within
+/// the operation that changes it.
 int
 OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
 {
     ASSERT(from != nullptr);
     ASSERT(numBytes > 0);
 
+    static const char ZEROS[SECTOR_SIZE] = { 0 };
+
+    if (!metadata) {
+        journal->Begin();
+    }
+    inode->lock->AcquireWrite();
+    int numWritten = 0;
+    while (hdr->FileLength() < position) {
+        unsigned length = hdr->FileLength();
+        if (length % SECTOR_SIZE == 0 && length >= hdr->AllocatedLength()) {
+            if (fileSystem->ExtendSparse(hdr, headerSector, position)) {
+                hdr->SetLength(position);
+                hdr->WriteBack(headerSector);
+            }
+            break;
+        }
+        unsigned n = SECTOR_SIZE - length % SECTOR_SIZE;
+        if (n > position - length) {
+            n = position - length;
+        }
+        if (WriteLocked(ZEROS, n, length) < (int) n) {
+            break;  // No room left for the gap.
+        }
+    }
+    if (hdr->FileLength() >= position) {
+        numWritten = WriteLocked(from, numBytes, position);
+    }
+    inode->lock->ReleaseWrite();
+    if (!metadata) {
+        journal->End();
+    }
+#ifdef USER_PROGRAM
+    InvalidateImage(nullptr, headerSector);
+#endif
+    return numWritten;
+}
+
+/// Make the file longer, if the write ends past it, taking more space if
+/// what it has is not enough; what does not fit is not written.
+int
+OpenFile::WriteLocked(const char *from, unsigned numBytes, unsigned position)
+{
     unsigned fileLength = hdr->FileLength();
-    unsigned firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    unsigned firstSector, lastSector;
 
+    if (position + numBytes > fileLength) {
+        unsigned end = position + numBytes;
+        if (end > MaxFileSize()) {
+            end = MaxFileSize();
+        }
+        if (end > hdr->AllocatedLength()
+              && !fileSystem->Extend(hdr, headerSector, end)) {
+            end = hdr->AllocatedLength();
+        }
+        if (end > fileLength) {
+            hdr->SetLength(end);
+            if (!hdr->IsInline()) {
+                hdr->WriteBack(headerSector);  // Otherwise, written below.
+            }
+            fileLength = end;
+        }
+    }
     if (position >= fileLength) {
         return 0;  // Check request.
     }
@@ -160,34 +544,185 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
     DEBUG('f', "Writing %u bytes at %u, from file of length %u.\n",
           numBytes, position, fileLength);
 
+    if (hdr->IsInline()) {
+        hdr->WriteInline(from, numBytes, position);
+        hdr->WriteBack(headerSector);
+        return numBytes;
+    }
+
     firstSector = DivRoundDown(position, SECTOR_SIZE);
     lastSector  = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
-    numSectors  = 1 + lastSector - firstSector;
-
-    buf = new char [numSectors * SECTOR_SIZE];
+    unsigned end = position + numBytes;
+    unsigned offset = position % SECTOR_SIZE;
+    bool firstPartial = offset != 0
+                        || end < (firstSector + 1) * SECTOR_SIZE;
+    bool lastPartial  = end % SECTOR_SIZE != 0 && lastSector != firstSector;
 
-    firstAligned = position == firstSector * SECTOR_SIZE;
-    lastAligned  = position + numBytes == (lastSector + 1) * SECTOR_SIZE;
+    // Take sectors for the holes written to; those partially written start
+    // as zeros.
+    bool firstHole = hdr->ByteToSector(firstSector * SECTOR_SIZE) == HOLE;
+    bool lastHole  = hdr->ByteToSector(lastSector * SECTOR_SIZE) == HOLE;
+    for (unsigned i = firstSector; i <= lastSector; i++) {
+        if (hdr->ByteToSector(i * SECTOR_SIZE) == HOLE) {
+            if (!fileSystem->FillHoles(hdr, headerSector, i, lastSector)) {
+                return 0;  // No room for them.
+            }
+            hdr->WriteBack(headerSector);
+            break;
+        }
+    }
 
     // Read in first and last sector, if they are to be partially modified.
-    if (!firstAligned) {
-        ReadAt(buf, SECTOR_SIZE, firstSector * SECTOR_SIZE);
+    // This goes straight to the disk, as there is no reason to read ahead.
+    char edges[2 * SECTOR_SIZE];
+    char *last = &edges[SECTOR_SIZE];
+    if (firstPartial && lastPartial && lastSector == firstSector + 1
+          && !firstHole && !lastHole
+          && RunLength(firstSector, lastSector) == 2) {
+        ReadSectors(hdr->ByteToSector(firstSector * SECTOR_SIZE), 2, edges);
+    } else {
+        if (firstPartial) {
+            if (firstHole) {
+                memset(edges, 0, SECTOR_SIZE);
+            } else {
+                ReadBlock(firstSector, edges);
+            }
+        }
+        if (lastPartial) {
+            if (lastHole) {
+                memset(last, 0, SECTOR_SIZE);
+            } else {
+                ReadBlock(lastSector, last);
+            }
+        }
+    }
+
+    // Copy in the bytes we want to change, and write the sectors back.
+    unsigned i = firstSector;
+    const char *data = from;
+    if (firstPartial) {
+        unsigned n = SECTOR_SIZE - offset < numBytes ? SECTOR_SIZE - offset
+                                                     : numBytes;
+        memcpy(&edges[offset], data, n);
+        WriteBlocks(i, 1, edges);
+        data += n;
+        i++;
+    }
+    while (i < end / SECTOR_SIZE) {
+        unsigned n = RunLength(i, end / SECTOR_SIZE - 1);
+        WriteBlocks(i, n, data);
+        data += n * SECTOR_SIZE;
+        i += n;
+    }
+    if (lastPartial) {
+        memcpy(last, data, end % SECTOR_SIZE);
+        WriteBlocks(i, 1, last);
+    }
+    return numBytes;
+}
+
+void
+OpenFile::WriteBlocks(unsigned first, unsigned count, const char *data)
+{
+    unsigned sector = hdr->ByteToSector(first * SECTOR_SIZE);
+    if (metadata) {
+        journal->WriteSectors(sector, count, data);
+    } else {
+        WriteSectors(sector, count, data);
     }
-    if (!lastAligned && (firstSector != lastSector || firstAligned)) {
-        ReadAt(&buf[(lastSector - firstSector) * SECTOR_SIZE],
-               SECTOR_SIZE, lastSector * SECTOR_SIZE);
+    if (Cached()) {
+        for (unsigned i = 0; i < count; i++) {
+            pageCache->Update(headerSector, generation, first + i,
+                              &data[i * SECTOR_SIZE]);
+        }
+    }
+}
+
+/// The space is taken in as few runs as there is room for, so that the file
+/// can then grow into it without more bitmap writes, nor scattering.
+bool
+OpenFile::Preallocate(unsigned numBytes)
+{
+    journal->Begin();
+    inode->lock->AcquireWrite();
+    bool success = numBytes <= hdr->AllocatedLength()
+                   || fileSystem->Extend(hdr, headerSector, numBytes);
+    if (success) {
+        hdr->WriteBack(headerSector);
     }
+    inode->lock->ReleaseWrite();
+    journal->End();
+    return success;
+}
 
-    // Copy in the bytes we want to change.
-    memcpy(&buf[position - firstSector * SECTOR_SIZE], from, numBytes);
+/// Blocks wholly in the range become holes; the bytes of those only partly
+/// in it, unless they are holes already, are written over with zeros.
+bool
+OpenFile::PunchHole(unsigned position, unsigned numBytes)
+{
+    static const char ZEROS[SECTOR_SIZE] = { 0 };
 
-    // Write modified sectors back.
-    for (unsigned i = firstSector; i <= lastSector; i++) {
-        synchDisk->WriteSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                               &buf[(i - firstSector) * SECTOR_SIZE]);
+    journal->Begin();
+    inode->lock->AcquireWrite();
+    unsigned length = hdr->FileLength();
+    unsigned end = numBytes > length - position ? length : position + numBytes;
+    bool success = true;
+    if (position >= length || numBytes == 0) {
+        ;  // Nothing to do.
+    } else if (hdr->IsInline()) {
+        hdr->WriteInline(ZEROS, end - position, position);
+        hdr->WriteBack(headerSector);
+    } else {
+        unsigned first = DivRoundUp(position, SECTOR_SIZE);
+        unsigned limit = end / SECTOR_SIZE;  // First block not wholly in.
+        if (end == length) {
+            limit = DivRoundUp(end, SECTOR_SIZE);
+        }
+        unsigned head = first * SECTOR_SIZE < end ? first * SECTOR_SIZE
+                                                  : end;
+        if (position < head && hdr->ByteToSector(position) != HOLE) {
+            WriteLocked(ZEROS, head - position, position);
+        }
+        unsigned tail = limit * SECTOR_SIZE > head ? limit * SECTOR_SIZE
+                                                   : head;
+        if (tail < end && hdr->ByteToSector(tail) != HOLE) {
+            WriteLocked(ZEROS, end - tail, tail);
+        }
+        if (first < limit) {
+            success = fileSystem->PunchHoles(hdr, headerSector,
+                                             first, limit - 1);
+            if (success) {
+                hdr->WriteBack(headerSector);
+                pageCache->Forget(headerSector, first, limit - 1);
+            }
+        }
     }
-    delete [] buf;
-    return numBytes;
+    inode->lock->ReleaseWrite();
+    journal->End();
+#ifdef USER_PROGRAM
+    InvalidateImage(nullptr, headerSector);
+#endif
+    return success;
+}
+
+/// The data goes first, so that the header committed never points at what
+/// was not written.  The journal is committed without the lock of the file,
+/// which operations waiting for the commit may be after.
+void
+OpenFile::Sync()
+{
+    inode->lock->AcquireRead();
+    unsigned numSectors = hdr->IsInline()
+                          ? 0 : DivRoundUp(hdr->FileLength(), SECTOR_SIZE);
+    for (unsigned i = 0; i < numSectors; i++) {
+        unsigned sector = hdr->ByteToSector(i * SECTOR_SIZE);
+        if (sector != HOLE) {
+            synchDisk->FlushSector(sector);
+        }
+    }
+    inode->lock->ReleaseRead();
+    journal->Commit();
+    synchDisk->FlushSector(headerSector);
 }
 
 /// Return the number of bytes in the file.
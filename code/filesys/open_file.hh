@@ -7,9 +7,9 @@
 /// `filesys.hh`).
 ///
 /// The other is the “real” implementation, that turns these operations into
-/// read and write disk sector requests.  In this baseline implementation of
-/// the file system, we do not worry about concurrent accesses to the file
-/// system by different threads -- this is part of the assignment.
+/// read and write disk sector requests.  Every file open on the same header
+/// shares an `Inode`, whose lock lets reads of the file go on together, and
+/// each write alone, while files of their own go on in parallel.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -21,6 +21,12 @@
 
 
 #include "lib/utility.hh"
+#include "machine/disk.hh"
+#ifdef USER_PROGRAM
+#include "userprog/image_cache.hh"
+#endif
+
+#include <string.h>
 
 
 #ifdef FILESYS_STUB  // Temporarily implement calls to Nachos file system as
@@ -28,17 +34,23 @@
 class OpenFile {
 public:
 
-    /// Open the file.
-    OpenFile(int f)
+    /// Open the file, called `name_` if known.
+    OpenFile(int f, const char *name_ = nullptr)
     {
         file = f;
         currentOffset = 0;
+        name = nullptr;
+        if (name_ != nullptr) {
+            name = new char [strlen(name_) + 1];
+            strcpy(name, name_);
+        }
     }
 
     /// Close the file.
     ~OpenFile()
     {
         SystemDep::Close(file);
+        delete [] name;
     }
 
     int ReadAt(char *into, unsigned numBytes, unsigned position)
@@ -54,6 +66,11 @@ public:
         ASSERT(numBytes > 0);
         SystemDep::Lseek(file, position, 0);
         SystemDep::WriteFile(file, from, numBytes);
+#ifdef USER_PROGRAM
+        if (name != nullptr) {
+            InvalidateImage(name, -1);
+        }
+#endif
         return numBytes;
     }
     int Read(char *into, unsigned numBytes)
@@ -79,23 +96,103 @@ public:
         return SystemDep::Tell(file);
     }
 
+    /// There are no file headers on a UNIX file system.
+    int GetSector() const
+    {
+        return -1;
+    }
+
+    /// Return the name the file was opened by, or null if unknown.
+    const char *GetName() const
+    {
+        return name;
+    }
+
+    /// Writes go straight to UNIX, so there is nothing left to write.
+    void Sync()
+    {}
+
+    /// There is no cache of Nachos' own to bypass.
+    void SetDirect(bool direct)
+    {}
+    bool IsDirect() const
+    {
+        return false;
+    }
+
+    /// There is no disk to move the blocks at once, so they are moved one
+    /// at a time.
+    int ReadScattered(char *const *blocks, unsigned count)
+    {
+        ASSERT(blocks != nullptr);
+        int total = 0;
+        for (unsigned i = 0; i < count; i++) {
+            int n = Read(blocks[i], SECTOR_SIZE);
+            total += n;
+            if (n < (int) SECTOR_SIZE) {
+                break;
+            }
+        }
+        return total;
+    }
+    int WriteGathered(const char *const *blocks, unsigned count)
+    {
+        ASSERT(blocks != nullptr);
+        for (unsigned i = 0; i < count; i++) {
+            Write(blocks[i], SECTOR_SIZE);
+        }
+        return count * SECTOR_SIZE;
+    }
+
+    /// UNIX files grow as needed.
+    bool Preallocate(unsigned numBytes)
+    {
+        return true;
+    }
+
+    /// The bytes are written over with zeros, which is what a hole reads as.
+    bool PunchHole(unsigned position, unsigned numBytes)
+    {
+        static const char ZEROS[512] = { 0 };
+        unsigned length = Length();
+        unsigned end = position + numBytes < length ? position + numBytes
+                                                    : length;
+        for (; position < end; position += sizeof ZEROS) {
+            unsigned n = end - position < sizeof ZEROS ? end - position
+                                                       : sizeof ZEROS;
+            WriteAt(ZEROS, n, position);
+        }
+        return true;
+    }
+
 private:
     int file;
     unsigned currentOffset;
+    char *name;
 };
 
 #else // FILESYS
 class FileHeader;
+class Inode;
 
 class OpenFile {
 public:
 
-    /// Open a file whose header is located at `sector` on the disk.
-    OpenFile(int sector);
+    /// Open a file whose header is located at `sector` on the disk.  Every
+    /// file open on the same header shares it, through `inodeTable`.
+    ///
+    /// The contents of a `metadata` file, such as a directory, are written
+    /// through the journal, and only within an operation of the file
+    /// system.
+    OpenFile(int sector, bool metadata = false);
 
     /// Close the file.
     ~OpenFile();
 
+    /// Open files come from a slab of their own (see `lib/slab.hh`).
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     /// Set the position from which to start reading/writing -- UNIX `lseek`.
     void Seek(unsigned position);
 
@@ -106,17 +203,110 @@ public:
     int Write(const char *from, unsigned numBytes);
 
     /// Read/write bytes from the file, bypassing the implicit position.
+    /// Writes past the end make the file grow.
 
     int ReadAt(char *into, unsigned numBytes, unsigned position);
     int WriteAt(const char *from, unsigned numBytes, unsigned position);
 
+    /// Reserve room on disk for the file to grow up to `numBytes` bytes,
+    /// without changing its length -- UNIX `fallocate`.  Return false if
+    /// the disk is too full.
+    bool Preallocate(unsigned numBytes);
+
+    /// Make `numBytes` bytes from `position` on read as zeros, giving back
+    /// the sectors of the blocks wholly among them, without changing the
+    /// length -- UNIX `fallocate` with `FALLOC_FL_PUNCH_HOLE`.  Return
+    /// false if there is no room for the index blocks this takes.
+    bool PunchHole(unsigned position, unsigned numBytes);
+
     // Return the number of bytes in the file (this interface is simpler than
     // the UNIX idiom -- `lseek` to end of file, `tell`, `lseek` back).
     unsigned Length() const;
 
+    /// Return the sector of the file header, which identifies the file.
+    int GetSector() const;
+
+    /// Write what is modified of the file from the disk cache to the disk,
+    /// and commit its header to the journal -- UNIX `fsync`.
+    void Sync();
+
+    /// Make whole blocks read and written from now on go straight between
+    /// the caller's buffer and the disk, if `direct`, rather than through
+    /// the page cache and the disk cache -- UNIX `O_DIRECT`.  Blocks found
+    /// in the page cache are still read from it, and those written update
+    /// it, so that other files open on the same header see the same bytes.
+    /// This is for data read or written once, such as a copy of a large
+    /// file, which would only push out of the caches what is used again.
+    /// It has no effect on metadata.
+    void SetDirect(bool direct);
+    bool IsDirect() const;
+
+    /// Read/write `count` whole blocks from the implicit position on, each
+    /// into or from a buffer of its own of `SECTOR_SIZE` bytes, such as the
+    /// frames holding a user buffer; for a direct file, the disk moves each
+    /// run of them in one request, with no copy.  Only whole blocks the
+    /// file has are moved: nothing is, unless the position is at the start
+    /// of a block, and the moving stops before the partial block at the end
+    /// of the file, and before a hole when writing, so that this never
+    /// makes the file grow.  Return the number of bytes moved, and advance
+    /// the position as much.
+    int ReadScattered(char *const *blocks, unsigned count);
+    int WriteGathered(const char *const *blocks, unsigned count);
+
   private:
-    FileHeader *hdr;  ///< Header for this file.
+    /// Sectors read ahead on the first sequential read, and most read ahead
+    /// at a time.
+    static const unsigned MIN_READ_AHEAD = 2;
+    static const unsigned MAX_READ_AHEAD = 16;
+
+    /// `WriteAt`, with the lock of the file held.
+    int WriteLocked(const char *from, unsigned numBytes, unsigned position);
+
+    /// Write `count` blocks of the file from `first` on, which must be
+    /// consecutive on disk, through the journal if the file is `metadata`,
+    /// and update those in the page cache.
+    void WriteBlocks(unsigned first, unsigned count, const char *data);
+
+    /// Read block `block` of the file into `data`, or `count` blocks from
+    /// it on, consecutive on disk, from the page cache when there, and
+    /// cache those that were not.  Holes read as zeros.
+    void ReadBlock(unsigned block, char *data);
+    void ReadBlocks(unsigned first, unsigned count, char *data);
+
+    /// Like `ReadBlocks`/`WriteBlocks`, with a buffer for each block.
+    void ReadBlockList(unsigned first, unsigned count, char *const *blocks);
+    void WriteBlockList(unsigned first, unsigned count,
+                        const char *const *blocks);
+
+    /// Whether the blocks of the file go through the page cache.
+    bool Cached() const;
+
+    /// Read/write `count` sectors from `sector` on, past the disk cache if
+    /// the file is `direct`.
+    void ReadSectors(unsigned sector, unsigned count, char *data) const;
+    void WriteSectors(unsigned sector, unsigned count,
+                      const char *data) const;
+
+    /// Read ahead of a read of sectors `first` to `last` of the file.
+    void ReadAhead(unsigned first, unsigned last);
+
+    /// Number of sectors of the file from `first` on, up to `last`, that
+    /// are consecutive on disk too.
+    unsigned RunLength(unsigned first, unsigned last);
+
+    Inode *inode;  ///< Shared with every other file open on `hdr`.
+    FileHeader *hdr;  ///< Header for this file, kept in `inode`.
+    int headerSector;  ///< Where `hdr` is kept on disk.
+    bool metadata;  ///< Whether the contents are written through `journal`.
+    bool direct;  ///< See `SetDirect`.
     unsigned seekPosition;  ///< Current position within the file.
+    unsigned generation;  ///< Of the file, in the page cache.
+
+    /// Sector of the file a sequential read would start at, sectors to read
+    /// ahead of it, and first sector not yet asked for.
+    unsigned nextSector;
+    unsigned readAheadWindow;
+    unsigned readAheadEnd;
 };
 
 #endif
@@ -0,0 +1,193 @@
+/// Routines to cache the blocks of files.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "page_cache.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+PageCache::PageCache(unsigned size_)
+{
+    size  = size_;
+    pages = new Page [size];
+    for (unsigned i = 0; i < size; i++) {
+        pages[i].inUse = false;
+    }
+
+    index = new HashIndex(size);
+
+    generation = new unsigned [diskSectors];
+    for (unsigned i = 0; i < diskSectors; i++) {
+        generation[i] = 0;
+    }
+
+    clock = 0;
+    lock  = new Lock("page cache");
+}
+
+PageCache::~PageCache()
+{
+    delete lock;
+    delete [] generation;
+    delete index;
+    delete [] pages;
+}
+
+unsigned
+PageCache::Hash(unsigned file, unsigned block)
+{
+    return file * 2654435761U ^ block;
+}
+
+void
+PageCache::Drop(unsigned i)
+{
+    ASSERT(i < size && pages[i].inUse);
+
+    index->Remove(i, Hash(pages[i].file, pages[i].block));
+    pages[i].inUse = false;
+}
+
+int
+PageCache::Find(unsigned file, unsigned block) const
+{
+    int i = index->First(Hash(file, block));
+    for (; i != -1; i = index->Next(i)) {
+        if (pages[i].file == file && pages[i].block == block) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+unsigned
+PageCache::Generation(unsigned file) const
+{
+    ASSERT(file < diskSectors);
+
+    return generation[file];
+}
+
+bool
+PageCache::Read(unsigned file, unsigned generation_, unsigned block,
+                char *into)
+{
+    ASSERT(file < diskSectors);
+    ASSERT(into != nullptr);
+
+    lock->Acquire();
+    int i = generation_ == generation[file] ? Find(file, block) : -1;
+    if (i != -1) {
+        pages[i].lastUsed = ++clock;
+        memcpy(into, pages[i].data, SECTOR_SIZE);
+        stats->numPageCacheHits++;
+    } else {
+        stats->numPageCacheMisses++;
+    }
+    lock->Release();
+    return i != -1;
+}
+
+/// A free entry is taken if there is one, or else the least recently used.
+void
+PageCache::Insert(unsigned file, unsigned generation_, unsigned block,
+                  const char *data)
+{
+    ASSERT(file < diskSectors);
+    ASSERT(data != nullptr);
+
+    lock->Acquire();
+    if (size == 0 || generation_ != generation[file]) {
+        lock->Release();
+        return;
+    }
+    int i = Find(file, block);
+    if (i == -1) {
+        i = 0;
+        for (unsigned j = 0; j < size; j++) {
+            if (!pages[j].inUse) {
+                i = j;
+                break;
+            }
+            if (pages[j].lastUsed < pages[i].lastUsed) {
+                i = j;
+            }
+        }
+        if (pages[i].inUse) {
+            Drop(i);
+        }
+        pages[i].inUse = true;
+        pages[i].file  = file;
+        pages[i].block = block;
+        index->Insert(i, Hash(file, block));
+    }
+    memcpy(pages[i].data, data, SECTOR_SIZE);
+    pages[i].lastUsed = ++clock;
+    lock->Release();
+}
+
+void
+PageCache::Update(unsigned file, unsigned generation_, unsigned block,
+                  const char *data)
+{
+    ASSERT(file < diskSectors);
+    ASSERT(data != nullptr);
+
+    lock->Acquire();
+    int i = generation_ == generation[file] ? Find(file, block) : -1;
+    if (i != -1) {
+        memcpy(pages[i].data, data, SECTOR_SIZE);
+    }
+    lock->Release();
+}
+
+void
+PageCache::Forget(unsigned file, unsigned first, unsigned last)
+{
+    ASSERT(file < diskSectors);
+    ASSERT(first <= last);
+
+    lock->Acquire();
+    for (unsigned i = 0; i < size; i++) {
+        if (pages[i].inUse && pages[i].file == file
+              && pages[i].block >= first && pages[i].block <= last) {
+            Drop(i);
+        }
+    }
+    lock->Release();
+}
+
+void
+PageCache::ForgetFile(unsigned file)
+{
+    ASSERT(file < diskSectors);
+
+    lock->Acquire();
+    for (unsigned i = 0; i < size; i++) {
+        if (pages[i].inUse && pages[i].file == file) {
+            Drop(i);
+        }
+    }
+    generation[file]++;
+    lock->Release();
+}
+
+void
+PageCache::ForgetAll()
+{
+    lock->Acquire();
+    for (unsigned i = 0; i < size; i++) {
+        if (pages[i].inUse) {
+            Drop(i);
+        }
+    }
+    for (unsigned i = 0; i < diskSectors; i++) {
+        generation[i]++;
+    }
+    lock->Release();
+}
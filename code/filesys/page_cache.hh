@@ -0,0 +1,113 @@
+/// Data structures to cache the blocks of files.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_PAGECACHE__HH
+#define NACHOS_FILESYS_PAGECACHE__HH
+
+
+#include "lib/hash_index.hh"
+#include "machine/disk.hh"
+#include "threads/lock.hh"
+
+
+/// A cache of the contents of files, a block at a time, shared by every
+/// reader: `OpenFile::ReadAt`, and so the loading of executables and the
+/// page faults of address spaces, which read through it.  The code of a
+/// program run over and over is read from the disk once, and then found
+/// here by the next process, long after the sectors it came from have left
+/// the disk cache.
+///
+/// A block is identified by the sector of the header of its file and by its
+/// number in the file, rather than by the sector it is kept at, so that is
+/// found without going through the header.  Files are told apart over time
+/// by a generation, which changes whenever the header sector is freed:
+/// what is cached, or about to be, for a file that is gone is never taken
+/// for the next file with its header at the same sector.
+///
+/// The cache is written through: `OpenFile` writes blocks to the disk and
+/// updates them here if they are cached.  Holes, files kept in their header
+/// and metadata are not cached.  The least recently used block makes room
+/// for a new one.
+class PageCache {
+public:
+
+    /// Blocks cached unless told otherwise.
+    static const unsigned DEFAULT_SIZE = 256;
+
+    /// Initialize an empty cache of `size` blocks; zero caches nothing.
+    PageCache(unsigned size = DEFAULT_SIZE);
+
+    ~PageCache();
+
+    /// Current generation of the file whose header is at `file`.
+    unsigned Generation(unsigned file) const;
+
+    /// Copy block `block` of `file` into `into`, and return true, if it is
+    /// cached for the `generation` given.
+    bool Read(unsigned file, unsigned generation, unsigned block, char *into);
+
+    /// Cache `data` as block `block` of `file`, unless `generation` is not
+    /// current anymore.
+    void Insert(unsigned file, unsigned generation, unsigned block,
+                const char *data);
+
+    /// Replace block `block` of `file` by `data`, if it is cached for
+    /// `generation`.
+    void Update(unsigned file, unsigned generation, unsigned block,
+                const char *data);
+
+    /// Forget blocks `first` to `last` of `file`.
+    void Forget(unsigned file, unsigned first, unsigned last);
+
+    /// Forget every block of `file`, whose header sector is freed, and
+    /// start a new generation for it.
+    void ForgetFile(unsigned file);
+
+    /// Forget every block, and start a new generation for every file, as
+    /// headers moved.
+    void ForgetAll();
+
+private:
+
+    /// A cached block.
+    class Page {
+    public:
+        bool inUse;
+        unsigned file;
+        unsigned block;
+        unsigned long lastUsed;
+        char data[SECTOR_SIZE];
+    };
+
+    /// The entry for block `block` of `file`, or -1 if none.  The lock must
+    /// be held.
+    int Find(unsigned file, unsigned block) const;
+
+    /// Hash of block `block` of `file`.
+    static unsigned Hash(unsigned file, unsigned block);
+
+    /// Take entry `i`, which must be in use, out for good.
+    void Drop(unsigned i);
+
+    Page *pages;
+    unsigned size;
+
+    /// The entries in use, by file and block.
+    HashIndex *index;
+
+    /// Generation of the file whose header is at each sector.
+    unsigned *generation;
+
+    /// Counts uses, to find the least recently used entry.
+    unsigned long clock;
+
+    /// Files are read with their own lock held only for reading, so several
+    /// threads may be at the cache at once.
+    Lock *lock;
+};
+
+
+#endif
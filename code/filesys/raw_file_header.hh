@@ -10,15 +10,56 @@
 #include "machine/disk.hh"
 
 
+/// A run of consecutive data sectors of a file.
+struct Extent {
+    unsigned start;   ///< First disk sector of the run.
+    unsigned length;  ///< Number of sectors in the run.
+};
+
+/// Start of an extent of blocks that have no sector: a hole, which reads as
+/// zeros until written.  Sector 0 holds the header of the free map, so it
+/// is never a data block.
+const unsigned HOLE = 0;
+
+/// Extents in the header itself, in an index block, and index blocks
+/// listed by the doubly indirect block.
 static const unsigned NUM_DIRECT
-  = (SECTOR_SIZE - 2 * sizeof (int)) / sizeof (int);
-const unsigned MAX_FILE_SIZE = NUM_DIRECT * SECTOR_SIZE;
+  = (SECTOR_SIZE - 5 * sizeof (int)) / sizeof (Extent);
+static const unsigned NUM_INDIRECT = SECTOR_SIZE / sizeof (Extent);
+static const unsigned NUM_DOUBLY_INDIRECT = SECTOR_SIZE / sizeof (int);
+
+/// Most extents a file can have: those in the header, those in the index
+/// block given by the header, and those in the index blocks given by the
+/// doubly indirect block.
+static const unsigned NUM_EXTENTS
+  = NUM_DIRECT + NUM_INDIRECT + NUM_DOUBLY_INDIRECT * NUM_INDIRECT;
+
+/// A file fits in `NUM_EXTENTS` runs of free sectors, however long they
+/// happen to be, so it can only be bounded by the size of the disk.
+inline unsigned
+MaxFileSize()
+{
+    return diskSectors * SECTOR_SIZE;
+}
+
+/// Files up to this long have no data sectors: their data is kept in the
+/// header, where the extents would go.
+const unsigned INLINE_SIZE = NUM_DIRECT * sizeof (Extent);
 
 struct RawFileHeader {
     unsigned numBytes;  ///< Number of bytes in the file.
     unsigned numSectors;  ///< Number of data sectors in the file.
-    unsigned dataSectors[NUM_DIRECT];  ///< Disk sector numbers for each data
-                                       ///< block in the file.
+    unsigned numExtents;  ///< Number of extents of the file, in all.
+    unsigned indirect;  ///< Index block with the extents after the
+                        ///< first `NUM_DIRECT`, if there are more.
+    unsigned doublyIndirect;  ///< Block listing the index blocks with the
+                              ///< extents after the first `NUM_DIRECT +
+                              ///< NUM_INDIRECT`, if there are more.
+    union {
+        Extent extents[NUM_DIRECT];  ///< First runs of data sectors of the
+                                     ///< file, in order.
+        char data[INLINE_SIZE];  ///< Contents of a file without extents.
+    };
 };
 
 
@@ -3,9 +3,16 @@
 /// happens later on).  This is a layer on top of the disk providing a
 /// synchronous interface (requests wait until the request completes).
 ///
-/// Use a semaphore to synchronize the interrupt handlers with the pending
-/// requests.  And, because the physical disk can only handle one operation
-/// at a time, use a lock to enforce mutual exclusion.
+/// Every request has a semaphore to synchronize the interrupt handler with
+/// the thread waiting for it.  And, because the physical disk can only
+/// handle one operation at a time, requests made meanwhile are queued;
+/// the interrupt handler starts the next one.  The queue is only touched
+/// with interrupts off.
+///
+/// The cache is protected by a lock, which is let go while waiting for the
+/// disk, so that several threads can have requests queued.  An entry being
+/// read or written is busy meanwhile: whoever wants it waits until it is
+/// not, and it is not reused for another sector.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -14,7 +21,53 @@
 
 
 #include "synch_disk.hh"
+#include "threads/system.hh"
+#ifdef USER_PROGRAM
+#include "userprog/address_space.hh"
+#endif
+
+#include <string.h>
+
+
+static const char *POLICY_NAMES[] = { "fifo", "sstf", "scan", "clook" };
 
+bool
+ParseDiskPolicy(const char *name, DiskPolicy *policy)
+{
+    ASSERT(name != nullptr);
+    ASSERT(policy != nullptr);
+
+    for (unsigned i = 0; i < sizeof POLICY_NAMES / sizeof *POLICY_NAMES;
+         i++) {
+        if (strcmp(name, POLICY_NAMES[i]) == 0) {
+            *policy = (DiskPolicy) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+DiskRequest::DiskRequest(int sector_, unsigned count_, char *data_,
+                         bool writing_, VoidFunctionPtr whenDone_,
+                         void *whenDoneArg_)
+  : done("disk request", 0)
+{
+    sector      = sector_;
+    count       = count_;
+    data        = data_;
+    writing     = writing_;
+    whenDone    = whenDone_;
+    whenDoneArg = whenDoneArg_;
+    made        = stats->totalTicks;
+    priority    = currentThread != nullptr ? currentThread->GetPriority()
+                                           : PRIORITY_DEFAULT;
+    buffers     = nullptr;
+}
+
+DiskRequest::~DiskRequest()
+{
+    delete [] buffers;
+}
 
 /// Disk interrupt handler.  Need this to be a C routine, because C++ cannot
 /// handle pointers to member functions.
@@ -26,24 +79,112 @@ DiskRequestDone(void *arg)
     disk->RequestDone();
 }
 
+/// Read sectors ahead.  Need this to be a C routine, like `DiskRequestDone`.
+static void
+ReadAheadHelper(void *arg)
+{
+    ASSERT(arg != nullptr);
+    SynchDisk *disk = (SynchDisk *) arg;
+    disk->ReadAheadLoop();
+}
+
+/// Write sectors behind.
+static void
+FlushHelper(void *arg)
+{
+    ASSERT(arg != nullptr);
+    SynchDisk *disk = (SynchDisk *) arg;
+    disk->FlushLoop();
+}
+
 /// Initialize the synchronous interface to the physical disk, in turn
 /// initializing the physical disk.
 ///
 /// * `name` is a UNIX file name to be used as storage for the disk data
 ///   (usually, `DISK`).
-SynchDisk::SynchDisk(const char *name)
+/// * `cacheSize` is the number of sectors to keep in memory.
+/// * `policy` is the order in which to serve requests.
+/// * `batchSize_` is the most requests handed to the disk at once.
+SynchDisk::SynchDisk(const char *name, unsigned cacheSize_,
+                     DiskPolicy policy_, bool mapped, DiskTiming timing,
+                     unsigned batchSize_)
 {
-    semaphore = new Semaphore("synch disk", 0);
+    ASSERT(batchSize_ > 0 && batchSize_ <= MAX_BATCH);
+
+    disk = new Disk(name, DiskRequestDone, this, mapped, timing);
+    queue      = new List<DiskRequest *>;
+    numServed  = 0;
+    batchSize  = batchSize_;
+    policy     = policy_;
+    headSector = 0;
+    goingUp    = true;
+
     lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, this);
+    entryReady = new Condition("synch disk entry ready", lock);
+
+    cacheSize = cacheSize_;
+    cache = new CachedSector [cacheSize + 1];
+    cache[cacheSize].prev = cache[cacheSize].next = cacheSize;
+    for (unsigned i = 0; i < cacheSize; i++) {
+        cache[i].sector = -1;
+        cache[i].dirty  = false;
+        cache[i].busy   = false;
+        cache[i].held   = false;
+        cache[i].request = nullptr;
+        LinkLast(i);
+    }
+    entryOf = new unsigned [diskSectors];
+    for (unsigned i = 0; i < diskSectors; i++) {
+        entryOf[i] = cacheSize;
+    }
+
+    readAheadFirst   = 0;
+    readAheadCount   = 0;
+    readAheadPending = new Semaphore("disk read-ahead", 0);
+
+    numDirty       = 0;
+    flushScheduled = false;
+    flushPending   = new Semaphore("disk flush", 0);
+
+    if (cacheSize > 0) {
+        Thread *t = new Thread("disk read-ahead", false, PRIORITY_DEFAULT);
+        t->Fork(ReadAheadHelper, this);
+        t = new Thread("disk flusher", false, PRIORITY_DEFAULT);
+        t->Fork(FlushHelper, this);
+    }
 }
 
 /// De-allocate data structures needed for the synchronous disk abstraction.
 SynchDisk::~SynchDisk()
 {
-    delete disk;
+    delete flushPending;
+    delete readAheadPending;
+    delete [] entryOf;
+    delete [] cache;
+    delete entryReady;
     delete lock;
-    delete semaphore;
+    delete queue;
+    delete disk;
+}
+
+/// Count `count` sectors asked of the disk by the current thread, and
+/// charge them to its process against its rate; a process over it is held
+/// back on its way out of the kernel, not here, where locks of the file
+/// system may be held.
+static void
+CountSectors(unsigned count, bool writing)
+{
+    if (writing) {
+        currentThread->usage.sectorsWritten += count;
+    } else {
+        currentThread->usage.sectorsRead += count;
+    }
+#ifdef USER_PROGRAM
+    AddressSpace *space = currentThread->space;
+    if (space != nullptr) {
+        space->diskBucket.Charge(space->limits, count);
+    }
+#endif
 }
 
 /// Read the contents of a disk sector into a buffer.  Return only after the
@@ -55,10 +196,15 @@ void
 SynchDisk::ReadSector(int sectorNumber, char *data)
 {
     ASSERT(data != nullptr);
+    ASSERT(sectorNumber >= 0 && (unsigned) sectorNumber < diskSectors);
 
-    lock->Acquire();  // Only one disk I/O at a time.
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();   // Wait for interrupt.
+    CountSectors(1, false);
+    if (cacheSize == 0) {
+        Transfer(sectorNumber, data, false);
+        return;
+    }
+    lock->Acquire();
+    memcpy(data, Lookup(sectorNumber, true, false)->data, SECTOR_SIZE);
     lock->Release();
 }
 
@@ -71,17 +217,792 @@ void
 SynchDisk::WriteSector(int sectorNumber, const char *data)
 {
     ASSERT(data != nullptr);
+    ASSERT(sectorNumber >= 0 && (unsigned) sectorNumber < diskSectors);
+
+    CountSectors(1, true);
+    if (cacheSize == 0) {
+        Transfer(sectorNumber, (char *) data, true);
+        return;
+    }
+    lock->Acquire();
+    WriteLocked(sectorNumber, data);
+    lock->Release();
+}
+
+void
+SynchDisk::WriteHeld(int sectorNumber, const char *data)
+{
+    ASSERT(data != nullptr);
+    ASSERT(sectorNumber >= 0 && (unsigned) sectorNumber < diskSectors);
+    ASSERT(cacheSize > 0);
+
+    CountSectors(1, true);
+    lock->Acquire();
+    WriteLocked(sectorNumber, data)->held = true;
+    lock->Release();
+}
+
+void
+SynchDisk::Unhold(int sectorNumber)
+{
+    ASSERT(sectorNumber >= 0 && (unsigned) sectorNumber < diskSectors);
+
+    lock->Acquire();
+    unsigned i = entryOf[sectorNumber];
+    ASSERT(i != cacheSize && cache[i].held);
+    cache[i].held = false;
+    entryReady->Broadcast();  // It may be the victim someone waits for.
+    lock->Release();
+}
+
+/// The whole sector is overwritten, so there is no need to read it.
+SynchDisk::CachedSector *
+SynchDisk::WriteLocked(int sectorNumber, const char *data)
+{
+    CachedSector *entry = Lookup(sectorNumber, false, false);
+    memcpy(entry->data, data, SECTOR_SIZE);
+    if (!entry->dirty) {
+        entry->dirty = true;
+        numDirty++;
+    }
+    if (!flushScheduled) {
+        flushScheduled = true;
+        flushPending->V();
+    }
+    return entry;
+}
+
+/// Runs of consecutive sectors are read a request at a time; sectors
+/// cached, and those there is no clean entry for, one at a time.
+void
+SynchDisk::ReadSectors(int firstSector, unsigned count, char *data)
+{
+    ASSERT(data != nullptr);
+    ASSERT(firstSector >= 0 && firstSector + count <= diskSectors);
+
+    CountSectors(count, false);
+    if (cacheSize == 0) {
+        Transfer(firstSector, data, false, count);
+        return;
+    }
+    lock->Acquire();
+    CachedSector *run[MAX_RUN];
+    for (unsigned i = 0; i < count;) {
+        unsigned n = ReserveRun(firstSector + i,
+                                count - i < MAX_RUN ? count - i : MAX_RUN,
+                                run, false);
+        if (n == 0) {
+            memcpy(&data[i * SECTOR_SIZE],
+                   Lookup(firstSector + i, true, false)->data, SECTOR_SIZE);
+            i++;
+            continue;
+        }
+        StartRun(run, n, false);
+        FinishRuns(run, n);
+        for (unsigned j = 0; j < n; j++, i++) {
+            memcpy(&data[i * SECTOR_SIZE], run[j]->data, SECTOR_SIZE);
+        }
+    }
+    lock->Release();
+}
+
+/// Writes only go as far as the cache, from which they are written behind
+/// in runs anyway.
+void
+SynchDisk::WriteSectors(int firstSector, unsigned count, const char *data)
+{
+    ASSERT(data != nullptr);
+    ASSERT(firstSector >= 0 && firstSector + count <= diskSectors);
+
+    if (cacheSize == 0) {
+        CountSectors(count, true);
+        Transfer(firstSector, (char *) data, true, count);
+        return;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        WriteSector(firstSector + i, &data[i * SECTOR_SIZE]);
+    }
+}
+
+/// A run longer than `MAX_RUN` is moved a request of `MAX_RUN` sectors at a
+/// time, which is as far as one track goes anyway.
+void
+SynchDisk::ReadDirect(int firstSector, unsigned count, char *data)
+{
+    ASSERT(data != nullptr);
+
+    char *buffers[MAX_RUN];
+    for (unsigned i = 0; i < count; i += MAX_RUN) {
+        unsigned n = count - i < MAX_RUN ? count - i : MAX_RUN;
+        for (unsigned j = 0; j < n; j++) {
+            buffers[j] = &data[(i + j) * SECTOR_SIZE];
+        }
+        ReadScattered(firstSector + i, n, buffers);
+    }
+}
+
+void
+SynchDisk::WriteDirect(int firstSector, unsigned count, const char *data)
+{
+    ASSERT(data != nullptr);
+
+    const char *buffers[MAX_RUN];
+    for (unsigned i = 0; i < count; i += MAX_RUN) {
+        unsigned n = count - i < MAX_RUN ? count - i : MAX_RUN;
+        for (unsigned j = 0; j < n; j++) {
+            buffers[j] = &data[(i + j) * SECTOR_SIZE];
+        }
+        WriteGathered(firstSector + i, n, buffers);
+    }
+}
+
+/// The sectors are read from the disk however they are cached; those
+/// modified in the cache are written back first.
+void
+SynchDisk::ReadScattered(int firstSector, unsigned count,
+                         char *const *buffers)
+{
+    ASSERT(buffers != nullptr);
+    ASSERT(firstSector >= 0 && firstSector + count <= diskSectors);
+
+    CountSectors(count, false);
+    stats->numDirectSectors += count;
+    if (cacheSize > 0) {
+        lock->Acquire();
+        for (unsigned i = 0; i < count; i++) {
+            FlushLocked(firstSector + i);
+        }
+        lock->Release();
+    }
+    WaitFor(SubmitScattered(firstSector, buffers, false, count));
+}
+
+/// Entries cached before the write have their modifications dropped, as
+/// the write supersedes them, so that they are not written back over it.
+/// Those loaded from the disk while the write is under way may hold what
+/// was there before, so they are overwritten again once it is done, unless
+/// written to meanwhile.
+void
+SynchDisk::WriteGathered(int firstSector, unsigned count,
+                         const char *const *buffers)
+{
+    ASSERT(buffers != nullptr);
+    ASSERT(firstSector >= 0 && firstSector + count <= diskSectors);
+
+    CountSectors(count, true);
+    stats->numDirectSectors += count;
+    if (cacheSize > 0) {
+        lock->Acquire();
+        OverwriteCached(firstSector, count, buffers, true);
+        lock->Release();
+    }
+    WaitFor(SubmitScattered(firstSector, (char *const *) buffers, true,
+                            count));
+    if (cacheSize > 0) {
+        lock->Acquire();
+        OverwriteCached(firstSector, count, buffers, false);
+        lock->Release();
+    }
+}
+
+void
+SynchDisk::OverwriteCached(int firstSector, unsigned count,
+                           const char *const *buffers, bool clean)
+{
+    for (unsigned i = 0; i < count;) {
+        unsigned e = entryOf[firstSector + i];
+        if (e == cacheSize) {
+            i++;
+            continue;
+        }
+        CachedSector *entry = &cache[e];
+        if (entry->busy) {
+            entryReady->Wait();
+            continue;  // It may have been evicted meanwhile.
+        }
+        if (entry->dirty) {
+            if (!clean || entry->held) {
+                i++;
+                continue;
+            }
+            entry->dirty = false;
+            numDirty--;
+        }
+        memcpy(entry->data, buffers[i], SECTOR_SIZE);
+        i++;
+    }
+}
+
+/// Every modified sector is sent to the disk at once, in runs, so that they
+/// are written in one sweep.  Those busy meanwhile are waited for
+/// afterwards.  Held sectors stay behind.
+void
+SynchDisk::Flush()
+{
+    lock->Acquire();
+    CachedSector **writing = new CachedSector * [cacheSize];
+    unsigned count = 0, runStart = 0;
+    for (unsigned s = 0; s < diskSectors; s++) {
+        unsigned i = entryOf[s];
+        bool joins = i != cacheSize && cache[i].dirty && !cache[i].busy
+                     && !cache[i].held;
+        if (count > runStart && (!joins || count - runStart == MAX_RUN)) {
+            StartRun(&writing[runStart], count - runStart, true);
+            runStart = count;
+        }
+        if (joins) {
+            cache[i].busy = true;
+            writing[count++] = &cache[i];
+        }
+    }
+    if (count > runStart) {
+        StartRun(&writing[runStart], count - runStart, true);
+    }
+    FinishRuns(writing, count);
+    delete [] writing;
+
+    for (unsigned s = 0; s < diskSectors && numDirty > 0; s++) {
+        FlushLocked(s);
+    }
+    disk->Flush();
+    lock->Release();
+}
+
+void
+SynchDisk::FlushSector(int sectorNumber)
+{
+    ASSERT(sectorNumber >= 0 && (unsigned) sectorNumber < diskSectors);
+
+    lock->Acquire();
+    FlushLocked(sectorNumber);
+    lock->Release();
+}
+
+/// A busy entry may be being written back already, or loaded; either way,
+/// it is looked at again once it is done.  A held entry is not written.
+void
+SynchDisk::FlushLocked(int sectorNumber)
+{
+    for (;;) {
+        unsigned i = entryOf[sectorNumber];
+        if (i == cacheSize) {
+            return;
+        }
+        if (cache[i].busy) {
+            entryReady->Wait();
+        } else {
+            if (cache[i].dirty && !cache[i].held) {
+                WriteBack(&cache[i]);
+            }
+            return;
+        }
+    }
+}
+
+/// Sectors modified while a flush is going on wait for the next one.
+void
+SynchDisk::FlushLoop()
+{
+    for (;;) {
+        flushPending->P();
+        if (numDirty < cacheSize / 2) {
+            alarmClock->WaitUntil(WRITE_BEHIND_TICKS);
+        }
+        flushScheduled = false;
+        DEBUG('f', "Writing %u modified sectors behind\n", numDirty);
+        Flush();
+    }
+}
+
+/// Filling the ring is left to `ReadAheadLoop`, which takes the lock to
+/// read; as interrupts are off here, looking at the cache needs no more.
+void
+SynchDisk::ReadAhead(int sectorNumber)
+{
+    ASSERT(sectorNumber >= 0 && (unsigned) sectorNumber < diskSectors);
+
+    if (cacheSize == 0) {
+        return;
+    }
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    if (entryOf[sectorNumber] == cacheSize
+          && readAheadCount < READ_AHEAD_QUEUE) {
+        readAheadQueue[(readAheadFirst + readAheadCount) % READ_AHEAD_QUEUE]
+          = sectorNumber;
+        readAheadCount++;
+        readAheadPending->V();
+    }
+    interrupt->SetLevel(oldLevel);
+}
+
+/// Every sector asked for so far is read at once, so that the disk serves
+/// them in one sweep.  A sector may have been cached since it was asked
+/// for, by a reader that could not wait.  One that would need to write
+/// back a modified entry to make room is read once the rest are done.
+void
+SynchDisk::ReadAheadLoop()
+{
+    int sectors[READ_AHEAD_QUEUE];
+    CachedSector *reading[READ_AHEAD_QUEUE];
+
+    for (;;) {
+        readAheadPending->P();
+
+        IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+        unsigned count = readAheadCount;
+        for (unsigned i = 0; i < count; i++) {
+            sectors[i] = readAheadQueue[(readAheadFirst + i)
+                                        % READ_AHEAD_QUEUE];
+        }
+        readAheadFirst = (readAheadFirst + count) % READ_AHEAD_QUEUE;
+        readAheadCount = 0;
+        interrupt->SetLevel(oldLevel);
+        if (count > 1) {
+            // Does not block: they were all `V`ed.
+            readAheadPending->P(count - 1);
+        }
+
+        lock->Acquire();
+        unsigned started = 0;
+        for (unsigned i = 0; i < count;) {
+            unsigned max = 1;
+            while (i + max < count && max < MAX_RUN
+                   && sectors[i + max] == sectors[i] + (int) max) {
+                max++;
+            }
+            unsigned n = ReserveRun(sectors[i], max, &reading[started], true);
+            if (n > 0) {
+                DEBUG('f', "Reading %u sectors ahead from %d\n",
+                      n, sectors[i]);
+                StartRun(&reading[started], n, false);
+                started += n;
+                for (unsigned j = 0; j < n; j++) {
+                    sectors[i + j] = -1;
+                }
+            }
+            i += n > 0 ? n : 1;
+        }
+        FinishRuns(reading, started);
+
+        for (unsigned i = 0; i < count; i++) {
+            if (sectors[i] >= 0 && entryOf[sectors[i]] == cacheSize) {
+                Lookup(sectors[i], true, true);
+                DEBUG('f', "Read sector %d ahead\n", sectors[i]);
+            }
+        }
+        lock->Release();
+    }
+}
+
+DiskRequest *
+SynchDisk::Submit(int sectorNumber, char *data, bool writing,
+                  unsigned count)
+{
+    ASSERT(data != nullptr);
+    ASSERT(sectorNumber >= 0 && sectorNumber + count <= diskSectors);
+    ASSERT(count > 0);
+
+    DiskRequest *request = new DiskRequest(sectorNumber, count, data,
+                                           writing, nullptr, nullptr);
+    Enqueue(request);
+    return request;
+}
+
+void
+SynchDisk::Submit(int sectorNumber, char *data, bool writing,
+                  VoidFunctionPtr whenDone, void *arg, unsigned count)
+{
+    ASSERT(data != nullptr);
+    ASSERT(sectorNumber >= 0 && sectorNumber + count <= diskSectors);
+    ASSERT(count > 0);
+    ASSERT(whenDone != nullptr);
+
+    Enqueue(new DiskRequest(sectorNumber, count, data, writing,
+                            whenDone, arg));
+}
+
+void
+SynchDisk::WaitFor(DiskRequest *request)
+{
+    ASSERT(request != nullptr);
+    ASSERT(request->whenDone == nullptr);
+
+    request->done.P();  // Wait for interrupt.
+    delete request;
+}
+
+void
+SynchDisk::Enqueue(DiskRequest *request)
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    if (numServed == 0) {
+        Start(request);
+    } else {
+        queue->Append(request);
+    }
+    interrupt->SetLevel(oldLevel);
+}
+
+void
+SynchDisk::Transfer(int sectorNumber, char *data, bool writing,
+                    unsigned count)
+{
+    WaitFor(Submit(sectorNumber, data, writing, count));
+}
+
+/// The list is copied, so that the caller's may go away.
+DiskRequest *
+SynchDisk::SubmitScattered(int sectorNumber, char *const *buffers,
+                           bool writing, unsigned count)
+{
+    ASSERT(buffers != nullptr);
+    ASSERT(sectorNumber >= 0 && sectorNumber + count <= diskSectors);
+    ASSERT(count > 0);
+
+    DiskRequest *request = new DiskRequest(sectorNumber, count, nullptr,
+                                           writing, nullptr, nullptr);
+    request->buffers = new char * [count];
+    memcpy(request->buffers, buffers, count * sizeof *buffers);
+    Enqueue(request);
+    return request;
+}
+
+void
+SynchDisk::TransferEntry(CachedSector *entry, bool writing)
+{
+    ASSERT(!entry->busy);
+
+    entry->busy = true;
+    StartRun(&entry, 1, writing);
+    FinishRuns(&entry, 1);
+}
+
+/// Nobody else touches a busy entry, so a modified one is clean from the
+/// moment it is being written.  The entries of a run are not next to each
+/// other, so the disk moves each sector straight to or from its entry.
+void
+SynchDisk::StartRun(CachedSector **entries, unsigned count, bool writing)
+{
+    ASSERT(count > 0);
+
+    for (unsigned i = 0; i < count; i++) {
+        ASSERT(entries[i]->busy);
+        ASSERT(entries[i]->sector == entries[0]->sector + (int) i);
+        if (writing) {
+            ASSERT(entries[i]->dirty);
+            entries[i]->dirty = false;
+            numDirty--;
+        }
+    }
+
+    if (count == 1) {
+        entries[0]->request = Submit(entries[0]->sector, entries[0]->data,
+                                     writing);
+        return;
+    }
+    ASSERT(count <= MAX_RUN);
+    char *buffers[MAX_RUN];
+    for (unsigned i = 0; i < count; i++) {
+        buffers[i] = entries[i]->data;
+    }
+    entries[0]->request = SubmitScattered(entries[0]->sector, buffers,
+                                          writing, count);
+}
+
+void
+SynchDisk::FinishRuns(CachedSector **entries, unsigned count)
+{
+    if (count == 0) {
+        return;
+    }
 
-    lock->Acquire();  // only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();   // wait for interrupt
     lock->Release();
+    for (unsigned i = 0; i < count;) {
+        DiskRequest *request = entries[i]->request;
+        ASSERT(request != nullptr);
+        unsigned n = request->count;
+        WaitFor(request);
+        i += n;
+    }
+    lock->Acquire();
+    for (unsigned i = 0; i < count; i++) {
+        entries[i]->request = nullptr;
+        entries[i]->busy    = false;
+    }
+    entryReady->Broadcast();
+}
+
+/// Entries are made busy as soon as they are taken, so that `Victim` does
+/// not hand them out again.
+unsigned
+SynchDisk::ReserveRun(int firstSector, unsigned max, CachedSector **entries,
+                      bool readingAhead)
+{
+    unsigned n = 0;
+    while (n < max && entryOf[firstSector + n] == cacheSize) {
+        unsigned victim = Victim();
+        if (victim == cacheSize || cache[victim].dirty) {
+            break;
+        }
+        Assign(victim, firstSector + n);
+        cache[victim].busy = true;
+        if (readingAhead) {
+            stats->numDiskReadAheads++;
+        } else {
+            stats->numDiskCacheMisses++;
+        }
+        entries[n++] = &cache[victim];
+    }
+    return n;
+}
+
+void
+SynchDisk::Start(DiskRequest *request)
+{
+    ASSERT(numServed == 0);
+
+    if (batchSize == 1) {
+        Issue(request);
+        return;
+    }
+    disk->StartBatch();
+    Issue(request);
+    while (numServed < batchSize) {
+        DiskRequest *next = NextRequest();
+        if (next == nullptr) {
+            break;
+        }
+        Issue(next);
+    }
+    disk->EndBatch();
+}
+
+void
+SynchDisk::Issue(DiskRequest *request)
+{
+    ASSERT(numServed < batchSize);
+
+    unsigned from = headSector / SECTORS_PER_TRACK;
+    unsigned to   = request->sector / SECTORS_PER_TRACK;
+    stats->numDiskSeekTracks += from > to ? from - to : to - from;
+
+    served[numServed++] = request;
+    headSector = request->sector + request->count - 1;
+    if (request->buffers != nullptr) {
+        if (request->writing) {
+            disk->WriteGather(request->sector, request->buffers,
+                              request->count);
+        } else {
+            disk->ReadScatter(request->sector, request->buffers,
+                              request->count);
+        }
+    } else if (request->writing) {
+        disk->WriteRequest(request->sector, request->data, request->count);
+    } else {
+        disk->ReadRequest(request->sector, request->data, request->count);
+    }
+}
+
+unsigned
+SynchDisk::PriorityOf(const DiskRequest *request)
+{
+    return request->priority
+           + (stats->totalTicks - request->made) / AGING_TICKS;
+}
+
+/// Look at every request in `queue`, which is left as it was, and return
+/// the one closest to the head; ties go to the request that came first.
+/// For sweeps, only those ahead of the head count, unless `wrapping`, in
+/// which case the lowest request is the closest.  Requests below
+/// `priority` do not count.
+DiskRequest *
+SynchDisk::Closest(bool wrapping, unsigned priority)
+{
+    DiskRequest *best = nullptr;
+    unsigned bestDistance = 0;
+
+    DiskRequest *first = queue->Head();
+    DiskRequest *r = first;
+    do {
+        queue->Append(queue->Pop());
+
+        unsigned distance;
+        bool counts = PriorityOf(r) >= priority;
+        if (policy == DISK_FIFO) {
+            distance = 0;
+        } else if (policy == DISK_SSTF) {
+            unsigned track = r->sector / SECTORS_PER_TRACK;
+            unsigned head  = headSector / SECTORS_PER_TRACK;
+            distance = track > head ? track - head : head - track;
+        } else if (wrapping) {
+            distance = r->sector;
+        } else {
+            counts = counts && (goingUp ? r->sector >= headSector
+                                        : r->sector <= headSector);
+            distance = goingUp ? r->sector - headSector
+                               : headSector - r->sector;
+        }
+        if (counts && (best == nullptr || distance < bestDistance)) {
+            best = r;
+            bestDistance = distance;
+        }
+        r = queue->Head();
+    } while (r != first);
+
+    return best;
+}
+
+DiskRequest *
+SynchDisk::NextRequest()
+{
+    if (queue->IsEmpty()) {
+        return nullptr;
+    }
+
+    unsigned top = 0;
+    DiskRequest *first = queue->Head();
+    DiskRequest *r = first;
+    do {
+        queue->Append(queue->Pop());
+        if (PriorityOf(r) > top) {
+            top = PriorityOf(r);
+        }
+        r = queue->Head();
+    } while (r != first);
+
+    DiskRequest *best = Closest(false, top);
+    if (best == nullptr) {
+        // Nothing ahead: SCAN turns back, C-LOOK starts over from the
+        // lowest request.
+        if (policy == DISK_SCAN) {
+            goingUp = !goingUp;
+            best = Closest(false, top);
+        } else {
+            best = Closest(true, top);
+        }
+    }
+    queue->Remove(best);
+    return best;
+}
+
+/// The entry taken for a sector not cached is the least recently used that
+/// is not busy.  If it is modified, it is written back first, and then all
+/// is looked at again, as other threads may have come by meanwhile.
+SynchDisk::CachedSector *
+SynchDisk::Lookup(int sectorNumber, bool load, bool readingAhead)
+{
+    for (;;) {
+        unsigned i = entryOf[sectorNumber];
+        if (i != cacheSize) {
+            if (cache[i].busy) {
+                entryReady->Wait();
+                continue;
+            }
+            if (!readingAhead) {
+                stats->numDiskCacheHits++;
+            }
+            Unlink(i);
+            LinkLast(i);
+            return &cache[i];
+        }
+
+        i = Victim();
+        if (i == cacheSize) {
+            entryReady->Wait();  // Every entry is busy or held.
+            continue;
+        }
+        CachedSector *victim = &cache[i];
+        if (victim->dirty) {
+            WriteBack(victim);
+            continue;
+        }
+
+        Assign(i, sectorNumber);
+        if (readingAhead) {
+            stats->numDiskReadAheads++;
+        } else {
+            stats->numDiskCacheMisses++;
+        }
+        if (load) {
+            TransferEntry(victim, false);
+        }
+        return victim;
+    }
+}
+
+unsigned
+SynchDisk::Victim() const
+{
+    unsigned i = cache[cacheSize].next;
+    while (i != cacheSize && (cache[i].busy || cache[i].held)) {
+        i = cache[i].next;
+    }
+    return i;
+}
+
+void
+SynchDisk::Assign(unsigned entry, int sectorNumber)
+{
+    ASSERT(!cache[entry].busy && !cache[entry].dirty && !cache[entry].held);
+
+    if (cache[entry].sector >= 0) {
+        entryOf[cache[entry].sector] = cacheSize;
+    }
+    cache[entry].sector = sectorNumber;
+    entryOf[sectorNumber] = entry;
+    Unlink(entry);
+    LinkLast(entry);
 }
 
-/// Disk interrupt handler.  Wake up any thread waiting for the disk
-/// request to finish.
+void
+SynchDisk::WriteBack(CachedSector *entry)
+{
+    TransferEntry(entry, true);
+}
+
+void
+SynchDisk::Unlink(unsigned entry)
+{
+    cache[cache[entry].prev].next = cache[entry].next;
+    cache[cache[entry].next].prev = cache[entry].prev;
+}
+
+void
+SynchDisk::LinkLast(unsigned entry)
+{
+    unsigned head = cacheSize;
+    cache[entry].prev = cache[head].prev;
+    cache[entry].next = head;
+    cache[cache[head].prev].next = entry;
+    cache[head].prev = entry;
+}
+
+/// Disk interrupt handler.  Tell whoever made each request of the batch
+/// that it is done, and start the next batch.
 void
 SynchDisk::RequestDone()
 {
-    semaphore->V();
+    ASSERT(numServed > 0);
+
+    unsigned count = numServed;
+    numServed = 0;
+    for (unsigned i = 0; i < count; i++) {
+        DiskRequest *request = served[i];
+        if (tracer != nullptr) {
+            tracer->RecordDisk(request->writing, request->sector,
+                               request->made);
+        }
+        if (request->whenDone != nullptr) {
+            request->whenDone(request->whenDoneArg);
+            delete request;
+        } else {
+            request->done.V();
+        }
+    }
+
+    DiskRequest *next = NextRequest();
+    if (next != nullptr) {
+        Start(next);
+    }
 }
@@ -10,10 +10,56 @@
 
 
 #include "machine/disk.hh"
+#include "threads/condition.hh"
 #include "threads/lock.hh"
 #include "threads/semaphore.hh"
+#include "lib/list.hh"
 
 
+/// Orders in which requests waiting for the disk are served.
+enum DiskPolicy {
+    DISK_FIFO,   ///< In order of arrival.
+    DISK_SSTF,   ///< Closest track first.
+    DISK_SCAN,   ///< Sweeping from one end of the requests to the other,
+                 ///< and back.
+    DISK_CLOOK   ///< Sweeping up the disk, then jumping back to the lowest
+                 ///< request.
+};
+
+/// Set `*policy` to the policy called `name`; return false if there is none.
+bool ParseDiskPolicy(const char *name, DiskPolicy *policy);
+
+/// A request waiting for, or being served by, the disk.
+class DiskRequest {
+public:
+    DiskRequest(int sector_, unsigned count_, char *data_, bool writing_,
+                VoidFunctionPtr whenDone_, void *whenDoneArg_);
+
+    ~DiskRequest();
+
+    /// The first of `count` consecutive sectors, and their contents.
+    int sector;
+    unsigned count;
+    char *data;
+    bool writing;
+
+    /// If not null, the contents of each sector, wherever they are, instead
+    /// of `data`; see `Disk::ReadScatter`.  Owned by the request.
+    char **buffers;
+
+    /// Called once the request is done, if not null.
+    VoidFunctionPtr whenDone;
+    void *whenDoneArg;
+
+    /// When the request was made, and the priority of the thread that
+    /// made it.
+    unsigned long made;
+    unsigned priority;
+
+    /// Signalled once the request is done, unless there is `whenDone`.
+    Semaphore done;
+};
+
 /// The following class defines a "synchronous" disk abstraction.
 ///
 /// As with other I/O devices, the raw physical disk is an asynchronous
@@ -24,32 +70,301 @@
 ///
 /// This class provides the abstraction that for any individual thread making
 /// a request, it waits around until the operation finishes before returning.
+/// Requests made while the disk is busy wait in a queue, from which the next
+/// one is taken by the `DiskPolicy` chosen, so that requests from several
+/// threads do not drag the head back and forth.
+///
+/// The policy only chooses among the requests of the highest priority
+/// waiting, that of the thread that made each, so that a process that
+/// reads little is not kept behind a bulk copy.  A request rises one level
+/// for every `AGING_TICKS` it waits, so that none starves.
+///
+/// Sectors are kept in a cache, so that those used over and over, such as
+/// the free map, the directory and file headers, are read from the disk
+/// once.  The least recently used sector makes room for a new one.  Writes
+/// only go to the cache; a modified sector is written back to the disk when
+/// it is evicted, or on `Flush`.
+///
+/// The disk transfers several consecutive sectors at a time for the price of
+/// one seek, so the cache reads and writes consecutive sectors together,
+/// up to `MAX_RUN` of them, whenever it can.
+///
+/// With a `batchSize` above one, requests that waited while the disk was
+/// busy are handed to it together, up to that many, in the order of the
+/// policy, and the disk interrupts once for all of them (see
+/// `Disk::StartBatch`).  One interrupt handler then tells every thread
+/// whose request is done.  A request alone is served as soon as it comes,
+/// so this only takes effect under heavy I/O, where it saves interrupts
+/// and context switches, at the price of the first requests of a batch
+/// waiting for the last.
+///
+/// Sectors can also be asked for ahead of time, with `ReadAhead`: a thread
+/// of the disk reads them into the cache in the background.
+///
+/// Modified sectors are written behind by another thread, `WRITE_BEHIND_TICKS`
+/// after the first of them is modified, so that writes to the same sectors
+/// meanwhile cost nothing more and the rest go out together, in order.  If
+/// half of the cache is modified by then, they are written at once.
 class SynchDisk {
 public:
 
-    /// Initialize a synchronous disk, by initializing the raw Disk.
-    SynchDisk(const char *name);
+    /// Sectors cached unless told otherwise.
+    static const unsigned DEFAULT_CACHE_SIZE = 64;
+
+    /// Ticks a request waits for the disk for each level it is raised.
+    static const unsigned long AGING_TICKS = 5000;
+
+    /// Ticks a modified sector may wait in the cache before the flusher
+    /// thread writes it back.
+    static const unsigned long WRITE_BEHIND_TICKS = 10000;
+
+    /// Most requests handed to the disk in one batch.
+    static const unsigned MAX_BATCH = 16;
+
+    /// Initialize a synchronous disk, by initializing the raw Disk, with a
+    /// cache of `cacheSize` sectors; zero sends every request to the disk.
+    /// Requests waiting for the disk are served by `policy`.  If `mapped`,
+    /// the disk maps its UNIX file into memory; a null `name` makes it a
+    /// RAM disk.  Its requests take as long as `timing` says, and go to it
+    /// in batches of up to `batchSize`, at most `MAX_BATCH`.
+    SynchDisk(const char *name, unsigned cacheSize = DEFAULT_CACHE_SIZE,
+              DiskPolicy policy = DISK_CLOOK, bool mapped = false,
+              DiskTiming timing = DISK_ACCURATE, unsigned batchSize = 1);
 
-    /// De-allocate the synch disk data.
+    /// De-allocate the synch disk data.  Modified sectors still cached are
+    /// lost, unless flushed before.
     ~SynchDisk();
 
     /// Read/write a disk sector, returning only once the data is actually
     /// read or written.  These call `Disk::ReadRequest`/`WriteRequest` and
     /// then wait until the request is done.
+    ///
+    /// With a cache, a sector cached is read from it, and a write returns
+    /// once the new contents are cached.
 
     void ReadSector(int sectorNumber, char *data);
     void WriteSector(int sectorNumber, const char *data);
 
+    /// Like `WriteSector`, but the sector is held in the cache, and not
+    /// written back to the disk nor evicted, until `Unhold`.  This is how
+    /// the journal keeps metadata from reaching its place on the disk before
+    /// it is in the journal.  There must be a cache.
+    void WriteHeld(int sectorNumber, const char *data);
+    void Unhold(int sectorNumber);
+
+    /// Number of sectors cached.
+    unsigned GetCacheSize() const { return cacheSize; }
+
+    /// Like `ReadSector`/`WriteSector`, for `count` consecutive sectors from
+    /// `firstSector` on.
+    void ReadSectors(int firstSector, unsigned count, char *data);
+    void WriteSectors(int firstSector, unsigned count, const char *data);
+
+    /// Like `ReadSectors`/`WriteSectors`, but straight between `data` and
+    /// the disk, for data that would only push more useful sectors out of
+    /// the cache.  The cache is kept right: sectors modified in it are
+    /// written back before being read, and those in it are overwritten
+    /// along with the disk.
+    void ReadDirect(int firstSector, unsigned count, char *data);
+    void WriteDirect(int firstSector, unsigned count, const char *data);
+
+    /// Like `ReadDirect`/`WriteDirect`, but sector `i` of the `count` from
+    /// `firstSector` on is read into, or written from, `buffers[i]`, of
+    /// `SECTOR_SIZE` bytes each, wherever they are: the disk moves them all
+    /// in one request.  This is how frames of main memory that are not next
+    /// to each other are filled or written out at once.
+    void ReadScattered(int firstSector, unsigned count, char *const *buffers);
+    void WriteGathered(int firstSector, unsigned count,
+                       const char *const *buffers);
+
+    /// Start reading or writing `count` consecutive sectors, and return at
+    /// once, bypassing the cache.  Any number of requests may be in flight; the disk serves
+    /// them in the order of the policy.  The request returned must be handed
+    /// to `WaitFor`, which returns once it is done, and frees it.
+    DiskRequest *Submit(int sectorNumber, char *data, bool writing,
+                        unsigned count = 1);
+    void WaitFor(DiskRequest *request);
+
+    /// Like `Submit`, except that the disk interrupt handler calls
+    /// `whenDone(arg)` once the request is done, and then frees it.  So
+    /// `whenDone` must not block.
+    void Submit(int sectorNumber, char *data, bool writing,
+                VoidFunctionPtr whenDone, void *arg, unsigned count = 1);
+
+    /// Write every modified sector in the cache back to the disk, except
+    /// those held, and have the disk write it to its UNIX file.
+    void Flush();
+
+    /// Write `sectorNumber` back to the disk, if it is modified in the
+    /// cache.
+    void FlushSector(int sectorNumber);
+
+    /// Have `sectorNumber` read into the cache, if it is not there, without
+    /// waiting for it.  This is only a hint: it is ignored if there is no
+    /// cache, or if too many sectors are already being read ahead.
+    void ReadAhead(int sectorNumber);
+
+    /// Read the sectors asked for by `ReadAhead`, forever.  Run by the disk
+    /// read-ahead thread.
+    void ReadAheadLoop();
+
+    /// Write modified sectors behind, forever.  Run by the disk flusher
+    /// thread.
+    void FlushLoop();
+
     /// Called by the disk device interrupt handler, to signal that the
-    /// current disk operation is complete.
+    /// current disk operation, or batch of them, is complete.
     void RequestDone();
 
 private:
+
+    /// A sector in the cache.
+    class CachedSector {
+    public:
+        int sector;  ///< -1 if the entry is free.
+        bool dirty;  ///< Whether `data` differs from the disk.
+        bool busy;   ///< Whether `data` is being read or written.
+        bool held;   ///< Whether it is kept from the disk; see `WriteHeld`.
+
+        /// The request reading or writing the run this entry starts, while
+        /// busy.
+        DiskRequest *request;
+
+        /// Neighbours in the order of use, from least to most recent.
+        unsigned prev;
+        unsigned next;
+
+        char data[SECTOR_SIZE];
+    };
+
+    /// Most sectors read or written by one request of the cache.
+    static const unsigned MAX_RUN = SECTORS_PER_TRACK;
+
+    /// Send a request to the disk, and wait until it is done.
+    void Transfer(int sectorNumber, char *data, bool writing,
+                  unsigned count = 1);
+
+    /// Like `Submit`, for a request of sectors each in a buffer of its own.
+    DiskRequest *SubmitScattered(int sectorNumber, char *const *buffers,
+                                 bool writing, unsigned count);
+
+    /// Hand `request` to the disk, or queue it if the disk is busy.
+    void Enqueue(DiskRequest *request);
+
+    /// Like `Transfer`, for an entry of the cache, which is busy meanwhile.
+    /// The lock must be held; it is let go while waiting.
+    void TransferEntry(CachedSector *entry, bool writing);
+
+    /// The halves of `TransferEntry`, for runs of entries caching
+    /// consecutive sectors, which must be busy: start the request for the
+    /// `count` `entries` of a run, and wait for those of several runs, put
+    /// one after the other in `entries`, at once.  The lock must be held.
+    void StartRun(CachedSector **entries, unsigned count, bool writing);
+    void FinishRuns(CachedSector **entries, unsigned count);
+
+    /// Make busy entries cache the sectors from `firstSector` on, up to
+    /// `max` of them, as long as they are not cached and there are clean
+    /// entries for them, and put them in `entries`.  Return how many.
+    unsigned ReserveRun(int firstSector, unsigned max, CachedSector **entries,
+                        bool readingAhead);
+
+    /// Hand `request` to the disk, which must be idle, with as many of
+    /// those waiting as a batch takes.  Interrupts must be off.
+    void Start(DiskRequest *request);
+
+    /// Hand `request` to the disk, as part of the batch being started.
+    void Issue(DiskRequest *request);
+
+    /// Take the next request to serve off `queue`; return null if there is
+    /// none.  Interrupts must be off.
+    DiskRequest *NextRequest();
+
+    /// The request of at least `priority` in `queue` that `policy` would
+    /// serve next, if any is ahead of the head, or if `wrapping` around.
+    DiskRequest *Closest(bool wrapping, unsigned priority);
+
+    /// The priority `request` is served at, raised for the time it waited.
+    static unsigned PriorityOf(const DiskRequest *request);
+
+    /// Return the entry caching `sectorNumber`, making room for it if it is
+    /// not cached; read it from the disk in that case if `load`.  The entry
+    /// becomes the most recently used.  A sector read ahead is not counted
+    /// as a hit or a miss.
+    CachedSector *Lookup(int sectorNumber, bool load, bool readingAhead);
+
+    /// Put `data` in the entry caching `sectorNumber`, which becomes
+    /// modified, and return the entry.  The lock must be held.
+    CachedSector *WriteLocked(int sectorNumber, const char *data);
+
+    /// The least recently used entry that is neither busy nor held, or
+    /// `cacheSize` if there is none.
+    unsigned Victim() const;
+
+    /// Make `entry`, which must be clean and not busy, cache `sectorNumber`
+    /// instead, and the most recently used.
+    void Assign(unsigned entry, int sectorNumber);
+
+    /// Write `sectorNumber` back, with the lock held.  Wait for it if it is
+    /// busy.
+    void FlushLocked(int sectorNumber);
+
+    /// Put `buffers` in the entries caching sectors from `firstSector` on,
+    /// up to `count` of them, if any, waiting for those busy.  Those
+    /// modified become clean if `clean`, and are left alone otherwise.  The
+    /// lock must be held.
+    void OverwriteCached(int firstSector, unsigned count,
+                         const char *const *buffers, bool clean);
+
+    /// Write `entry` back to the disk; it must be modified.  The lock must
+    /// be held.
+    void WriteBack(CachedSector *entry);
+
+    /// Move `entry` to either end of the order of use.
+    void Unlink(unsigned entry);
+    void LinkLast(unsigned entry);
+
     Disk *disk;  ///< Raw disk device.
-    Semaphore *semaphore;  ///< To synchronize requesting thread with the
-                           ///< interrupt handler.
-    Lock *lock;  ///< Only one read/write request can be sent to the disk at
-                 ///< a time.
+
+    /// Requests waiting for the disk, in order of arrival; the `numServed`
+    /// being served, if any, in the order the disk serves them; the sector
+    /// it is at, and whether a scan is going up.
+    List<DiskRequest *> *queue;
+    DiskRequest *served[MAX_BATCH];
+    unsigned numServed;
+    unsigned batchSize;
+    DiskPolicy policy;
+    int headSector;
+    bool goingUp;
+
+    Lock *lock;  ///< Protects the cache.
+    Condition *entryReady;  ///< Signalled when a busy entry is not anymore.
+
+    /// Cache entries, followed by one more that heads the order of use.
+    CachedSector *cache;
+    unsigned cacheSize;
+
+    /// Entry caching each sector, or `cacheSize` if it is not cached.
+    unsigned *entryOf;
+
+    /// Most sectors waiting to be read ahead.
+    static const unsigned READ_AHEAD_QUEUE = 32;
+
+    /// Sectors waiting to be read ahead, as a ring, and how many there are
+    /// from `readAheadFirst` on.
+    int readAheadQueue[READ_AHEAD_QUEUE];
+    unsigned readAheadFirst;
+    unsigned readAheadCount;
+
+    /// Counts the sectors in `readAheadQueue`, for the read-ahead thread.
+    Semaphore *readAheadPending;
+
+    /// Number of modified entries.
+    unsigned numDirty;
+
+    /// Whether the flusher thread has been told to write back the sectors
+    /// modified since it last started, and what tells it.
+    bool flushScheduled;
+    Semaphore *flushPending;
 };
 
 
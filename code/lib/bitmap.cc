@@ -23,9 +23,12 @@ Bitmap::Bitmap(unsigned nitems)
     numBits  = nitems;
     numWords = DivRoundUp(numBits, BITS_IN_WORD);
     map      = new unsigned [numWords];
-    for (unsigned i = 0; i < numBits; i++) {
-        Clear(i);
+    next     = 0;
+    for (unsigned i = 0; i < numWords; i++) {
+        map[i] = 0;
     }
+    dirtyFirst = 0;
+    dirtyEnd   = numWords;
 }
 
 /// De-allocate a bitmap.
@@ -42,6 +45,7 @@ Bitmap::Mark(unsigned which)
 {
     ASSERT(which < numBits);
     map[which / BITS_IN_WORD] |= 1 << which % BITS_IN_WORD;
+    Touch(which / BITS_IN_WORD);
 }
 
 /// Clear the “nth” bit in a bitmap.
@@ -52,6 +56,20 @@ Bitmap::Clear(unsigned which)
 {
     ASSERT(which < numBits);
     map[which / BITS_IN_WORD] &= ~(1 << which % BITS_IN_WORD);
+    Touch(which / BITS_IN_WORD);
+}
+
+void
+Bitmap::Touch(unsigned w)
+{
+    if (dirtyFirst == dirtyEnd) {
+        dirtyFirst = w;
+        dirtyEnd   = w + 1;
+    } else if (w < dirtyFirst) {
+        dirtyFirst = w;
+    } else if (w >= dirtyEnd) {
+        dirtyEnd = w + 1;
+    }
 }
 
 /// Return true if the “nth” bit is set.
@@ -64,17 +82,122 @@ Bitmap::Test(unsigned which) const
     return map[which / BITS_IN_WORD] & 1 << which % BITS_IN_WORD;
 }
 
-/// Return the number of the first bit which is clear.  As a side effect, set
-/// the bit (mark it as in use).  (In other words, find and allocate a bit.)
+unsigned
+Bitmap::ClearBits(unsigned w) const
+{
+    ASSERT(w < numWords);
+
+    unsigned bits = ~map[w];
+    if (w == numWords - 1 && numBits % BITS_IN_WORD != 0) {
+        bits &= (1U << numBits % BITS_IN_WORD) - 1;
+    }
+    return bits;
+}
+
+/// Return the number of the first bit which is clear, from the one after
+/// the bit found last time on.  As a side effect, set the bit (mark it as
+/// in use).  (In other words, find and allocate a bit.)
+///
+/// The word `next` is in is looked at twice: first from `next` on, and
+/// last, once every other word has been.
 ///
 /// If no bits are clear, return -1.
 int
 Bitmap::Find()
 {
-    for (unsigned i = 0; i < numBits; i++) {
-        if (!Test(i)) {
-            Mark(i);
-            return i;
+    unsigned first = next / BITS_IN_WORD;
+    for (unsigned i = 0; i <= numWords; i++) {
+        unsigned w = (first + i) % numWords;
+        unsigned bits = ClearBits(w);
+        if (i == 0) {
+            bits &= ~0U << next % BITS_IN_WORD;
+        }
+        if (bits != 0) {
+            unsigned which = w * BITS_IN_WORD + __builtin_ctz(bits);
+            Mark(which);
+            next = (which + 1) % numBits;
+            return which;
+        }
+    }
+    return -1;
+}
+
+int
+Bitmap::Find(unsigned begin, unsigned end)
+{
+    ASSERT(begin <= end && end <= numBits);
+
+    int which = -1;
+    unsigned length = 0;
+    FindRunIn(begin, end, 1, &which, &length);
+    if (which != -1) {
+        Mark(which);
+    }
+    return which;
+}
+
+bool
+Bitmap::FindRunIn(unsigned begin, unsigned end, unsigned count,
+                  int *best, unsigned *bestLength) const
+{
+    unsigned start = begin, run = 0;
+    for (unsigned i = begin; i < end;) {
+        unsigned step = 1;
+        bool clear;
+        if (i % BITS_IN_WORD == 0 && i + BITS_IN_WORD <= end
+              && (ClearBits(i / BITS_IN_WORD) == 0
+                  || ClearBits(i / BITS_IN_WORD) == ~0U)) {
+            step  = BITS_IN_WORD;  // The whole word is set, or clear.
+            clear = ClearBits(i / BITS_IN_WORD) != 0;
+        } else {
+            clear = !Test(i);
+        }
+
+        if (!clear) {
+            run = 0;
+        } else {
+            if (run == 0) {
+                start = i;
+            }
+            run += step;
+            if (run > *bestLength) {
+                *best       = start;
+                *bestLength = run < count ? run : count;
+                if (run >= count) {
+                    return true;
+                }
+            }
+        }
+        i += step;
+    }
+    return false;
+}
+
+/// Runs do not wrap around the end of the bitmap: one ending there is cut
+/// short when the search goes back to the start.
+int
+Bitmap::FindRun(unsigned from, unsigned count, unsigned *length) const
+{
+    ASSERT(from < numBits);
+    ASSERT(count > 0);
+    ASSERT(length != nullptr);
+
+    int best = -1;
+    *length = 0;
+    if (!FindRunIn(from, numBits, count, &best, length)) {
+        FindRunIn(0, from, count, &best, length);
+    }
+    return best;
+}
+
+int
+Bitmap::FindAlignedRun(unsigned count) const
+{
+    ASSERT(count > 0);
+
+    for (unsigned start = 0; start + count <= numBits; start += count) {
+        if (CountClear(start, start + count) == count) {
+            return start;
         }
     }
     return -1;
@@ -87,10 +210,27 @@ Bitmap::CountClear() const
 {
     unsigned count = 0;
 
-    for (unsigned i = 0; i < numBits; i++) {
-        if (!Test(i)) {
-            count++;
-        }
+    for (unsigned w = 0; w < numWords; w++) {
+        count += __builtin_popcount(ClearBits(w));
+    }
+    return count;
+}
+
+unsigned
+Bitmap::CountClear(unsigned begin, unsigned end) const
+{
+    ASSERT(begin <= end && end <= numBits);
+
+    unsigned count = 0;
+    unsigned i = begin;
+    for (; i < end && i % BITS_IN_WORD != 0; i++) {
+        count += !Test(i);
+    }
+    for (; i + BITS_IN_WORD <= end; i += BITS_IN_WORD) {
+        count += __builtin_popcount(ClearBits(i / BITS_IN_WORD));
+    }
+    for (; i < end; i++) {
+        count += !Test(i);
     }
     return count;
 }
@@ -121,6 +261,7 @@ Bitmap::FetchFrom(OpenFile *file)
 {
     ASSERT(file != nullptr);
     file->ReadAt((char *) map, numWords * sizeof (unsigned), 0);
+    dirtyFirst = dirtyEnd = 0;
 }
 
 /// Store the contents of a bitmap to a Nachos file.
@@ -129,8 +270,14 @@ Bitmap::FetchFrom(OpenFile *file)
 ///
 /// * `file` is the place to write the bitmap to.
 void
-Bitmap::WriteBack(OpenFile *file) const
+Bitmap::WriteBack(OpenFile *file)
 {
     ASSERT(file != nullptr);
-    file->WriteAt((char *) map, numWords * sizeof (unsigned), 0);
+    if (dirtyFirst == dirtyEnd) {
+        return;
+    }
+    file->WriteAt((char *) &map[dirtyFirst],
+                  (dirtyEnd - dirtyFirst) * sizeof (unsigned),
+                  dirtyFirst * sizeof (unsigned));
+    dirtyFirst = dirtyEnd = 0;
 }
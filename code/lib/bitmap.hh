@@ -3,7 +3,9 @@
 /// vector.
 ///
 /// The bitmap is represented as an array of unsigned integers, on which we
-/// do modulo arithmetic to find the bit we are interested in.
+/// do modulo arithmetic to find the bit we are interested in.  Searches go
+/// a word at a time, skipping over words with no clear bits, or with only
+/// clear bits.
 ///
 /// The data structure is parameterized with with the number of bits being
 /// managed.
@@ -51,13 +53,35 @@ public:
     bool Test(unsigned which) const;
 
     /// Return the index of a clear bit, and as a side effect, set the bit.
+    /// The search starts after the bit found last time, and wraps around
+    /// (“next fit”), so that it does not go over the bits taken already.
     ///
     /// If no bits are clear, return -1.
     int Find();
 
+    /// Like `Find`, but only among bits `begin` to `end - 1`, taking the
+    /// first that is clear.
+    int Find(unsigned begin, unsigned end);
+
+    /// Return the first index of a run of `count` clear bits, looking from
+    /// `from` on, and then from the start.  If there is no run that long,
+    /// return the first of the longest instead.  Set `*length` to the length
+    /// of the run returned, at most `count`.  Bits are left as they are.
+    ///
+    /// If no bits are clear, return -1.
+    int FindRun(unsigned from, unsigned count, unsigned *length) const;
+
+    /// Like `FindRun`, but only for a whole run of `count` clear bits that
+    /// starts at a multiple of `count`, looking from the start.  Return -1
+    /// if there is none.
+    int FindAlignedRun(unsigned count) const;
+
     /// Return the number of clear bits.
     unsigned CountClear() const;
 
+    /// Return the number of clear bits from `begin` to `end - 1`.
+    unsigned CountClear(unsigned begin, unsigned end) const;
+
     /// Print contents of bitmap.
     void Print() const;
 
@@ -67,11 +91,13 @@ public:
     /// need to read and write the bitmap to a file.
     void FetchFrom(OpenFile *file);
 
-    /// Write contents to disk.
+    /// Write contents to disk.  Only the words changed since the last
+    /// `FetchFrom` or `WriteBack` are written, so that a bitmap kept in
+    /// memory costs no more than the sectors it changes.
     ///
     /// Note: this is not needed until the *FILESYS* assignment, when we will
     /// need to read and write the bitmap to a file.
-    void WriteBack(OpenFile *file) const;
+    void WriteBack(OpenFile *file);
 
 private:
 
@@ -85,6 +111,26 @@ private:
     /// Bit storage.
     unsigned *map;
 
+    /// Where `Find` starts looking.
+    unsigned next;
+
+    /// Words changed since the bitmap was last read or written, from
+    /// `dirtyFirst` up to `dirtyEnd - 1`; none if they are equal.
+    unsigned dirtyFirst;
+    unsigned dirtyEnd;
+
+    /// Count word `w` among those changed.
+    void Touch(unsigned w);
+
+    /// Return the clear bits of word `w`, as set bits; bits past the end of
+    /// the bitmap are left out.
+    unsigned ClearBits(unsigned w) const;
+
+    /// Look for a run for `FindRun` in bits `begin` to `end - 1`; update
+    /// `*best` and `*bestLength` if a longer one is found, and return true
+    /// once one of `count` bits is.
+    bool FindRunIn(unsigned begin, unsigned end, unsigned count,
+                   int *best, unsigned *bestLength) const;
 };
 
 
@@ -20,18 +20,7 @@
 
 Debug::Debug()
 {
-    flags = "";
-}
-
-bool
-Debug::IsEnabled(char flag) const
-{
-    if (flags != nullptr) {
-        return strchr(flags, flag) != 0
-               || strchr(flags, '+') != 0;
-    } else {
-        return false;
-    }
+    SetFlags("");
 }
 
 const char *
@@ -44,6 +33,17 @@ void
 Debug::SetFlags(const char *new_flags)
 {
     flags = new_flags;
+
+    bool all = flags != nullptr && strchr(flags, '+') != nullptr;
+    for (unsigned i = 0; i < sizeof enabled / sizeof *enabled; i++) {
+        enabled[i] = all ? ~0U : 0;
+    }
+    if (flags != nullptr && !all) {
+        for (const char *f = flags; *f != '\0'; f++) {
+            unsigned char c = *f;
+            enabled[c / WORD_BITS] |= 1U << (c % WORD_BITS);
+        }
+    }
 }
 
 void
@@ -15,9 +15,17 @@
 /// * `a` -- address spaces (requires *USER_PROGRAM*).
 /// * `e` -- exception handling (requires *USER_PROGRAM*).
 /// * `n` -- network emulation (requires *NETWORK*).
+/// * `v` -- paging and swapping (requires *SWAP*).
+/// * `u` -- resources used by each thread, as it finishes.
 ///
 /// See also `debug_opts.hh`.
 ///
+/// Debug messages are checked for in the hottest paths of the simulation,
+/// so the flags are kept as a set of bits, one per character, and testing
+/// one is a single bit test, inline.  A build with `NO_DEBUG_MESSAGES`
+/// defined compiles `DEBUG` and `DEBUG_CONT` away, together with their
+/// arguments, and no flag is ever enabled.
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -40,7 +48,15 @@ public:
     Debug();
 
     /// Is this debug flag enabled?
-    bool IsEnabled(char flag) const;
+    bool IsEnabled(char flag) const
+    {
+#ifdef NO_DEBUG_MESSAGES
+        return false;
+#else
+        unsigned char c = flag;
+        return (enabled[c / WORD_BITS] >> (c % WORD_BITS)) & 1;
+#endif
+    }
 
     /// Get the current flags.
     const char *GetFlags() const;
@@ -73,9 +89,16 @@ public:
     void PrintCont(char flag, const char *format, ...) const;
 
 private:
+    /// Bits in each word of `enabled`.
+    static const unsigned WORD_BITS = 8 * sizeof (unsigned);
+
     /// String that controls which debug messages are printed.
     const char *flags;
 
+    /// The flags in `flags`, as a bit for each character; all of them if
+    /// `+` is among them.
+    unsigned enabled[256 / WORD_BITS];
+
     DebugOpts opts;
 };
 
@@ -0,0 +1,72 @@
+/// Routines to look entries of a table up by a hash.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "hash_index.hh"
+#include "utility.hh"
+
+
+HashIndex::HashIndex(unsigned size_)
+{
+    size = size_;
+    for (numBuckets = 1; numBuckets < 2 * size; numBuckets *= 2) {
+        ;
+    }
+    buckets = new int [numBuckets];
+    next    = new int [size];
+    Clear();
+}
+
+HashIndex::~HashIndex()
+{
+    delete [] next;
+    delete [] buckets;
+}
+
+void
+HashIndex::Clear()
+{
+    for (unsigned b = 0; b < numBuckets; b++) {
+        buckets[b] = -1;
+    }
+}
+
+void
+HashIndex::Insert(unsigned i, unsigned hash)
+{
+    ASSERT(i < size);
+
+    unsigned b = hash & (numBuckets - 1);
+    next[i] = buckets[b];
+    buckets[b] = i;
+}
+
+void
+HashIndex::Remove(unsigned i, unsigned hash)
+{
+    ASSERT(i < size);
+
+    int *link = &buckets[hash & (numBuckets - 1)];
+    while (*link != (int) i) {
+        ASSERT(*link != -1);
+        link = &next[*link];
+    }
+    *link = next[i];
+}
+
+int
+HashIndex::First(unsigned hash) const
+{
+    return buckets[hash & (numBuckets - 1)];
+}
+
+int
+HashIndex::Next(unsigned i) const
+{
+    ASSERT(i < size);
+
+    return next[i];
+}
@@ -0,0 +1,60 @@
+/// Data structures to look entries of a table up by a hash.
+///
+/// Caches and directories keep their entries in an array, and find them by
+/// some key.  A `HashIndex` chains the numbers of the entries, in the
+/// buckets of their hashes, through an array of its own: the entries need
+/// no links, and indexing one never allocates.  Owners compute the hashes,
+/// and compare keys as they walk a bucket, so the index knows nothing of
+/// what it indexes.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_LIB_HASHINDEX__HH
+#define NACHOS_LIB_HASHINDEX__HH
+
+
+/// An index of entries 0 to `size - 1` of some table, by hash.
+///
+/// There are a power of two of buckets, at least twice as many as entries,
+/// so that buckets stay short.  A bucket is walked with `First` and `Next`,
+/// which return -1 at its end:
+///
+///     for (int i = index.First(hash); i != -1; i = index.Next(i)) ...
+class HashIndex {
+public:
+
+    /// Make an empty index for `size` entries.
+    HashIndex(unsigned size);
+
+    ~HashIndex();
+
+    /// Take every entry out.
+    void Clear();
+
+    /// Put entry `i`, which must not be in, in the bucket of `hash`.
+    void Insert(unsigned i, unsigned hash);
+
+    /// Take entry `i` out of the bucket of `hash`, where it must be.
+    void Remove(unsigned i, unsigned hash);
+
+    /// Return the first entry in the bucket of `hash`, or -1 if it is
+    /// empty.
+    int First(unsigned hash) const;
+
+    /// Return the entry after `i` in its bucket, or -1.
+    int Next(unsigned i) const;
+
+private:
+
+    /// First entry in each bucket, and next entry in the same bucket after
+    /// each entry; -1 ends a bucket.
+    int *buckets;
+    unsigned numBuckets;
+    int *next;
+    unsigned size;
+};
+
+
+#endif
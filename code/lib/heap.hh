@@ -0,0 +1,252 @@
+/// Data structures to keep objects in priority order.
+///
+/// A `Heap` is a binary min-heap of pointers to items of type `T`, ordered
+/// by `BEFORE`.  The first item is found in constant time, and items are
+/// put on, taken off, or moved after their key changed, in logarithmic
+/// time.  So that any item can be found without a search, each item keeps
+/// its own position on the heap, in its member `POSITION`.
+///
+/// The heap grows as needed, but never shrinks; it does not own its items.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_LIB_HEAP__HH
+#define NACHOS_LIB_HEAP__HH
+
+
+#include "utility.hh"
+
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+class Heap {
+public:
+
+    /// Initialize an empty heap, with room for `capacity` items before it
+    /// has to grow.
+    Heap(unsigned capacity = 16);
+
+    /// De-allocate the heap.  Items left on it are not deleted.
+    ~Heap();
+
+    /// Put `item` on the heap.
+    void Push(T *item);
+
+    /// Get the first item, or null if the heap is empty.
+    T *Top() const;
+
+    /// Take the first item off the heap; return null if it is empty.
+    T *Pop();
+
+    /// Take `item`, which must be on the heap, off it.
+    void Remove(T *item);
+
+    /// Move `item`, which must be on the heap, to its place after its key
+    /// changed, either way.
+    void Update(T *item);
+
+    /// Is `item` on the heap?
+    bool Has(const T *item) const;
+
+    unsigned Size() const;
+
+    bool IsEmpty() const;
+
+    /// Get the item at position `i`, which must be less than `Size`.
+    /// Positions follow the heap, not the priority order.
+    T *Get(unsigned i) const;
+
+private:
+
+    /// Place `item` at position `i`, moving it up or down until the order
+    /// holds.
+    void SiftUp(unsigned i, T *item);
+    void SiftDown(unsigned i, T *item);
+
+    /// Put `item` at position `i`, and let it know.
+    void Place(unsigned i, T *item);
+
+    T **items;
+    unsigned size;
+    unsigned capacity;
+};
+
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+Heap<T, POSITION, BEFORE>::Heap(unsigned capacity_)
+{
+    ASSERT(capacity_ > 0);
+
+    capacity = capacity_;
+    items    = new T * [capacity];
+    size     = 0;
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+Heap<T, POSITION, BEFORE>::~Heap()
+{
+    delete [] items;
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+void
+Heap<T, POSITION, BEFORE>::Push(T *item)
+{
+    ASSERT(item != nullptr);
+
+    if (size == capacity) {
+        T **bigger = new T * [capacity * 2];
+        for (unsigned i = 0; i < size; i++) {
+            bigger[i] = items[i];
+        }
+        delete [] items;
+        items = bigger;
+        capacity *= 2;
+    }
+    SiftUp(size++, item);
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+T *
+Heap<T, POSITION, BEFORE>::Top() const
+{
+    return size == 0 ? nullptr : items[0];
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+T *
+Heap<T, POSITION, BEFORE>::Pop()
+{
+    if (size == 0) {
+        return nullptr;
+    }
+
+    T *top = items[0];
+    Remove(top);
+    return top;
+}
+
+/// The last item takes the place of the removed one, and goes up or down
+/// from there.
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+void
+Heap<T, POSITION, BEFORE>::Remove(T *item)
+{
+    ASSERT(Has(item));
+
+    unsigned i = item->*POSITION;
+    T *last = items[--size];
+    if (i < size) {
+        if (i > 0 && BEFORE(last, items[(i - 1) / 2])) {
+            SiftUp(i, last);
+        } else {
+            SiftDown(i, last);
+        }
+    }
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+void
+Heap<T, POSITION, BEFORE>::Update(T *item)
+{
+    ASSERT(Has(item));
+
+    unsigned i = item->*POSITION;
+    if (i > 0 && BEFORE(item, items[(i - 1) / 2])) {
+        SiftUp(i, item);
+    } else {
+        SiftDown(i, item);
+    }
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+bool
+Heap<T, POSITION, BEFORE>::Has(const T *item) const
+{
+    ASSERT(item != nullptr);
+
+    unsigned i = item->*POSITION;
+    return i < size && items[i] == item;
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+unsigned
+Heap<T, POSITION, BEFORE>::Size() const
+{
+    return size;
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+bool
+Heap<T, POSITION, BEFORE>::IsEmpty() const
+{
+    return size == 0;
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+T *
+Heap<T, POSITION, BEFORE>::Get(unsigned i) const
+{
+    ASSERT(i < size);
+
+    return items[i];
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+void
+Heap<T, POSITION, BEFORE>::SiftUp(unsigned i, T *item)
+{
+    while (i > 0 && BEFORE(item, items[(i - 1) / 2])) {
+        Place(i, items[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    Place(i, item);
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+void
+Heap<T, POSITION, BEFORE>::SiftDown(unsigned i, T *item)
+{
+    for (;;) {
+        unsigned child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && BEFORE(items[child + 1], items[child])) {
+            child++;
+        }
+        if (!BEFORE(items[child], item)) {
+            break;
+        }
+        Place(i, items[child]);
+        i = child;
+    }
+    Place(i, item);
+}
+
+template <class T, unsigned T::*POSITION,
+          bool (*BEFORE)(const T *, const T *)>
+void
+Heap<T, POSITION, BEFORE>::Place(unsigned i, T *item)
+{
+    items[i] = item;
+    item->*POSITION = i;
+}
+
+
+#endif
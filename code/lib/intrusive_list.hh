@@ -0,0 +1,233 @@
+/// Data structures to manage lists of objects that link themselves.
+///
+/// A `List` allocates an element to hold every item put on it.  The kernel
+/// queues of threads are changed all the time with interrupts disabled, and
+/// they should not depend on the heap: an intrusive list instead links its
+/// items through a `ListLink` embedded in each of them.  Inserting an item
+/// never allocates, and removing any item is done in constant time.
+///
+/// An item can be on as many intrusive lists at once as it has links.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_LIB_INTRUSIVELIST__HH
+#define NACHOS_LIB_INTRUSIVELIST__HH
+
+
+#include "utility.hh"
+
+
+/// The links of an item of type `T` on some intrusive list.
+template <class T>
+class ListLink {
+public:
+
+    /// Initialize the link as not being on any list.
+    ListLink();
+
+    /// Return whether the item is on some list.
+    bool IsLinked() const;
+
+    T *prev;           ///< Previous item, null if this is the first.
+    T *next;           ///< Next item, null if this is the last.
+    const void *list;  ///< List the item is on, null if none.
+};
+
+/// A doubly linked list of items of type `T`, linked through their member
+/// `LINK`.
+template <class T, ListLink<T> T::*LINK>
+class IntrusiveList {
+public:
+
+    /// Initialize the list.
+    IntrusiveList();
+
+    /// De-allocate the list.  It does not own its items; any left are
+    /// just taken off it.
+    ~IntrusiveList();
+
+    /// Put item at the beginning of the list.
+    void Prepend(T *item);
+
+    /// Put item at the end of the list.
+    void Append(T *item);
+
+    /// Get the item on the front of the list, or null if it is empty.
+    T *Head() const;
+
+    /// Get the item following `item`, which must be on the list, or null
+    /// if it is the last one.
+    T *Next(const T *item) const;
+
+    /// Take the item off the front of the list; return null if it is
+    /// empty.
+    T *Pop();
+
+    /// Take `item`, which must be on the list, off it.
+    void Remove(T *item);
+
+    /// Apply `func` to all items in the list.
+    void Apply(void (*func)(T *)) const;
+
+    /// Is `item` on the list?
+    bool Has(const T *item) const;
+
+    /// Is the list empty?
+    bool IsEmpty() const;
+
+private:
+
+    T *first;  ///< Head of the list, null if the list is empty.
+    T *last;   ///< Last element of the list.
+};
+
+
+template <class T>
+ListLink<T>::ListLink()
+{
+    prev = nullptr;
+    next = nullptr;
+    list = nullptr;
+}
+
+template <class T>
+bool
+ListLink<T>::IsLinked() const
+{
+    return list != nullptr;
+}
+
+template <class T, ListLink<T> T::*LINK>
+IntrusiveList<T, LINK>::IntrusiveList()
+{
+    first = last = nullptr;
+}
+
+template <class T, ListLink<T> T::*LINK>
+IntrusiveList<T, LINK>::~IntrusiveList()
+{
+    while (Pop() != nullptr) {}
+}
+
+template <class T, ListLink<T> T::*LINK>
+void
+IntrusiveList<T, LINK>::Prepend(T *item)
+{
+    ASSERT(item != nullptr);
+
+    ListLink<T> *link = &(item->*LINK);
+    ASSERT(!link->IsLinked());
+
+    link->prev = nullptr;
+    link->next = first;
+    link->list = this;
+    if (first == nullptr) {
+        last = item;
+    } else {
+        (first->*LINK).prev = item;
+    }
+    first = item;
+}
+
+template <class T, ListLink<T> T::*LINK>
+void
+IntrusiveList<T, LINK>::Append(T *item)
+{
+    ASSERT(item != nullptr);
+
+    ListLink<T> *link = &(item->*LINK);
+    ASSERT(!link->IsLinked());
+
+    link->prev = last;
+    link->next = nullptr;
+    link->list = this;
+    if (last == nullptr) {
+        first = item;
+    } else {
+        (last->*LINK).next = item;
+    }
+    last = item;
+}
+
+template <class T, ListLink<T> T::*LINK>
+T *
+IntrusiveList<T, LINK>::Head() const
+{
+    return first;
+}
+
+template <class T, ListLink<T> T::*LINK>
+T *
+IntrusiveList<T, LINK>::Next(const T *item) const
+{
+    ASSERT(item != nullptr);
+    ASSERT((item->*LINK).list == this);
+
+    return (item->*LINK).next;
+}
+
+template <class T, ListLink<T> T::*LINK>
+T *
+IntrusiveList<T, LINK>::Pop()
+{
+    T *item = first;
+    if (item != nullptr) {
+        Remove(item);
+    }
+    return item;
+}
+
+template <class T, ListLink<T> T::*LINK>
+void
+IntrusiveList<T, LINK>::Remove(T *item)
+{
+    ASSERT(item != nullptr);
+
+    ListLink<T> *link = &(item->*LINK);
+    ASSERT(link->list == this);
+
+    if (link->prev == nullptr) {
+        first = link->next;
+    } else {
+        (link->prev->*LINK).next = link->next;
+    }
+    if (link->next == nullptr) {
+        last = link->prev;
+    } else {
+        (link->next->*LINK).prev = link->prev;
+    }
+    link->prev = link->next = nullptr;
+    link->list = nullptr;
+}
+
+template <class T, ListLink<T> T::*LINK>
+void
+IntrusiveList<T, LINK>::Apply(void (*func)(T *)) const
+{
+    ASSERT(func != nullptr);
+
+    for (T *item = first; item != nullptr; item = (item->*LINK).next) {
+        func(item);
+    }
+}
+
+template <class T, ListLink<T> T::*LINK>
+bool
+IntrusiveList<T, LINK>::Has(const T *item) const
+{
+    ASSERT(item != nullptr);
+
+    return (item->*LINK).list == this;
+}
+
+template <class T, ListLink<T> T::*LINK>
+bool
+IntrusiveList<T, LINK>::IsEmpty() const
+{
+    return first == nullptr;
+}
+
+
+#endif
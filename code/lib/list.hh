@@ -12,6 +12,7 @@
 #define NACHOS_LIB_LIST__HH
 
 
+#include "slab.hh"
 #include "utility.hh"
 
 
@@ -27,6 +28,10 @@ public:
     // Initialize a list element.
     ListElement(Item itemPtr, int sortKey);
 
+    /// Elements come from `listElementSlab`, unless they do not fit.
+    static void *operator new(size_t size);
+    static void operator delete(void *element, size_t size);
+
     ListElement *next;  ///< Next element on list, null if this is the last.
     int key;            ///< Priority, for a sorted list.
     Item item;          ///< Item on the list.
@@ -98,6 +103,27 @@ ListElement<Item>::ListElement(Item anItem, int sortKey)
      next = nullptr;  // Assume we will put it at the end of the list.
 }
 
+template <class Item>
+void *
+ListElement<Item>::operator new(size_t size)
+{
+    if (size > listElementSlab.GetObjectSize()) {
+        return ::operator new(size);
+    }
+    return listElementSlab.Allocate();
+}
+
+template <class Item>
+void
+ListElement<Item>::operator delete(void *element, size_t size)
+{
+    if (size > listElementSlab.GetObjectSize()) {
+        ::operator delete(element);
+    } else {
+        listElementSlab.Free(element);
+    }
+}
+
 /// Initialize a list, empty to start with.
 ///
 /// Elements can now be added to the list.
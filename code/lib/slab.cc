@@ -0,0 +1,121 @@
+/// Routines to allocate kernel objects of one size quickly.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "slab.hh"
+#include "list.hh"
+#include "utility.hh"
+
+
+Slab *Slab::firstSlab = nullptr;
+
+Slab listElementSlab("ListElement", sizeof (ListElement<void *>));
+
+/// Objects are rounded up to keep every one of them aligned like memory
+/// from `new`, and to fit the free list link.
+Slab::Slab(const char *name_, size_t objectSize_, unsigned perChunk_)
+{
+    ASSERT(name_ != nullptr);
+    ASSERT(objectSize_ > 0);
+    ASSERT(perChunk_ > 0);
+
+    const size_t ALIGNMENT = alignof (max_align_t);
+
+    if (objectSize_ < sizeof (FreeObject)) {
+        objectSize_ = sizeof (FreeObject);
+    }
+    name        = name_;
+    objectSize  = (objectSize_ + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    perChunk    = perChunk_;
+    freeList    = nullptr;
+    allocations = 0;
+    numLive     = 0;
+    peakLive    = 0;
+    numChunks   = 0;
+
+    nextSlab  = firstSlab;
+    firstSlab = this;
+}
+
+void *
+Slab::Allocate()
+{
+    if (freeList == nullptr) {
+        Grow();
+    }
+    FreeObject *object = freeList;
+    freeList = object->next;
+
+    allocations++;
+    if (++numLive > peakLive) {
+        peakLive = numLive;
+    }
+    return object;
+}
+
+void
+Slab::Free(void *object)
+{
+    ASSERT(object != nullptr);
+    ASSERT(numLive > 0);
+
+    FreeObject *f = (FreeObject *) object;
+    f->next  = freeList;
+    freeList = f;
+    numLive--;
+}
+
+size_t
+Slab::GetObjectSize() const
+{
+    return objectSize;
+}
+
+void
+Slab::Grow()
+{
+    char *chunk = new char [perChunk * objectSize];
+    for (unsigned i = perChunk; i > 0; i--) {
+        FreeObject *f = (FreeObject *) &chunk[(i - 1) * objectSize];
+        f->next  = freeList;
+        freeList = f;
+    }
+    numChunks++;
+}
+
+void
+Slab::PrintAll()
+{
+    for (const Slab *s = firstSlab; s != nullptr; s = s->nextSlab) {
+        if (s->allocations == 0) {
+            continue;
+        }
+        printf("Slab %s: size %u, allocations %lu, live %lu, peak %lu, "
+               "chunks %lu\n",
+               s->name, (unsigned) s->objectSize, s->allocations,
+               s->numLive, s->peakLive, s->numChunks);
+    }
+}
+
+void
+Slab::PrintAllJSON(FILE *f)
+{
+    ASSERT(f != nullptr);
+
+    bool first = true;
+    fputc('[', f);
+    for (const Slab *s = firstSlab; s != nullptr; s = s->nextSlab) {
+        if (s->allocations == 0) {
+            continue;
+        }
+        fprintf(f, "%s{\"name\":\"%s\",\"size\":%u,\"allocations\":%lu,"
+                   "\"live\":%lu,\"peak\":%lu,\"chunks\":%lu}",
+                first ? "" : ",", s->name, (unsigned) s->objectSize,
+                s->allocations, s->numLive, s->peakLive, s->numChunks);
+        first = false;
+    }
+    fputc(']', f);
+}
@@ -0,0 +1,87 @@
+/// Data structures to allocate kernel objects of one size quickly.
+///
+/// Many kernel objects, such as pending interrupts, list elements or
+/// threads, are created and destroyed all the time.  A `Slab` hands out
+/// objects of a fixed size carved from chunks of memory, and keeps the
+/// objects given back on a free list, so that after a while neither
+/// allocating nor freeing one reaches the host's allocator.  Chunks are
+/// never given back: objects may still be freed while the program exits.
+///
+/// A class adopts a slab by defining its own `operator new` and `operator
+/// delete` on top of `Allocate` and `Free`.  Every slab counts what it
+/// hands out, and `Slab::PrintAll` reports it, so that the memory used by
+/// the kernel can be seen at the end of a run.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_LIB_SLAB__HH
+#define NACHOS_LIB_SLAB__HH
+
+
+#include <stddef.h>
+#include <stdio.h>
+
+
+class Slab {
+public:
+
+    /// Objects carved from each chunk, unless told otherwise.
+    static const unsigned DEFAULT_CHUNK = 32;
+
+    /// Initialize a slab of objects of `objectSize` bytes, called `name`
+    /// in the statistics, taking `perChunk` of them at a time from the
+    /// host.
+    Slab(const char *name, size_t objectSize,
+         unsigned perChunk = DEFAULT_CHUNK);
+
+    /// Return memory for an object.
+    void *Allocate();
+
+    /// Give back `object`, which must come from `Allocate`.
+    void Free(void *object);
+
+    /// Size of the objects, rounded up for alignment.
+    size_t GetObjectSize() const;
+
+    /// Print the usage of every slab that handed out anything, one per
+    /// line.
+    static void PrintAll();
+
+    /// Same, as a JSON array.
+    static void PrintAllJSON(FILE *f);
+
+private:
+
+    /// An object on the free list.
+    class FreeObject {
+    public:
+        FreeObject *next;
+    };
+
+    /// Take a new chunk from the host, and put its objects on the free
+    /// list.
+    void Grow();
+
+    const char *name;
+    size_t objectSize;
+    unsigned perChunk;
+    FreeObject *freeList;
+
+    unsigned long allocations;
+    unsigned long numLive;   ///< Objects allocated and not freed yet.
+    unsigned long peakLive;  ///< Most objects live at once.
+    unsigned long numChunks;
+
+    /// Every slab, so that they can be reported.
+    Slab *nextSlab;
+    static Slab *firstSlab;
+};
+
+/// Slab shared by list elements whose item is no bigger than a pointer,
+/// which are those of nearly every list in the kernel.
+extern Slab listElementSlab;
+
+
+#endif
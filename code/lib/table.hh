@@ -8,22 +8,37 @@
 #define NACHOS_LIB_TABLE__HH
 
 
-#include "list.hh"
+#include "utility.hh"
+
+#include <limits.h>
+#include <new>
 
 
 template <class T>
 class Table {
 public:
+    /// Number of indexes available in a new table.
     static const unsigned SIZE = 20;
 
     /// Construct an empty table.
-    Table();
+    ///
+    /// The table starts with room for `initialSize` items, and doubles in
+    /// size whenever it runs out of free indexes.
+    Table(unsigned initialSize = SIZE);
+
+    ~Table();
 
     /// Add an item into a free index.
     ///
     /// Returns -1 if no space is left to add the item.
     int Add(T item);
 
+    /// Add an item at index `i`, which must be free, growing the table if
+    /// `i` is past its end.
+    ///
+    /// Returns false if no space is left to add the item.
+    bool AddAt(int i, T item);
+
     /// Get the item associated with a given index.
     T Get(int i) const;
 
@@ -33,6 +48,10 @@ public:
     /// Check whether the table is empty.
     bool IsEmpty() const;
 
+    /// Number of indexes the table has room for; every index with an item
+    /// is below it.
+    unsigned Capacity() const;
+
     /// Remove the item associated with a given index.
     ///
     /// Returns the removed item, or `T()` if the index is already
@@ -47,44 +66,132 @@ public:
     T Update(int i, T item);
 
 private:
+    /// Marks an index in use in `next`.
+    static const int USED = -2;
+
+    /// Make room for at least one more item.  Returns false if memory is
+    /// exhausted.
+    bool Grow();
+
     /// Data items.
-    T data[SIZE];
+    T *data;
+
+    /// For every free index, the next free one, or -1; `USED` for indexes
+    /// that have an item.  Free indexes are thus kept in a list threaded
+    /// through this array, so that neither adding nor removing an item
+    /// needs to search or allocate anything.
+    int *next;
+
+    /// Number of indexes in `data` and `next`.
+    unsigned capacity;
 
-    /// Current greatest index for a new item.
-    int current;
+    /// First free index, or -1 if the table is full.
+    int freeHead;
 
-    /// A list to store indexes of items that have been freed and are not
-    /// among those with greatest numbers, so it is not possible to modify
-    /// `current`.  In other words, this keeps track of external
-    /// fragmentation.
-    List<int> freed;
+    /// Number of indexes in use.
+    unsigned count;
 };
 
 
 template <class T>
-Table<T>::Table()
+Table<T>::Table(unsigned initialSize)
 {
-    current = 0;
+    ASSERT(initialSize > 0);
+
+    capacity = initialSize;
+    data     = new T [capacity];
+    next     = new int [capacity];
+    for (unsigned i = 0; i < capacity; i++) {
+        next[i] = i + 1 < capacity ? (int) i + 1 : -1;
+    }
+    freeHead = 0;
+    count    = 0;
 }
 
+template <class T>
+Table<T>::~Table()
+{
+    delete [] data;
+    delete [] next;
+}
+
+template <class T>
+bool
+Table<T>::Grow()
+{
+    unsigned newCapacity = capacity * 2;
+    if (newCapacity <= capacity || newCapacity > (unsigned) INT_MAX) {
+        return false;
+    }
+
+    T *newData = new (std::nothrow) T [newCapacity];
+    int *newNext = new (std::nothrow) int [newCapacity];
+    if (newData == nullptr || newNext == nullptr) {
+        delete [] newData;
+        delete [] newNext;
+        return false;
+    }
+
+    for (unsigned i = 0; i < capacity; i++) {
+        newData[i] = data[i];
+        newNext[i] = next[i];
+    }
+    for (unsigned i = capacity; i < newCapacity; i++) {
+        newNext[i] = i + 1 < newCapacity ? (int) i + 1 : freeHead;
+    }
+    freeHead = capacity;
+
+    delete [] data;
+    delete [] next;
+    data     = newData;
+    next     = newNext;
+    capacity = newCapacity;
+    return true;
+}
 
 template <class T>
 int
 Table<T>::Add(T item)
 {
-    int i;
-
-    if (!freed.IsEmpty()) {
-        i = freed.Pop();
-        data[i] = item;
-        return i;
-    } else if (current < static_cast<int>(SIZE)) {
-        i = current++;
-        data[i] = item;
-        return i;
-    } else {
+    if (freeHead == -1 && !Grow()) {
         return -1;
     }
+
+    int i = freeHead;
+    freeHead = next[i];
+    next[i]  = USED;
+    data[i]  = item;
+    count++;
+    return i;
+}
+
+template <class T>
+bool
+Table<T>::AddAt(int i, T item)
+{
+    ASSERT(i >= 0);
+    ASSERT(!HasKey(i));
+
+    while ((unsigned) i >= capacity) {
+        if (!Grow()) {
+            return false;
+        }
+    }
+
+    // Take `i` out of the list of free indexes.
+    if (freeHead == i) {
+        freeHead = next[i];
+    } else {
+        int j = freeHead;
+        while (next[j] != i) {
+            j = next[j];
+        }
+        next[j] = next[i];
+    }
+    next[i] = USED;
+    data[i] = item;
+    count++;
+    return true;
 }
 
 template <class T>
@@ -102,14 +209,21 @@ Table<T>::HasKey(int i) const
 {
     ASSERT(i >= 0);
 
-    return i < current && !freed.Has(i);
+    return (unsigned) i < capacity && next[i] == USED;
 }
 
 template <class T>
 bool
 Table<T>::IsEmpty() const
 {
-    return current == 0;
+    return count == 0;
+}
+
+template <class T>
+unsigned
+Table<T>::Capacity() const
+{
+    return capacity;
 }
 
 template <class T>
@@ -122,26 +236,19 @@ Table<T>::Remove(int i)
         return T();
     }
 
-    if (i == current - 1) {
-        current--;
-        for (int j = current - 1; j >= 0 && !HasKey(j); j--) {
-            ASSERT(freed.Has(j));
-            freed.SortedPop(&j);
-            current--;
-        }
-    } else {
-        freed.SortedInsert(i, i);
-    }
-    return data[i];
+    T item = data[i];
+    data[i]  = T();
+    next[i]  = freeHead;
+    freeHead = i;
+    count--;
+    return item;
 }
 
 template <class T>
 T
 Table<T>::Update(int i, T item)
 {
-    ASSERT(i >= 0);
-    ASSERT(i < current);
-    ASSERT(!freed.Has(i));
+    ASSERT(HasKey(i));
 
     T previous = data[i];
     data[i] = item;
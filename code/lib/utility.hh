@@ -66,8 +66,25 @@ typedef void (*VoidNoArgFunctionPtr)();
 /// Global object for debug output.
 extern Debug debug;
 
-#define DEBUG(...)  (debug.Print)(__FILE__, __LINE__, __func__, __VA_ARGS__)
-#define DEBUG_CONT  (debug.PrintCont)
+/// Print a debug message if `flag` is enabled, as `Debug::Print` and
+/// `Debug::PrintCont` do.  The enabled check is inline, so the arguments are
+/// not even evaluated for a flag not enabled; with `NO_DEBUG_MESSAGES`, no
+/// code is left, but the arguments are still compiled, so that they do not
+/// go stale, nor the variables only used in them unused.
+#ifdef NO_DEBUG_MESSAGES
+#define DEBUG(flag, ...) \
+    (true ? (void) 0 \
+          : (debug.Print)(__FILE__, __LINE__, __func__, flag, __VA_ARGS__))
+#define DEBUG_CONT(flag, ...) \
+    (true ? (void) 0 : (debug.PrintCont)(flag, __VA_ARGS__))
+#else
+#define DEBUG(flag, ...) \
+    (debug.IsEnabled(flag) \
+       ? (debug.Print)(__FILE__, __LINE__, __func__, flag, __VA_ARGS__) \
+       : (void) 0)
+#define DEBUG_CONT(flag, ...) \
+    (debug.IsEnabled(flag) ? (debug.PrintCont)(flag, __VA_ARGS__) : (void) 0)
+#endif
 
 
 #endif
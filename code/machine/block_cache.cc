@@ -0,0 +1,193 @@
+/// Routines to translate and cache basic blocks of user code.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "block_cache.hh"
+#include "endianness.hh"
+#include "lib/utility.hh"
+#ifdef SUPERINSTRUCTIONS
+#include "mips_core.hh"
+#endif
+
+
+/// Whether `opCode` ends a basic block once its delay slot (if any) has
+/// been executed.
+static inline bool
+IsControlTransfer(unsigned char opCode)
+{
+    switch (opCode) {
+        case OP_BEQ:
+        case OP_BGEZ:
+        case OP_BGEZAL:
+        case OP_BGTZ:
+        case OP_BLEZ:
+        case OP_BLTZ:
+        case OP_BLTZAL:
+        case OP_BNE:
+        case OP_J:
+        case OP_JAL:
+        case OP_JALR:
+        case OP_JR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Whether `opCode` always traps into the kernel.
+static inline bool
+IsTrap(unsigned char opCode)
+{
+    return opCode == OP_SYSCALL || opCode == OP_RES || opCode == OP_UNIMP;
+}
+
+/// Free `block` and what it owns.
+static void
+Release(BasicBlock *block)
+{
+    delete [] block->instrs;
+#ifdef SUPERINSTRUCTIONS
+    delete [] block->fused;
+#endif
+    delete block;
+}
+
+BlockCache::BlockCache(unsigned numFrames_, unsigned frameSize)
+{
+    ASSERT(frameSize % 4 == 0);
+
+    numFrames     = numFrames_;
+    wordsPerFrame = frameSize / 4;
+    blocks        = new BasicBlock * [numFrames * wordsPerFrame];
+    generation    = new unsigned [numFrames];
+    codeLow       = new unsigned [numFrames];
+    codeHigh      = new unsigned [numFrames];
+
+    for (unsigned i = 0; i < numFrames * wordsPerFrame; i++) {
+        blocks[i] = nullptr;
+    }
+    for (unsigned i = 0; i < numFrames; i++) {
+        generation[i] = 0;
+        codeLow[i] = codeHigh[i] = 0;
+    }
+}
+
+BlockCache::~BlockCache()
+{
+    for (unsigned i = 0; i < numFrames * wordsPerFrame; i++) {
+        if (blocks[i] != nullptr) {
+            Release(blocks[i]);
+        }
+    }
+    delete [] blocks;
+    delete [] generation;
+    delete [] codeLow;
+    delete [] codeHigh;
+}
+
+const BasicBlock *
+BlockCache::Find(const char *memory, unsigned physAddr)
+{
+    ASSERT(memory != nullptr);
+    ASSERT(physAddr % 4 == 0);
+
+    unsigned word = physAddr / 4;
+    ASSERT(word < numFrames * wordsPerFrame);
+
+    BasicBlock *block = blocks[word];
+    if (block != nullptr && block->generation != generation[block->frame]) {
+        Release(block);
+        block = blocks[word] = nullptr;
+    }
+    if (block == nullptr) {
+        block = blocks[word] = Translate(memory, physAddr);
+    }
+    return block;
+}
+
+bool
+BlockCache::IsCurrent(unsigned frame, unsigned gen) const
+{
+    ASSERT(frame < numFrames);
+    return generation[frame] == gen;
+}
+
+void
+BlockCache::InvalidateWord(unsigned physAddr)
+{
+    unsigned word  = physAddr / 4;
+    unsigned frame = word / wordsPerFrame;
+    ASSERT(frame < numFrames);
+
+    unsigned offset = word % wordsPerFrame;
+    if (offset >= codeLow[frame] && offset < codeHigh[frame]) {
+        InvalidateFrame(frame);
+    }
+}
+
+void
+BlockCache::InvalidateFrame(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    if (codeLow[frame] == codeHigh[frame]) {
+        return;  // Nothing was translated from this frame.
+    }
+    generation[frame]++;
+    codeLow[frame] = codeHigh[frame] = 0;
+}
+
+BasicBlock *
+BlockCache::Translate(const char *memory, unsigned physAddr)
+{
+    unsigned word   = physAddr / 4;
+    unsigned frame  = word / wordsPerFrame;
+    unsigned offset = word % wordsPerFrame;
+
+    // Decode up to the end of the block: after the delay slot of a control
+    // transfer, at a trap, or at the end of the frame.
+    Instruction *instrs = new Instruction [wordsPerFrame - offset];
+    unsigned length = 0;
+    bool inDelaySlot = false;
+    while (offset + length < wordsPerFrame) {
+        Instruction *instr = &instrs[length];
+        instr->value = WordToHost(*(const unsigned *)
+                                  &memory[(word + length) * 4]);
+        instr->Decode();
+        length++;
+        if (inDelaySlot || IsTrap(instr->opCode)) {
+            break;
+        }
+        inDelaySlot = IsControlTransfer(instr->opCode);
+    }
+
+    BasicBlock *block = new BasicBlock;
+    block->frame      = frame;
+    block->generation = generation[frame];
+    block->length     = length;
+    block->instrs     = instrs;
+#ifdef SUPERINSTRUCTIONS
+    block->fused = new unsigned char [length];
+    for (unsigned i = 0; i + 1 < length; i++) {
+        block->fused[i] = MipsFusePair(&instrs[i], &instrs[i + 1]);
+    }
+    block->fused[length - 1] = FUSED_NONE;
+#endif
+
+    if (codeLow[frame] == codeHigh[frame]) {
+        codeLow[frame]  = offset;
+        codeHigh[frame] = offset + length;
+    } else {
+        if (offset < codeLow[frame]) {
+            codeLow[frame] = offset;
+        }
+        if (offset + length > codeHigh[frame]) {
+            codeHigh[frame] = offset + length;
+        }
+    }
+    return block;
+}
@@ -0,0 +1,100 @@
+/// Data structures for translating user code into basic blocks.
+///
+/// A basic block is a straight run of instructions that ends right after a
+/// control transfer (and its delay slot), a system call, or the end of the
+/// page.  Each block is decoded once, the first time it is reached, and is
+/// then executed back to back by `Machine::Run` without going through the
+/// MMU for every fetch.
+///
+/// Blocks are indexed by the physical address of their first instruction
+/// and never cross a frame boundary.  Every frame carries a generation
+/// number that is bumped whenever code translated from it may have changed;
+/// a block whose generation is not current must not be executed anymore,
+/// and is dropped the next time it is looked up.
+///
+/// With `SUPERINSTRUCTIONS`, translation also looks for pairs of
+/// instructions that the execution core can run as one (see `FusedPair` in
+/// `mips_core.hh`), so that `Machine::RunBlock` goes through its loop once
+/// for both.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_BLOCKCACHE__HH
+#define NACHOS_MACHINE_BLOCKCACHE__HH
+
+
+#include "instruction.hh"
+
+
+class BasicBlock {
+public:
+
+    /// Frame containing the block, and its generation at translation time.
+    unsigned frame;
+    unsigned generation;
+
+    /// Number of instructions in the block.
+    unsigned length;
+
+    /// Decoded instructions, in order.
+    Instruction *instrs;
+
+#ifdef SUPERINSTRUCTIONS
+    /// The pair that each instruction makes with the next one, or
+    /// `FUSED_NONE`.  Pairs may overlap: which are run depends on where
+    /// the block is left.
+    unsigned char *fused;
+#endif
+};
+
+class BlockCache {
+public:
+
+    /// Create an empty cache covering `numFrames` frames of `frameSize`
+    /// bytes each.
+    BlockCache(unsigned numFrames, unsigned frameSize);
+
+    ~BlockCache();
+
+    /// Return the block starting at physical address `physAddr`, decoding
+    /// it from `memory` if it is not cached yet.
+    const BasicBlock *Find(const char *memory, unsigned physAddr);
+
+    /// Whether a block translated from `frame` at `generation` is still
+    /// safe to execute.
+    ///
+    /// Takes the frame and generation instead of the block itself, because
+    /// a stale block may already have been released.
+    bool IsCurrent(unsigned frame, unsigned generation) const;
+
+    /// Note a store to `physAddr`.
+    void InvalidateWord(unsigned physAddr);
+
+    /// Drop every block of a physical frame.
+    void InvalidateFrame(unsigned frame);
+
+private:
+
+    /// Decode a new block starting at `physAddr`.
+    BasicBlock *Translate(const char *memory, unsigned physAddr);
+
+    unsigned numFrames;
+    unsigned wordsPerFrame;
+
+    /// Blocks, indexed by the word of physical memory they start at.
+    BasicBlock **blocks;
+
+    /// Per-frame generation numbers.
+    unsigned *generation;
+
+    /// Per-frame range of words covered by some block, `[codeLow,
+    /// codeHigh)`.  Stores outside of it cannot affect translated code.
+    unsigned *codeLow;
+    unsigned *codeHigh;
+};
+
+
+#endif
@@ -0,0 +1,172 @@
+/// Routines to model the memory caches of the simulated CPU.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "cache_model.hh"
+#include "threads/system.hh"
+
+#include <stdlib.h>
+
+
+CacheGeometry cacheGeometries[NUM_CACHE_LEVELS];
+
+static const char *LEVEL_NAMES[] = { "L1I", "L1D", "L2" };
+
+static bool
+IsPowerOfTwo(unsigned n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+bool
+ParseCacheGeometry(const char *text, CacheGeometry *geometry)
+{
+    ASSERT(text != nullptr);
+    ASSERT(geometry != nullptr);
+
+    char *end;
+    unsigned size     = strtoul(text, &end, 10);
+    unsigned ways     = 2;
+    unsigned lineSize = 16;
+    if (*end == ':') {
+        ways = strtoul(end + 1, &end, 10);
+        if (*end == ':') {
+            lineSize = strtoul(end + 1, &end, 10);
+        }
+    }
+    if (*end != '\0' || ways == 0 || lineSize < 4 || !IsPowerOfTwo(lineSize)
+          || size % (ways * lineSize) != 0
+          || !IsPowerOfTwo(size / (ways * lineSize))) {
+        return false;
+    }
+
+    geometry->size     = size;
+    geometry->ways     = ways;
+    geometry->lineSize = lineSize;
+    return true;
+}
+
+const char *
+CacheLevelToString(CacheLevelId level)
+{
+    ASSERT(level < NUM_CACHE_LEVELS);
+    return LEVEL_NAMES[level];
+}
+
+CacheLevel::CacheLevel(const CacheGeometry *geometry)
+{
+    ASSERT(geometry != nullptr && geometry->size > 0);
+
+    ways    = geometry->ways;
+    numSets = geometry->size / (ways * geometry->lineSize);
+    lineShift = 0;
+    while ((1U << lineShift) < geometry->lineSize) {
+        lineShift++;
+    }
+
+    tags    = new unsigned [numSets * ways];
+    lastUse = new unsigned long [numSets * ways];
+    clock   = 0;
+    for (unsigned i = 0; i < numSets * ways; i++) {
+        tags[i]    = NO_LINE;
+        lastUse[i] = 0;
+    }
+}
+
+CacheLevel::~CacheLevel()
+{
+    delete [] tags;
+    delete [] lastUse;
+}
+
+bool
+CacheLevel::Access(unsigned physAddr)
+{
+    unsigned line  = physAddr >> lineShift;
+    unsigned first = (line & (numSets - 1)) * ways;
+
+    clock++;
+    unsigned victim = first;
+    for (unsigned i = first; i < first + ways; i++) {
+        if (tags[i] == line) {
+            lastUse[i] = clock;
+            return true;
+        }
+        if (lastUse[i] < lastUse[victim]) {
+            victim = i;
+        }
+    }
+    tags[victim]    = line;
+    lastUse[victim] = clock;
+    return false;
+}
+
+CacheHierarchy::CacheHierarchy()
+{
+    for (unsigned i = 0; i < NUM_CACHE_LEVELS; i++) {
+        levels[i] = cacheGeometries[i].size == 0
+                    ? nullptr : new CacheLevel(&cacheGeometries[i]);
+    }
+}
+
+CacheHierarchy::~CacheHierarchy()
+{
+    for (unsigned i = 0; i < NUM_CACHE_LEVELS; i++) {
+        delete levels[i];
+    }
+}
+
+bool
+CacheHierarchy::IsConfigured()
+{
+    return cacheGeometries[CACHE_L1I].size > 0
+           || cacheGeometries[CACHE_L1D].size > 0;
+}
+
+void
+CacheHierarchy::Fetch(unsigned physAddr)
+{
+    Lookup(CACHE_L1I, physAddr);
+}
+
+void
+CacheHierarchy::Access(unsigned physAddr)
+{
+    Lookup(CACHE_L1D, physAddr);
+}
+
+void
+CacheHierarchy::Lookup(CacheLevelId first, unsigned physAddr)
+{
+    if (levels[first] == nullptr) {
+        return;  // Not modelled.
+    }
+
+    stats->cacheAccesses[first]++;
+    currentThread->usage.cacheAccesses++;
+    if (levels[first]->Access(physAddr)) {
+        return;
+    }
+    stats->cacheMisses[first]++;
+    currentThread->usage.cacheMisses++;
+
+    unsigned stall = MEMORY_TICKS;
+    if (levels[CACHE_L2] != nullptr) {
+        stats->cacheAccesses[CACHE_L2]++;
+        if (levels[CACHE_L2]->Access(physAddr)) {
+            stall = L2_HIT_TICKS;
+        } else {
+            stats->cacheMisses[CACHE_L2]++;
+        }
+    }
+
+    // Charged as user time of the instruction, before `OneTick` checks for
+    // the interrupts that came due meanwhile.
+    stats->totalTicks      += stall;
+    stats->userTicks       += stall;
+    stats->cacheStallTicks += stall;
+    currentThread->usage.userTicks += stall;
+}
@@ -0,0 +1,123 @@
+/// Data structures to model the memory caches of the simulated CPU.
+///
+/// Every user access costs `USER_TICK`, whether the word is used over and
+/// over or touched once, so nothing tells a program laid out to use the
+/// caches of a real machine from one that is not.  Built with
+/// `-DCACHE_MODEL`, the MMU can send the physical address of every fetch,
+/// load and store of a user program through a model of split first level
+/// caches, for instructions and for data, and a unified second level,
+/// charging the time a miss takes to the program, as user ticks.
+///
+/// Each level is set associative, with least recently used replacement,
+/// and of the geometry chosen when Nachos starts.  Accesses whose first
+/// level is not there are left out of the model, and cost what they did
+/// before; without a second level, first level misses go to main memory.
+/// First level hits cost nothing more.  Only tags are kept: the data are
+/// always read from main memory, so the model changes the time programs
+/// take, and never what they compute.  Stores allocate lines as loads do,
+/// and writing lines back is not charged.  Accesses by the kernel, and
+/// changes to frames behind the CPU's back, are not seen.
+///
+/// Each CPU has caches of its own, not kept coherent, which would only
+/// change the time taken.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_CACHEMODEL__HH
+#define NACHOS_MACHINE_CACHEMODEL__HH
+
+
+/// The levels modelled.
+enum CacheLevelId {
+    CACHE_L1I,  ///< First level, for instruction fetches.
+    CACHE_L1D,  ///< First level, for loads and stores.
+    CACHE_L2,   ///< Second level, behind both.
+    NUM_CACHE_LEVELS
+};
+
+/// Ticks a first level miss takes when the second level has the line, and
+/// when the line comes from main memory.
+const unsigned L2_HIT_TICKS = 4;
+const unsigned MEMORY_TICKS = 20;
+
+/// Size, associativity and line size of one level.  A size of zero means
+/// the level is not there.
+class CacheGeometry {
+public:
+    unsigned size;
+    unsigned ways;
+    unsigned lineSize;
+};
+
+/// Geometries of the levels of every CPU.  They can be chosen when Nachos
+/// starts, before the machine is made; all are absent by default.
+extern CacheGeometry cacheGeometries[NUM_CACHE_LEVELS];
+
+/// Parse a geometry written `<bytes>[:<ways>[:<line bytes>]]`, with 2 ways
+/// of 16 bytes unless told otherwise.  Return false unless it describes
+/// whole sets of a power of two lines, whose size is a power of two of at
+/// least a word.
+bool ParseCacheGeometry(const char *text, CacheGeometry *geometry);
+
+/// Return the name of a level, as printed in the statistics.
+const char *CacheLevelToString(CacheLevelId level);
+
+/// The tags of one level.
+class CacheLevel {
+public:
+
+    CacheLevel(const CacheGeometry *geometry);
+
+    ~CacheLevel();
+
+    /// Look up the line holding `physAddr`, bringing it in if missing, in
+    /// place of the least recently used of its set.  Return whether it
+    /// was there.
+    bool Access(unsigned physAddr);
+
+private:
+
+    unsigned numSets;
+    unsigned ways;
+    unsigned lineShift;
+
+    /// Line number held by each way of each set, or `NO_LINE`, and the
+    /// value of `clock` when it was last used.
+    unsigned *tags;
+    unsigned long *lastUse;
+    unsigned long clock;
+
+    static const unsigned NO_LINE = (unsigned) -1;
+};
+
+/// The levels of one CPU.
+class CacheHierarchy {
+public:
+
+    /// Build the levels described by `cacheGeometries`.
+    CacheHierarchy();
+
+    ~CacheHierarchy();
+
+    /// Return whether a first level is described, so that a hierarchy is
+    /// worth building.
+    static bool IsConfigured();
+
+    /// Account for a user fetch from, or a load or store to, `physAddr`,
+    /// charging the ticks a miss takes to the running thread.
+    void Fetch(unsigned physAddr);
+    void Access(unsigned physAddr);
+
+private:
+
+    /// Go through `first`, and the second level on a miss.
+    void Lookup(CacheLevelId first, unsigned physAddr);
+
+    /// Each level, or null if it is not there.
+    CacheLevel *levels[NUM_CACHE_LEVELS];
+};
+
+
+#endif
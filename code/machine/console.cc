@@ -18,6 +18,7 @@
 #include "threads/system.hh"
 
 #include <stdio.h>
+#include <string.h>
 
 
 /// Dummy functions because C++ is weird about pointers to member functions.
@@ -48,9 +49,10 @@ ConsoleWriteDone(void *c)
 ///   from the keyboard.
 /// * `writeDone` is the interrupt handler called when a character has been
 ///   output, so that it is ok to request the next char be output.
+/// * `cooked_` tells whether the input is read a line at a time.
 Console::Console(const char *readFile, const char *writeFile,
         VoidFunctionPtr readAvail,
-        VoidFunctionPtr writeDone, void *callArg)
+        VoidFunctionPtr writeDone, void *callArg, bool cooked_)
 {
     ASSERT(readAvail != nullptr);
     ASSERT(writeDone != nullptr);
@@ -72,7 +74,18 @@ Console::Console(const char *readFile, const char *writeFile,
     readHandler  = readAvail;
     handlerArg   = callArg;
     putBusy      = false;
+    putCount     = 0;
     incoming     = EOF;
+    outCount     = 0;
+    cooked       = cooked_;
+    inStart      = 0;
+    inCount      = 0;
+    lineLeft     = 0;
+    inputEnded   = false;
+    endHanded    = false;
+    if (consoleScript != nullptr) {
+        consoleScript->Attach(this);
+    }
 
     // Start polling for incoming packets.
     interrupt->Schedule(ConsoleReadPoll, this,
@@ -82,6 +95,10 @@ Console::Console(const char *readFile, const char *writeFile,
 /// Clean up console emulation.
 Console::~Console()
 {
+    Flush();
+    if (consoleScript != nullptr) {
+        consoleScript->Detach(this);
+    }
     if (readFileNo != 0) {
         SystemDep::Close(readFileNo);
     }
@@ -106,26 +123,118 @@ Console::CheckCharAvail()
     interrupt->Schedule(ConsoleReadPoll, this,
             CONSOLE_TIME, CONSOLE_READ_INT);
 
+    if (cooked) {
+        CheckLineAvail();
+        return;
+    }
+
     // Do nothing if character is already buffered, or none to be read.
-    if (incoming != EOF || !SystemDep::PollFile(readFileNo)) {
+    if (incoming != EOF || ReadInput(&c, sizeof c) <= 0) {
         return;
     }
 
-    // Otherwise, read character and tell user about it.
-    SystemDep::Read(readFileNo, &c, sizeof c);
+    // Otherwise, tell user about the character read.
     incoming = c;
     stats->numConsoleCharsRead++;
     (*readHandler)(handlerArg);
 }
 
+/// Nothing is read while the line handed last is being gotten.  Input with
+/// no newline yet is waited for, unless it fills the buffer.
+void
+Console::CheckLineAvail()
+{
+    if (lineLeft > 0 || endHanded) {
+        return;
+    }
+
+    const char *line = &inBuffer[inStart];
+    const char *newline = (const char *) memchr(line, '\n', inCount);
+    if (newline == nullptr && !inputEnded && inCount < BUFFER_SIZE) {
+        memmove(inBuffer, line, inCount);
+        inStart = 0;
+        line = inBuffer;
+        int n = ReadInput(&inBuffer[inCount], BUFFER_SIZE - inCount);
+        if (n == 0) {
+            inputEnded = true;
+        } else if (n > 0) {
+            inCount += n;
+        }
+        newline = (const char *) memchr(line, '\n', inCount);
+    }
+
+    if (newline != nullptr) {
+        lineLeft = newline - line + 1;
+    } else if (inCount == BUFFER_SIZE || (inputEnded && inCount > 0)) {
+        lineLeft = inCount;
+    } else if (inputEnded) {
+        endHanded = true;  // Nothing to get: the end of the input.
+    } else {
+        return;
+    }
+    stats->numConsoleCharsRead += lineLeft;
+    (*readHandler)(handlerArg);
+}
+
+int
+Console::ReadInput(char *buffer, unsigned size)
+{
+    ASSERT(buffer != nullptr);
+    ASSERT(size > 0);
+
+    unsigned length;
+    if (inputLog != nullptr && inputLog->IsReplaying()) {
+        return inputLog->Replay(INPUT_CONSOLE, buffer, size, &length)
+               ? (int) length : -1;
+    }
+
+    int n;
+    if (consoleScript != nullptr && consoleScript->IsAttached(this)) {
+        n = consoleScript->Type(buffer, cooked ? size : 1);
+        if (n < 0 || (n == 0 && !cooked)) {
+            return -1;
+        }
+    } else if (!SystemDep::PollFile(readFileNo)) {
+        return -1;
+    } else if (cooked) {
+        n = SystemDep::ReadPartial(readFileNo, buffer, size);
+        if (n < 0) {
+            n = 0;
+        }
+    } else {
+        SystemDep::Read(readFileNo, buffer, 1);
+        n = 1;
+    }
+    if (inputLog != nullptr) {
+        inputLog->Record(INPUT_CONSOLE, buffer, n);
+    }
+    return n;
+}
+
 /// Internal routine called when it is time to invoke the interrupt handler
 /// to tell the Nachos kernel that the output character has completed.
+///
+/// If the handler puts no other character, the display is idle, and what
+/// is buffered is written.
 void
 Console::WriteDone()
 {
     putBusy = false;
-    stats->numConsoleCharsWritten++;
+    stats->numConsoleCharsWritten += putCount;
+    stats->numConsoleWriteInterrupts++;
     (*writeHandler)(handlerArg);
+    if (!putBusy) {
+        Flush();
+    }
+}
+
+void
+Console::Flush()
+{
+    if (outCount > 0) {
+        SystemDep::WriteFile(writeFileNo, outBuffer, outCount);
+        outCount = 0;
+    }
 }
 
 /// Read a character from the input buffer, if there is any there.
@@ -133,20 +242,53 @@ Console::WriteDone()
 char
 Console::GetChar()
 {
+    if (cooked) {
+        if (lineLeft == 0) {
+            return EOF;
+        }
+        lineLeft--;
+        inCount--;
+        return inBuffer[inStart++];
+    }
+
     char ch = incoming;
 
     incoming = EOF;
     return ch;
 }
 
+bool
+Console::IsCooked() const
+{
+    return cooked;
+}
+
 /// Write a character to the simulated display, schedule an interrupt to
 /// occur in the future, and return.
 void
 Console::PutChar(char ch)
 {
+    PutChars(&ch, 1);
+}
+
+void
+Console::PutChars(const char *chars, unsigned count)
+{
+    ASSERT(chars != nullptr);
+    ASSERT(count > 0 && count <= BUFFER_SIZE);
     ASSERT(!putBusy);
-    SystemDep::WriteFile(writeFileNo, &ch, sizeof (char));
-    putBusy = true;
+
+    if (consoleScript != nullptr && consoleScript->IsAttached(this)) {
+        consoleScript->Output(chars, count);
+    }
+    for (unsigned i = 0; i < count; i++) {
+        outBuffer[outCount++] = chars[i];
+        if (chars[i] == '\n' || outCount == BUFFER_SIZE) {
+            Flush();
+        }
+    }
+    putBusy  = true;
+    putCount = count;
     interrupt->Schedule(ConsoleWriteDone, this,
-                        CONSOLE_TIME, CONSOLE_WRITE_INT);
+                        count * CONSOLE_TIME, CONSOLE_WRITE_INT);
 }
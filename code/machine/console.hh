@@ -36,13 +36,28 @@
 /// called when a character has arrived, ready to be read in.  The interrupt
 /// handler `writeDone` is called when an output character has been “put”, so
 /// that the next character can be written.
+///
+/// Characters put are kept in a buffer on the host, and written to the UNIX
+/// file in one go at a newline, when the buffer fills up, or once the
+/// display goes idle: when the write interrupt of a character is handled
+/// without another being put.
+///
+/// A `cooked` console reads its input a line at a time, as a terminal in
+/// canonical mode does: the host input is read in chunks, and `readAvail` is
+/// called once per line, which `GetChar` then returns by characters,
+/// newline included, before returning EOF.  At the end of the host input,
+/// what is left is handed as a last line, and `readAvail` is called once
+/// more with nothing to get.
 class Console {
 public:
 
+    /// Characters buffered on the host, for input and output each.
+    static const unsigned BUFFER_SIZE = 256;
+
     /// Initialize the hardware console device.
     Console(const char *readFile, const char *writeFile,
             VoidFunctionPtr readAvail, VoidFunctionPtr writeDone,
-            void *callArg);
+            void *callArg, bool cooked = false);
 
     /// Clean up console emulation.
     ~Console();
@@ -53,11 +68,19 @@ public:
     /// `writeHandler` is called when the I/O completes.
     void PutChar(char ch);
 
+    /// Like `PutChar`, for the `count` characters at `chars`, up to
+    /// `BUFFER_SIZE`: they take as long as so many `PutChar`, but
+    /// `writeHandler` is called once, when the last is out.
+    void PutChars(const char *chars, unsigned count);
+
     /// Poll the console input.  If a char is available, return it.
     /// Otherwise, return EOF.  `readHandler` is called whenever there is a
-    /// char to be gotten.
+    /// char to be gotten, or a line if cooked.
     char GetChar();
 
+    /// Whether the input is read a line at a time.
+    bool IsCooked() const;
+
     // Internal emulation routines -- DO NOT call these.
     // Internal routines to signal I/O completion.
 
@@ -74,8 +97,39 @@ public:
     void *handlerArg;  ///< argument to be passed to the interrupt handlers.
     bool putBusy;  ///< Is a `PutChar` operation in progress?  If so, you
                    ///< cannot do another one!
+    unsigned putCount;  ///< Characters of the operation in progress.
     char incoming;  ///< Contains the character to be read, if there is one
                     ///< available.  Otherwise contains EOF.
+
+    /// Write the characters put so far to the UNIX file.
+    void Flush();
+
+    /// Read what the host has of the input into `inBuffer`, and hand a line
+    /// if there is one.
+    void CheckLineAvail();
+
+    /// Read input into `buffer`, of `size` bytes: a character, or what the
+    /// host has if cooked.  Return how many were read, 0 at the end of the
+    /// input, or -1 if there is none yet.  The input is typed by the console
+    /// script, if there is one, rather than read from the host; it is
+    /// recorded, or taken from the replayed log, if there is an input log.
+    int ReadInput(char *buffer, unsigned size);
+
+    /// Characters put and not yet written to the UNIX file.
+    char outBuffer[BUFFER_SIZE];
+    unsigned outCount;
+
+    bool cooked;
+    /// Input read from the host: `inCount` characters from `inStart` on,
+    /// the first `lineLeft` of which are the line handed and not yet
+    /// gotten.  Whether the host input ended, and whether the kernel was
+    /// told.
+    char inBuffer[BUFFER_SIZE];
+    unsigned inStart;
+    unsigned inCount;
+    unsigned lineLeft;
+    bool inputEnded;
+    bool endHanded;
 };
 
 
@@ -18,6 +18,7 @@
 #include "threads/system.hh"
 
 #include <stdio.h>
+#include <string.h>
 
 
 /// We put this at the front of the UNIX file representing the
@@ -26,7 +27,32 @@
 static const unsigned MAGIC_NUMBER = 0x456789AB;
 static const unsigned MAGIC_SIZE = sizeof (int);
 
-static const unsigned DISK_SIZE = MAGIC_SIZE + NUM_SECTORS * SECTOR_SIZE;
+unsigned diskSectors = DEFAULT_NUM_TRACKS * SECTORS_PER_TRACK;
+
+/// Bytes of the UNIX file, magic number included.
+static unsigned
+DiskSize()
+{
+    return MAGIC_SIZE + diskSectors * SECTOR_SIZE;
+}
+
+static const char *TIMING_NAMES[] = { "accurate", "fixed", "immediate" };
+
+bool
+ParseDiskTiming(const char *name, DiskTiming *timing)
+{
+    ASSERT(name != nullptr);
+    ASSERT(timing != nullptr);
+
+    for (unsigned i = 0; i < sizeof TIMING_NAMES / sizeof *TIMING_NAMES;
+         i++) {
+        if (strcmp(name, TIMING_NAMES[i]) == 0) {
+            *timing = (DiskTiming) i;
+            return true;
+        }
+    }
+    return false;
+}
 
 /// dummy procedure because we cannot take a pointer of a member function
 static void
@@ -40,13 +66,16 @@ DiskDone(void *arg)
 /// does not exist), and check the magic number to make sure it is ok to
 /// treat it as Nachos disk storage.
 //
-/// * `name` is the text name of the file simulating the Nachos disk.
+/// * `name` is the text name of the file simulating the Nachos disk, or
+///   null for a RAM disk.
 /// * `callWhenDone` is an interrupt handler to be called when disk
 ///   read/write request completes.
 /// * `callArg` is an argument to pass the interrupt handler.
-Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg)
+/// * `mapped` is whether to map the UNIX file into memory.
+/// * `timing_` is how long requests take.
+Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg,
+           bool mapped, DiskTiming timing_)
 {
-    ASSERT(name != nullptr);
     ASSERT(callWhenDone != nullptr);
 
     int magicNum;
@@ -57,6 +86,19 @@ Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg)
     handlerArg = callArg;
     lastSector = 0;
     bufferInit = 0;
+    timing     = timing_;
+    active     = false;
+    batching   = false;
+    batchTicks = 0;
+
+    if (name == nullptr) {
+        // Room is left for the magic number, so that sectors lie where
+        // they would in a mapped file.
+        fileno = -1;
+        image  = new char [DiskSize()];
+        memset(image, 0, DiskSize());
+        return;
+    }
 
     fileno = SystemDep::OpenForReadWrite(name, false);
     if (fileno >= 0) {  // File exists, check magic number.
@@ -67,20 +109,40 @@ Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg)
         magicNum = MAGIC_NUMBER;
         SystemDep::WriteFile(fileno, (char *) &magicNum, MAGIC_SIZE);
           // Write magic number.
+    }
 
-        // Need to write at end of file, so that reads will not return EOF.
-        SystemDep::Lseek(fileno, DISK_SIZE - sizeof (int), 0);
+    // Need to write at end of file, so that reads will not return EOF.  A
+    // file made for a smaller disk grows the same way.
+    SystemDep::Lseek(fileno, 0, 2);
+    if ((unsigned) SystemDep::Tell(fileno) < DiskSize()) {
+        SystemDep::Lseek(fileno, DiskSize() - sizeof (int), 0);
         SystemDep::WriteFile(fileno, (char *) &tmp, sizeof (int));
     }
-    active = false;
+    image = mapped ? SystemDep::MapFile(fileno, DiskSize()) : nullptr;
 }
 
 /// Clean up disk simulation, by closing the UNIX file representing the disk.
 Disk::~Disk()
 {
+    if (fileno == -1) {
+        delete [] image;
+        return;
+    }
+    if (image != nullptr) {
+        SystemDep::SyncMapping(image, DiskSize());
+        SystemDep::UnmapFile(image, DiskSize());
+    }
     SystemDep::Close(fileno);
 }
 
+void
+Disk::Flush()
+{
+    if (image != nullptr && fileno != -1) {
+        SystemDep::SyncMapping(image, DiskSize());
+    }
+}
+
 /// Dump the data in a disk read/write request, for debugging.
 static void
 PrintSector(bool writing, unsigned sector, const char *data)
@@ -102,62 +164,183 @@ PrintSector(bool writing, unsigned sector, const char *data)
 
 /// Disk::ReadRequest/WriteRequest
 ///
-/// Simulate a request to read/write a single disk sector.
+/// Simulate a request to read/write consecutive disk sectors.
 ///
 /// Do the read/write immediately to the UNIX file.  Set up an interrupt
 /// handler to be called later, that will notify the caller when the
 /// simulator says the operation has completed.
 ///
-/// Note that a disk only allows an entire sector to be read/written, not
+/// Note that a disk only allows entire sectors to be read/written, not
 /// part of a sector.
 ///
-/// * `sectorNumber` is the disk sector to read/write.
+/// * `sectorNumber` is the first disk sector to read/write.
 /// * `data` are the bytes to be written, the buffer to hold the incoming
-///   bytes.
+///   bytes; `count * SECTOR_SIZE` of them.
+/// * `count` is the number of sectors.
 void
-Disk::ReadRequest(unsigned sectorNumber, char *data)
+Disk::ReadRequest(unsigned sectorNumber, char *data, unsigned count)
 {
     ASSERT(data != nullptr);
 
-    int ticks = ComputeLatency(sectorNumber, false);
+    int ticks = ComputeLatency(sectorNumber, false, count);
 
-    ASSERT(!active);  // only one request at a time
-    ASSERT(sectorNumber >= 0 && sectorNumber < NUM_SECTORS);
+    ASSERT(!active || batching);  // only one request at a time
+    ASSERT(count > 0 && sectorNumber + count <= diskSectors);
 
-    DEBUG('d', "Reading from sector %u\n", sectorNumber);
-    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
-    SystemDep::Read(fileno, data, SECTOR_SIZE);
+    DEBUG('d', "Reading %u sectors from sector %u\n", count, sectorNumber);
+    if (image != nullptr) {
+        memcpy(data, &image[SECTOR_SIZE * sectorNumber + MAGIC_SIZE],
+               count * SECTOR_SIZE);
+    } else {
+        SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+        SystemDep::Read(fileno, data, count * SECTOR_SIZE);
+    }
     if (debug.IsEnabled('d')) {
-        PrintSector(false, sectorNumber, data);
+        for (unsigned i = 0; i < count; i++) {
+            PrintSector(false, sectorNumber + i, &data[i * SECTOR_SIZE]);
+        }
     }
 
-    active = true;
-    UpdateLast(sectorNumber);
+    UpdateLast(sectorNumber, count);
     stats->numDiskReads++;
-    interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
+    Begin(ticks);
 }
 
 void
-Disk::WriteRequest(unsigned sectorNumber, const char *data)
+Disk::WriteRequest(unsigned sectorNumber, const char *data, unsigned count)
 {
     ASSERT(data != nullptr);
 
-    int ticks = ComputeLatency(sectorNumber, true);
+    int ticks = ComputeLatency(sectorNumber, true, count);
 
-    ASSERT(!active);
-    ASSERT(sectorNumber >= 0 && sectorNumber < NUM_SECTORS);
+    ASSERT(!active || batching);
+    ASSERT(count > 0 && sectorNumber + count <= diskSectors);
 
-    DEBUG('d', "Writing to sector %u\n", sectorNumber);
-    SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
-    SystemDep::WriteFile(fileno, data, SECTOR_SIZE);
+    DEBUG('d', "Writing %u sectors to sector %u\n", count, sectorNumber);
+    if (image != nullptr) {
+        memcpy(&image[SECTOR_SIZE * sectorNumber + MAGIC_SIZE], data,
+               count * SECTOR_SIZE);
+    } else {
+        SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+        SystemDep::WriteFile(fileno, data, count * SECTOR_SIZE);
+    }
     if (debug.IsEnabled('d')) {
-        PrintSector(true, sectorNumber, data);
+        for (unsigned i = 0; i < count; i++) {
+            PrintSector(true, sectorNumber + i, &data[i * SECTOR_SIZE]);
+        }
     }
 
-    active = true;
-    UpdateLast(sectorNumber);
+    UpdateLast(sectorNumber, count);
     stats->numDiskWrites++;
-    interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
+    Begin(ticks);
+}
+
+/// The sectors are moved one at a time, after a single seek of the UNIX
+/// file.
+void
+Disk::ReadScatter(unsigned sectorNumber, char *const *buffers, unsigned count)
+{
+    ASSERT(buffers != nullptr);
+
+    int ticks = ComputeLatency(sectorNumber, false, count);
+
+    ASSERT(!active || batching);
+    ASSERT(count > 0 && sectorNumber + count <= diskSectors);
+
+    DEBUG('d', "Reading %u scattered sectors from sector %u\n",
+          count, sectorNumber);
+    if (image == nullptr) {
+        SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+    }
+    for (unsigned i = 0; i < count; i++) {
+        ASSERT(buffers[i] != nullptr);
+        if (image != nullptr) {
+            memcpy(buffers[i],
+                   &image[SECTOR_SIZE * (sectorNumber + i) + MAGIC_SIZE],
+                   SECTOR_SIZE);
+        } else {
+            SystemDep::Read(fileno, buffers[i], SECTOR_SIZE);
+        }
+        if (debug.IsEnabled('d')) {
+            PrintSector(false, sectorNumber + i, buffers[i]);
+        }
+    }
+
+    UpdateLast(sectorNumber, count);
+    stats->numDiskReads++;
+    Begin(ticks);
+}
+
+void
+Disk::WriteGather(unsigned sectorNumber, const char *const *buffers,
+                  unsigned count)
+{
+    ASSERT(buffers != nullptr);
+
+    int ticks = ComputeLatency(sectorNumber, true, count);
+
+    ASSERT(!active || batching);
+    ASSERT(count > 0 && sectorNumber + count <= diskSectors);
+
+    DEBUG('d', "Writing %u gathered sectors to sector %u\n",
+          count, sectorNumber);
+    if (image == nullptr) {
+        SystemDep::Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+    }
+    for (unsigned i = 0; i < count; i++) {
+        ASSERT(buffers[i] != nullptr);
+        if (image != nullptr) {
+            memcpy(&image[SECTOR_SIZE * (sectorNumber + i) + MAGIC_SIZE],
+                   buffers[i], SECTOR_SIZE);
+        } else {
+            SystemDep::WriteFile(fileno, buffers[i], SECTOR_SIZE);
+        }
+        if (debug.IsEnabled('d')) {
+            PrintSector(true, sectorNumber + i, buffers[i]);
+        }
+    }
+
+    UpdateLast(sectorNumber, count);
+    stats->numDiskWrites++;
+    Begin(ticks);
+}
+
+void
+Disk::StartBatch()
+{
+    ASSERT(!active && !batching);
+
+    batching   = true;
+    batchTicks = 0;
+}
+
+/// A batch with no requests does not interrupt.
+void
+Disk::EndBatch()
+{
+    ASSERT(batching);
+
+    batching = false;
+    if (active) {
+        interrupt->Schedule(DiskDone, this, batchTicks, DISK_INT);
+    }
+}
+
+void
+Disk::Begin(int ticks)
+{
+    active = true;
+    if (batching) {
+        batchTicks += ticks;
+    } else {
+        interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
+    }
+}
+
+unsigned
+Disk::StartTime() const
+{
+    return stats->totalTicks + (batching ? batchTicks : 0);
 }
 
 /// Called when it is time to invoke the disk interrupt handler, to tell the
@@ -166,6 +349,7 @@ void
 Disk::HandleInterrupt()
 {
     active = false;
+    stats->numDiskInterrupts++;
     (*handler)(handlerArg);
 }
 
@@ -191,7 +375,7 @@ Disk::TimeToSeek(unsigned newSector, unsigned *rotation)
     unsigned oldTrack = lastSector / SECTORS_PER_TRACK;
     unsigned seek = Diff(newTrack, oldTrack) * SEEK_TIME;
       // How long will seek take?
-    unsigned over = (stats->totalTicks + seek) % ROTATION_TIME;
+    unsigned over = (StartTime() + seek) % ROTATION_TIME;
       // Will we be in the middle of a sector when we finish the seek?
 
     *rotation = 0;
@@ -212,11 +396,15 @@ Disk::ModuloDiff(unsigned to, unsigned from)
     return (toOffset - fromOffset + SECTORS_PER_TRACK) % SECTORS_PER_TRACK;
 }
 
-/// Return how long will it take to read/write a disk sector, from
-/// the current position of the disk head.
+/// Return how long will it take to read/write `count` consecutive disk
+/// sectors, from the current position of the disk head.
 ///
 ///     Latency = seek time + rotational latency + transfer time
 ///
+/// Seeking and rotating to the first sector is paid once; then the rest
+/// pass under the head one after the other, with a seek to the next track
+/// whenever the end of one is reached.
+///
 /// Disk seeks at one track per `SEEK_TIME` ticks (cf. `stats.hh`) and
 /// rotates at one sector per `ROTATION_TIME` ticks.
 ///
@@ -228,12 +416,32 @@ Disk::ModuloDiff(unsigned to, unsigned from)
 /// contents of the current disk track into the buffer.  This allows read
 /// requests to the current track to be satisfied more quickly.  The contents
 /// of the track buffer are discarded after every seek to a new track.
+///
+/// As it is called once for every request, it also accounts for it in
+/// `stats`.
 int
-Disk::ComputeLatency(unsigned newSector, bool writing)
+Disk::ComputeLatency(unsigned newSector, bool writing, unsigned count)
 {
+    ASSERT(count > 0);
+
+    unsigned tracks = Diff(newSector / SECTORS_PER_TRACK,
+                           lastSector / SECTORS_PER_TRACK);
+    if (timing == DISK_IMMEDIATE) {
+        stats->RecordDiskRequest(count, 1, tracks, 0, false);
+        return 1;  // An interrupt cannot come any sooner.
+    } else if (timing == DISK_FIXED) {
+        stats->RecordDiskRequest(count, count * DISK_FIXED_TIME, tracks, 0,
+                                 false);
+        return count * DISK_FIXED_TIME;
+    }
+
     unsigned rotation;
     unsigned seek      = TimeToSeek(newSector, &rotation);
-    unsigned timeAfter = stats->totalTicks + seek + rotation;
+    unsigned timeAfter = StartTime() + seek + rotation;
+    unsigned endSector = newSector + count - 1;
+    unsigned transfer  = count * ROTATION_TIME
+                         + (endSector / SECTORS_PER_TRACK
+                            - newSector / SECTORS_PER_TRACK) * SEEK_TIME;
 
 #ifndef NOTRACKBUF  // Turn this on if you do not want the track buffer
                     // stuff.
@@ -241,30 +449,41 @@ Disk::ComputeLatency(unsigned newSector, bool writing)
     if (!writing && seek == 0
         && (timeAfter - bufferInit) / ROTATION_TIME
            > ModuloDiff(newSector, bufferInit / ROTATION_TIME)) {
-        DEBUG('d', "Request latency = %u\n", ROTATION_TIME);
-        return ROTATION_TIME;
-          // Time to transfer sector from the track buffer.
+        DEBUG('d', "Request latency = %u\n", transfer);
+        stats->RecordDiskRequest(count, transfer, tracks, 0, true);
+        return transfer;
+          // Time to transfer sectors from the track buffer.
     }
 #endif
 
     rotation += ModuloDiff(newSector, timeAfter / ROTATION_TIME)
                 * ROTATION_TIME;
 
-    DEBUG('d', "Request latency = %u\n", seek + rotation + ROTATION_TIME);
-    return seek + rotation + ROTATION_TIME;
+    DEBUG('d', "Request latency = %u\n", seek + rotation + transfer);
+    stats->RecordDiskRequest(count, seek + rotation + transfer, tracks,
+                             rotation, false);
+    return seek + rotation + transfer;
 }
 
 /// Keep track of the most recently requested sector.  So we can know what is
-/// in the track buffer.
+/// in the track buffer.  A request ending on another track than it started
+/// leaves that one in the buffer.
 void
-Disk::UpdateLast(unsigned newSector)
+Disk::UpdateLast(unsigned newSector, unsigned count)
 {
     unsigned rotate;
     unsigned seek = TimeToSeek(newSector, &rotate);
+    unsigned endSector = newSector + count - 1;
 
     if (seek != 0) {
-        bufferInit = stats->totalTicks + seek + rotate;
+        bufferInit = StartTime() + seek + rotate;
+    }
+    if (endSector / SECTORS_PER_TRACK != newSector / SECTORS_PER_TRACK) {
+        bufferInit = StartTime() + seek + rotate
+                     + (endSector / SECTORS_PER_TRACK
+                        - newSector / SECTORS_PER_TRACK) * SEEK_TIME
+                     + (count - 1) * ROTATION_TIME;
     }
-    lastSector = newSector;
+    lastSector = endSector;
     DEBUG('d', "Updating last sector = %u, %u\n", lastSector, bufferInit);
 }
@@ -36,7 +36,11 @@
 /// immediately, and an interrupt is invoked later to signal that the
 /// operation completed.
 ///
-/// The physical disk is in fact simulated via operations on a UNIX file.
+/// The physical disk is in fact simulated via operations on a UNIX file;
+/// or, if `mapped`, by copying to and from the whole file mapped into
+/// memory, which takes no system calls.  A RAM disk has no file at all: its
+/// sectors are only kept in memory, blank when Nachos starts and lost when
+/// it halts, for file systems that need not outlive a run.
 ///
 /// To make life a little more realistic, the simulated time for each
 /// operation reflects a “track buffer” -- RAM to store the contents of the
@@ -54,40 +58,95 @@
 const unsigned SECTOR_SIZE = 128;       ///< Number of bytes per disk sector.
 const unsigned SECTORS_PER_TRACK = 32;  ///< Number of sectors per disk
                                         ///< track.
-const unsigned NUM_TRACKS = 32;         ///< Number of tracks per disk.
-const unsigned NUM_SECTORS = SECTORS_PER_TRACK * NUM_TRACKS;
-  ///< Total # of sectors per disk.
+const unsigned DEFAULT_NUM_TRACKS = 32;  ///< Number of tracks per disk,
+                                         ///< unless chosen otherwise.
+
+/// Total # of sectors per disk, a whole number of tracks.  It can be chosen
+/// when Nachos starts, before the disk is made; a disk formatted with
+/// another size has to be formatted again.
+extern unsigned diskSectors;
+
+/// How long requests take.  Whichever, a request ends with an interrupt.
+enum DiskTiming {
+    DISK_ACCURATE,  ///< Seek, rotation and transfer, as a disk would.
+    DISK_FIXED,     ///< `DISK_FIXED_TIME` per sector, wherever it is.
+    DISK_IMMEDIATE  ///< Done at the next tick.
+};
+
+/// Ticks per sector with `DISK_FIXED`: as long as an average rotational
+/// delay and the transfer.
+const unsigned DISK_FIXED_TIME = 1000;
+
+/// Set `*timing` to the model called `name`; return false if there is none.
+bool ParseDiskTiming(const char *name, DiskTiming *timing);
 
 class Disk {
 public:
     /// Create a simulated disk.
     ///
     /// Invoke `(*callWhenDone)(callArg)` every time a request completes.
-    Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg);
+    /// If `mapped`, map the UNIX file into memory.  A null `name` makes a
+    /// RAM disk, for which `mapped` does not matter.  Requests take as long
+    /// as `timing` says.
+    Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg,
+         bool mapped = false, DiskTiming timing = DISK_ACCURATE);
     ~Disk();  // Deallocate the disk.
 
-    /// Read/write an single disk sector.
+    /// Read/write `count` consecutive disk sectors, from `sectorNumber` on.
     ///
     /// These routines send a request to the disk and return immediately.
     /// Only one request allowed at a time!
 
-    void ReadRequest(unsigned sectorNumber, char *data);
-    void WriteRequest(unsigned sectorNumber, const char *data);
+    void ReadRequest(unsigned sectorNumber, char *data, unsigned count = 1);
+    void WriteRequest(unsigned sectorNumber, const char *data,
+                      unsigned count = 1);
+
+    /// Like `ReadRequest`/`WriteRequest`, but sector `i` of the request is
+    /// moved straight to or from `buffers[i]`, so that the sectors of one
+    /// request can go to buffers all over memory, such as frames of main
+    /// memory or entries of a cache, as a disk controller doing DMA with a
+    /// list of segments would.  The list is only looked at here.
+    void ReadScatter(unsigned sectorNumber, char *const *buffers,
+                     unsigned count);
+    void WriteGather(unsigned sectorNumber, const char *const *buffers,
+                     unsigned count);
+
+    /// Take the requests made from now on to `EndBatch` as a batch: the
+    /// disk serves them one after the other, each from where the one before
+    /// left the head, and interrupts once, when the last is done, rather
+    /// than once for each.  Only one batch is allowed at a time, and no
+    /// request may be in progress when it starts.
+    void StartBatch();
+    void EndBatch();
 
     /// Interrupt handler, invoked when disk request finishes.
     void HandleInterrupt();
 
-    /// Return how long a request to newSector will take.
+    /// Make sure what was written is in the UNIX file, rather than only in
+    /// its mapping.  Nothing to do unless `mapped`.
+    void Flush();
+
+    /// Return how long a request for `count` sectors from `newSector` on
+    /// will take.
     ///
     ///     (seek + rotational delay + transfer)
-    int ComputeLatency(unsigned newSector, bool writing);
+    ///
+    /// unless the timing model is not `DISK_ACCURATE`.  The request is
+    /// accounted for in `stats`.
+    int ComputeLatency(unsigned newSector, bool writing, unsigned count = 1);
 
 private:
-    int fileno;  ///< UNIX file number for simulated disk.
+    int fileno;  ///< UNIX file number for simulated disk, or -1 for a RAM
+                 ///< disk.
+    char *image;  ///< The UNIX file mapped into memory, the sectors of a
+                  ///< RAM disk, or null.
     VoidFunctionPtr handler;  ///< Interrupt handler, to be invoked when any
                               ///< disk request finishes.
     void *handlerArg;  ///< Argument to interrupt handler.
     bool active;  ///< Is a disk operation in progress?
+    bool batching;  ///< Are requests being taken as a batch?
+    unsigned batchTicks;  ///< How long the requests of the batch take.
+    DiskTiming timing;
     unsigned lastSector;  ///< The previous disk request.
     int bufferInit;  ///< When the track buffer started being loaded.
                      // being loaded
@@ -98,7 +157,15 @@ private:
     /// Number of sectors between `to` and `from`.
     unsigned ModuloDiff(unsigned to, unsigned from);
 
-    void UpdateLast(unsigned newSector);
+    void UpdateLast(unsigned newSector, unsigned count);
+
+    /// When the request being made starts: now, or once the requests of
+    /// the batch before it are done.
+    unsigned StartTime() const;
+
+    /// Mark a request taking `ticks` as in progress, and have it interrupt
+    /// when done, unless it is part of a batch.
+    void Begin(int ticks);
 };
 
 
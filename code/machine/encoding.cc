@@ -11,7 +11,7 @@
 #include "encoding.hh"
 
 
-const OpInfo OP_TABLE[] = {
+constexpr OpInfo OP_TABLE[] = {
     { SPECIAL,  RFMT }, { BCOND,    IFMT },
     { OP_J,     JFMT }, { OP_JAL,   JFMT },
     { OP_BEQ,   IFMT }, { OP_BNE,   IFMT },
@@ -46,7 +46,7 @@ const OpInfo OP_TABLE[] = {
     { OP_RES,   IFMT }, { OP_RES,   IFMT }
 };
 
-const int SPECIAL_TABLE[] = {
+constexpr int SPECIAL_TABLE[] = {
     OP_SLL,     OP_RES,   OP_SRL,  OP_SRA,
     OP_SLLV,    OP_RES,   OP_SRLV, OP_SRAV,
     OP_JR,      OP_JALR,  OP_RES,  OP_RES,
@@ -65,6 +65,56 @@ const int SPECIAL_TABLE[] = {
     OP_RES,     OP_RES,   OP_RES,  OP_RES
 };
 
+/// Where the `extra` field of an instruction of `format` is, for
+/// `DECODE_TABLE`.
+static constexpr DecodeInfo
+FormatInfo(int opCode, int format)
+{
+    return format == IFMT ? DecodeInfo { (unsigned char) opCode, 0,
+                                         0xFFFF, 0x8000 }
+         : format == RFMT ? DecodeInfo { (unsigned char) opCode, 6,
+                                         0x1F, 0 }
+         :                  DecodeInfo { (unsigned char) opCode, 0,
+                                         0x3FFFFFF, 0 };
+}
+
+/// The operation of a BCOND instruction whose `rt` field is `rt`.
+static constexpr int
+BcondOpCode(unsigned rt)
+{
+    return rt == 0  ? OP_BLTZ
+         : rt == 1  ? OP_BGEZ
+         : rt == 16 ? OP_BLTZAL
+         : rt == 17 ? OP_BGEZAL
+         :            OP_UNIMP;
+}
+
+static constexpr DecodeInfo
+DecodeEntry(unsigned i)
+{
+    return i < DECODE_SPECIAL
+             ? FormatInfo(OP_TABLE[i].opCode, OP_TABLE[i].format)
+         : i < DECODE_BCOND
+             ? FormatInfo(SPECIAL_TABLE[i - DECODE_SPECIAL], RFMT)
+         : FormatInfo(BcondOpCode(i - DECODE_BCOND), IFMT);
+}
+
+#define DECODE_ROW(i)                                                      \
+    DecodeEntry(i),      DecodeEntry(i + 1),  DecodeEntry(i + 2),          \
+    DecodeEntry(i + 3),  DecodeEntry(i + 4),  DecodeEntry(i + 5),          \
+    DecodeEntry(i + 6),  DecodeEntry(i + 7),  DecodeEntry(i + 8),          \
+    DecodeEntry(i + 9),  DecodeEntry(i + 10), DecodeEntry(i + 11),         \
+    DecodeEntry(i + 12), DecodeEntry(i + 13), DecodeEntry(i + 14),         \
+    DecodeEntry(i + 15)
+
+constexpr DecodeInfo DECODE_TABLE[DECODE_TABLE_SIZE] = {
+    DECODE_ROW(0),   DECODE_ROW(16),  DECODE_ROW(32),  DECODE_ROW(48),
+    DECODE_ROW(64),  DECODE_ROW(80),  DECODE_ROW(96),  DECODE_ROW(112),
+    DECODE_ROW(128), DECODE_ROW(144)
+};
+
+#undef DECODE_ROW
+
 const struct OpString OP_STRINGS[] = {
     { "Should not happen", { NONE,  NONE,  NONE  }},
     { "ADD r%d,r%d,r%d",   { RD,    RS,    RT    }},
@@ -128,6 +128,42 @@ extern const OpInfo OP_TABLE[];
 /// into the `opCode` field of a `MemWord`.
 extern const int SPECIAL_TABLE[];
 
+/// The two tables above, and the `rt` field of BCOND instructions, folded
+/// into one, so that decoding an instruction takes a single lookup and no
+/// branches.  Entries are:
+///
+/// * from 0, for bits 31:26, except for SPECIAL and BCOND;
+/// * from `DECODE_SPECIAL`, for the `funct` field of SPECIAL instructions;
+/// * from `DECODE_BCOND`, for the `rt` field of BCOND instructions.
+///
+/// Each tells the operation and where its `extra` field is: the bits
+/// `mask` from bit `shift` on, sign-extended from bit `sign` if not 0.
+/// The table is computed at compile time from the two above.
+
+enum {
+    DECODE_SPECIAL    = 64,
+    DECODE_BCOND      = 128,
+    DECODE_TABLE_SIZE = 160
+};
+
+struct DecodeInfo {
+    unsigned char opCode;
+    unsigned char shift;
+    unsigned mask;
+    unsigned sign;
+};
+
+extern const DecodeInfo DECODE_TABLE[];
+
+/// Return the entry of `DECODE_TABLE` for the instruction `value`.
+inline unsigned
+DecodeIndex(unsigned value)
+{
+    unsigned op = value >> 26;
+    return op + (op == 0) * (DECODE_SPECIAL + (value & 0x3F))
+              + (op == 1) * (DECODE_BCOND - 1 + (value >> 16 & 0x1F));
+}
+
 
 /// Stuff to help print out each instruction, for debugging.
 
@@ -9,6 +9,13 @@
 /// Simulated machine byte ordering
 ///     Main memory.
 ///
+/// The byte order of the host is chosen when building, with
+/// `HOST_IS_BIG_ENDIAN` (see `Makefile.env`), so the routines are inline:
+/// on a little-endian host, main memory is thus kept in host byte order,
+/// and every load and store of `MMU::ReadMem` and `MMU::WriteMem`, and the
+/// conversions of the loader and of the buffers shared with user programs,
+/// compile to plain accesses, and loops converting whole tables to nothing.
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -18,10 +25,37 @@
 #define NACHOS_MACHINE_ENDIANNESS__HH
 
 
-unsigned WordToHost(unsigned word);
-unsigned short ShortToHost(unsigned short shortword);
-unsigned WordToMachine(unsigned word);
-unsigned short ShortToMachine(unsigned short shortword);
+inline unsigned
+WordToHost(unsigned word)
+{
+#ifdef HOST_IS_BIG_ENDIAN
+    return __builtin_bswap32(word);
+#else
+    return word;
+#endif
+}
+
+inline unsigned short
+ShortToHost(unsigned short shortword)
+{
+#ifdef HOST_IS_BIG_ENDIAN
+    return __builtin_bswap16(shortword);
+#else
+    return shortword;
+#endif
+}
+
+inline unsigned
+WordToMachine(unsigned word)
+{
+    return WordToHost(word);
+}
+
+inline unsigned short
+ShortToMachine(unsigned short shortword)
+{
+    return ShortToHost(shortword);
+}
 
 
 #endif
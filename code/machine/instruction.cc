@@ -12,38 +12,21 @@
 
 
 /// Decode a MIPS instruction.
+///
+/// The operation, and where the `extra` field is, come from a single entry
+/// of `DECODE_TABLE`; the sign of immediates is extended without testing
+/// it.
 void
 Instruction::Decode()
 {
-    const OpInfo *opPtr;
+    const DecodeInfo &info = DECODE_TABLE[DecodeIndex(value)];
 
     rs = value >> 21 & 0x1F;
     rt = value >> 16 & 0x1F;
     rd = value >> 11 & 0x1F;
-    opPtr  = &OP_TABLE[value >> 26 & 0x3F];
-    opCode = opPtr->opCode;
-    if (opPtr->format == IFMT) {
-        extra = value & 0xFFFF;
-        if (extra & 0x8000) {
-            extra |= 0xFFFF0000;
-        }
-    } else if (opPtr->format == RFMT) {
-        extra = value >> 6 & 0x1F;
-    } else {
-        extra = value & 0x3FFFFFF;
-    }
-
-    if (opCode == SPECIAL) {
-        opCode = SPECIAL_TABLE[value & 0x3F];
-    } else if (opCode == BCOND) {
-        int i = value & 0x1F0000;
-
-        opCode = (i == 0)        ? OP_BLTZ :
-                 (i == 0x10000)  ? OP_BGEZ :
-                 (i == 0x100000) ? OP_BLTZAL :
-                 (i == 0x110000) ? OP_BGEZAL :
-                                   OP_UNIMP;
-    }
+    opCode = info.opCode;
+    unsigned field = value >> info.shift & info.mask;
+    extra = (int) (field ^ info.sign) - (int) info.sign;
 }
 
 int
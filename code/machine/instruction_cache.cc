@@ -0,0 +1,88 @@
+/// Routines to manage the cache of predecoded user instructions.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "instruction_cache.hh"
+#include "lib/utility.hh"
+
+
+InstructionCache::InstructionCache(unsigned numFrames_, unsigned frameSize)
+{
+    ASSERT(frameSize % 4 == 0);
+
+    numFrames     = numFrames_;
+    wordsPerFrame = frameSize / 4;
+    entries       = new Instruction [numFrames * wordsPerFrame];
+    valid         = new bool [numFrames * wordsPerFrame];
+    frameCached   = new bool [numFrames];
+    Flush();
+}
+
+InstructionCache::~InstructionCache()
+{
+    delete [] entries;
+    delete [] valid;
+    delete [] frameCached;
+}
+
+const Instruction *
+InstructionCache::Lookup(unsigned physAddr) const
+{
+    unsigned word = physAddr / 4;
+    ASSERT(word < numFrames * wordsPerFrame);
+
+    return valid[word] ? &entries[word] : nullptr;
+}
+
+void
+InstructionCache::Insert(unsigned physAddr, const Instruction *instr)
+{
+    ASSERT(instr != nullptr);
+
+    unsigned word = physAddr / 4;
+    ASSERT(word < numFrames * wordsPerFrame);
+
+    entries[word] = *instr;
+    valid[word] = true;
+    frameCached[word / wordsPerFrame] = true;
+}
+
+void
+InstructionCache::InvalidateWord(unsigned physAddr)
+{
+    unsigned word = physAddr / 4;
+    ASSERT(word < numFrames * wordsPerFrame);
+
+    if (frameCached[word / wordsPerFrame]) {
+        valid[word] = false;
+    }
+}
+
+void
+InstructionCache::InvalidateFrame(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+
+    if (!frameCached[frame]) {
+        return;
+    }
+    for (unsigned i = 0; i < wordsPerFrame; i++) {
+        valid[frame * wordsPerFrame + i] = false;
+    }
+    frameCached[frame] = false;
+}
+
+void
+InstructionCache::Flush()
+{
+    for (unsigned i = 0; i < numFrames * wordsPerFrame; i++) {
+        valid[i] = false;
+    }
+    for (unsigned i = 0; i < numFrames; i++) {
+        frameCached[i] = false;
+    }
+}
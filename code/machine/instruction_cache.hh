@@ -0,0 +1,69 @@
+/// Data structures for a cache of predecoded user instructions.
+///
+/// Decoding a MIPS instruction is cheap, but it is done once per simulated
+/// cycle, so tight user loops end up decoding the very same words over and
+/// over again.  The instruction cache keeps one decoded `Instruction` per
+/// word of physical memory, so that a fetch that hits the cache only needs
+/// the address translation.
+///
+/// The cache is indexed by physical address, so it remains valid across
+/// context switches.  It must be told whenever the contents of a frame
+/// change behind the simulated CPU's back (for example, when the kernel
+/// loads a page from disk or releases a frame); stores performed by the
+/// simulated CPU itself are tracked by the MMU.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_INSTRUCTIONCACHE__HH
+#define NACHOS_MACHINE_INSTRUCTIONCACHE__HH
+
+
+#include "instruction.hh"
+
+
+class InstructionCache {
+public:
+
+    /// Create an empty cache covering `numFrames` frames of `frameSize`
+    /// bytes each.
+    InstructionCache(unsigned numFrames, unsigned frameSize);
+
+    ~InstructionCache();
+
+    /// Return the decoded instruction stored at physical address
+    /// `physAddr`, or null if it is not cached.
+    const Instruction *Lookup(unsigned physAddr) const;
+
+    /// Store the decoded instruction `instr` found at `physAddr`.
+    void Insert(unsigned physAddr, const Instruction *instr);
+
+    /// Forget the word containing `physAddr`, because it was written to.
+    void InvalidateWord(unsigned physAddr);
+
+    /// Forget every instruction of a physical frame.
+    void InvalidateFrame(unsigned frame);
+
+    /// Forget everything.
+    void Flush();
+
+private:
+
+    unsigned numFrames;
+    unsigned wordsPerFrame;
+
+    /// Decoded instructions, one per word of physical memory.
+    Instruction *entries;
+
+    /// Whether each entry holds a valid decoded instruction.
+    bool *valid;
+
+    /// Whether a frame has any valid entry at all.  Lets stores to frames
+    /// that never held code skip the invalidation.
+    bool *frameCached;
+};
+
+
+#endif
@@ -22,6 +22,7 @@
 
 #include "interrupt.hh"
 #include "threads/system.hh"
+#include "lib/slab.hh"
 
 #include <limits.h>
 #include <stdio.h>
@@ -32,7 +33,7 @@
 static const char *INT_LEVEL_NAMES[] = { "disabled", "enabled" };
 static const char *INT_TYPE_NAMES[]  = {
     "timer", "disk", "console write", "console read",
-    "network send", "network recv"
+    "network send", "network recv", "alarm"
 };
 
 static inline bool
@@ -60,10 +61,34 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
     ASSERT(func != nullptr);
     ASSERT(IsIntType(kind));
 
-    handler = func;
-    arg     = param;
-    when    = time;
-    type    = kind;
+    handler  = func;
+    arg      = param;
+    when     = time;
+    type     = kind;
+    seq      = 0;
+    position = 0;
+}
+
+static Slab pendingSlab("PendingInterrupt", sizeof (PendingInterrupt));
+
+void *
+PendingInterrupt::operator new(size_t size)
+{
+    ASSERT(size == sizeof (PendingInterrupt));
+    return pendingSlab.Allocate();
+}
+
+void
+PendingInterrupt::operator delete(void *p, size_t size)
+{
+    pendingSlab.Free(p);
+}
+
+bool
+PendingInterrupt::Before(const PendingInterrupt *a,
+                         const PendingInterrupt *b)
+{
+    return a->when < b->when || (a->when == b->when && a->seq < b->seq);
 }
 
 /// Initialize the simulation of hardware device interrupts.
@@ -72,19 +97,28 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
 Interrupt::Interrupt()
 {
     level         = INT_OFF;
-    pending       = new List<PendingInterrupt *>;
+    nextSeq       = 0;
     inHandler     = false;
     yieldOnReturn = false;
     status        = SYSTEM_MODE;
+    nextDue       = ULONG_MAX;
 }
 
 /// De-allocate the data structures needed by the interrupt simulation.
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-        delete pending->Pop();
+    while (!pending.IsEmpty()) {
+        delete pending.Pop();
     }
-    delete pending;
+}
+
+PendingInterrupt *
+Interrupt::NewPending(VoidFunctionPtr handler, void *arg,
+                      unsigned long when, IntType type)
+{
+    PendingInterrupt *p = new PendingInterrupt(handler, arg, when, type);
+    p->seq = nextSeq++;
+    return p;
 }
 
 /// Change interrupts to be enabled or disabled, without advancing the
@@ -152,12 +186,28 @@ Interrupt::OneTick()
     if (status == SYSTEM_MODE) {
         stats->totalTicks += SYSTEM_TICK;
         stats->systemTicks += SYSTEM_TICK;
+        if (currentThread != nullptr) {
+            currentThread->usage.systemTicks += SYSTEM_TICK;
+        }
     } else {  // USER_PROGRAM
         stats->totalTicks += USER_TICK;
         stats->userTicks += USER_TICK;
+        currentThread->usage.userTicks += USER_TICK;
+#ifdef USER_PROGRAM
+        if (profiler != nullptr) {
+            profiler->Tick();
+        }
+#endif
     }
     DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
 
+    // Fast path: nothing can be due yet, so there is no need to go through
+    // the pending list.  Skipped when tracing, to keep the same output.
+    if (stats->totalTicks < nextDue && !yieldOnReturn
+          && !debug.IsEnabled('i')) {
+        return;
+    }
+
     // Check any pending interrupts are now ready to fire.
     ChangeLevel(INT_ON, INT_OFF);  // First, turn off interrupts (interrupt
                                    // handlers run with interrupts disabled).
@@ -172,6 +222,28 @@ Interrupt::OneTick()
     }
 }
 
+unsigned long
+Interrupt::BatchDeadline() const
+{
+    if (yieldOnReturn || status != USER_MODE || debug.IsEnabled('i')) {
+        return 0;
+    }
+#ifdef USER_PROGRAM
+    if (profiler != nullptr) {
+        return 0;
+    }
+#endif
+    return nextDue;
+}
+
+void
+Interrupt::AdvanceUserTicks(unsigned long ticks)
+{
+    stats->totalTicks += ticks;
+    stats->userTicks  += ticks;
+    currentThread->usage.userTicks += ticks;
+}
+
 /// Called from within an interrupt handler, to cause a context switch (for
 /// example, on a time slice) in the interrupted thread, when the handler
 /// returns.
@@ -224,6 +296,14 @@ Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
     stats->Print();
+    if (lockStats != nullptr) {
+        lockStats->Print();
+    }
+#ifdef USER_PROGRAM
+    if (consoleScript != nullptr) {
+        consoleScript->Print();
+    }
+#endif
     Cleanup();  // Never returns.
 }
 
@@ -237,19 +317,17 @@ Interrupt::Halt()
 void
 Interrupt::RestartTicks()
 {
-    List<PendingInterrupt *> *oldPending = pending;
-    pending = new List<PendingInterrupt *>;
-
-    PendingInterrupt *i;
-    unsigned          oldWhen = 0;
-    while ((i = oldPending->SortedPop((int *) &oldWhen)) != nullptr) {
-        unsigned newWhen = oldWhen - stats->totalTicks;
-        pending->SortedInsert(i, newWhen);
-        DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
-              oldWhen, newWhen);
+    // Every interrupt moves back by the same amount, so the heap order
+    // still holds.
+    for (unsigned i = 0; i < pending.Size(); i++) {
+        PendingInterrupt *p = pending.Get(i);
+        unsigned long oldWhen = p->when;
+        p->when = oldWhen - stats->totalTicks;
+        DEBUG('x', "Interrupt at time %lu re-scheduled at new time %lu.\n",
+              oldWhen, p->when);
     }
 
-    delete oldPending;
+    nextDue = 0;
     stats->totalTicks = 0;
     stats->tickResets += 1;
 }
@@ -287,14 +365,16 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
     ASSERT(ULONG_MAX - stats->totalTicks > fromNow);
 #endif
 
-    unsigned when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg,
-                                                     when, type);
+    unsigned long when = stats->totalTicks + fromNow;
+    PendingInterrupt *toOccur = NewPending(handler, arg, when, type);
 
-    DEBUG('i', "Scheduling interrupt handler the %s at time = %u\n",
+    DEBUG('i', "Scheduling interrupt handler the %s at time = %lu\n",
           INT_TYPE_NAMES[type], when);
 
-    pending->SortedInsert(toOccur, when);
+    pending.Push(toOccur);
+    if (when < nextDue) {
+        nextDue = when;
+    }
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -309,41 +389,54 @@ bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
-    unsigned      when;
 
     ASSERT(level == INT_OFF);  // Interrupts need to be disabled, to invoke
                                // an interrupt handler.
     if (debug.IsEnabled('i')) {
         DumpState();
     }
-    PendingInterrupt *toOccur = pending->SortedPop((int *) &when);
-
-    if (toOccur == nullptr) {  // No pending interrupts.
+    if (pending.IsEmpty()) {  // No pending interrupts.
+        nextDue = ULONG_MAX;
         return false;
     }
 
+    if (advanceClock && pending.Top()->type == TIMER_INT
+          && pending.Size() > 1) {
+        SkipIdleTimer();
+    }
+
+    PendingInterrupt *toOccur = pending.Top();
+    unsigned long when = toOccur->when;
     if (advanceClock && when > stats->totalTicks) {  // Advance the clock.
         stats->idleTicks += (when - stats->totalTicks);
         stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {  // Not time yet, put it back.
-        pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks) {  // Not time yet.
+        nextDue = when;
         return false;
     }
 
     // Check if there is nothing more to do, and if so, quit.
     if (status == IDLE_MODE && toOccur->type == TIMER_INT
-          && pending->IsEmpty()) {
-        pending->SortedInsert(toOccur, when);
+          && pending.Size() == 1) {
+        nextDue = when;
         return false;
     }
 
-    DEBUG('i', "Invoking interrupt handler for the %s at time %u\n",
+    pending.Pop();
+
+    nextDue = 0;  // The handler may schedule more interrupts; find out
+                  // again on the next tick.
+
+    DEBUG('i', "Invoking interrupt handler for the %s at time %lu\n",
             INT_TYPE_NAMES[toOccur->type], toOccur->when);
 #ifdef USER_PROGRAM
     if (machine != nullptr) {
         machine->DelayedLoad(0, 0);
     }
 #endif
+    if (tracer != nullptr) {
+        tracer->RecordInterrupt(INT_TYPE_NAMES[toOccur->type]);
+    }
     inHandler = true;
     status = SYSTEM_MODE;  // Whatever we were doing, we are now going to be
                            // running in the kernel.
@@ -354,6 +447,30 @@ Interrupt::CheckIfDue(bool advanceClock)
     return true;
 }
 
+/// With nothing to run, the timer interrupts due before the next device
+/// event would only find the machine idle, and return.  So the timer is not
+/// called for them: it is moved to its first period that falls after the
+/// event, keeping its phase, so that once a thread runs again it is
+/// interrupted at the times it would have been.
+void
+Interrupt::SkipIdleTimer()
+{
+    PendingInterrupt *timerTick = pending.Pop();
+    ASSERT(timerTick->type == TIMER_INT);
+    ASSERT(pending.Size() > 0);
+
+    unsigned long event = pending.Top()->when;
+    if (event > timerTick->when) {
+        unsigned long periods = (event - timerTick->when + TIMER_TICKS - 1)
+                                / TIMER_TICKS;
+        timerTick->when += periods * TIMER_TICKS;
+        stats->numIdleTimerSkips += periods;
+        DEBUG('i', "Skipping %lu idle timer ticks, next at time %lu\n",
+              periods, timerTick->when);
+    }
+    pending.Push(timerTick);
+}
+
 IntStatus
 Interrupt::GetLevel() const
 {
@@ -390,10 +507,24 @@ Interrupt::DumpState()
 {
     printf("Time: %lu, interrupts %s\n",
            stats->totalTicks, INT_LEVEL_NAMES[level]);
-    if (pending->IsEmpty()) {
+    if (pending.IsEmpty()) {
         printf("No pending interrupts\n");
-    } else {
-        printf("Pending interrupts:\n");
-        pending->Apply(PrintPending);
+        return;
+    }
+
+    // Print them in the order they will fire, from a copy of the heap.
+    PendingInterrupt **sorted = new PendingInterrupt * [pending.Size()];
+    for (unsigned i = 0; i < pending.Size(); i++) {
+        PendingInterrupt *p = pending.Get(i);
+        unsigned j = i;
+        for (; j > 0 && PendingInterrupt::Before(p, sorted[j - 1]); j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = p;
+    }
+    printf("Pending interrupts:\n");
+    for (unsigned i = 0; i < pending.Size(); i++) {
+        PrintPending(sorted[i]);
     }
+    delete [] sorted;
 }
@@ -36,6 +36,7 @@
 #define NACHOS_MACHINE_INTERRUPT__HH
 
 
+#include "lib/heap.hh"
 #include "lib/list.hh"
 
 
@@ -58,7 +59,8 @@ enum MachineStatus {
 
 /// `IntType` records which hardware device generated an interrupt.  In
 /// Nachos, we support a hardware timer device, a disk, a console display and
-/// keyboard, and a network.
+/// keyboard, and a network; the kernel also uses them to wake up sleeping
+/// threads.
 enum IntType {
     TIMER_INT,
     DISK_INT,
@@ -66,6 +68,7 @@ enum IntType {
     CONSOLE_READ_INT,
     NETWORK_SEND_INT,
     NETWORK_RECV_INT,
+    ALARM_INT,
     NUM_INT_TYPES
 };
 
@@ -87,6 +90,16 @@ public:
     void *arg;  ///< The argument to the function.
     unsigned long when;  ///< When the interrupt is supposed to fire.
     IntType type;  ///< For debugging.
+    unsigned long seq;  ///< Order of scheduling, to break ties in `when`.
+    unsigned position;  ///< Place on the pending heap.
+
+    /// Interrupts come from a slab of their own (see `lib/slab.hh`).
+    static void *operator new(size_t size);
+    static void operator delete(void *p, size_t size);
+
+    /// Return whether `a` is to fire before `b`: earlier, or as early but
+    /// scheduled first.
+    static bool Before(const PendingInterrupt *a, const PendingInterrupt *b);
 };
 
 /// The following class defines the data structures for the simulation
@@ -113,7 +126,7 @@ public:
     IntStatus GetLevel() const;
 
     // The ready queue is empty, roll simulated time forward until the next
-    // interrupt.
+    // interrupt other than the timer.
     void Idle();
 
     // Quit and print out stats.
@@ -145,20 +158,44 @@ public:
     /// Advance simulated time.
     void OneTick();
 
+    /// Time up to which user instructions can run without `OneTick`
+    /// having anything to do but advance the clock.  Zero if it has to see
+    /// every instruction, because of a pending context switch, tracing or
+    /// profiling, or because the next due time is not known.
+    unsigned long BatchDeadline() const;
+
+    /// Advance simulated time by `ticks` of user instructions at once.
+    void AdvanceUserTicks(unsigned long ticks);
+
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
-    List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
-                                        ///< to occur in the future.
+    /// Interrupts scheduled to occur in the future, ordered by `when` and
+    /// then by `seq`, so that interrupts due at the same time fire in the
+    /// order they were scheduled.
+    Heap<PendingInterrupt, &PendingInterrupt::position,
+         &PendingInterrupt::Before> pending;
+    unsigned long nextSeq;  ///< `seq` of the next interrupt to schedule.
     bool inHandler;  ///< True if we are running an interrupt handler.
     bool yieldOnReturn;  ///< True if we are to context switch on return from
                          ///< the interrupt handler.
     MachineStatus status;  ///< Idle, kernel mode, user mode.
+    unsigned long nextDue;  ///< No pending interrupt is due before this
+                            ///< time; lets `OneTick` skip checking the
+                            ///< pending list until then.  Zero if unknown.
 
     /// These functions are internal to the interrupt simulation code.
 
     /// Check if an interrupt is supposed to occur now.
     bool CheckIfDue(bool advanceClock);
 
+    /// Move the timer interrupt, which is the first pending, past the
+    /// next other one, while the machine is idle.
+    void SkipIdleTimer();
+
+    /// Get a node for a new interrupt.
+    PendingInterrupt *NewPending(VoidFunctionPtr handler, void *arg,
+                                 unsigned long when, IntType type);
+
     /// SetLevel, without advancing the simulated time.
     void ChangeLevel(IntStatus old,
                      IntStatus now);
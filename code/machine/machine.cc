@@ -45,17 +45,34 @@ CheckEndian()
 /// * `st` -- pointer to an object that performs single stepping, for
 ///   dropping into it after each user instruction is executed; if null,
 ///   execute normally, without single stepping.
-Machine::Machine(SingleStepper *st)
+/// * `tlbSize`, `tlbWays` and `tlbPolicy` -- geometry and replacement
+///   policy of the TLB of each CPU, if there is one (see `MMU::MMU`).
+/// * `numCPUs` -- number of CPUs; the first one is selected.
+Machine::Machine(SingleStepper *st, unsigned tlbSize, unsigned tlbWays,
+                 TLBPolicy tlbPolicy, unsigned numCPUs_)
 {
-    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
-        registers[i] = 0;
+    ASSERT(numCPUs_ > 0 && numCPUs_ <= Statistics::MAX_CPUS);
+
+    numCPUs = numCPUs_;
+    for (unsigned c = 0; c < numCPUs; c++) {
+        for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+            cpuRegisters[c][i] = 0;
+        }
+        cpuMMUs[c] = new MMU(tlbSize, tlbWays, tlbPolicy,
+                             c == 0 ? nullptr : cpuMMUs[0]->mainMemory);
     }
+    SelectCPU(0);
 
     for (unsigned i = 0; i < NUM_EXCEPTION_TYPES; i++) {
         handlers[i] = nullptr;
     }
 
-    singleStepper = st;
+    singleStepper    = st;
+    stepping         = st != nullptr;
+    batching         = false;
+    batchTicks       = 0;
+    numBreakpoints   = 0;
+    breakpointFilter = 0;
     CheckEndian();
 }
 
@@ -65,10 +82,47 @@ Machine::GetRegisters() const
     return registers;
 }
 
+Machine::~Machine()
+{
+    // The first MMU owns the memory the others share.
+    for (unsigned c = numCPUs; c-- > 0;) {
+        delete cpuMMUs[c];
+    }
+}
+
 MMU *
 Machine::GetMMU()
 {
-    return &mmu;
+    return mmu;
+}
+
+unsigned
+Machine::GetNumCPUs() const
+{
+    return numCPUs;
+}
+
+unsigned
+Machine::GetCPU() const
+{
+    return cpu;
+}
+
+void
+Machine::SelectCPU(unsigned cpu_)
+{
+    ASSERT(cpu_ < numCPUs);
+
+    cpu       = cpu_;
+    registers = cpuRegisters[cpu];
+    mmu       = cpuMMUs[cpu];
+}
+
+MMU *
+Machine::GetMMU(unsigned cpu_)
+{
+    ASSERT(cpu_ < numCPUs);
+    return cpuMMUs[cpu_];
 }
 
 /// Fetch or write the contents of a user program register.
@@ -94,35 +148,130 @@ Machine::WriteRegister(unsigned num, int value)
 bool
 Machine::ReadMem(unsigned addr, unsigned size, int *value)
 {
-    ExceptionType e = mmu.ReadMem(addr, size, value);
+    ExceptionType e = mmu->ReadMem(addr, size, value);
     if (e != NO_EXCEPTION) {
         RaiseException(e, addr);
         return false;
     }
 
-#ifdef USE_TLB
-    stats->tlbHits++;
-#endif
-
     return true;
 }
 
 bool
 Machine::WriteMem(unsigned addr, unsigned size, int value)
 {
-    ExceptionType e = mmu.WriteMem(addr, size, value);
+    ExceptionType e = mmu->WriteMem(addr, size, value);
     if (e != NO_EXCEPTION) {
         RaiseException(e, addr);
         return false;
     }
 
-#ifdef USE_TLB
-    stats->tlbHits++;
-#endif
+    return true;
+}
+
+bool
+Machine::ReadBuffer(unsigned addr, char *buffer, unsigned count,
+                    bool stopAtNul, unsigned *copied)
+{
+    ExceptionType e = mmu->ReadBuffer(addr, buffer, count, stopAtNul, copied);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, addr + *copied);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+Machine::WriteBuffer(unsigned addr, const char *buffer, unsigned count,
+                     unsigned *copied)
+{
+    ExceptionType e = mmu->WriteBuffer(addr, buffer, count, copied);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, addr + *copied);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+Machine::TranslateAddress(unsigned addr, bool writing, unsigned *physAddr)
+{
+    ExceptionType e = mmu->TranslateAddress(addr, writing, physAddr);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, addr);
+        return false;
+    }
 
     return true;
 }
 
+bool
+Machine::SetBreakpoint(unsigned addr)
+{
+    if (IsBreakpoint(addr)) {
+        return true;
+    }
+    if (numBreakpoints == MAX_BREAKPOINTS) {
+        return false;
+    }
+    breakpoints[numBreakpoints++] = addr;
+    breakpointFilter |= BreakpointBit(addr);
+    return true;
+}
+
+bool
+Machine::ClearBreakpoint(unsigned addr)
+{
+    bool found = false;
+    breakpointFilter = 0;
+    for (unsigned i = 0; i < numBreakpoints; i++) {
+        if (!found && breakpoints[i] == addr) {
+            breakpoints[i] = breakpoints[--numBreakpoints];
+            found = true;
+        }
+        if (i < numBreakpoints) {
+            breakpointFilter |= BreakpointBit(breakpoints[i]);
+        }
+    }
+    return found;
+}
+
+unsigned
+Machine::GetNumBreakpoints() const
+{
+    return numBreakpoints;
+}
+
+unsigned
+Machine::GetBreakpoint(unsigned i) const
+{
+    ASSERT(i < numBreakpoints);
+    return breakpoints[i];
+}
+
+bool
+Machine::SetWatchpoint(unsigned addr, unsigned size)
+{
+    for (unsigned c = 0; c < numCPUs; c++) {
+        if (!cpuMMUs[c]->SetWatchpoint(addr, size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+Machine::ClearWatchpoint(unsigned addr)
+{
+    bool found = false;
+    for (unsigned c = 0; c < numCPUs; c++) {
+        found = cpuMMUs[c]->ClearWatchpoint(addr) || found;
+    }
+    return found;
+}
+
 /// Transfer control to the Nachos kernel from user mode, because the user
 /// program either invoked a system call, or some exception occured (such as
 /// the address translation failed).
@@ -141,6 +290,12 @@ Machine::RaiseException(ExceptionType et, unsigned badVAddr)
     registers[BAD_VADDR_REG] = badVAddr;
     DelayedLoad(0, 0);  // Finish anything in progress.
 
+    // The kernel must see the time of the instructions run so far.
+    if (batching) {
+        batching = false;
+        interrupt->AdvanceUserTicks(batchTicks);
+    }
+
     // Call the associated handler with interrupts enabled in system mode.
     interrupt->SetStatus(SYSTEM_MODE);
     (*handlers[et])(et);
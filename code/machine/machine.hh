@@ -22,31 +22,13 @@
 
 
 #include "exception_type.hh"
+#include "mips_core.hh"
 #include "mmu.hh"
 #include "single_stepper.hh"
+#include "statistics.hh"
 #include "lib/utility.hh"
 
 
-// User program CPU state.  The full set of MIPS registers, plus a few
-// more because we need to be able to start/stop a user program between
-// any two instructions (thus we need to keep track of things like load
-// delay slots, etc.)
-enum {
-    STACK_REG      = 29,  ///< User's stack pointer.
-    RET_ADDR_REG   = 31,  ///< Holds return address for procedure calls.
-    HI_REG         = 32,  ///< Double register to hold multiply result.
-    LO_REG         = 33,
-    PC_REG         = 34,  ///< Current program counter.
-    NEXT_PC_REG    = 35,  ///< Next program counter (for branch delay).
-    PREV_PC_REG    = 36,  ///< Previous program counter (for debugging).
-    LOAD_REG       = 37,  ///< The register target of a delayed load.
-    LOAD_VALUE_REG = 38,  ///< The value to be loaded by a delayed load.
-    BAD_VADDR_REG  = 39,  ///< The failing virtual address on an exception.
-
-    NUM_GP_REGS    = 32,  ///< 32 general purpose registers on MIPS.
-    NUM_TOTAL_REGS = 40
-};
-
 class Instruction;
 
 typedef void (*ExceptionHandler)(ExceptionType);
@@ -67,8 +49,13 @@ typedef void (*ExceptionHandler)(ExceptionType);
 class Machine {
 public:
 
-    /// Initialize the simulation of the hardware for running user programs.
-    Machine(SingleStepper *st);
+    /// Initialize the simulation of the hardware for running user programs,
+    /// with `numCPUs` CPUs sharing main memory.
+    Machine(SingleStepper *st, unsigned tlbSize = TLB_SIZE,
+            unsigned tlbWays = 0, TLBPolicy tlbPolicy = TLB_FIFO,
+            unsigned numCPUs = 1);
+
+    ~Machine();
 
     /// Routines callable by the Nachos kernel.
 
@@ -79,6 +66,19 @@ public:
 
     MMU *GetMMU();
 
+    /// Every CPU has registers and an MMU (with its TLB) of its own.  The
+    /// machine runs one CPU at a time: the one selected, whose registers
+    /// and MMU all other methods refer to.
+
+    unsigned GetNumCPUs() const;
+
+    unsigned GetCPU() const;
+
+    void SelectCPU(unsigned cpu);
+
+    /// Return the MMU of `cpu`, to keep its TLB consistent with the others.
+    MMU *GetMMU(unsigned cpu);
+
     /// Read the contents of a CPU register.
     int ReadRegister(unsigned num) const;
 
@@ -92,9 +92,56 @@ public:
 
     bool WriteMem(unsigned addr, unsigned size, int value);
 
+    bool ReadBuffer(unsigned addr, char *buffer, unsigned count,
+                    bool stopAtNul, unsigned *copied);
+
+    bool WriteBuffer(unsigned addr, const char *buffer, unsigned count,
+                     unsigned *copied);
+
+    bool TranslateAddress(unsigned addr, bool writing, unsigned *physAddr);
+
     /// Print the user CPU and memory state.
     void DumpState();
 
+    /// Breakpoints kept at most.
+    static const unsigned MAX_BREAKPOINTS = 16;
+
+    /// Drop into the single stepper before running the instruction at
+    /// `addr`, even if not single-stepping.  Return false if there is no
+    /// room for another breakpoint.
+    bool SetBreakpoint(unsigned addr);
+
+    /// Return false if there was no breakpoint at `addr`.
+    bool ClearBreakpoint(unsigned addr);
+
+    unsigned GetNumBreakpoints() const;
+
+    unsigned GetBreakpoint(unsigned i) const;
+
+    /// Watch for writes to the `size` bytes at `addr`, on every CPU, and
+    /// drop into the single stepper after an instruction writes to them
+    /// (see `MMU::SetWatchpoint`).  Return false if there is no room for
+    /// another watchpoint.
+    bool SetWatchpoint(unsigned addr, unsigned size);
+
+    /// Return false if no watchpoint starts at `addr`.
+    bool ClearWatchpoint(unsigned addr);
+
+    /// Checked before every instruction while not single-stepping, so most
+    /// addresses are told apart by the filter alone.
+    bool IsBreakpoint(unsigned addr) const
+    {
+        if ((breakpointFilter & BreakpointBit(addr)) == 0) {
+            return false;
+        }
+        for (unsigned i = 0; i < numBreakpoints; i++) {
+            if (breakpoints[i] == addr) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     /// Routines internal to the machine simulation -- DO NOT call these.
 
     /// Fetch one instruction of a user program.
@@ -105,6 +152,29 @@ public:
     /// Run a certain instruction of a user program.
     void ExecInstruction(const Instruction *instr);
 
+    /// Same as `ExecInstruction`, but run by the execution core shared
+    /// with `bin/execute`, which dispatches through a table of handlers
+    /// instead of a `switch` (see `mips_core.hh`).  Used by `Run` when
+    /// `THREADED_DISPATCH` is defined.
+    void ExecInstructionThreaded(const Instruction *instr);
+
+#ifdef BLOCK_TRANSLATION
+    /// Run the basic block at the current PC (see `block_cache.hh`).
+    void RunBlock();
+
+#ifdef SUPERINSTRUCTIONS
+    /// Between the two instructions of a pair, tell `MipsExecutePair`
+    /// whether the second one may run right away (see `mips_core.hh`).
+    bool ContinuePair();
+#endif
+#endif
+
+    /// Run user instructions up to the time the next pending interrupt is
+    /// due, and advance simulated time for all of them at once.  Return
+    /// false, without running anything, if `OneTick` has to look at the
+    /// very next instruction.
+    bool RunBatch(Instruction *instr);
+
     /// Do a pending delayed load (modifying a reg).
     void DelayedLoad(unsigned nextReg, int nextVal);
 
@@ -121,15 +191,41 @@ public:
     void SetHandler(ExceptionType et, ExceptionHandler handler);
 
 private:
+    /// Simulate R2000 multiplication, leaving the double-length result in
+    /// `*hiPtr` and `*loPtr`.
+    static void Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr);
+
     SingleStepper *singleStepper;  ///< Drop back into the method of a
                                    ///< provided object (may be a debugger)
                                    ///< after each simulated instruction.
 
+    bool stepping;  ///< Whether to drop into `singleStepper` after every
+                    ///< instruction, or only on breakpoints.
+
+    bool batching;  ///< Whether `RunBatch` is running instructions.
+    unsigned long batchTicks;  ///< Ticks of the instructions `RunBatch` ran
+                               ///< that were not added to the clock yet.
+
+    /// Bit of `breakpointFilter` that `addr` sets.
+    static unsigned BreakpointBit(unsigned addr)
+    {
+        return 1U << (addr / 4 % 32);
+    }
+
+    unsigned breakpoints[MAX_BREAKPOINTS];
+    unsigned numBreakpoints;
+    unsigned breakpointFilter;  ///< The bits of every breakpoint, or-ed.
+
     /// Private data structures.
-    int registers[NUM_TOTAL_REGS];  ///< CPU registers, for executing user
-                                    ///< programs.
+    int cpuRegisters[Statistics::MAX_CPUS][NUM_TOTAL_REGS];
+    MMU *cpuMMUs[Statistics::MAX_CPUS];
+    unsigned numCPUs;
+    unsigned cpu;
+
+    int *registers;  ///< Registers of the selected CPU, for executing user
+                     ///< programs.
 
-    MMU mmu; ///< Memory management unit.
+    MMU *mmu;  ///< Memory management unit of the selected CPU.
 
     ExceptionHandler handlers[NUM_EXCEPTION_TYPES];  ///< Exception handlers.
 };
@@ -0,0 +1,714 @@
+/// The execution core of the MIPS simulator, shared by `Machine` and the
+/// standalone interpreter `bin/execute`.
+///
+/// The core runs one predecoded `Instruction` at a time, dispatching
+/// through a table of labels indexed by its `opCode`, which the host branch
+/// predictor handles much better than one big `switch`.  It knows nothing
+/// of where the registers, the memory or the kernel are: it works on the
+/// array of registers it is given, and goes to a *host* for the rest.  A
+/// host is any class with the methods
+///
+///     bool ReadMem(unsigned addr, unsigned size, int *value);
+///     bool WriteMem(unsigned addr, unsigned size, int value);
+///     void RaiseException(ExceptionType which, unsigned badVAddr);
+///
+/// where the memory accesses raise the exception themselves and return
+/// false if they fail.  `MipsExecute` is a template on the host, so that
+/// these calls are direct and may be inlined: the simulator pays nothing
+/// for the core being shared, and speeding up the core speeds up both.
+///
+/// The semantics of each instruction must be kept identical to the ones in
+/// `Machine::ExecInstruction` (see `mips_sim.cc`), which is still the
+/// reference implementation.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_MIPSCORE__HH
+#define NACHOS_MACHINE_MIPSCORE__HH
+
+
+#include "exception_type.hh"
+#include "instruction.hh"
+#include "lib/assert.hh"
+
+#include <stdint.h>
+
+
+// User program CPU state.  The full set of MIPS registers, plus a few
+// more because we need to be able to start/stop a user program between
+// any two instructions (thus we need to keep track of things like load
+// delay slots, etc.)
+enum {
+    STACK_REG      = 29,  ///< User's stack pointer.
+    RET_ADDR_REG   = 31,  ///< Holds return address for procedure calls.
+    HI_REG         = 32,  ///< Double register to hold multiply result.
+    LO_REG         = 33,
+    PC_REG         = 34,  ///< Current program counter.
+    NEXT_PC_REG    = 35,  ///< Next program counter (for branch delay).
+    PREV_PC_REG    = 36,  ///< Previous program counter (for debugging).
+    LOAD_REG       = 37,  ///< The register target of a delayed load.
+    LOAD_VALUE_REG = 38,  ///< The value to be loaded by a delayed load.
+    BAD_VADDR_REG  = 39,  ///< The failing virtual address on an exception.
+
+    NUM_GP_REGS    = 32,  ///< 32 general purpose registers on MIPS.
+    NUM_TOTAL_REGS = 40
+};
+
+/// Simulate R2000 multiplication.
+///
+/// The words at `*hiPtr` and `*loPtr` are overwritten with the double-length
+/// result of the multiplication.
+inline void
+MipsMult(int a, int b, bool signedArith, int *hiPtr, int *loPtr)
+{
+    ASSERT(hiPtr != nullptr);
+    ASSERT(loPtr != nullptr);
+
+    uint64_t result;
+    if (signedArith) {
+        result = (uint64_t) ((int64_t) a * (int64_t) b);
+    } else {
+        result = (uint64_t) (uint32_t) a * (uint64_t) (uint32_t) b;
+    }
+
+    *hiPtr = (int) (uint32_t) (result >> 32);
+    *loPtr = (int) (uint32_t) result;
+}
+
+/// Simulate the effects of a delayed load on `registers`: apply the pending
+/// one, and leave `nextReg` and `nextValue` pending.
+inline void
+MipsDelayedLoad(int *registers, unsigned nextReg, int nextValue)
+{
+    registers[registers[LOAD_REG]] = registers[LOAD_VALUE_REG];
+    registers[LOAD_REG] = nextReg;
+    registers[LOAD_VALUE_REG] = nextValue;
+    registers[0] = 0;  // And always make sure R0 stays zero.
+}
+
+/// Finish an instruction that did not fail: do the delayed load, leaving
+/// `nextReg` and `nextValue` pending, and advance the program counters,
+/// the next one to `pcAfter`.
+inline void
+MipsRetire(int *registers, unsigned nextReg, int nextValue, int pcAfter)
+{
+    MipsDelayedLoad(registers, nextReg, nextValue);
+    registers[PREV_PC_REG] = registers[PC_REG];
+    registers[PC_REG] = registers[NEXT_PC_REG];
+    registers[NEXT_PC_REG] = pcAfter;
+}
+
+
+/// Fetch the next label to jump to and go there.
+#define DISPATCH(op)  goto *HANDLERS[(op)]
+
+/// Execute `instr` on the `NUM_TOTAL_REGS` registers at `r`, with the
+/// memory and the exceptions of `host`.
+///
+/// On an exception, the host is told and nothing else is modified, so that
+/// the instruction can be re-started.  Otherwise, the delayed load is done
+/// and the program counters advanced.
+template <class Host>
+void
+MipsExecute(Host *host, int *r, const Instruction *instr)
+{
+    // Indexed by `opCode`; see `encoding.hh`.  Holes in the numbering are
+    // mapped to `op_invalid`.
+    static void *const HANDLERS[MAX_OPCODE + 1] = {
+        &&op_invalid,                                         //  0
+        &&op_add,    &&op_addi,   &&op_addiu,  &&op_addu,     //  1 -  4
+        &&op_and,    &&op_andi,   &&op_beq,    &&op_bgez,     //  5 -  8
+        &&op_bgezal, &&op_bgtz,   &&op_blez,   &&op_bltz,     //  9 - 12
+        &&op_bltzal, &&op_bne,    &&op_invalid, &&op_div,     // 13 - 16
+        &&op_divu,   &&op_j,      &&op_jal,    &&op_jalr,     // 17 - 20
+        &&op_jr,     &&op_lb,     &&op_lb,     &&op_lh,       // 21 - 24
+        &&op_lh,     &&op_lui,    &&op_lw,     &&op_lwl,      // 25 - 28
+        &&op_lwr,    &&op_invalid, &&op_mfhi,  &&op_mflo,     // 29 - 32
+        &&op_invalid, &&op_mthi,  &&op_mtlo,   &&op_mult,     // 33 - 36
+        &&op_multu,  &&op_nor,    &&op_or,     &&op_ori,      // 37 - 40
+        &&op_invalid, &&op_sb,    &&op_sh,     &&op_sll,      // 41 - 44
+        &&op_sllv,   &&op_slt,    &&op_slti,   &&op_sltiu,    // 45 - 48
+        &&op_sltu,   &&op_sra,    &&op_srav,   &&op_srl,      // 49 - 52
+        &&op_srlv,   &&op_sub,    &&op_subu,   &&op_sw,       // 53 - 56
+        &&op_swl,    &&op_swr,    &&op_xor,    &&op_xori,     // 57 - 60
+        &&op_syscall, &&op_illegal, &&op_illegal              // 61 - 63
+    };
+
+    int nextLoadReg = 0;
+    int nextLoadValue = 0;  // Record delayed load operation, to apply in the
+                            // future.
+
+    int      pcAfter = r[NEXT_PC_REG] + 4;
+    int      sum, diff, tmp, value;
+    unsigned rs, rt, imm;
+
+    ASSERT(instr->opCode <= MAX_OPCODE);
+    DISPATCH(instr->opCode);
+
+op_add:
+    sum = r[instr->rs] + r[instr->rt];
+    if (!((r[instr->rs] ^ r[instr->rt]) & SIGN_BIT)
+          && (r[instr->rs] ^ sum) & SIGN_BIT) {
+        host->RaiseException(OVERFLOW_EXCEPTION, 0);
+        return;
+    }
+    r[instr->rd] = sum;
+    goto done;
+
+op_addi:
+    sum = r[instr->rs] + instr->extra;
+    if (!((r[instr->rs] ^ instr->extra) & SIGN_BIT)
+          && (instr->extra ^ sum) & SIGN_BIT) {
+        host->RaiseException(OVERFLOW_EXCEPTION, 0);
+        return;
+    }
+    r[instr->rt] = sum;
+    goto done;
+
+op_addiu:
+    r[instr->rt] = r[instr->rs] + instr->extra;
+    goto done;
+
+op_addu:
+    r[instr->rd] = r[instr->rs] + r[instr->rt];
+    goto done;
+
+op_and:
+    r[instr->rd] = r[instr->rs] & r[instr->rt];
+    goto done;
+
+op_andi:
+    r[instr->rt] = r[instr->rs] & (instr->extra & 0xFFFF);
+    goto done;
+
+op_beq:
+    if (r[instr->rs] == r[instr->rt]) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    goto done;
+
+op_bgezal:
+    r[RET_ADDR_REG] = r[NEXT_PC_REG] + 4;
+op_bgez:
+    if (!(r[instr->rs] & SIGN_BIT)) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    goto done;
+
+op_bgtz:
+    if (r[instr->rs] > 0) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    goto done;
+
+op_blez:
+    if (r[instr->rs] <= 0) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    goto done;
+
+op_bltzal:
+    r[RET_ADDR_REG] = r[NEXT_PC_REG] + 4;
+op_bltz:
+    if (r[instr->rs] & SIGN_BIT) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    goto done;
+
+op_bne:
+    if (r[instr->rs] != r[instr->rt]) {
+        pcAfter = r[NEXT_PC_REG] + IndexToAddr(instr->extra);
+    }
+    goto done;
+
+op_div:
+    if (r[instr->rt] == 0) {
+        r[LO_REG] = 0;
+        r[HI_REG] = 0;
+    } else {
+        r[LO_REG] = r[instr->rs] / r[instr->rt];
+        r[HI_REG] = r[instr->rs] % r[instr->rt];
+    }
+    goto done;
+
+op_divu:
+    rs = (unsigned) r[instr->rs];
+    rt = (unsigned) r[instr->rt];
+    if (rt == 0) {
+        r[LO_REG] = 0;
+        r[HI_REG] = 0;
+    } else {
+        tmp = rs / rt;
+        r[LO_REG] = (int) tmp;
+        tmp = rs % rt;
+        r[HI_REG] = (int) tmp;
+    }
+    goto done;
+
+op_jal:
+    r[RET_ADDR_REG] = r[NEXT_PC_REG] + 4;
+op_j:
+    pcAfter = (pcAfter & 0xF0000000) | IndexToAddr(instr->extra);
+    goto done;
+
+op_jalr:
+    r[instr->rd] = r[NEXT_PC_REG] + 4;
+op_jr:
+    pcAfter = r[instr->rs];
+    goto done;
+
+op_lb:  // Also `LBU`.
+    tmp = r[instr->rs] + instr->extra;
+    if (!host->ReadMem(tmp, 1, &value)) {
+        return;
+    }
+    if (value & 0x80 && instr->opCode == OP_LB) {
+        value |= 0xFFFFFF00;
+    } else {
+        value &= 0xFF;
+    }
+    nextLoadReg = instr->rt;
+    nextLoadValue = value;
+    goto done;
+
+op_lh:  // Also `LHU`.
+    tmp = r[instr->rs] + instr->extra;
+    if (tmp & 0x1) {
+        host->RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
+        return;
+    }
+    if (!host->ReadMem(tmp, 2, &value)) {
+        return;
+    }
+    if (value & 0x8000 && instr->opCode == OP_LH) {
+        value |= 0xFFFF0000;
+    } else {
+        value &= 0xFFFF;
+    }
+    nextLoadReg = instr->rt;
+    nextLoadValue = value;
+    goto done;
+
+op_lui:
+    r[instr->rt] = instr->extra << 16;
+    goto done;
+
+op_lw:
+    tmp = r[instr->rs] + instr->extra;
+    if (tmp & 0x3) {
+        host->RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
+        return;
+    }
+    if (!host->ReadMem(tmp, 4, &value)) {
+        return;
+    }
+    nextLoadReg = instr->rt;
+    nextLoadValue = value;
+    goto done;
+
+op_lwl:
+    tmp = r[instr->rs] + instr->extra;
+    ASSERT((tmp & 0x3) == 0);  // See `Machine::ExecInstruction`.
+    if (!host->ReadMem(tmp, 4, &value)) {
+        return;
+    }
+    if (r[LOAD_REG] == instr->rt) {
+        nextLoadValue = r[LOAD_VALUE_REG];
+    } else {
+        nextLoadValue = r[instr->rt];
+    }
+    switch (tmp & 0x3) {
+        case 0:
+            nextLoadValue = value;
+            break;
+        case 1:
+            nextLoadValue = (nextLoadValue & 0xFF) | value << 8;
+            break;
+        case 2:
+            nextLoadValue = (nextLoadValue & 0xFFFF) | value << 16;
+            break;
+        case 3:
+            nextLoadValue = (nextLoadValue & 0xFFFFFF) | value << 24;
+            break;
+    }
+    nextLoadReg = instr->rt;
+    goto done;
+
+op_lwr:
+    tmp = r[instr->rs] + instr->extra;
+    ASSERT((tmp & 0x3) == 0);  // See `Machine::ExecInstruction`.
+    if (!host->ReadMem(tmp, 4, &value)) {
+        return;
+    }
+    if (r[LOAD_REG] == instr->rt) {
+        nextLoadValue = r[LOAD_VALUE_REG];
+    } else {
+        nextLoadValue = r[instr->rt];
+    }
+    switch (tmp & 0x3) {
+        case 0:
+            nextLoadValue = (nextLoadValue & 0xFFFFFF00)
+                            | (value >> 24 & 0xFF);
+            break;
+        case 1:
+            nextLoadValue = (nextLoadValue & 0xFFFF0000)
+                            | (value >> 16 & 0xFFFF);
+            break;
+        case 2:
+            nextLoadValue = (nextLoadValue & 0xFF000000)
+                            | (value >> 8 & 0xFFFFFF);
+            break;
+        case 3:
+            nextLoadValue = value;
+            break;
+    }
+    nextLoadReg = instr->rt;
+    goto done;
+
+op_mfhi:
+    r[instr->rd] = r[HI_REG];
+    goto done;
+
+op_mflo:
+    r[instr->rd] = r[LO_REG];
+    goto done;
+
+op_mthi:
+    r[HI_REG] = r[instr->rs];
+    goto done;
+
+op_mtlo:
+    r[LO_REG] = r[instr->rs];
+    goto done;
+
+op_mult:
+    MipsMult(r[instr->rs], r[instr->rt], true, &r[HI_REG], &r[LO_REG]);
+    goto done;
+
+op_multu:
+    MipsMult(r[instr->rs], r[instr->rt], false, &r[HI_REG], &r[LO_REG]);
+    goto done;
+
+op_nor:
+    r[instr->rd] = ~(r[instr->rs] | r[instr->rt]);
+    goto done;
+
+op_or:
+    r[instr->rd] = r[instr->rs] | r[instr->rt];
+    goto done;
+
+op_ori:
+    r[instr->rt] = r[instr->rs] | (instr->extra & 0xFFFF);
+    goto done;
+
+op_sb:
+    if (!host->WriteMem((unsigned) (r[instr->rs] + instr->extra),
+                  1, r[instr->rt])) {
+        return;
+    }
+    goto done;
+
+op_sh:
+    if (!host->WriteMem((unsigned) (r[instr->rs] + instr->extra),
+                  2, r[instr->rt])) {
+        return;
+    }
+    goto done;
+
+op_sll:
+    r[instr->rd] = r[instr->rt] << instr->extra;
+    goto done;
+
+op_sllv:
+    r[instr->rd] = r[instr->rt] << (r[instr->rs] & 0x1F);
+    goto done;
+
+op_slt:
+    r[instr->rd] = (r[instr->rs] < r[instr->rt]) ? 1 : 0;
+    goto done;
+
+op_slti:
+    r[instr->rt] = (r[instr->rs] < instr->extra) ? 1 : 0;
+    goto done;
+
+op_sltiu:
+    rs = r[instr->rs];
+    imm = instr->extra;
+    r[instr->rt] = (rs < imm) ? 1 : 0;
+    goto done;
+
+op_sltu:
+    rs = r[instr->rs];
+    rt = r[instr->rt];
+    r[instr->rd] = (rs < rt) ? 1 : 0;
+    goto done;
+
+op_sra:
+    r[instr->rd] = r[instr->rt] >> instr->extra;
+    goto done;
+
+op_srav:
+    r[instr->rd] = r[instr->rt] >> (r[instr->rs] & 0x1F);
+    goto done;
+
+op_srl:
+    tmp = r[instr->rt];
+    tmp >>= instr->extra;
+    r[instr->rd] = tmp;
+    goto done;
+
+op_srlv:
+    tmp = r[instr->rt];
+    tmp >>= r[instr->rs] & 0x1F;
+    r[instr->rd] = tmp;
+    goto done;
+
+op_sub:
+    diff = r[instr->rs] - r[instr->rt];
+    if ((r[instr->rs] ^ r[instr->rt]) & SIGN_BIT
+          && (r[instr->rs] ^ diff) & SIGN_BIT) {
+        host->RaiseException(OVERFLOW_EXCEPTION, 0);
+        return;
+    }
+    r[instr->rd] = diff;
+    goto done;
+
+op_subu:
+    r[instr->rd] = r[instr->rs] - r[instr->rt];
+    goto done;
+
+op_sw:
+    if (!host->WriteMem((unsigned) (r[instr->rs] + instr->extra),
+                  4, r[instr->rt])) {
+        return;
+    }
+    goto done;
+
+op_swl:
+    tmp = r[instr->rs] + instr->extra;
+    ASSERT((tmp & 0x3) == 0);  // See `Machine::ExecInstruction`.
+    if (!host->ReadMem(tmp & ~0x3, 4, &value)) {
+        return;
+    }
+    switch (tmp & 0x3) {
+        case 0:
+            value = r[instr->rt];
+            break;
+        case 1:
+            value = (value & 0xFF000000) | (r[instr->rt] >> 8 & 0xFFFFFF);
+            break;
+        case 2:
+            value = (value & 0xFFFF0000) | (r[instr->rt] >> 16 & 0xFFFF);
+            break;
+        case 3:
+            value = (value & 0xFFFFFF00) | (r[instr->rt] >> 24 & 0xFF);
+            break;
+    }
+    if (!host->WriteMem(tmp & ~0x3, 4, value)) {
+        return;
+    }
+    goto done;
+
+op_swr:
+    tmp = r[instr->rs] + instr->extra;
+    ASSERT((tmp & 0x3) == 0);  // See `Machine::ExecInstruction`.
+    if (!host->ReadMem(tmp & ~0x3, 4, &value)) {
+        return;
+    }
+    switch (tmp & 0x3) {
+        case 0:
+            value = (value & 0xFFFFFF) | r[instr->rt] << 24;
+            break;
+        case 1:
+            value = (value & 0xFFFF) | r[instr->rt] << 16;
+            break;
+        case 2:
+            value = (value & 0xFF) | r[instr->rt] << 8;
+            break;
+        case 3:
+            value = r[instr->rt];
+            break;
+    }
+    if (!host->WriteMem(tmp & ~0x3, 4, value)) {
+        return;
+    }
+    goto done;
+
+op_syscall:
+    host->RaiseException(SYSCALL_EXCEPTION, 0);
+    return;
+
+op_xor:
+    r[instr->rd] = r[instr->rs] ^ r[instr->rt];
+    goto done;
+
+op_xori:
+    r[instr->rt] = r[instr->rs] ^ (instr->extra & 0xFFFF);
+    goto done;
+
+op_illegal:  // `RES` and `UNIMP`.
+    host->RaiseException(ILLEGAL_INSTR_EXCEPTION, 0);
+    return;
+
+op_invalid:
+    ASSERT(false);
+    return;
+
+done:
+    // Now we have successfully executed the instruction.
+
+    // Do any delayed load operation, and advance program counters.
+    MipsRetire(r, nextLoadReg, nextLoadValue, pcAfter);
+}
+
+#undef DISPATCH
+
+
+/// Pairs of instructions that compiled code has back to back so often that
+/// they are worth running as one, by `MipsExecutePair`.
+///
+/// A pair is only made of instructions that do not transfer control, but
+/// for the last branch, and such that the first one does not write memory,
+/// so that nothing the first one does may have to stop the second one but
+/// an interrupt, which the host checks.
+enum FusedPair {
+    FUSED_NONE,
+    FUSED_LUI_ORI,       ///< `lui r, hi; ori r, r, lo`: a constant.
+    FUSED_LUI_ADDIU,     ///< `lui r, hi; addiu r, r, lo`: an address.
+    FUSED_LW_NOP,        ///< `lw r, n(s); nop`: a load and its delay slot.
+    FUSED_ADDIU_SW,      ///< `addiu sp, sp, -n; sw ra, m(sp)`: a prologue.
+    FUSED_SLT_BRANCH,    ///< `slt r, s, t; bne r, zero, l`, or `beq`.
+    FUSED_SLTI_BRANCH,   ///< Likewise with `slti`.
+    FUSED_SLTIU_BRANCH,  ///< Likewise with `sltiu`.
+    FUSED_SLTU_BRANCH    ///< Likewise with `sltu`.
+};
+
+/// Return the pair that `first` and `second`, back to back, make, or
+/// `FUSED_NONE`.
+///
+/// Registers are not looked at: a pair is run exactly like its two
+/// instructions one after the other, whatever they work on.
+inline unsigned char
+MipsFusePair(const Instruction *first, const Instruction *second)
+{
+    ASSERT(first != nullptr);
+    ASSERT(second != nullptr);
+
+    bool branch = second->opCode == OP_BEQ || second->opCode == OP_BNE;
+    switch (first->opCode) {
+        case OP_LUI:
+            return second->opCode == OP_ORI   ? FUSED_LUI_ORI
+                 : second->opCode == OP_ADDIU ? FUSED_LUI_ADDIU
+                 : FUSED_NONE;
+        case OP_LW:
+            return second->value == 0 ? FUSED_LW_NOP : FUSED_NONE;
+        case OP_ADDIU:
+            return second->opCode == OP_SW ? FUSED_ADDIU_SW : FUSED_NONE;
+        case OP_SLT:
+            return branch ? FUSED_SLT_BRANCH : FUSED_NONE;
+        case OP_SLTI:
+            return branch ? FUSED_SLTI_BRANCH : FUSED_NONE;
+        case OP_SLTIU:
+            return branch ? FUSED_SLTIU_BRANCH : FUSED_NONE;
+        case OP_SLTU:
+            return branch ? FUSED_SLTU_BRANCH : FUSED_NONE;
+        default:
+            return FUSED_NONE;
+    }
+}
+
+/// Execute the two instructions at `pair`, which make the pair `fused`, as
+/// `MipsExecute` would one after the other.
+///
+/// Between the two, the host is asked whether the second one may follow
+/// right away, with
+///
+///     bool ContinuePair();
+///
+/// which must account for the time of the first one if so.  Return whether
+/// the second one was run, even if it failed; if not, only the first one
+/// was, unless it failed too.
+template <class Host>
+bool
+MipsExecutePair(Host *host, int *r, const Instruction *pair,
+                unsigned char fused)
+{
+    ASSERT(fused != FUSED_NONE);
+
+    const Instruction *a = &pair[0];
+    const Instruction *b = &pair[1];
+    int nextLoadReg = 0;
+    int nextLoadValue = 0;
+    int tmp, value;
+
+    switch (fused) {
+        case FUSED_LUI_ORI:
+        case FUSED_LUI_ADDIU:
+            r[a->rt] = a->extra << 16;
+            break;
+        case FUSED_LW_NOP:
+            tmp = r[a->rs] + a->extra;
+            if (tmp & 0x3) {
+                host->RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
+                return false;
+            }
+            if (!host->ReadMem(tmp, 4, &value)) {
+                return false;
+            }
+            nextLoadReg = a->rt;
+            nextLoadValue = value;
+            break;
+        case FUSED_ADDIU_SW:
+            r[a->rt] = r[a->rs] + a->extra;
+            break;
+        case FUSED_SLT_BRANCH:
+            r[a->rd] = (r[a->rs] < r[a->rt]) ? 1 : 0;
+            break;
+        case FUSED_SLTI_BRANCH:
+            r[a->rt] = (r[a->rs] < a->extra) ? 1 : 0;
+            break;
+        case FUSED_SLTIU_BRANCH:
+            r[a->rt] = ((unsigned) r[a->rs] < (unsigned) a->extra) ? 1 : 0;
+            break;
+        case FUSED_SLTU_BRANCH:
+            r[a->rd] = ((unsigned) r[a->rs] < (unsigned) r[a->rt]) ? 1 : 0;
+            break;
+        default:
+            ASSERT(false);
+    }
+    MipsRetire(r, nextLoadReg, nextLoadValue, r[NEXT_PC_REG] + 4);
+    if (!host->ContinuePair()) {
+        return false;
+    }
+
+    int pcAfter = r[NEXT_PC_REG] + 4;
+    switch (fused) {
+        case FUSED_LUI_ORI:
+            r[b->rt] = r[b->rs] | (b->extra & 0xFFFF);
+            break;
+        case FUSED_LUI_ADDIU:
+            r[b->rt] = r[b->rs] + b->extra;
+            break;
+        case FUSED_LW_NOP:
+            break;
+        case FUSED_ADDIU_SW:
+            if (!host->WriteMem((unsigned) (r[b->rs] + b->extra),
+                                4, r[b->rt])) {
+                return true;
+            }
+            break;
+        default:  // A branch.
+            if ((r[b->rs] == r[b->rt]) == (b->opCode == OP_BEQ)) {
+                pcAfter = r[NEXT_PC_REG] + IndexToAddr(b->extra);
+            }
+            break;
+    }
+    MipsRetire(r, 0, 0, pcAfter);
+    return true;
+}
+
+
+#endif
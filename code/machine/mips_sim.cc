@@ -15,6 +15,7 @@
 #include "machine.hh"
 #include "threads/system.hh"
 
+#include <stdint.h>
 #include <stdio.h>
 
 
@@ -36,15 +37,146 @@ Machine::Run()
     interrupt->SetStatus(USER_MODE);
 
     for (;;) {
+        // Between breakpoints, the single stepper is left alone, and the
+        // program runs at full speed.
+        if (singleStepper != nullptr
+              && (stepping || IsBreakpoint(registers[PC_REG])
+                  || mmu->HasWatchHit())) {
+            stepping = singleStepper->Step();
+        }
+#ifdef BLOCK_TRANSLATION
+        // Single-stepping and instruction tracing want to see every fetch,
+        // so fall back to the plain interpreter for them.
+        if (!stepping && !debug.IsEnabled('m')) {
+            RunBlock();
+            continue;
+        }
+#endif
+        if (singleStepper == nullptr && RunBatch(instr)) {
+            continue;
+        }
         if (FetchInstruction(instr)) {
+#ifdef THREADED_DISPATCH
+            ExecInstructionThreaded(instr);
+#else
             ExecInstruction(instr);
+#endif
         }
         interrupt->OneTick();
-        if (singleStepper != nullptr && !singleStepper->Step()) {
-            singleStepper = nullptr;
+    }
+}
+
+/// Nothing but the clock changes between interrupts, so instead of calling
+/// `OneTick` after every instruction, count the ticks and add them when the
+/// next interrupt is about to be due.  The instruction that brings it due
+/// is left to `Run`, to go through `OneTick` as usual.  An exception ends
+/// the batch early: `RaiseException` adds the ticks counted so far before
+/// trapping, and the faulting instruction is ticked like in `Run`.
+bool
+Machine::RunBatch(Instruction *instr)
+{
+    unsigned long deadline = interrupt->BatchDeadline();
+    if (stats->totalTicks + USER_TICK >= deadline) {
+        return false;
+    }
+
+    batching   = true;
+    batchTicks = 0;
+    do {
+        if (FetchInstruction(instr)) {
+#ifdef THREADED_DISPATCH
+            ExecInstructionThreaded(instr);
+#else
+            ExecInstruction(instr);
+#endif
+        }
+        if (!batching) {
+            interrupt->OneTick();
+            return true;
         }
+        batchTicks += USER_TICK;
+        // Checked against the clock every time, since `CACHE_MODEL`
+        // charges stalls to it while the instruction runs.
+    } while (stats->totalTicks + batchTicks + USER_TICK < deadline);
+    batching = false;
+    interrupt->AdvanceUserTicks(batchTicks);
+    return true;
+}
+
+#ifdef BLOCK_TRANSLATION
+/// Execute the basic block starting at the current PC.
+///
+/// Ticks after every instruction, exactly like `Run` does, so interrupts
+/// and exceptions still happen at the same instruction boundaries.  The
+/// block is left as soon as control does not flow sequentially anymore (a
+/// taken branch or an exception), if its code changed in the meantime, or
+/// on a breakpoint or a write to watched memory, for `Run` to stop there.
+void
+Machine::RunBlock()
+{
+    unsigned startPC = registers[PC_REG];
+    const BasicBlock *block;
+    const MMU *blockMMU = mmu;
+
+    ExceptionType e = mmu->FetchBlock(startPC, &block);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, startPC);
+        interrupt->OneTick();
+        return;
+    }
+    // Copy what we need: the block may be released while another thread
+    // runs during `OneTick`, and this one may come back on another CPU.
+    unsigned frame = block->frame;
+    unsigned generation = block->generation;
+    unsigned length = block->length;
+    const Instruction *instrs = block->instrs;
+#ifdef SUPERINSTRUCTIONS
+    const unsigned char *fused = block->fused;
+#endif
+
+    for (unsigned i = 0; i < length; i++) {
+        if (i > 0 && ((unsigned) registers[PC_REG] != startPC + 4 * i
+                      || mmu != blockMMU
+                      || !mmu->IsBlockCurrent(frame, generation)
+                      || IsBreakpoint(registers[PC_REG])
+                      || mmu->HasWatchHit())) {
+            return;
+        }
+#ifdef SUPERINSTRUCTIONS
+        // Only the tick of the second instruction is left for `OneTick`.
+        if (fused[i] != FUSED_NONE) {
+            if (MipsExecutePair(this, registers, &instrs[i], fused[i])) {
+                i++;
+            }
+            interrupt->OneTick();
+            continue;
+        }
+#endif
+#ifdef THREADED_DISPATCH
+        ExecInstructionThreaded(&instrs[i]);
+#else
+        ExecInstruction(&instrs[i]);
+#endif
+        interrupt->OneTick();
     }
 }
+#ifdef SUPERINSTRUCTIONS
+/// The second instruction of a pair may only follow the first one right
+/// away if `OneTick` would have had nothing to do between them and nobody
+/// wants to stop there.  Then the tick of the first one is just added to
+/// the clock.
+bool
+Machine::ContinuePair()
+{
+    if (stats->totalTicks + USER_TICK >= interrupt->BatchDeadline()
+          || IsBreakpoint(registers[PC_REG])) {
+        return false;
+    }
+    interrupt->AdvanceUserTicks(USER_TICK);
+    return true;
+}
+#endif
+#endif
 
 /// Simulate effects of a delayed load.
 ///
@@ -53,10 +185,7 @@ Machine::Run()
 void
 Machine::DelayedLoad(unsigned nextReg, int nextValue)
 {
-    registers[registers[LOAD_REG]] = registers[LOAD_VALUE_REG];
-    registers[LOAD_REG] = nextReg;
-    registers[LOAD_VALUE_REG] = nextValue;
-    registers[0] = 0;  // And always make sure R0 stays zero.
+    MipsDelayedLoad(registers, nextReg, nextValue);
 }
 
 bool
@@ -64,13 +193,11 @@ Machine::FetchInstruction(Instruction *instr)
 {
     ASSERT(instr != nullptr);
 
-    int raw;
-    if (!ReadMem(registers[PC_REG], 4, &raw)) {
+    ExceptionType e = mmu->FetchInstruction(registers[PC_REG], instr);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, registers[PC_REG]);
         return false;  // Exception occurred.
     }
-    instr->value = raw;
-    instr->Decode();
-
     if (debug.IsEnabled('m')) {
         const struct OpString *str = &OP_STRINGS[instr->opCode];
 
@@ -84,74 +211,19 @@ Machine::FetchInstruction(Instruction *instr)
     return true;
 }
 
-/// Simulate R2000 multiplication.
-///
-/// The words at `*hiPtr` and `*loPtr` are overwritten with the double-length
-/// result of the multiplication.
-static void
-Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr)
+/// Simulate R2000 multiplication, as the execution core does.
+void
+Machine::Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr)
 {
-    ASSERT(hiPtr != nullptr);
-    ASSERT(loPtr != nullptr);
-
-    if (a == 0 || b == 0) {
-        *hiPtr = *loPtr = 0;
-        return;
-    }
-
-    // Compute the sign of the result, then make everything positive so
-    // unsigned computation can be done in the main loop.
-    bool negative = false;
-    if (signedArith) {
-        if (a < 0) {
-            negative = !negative;
-            a = -a;
-        }
-        if (b < 0) {
-            negative = !negative;
-            b = -b;
-        }
-    }
-
-    // Compute the result in unsigned arithmetic (check `a`'s bits one at a
-    // time, and add in a shifted value of `b`).
-    unsigned bLo = b;
-    unsigned bHi = 0;
-    unsigned lo = 0;
-    unsigned hi = 0;
-    for (unsigned i = 0; i < 32; i++) {
-        if (a & 1) {
-            lo += bLo;
-            if (lo < bLo) {  // Carry out of the low bits?
-                hi += 1;
-            }
-            hi += bHi;
-            if ((a & 0xFFFFFFFE) == 0) {
-                break;
-            }
-        }
-        bHi <<= 1;
-        if (bLo & 0x80000000) {
-            bHi |= 1;
-        }
-
-        bLo <<= 1;
-        a >>= 1;
-    }
-
-    // If the result is supposed to be negative, compute the two's complement
-    // of the double-word result.
-    if (negative) {
-        hi = ~hi;
-        lo = ~lo;
-        lo++;
-        if (lo == 0) {
-            hi++;
-        }
-    }
+    MipsMult(a, b, signedArith, hiPtr, loPtr);
+}
 
-    *hiPtr = (int) hi;
-    *loPtr = (int) lo;
+/// The machine is the host of the core: its memory accesses go through the
+/// MMU, and its exceptions trap to the kernel.
+void
+Machine::ExecInstructionThreaded(const Instruction *instr)
+{
+    MipsExecute(this, registers, instr);
 }
 
 /// Execute one instruction from a user-level program.
@@ -30,60 +30,487 @@
 
 #include "mmu.hh"
 #include "endianness.hh"
+#include "threads/system.hh"
 
 #include <stdio.h>
+#include <string.h>
 
 
-MMU::MMU()
+static const char *TLB_POLICY_NAMES[] = { "fifo", "lru", "random", "clock" };
+
+bool
+ParseTLBPolicy(const char *name, TLBPolicy *policy)
 {
-    mainMemory = new char [MEMORY_SIZE];
-    for (unsigned i = 0; i < MEMORY_SIZE; i++) {
-        mainMemory[i] = 0;
+    ASSERT(name != nullptr);
+    ASSERT(policy != nullptr);
+
+    for (unsigned i = 0; i < NUM_TLB_POLICIES; i++) {
+        if (strcmp(name, TLB_POLICY_NAMES[i]) == 0) {
+            *policy = (TLBPolicy) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *
+TLBPolicyToString(TLBPolicy policy)
+{
+    ASSERT(policy < NUM_TLB_POLICIES);
+    return TLB_POLICY_NAMES[policy];
+}
+
+
+unsigned numPhysPages = DEFAULT_NUM_PHYS_PAGES;
+
+MMU::MMU(unsigned tlbSize_, unsigned tlbWays_, TLBPolicy tlbPolicy_,
+         char *memory)
+    : icache(numPhysPages, PAGE_SIZE)
+#ifdef BLOCK_TRANSLATION
+    , blockCache(numPhysPages, PAGE_SIZE)
+#endif
+{
+    ASSERT(numPhysPages > 0 && numPhysPages < TranslationEntry::MAX_FRAMES);
+    ASSERT(sizeof (TranslationEntry) == 2 * sizeof (unsigned));
+
+    ownsMemory = memory == nullptr;
+    if (ownsMemory) {
+        // Zeroed by the host as pages are touched; frames given to a
+        // program are cleared by the kernel then, not here.
+        mainMemory = SystemDep::MapZeroed(numPhysPages * PAGE_SIZE);
+    } else {
+        mainMemory = memory;
     }
 
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLB_SIZE];
-    for (unsigned i = 0; i < TLB_SIZE; i++) {
+    ASSERT(tlbSize_ > 0);
+    ASSERT(tlbWays_ <= tlbSize_ && (tlbWays_ == 0 || tlbSize_ % tlbWays_ == 0));
+    ASSERT(tlbPolicy_ < NUM_TLB_POLICIES);
+
+    tlbSize   = tlbSize_;
+    tlbWays   = tlbWays_ == 0 ? tlbSize_ : tlbWays_;
+    tlbSets   = tlbSize / tlbWays;
+    tlbPolicy = tlbPolicy_;
+
+    tlb = new TranslationEntry[tlbSize];
+    for (unsigned i = 0; i < tlbSize; i++) {
         tlb[i].valid = false;
+        tlb[i].large = false;
     }
     pageTable = nullptr;
 #else  // Use linear page table.
+    tlbSize = tlbWays = tlbSets = 0;
+    tlbPolicy = tlbPolicy_;
     tlb = nullptr;
     pageTable = nullptr;
 #endif
+
+    currentAsid = NO_ASID;
+    tlbAsid     = new unsigned [tlbSize];
+    for (unsigned i = 0; i < tlbSize; i++) {
+        tlbAsid[i] = NO_ASID;
+    }
+
+    tlbHand    = new unsigned [tlbSets];
+    tlbLastUse = new unsigned long [tlbSize];
+    tlbClock   = 0;
+    for (unsigned i = 0; i < tlbSets; i++) {
+        tlbHand[i] = 0;
+    }
+    for (unsigned i = 0; i < tlbSize; i++) {
+        tlbLastUse[i] = 0;
+    }
+
+    // Use at least twice as many buckets as entries, rounded up to a power
+    // of two so that hashing is just a mask.
+    unsigned buckets = 1;
+    while (buckets < 2 * tlbSize) {
+        buckets <<= 1;
+    }
+    tlbHashMask = buckets - 1;
+    tlbBucket   = new int [buckets];
+    tlbChain    = new int [tlbSize];
+    tlbLinked   = new bool [tlbSize];
+    for (unsigned i = 0; i < buckets; i++) {
+        tlbBucket[i] = -1;
+    }
+    for (unsigned i = 0; i < tlbSize; i++) {
+        tlbChain[i] = -1;
+        tlbLinked[i] = false;
+    }
+    numLargeTLBEntries = 0;
+
+    numWatchpoints = 0;
+    watchHit       = false;
+    watchHitAddr   = 0;
+
+    fastPathTable   = nullptr;
+    fastPathEnabled = !debug.IsEnabled('a');
+    FlushFastPath();
+
+#ifdef CACHE_MODEL
+    caches = CacheHierarchy::IsConfigured() ? new CacheHierarchy : nullptr;
+#endif
 }
 
 MMU::~MMU()
 {
-    delete [] mainMemory;
+    if (ownsMemory) {
+        SystemDep::UnmapFile(mainMemory, numPhysPages * PAGE_SIZE);
+    }
     if (tlb != nullptr) {
         delete [] tlb;
     }
+    delete [] tlbAsid;
+    delete [] tlbHand;
+    delete [] tlbLastUse;
+    delete [] tlbBucket;
+    delete [] tlbChain;
+    delete [] tlbLinked;
+#ifdef CACHE_MODEL
+    delete caches;
+#endif
+}
+
+unsigned
+MMU::GetTLBSize() const
+{
+    return tlbSize;
+}
+
+unsigned
+MMU::GetTLBEntryASID(unsigned slot) const
+{
+    ASSERT(slot < tlbSize);
+
+    return tlbAsid[slot];
+}
+
+bool
+MMU::ProbeTLB(unsigned vpn) const
+{
+    ASSERT(tlb != nullptr);
+
+    return FindTLBSlot(vpn) != -1;
+}
+
+int
+MMU::FindTLBSlot(unsigned vpn) const
+{
+    for (int i = tlbBucket[TLBBucket(vpn, currentAsid)]; i != -1;
+         i = tlbChain[i]) {
+        if (tlb[i].valid && tlb[i].virtualPage == vpn
+              && tlbAsid[i] == currentAsid) {
+            return i;
+        }
+    }
+
+    // Large entries are indexed by the first page of their group.
+    unsigned base = TranslationEntry::LargeBase(vpn);
+    if (numLargeTLBEntries == 0 || base == vpn) {
+        return -1;
+    }
+    for (int i = tlbBucket[TLBBucket(base, currentAsid)]; i != -1;
+         i = tlbChain[i]) {
+        if (tlb[i].valid && tlb[i].large && tlb[i].virtualPage == base
+              && tlbAsid[i] == currentAsid) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// Return whether `entry` maps `frame`.
+static bool
+MapsFrame(const TranslationEntry *entry, unsigned frame)
+{
+    unsigned span = entry->large ? TranslationEntry::LARGE_PAGE_PAGES : 1;
+    return entry->valid && frame >= entry->physicalPage
+           && frame < entry->physicalPage + span;
+}
+
+bool
+MMU::SetWatchpoint(unsigned addr, unsigned size)
+{
+    ASSERT(size > 0);
+
+    if (numWatchpoints == MAX_WATCHPOINTS) {
+        return false;
+    }
+    watchStart[numWatchpoints] = addr;
+    watchSize[numWatchpoints]  = size;
+    numWatchpoints++;
+
+    // Cached translations of the pages watched would let writes through
+    // unchecked.
+    FlushFastPath();
+    return true;
+}
+
+bool
+MMU::ClearWatchpoint(unsigned addr)
+{
+    for (unsigned i = 0; i < numWatchpoints; i++) {
+        if (watchStart[i] == addr) {
+            numWatchpoints--;
+            watchStart[i] = watchStart[numWatchpoints];
+            watchSize[i]  = watchSize[numWatchpoints];
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned
+MMU::GetNumWatchpoints() const
+{
+    return numWatchpoints;
+}
+
+void
+MMU::GetWatchpoint(unsigned i, unsigned *addr, unsigned *size) const
+{
+    ASSERT(i < numWatchpoints);
+    ASSERT(addr != nullptr);
+    ASSERT(size != nullptr);
+
+    *addr = watchStart[i];
+    *size = watchSize[i];
+}
+
+unsigned
+MMU::TakeWatchHit()
+{
+    watchHit = false;
+    return watchHitAddr;
+}
+
+bool
+MMU::IsWatched(unsigned addr, unsigned size) const
+{
+    for (unsigned i = 0; i < numWatchpoints; i++) {
+        if (addr < watchStart[i] + watchSize[i]
+              && watchStart[i] < addr + size) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void
 MMU::PrintTLB() const
 {
 #ifdef USE_TLB
-    printf("TLB content (%u entries):\n", TLB_SIZE);
-    for (unsigned i = 0; i < TLB_SIZE; i++) {
+    printf("TLB content (%u entries, %u-way, %s), current ASID %u:\n",
+           tlbSize, tlbWays, TLBPolicyToString(tlbPolicy), currentAsid);
+    for (unsigned i = 0; i < tlbSize; i++) {
         const TranslationEntry *e = &tlb[i];
-        printf("(%u) valid: %d, virt: %d, frame: %d, flags: %s%s%s\n",
-               i, e->valid, e->virtualPage, e->physicalPage,
+        printf("(%u) valid: %d, asid: %u, virt: %d, frame: %d, "
+               "flags: %s%s%s%s\n",
+               i, e->valid, tlbAsid[i], e->virtualPage, e->physicalPage,
                (e->readOnly) ? "readonly " : "",
                (e->use)      ? "use " : "",
-               (e->dirty)    ? "dirty" : "");
+               (e->dirty)    ? "dirty " : "",
+               (e->large)    ? "large" : "");
     }
 #else
     printf("TLB not present in the machine.\n");
 #endif
 }
 
-void MMU::LoadTLBEntry(TranslationEntry entry) {
-    tlb[tlbFIFO] = entry;
+void MMU::LoadTLBEntry(TranslationEntry entry, TranslationEntry *evicted) {
+    ASSERT(tlb != nullptr);
+    ASSERT(!entry.large
+             || (entry.virtualPage % TranslationEntry::LARGE_PAGE_PAGES == 0
+                 && entry.physicalPage
+                      % TranslationEntry::LARGE_PAGE_PAGES == 0));
+
+    unsigned slot = ChooseTLBVictim(entry.virtualPage % tlbSets);
+    if (evicted != nullptr) {
+        *evicted = tlb[slot];
+    }
+
+    UnlinkTLBSlot(slot);
+    // Every page of a large entry may have been cached through it.
+    unsigned span = tlb[slot].large ? TranslationEntry::LARGE_PAGE_PAGES : 1;
+    for (unsigned k = 0; k < span; k++) {
+        FastTranslation *f = &fastPath[(tlb[slot].virtualPage + k)
+                                       & (FAST_PATH_SIZE - 1)];
+        if (f->tlbSlot == (int) slot) {
+            f->vpn = FastTranslation::INVALID_VPN;
+        }
+    }
+    tlb[slot] = entry;
+    tlbAsid[slot] = currentAsid;
+    LinkTLBSlot(slot);
+    tlbLastUse[slot] = ++tlbClock;
+}
+
+void
+MMU::CollectTLBBits(unsigned frame, TranslationEntry *entry)
+{
+    ASSERT(entry != nullptr);
+
+    for (unsigned i = 0; i < tlbSize; i++) {
+        if (MapsFrame(&tlb[i], frame)) {
+            entry->use   = entry->use   || tlb[i].use;
+            entry->dirty = entry->dirty || tlb[i].dirty;
+            tlb[i].use   = false;
+            tlb[i].dirty = false;
+        }
+    }
+}
+
+void
+MMU::InvalidateTLBFrame(unsigned frame)
+{
+    for (unsigned i = 0; i < tlbSize; i++) {
+        if (MapsFrame(&tlb[i], frame)) {
+            UnlinkTLBSlot(i);
+            tlb[i].valid = false;
+        }
+    }
+}
+
+/// Choose which entry of `set` is to be replaced by a new translation.
+///
+/// Invalid entries are always taken first; otherwise the configured policy
+/// picks among the valid ones.
+unsigned
+MMU::ChooseTLBVictim(unsigned set)
+{
+    ASSERT(set < tlbSets);
+
+    unsigned first = set * tlbWays;
+    for (unsigned i = first; i < first + tlbWays; i++) {
+        if (!tlb[i].valid) {
+            return i;
+        }
+    }
+
+    unsigned victim;
+    switch (tlbPolicy) {
+        case TLB_FIFO:
+            victim = first + tlbHand[set];
+            tlbHand[set] = (tlbHand[set] + 1) % tlbWays;
+            break;
+
+        case TLB_LRU:
+            victim = first;
+            for (unsigned i = first + 1; i < first + tlbWays; i++) {
+                if (tlbLastUse[i] < tlbLastUse[victim]) {
+                    victim = i;
+                }
+            }
+            break;
+
+        case TLB_RANDOM:
+            victim = first + SystemDep::Random() % tlbWays;
+            break;
+
+        case TLB_CLOCK:
+            // Give every referenced entry a second chance; this terminates
+            // after at most one full turn, having cleared every `use` bit.
+            for (;;) {
+                unsigned current = first + tlbHand[set];
+                tlbHand[set] = (tlbHand[set] + 1) % tlbWays;
+                if (!tlb[current].use) {
+                    victim = current;
+                    break;
+                }
+                tlb[current].use = false;
+            }
+            break;
+
+        default:
+            ASSERT(false);
+            victim = first;
+    }
+    return victim;
+}
+
+void
+MMU::InvalidateTLB()
+{
+    ASSERT(tlb != nullptr);
 
-    tlbFIFO++;
-    tlbFIFO %= TLB_SIZE;
+    for (unsigned i = 0; i < tlbSize; i++) {
+        UnlinkTLBSlot(i);
+        tlb[i].valid = false;
+    }
+    FlushFastPath();
+}
+
+void
+MMU::SetASID(unsigned asid)
+{
+    ASSERT(asid <= NO_ASID);
+    if (asid != currentAsid) {
+        FlushFastPath();
+    }
+    currentAsid = asid;
+}
+
+void
+MMU::InvalidateASID(unsigned asid)
+{
+    ASSERT(tlb != nullptr);
+    ASSERT(asid <= NO_ASID);
+
+    for (unsigned i = 0; i < tlbSize; i++) {
+        if (tlbAsid[i] == asid) {
+            UnlinkTLBSlot(i);
+            tlb[i].valid = false;
+        }
+    }
+    if (asid == currentAsid) {
+        FlushFastPath();
+    }
+}
+
+unsigned
+MMU::TLBBucket(unsigned vpn, unsigned asid) const
+{
+    // Spread the entries of different spaces, which tend to use the same
+    // low virtual pages.
+    return (vpn ^ asid * 0x9E5) & tlbHashMask;
+}
+
+void
+MMU::LinkTLBSlot(unsigned slot)
+{
+    ASSERT(slot < tlbSize);
+    ASSERT(!tlbLinked[slot]);
+
+    unsigned bucket = TLBBucket(tlb[slot].virtualPage, tlbAsid[slot]);
+    tlbChain[slot] = tlbBucket[bucket];
+    tlbBucket[bucket] = slot;
+    tlbLinked[slot] = true;
+    if (tlb[slot].large) {
+        numLargeTLBEntries++;
+    }
+}
+
+void
+MMU::UnlinkTLBSlot(unsigned slot)
+{
+    ASSERT(slot < tlbSize);
+
+    if (!tlbLinked[slot]) {
+        return;
+    }
+
+    int *link = &tlbBucket[TLBBucket(tlb[slot].virtualPage, tlbAsid[slot])];
+    while (*link != (int) slot) {
+        ASSERT(*link != -1);
+        link = &tlbChain[*link];
+    }
+    *link = tlbChain[slot];
+    tlbChain[slot] = -1;
+    tlbLinked[slot] = false;
+    if (tlb[slot].large) {
+        numLargeTLBEntries--;
+    }
 }
 
 /// Read `size` (1, 2, or 4) bytes of virtual memory at `addr` into
@@ -100,13 +527,21 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
 {
     ASSERT(value != nullptr);
 
-    DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
-
     unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, false);
-    if (e != NO_EXCEPTION) {
-        return e;
+    bool fast = FastTranslate(addr, size, false, &physicalAddress);
+    if (!fast) {
+        DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
+
+        ExceptionType e = Translate(addr, &physicalAddress, size, false);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+    }
+#ifdef CACHE_MODEL
+    if (caches != nullptr) {
+        caches->Access(physicalAddress);
     }
+#endif
 
     int data;
     switch (size) {
@@ -129,7 +564,9 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
             ASSERT(false);
     }
 
-    DEBUG('a', "\tValue read: %8.8X\n", *value);
+    if (!fast) {
+        DEBUG('a', "\tValue read: %8.8X\n", *value);
+    }
     return NO_EXCEPTION;
 }
 
@@ -145,13 +582,21 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
 ExceptionType
 MMU::WriteMem(unsigned addr, unsigned size, int value)
 {
-    DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n", addr, size, value);
-
     unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, true);
-    if (e != NO_EXCEPTION) {
-        return e;
+    if (!FastTranslate(addr, size, true, &physicalAddress)) {
+        DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n",
+              addr, size, value);
+
+        ExceptionType e = Translate(addr, &physicalAddress, size, true);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+    }
+#ifdef CACHE_MODEL
+    if (caches != nullptr) {
+        caches->Access(physicalAddress);
     }
+#endif
 
     switch (size) {
         case 1:
@@ -173,45 +618,270 @@ MMU::WriteMem(unsigned addr, unsigned size, int value)
             ASSERT(false);
     }
 
+    // Self-modifying code: drop the stale decoded instruction, if any.
+    icache.InvalidateWord(physicalAddress);
+#ifdef BLOCK_TRANSLATION
+    blockCache.InvalidateWord(physicalAddress);
+#endif
+
+    return NO_EXCEPTION;
+}
+
+/// Read up to `count` bytes of virtual memory starting at `addr` into
+/// `buffer`.
+///
+/// Each page touched is translated once, and its bytes are copied in one
+/// go.  The bytes are copied in memory order, so the result is the same as
+/// reading them one at a time with `ReadMem`.
+///
+/// * `addr` is the virtual address to read from.
+/// * `buffer` is the place to copy the data to.
+/// * `count` is the maximum number of bytes to copy.
+/// * `stopAtNul` tells whether to stop after copying a null byte.
+/// * `copied` is the place to store the number of bytes copied.
+ExceptionType
+MMU::ReadBuffer(unsigned addr, char *buffer, unsigned count, bool stopAtNul,
+                unsigned *copied)
+{
+    ASSERT(buffer != nullptr);
+    ASSERT(copied != nullptr);
+
+    DEBUG('a', "Reading %u bytes from VA 0x%X\n", count, addr);
+
+    *copied = 0;
+    while (*copied < count) {
+        unsigned virtAddr = addr + *copied;
+        unsigned physicalAddress;
+        ExceptionType e = Translate(virtAddr, &physicalAddress, 1, false);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+
+        unsigned chunk = PAGE_SIZE - virtAddr % PAGE_SIZE;
+        if (chunk > count - *copied) {
+            chunk = count - *copied;
+        }
+        const char *source = &mainMemory[physicalAddress];
+        if (stopAtNul) {
+            const char *nul = (const char *) memchr(source, '\0', chunk);
+            if (nul != nullptr) {
+                chunk = nul - source + 1;
+                memcpy(buffer + *copied, source, chunk);
+                *copied += chunk;
+                break;
+            }
+        }
+        memcpy(buffer + *copied, source, chunk);
+        *copied += chunk;
+    }
+    return NO_EXCEPTION;
+}
+
+/// Write `count` bytes from `buffer` into virtual memory starting at
+/// `addr`.
+///
+/// Like `ReadBuffer`, each page is translated once.  Cached decoded
+/// instructions of the words written to are dropped, as in `WriteMem`.
+///
+/// * `addr` is the virtual address to write to.
+/// * `buffer` holds the data to be written.
+/// * `count` is the number of bytes to copy.
+/// * `copied` is the place to store the number of bytes copied.
+ExceptionType
+MMU::WriteBuffer(unsigned addr, const char *buffer, unsigned count,
+                 unsigned *copied)
+{
+    ASSERT(buffer != nullptr);
+    ASSERT(copied != nullptr);
+
+    DEBUG('a', "Writing %u bytes to VA 0x%X\n", count, addr);
+
+    *copied = 0;
+    while (*copied < count) {
+        unsigned virtAddr = addr + *copied;
+        unsigned physicalAddress;
+        ExceptionType e = Translate(virtAddr, &physicalAddress, 1, true);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+
+        unsigned chunk = PAGE_SIZE - virtAddr % PAGE_SIZE;
+        if (chunk > count - *copied) {
+            chunk = count - *copied;
+        }
+        if (numWatchpoints > 0 && IsWatched(virtAddr, chunk)) {
+            watchHit     = true;
+            watchHitAddr = virtAddr;
+        }
+        memcpy(&mainMemory[physicalAddress], buffer + *copied, chunk);
+        *copied += chunk;
+
+        // Words only partially covered by the copy must go as well, so
+        // start at the word holding the first byte.
+        for (unsigned a = physicalAddress & ~3U;
+             a < physicalAddress + chunk; a += 4) {
+            icache.InvalidateWord(a);
+#ifdef BLOCK_TRANSLATION
+            blockCache.InvalidateWord(a);
+#endif
+        }
+    }
     return NO_EXCEPTION;
 }
 
 ExceptionType
-MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
+MMU::TranslateAddress(unsigned addr, bool writing, unsigned *physAddr)
+{
+    ASSERT(physAddr != nullptr);
+
+    // The kernel may write anywhere up to the end of the page.
+    ExceptionType e = Translate(addr, physAddr, 1, writing);
+    if (e == NO_EXCEPTION && writing && numWatchpoints > 0
+          && IsWatched(addr, PAGE_SIZE - addr % PAGE_SIZE)) {
+        watchHit     = true;
+        watchHitAddr = addr;
+    }
+    return e;
+}
+
+/// Fetch the instruction at virtual address `addr` and leave it decoded in
+/// `instr`.
+///
+/// Returns the exception raised by the translation, if any.
+///
+/// * `addr` is the virtual address of the instruction (the PC).
+/// * `instr` is the place to write the decoded instruction.
+ExceptionType
+MMU::FetchInstruction(unsigned addr, Instruction *instr)
+{
+    ASSERT(instr != nullptr);
+
+    unsigned physicalAddress;
+    if (!FastTranslate(addr, 4, false, &physicalAddress)) {
+        DEBUG('a', "Fetching VA 0x%X\n", addr);
+
+        ExceptionType e = Translate(addr, &physicalAddress, 4, false);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+    }
+#ifdef CACHE_MODEL
+    if (caches != nullptr) {
+        caches->Fetch(physicalAddress);
+    }
+#endif
+
+    const Instruction *cached = icache.Lookup(physicalAddress);
+    if (cached != nullptr) {
+        *instr = *cached;
+        return NO_EXCEPTION;
+    }
+
+    instr->value = WordToHost(*(unsigned *) &mainMemory[physicalAddress]);
+    instr->Decode();
+    icache.Insert(physicalAddress, instr);
+    return NO_EXCEPTION;
+}
+
+#ifdef BLOCK_TRANSLATION
+/// Translate the virtual address `addr` of an instruction and return, in
+/// `block`, the basic block starting at it.
+///
+/// Only the first instruction of the block goes through `Translate`; the
+/// block never crosses a page boundary, so the rest of it lives in the same
+/// frame.
+ExceptionType
+MMU::FetchBlock(unsigned addr, const BasicBlock **block)
+{
+    ASSERT(block != nullptr);
+
+    unsigned physicalAddress;
+    if (!FastTranslate(addr, 4, false, &physicalAddress)) {
+        DEBUG('a', "Fetching block at VA 0x%X\n", addr);
+
+        ExceptionType e = Translate(addr, &physicalAddress, 4, false);
+        if (e != NO_EXCEPTION) {
+            return e;
+        }
+    }
+
+    *block = blockCache.Find(mainMemory, physicalAddress);
+#ifdef CACHE_MODEL
+    // Every instruction of the block is taken to be fetched, as blocks
+    // only end at branches.
+    if (caches != nullptr) {
+        for (unsigned i = 0; i < (*block)->length; i++) {
+            caches->Fetch(physicalAddress + 4 * i);
+        }
+    }
+#endif
+    return NO_EXCEPTION;
+}
+
+bool
+MMU::IsBlockCurrent(unsigned frame, unsigned generation) const
+{
+    return blockCache.IsCurrent(frame, generation);
+}
+#endif
+
+void
+MMU::InvalidateFrame(unsigned frame)
+{
+    ASSERT(frame < numPhysPages);
+    icache.InvalidateFrame(frame);
+#ifdef BLOCK_TRANSLATION
+    blockCache.InvalidateFrame(frame);
+#endif
+}
+
+ExceptionType
+MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry)
 {
     ASSERT(entry != nullptr);
 
     if (tlb == nullptr) {
-        // Use a page table; `vpn` is an index in the table.
+        // Use a page table, through its directory.  Whether a page without
+        // a leaf is part of the address space is up to the kernel.
 
-        if (vpn >= pageTableSize) {
+        if (vpn >= PageTable::MAX_PAGES) {
             DEBUG_CONT('a', "virtual page # %u too large for"
                             " page table size %u!\n",
-                       vpn, pageTableSize);
+                       vpn, PageTable::MAX_PAGES);
             return ADDRESS_ERROR_EXCEPTION;
-        } else if (!pageTable[vpn].valid) {
-            DEBUG_CONT('a', "virtual page # %u too large for"
-                            " page table size %u!\n",
-                       vpn, pageTableSize);
+        }
+        TranslationEntry *e = pageTable->Find(vpn);
+        unsigned base = TranslationEntry::LargeBase(vpn);
+        if (base != vpn) {
+            // A large entry for the group takes the place of that of the
+            // page.
+            TranslationEntry *b = pageTable->Find(base);
+            if (b != nullptr && b->valid && b->large) {
+                e = b;
+            }
+        }
+        if (e == nullptr || !e->valid) {
+            DEBUG_CONT('a', "virtual page # %u not mapped!\n", vpn);
             return PAGE_FAULT_EXCEPTION;
         }
 
-        *entry = &pageTable[vpn];
+        *entry = e;
         return NO_EXCEPTION;
 
     } else {
-        // Use the TLB.
-
-        unsigned i;
-        for (i = 0; i < TLB_SIZE; i++) {
-            TranslationEntry *e = &tlb[i];
-            if (e->valid && e->virtualPage == vpn) {
-                *entry = e;  // FOUND!
-                return NO_EXCEPTION;
-            }
+        // Use the TLB, through its index.
+
+        int i = FindTLBSlot(vpn);
+        if (i != -1) {
+            *entry = &tlb[i];  // FOUND!
+            tlbLastUse[i] = ++tlbClock;
+            stats->tlbHits++;
+            return NO_EXCEPTION;
         }
 
         // Not found.
+        stats->tlbMisses++;
+        currentThread->usage.tlbMisses++;
         DEBUG_CONT('a', "no valid TLB entry found for this virtual page!\n");
         return PAGE_FAULT_EXCEPTION;  // Really, this is a TLB fault, the
                                       // page may be in memory, but not in
@@ -264,13 +934,18 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
         DEBUG_CONT('a', "%u mapped read-only!\n", virtAddr);
         return READ_ONLY_EXCEPTION;
     }
+    if (writing && numWatchpoints > 0 && IsWatched(virtAddr, size)) {
+        DEBUG_CONT('a', "%u watched, ", virtAddr);
+        watchHit     = true;
+        watchHitAddr = virtAddr;
+    }
 
-    unsigned pageFrame = entry->physicalPage;
+    unsigned pageFrame = entry->FrameOf(vpn);
 
     // If the `pageFrame` is too big, there is something really wrong!  An
     // invalid translation was loaded into the page table or TLB.
-    if (pageFrame >= NUM_PHYS_PAGES) {
-        DEBUG_CONT('a', "frame %u > %u!\n", pageFrame, NUM_PHYS_PAGES);
+    if (pageFrame >= numPhysPages) {
+        DEBUG_CONT('a', "frame %u > %u!\n", pageFrame, numPhysPages);
         return BUS_ERROR_EXCEPTION;
     }
 
@@ -281,7 +956,80 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
     }
 
     *physAddr = pageFrame * PAGE_SIZE + offset;
-    ASSERT(*physAddr >= 0 && *physAddr + size <= MEMORY_SIZE);
+    ASSERT(*physAddr >= 0
+             && *physAddr + size <= numPhysPages * PAGE_SIZE);
     DEBUG_CONT('a', "physical address 0x%X\n", *physAddr);
+
+    CacheTranslation(vpn, entry);
     return NO_EXCEPTION;
+}
+
+/// Translate `virtAddr` using the cache of recent translations.
+///
+/// Every condition under which the cached translation could differ from
+/// the one `Translate` would compute is checked, so on a miss (return
+/// value false) the caller simply falls back to `Translate`, which also
+/// takes care of raising any exception.
+bool
+MMU::FastTranslate(unsigned virtAddr, unsigned size, bool writing,
+                   unsigned *physAddr)
+{
+    if (!fastPathEnabled || virtAddr & (size - 1)) {
+        return false;
+    }
+    if (tlb == nullptr && pageTable != fastPathTable) {
+        return false;
+    }
+
+    unsigned vpn = virtAddr / PAGE_SIZE;
+    const FastTranslation *f = &fastPath[vpn & (FAST_PATH_SIZE - 1)];
+    if (f->vpn != vpn) {
+        return false;
+    }
+
+    TranslationEntry *entry = f->entry;
+    if (!entry->valid || entry->FrameOf(vpn) != f->frame
+          || (writing && entry->readOnly)) {
+        return false;
+    }
+
+    entry->use = true;
+    if (writing) {
+        entry->dirty = true;
+    }
+    if (f->tlbSlot >= 0) {
+        tlbLastUse[f->tlbSlot] = ++tlbClock;
+        stats->tlbHits++;
+    }
+
+    *physAddr = f->frame * PAGE_SIZE + virtAddr % PAGE_SIZE;
+    return true;
+}
+
+void
+MMU::CacheTranslation(unsigned vpn, TranslationEntry *entry)
+{
+    ASSERT(entry != nullptr);
+
+    if (tlb == nullptr && pageTable != fastPathTable) {
+        FlushFastPath();
+        fastPathTable = pageTable;
+    }
+    if (numWatchpoints > 0 && IsWatched(vpn * PAGE_SIZE, PAGE_SIZE)) {
+        return;
+    }
+
+    FastTranslation *f = &fastPath[vpn & (FAST_PATH_SIZE - 1)];
+    f->vpn     = vpn;
+    f->frame   = entry->FrameOf(vpn);
+    f->entry   = entry;
+    f->tlbSlot = tlb == nullptr ? -1 : entry - tlb;
+}
+
+void
+MMU::FlushFastPath()
+{
+    for (unsigned i = 0; i < FAST_PATH_SIZE; i++) {
+        fastPath[i].vpn = FastTranslation::INVALID_VPN;
+    }
 }
\ No newline at end of file
@@ -9,8 +9,12 @@
 #define NACHOS_MACHINE_MMU__HH
 
 
+#include "block_cache.hh"
+#include "cache_model.hh"
 #include "exception_type.hh"
 #include "disk.hh"
+#include "instruction_cache.hh"
+#include "page_table.hh"
 #include "translation_entry.hh"
 
 
@@ -19,21 +23,71 @@
 const unsigned PAGE_SIZE = SECTOR_SIZE;  ///< Set the page size equal to the
                                          ///< disk sector size, for
                                          ///< simplicity.
-const unsigned NUM_PHYS_PAGES = 128;
-const unsigned MEMORY_SIZE = NUM_PHYS_PAGES * PAGE_SIZE;
 
-/// Number of entries in the TLB, if one is present.
+/// Default number of physical pages.  The actual number, `numPhysPages`,
+/// can be chosen when Nachos starts, before the machine is made.
+const unsigned DEFAULT_NUM_PHYS_PAGES = 128;
+extern unsigned numPhysPages;
+
+/// Default number of entries in the TLB, if one is present.
 ///
-/// If there is a TLB, it will be small compared to page tables.
+/// If there is a TLB, it will be small compared to page tables.  The actual
+/// size can be chosen when the machine is started.
 const unsigned TLB_SIZE = 4;
 
+/// Number of address space identifiers (ASIDs) that TLB entries can be
+/// tagged with.  Entries loaded while `NO_ASID` is current belong to no
+/// particular address space, and must be flushed by the kernel whenever
+/// it switches between two spaces that use it.
+const unsigned NUM_ASIDS = 64;
+const unsigned NO_ASID = NUM_ASIDS;
+
+/// Replacement policies for the TLB, used by `MMU::LoadTLBEntry` to choose
+/// the entry to replace within a set once all of them are valid.
+enum TLBPolicy {
+    TLB_FIFO,    ///< The oldest loaded entry.
+    TLB_LRU,     ///< The least recently referenced entry.
+    TLB_RANDOM,  ///< Any entry, at random.
+    TLB_CLOCK,   ///< Second chance, using the `use` bit.
+    NUM_TLB_POLICIES
+};
+
+/// Parse a policy name (`fifo`, `lru`, `random` or `clock`).  Return false
+/// if the name is not known.
+bool ParseTLBPolicy(const char *name, TLBPolicy *policy);
+
+/// Return the name of a policy.
+const char *TLBPolicyToString(TLBPolicy policy);
+
+
+/// A recently used translation, kept by the MMU so that later accesses to
+/// the same virtual page can skip most of the work of `MMU::Translate`.
+class FastTranslation {
+public:
+    unsigned vpn;             ///< Virtual page, or `INVALID_VPN`.
+    unsigned frame;           ///< Its frame at the time it was cached.
+    TranslationEntry *entry;  ///< The entry it was translated with.
+    int tlbSlot;              ///< Slot of `entry` in the TLB, or -1 if it
+                              ///< belongs to a page table.
+
+    static const unsigned INVALID_VPN = (unsigned) -1;
+};
 
 /// This class simulates an MMU (memory management unit) that can use either
 /// page tables or a TLB.
 class MMU {
 public:
-    // Initialize the MMU subsystem.
-    MMU();
+    /// Initialize the MMU subsystem.
+    ///
+    /// If a TLB is used, it has `tlbSize` entries, grouped in sets of
+    /// `tlbWays` entries each (0 means fully associative), and entries are
+    /// replaced according to `tlbPolicy`.
+    ///
+    /// If `memory` is given, it is the physical memory, shared with the
+    /// MMUs of other CPUs and owned by one of them; otherwise the MMU
+    /// allocates its own.
+    MMU(unsigned tlbSize = TLB_SIZE, unsigned tlbWays = 0,
+        TLBPolicy tlbPolicy = TLB_FIFO, char *memory = nullptr);
 
     // Deallocate data structures.
     ~MMU();
@@ -45,9 +99,135 @@ public:
 
     ExceptionType WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Copy `count` bytes between virtual memory at `addr` and a kernel
+    /// buffer, translating once per page.  If `stopAtNul` is set, reading
+    /// also stops after the first null byte.
+    ///
+    /// `*copied` is always set to the number of bytes transferred; if an
+    /// exception is returned, it was raised at `addr + *copied`, and the
+    /// copy can be resumed from there once it is handled.
+    ExceptionType ReadBuffer(unsigned addr, char *buffer, unsigned count,
+                             bool stopAtNul, unsigned *copied);
+
+    ExceptionType WriteBuffer(unsigned addr, const char *buffer,
+                              unsigned count, unsigned *copied);
+
+    /// Translate `addr` as a one-byte access would, for the kernel to
+    /// reach user memory in place, through `mainMemory[*physAddr]`.
+    ///
+    /// The translation holds up to the end of the page.  After writing to
+    /// the frame, the kernel must call `InvalidateFrame`.
+    ExceptionType TranslateAddress(unsigned addr, bool writing,
+                                   unsigned *physAddr);
+
+    /// Fetch and decode the instruction at virtual address `addr`.
+    ///
+    /// Decoded instructions are kept in a cache indexed by physical
+    /// address, so only the translation is performed when the same word is
+    /// fetched again.
+    ExceptionType FetchInstruction(unsigned addr, Instruction *instr);
+
+#ifdef BLOCK_TRANSLATION
+    /// Translate `addr` and return the basic block that starts there.
+    ExceptionType FetchBlock(unsigned addr, const BasicBlock **block);
+
+    /// Whether a block fetched earlier may still be executed.
+    bool IsBlockCurrent(unsigned frame, unsigned generation) const;
+#endif
+
+    /// Forget every cached fast translation.
+    ///
+    /// The MMU notices by itself most changes that make a cached
+    /// translation stale: replaced or invalidated TLB entries, a different
+    /// page table, entries becoming invalid or read-only, or pointing to a
+    /// different frame.  This is only needed if the kernel reuses a page
+    /// table entry for another virtual page.
+    void FlushFastPath();
+
+    /// Tell the MMU that the contents of physical frame `frame` were
+    /// changed by the kernel (or that the frame was released), so that any
+    /// instruction decoded from it is discarded.
+    void InvalidateFrame(unsigned frame);
+
     void PrintTLB() const;
 
-    void LoadTLBEntry(TranslationEntry entry);
+    /// Load `entry` into the TLB, replacing some other entry.
+    ///
+    /// The kernel must install translations through this method (and drop
+    /// them through `InvalidateTLB`) rather than by filling `tlb` directly,
+    /// so that the TLB index stays consistent.
+    ///
+    /// If `evicted` is not null, the replaced entry is copied there, so
+    /// that its `use` and `dirty` bits can be written back; it is marked
+    /// invalid if the slot held no valid entry.
+    void LoadTLBEntry(TranslationEntry entry,
+                      TranslationEntry *evicted = nullptr);
+
+    /// Merge the `use` and `dirty` bits of every TLB entry that maps
+    /// `frame` into `entry`, and clear them in the TLB, so that `entry`
+    /// becomes the only record of them.  The bits of a large entry are
+    /// those of its whole group, so they go to the first of its frames
+    /// asked for.
+    void CollectTLBBits(unsigned frame, TranslationEntry *entry);
+
+    /// Invalidate every TLB entry that maps `frame`, whatever its ASID,
+    /// large entries included.
+    void InvalidateTLBFrame(unsigned frame);
+
+    /// Invalidate every entry in the TLB.
+    void InvalidateTLB();
+
+    /// Select the address space identifier of the running address space.
+    ///
+    /// Lookups only match TLB entries loaded under the same identifier,
+    /// so entries of several address spaces can stay in the TLB across
+    /// context switches.
+    void SetASID(unsigned asid);
+
+    /// Invalidate every TLB entry loaded under `asid`, for instance when
+    /// the identifier is given to a new address space.
+    void InvalidateASID(unsigned asid);
+
+    /// Number of entries in the TLB (zero if there is none).
+    unsigned GetTLBSize() const;
+
+    /// Return the identifier entry `slot` of the TLB was loaded under.
+    unsigned GetTLBEntryASID(unsigned slot) const;
+
+    /// Return whether the TLB holds a valid entry for `vpn` under the
+    /// current identifier, as the MIPS `tlbp` instruction tells; a large
+    /// entry counts for every page it maps.  Neither the statistics nor the
+    /// replacement policy take notice.
+    bool ProbeTLB(unsigned vpn) const;
+
+    /// Watchpoints kept at most.
+    static const unsigned MAX_WATCHPOINTS = 8;
+
+    /// Watch for writes to the `size` bytes of virtual memory at `addr`.
+    /// Return false if there is no room for another watchpoint.
+    ///
+    /// Pages holding watched bytes are protected: their translations are
+    /// not cached, so that every write to them is checked by `Translate`,
+    /// while writes to other pages are not slowed down at all.  A write to
+    /// watched bytes is let through, and recorded for `TakeWatchHit`.
+    bool SetWatchpoint(unsigned addr, unsigned size);
+
+    /// Return false if no watchpoint starts at `addr`.
+    bool ClearWatchpoint(unsigned addr);
+
+    unsigned GetNumWatchpoints() const;
+
+    void GetWatchpoint(unsigned i, unsigned *addr, unsigned *size) const;
+
+    /// Whether watched bytes were written since the last `TakeWatchHit`.
+    bool HasWatchHit() const
+    {
+        return watchHit;
+    }
+
+    /// Forget the last write to watched bytes, and return the address
+    /// written.
+    unsigned TakeWatchHit();
 
     /// Data structures -- all of these are accessible to Nachos kernel code.
     /// “Public” for convenience.
@@ -81,14 +261,18 @@ public:
     TranslationEntry *tlb;  ///< This pointer should be considered
                             ///< “read-only” to Nachos kernel code.
 
-    TranslationEntry *pageTable;
-    unsigned pageTableSize;
+    PageTable *pageTable;
 
 private:
 
+    /// Whether `mainMemory` is to be deleted along with the MMU.
+    bool ownsMemory;
+
     /// Retrieve a page entry either from a page table or the TLB.
+    ///
+    /// TLB lookups are accounted in `stats->tlbHits` and `tlbMisses`.
     ExceptionType RetrievePageEntry(unsigned vpn,
-                                    TranslationEntry **entry) const;
+                                    TranslationEntry **entry);
 
     /// Translate an address, and check for alignment.
     ///
@@ -98,7 +282,101 @@ private:
     ExceptionType Translate(unsigned virtAddr, unsigned *physAddr,
                             unsigned size, bool writing);
 
-    int tlbFIFO = 0;
+    /// TLB geometry: `tlbSets` sets of `tlbWays` entries each.  The set
+    /// of a virtual page is `vpn % tlbSets`.
+    unsigned tlbSize;
+    unsigned tlbWays;
+    unsigned tlbSets;
+    TLBPolicy tlbPolicy;
+
+    /// Per-set position of the FIFO or clock hand, relative to the first
+    /// entry of the set.
+    unsigned *tlbHand;
+
+    /// For LRU: the value of `tlbClock` at the last reference of each
+    /// entry.
+    unsigned long *tlbLastUse;
+    unsigned long tlbClock;
+
+    /// Try to translate `virtAddr` with a cached translation.  Return
+    /// false if the full `Translate` is needed; `use` and `dirty` bits are
+    /// set as `Translate` would.
+    bool FastTranslate(unsigned virtAddr, unsigned size, bool writing,
+                       unsigned *physAddr);
+
+    /// Remember the translation of `vpn` through `entry`, unless the page
+    /// is protected by a watchpoint.
+    void CacheTranslation(unsigned vpn, TranslationEntry *entry);
+
+    /// Whether a watchpoint covers any byte from `addr` to `addr + size`.
+    bool IsWatched(unsigned addr, unsigned size) const;
+
+    /// Watched ranges, and the last write to one of them.
+    unsigned watchStart[MAX_WATCHPOINTS];
+    unsigned watchSize[MAX_WATCHPOINTS];
+    unsigned numWatchpoints;
+    bool watchHit;
+    unsigned watchHitAddr;
+
+    /// Direct-mapped cache of translations, indexed by `vpn &
+    /// (FAST_PATH_SIZE - 1)`.
+    static const unsigned FAST_PATH_SIZE = 64;
+    FastTranslation fastPath[FAST_PATH_SIZE];
+
+    /// Page table the cached translations refer to, if any.
+    PageTable *fastPathTable;
+
+    /// Fast translations bypass the `DEBUG` messages of `Translate`, so
+    /// they are turned off while those messages are enabled.
+    bool fastPathEnabled;
+
+    /// ASID of the running address space, and of every TLB entry.
+    unsigned currentAsid;
+    unsigned *tlbAsid;
+
+    /// Bucket of the TLB index for a virtual page of an address space.
+    unsigned TLBBucket(unsigned vpn, unsigned asid) const;
+
+    /// Choose the entry of `set` to be replaced.
+    unsigned ChooseTLBVictim(unsigned set);
+
+    /// Index of the TLB by virtual page number, so that a lookup does not
+    /// have to scan every entry.
+    ///
+    /// `tlbBucket[TLBBucket(vpn, asid)]` holds the first TLB slot whose
+    /// virtual page hashes there, and `tlbChain` links slots within the
+    /// same bucket; -1 ends a chain.  Slots are linked as long as they hold
+    /// an entry loaded with `LoadTLBEntry`, valid or not.
+    unsigned tlbHashMask;
+    int *tlbBucket;
+    int *tlbChain;
+    bool *tlbLinked;
+
+    /// Add or remove a TLB slot from the index.
+    void LinkTLBSlot(unsigned slot);
+    void UnlinkTLBSlot(unsigned slot);
+
+    /// Return the slot of the valid entry mapping `vpn` under the current
+    /// identifier, or -1.  Large entries are only looked for when the page
+    /// has none of its own, and at least one is linked.
+    int FindTLBSlot(unsigned vpn) const;
+
+    /// Number of large entries linked in the index.
+    unsigned numLargeTLBEntries;
+
+    /// Predecoded instructions, indexed by physical address.
+    InstructionCache icache;
+
+#ifdef BLOCK_TRANSLATION
+    /// Translated basic blocks, indexed by physical address.
+    BlockCache blockCache;
+#endif
+
+#ifdef CACHE_MODEL
+    /// Memory caches user accesses go through, or null if none were
+    /// chosen.
+    CacheHierarchy *caches;
+#endif
 };
 
 
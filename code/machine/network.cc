@@ -15,6 +15,25 @@
 #include <string.h>
 
 
+/// Longest wait between two looks for an incoming packet, once the link is
+/// quiet.  Kept well under the time a connection waits for an ACK.
+static const unsigned long MAX_POLL_INTERVAL = 16 * NETWORK_TIME;
+
+/// Put in `name`, of `size` bytes, the name of the socket by which machine
+/// `host` gets packets sent to `addr`: its own socket, or its alias as
+/// a member of a group.  A broadcast reaches every machine's own socket.
+static void
+SocketName(NetworkAddress addr, NetworkAddress host, char *name,
+           unsigned size)
+{
+    if (IsGroupAddress(addr)) {
+        snprintf(name, size, "GROUP_%d_%u",
+                 GroupAddress(0) - addr, (unsigned) host);
+    } else {
+        snprintf(name, size, "SOCKET_%u", (unsigned) host);
+    }
+}
+
 /// Dummy functions because C++ cannot call member functions indirectly.
 
 static void
@@ -38,12 +57,14 @@ NetworkSendDone(void *arg)
 /// * `addr` is used to generate the socket name.
 /// * `reliability` says whether we drop packets to emulate unreliable links.
 /// * `readAvail`, `writeDone`, `callArg` -- analogous to console.
+/// * `queueSize` is how many packets can be waiting to be received.
 Network::Network(NetworkAddress addr, double reliability,
                  VoidFunctionPtr readAvail, VoidFunctionPtr writeDone,
-                 void *callArg)
+                 void *callArg, unsigned queueSize_)
 {
     ASSERT(readAvail != nullptr);
     ASSERT(writeDone != nullptr);
+    ASSERT(queueSize_ > 0);
 
     ident = addr;
     chanceToWork = (reliability < 0) ? 0 :
@@ -55,57 +76,172 @@ Network::Network(NetworkAddress addr, double reliability,
     readHandler = readAvail;
     handlerArg = callArg;
     sendBusy = false;
-    inHdr.length = 0;
+    queueSize  = queueSize_;
+    inQueue    = new InPacket [queueSize];
+    queueHead  = 0;
+    queueCount = 0;
 
     sock = SystemDep::OpenSocket();
-    snprintf(sockName, sizeof sockName, "SOCKET_%u", (unsigned) addr);
+    SocketName(addr, addr, sockName, sizeof sockName);
     SystemDep::AssignNameToSocket(sockName, sock);
       // Bind socket to a filename in the current directory.
+    for (unsigned i = 0; i < MAX_GROUPS; i++) {
+        joined[i] = false;
+    }
 
     // Start polling for incoming packets.
-    interrupt->Schedule(NetworkReadPoll, this,
-                        NETWORK_TIME, NETWORK_RECV_INT);
+    pollInterval = NETWORK_TIME;
+    nextPoll = 0;
+    SchedulePoll(pollInterval);
 }
 
 Network::~Network()
 {
+    for (unsigned i = 0; i < MAX_GROUPS; i++) {
+        LeaveGroup(GroupAddress(i));
+    }
     SystemDep::CloseSocket(sock);
     SystemDep::DeAssignNameToSocket(sockName);
+    delete [] inQueue;
 }
 
-/// If a packet is already buffered, we simply delay reading the incoming
-/// packet.  In real life, the incoming packet might be dropped if we cannot
-/// read it in time.
+void
+Network::JoinGroup(NetworkAddress group)
+{
+    ASSERT(IsGroupAddress(group));
+
+    unsigned g = GroupAddress(0) - group;
+    if (!joined[g]) {
+        char alias[32];
+        SocketName(group, ident, alias, sizeof alias);
+        SystemDep::AliasSocketName(sockName, alias);
+        joined[g] = true;
+    }
+}
+
+void
+Network::LeaveGroup(NetworkAddress group)
+{
+    ASSERT(IsGroupAddress(group));
+
+    unsigned g = GroupAddress(0) - group;
+    if (joined[g]) {
+        char alias[32];
+        SocketName(group, ident, alias, sizeof alias);
+        SystemDep::DeAssignNameToSocket(alias);
+        joined[g] = false;
+    }
+}
+
+bool
+Network::IsAddressedBy(NetworkAddress addr) const
+{
+    return addr == ident || addr == BROADCAST_ADDRESS
+           || (IsGroupAddress(addr) && joined[GroupAddress(0) - addr]);
+}
+
+void
+Network::SchedulePoll(unsigned long fromNow)
+{
+    nextPoll = stats->totalTicks + fromNow;
+    interrupt->Schedule(NetworkReadPoll, this, fromNow, NETWORK_RECV_INT);
+}
+
+/// If the queue of packets is full, we simply delay reading the incoming
+/// packets.  In real life, they might be dropped if we cannot read them in
+/// time.
+///
+/// Every packet waiting on the socket is read in, as long as there is room,
+/// and the user is told once for all of them, so that a burst does not take
+/// an interrupt for each packet.
+///
+/// While no packet arrives, polls grow further apart, so that a quiet link
+/// costs few interrupts.  An idle machine loses nothing by it: polling
+/// then waits on the host for the socket to become ready, and the clock
+/// jumps to the next poll anyway.
 void
 Network::CheckPktAvail()
 {
-    // Schedule the next time to poll for a packet.
-    interrupt->Schedule(NetworkReadPoll, this,
-                        NETWORK_TIME, NETWORK_RECV_INT);
+    // A poll superseded by an earlier one finds the next poll to heed at
+    // most an interval ahead.  One further ahead than that is from before
+    // the clock was restarted.
+    if (stats->totalTicks != nextPoll
+          && nextPoll <= stats->totalTicks + MAX_POLL_INTERVAL) {
+        return;
+    }
 
-    if (inHdr.length != 0) {  // Do nothing if packet is already buffered.
+    stats->numNetworkPolls++;
+    if (queueCount == queueSize) {  // Do nothing if there is no room.
+        SchedulePoll(pollInterval);
         return;
     }
-    if (!SystemDep::PollSocket(sock)) {  // Do nothing if no packet to read.
+    InPacket *p = &inQueue[(queueHead + queueCount) % queueSize];
+    if (!ReadPacket(p)) {  // Do nothing if no packet to read, but wait
+                           // longer to look again.
+        if (pollInterval < MAX_POLL_INTERVAL) {
+            pollInterval *= 2;
+        }
+        SchedulePoll(pollInterval);
         return;
     }
+    pollInterval = NETWORK_TIME;
+    SchedulePoll(pollInterval);
 
-    // Otherwise, read packet in.
-    char *buffer = new char [MAX_WIRE_SIZE];
-    SystemDep::ReadFromSocket(sock, buffer, MAX_WIRE_SIZE);
+    // Otherwise, read packets in, the header and data of each straight
+    // where they are kept.  A packet for a group left since it was sent is
+    // dropped.
+    do {
+        if (!IsAddressedBy(p->hdr.to)) {
+            ASSERT(IsGroupAddress(p->hdr.to));
+            continue;
+        }
+        queueCount++;
 
-    // Divide packet into header and data.
-    inHdr = *(PacketHeader *) buffer;
-    ASSERT(inHdr.to == ident && inHdr.length <= MAX_PACKET_SIZE);
-    memcpy(inbox, buffer + sizeof (PacketHeader), inHdr.length);
-    delete [] buffer;
+        DEBUG('n', "Network received packet from %d, length %u...\n",
+              (int) p->hdr.from, p->hdr.length);
+        stats->numPacketsRecvd++;
+        p = &inQueue[(queueHead + queueCount) % queueSize];
+    } while (queueCount < queueSize && ReadPacket(p));
 
-    DEBUG('n', "Network received packet from %d, length %u...\n",
-          (int) inHdr.from, inHdr.length);
-    stats->numPacketsRecvd++;
+    // Tell post office that packets have arrived.
+    if (queueCount > 0) {
+        (*readHandler)(handlerArg);
+    }
+}
+
+/// A replayed packet is logged as its header followed by its data.
+bool
+Network::ReadPacket(InPacket *p)
+{
+    ASSERT(p != nullptr);
+
+    if (inputLog != nullptr && inputLog->IsReplaying()) {
+        char packet[sizeof p->hdr + MAX_PACKET_SIZE];
+        unsigned length;
+        if (!inputLog->Replay(INPUT_PACKET, packet, sizeof packet, &length)) {
+            return false;
+        }
+        ASSERT(length >= sizeof p->hdr);
+        memcpy(&p->hdr, packet, sizeof p->hdr);
+        ASSERT(length == sizeof p->hdr + p->hdr.length);
+        memcpy(p->data, packet + sizeof p->hdr, p->hdr.length);
+        return true;
+    }
 
-    // Tell post office that the packet has arrived.
-    (*readHandler)(handlerArg);
+    if (!SystemDep::PollSocket(sock)) {
+        return false;
+    }
+    size_t size = SystemDep::ReadFromSocket(sock, (char *) &p->hdr,
+                                            sizeof p->hdr,
+                                            p->data, sizeof p->data);
+    ASSERT(p->hdr.length > 0 && size == sizeof p->hdr + p->hdr.length);
+    if (inputLog != nullptr) {
+        char packet[sizeof p->hdr + MAX_PACKET_SIZE];
+        memcpy(packet, &p->hdr, sizeof p->hdr);
+        memcpy(packet + sizeof p->hdr, p->data, p->hdr.length);
+        inputLog->Record(INPUT_PACKET, packet, size);
+    }
+    return true;
 }
 
 /// Notify user that another packet can be sent.
@@ -117,52 +253,75 @@ Network::SendDone()
     (*writeHandler)(handlerArg);
 }
 
-/// Send a packet by concatenating hdr and data, and schedule an interrupt to
-/// tell the user when the next packet can be sent.
+/// Send a packet made of `hdr` and `data`, and schedule an interrupt to tell
+/// the user when the next packet can be sent.
+///
+/// The packet goes on the socket as long as it is, rather than padded out to
+/// `MAX_WIRE_SIZE`, gathered from `hdr` and `data` without copying them.
 ///
-/// Note we always pad out a packet to `MAX_WIRE_SIZE` before putting it into
-/// the socket, because it is simpler at the receive end.
+/// A packet to a broadcast or multicast address is sent to the socket of
+/// every other machine by that address, whoever is there; it takes the
+/// network as long as any other packet.
 void
 Network::Send(PacketHeader hdr, const char *data)
 {
     ASSERT(data != nullptr);
-
-    char toName[32];
-
-    snprintf(toName, sizeof toName, "SOCKET_%u", (unsigned) hdr.to);
-
     ASSERT(!sendBusy && hdr.length > 0
            && hdr.length <= MAX_PACKET_SIZE && hdr.from == ident);
-    DEBUG('n', "Sending to addr %u, %u bytes... ", hdr.to, hdr.length);
+    DEBUG('n', "Sending to addr %d, %u bytes... ", hdr.to, hdr.length);
 
     interrupt->Schedule(NetworkSendDone, this,
                         NETWORK_TIME, NETWORK_SEND_INT);
 
-    // Emulate a lost packet.
-    if (SystemDep::Random() % 100 >= chanceToWork * 100) {
-        DEBUG('n', "oops, lost it!\n");
-        return;
+    // An answer may come soon: look for it without waiting out a long
+    // interval.
+    pollInterval = NETWORK_TIME;
+    if (nextPoll > stats->totalTicks + pollInterval) {
+        SchedulePoll(pollInterval);
     }
 
-    // Concatenate `hdr` and `data` into a single buffer, and send it out.
-    char *buffer = new char [MAX_WIRE_SIZE];
-    *(PacketHeader *) buffer = hdr;
-    memcpy(buffer + sizeof (PacketHeader), data, hdr.length);
-    SystemDep::SendToSocket(sock, buffer, MAX_WIRE_SIZE, toName);
-    delete [] buffer;
+    bool fanOut = hdr.to < 0;
+    ASSERT(!fanOut || hdr.to == BROADCAST_ADDRESS || IsGroupAddress(hdr.to));
+    unsigned first = fanOut ? 0 : hdr.to;
+    unsigned last  = fanOut ? MAX_MACHINES - 1 : hdr.to;
+    for (unsigned host = first; host <= last; host++) {
+        if (fanOut && host == (unsigned) ident) {
+            continue;
+        }
+
+        // Emulate a lost packet.
+        if (SystemDep::Random() % 100 >= chanceToWork * 100) {
+            DEBUG('n', "oops, lost it for %u! ", host);
+            continue;
+        }
+
+        char toName[32];
+        SocketName(hdr.to, host, toName, sizeof toName);
+        if (!SystemDep::SendToSocket(sock, (const char *) &hdr, sizeof hdr,
+                                     data, hdr.length, toName)
+              && !fanOut) {
+            DEBUG('n', "nobody there, lost it! ");
+        }
+    }
+    DEBUG('n', "\n");
 }
 
-// Read a packet, if one is buffered.
+/// Read the oldest packet, if one is buffered.
 PacketHeader
 Network::Receive(char *data)
 {
     ASSERT(data != nullptr);
 
-    PacketHeader hdr = inHdr;
-
-    inHdr.length = 0;
-    if (hdr.length != 0) {
-        memmove(data, inbox, hdr.length);
+    PacketHeader hdr;
+    if (queueCount == 0) {
+        hdr.length = 0;
+        return hdr;
     }
+
+    InPacket *p = &inQueue[queueHead];
+    queueHead = (queueHead + 1) % queueSize;
+    queueCount--;
+    hdr = p->hdr;
+    memcpy(data, p->data, hdr.length);
     return hdr;
 }
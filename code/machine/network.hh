@@ -25,6 +25,32 @@
 /// This machine's ID is given on the command line.
 typedef int NetworkAddress;
 
+/// Broadcasts reach every machine with an ID below this.
+const unsigned MAX_MACHINES = 32;
+
+/// Multicast groups are numbered below this.
+const unsigned MAX_GROUPS = 16;
+
+/// Address for a packet to every other machine.
+const NetworkAddress BROADCAST_ADDRESS = -1;
+
+/// Address for a packet to every other machine in multicast group `group`.
+/// Such addresses are below `BROADCAST_ADDRESS`, so they are no machine's.
+inline NetworkAddress
+GroupAddress(unsigned group)
+{
+    ASSERT(group < MAX_GROUPS);
+    return -2 - (NetworkAddress) group;
+}
+
+/// Whether `addr` is that of a multicast group.
+inline bool
+IsGroupAddress(NetworkAddress addr)
+{
+    return addr < BROADCAST_ADDRESS
+           && addr >= GroupAddress(MAX_GROUPS - 1);
+}
+
 /// The following class defines the network packet header.
 ///
 /// The packet header is prepended to the data payload by the `Network`
@@ -58,13 +84,22 @@ const unsigned MAX_PACKET_SIZE = MAX_WIRE_SIZE - sizeof (PacketHeader);
 /// a packet.  Note that you can change the seed for the random number
 /// generator, by changing the arguments to `RandomInit` in `Initialize`.
 /// The random number generator is used to choose which packets to drop.
+///
+/// A packet can also go to `BROADCAST_ADDRESS`, or to the `GroupAddress` of
+/// a multicast group that machines joined, and then reaches every other
+/// machine addressed, taking one send rather than one per machine.  Each
+/// copy is dropped, or not, on its own.  The sender never gets a copy.
 class Network {
 public:
 
-    /// Allocate and initialize network driver.
+    /// Packets kept on arrival unless told otherwise.
+    static const unsigned DEFAULT_QUEUE_SIZE = 16;
+
+    /// Allocate and initialize network driver, keeping up to `queueSize`
+    /// packets that arrived and were not received yet.
     Network(NetworkAddress addr, double reliability,
             VoidFunctionPtr readAvail, VoidFunctionPtr writeDone,
-            void *callArg);
+            void *callArg, unsigned queueSize = DEFAULT_QUEUE_SIZE);
 
     /// De-allocate the network driver data.
     ~Network();
@@ -82,10 +117,21 @@ public:
 
     /// Poll the network for incoming messages.
     ///
-    /// If there is a packet waiting, copy the packet into `data` and return
+    /// If there is a packet waiting, copy the oldest into `data` and return
     /// the header.  If no packet is waiting, return a header with length 0.
+    ///
+    /// `readHandler` is invoked once for each batch of packets that arrive
+    /// together, so it should take every packet waiting.
     PacketHeader Receive(char *data);
 
+    /// Join or leave the multicast group with address `group`, so that
+    /// packets sent to it arrive here, or stop arriving.
+    void JoinGroup(NetworkAddress group);
+    void LeaveGroup(NetworkAddress group);
+
+    /// Whether packets sent to `addr` arrive here.
+    bool IsAddressedBy(NetworkAddress addr) const;
+
     /// Interrupt handler, called when message is sent.
     void SendDone();
 
@@ -106,6 +152,10 @@ private:
     /// File name corresponding to UNIX socket.
     char sockName[32];
 
+    /// Groups joined.  Membership is an alias of the socket, named after
+    /// the group and the machine, so that senders find members by name.
+    bool joined[MAX_GROUPS];
+
     /// Interrupt handler, signalling next packet can be sent.
     VoidFunctionPtr writeHandler;
 
@@ -118,14 +168,37 @@ private:
     /// Packet is being sent.
     bool sendBusy;
 
-    /// Packet has arrived, can be pulled off of network.
-    bool packetAvail;
-
-    /// Information about arrived packet.
-    PacketHeader inHdr;
-
-    /// Data for arrived packet.
-    char inbox[MAX_PACKET_SIZE];
+    /// A packet that arrived.
+    class InPacket {
+    public:
+        PacketHeader hdr;
+        char data[MAX_PACKET_SIZE];
+    };
+
+    /// Ticks from one poll for incoming packets to the next.  The interval
+    /// doubles, up to `MAX_POLL_INTERVAL`, each time a poll finds nothing,
+    /// and is back to `NETWORK_TIME` once a packet arrives or is sent, as
+    /// an answer is likely then.
+    unsigned long pollInterval;
+
+    /// Time of the poll to heed; polls scheduled before it was brought
+    /// forward find it is not their time, and do nothing.
+    unsigned long nextPoll;
+
+    /// Schedule the next poll `fromNow` ticks from now.
+    void SchedulePoll(unsigned long fromNow);
+
+    /// Read the next packet waiting into `p`, or return false if there is
+    /// none.  Packets are recorded, or taken from the replayed log, if
+    /// there is an input log.
+    bool ReadPacket(InPacket *p);
+
+    /// Packets that arrived, and can be pulled off of network: a ring of
+    /// `queueSize`, with `queueCount` of them from `queueHead` on.
+    InPacket *inQueue;
+    unsigned queueSize;
+    unsigned queueHead;
+    unsigned queueCount;
 };
 
 
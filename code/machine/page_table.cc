@@ -0,0 +1,64 @@
+/// Routines for two-level page tables.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "page_table.hh"
+
+
+PageTable::PageTable()
+{
+    directory     = nullptr;
+    directorySize = 0;
+}
+
+PageTable::~PageTable()
+{
+    for (unsigned i = 0; i < directorySize; i++) {
+        delete [] directory[i];
+    }
+    delete [] directory;
+}
+
+/// The directory grows at least twice as big each time, so that filling a
+/// region upwards does not copy it on every new leaf.
+TranslationEntry &
+PageTable::operator[](unsigned vpn)
+{
+    ASSERT(vpn < MAX_PAGES);
+
+    unsigned leaf = vpn >> LEAF_BITS;
+    if (leaf >= directorySize) {
+        unsigned size = directorySize == 0 ? 1 : 2 * directorySize;
+        while (size <= leaf) {
+            size *= 2;
+        }
+        if (size > MAX_LEAVES) {
+            size = MAX_LEAVES;
+        }
+        TranslationEntry **bigger = new TranslationEntry * [size];
+        for (unsigned i = 0; i < size; i++) {
+            bigger[i] = i < directorySize ? directory[i] : nullptr;
+        }
+        delete [] directory;
+        directory     = bigger;
+        directorySize = size;
+    }
+
+    if (directory[leaf] == nullptr) {
+        TranslationEntry *entries = new TranslationEntry [LEAF_SIZE];
+        for (unsigned i = 0; i < LEAF_SIZE; i++) {
+            entries[i].virtualPage  = -1;
+            entries[i].physicalPage = TranslationEntry::NO_FRAME;
+            entries[i].valid        = false;
+            entries[i].readOnly     = false;
+            entries[i].use          = false;
+            entries[i].dirty        = false;
+            entries[i].large        = false;
+        }
+        directory[leaf] = entries;
+    }
+    return directory[leaf][vpn & (LEAF_SIZE - 1)];
+}
@@ -0,0 +1,66 @@
+/// Data structures for two-level page tables.
+///
+/// A linear page table needs an entry for every virtual page up to the
+/// highest one used, so regions placed far apart cost the entries of the
+/// whole gap between them.  A `PageTable` instead splits the virtual page
+/// number in two: the high bits pick a leaf out of a directory, and the
+/// low bits an entry within the leaf.  Leaves are only made for the parts
+/// of the address space that are used, and the directory only grows up to
+/// the highest of them.
+///
+/// Leaves never move once made, so pointers to their entries, such as
+/// those cached by the MMU, stay good as long as the table lives.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_PAGETABLE__HH
+#define NACHOS_MACHINE_PAGETABLE__HH
+
+
+#include "translation_entry.hh"
+
+
+class PageTable {
+public:
+
+    /// Bits of the virtual page number that pick an entry in a leaf, and
+    /// the entries of a leaf.
+    static const unsigned LEAF_BITS = 5;
+    static const unsigned LEAF_SIZE = 1U << LEAF_BITS;
+
+    /// Virtual pages the table can map, and leaves it can have.
+    static const unsigned MAX_PAGES = 1U << 16;
+    static const unsigned MAX_LEAVES = MAX_PAGES / LEAF_SIZE;
+
+    /// Initialize an empty table.
+    PageTable();
+
+    ~PageTable();
+
+    /// Return the entry of `vpn`, making its leaf if there is none.  New
+    /// entries map nothing: they are not valid, and their virtual page is
+    /// -1 and their physical page `TranslationEntry::NO_FRAME`.
+    TranslationEntry &operator[](unsigned vpn);
+
+    /// Return the entry of `vpn`, or null if its leaf was never made.
+    TranslationEntry *Find(unsigned vpn) const
+    {
+        unsigned leaf = vpn >> LEAF_BITS;
+        if (leaf >= directorySize || directory[leaf] == nullptr) {
+            return nullptr;
+        }
+        return &directory[leaf][vpn & (LEAF_SIZE - 1)];
+    }
+
+private:
+
+    /// Leaves by the high bits of the virtual page, null where none was
+    /// made yet.
+    TranslationEntry **directory;
+    unsigned directorySize;
+};
+
+
+#endif
@@ -3,6 +3,10 @@
 
 
 /// Abstract interface for single-step objects.
+///
+/// The machine calls `Step` after every instruction while single-stepping,
+/// and otherwise only before instructions with a breakpoint (see
+/// `Machine::SetBreakpoint`).
 class SingleStepper {
 public:
     /// Returns whether to continue single-stepping or no.
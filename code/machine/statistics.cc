@@ -9,6 +9,7 @@
 
 
 #include "statistics.hh"
+#include "lib/slab.hh"
 #include "lib/utility.hh"
 
 #include <stdio.h>
@@ -18,16 +19,134 @@
 Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
-    numDiskReads = numDiskWrites = 0;
+    numIdleTimerSkips = 0;
+    numDiskReads = numDiskWrites = numDiskInterrupts = 0;
+    numDiskCacheHits = numDiskCacheMisses = numDiskReadAheads = 0;
+    numDirectSectors = 0;
+    numDiskSeekTracks = 0;
+    numDentryHits = numDentryMisses = 0;
+    numPageCacheHits = numPageCacheMisses = 0;
+    numJournalCommits = numJournalSectors = numJournalCheckpoints = 0;
+    numDiskRequests = numDiskSectors = diskRequestTicks = 0;
+    for (unsigned b = 0; b < LATENCY_BUCKETS; b++) {
+        diskLatency[b] = diskSeekTracks[b] = 0;
+    }
+    diskRotationTicks = numTrackBufferHits = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
-    numPageFaults = tlbHits = tlbMisses = 0;
+    numConsoleWriteInterrupts = 0;
+    numContextSwitches = numSlicesExpired = 0;
+    for (unsigned i = 0; i < MAX_READY_QUEUES; i++) {
+        numDispatches[i] = readyWaitTicks[i] = 0;
+        for (unsigned b = 0; b < LATENCY_BUCKETS; b++) {
+            readyWait[i][b] = 0;
+        }
+    }
+    numCPUs = 1;
+    for (unsigned i = 0; i < MAX_CPUS; i++) {
+        cpuBusyTicks[i] = 0;
+    }
+    numMigrations = numSteals = numIPIs = numShootdowns = 0;
+    numGangSwitches = numGangPicks = 0;
+    numPageFaults = tlbHits = tlbMisses = numTLBPreloads = 0;
+    numLargePages = 0;
+    for (unsigned i = 0; i < NUM_CACHE_LEVELS; i++) {
+        cacheAccesses[i] = cacheMisses[i] = 0;
+    }
+    cacheStallTicks = 0;
+    numReadAheads = numFaultsSaved = numTracePrefetches = 0;
+    numSwapIns = numSwapOuts = 0;
+    numEvictions = minFreeFrames = 0;
+    numDirtyEvictions = numPagesCleaned = 0;
+    numFramesZeroed = numZeroedFramesUsed = 0;
+    framePolicy = "none";
+    numAdmissionWaits = numSuspensions = 0;
+    numImageHits = numImageMisses = 0;
     numPacketsSent = numPacketsRecvd = 0;
+    numNetworkPolls = 0;
+    numRetransmissions = 0;
+    numRemoteHits = 0;
+    numRemoteMisses = 0;
+    numRemoteRevalidations = 0;
+#ifdef USER_PROGRAM
+    for (unsigned i = 0; i < MAX_SYSCALLS; i++) {
+        syscallNames[i] = nullptr;
+        numSyscalls[i] = syscallTicks[i] = 0;
+        for (unsigned b = 0; b < LATENCY_BUCKETS; b++) {
+            syscallLatency[i][b] = 0;
+        }
+    }
+#endif
 #ifdef DFS_TICKS_FIX
     tickResets = 0;
 #endif
 
 }
 
+/// Return the latency histogram bucket counting `ticks`.
+static unsigned
+LatencyBucket(unsigned long ticks)
+{
+    unsigned bucket = 0;
+    while (ticks > 0 && bucket < Statistics::LATENCY_BUCKETS - 1) {
+        ticks >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/// Print the non-empty buckets of `histogram`, each preceded by a comma.
+static void
+PrintLatencies(const unsigned long *histogram)
+{
+    for (unsigned b = 0; b < Statistics::LATENCY_BUCKETS; b++) {
+        if (histogram[b] == 0) {
+            continue;
+        }
+        if (b == Statistics::LATENCY_BUCKETS - 1) {
+            printf(", >=%lu: %lu", 1UL << (b - 1), histogram[b]);
+        } else {
+            printf(", <%lu: %lu", 1UL << b, histogram[b]);
+        }
+    }
+}
+
+void
+Statistics::RecordReadyWait(unsigned queue, unsigned long ticks)
+{
+    ASSERT(queue < MAX_READY_QUEUES);
+
+    numDispatches[queue]++;
+    readyWaitTicks[queue] += ticks;
+    readyWait[queue][LatencyBucket(ticks)]++;
+}
+
+void
+Statistics::RecordDiskRequest(unsigned count, unsigned long ticks,
+                              unsigned tracks, unsigned long rotation,
+                              bool trackBuffer)
+{
+    numDiskRequests++;
+    numDiskSectors += count;
+    diskRequestTicks += ticks;
+    diskLatency[LatencyBucket(ticks)]++;
+    diskSeekTracks[LatencyBucket(tracks)]++;
+    diskRotationTicks += rotation;
+    if (trackBuffer) {
+        numTrackBufferHits++;
+    }
+}
+
+#ifdef USER_PROGRAM
+void
+Statistics::RecordSyscall(unsigned scid, unsigned long ticks)
+{
+    ASSERT(scid < MAX_SYSCALLS);
+
+    syscallTicks[scid] += ticks;
+    syscallLatency[scid][LatencyBucket(ticks)]++;
+}
+#endif
+
 /// Print performance metrics, when we have finished everything at system
 /// shutdown.
 void
@@ -41,13 +160,256 @@ Statistics::Print()
 #endif
     printf("Ticks: total %lu, idle %lu, system %lu, user %lu\n",
            totalTicks, idleTicks, systemTicks, userTicks);
-    printf("Disk I/O: reads %lu, writes %lu\n", numDiskReads, numDiskWrites);
-    printf("Console I/O: reads %lu, writes %lu\n",
-           numConsoleCharsRead, numConsoleCharsWritten);
-    printf("Paging: faults %lu\n", numPageFaults);
+    printf("Timer: interrupts skipped while idle %lu\n", numIdleTimerSkips);
+    PrintScheduling();
+    printf("Disk I/O: reads %lu, writes %lu, interrupts %lu\n",
+           numDiskReads, numDiskWrites, numDiskInterrupts);
+#ifdef FILESYS
+    printf("Disk cache: hits %lu, misses %lu, read ahead %lu, "
+           "direct sectors %lu\n",
+           numDiskCacheHits, numDiskCacheMisses, numDiskReadAheads,
+           numDirectSectors);
+    printf("Disk seeks: tracks %lu\n", numDiskSeekTracks);
+    printf("Disk requests: %lu, sectors %lu, ticks %lu, rotation ticks %lu, "
+           "track buffer hits %lu",
+           numDiskRequests, numDiskSectors, diskRequestTicks,
+           diskRotationTicks, numTrackBufferHits);
+    PrintLatencies(diskLatency);
+    printf("\n");
+    printf("Disk seek distances: requests %lu", numDiskRequests);
+    PrintLatencies(diskSeekTracks);
+    printf("\n");
+    printf("Dentry cache: hits %lu, misses %lu\n",
+           numDentryHits, numDentryMisses);
+    printf("Page cache: hits %lu, misses %lu\n",
+           numPageCacheHits, numPageCacheMisses);
+    printf("Journal: commits %lu, sectors %lu, checkpoints %lu\n",
+           numJournalCommits, numJournalSectors, numJournalCheckpoints);
+#endif
+    printf("Console I/O: reads %lu, writes %lu, write interrupts %lu\n",
+           numConsoleCharsRead, numConsoleCharsWritten,
+           numConsoleWriteInterrupts);
+#ifdef SWAP
+    printf("Paging: faults %lu, large pages %lu, swap-ins %lu, "
+           "swap-outs %lu\n",
+           numPageFaults, numLargePages, numSwapIns, numSwapOuts);
+#else
+    printf("Paging: faults %lu, large pages %lu\n",
+           numPageFaults, numLargePages);
+#endif
+#ifdef DEMAND_LOADING
+    printf("Read-ahead: pages %lu, prefetched %lu, faults saved %lu\n",
+           numReadAheads, numTracePrefetches, numFaultsSaved);
+#endif
+#ifdef VMEM
+    printf("Memory: evictions %lu, fewest free frames %lu, "
+           "admissions deferred %lu, suspensions %lu\n",
+           numEvictions, minFreeFrames, numAdmissionWaits, numSuspensions);
+    printf("Idle zeroing: frames cleared %lu, used %lu\n",
+           numFramesZeroed, numZeroedFramesUsed);
+#endif
+#ifdef SWAP
+    printf("Replacement: policy %s, faults per 1000 instructions %.2f, "
+           "dirty writebacks %lu, pages cleaned %lu, swap I/O %lu pages\n",
+           framePolicy,
+           userTicks == 0 ? 0.0 : 1000.0 * numPageFaults / userTicks,
+           numDirtyEvictions, numPagesCleaned, numSwapIns + numSwapOuts);
+#endif
 #ifdef USE_TLB
-    printf("TLB: hits: %lu misses: %lu ratio: %f\n", tlbHits - tlbMisses, tlbMisses,  (double) (tlbHits - tlbMisses) / (double) tlbHits);
+    unsigned long tlbLookups = tlbHits + tlbMisses;
+    printf("TLB: hits %lu, misses %lu, hit ratio %.2f%%, preloads %lu\n",
+           tlbHits, tlbMisses,
+           tlbLookups == 0 ? 0.0 : 100.0 * tlbHits / tlbLookups,
+           numTLBPreloads);
+#endif
+#ifdef CACHE_MODEL
+    for (unsigned i = 0; i < NUM_CACHE_LEVELS; i++) {
+        if (cacheAccesses[i] == 0) {
+            continue;
+        }
+        printf("Cache %s: accesses %lu, misses %lu, hit ratio %.2f%%\n",
+               CacheLevelToString((CacheLevelId) i), cacheAccesses[i],
+               cacheMisses[i],
+               100.0 * (cacheAccesses[i] - cacheMisses[i])
+                     / cacheAccesses[i]);
+    }
+    printf("Cache stalls: ticks %lu\n", cacheStallTicks);
+#endif
+#ifdef USER_PROGRAM
+    printf("Images: cached %lu, read %lu\n", numImageHits, numImageMisses);
+#endif
+    printf("Network I/O: packets received %lu, sent %lu, polls %lu\n",
+           numPacketsRecvd, numPacketsSent, numNetworkPolls);
+#ifdef NETWORK
+    printf("Transport: retransmissions %lu\n", numRetransmissions);
+    printf("Remote files: blocks cached %lu, fetched %lu, revalidations %lu\n",
+           numRemoteHits, numRemoteMisses, numRemoteRevalidations);
+#endif
+#ifdef USER_PROGRAM
+    for (unsigned i = 0; i < MAX_SYSCALLS; i++) {
+        if (numSyscalls[i] == 0) {
+            continue;
+        }
+        printf("Syscall %s: calls %lu, ticks %lu",
+               syscallNames[i] != nullptr ? syscallNames[i] : "?",
+               numSyscalls[i], syscallTicks[i]);
+        PrintLatencies(syscallLatency[i]);
+        printf("\n");
+    }
+#endif
+    Slab::PrintAll();
+}
+
+void
+Statistics::PrintScheduling()
+{
+    printf("Scheduling: context switches %lu, slices used up %lu\n",
+           numContextSwitches, numSlicesExpired);
+    for (unsigned i = 0; i < MAX_READY_QUEUES; i++) {
+        if (numDispatches[i] == 0) {
+            continue;
+        }
+        printf("Ready queue %u: dispatches %lu, ticks waited %lu",
+               i, numDispatches[i], readyWaitTicks[i]);
+        PrintLatencies(readyWait[i]);
+        printf("\n");
+    }
+    if (numCPUs > 1) {
+        printf("CPUs: migrations %lu, steals %lu, IPIs %lu, "
+               "TLB shootdowns %lu\n",
+               numMigrations, numSteals, numIPIs, numShootdowns);
+        if (numGangSwitches != 0) {
+            printf("Gangs: switches %lu, picked ahead %lu\n",
+                   numGangSwitches, numGangPicks);
+        }
+        for (unsigned i = 0; i < numCPUs; i++) {
+            printf("CPU %u: busy ticks %lu\n", i, cpuBusyTicks[i]);
+        }
+    }
+}
+
+/// Write `histogram` as a JSON array.
+static void
+PrintHistogramJSON(FILE *f, const unsigned long *histogram)
+{
+    fputc('[', f);
+    for (unsigned b = 0; b < Statistics::LATENCY_BUCKETS; b++) {
+        fprintf(f, b == 0 ? "%lu" : ",%lu", histogram[b]);
+    }
+    fputc(']', f);
+}
+
+/// Every counter is written, whether or not the build keeps it, so that
+/// the output of any build can be read the same way.
+void
+Statistics::PrintJSON(FILE *f) const
+{
+    ASSERT(f != nullptr);
+
+    fprintf(f, "{\"ticks\":{\"total\":%lu,\"idle\":%lu,\"system\":%lu,"
+               "\"user\":%lu},\n",
+            totalTicks, idleTicks, systemTicks, userTicks);
+    fprintf(f, "\"timer\":{\"idleSkips\":%lu},\n", numIdleTimerSkips);
+
+    fprintf(f, "\"scheduling\":{\"contextSwitches\":%lu,"
+               "\"slicesExpired\":%lu,\"migrations\":%lu,\"steals\":%lu,"
+               "\"ipis\":%lu,\"shootdowns\":%lu,\"gangSwitches\":%lu,"
+               "\"gangPicks\":%lu,\"readyQueues\":[",
+            numContextSwitches, numSlicesExpired, numMigrations, numSteals,
+            numIPIs, numShootdowns, numGangSwitches, numGangPicks);
+    for (unsigned i = 0; i < MAX_READY_QUEUES; i++) {
+        fprintf(f, "%s{\"dispatches\":%lu,\"ticksWaited\":%lu,\"waits\":",
+                i == 0 ? "" : ",", numDispatches[i], readyWaitTicks[i]);
+        PrintHistogramJSON(f, readyWait[i]);
+        fputc('}', f);
+    }
+    fprintf(f, "],\"cpuBusyTicks\":[");
+    for (unsigned i = 0; i < numCPUs; i++) {
+        fprintf(f, i == 0 ? "%lu" : ",%lu", cpuBusyTicks[i]);
+    }
+    fprintf(f, "]},\n");
+
+    fprintf(f, "\"disk\":{\"reads\":%lu,\"writes\":%lu,\"interrupts\":%lu,"
+               "\"cacheHits\":%lu,\"cacheMisses\":%lu,\"readAheads\":%lu,"
+               "\"directSectors\":%lu,\"seekTracks\":%lu,\"requests\":%lu,"
+               "\"sectors\":%lu,\"requestTicks\":%lu,\"rotationTicks\":%lu,"
+               "\"trackBufferHits\":%lu,\"latency\":",
+            numDiskReads, numDiskWrites, numDiskInterrupts,
+            numDiskCacheHits, numDiskCacheMisses,
+            numDiskReadAheads, numDirectSectors, numDiskSeekTracks,
+            numDiskRequests, numDiskSectors, diskRequestTicks,
+            diskRotationTicks, numTrackBufferHits);
+    PrintHistogramJSON(f, diskLatency);
+    fprintf(f, ",\"seekDistances\":");
+    PrintHistogramJSON(f, diskSeekTracks);
+    fprintf(f, "},\n");
+    fprintf(f, "\"dentryCache\":{\"hits\":%lu,\"misses\":%lu},\n",
+            numDentryHits, numDentryMisses);
+    fprintf(f, "\"pageCache\":{\"hits\":%lu,\"misses\":%lu},\n",
+            numPageCacheHits, numPageCacheMisses);
+    fprintf(f, "\"journal\":{\"commits\":%lu,\"sectors\":%lu,"
+               "\"checkpoints\":%lu},\n",
+            numJournalCommits, numJournalSectors, numJournalCheckpoints);
+    fprintf(f, "\"console\":{\"reads\":%lu,\"writes\":%lu,"
+               "\"writeInterrupts\":%lu},\n",
+            numConsoleCharsRead, numConsoleCharsWritten,
+            numConsoleWriteInterrupts);
+
+    fprintf(f, "\"paging\":{\"faults\":%lu,\"largePages\":%lu,"
+               "\"readAheads\":%lu,\"tracePrefetches\":%lu,"
+               "\"faultsSaved\":%lu,"
+               "\"swapIns\":%lu,\"swapOuts\":%lu,"
+               "\"evictions\":%lu,\"minFreeFrames\":%lu,"
+               "\"admissionWaits\":%lu,\"suspensions\":%lu,"
+               "\"dirtyEvictions\":%lu,\"pagesCleaned\":%lu,"
+               "\"framesZeroed\":%lu,\"zeroedFramesUsed\":%lu,"
+               "\"policy\":\"%s\"},\n",
+            numPageFaults, numLargePages, numReadAheads, numTracePrefetches,
+            numFaultsSaved, numSwapIns, numSwapOuts, numEvictions,
+            minFreeFrames, numAdmissionWaits, numSuspensions,
+            numDirtyEvictions, numPagesCleaned, numFramesZeroed,
+            numZeroedFramesUsed, framePolicy);
+    fprintf(f, "\"tlb\":{\"hits\":%lu,\"misses\":%lu,"
+               "\"preloads\":%lu},\n",
+            tlbHits, tlbMisses, numTLBPreloads);
+#ifdef CACHE_MODEL
+    fprintf(f, "\"caches\":{");
+    for (unsigned i = 0; i < NUM_CACHE_LEVELS; i++) {
+        fprintf(f, "\"%s\":{\"accesses\":%lu,\"misses\":%lu},",
+                CacheLevelToString((CacheLevelId) i), cacheAccesses[i],
+                cacheMisses[i]);
+    }
+    fprintf(f, "\"stallTicks\":%lu},\n", cacheStallTicks);
+#endif
+    fprintf(f, "\"images\":{\"hits\":%lu,\"misses\":%lu},\n",
+            numImageHits, numImageMisses);
+
+    fprintf(f, "\"network\":{\"packetsSent\":%lu,\"packetsReceived\":%lu,"
+               "\"polls\":%lu,\"retransmissions\":%lu,"
+               "\"remoteHits\":%lu,\"remoteMisses\":%lu,"
+               "\"remoteRevalidations\":%lu},\n",
+            numPacketsSent, numPacketsRecvd, numNetworkPolls,
+            numRetransmissions, numRemoteHits, numRemoteMisses,
+            numRemoteRevalidations);
+
+    fprintf(f, "\"slabs\":");
+    Slab::PrintAllJSON(f);
+    fprintf(f, ",\n\"syscalls\":[");
+#ifdef USER_PROGRAM
+    bool first = true;
+    for (unsigned i = 0; i < MAX_SYSCALLS; i++) {
+        if (numSyscalls[i] == 0) {
+            continue;
+        }
+        fprintf(f, "%s{\"name\":\"%s\",\"calls\":%lu,\"ticks\":%lu,"
+                   "\"latency\":",
+                first ? "" : ",",
+                syscallNames[i] != nullptr ? syscallNames[i] : "?",
+                numSyscalls[i], syscallTicks[i]);
+        PrintHistogramJSON(f, syscallLatency[i]);
+        fputc('}', f);
+        first = false;
+    }
 #endif
-    printf("Network I/O: packets received %lu, sent %lu\n",
-           numPacketsRecvd, numPacketsSent);
+    fprintf(f, "]}");
 }
@@ -11,6 +11,11 @@
 #define NACHOS_MACHINE_STATS__HH
 
 
+#include "cache_model.hh"
+
+#include <stdio.h>
+
+
 /// The following class defines the statistics that are to be kept about
 /// Nachos behavior -- how much time (ticks) elapsed, how many user
 /// instructions executed, etc.
@@ -19,6 +24,11 @@
 class Statistics {
 public:
 
+    /// Buckets of the latency histograms: bucket 0 counts events that took
+    /// no time, and bucket `b` events that took from `2^(b-1)` to `2^b - 1`
+    /// ticks; the last bucket also counts every longer event.
+    static const unsigned LATENCY_BUCKETS = 20;
+
     /// Total time running Nachos.
     unsigned long totalTicks;
 
@@ -32,31 +42,215 @@ public:
     /// instructions executed).
     unsigned long userTicks;
 
+    /// Number of timer interrupts not taken because nothing could run.
+    unsigned long numIdleTimerSkips;
+
     /// Number of disk read requests.
     unsigned long numDiskReads;
 
     /// Number of disk write requests.
     unsigned long numDiskWrites;
 
+    /// Number of disk interrupts: one per request, or per batch.
+    unsigned long numDiskInterrupts;
+
+    /// Number of sector reads and writes that found, or did not find, the
+    /// sector in the disk cache.
+    unsigned long numDiskCacheHits;
+    unsigned long numDiskCacheMisses;
+
+    /// Number of sectors read into the disk cache ahead of being asked for.
+    unsigned long numDiskReadAheads;
+
+    /// Number of sectors read or written past the disk cache, by files open
+    /// for direct I/O.
+    unsigned long numDirectSectors;
+
+    /// Number of tracks the disk head moved across.
+    unsigned long numDiskSeekTracks;
+
+    /// Number of names looked up in directories found, and not found, in
+    /// the dentry cache.
+    unsigned long numDentryHits;
+    unsigned long numDentryMisses;
+
+    /// Number of blocks of files found, and not found, in the page cache.
+    unsigned long numPageCacheHits;
+    unsigned long numPageCacheMisses;
+
+    /// Number of groups of metadata changes committed to the journal, of
+    /// sectors written to it for them, and of times it was emptied.
+    unsigned long numJournalCommits;
+    unsigned long numJournalSectors;
+    unsigned long numJournalCheckpoints;
+
+    /// Number of requests to the raw disk, of sectors they transferred,
+    /// and histograms of how long they took and of the tracks sought for
+    /// them, ticks spent waiting for their first sector to come under the
+    /// head, and number of reads served from the track buffer.
+    unsigned long numDiskRequests;
+    unsigned long numDiskSectors;
+    unsigned long diskRequestTicks;
+    unsigned long diskLatency[LATENCY_BUCKETS];
+    unsigned long diskSeekTracks[LATENCY_BUCKETS];
+    unsigned long diskRotationTicks;
+    unsigned long numTrackBufferHits;
+
+    /// Account for a disk request for `count` sectors that takes `ticks`,
+    /// after seeking past `tracks` tracks and waiting `rotation` ticks, or
+    /// read from the track buffer if `trackBuffer`.
+    void RecordDiskRequest(unsigned count, unsigned long ticks,
+                           unsigned tracks, unsigned long rotation,
+                           bool trackBuffer);
+
     /// Number of characters read from the keyboard.
     unsigned long numConsoleCharsRead;
 
     /// Number of characters written to the display.
     unsigned long numConsoleCharsWritten;
 
+    /// Number of display interrupts: one per character, or per batch.
+    unsigned long numConsoleWriteInterrupts;
+
+    /// Number of switches from one thread to another, and number of times
+    /// a thread was preempted after running all of its time slices.
+    unsigned long numContextSwitches;
+    unsigned long numSlicesExpired;
+
+    /// Ready queues the scheduler may have.
+    static const unsigned MAX_READY_QUEUES = 16;
+
+    /// Number of threads dispatched from each ready queue, ticks they had
+    /// waited there since becoming ready, and histogram of those waits.
+    unsigned long numDispatches[MAX_READY_QUEUES];
+    unsigned long readyWaitTicks[MAX_READY_QUEUES];
+    unsigned long readyWait[MAX_READY_QUEUES][LATENCY_BUCKETS];
+
+    /// Account for a thread dispatched from `queue` after being ready for
+    /// `ticks`.
+    void RecordReadyWait(unsigned queue, unsigned long ticks);
+
+    /// CPUs the machine may have, and how many it has.
+    static const unsigned MAX_CPUS = 8;
+    unsigned numCPUs;
+
+    /// Ticks each CPU spent running threads.
+    unsigned long cpuBusyTicks[MAX_CPUS];
+
+    /// Number of threads moved from one CPU to another, of those taken by
+    /// an idle CPU from the queues of a busy one, of interprocessor
+    /// interrupts sent, and of TLB entries invalidated on every CPU.
+    unsigned long numMigrations;
+    unsigned long numSteals;
+    unsigned long numIPIs;
+    unsigned long numShootdowns;
+
+    /// Number of times another address space became the gang, and of
+    /// threads of the gang run ahead of others, with gang scheduling.
+    unsigned long numGangSwitches;
+    unsigned long numGangPicks;
+
     /// Number of virtual memory page faults.
     unsigned long numPageFaults;
 
-    /// Number of virtual memory page hits.
+    /// Number of pages loaded ahead of a page fault, and number of faults
+    /// that found their page already loaded that way, or by the
+    /// prefetcher, which loads the pages earlier runs of a program faulted
+    /// first, `numTracePrefetches` of them.
+    unsigned long numReadAheads;
+    unsigned long numFaultsSaved;
+    unsigned long numTracePrefetches;
+
+    /// Number of large translations made: groups of pages mapped by one
+    /// page table entry, or large entries loaded into the TLB.
+    unsigned long numLargePages;
+
+    /// Number of pages read from, and written to, swap files.
+    unsigned long numSwapIns;
+    unsigned long numSwapOuts;
+
+    /// Number of pages evicted to make room for others, and lowest number
+    /// of free frames seen.
+    unsigned long numEvictions;
+    unsigned long minFreeFrames;
+
+    /// Number of evicted pages that were dirty, and so were written back
+    /// to swap or to their mapped file, and name of the page replacement
+    /// policy that chose them.
+    unsigned long numDirtyEvictions;
+    const char *framePolicy;
+
+    /// Number of dirty pages written to swap ahead of their eviction, by
+    /// the page cleaner.
+    unsigned long numPagesCleaned;
+
+    /// Number of free frames cleared while the CPU was idle, and of those
+    /// given to a page that needed them clear, saving the clearing.
+    unsigned long numFramesZeroed;
+    unsigned long numZeroedFramesUsed;
+
+    /// Number of programs made to wait for memory before starting, and of
+    /// suspensions of running ones to relieve it.
+    unsigned long numAdmissionWaits;
+    unsigned long numSuspensions;
+
+    /// Number of TLB lookups that found, or did not find, a translation.
     unsigned long tlbHits;
     unsigned long tlbMisses;
 
+    /// Number of TLB entries loaded ahead of use, from the working set of
+    /// a space being switched to.
+    unsigned long numTLBPreloads;
+
+    /// Number of user accesses that went through each cache level, and
+    /// of those that missed it, with `-DCACHE_MODEL`; and ticks spent
+    /// waiting for the misses.
+    unsigned long cacheAccesses[NUM_CACHE_LEVELS];
+    unsigned long cacheMisses[NUM_CACHE_LEVELS];
+    unsigned long cacheStallTicks;
+
+    /// Number of executables found in, and read into, the image cache.
+    unsigned long numImageHits;
+    unsigned long numImageMisses;
+
     /// Number of packets sent over the network.
     unsigned long numPacketsSent;
 
     /// Number of packets received over the network.
     unsigned long numPacketsRecvd;
 
+    /// Number of times the network looked for a packet on its socket.
+    unsigned long numNetworkPolls;
+
+    /// Number of segments sent again by connections, for want of an ACK.
+    unsigned long numRetransmissions;
+
+    /// Number of blocks of remote files found kept by the client, and read
+    /// from the server; and number of times a client asked the server
+    /// whether a file changed, once its lease ran out.
+    unsigned long numRemoteHits;
+    unsigned long numRemoteMisses;
+    unsigned long numRemoteRevalidations;
+
+#ifdef USER_PROGRAM
+    /// System call codes are below this.
+    static const unsigned MAX_SYSCALLS = 64;
+
+    /// Name of each system call, or null for unused codes.
+    const char *syscallNames[MAX_SYSCALLS];
+
+    /// Number of calls to each system call, and ticks spent in the calls
+    /// that returned.
+    unsigned long numSyscalls[MAX_SYSCALLS];
+    unsigned long syscallTicks[MAX_SYSCALLS];
+
+    /// Latency histogram of each system call, in ticks.
+    unsigned long syscallLatency[MAX_SYSCALLS][LATENCY_BUCKETS];
+
+    /// Account for a call to `scid` that returned after `ticks`.
+    void RecordSyscall(unsigned scid, unsigned long ticks);
+#endif
+
 #ifdef DFS_TICKS_FIX
     /// Number of times the tick count gets reset.
     unsigned long tickResets;
@@ -67,6 +261,13 @@ public:
 
     /// Print collected statistics.
     void Print();
+
+    /// Print the statistics about scheduling alone.
+    void PrintScheduling();
+
+    /// Write every statistic to `f` as a JSON object, histograms as arrays
+    /// of `LATENCY_BUCKETS` counts.
+    void PrintJSON(FILE *f) const;
 };
 
 /// Constants used to reflect the relative time an operation would take in a
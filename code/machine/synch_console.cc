@@ -1,5 +1,7 @@
 #include "synch_console.hh"
 
+#include <stdio.h>
+
 static void
 SynchConsoleReadAvail(void *arg) {
     ASSERT(arg != nullptr);
@@ -14,14 +16,19 @@ SynchConsoleWriteDone(void *arg) {
     synch_console->WriteDone();
 }
 
-SynchConsole::SynchConsole(const char *debugName)
+SynchConsole::SynchConsole(const char *debugName, bool cooked,
+                           bool batched_)
 {
     name = debugName;
-    console = new Console(nullptr, nullptr, SynchConsoleReadAvail, SynchConsoleWriteDone, this);
+    console = new Console(nullptr, nullptr, SynchConsoleReadAvail, SynchConsoleWriteDone, this, cooked);
     readAvail = new Semaphore("SynchConsole::readAvail", 0);
     writeDone = new Semaphore("SynchConsole::writeDone", 0);
     readLock = new Lock("SynchConsole::readLock");
     writeLock = new Lock("SynchConsole::writeLock");
+    writeNext = nullptr;
+    writeEnd = nullptr;
+    lineHanded = false;
+    batched = batched_;
 }
 
 SynchConsole::~SynchConsole()
@@ -37,8 +44,7 @@ char
 SynchConsole::ReadChar() {
     readLock->Acquire();
 
-    readAvail->P();
-    char c = console->GetChar();
+    char c = NextChar();
 
     readLock->Release();
 
@@ -47,9 +53,45 @@ SynchConsole::ReadChar() {
 
 void
 SynchConsole::WriteChar(char c) {
+    WriteBuffer(&c, 1);
+}
+
+unsigned
+SynchConsole::ReadLine(char *buffer, unsigned count) {
+    ASSERT(buffer != nullptr);
+
+    readLock->Acquire();
+
+    unsigned i = 0;
+    while (i < count) {
+        char c = NextChar();
+        if (c == EOF) {
+            break;
+        }
+        buffer[i++] = c;
+        if (c == '\n') {
+            break;
+        }
+    }
+
+    readLock->Release();
+
+    return i;
+}
+
+void
+SynchConsole::WriteBuffer(const char *buffer, unsigned count) {
+    ASSERT(buffer != nullptr);
+
+    if (count == 0) {
+        return;
+    }
+
     writeLock->Acquire();
 
-    console->PutChar(c);
+    writeNext = buffer;
+    writeEnd = buffer + count;
+    PutNext();
     writeDone->P();
 
     writeLock->Release();
@@ -60,7 +102,42 @@ SynchConsole::ReadAvail() {
     readAvail->V();
 }
 
+/// A cooked console interrupts once a line, which is then gotten until it
+/// runs out.
+char
+SynchConsole::NextChar() {
+    char c = EOF;
+    if (console->IsCooked() && lineHanded) {
+        c = console->GetChar();
+    }
+    if (c == EOF) {
+        readAvail->P();
+        c = console->GetChar();
+        lineHanded = c != EOF;
+    }
+    return c;
+}
+
+/// Runs in the interrupt handler: the next character goes out at once,
+/// without waking the writer up.
 void
 SynchConsole::WriteDone() {
-    writeDone->V();
+    if (writeNext != writeEnd) {
+        PutNext();
+    } else {
+        writeDone->V();
+    }
+}
+
+void
+SynchConsole::PutNext() {
+    unsigned count = 1;
+    if (batched) {
+        count = writeEnd - writeNext;
+        if (count > Console::BUFFER_SIZE) {
+            count = Console::BUFFER_SIZE;
+        }
+    }
+    console->PutChars(writeNext, count);
+    writeNext += count;
 }
\ No newline at end of file
@@ -7,23 +7,56 @@
 
 class SynchConsole {
 public:
-    SynchConsole(const char* name);
+    /// A `cooked` console reads its input a line at a time; see `Console`.
+    /// A `batched` one hands what is written to the console up to
+    /// `Console::BUFFER_SIZE` characters at a time, with one interrupt for
+    /// each batch rather than for each character.
+    SynchConsole(const char* name, bool cooked = false, bool batched = false);
 
     ~SynchConsole();
 
     char ReadChar();
     void WriteChar(char c);
 
+    /// Read up to `count` characters into `buffer`, stopping after a
+    /// newline or before the end of the input, and return how many were
+    /// read.  The line is read whole, with no other reader in between.
+    unsigned ReadLine(char *buffer, unsigned count);
+
+    /// Write the `count` characters of `buffer`, with no other writer in
+    /// between.  Each character, or batch, is handed to the console by the
+    /// interrupt of the one before, and the caller only waits for the last
+    /// one.
+    void WriteBuffer(const char *buffer, unsigned count);
+
     void ReadAvail();
     void WriteDone();
 
 private:
+    /// Wait for the next character of the input and return it.  The read
+    /// lock must be held.
+    char NextChar();
+
+    /// Hand the console the next character of the `WriteBuffer` going on,
+    /// or batch of them.
+    void PutNext();
+
     const char* name;
     Console* console;
     Semaphore* readAvail;
     Semaphore* writeDone;
     Lock* readLock;
     Lock* writeLock;
+
+    /// Characters of the `WriteBuffer` going on still to be handed to the
+    /// console, from `writeNext` up to `writeEnd`.
+    const char* writeNext;
+    const char* writeEnd;
+
+    /// Whether the console handed a line that may not be all gotten yet.
+    bool lineHanded;
+
+    bool batched;
 };
 
 #endif
@@ -29,13 +29,17 @@
 
 extern "C" {
 #include <stdio.h>
+#include <errno.h>
 #include <string.h>
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/file.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
 #ifdef HOST_i386
 #include <sys/time.h>
 #endif
@@ -99,15 +103,16 @@ PollFile(int fd)
 /// Open a file for writing.
 ///
 /// Create it if it does not exist; truncate it if it does already exist.
-/// Return the file descriptor.
+/// Return the file descriptor, or -1 if it cannot be opened and
+/// `crashOnError` is not set.
 ///
 /// * `name` is the file name.
 int
-OpenForWrite(const char *name)
+OpenForWrite(const char *name, bool crashOnError)
 {
     ASSERT(name != nullptr);
     int fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0666);
-    ASSERT(fd >= 0);
+    ASSERT(!crashOnError || fd >= 0);
     return fd;
 }
 
@@ -199,6 +204,92 @@ Unlink(const char *name)
     return unlink(name);
 }
 
+/// Look a file up, with `stat`.
+bool
+Stat(const char *name, bool *isDirectory, unsigned *length)
+{
+    ASSERT(name != nullptr);
+    ASSERT(isDirectory != nullptr);
+    ASSERT(length != nullptr);
+
+    struct stat s;
+    if (stat(name, &s) != 0) {
+        return false;
+    }
+    *isDirectory = S_ISDIR(s.st_mode);
+    *length = s.st_size;
+    return true;
+}
+
+/// List a directory, with `readdir`.
+bool
+ListDirectory(const char *name,
+              void (*function)(const char *entry, void *arg), void *arg)
+{
+    ASSERT(name != nullptr);
+    ASSERT(function != nullptr);
+
+    DIR *dir = opendir(name);
+    if (dir == nullptr) {
+        return false;
+    }
+    for (struct dirent *e = readdir(dir); e != nullptr; e = readdir(dir)) {
+        if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+            function(e->d_name, arg);
+        }
+    }
+    closedir(dir);
+    return true;
+}
+
+/// Map an open file into memory.
+///
+/// Abort on error.
+char *
+MapFile(int fd, size_t nBytes)
+{
+    ASSERT(nBytes > 0);
+    void *p = mmap(nullptr, nBytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+    ASSERT(p != MAP_FAILED);
+    return (char *) p;
+}
+
+/// Write a mapped file back, and wait until it is written.
+///
+/// Abort on error.
+void
+SyncMapping(char *p, size_t nBytes)
+{
+    ASSERT(p != nullptr);
+    int retVal = msync(p, nBytes, MS_SYNC);
+    ASSERT(retVal == 0);
+}
+
+/// Unmap a mapped file.
+///
+/// Abort on error.
+void
+UnmapFile(char *p, size_t nBytes)
+{
+    ASSERT(p != nullptr);
+    int retVal = munmap(p, nBytes);
+    ASSERT(retVal == 0);
+}
+
+/// Map zero-filled memory, private to this process.
+///
+/// Abort on error.
+char *
+MapZeroed(size_t nBytes)
+{
+    ASSERT(nBytes > 0);
+    void *p = mmap(nullptr, nBytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANON, -1, 0);
+    ASSERT(p != MAP_FAILED);
+    return (char *) p;
+}
+
 /// Open an interprocess communication (IPC) connection.
 ///
 /// For now, just open a datagram port where other Nachos (simulating
@@ -258,6 +349,20 @@ DeAssignNameToSocket(const char *socketName)
     unlink(socketName);
 }
 
+/// Packets sent to `alias` reach the port named `socketName`, through a
+/// symbolic link.
+void
+AliasSocketName(const char *socketName, const char *alias)
+{
+    ASSERT(socketName != nullptr);
+    ASSERT(alias != nullptr);
+
+    unlink(alias);  // In case it is still around from last time.
+    int retVal = symlink(socketName, alias);
+    ASSERT(retVal == 0);
+    DEBUG('n', "Aliased socket %s as %s\n", socketName, alias);
+}
+
 /// Return true if there are any messages waiting to arrive on the IPC port.
 bool
 PollSocket(int sockID)
@@ -265,56 +370,77 @@ PollSocket(int sockID)
     return PollFile(sockID);  // On UNIX, socket ID's are just file ID's.
 }
 
-/// Read a fixed size packet off the IPC port.
+/// Read a packet off the IPC port: its first `headerSize` bytes into
+/// `header`, and up to `dataSize` more into `data`.  Return the size of the
+/// packet, which must hold a whole header.
 ///
 /// Abort on error.
-void
-ReadFromSocket(int sockID, char *buffer, size_t packetSize)
+size_t
+ReadFromSocket(int sockID, char *header, size_t headerSize,
+               char *data, size_t dataSize)
 {
-    ASSERT(buffer != nullptr);
-    ASSERT(packetSize > 0);
+    ASSERT(header != nullptr);
+    ASSERT(headerSize > 0);
+    ASSERT(data != nullptr);
 
-    ssize_t retVal;
-    // Comentado para evitar error de compilacion Red Hat 9 (2004)
-    //extern int errno;
     struct sockaddr_un uName;
-    size_t size = sizeof uName;
-
-    retVal = recvfrom(sockID, buffer, packetSize, 0,
-                      (struct sockaddr *) &uName, (socklen_t *) &size);
-
-    if (retVal <= 0 || retVal != (ssize_t) packetSize) {
-        perror("in recvfrom");
-        // Comentado para evitar error de compilacion Red Hat 9 (2004)
-        //printf("called: %X, got back %d, %d\n", buffer, retVal, errno);
+    struct iovec parts[2];
+    parts[0].iov_base = header;
+    parts[0].iov_len  = headerSize;
+    parts[1].iov_base = data;
+    parts[1].iov_len  = dataSize;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_name    = &uName;
+    msg.msg_namelen = sizeof uName;
+    msg.msg_iov     = parts;
+    msg.msg_iovlen  = 2;
+
+    ssize_t retVal = recvmsg(sockID, &msg, 0);
+    if (retVal < (ssize_t) headerSize || (msg.msg_flags & MSG_TRUNC)) {
+        perror("in recvmsg");
         ASSERT(false);
     }
+    return retVal;
 }
 
-/// Transmit a fixed size packet to another Nachos' IPC port.
+/// Transmit a packet to another Nachos' IPC port, made of `headerSize`
+/// bytes from `header` followed by `dataSize` bytes from `data`.  Return
+/// false if no Nachos has the port, as it is not running (anymore).
 ///
-/// Abort on error.
-void
-SendToSocket(int sockID, const char *buffer,
-             size_t packetSize, const char *toName)
+/// Abort on any other error.
+bool
+SendToSocket(int sockID, const char *header, size_t headerSize,
+             const char *data, size_t dataSize, const char *toName)
 {
-    ASSERT(buffer != nullptr);
-    ASSERT(packetSize > 0);
+    ASSERT(header != nullptr);
+    ASSERT(headerSize > 0);
+    ASSERT(data != nullptr || dataSize == 0);
     ASSERT(toName != nullptr);
 
     struct sockaddr_un uName;
-    ssize_t            retVal;
-
     InitSocketName(&uName, toName);
-#ifdef HOST_LINUX
-    retVal = sendto(sockID, buffer, packetSize, 0,
-                    (const struct sockaddr *) &uName, sizeof uName);
-#else
-    retVal = sendto(sockID, buffer, packetSize, 0,
-                    (char *) &uName, sizeof uName);
-#endif
 
-    ASSERT(retVal > 0 && retVal == (ssize_t) packetSize);
+    struct iovec parts[2];
+    parts[0].iov_base = (void *) header;
+    parts[0].iov_len  = headerSize;
+    parts[1].iov_base = (void *) data;
+    parts[1].iov_len  = dataSize;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof msg);
+    msg.msg_name    = &uName;
+    msg.msg_namelen = sizeof uName;
+    msg.msg_iov     = parts;
+    msg.msg_iovlen  = 2;
+
+    ssize_t retVal = sendmsg(sockID, &msg, 0);
+    if (retVal < 0 && (errno == ENOENT || errno == ECONNREFUSED)) {
+        return false;
+    }
+    ASSERT(retVal == (ssize_t) (headerSize + dataSize));
+    return true;
 }
 
 
@@ -27,7 +27,7 @@ namespace SystemDep {
     ///
     /// For simulating the disk and the console devices.
 
-    int OpenForWrite(const char *name);
+    int OpenForWrite(const char *name, bool crashOnError = true);
 
     int OpenForReadWrite(const char *name, bool crashOnError);
 
@@ -45,6 +45,32 @@ namespace SystemDep {
 
     bool Unlink(const char *name);
 
+    /// Tell whether there is a file at `name`, and if so, whether it is a
+    /// directory, and its length in bytes.
+    bool Stat(const char *name, bool *isDirectory, unsigned *length);
+
+    /// Call `function` with the name of every entry of the directory
+    /// `name`, but `.` and `..`, and with `arg`; return false if there is
+    /// no such directory.
+    bool ListDirectory(const char *name,
+                       void (*function)(const char *entry, void *arg),
+                       void *arg);
+
+    /// Map the first `nBytes` of an open file into memory, shared, so that
+    /// what is written there reaches the file; write what was changed back
+    /// to the file; and unmap it.
+
+    char *MapFile(int fd, size_t nBytes);
+
+    void SyncMapping(char *p, size_t nBytes);
+
+    void UnmapFile(char *p, size_t nBytes);
+
+    /// Map `nBytes` of zero-filled memory that belongs to no file.  The
+    /// host only provides each page when it is first touched, so nothing
+    /// has to be cleared up front.  Unmap it with `UnmapFile`.
+    char *MapZeroed(size_t nBytes);
+
     /// Interprocess communication operations, for simulating the network.
 
     int OpenSocket();
@@ -55,12 +81,22 @@ namespace SystemDep {
 
     void DeAssignNameToSocket(const char *socketName);
 
+    /// Give the IPC port named `socketName` another name, `alias`, which
+    /// `DeAssignNameToSocket` takes away.
+    void AliasSocketName(const char *socketName, const char *alias);
+
     bool PollSocket(int sockID);
 
-    void ReadFromSocket(int sockID, char *buffer, size_t packetSize);
+    /// Packets go in two parts, a header and data, gathered from and
+    /// scattered into separate buffers, so that they need not be copied
+    /// into one first.  Reading returns the bytes in the packet; sending
+    /// returns false if there is no socket to send to.
+
+    size_t ReadFromSocket(int sockID, char *header, size_t headerSize,
+                          char *data, size_t dataSize);
 
-    void SendToSocket(int sockID, const char *buffer,
-                      size_t packetSize, const char *toName);
+    bool SendToSocket(int sockID, const char *header, size_t headerSize,
+                      const char *data, size_t dataSize, const char *toName);
 
     /// Process control: `sleep`.
 
@@ -69,13 +69,25 @@ Timer::TimerExpired()
 
 /// Return when the hardware timer device will next cause an interrupt.
 ///
-/// If `randomize` is turned on, make it a (pseudo-)random delay.
+/// If `randomize` is turned on, make it a (pseudo-)random delay.  Random
+/// delays are recorded, and replayed delays come from the log, if there is
+/// an input log.
 int
 Timer::TimeOfNextInterrupt()
 {
-    if (randomize) {
-        return 1 + SystemDep::Random() % (TIMER_TICKS * 2);
-    } else {
+    int delay;
+    unsigned length;
+    if (inputLog != nullptr && inputLog->IsReplaying()
+          && inputLog->Replay(INPUT_TIMER, &delay, sizeof delay, &length)) {
+        return delay;
+    }
+
+    if (!randomize) {
         return TIMER_TICKS;
     }
+    delay = 1 + SystemDep::Random() % (TIMER_TICKS * 2);
+    if (inputLog != nullptr && inputLog->IsRecording()) {
+        inputLog->Record(INPUT_TIMER, &delay, sizeof delay);
+    }
+    return delay;
 }
@@ -20,10 +20,14 @@
 
 #include "network.hh"
 #include "post.hh"
+#include "remote_fs.hh"
+#include "rpc.hh"
+#include "transport.hh"
 #include "machine/interrupt.hh"
 #include "threads/system.hh"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -76,3 +80,576 @@ MailTest(int farAddr)
     // Then we are done!
     interrupt->Halt();
 }
+
+/// Wait a few seconds, in real time, acknowledging what the other machine
+/// sends again, as the clock of an idle machine runs ahead of the other;
+/// then halt.
+static void
+LingerAndHalt()
+{
+    for (unsigned i = 0; i < 3; i++) {
+        SystemDep::Delay(1);
+        alarmClock->WaitUntil(Connection::RETRANSMIT_TICKS);
+    }
+    interrupt->Halt();
+}
+
+/// Messages each machine sends in `TransportTest`, and the size of the big
+/// one sent after them.
+static const unsigned TRANSPORT_MESSAGES = 100;
+static const unsigned TRANSPORT_BULK_SIZE = 4000;
+
+static Connection *transportConnection;
+
+static void
+TransportSender(void *)
+{
+    char data[MAX_SEGMENT_SIZE];
+    for (unsigned i = 0; i < TRANSPORT_MESSAGES; i++) {
+        unsigned length = snprintf(data, sizeof data, "message %u", i) + 1;
+        transportConnection->Send(data, length);
+    }
+
+    char *bulk = new char [TRANSPORT_BULK_SIZE];
+    for (unsigned i = 0; i < TRANSPORT_BULK_SIZE; i++) {
+        bulk[i] = i % 251;
+    }
+    transportConnection->Send(bulk, TRANSPORT_BULK_SIZE);
+    delete [] bulk;
+}
+
+/// Test out the reliable transport, by doing the following:
+///
+/// 1. Open a connection to mailbox #2 on the machine with ID `farAddr`,
+///    from our mailbox #2, with up to `window` segments in flight.
+/// 2. Send `TRANSPORT_MESSAGES` numbered messages, from a thread of its
+///    own, while receiving as many from the other machine, checking that
+///    they arrive in order.  Then send and receive one message of
+///    `TRANSPORT_BULK_SIZE` bytes, many segments long.
+/// 3. Wait for every message sent to be acknowledged, and linger before
+///    halting.
+void
+TransportTest(int farAddr, unsigned window)
+{
+    transportConnection = new Connection(2, farAddr, 2, window);
+    unsigned long start = stats->totalTicks;
+
+    Thread *sender = new Thread("transport sender", true, PRIORITY_DEFAULT);
+    sender->Fork(TransportSender, nullptr);
+
+    char data[MAX_SEGMENT_SIZE];
+    char want[MAX_SEGMENT_SIZE];
+    unsigned inOrder = 0;
+    for (unsigned i = 0; i < TRANSPORT_MESSAGES; i++) {
+        transportConnection->Receive(data, sizeof data);
+        snprintf(want, sizeof want, "message %u", i);
+        if (strcmp(data, want) == 0) {
+            inOrder++;
+        }
+    }
+
+    char *bulk = new char [TRANSPORT_BULK_SIZE];
+    unsigned length = transportConnection->Receive(bulk,
+                                                   TRANSPORT_BULK_SIZE);
+    bool intact = length == TRANSPORT_BULK_SIZE;
+    for (unsigned i = 0; intact && i < TRANSPORT_BULK_SIZE; i++) {
+        intact = bulk[i] == (char) (i % 251);
+    }
+    delete [] bulk;
+
+    sender->Join();
+    transportConnection->Drain();
+    printf("Transport: %u of %u messages received in order, window %u, "
+           "ticks %lu, retransmissions %lu\n",
+           inOrder, TRANSPORT_MESSAGES, window, stats->totalTicks - start,
+           stats->numRetransmissions);
+    printf("Transport: %u byte message received %s\n",
+           length, intact ? "intact" : "corrupted");
+    fflush(stdout);
+
+    LingerAndHalt();
+}
+
+
+/// Test broadcast and multicast among `numMachines` machines, with IDs from
+/// 0 on; those with even IDs join multicast group 0.  Machine 0 sends one
+/// message to every machine, one to the group, and one more to every
+/// machine to end; each other machine tells it back which of the first two
+/// arrived, so that it can tell whether those with odd IDs got only the
+/// first, and those with even IDs both.  Machine 0 is to be started last.
+///
+/// Every machine waits for each message it expects, so the network is to be
+/// reliable; a lost one leaves a machine waiting forever.
+void
+MulticastTest(unsigned numMachines)
+{
+    static const char *MESSAGES[] = {
+        "Hello, everybody!", "Hello, evens!", "Bye, everybody!"
+    };
+    static const NetworkAddress TO[] = {
+        BROADCAST_ADDRESS, GroupAddress(0), BROADCAST_ADDRESS
+    };
+    const unsigned count = sizeof MESSAGES / sizeof *MESSAGES;
+    const int replyBox = 1;
+
+    NetworkAddress self = postOffice->GetAddress();
+    if (self % 2 == 0) {
+        postOffice->JoinGroup(0);
+    }
+
+    PacketHeader outPktHdr, inPktHdr;
+    MailHeader   outMailHdr, inMailHdr;
+    char buffer[MAX_MAIL_SIZE];
+
+    if (self != 0) {
+        unsigned got = 0;  // A bit for each message.
+        unsigned which;
+        do {
+            postOffice->Receive(0, &inPktHdr, &inMailHdr, buffer);
+            printf("Got \"%s\" from %d, sent to %d\n",
+                   buffer, inPktHdr.from, inPktHdr.to);
+            for (which = 0; which < count - 1; which++) {
+                if (strcmp(buffer, MESSAGES[which]) == 0) {
+                    got |= 1 << which;
+                    break;
+                }
+            }
+        } while (which < count - 1);
+        outPktHdr.to      = 0;
+        outMailHdr.to     = replyBox;
+        outMailHdr.from   = 0;
+        outMailHdr.length = sizeof got;
+        postOffice->Send(outPktHdr, outMailHdr, (const char *) &got);
+        fflush(stdout);
+        LingerAndHalt();
+    }
+
+    SystemDep::Delay(1);  // Let the others join.
+    outMailHdr.to   = 0;
+    outMailHdr.from = replyBox;
+    for (unsigned i = 0; i < count; i++) {
+        outPktHdr.to      = TO[i];
+        outMailHdr.length = strlen(MESSAGES[i]) + 1;
+        postOffice->Send(outPktHdr, outMailHdr, MESSAGES[i]);
+    }
+
+    unsigned right = 0;
+    for (unsigned i = 1; i < numMachines; i++) {
+        postOffice->Receive(replyBox, &inPktHdr, &inMailHdr, buffer);
+        unsigned got;
+        memcpy(&got, buffer, sizeof got);
+        bool ok = got == (inPktHdr.from % 2 == 0 ? 3u : 1u);
+        printf("Machine %d got %s\n", inPktHdr.from,
+               ok ? "what was sent to it" : "something else");
+        right += ok;
+    }
+    printf("Multicast: %u of %u machines got what was sent to them\n",
+           right, numMachines - 1);
+    fflush(stdout);
+    interrupt->Halt();
+}
+
+
+/// Network benchmark
+///
+/// Run over a connection between two machines, one of them, the one with
+/// the lower ID, as the client, and the other echoing for it.  For each
+/// message size, the client measures round trips of one message there and
+/// back, and the time to send a given amount of data in messages of that
+/// size, one way.  Each of them prints one line of `key=value` pairs, with
+/// what it cost the client, so that runs with other reliabilities (`-n`),
+/// windows, or builds can be compared.  Ticks are those of the client,
+/// which include its idle time.
+
+/// Sizes of the messages, the last of them a few segments long; round
+/// trips measured for each; and bytes sent one way for each.
+static const unsigned BENCH_SIZES[] = { 8, MAX_SEGMENT_SIZE, 256 };
+static const unsigned BENCH_ROUNDS = 50;
+static const unsigned BENCH_BYTES = 4096;
+
+static const unsigned MAX_BENCH_SIZE = 256;
+
+/// What the client had done when a workload started.
+typedef struct {
+    unsigned long ticks;
+    unsigned long sent;
+    unsigned long received;
+    unsigned long retransmissions;
+} NetSnapshot;
+
+static void
+TakeNetSnapshot(NetSnapshot *s)
+{
+    s->ticks           = stats->totalTicks;
+    s->sent            = stats->numPacketsSent;
+    s->received        = stats->numPacketsRecvd;
+    s->retransmissions = stats->numRetransmissions;
+}
+
+/// Print the packets the workload cost since `start`, ending the line.
+static void
+ReportPackets(const NetSnapshot *start)
+{
+    printf(" packets_sent=%lu packets_received=%lu retransmissions=%lu\n",
+           stats->numPacketsSent - start->sent,
+           stats->numPacketsRecvd - start->received,
+           stats->numRetransmissions - start->retransmissions);
+    fflush(stdout);
+}
+
+static int
+CompareTicks(const void *a, const void *b)
+{
+    unsigned long x = *(const unsigned long *) a;
+    unsigned long y = *(const unsigned long *) b;
+    return x < y ? -1 : x > y;
+}
+
+/// Client side: time round trips of messages of `size` bytes.
+static void
+BenchLatency(Connection *c, unsigned size, unsigned window)
+{
+    char data[MAX_BENCH_SIZE];
+    memset(data, 'l', size);
+    unsigned long ticks[BENCH_ROUNDS];
+    bool ok = true;
+
+    NetSnapshot start;
+    TakeNetSnapshot(&start);
+    for (unsigned i = 0; i < BENCH_ROUNDS; i++) {
+        unsigned long sent = stats->totalTicks;
+        c->Send(data, size);
+        ok = c->Receive(data, sizeof data) == size && ok;
+        ticks[i] = stats->totalTicks - sent;
+    }
+    qsort(ticks, BENCH_ROUNDS, sizeof *ticks, CompareTicks);
+
+    printf("netbench workload=latency size=%u window=%u rounds=%u ok=%d "
+           "ticks_min=%lu ticks_p50=%lu ticks_p90=%lu ticks_max=%lu",
+           size, window, BENCH_ROUNDS, ok, ticks[0],
+           ticks[BENCH_ROUNDS / 2], ticks[BENCH_ROUNDS * 9 / 10],
+           ticks[BENCH_ROUNDS - 1]);
+    ReportPackets(&start);
+}
+
+/// Client side: time sending `BENCH_BYTES` in messages of `size` bytes,
+/// until the server says it has them all.
+static void
+BenchThroughput(Connection *c, unsigned size, unsigned window)
+{
+    char data[MAX_BENCH_SIZE];
+    memset(data, 't', size);
+
+    NetSnapshot start;
+    TakeNetSnapshot(&start);
+    for (unsigned sent = 0; sent < BENCH_BYTES; sent += size) {
+        c->Send(data, size);
+    }
+    bool ok = c->Receive(data, sizeof data) == 1;
+    unsigned long ticks = stats->totalTicks - start.ticks;
+
+    printf("netbench workload=throughput size=%u window=%u bytes=%u ok=%d "
+           "ticks=%lu bytes_per_ktick=%.1f",
+           size, window, BENCH_BYTES, ok, ticks,
+           ticks == 0 ? 0.0 : BENCH_BYTES * 1000.0 / ticks);
+    ReportPackets(&start);
+}
+
+/// Server side: echo every round trip, and acknowledge the one-way data
+/// with a single byte, for each size in turn.
+static void
+BenchServe(Connection *c)
+{
+    char data[MAX_BENCH_SIZE];
+    for (unsigned s = 0; s < sizeof BENCH_SIZES / sizeof *BENCH_SIZES; s++) {
+        unsigned size = BENCH_SIZES[s];
+        for (unsigned i = 0; i < BENCH_ROUNDS; i++) {
+            unsigned length = c->Receive(data, sizeof data);
+            c->Send(data, length);
+        }
+        for (unsigned got = 0; got < BENCH_BYTES; got += size) {
+            c->Receive(data, sizeof data);
+        }
+        c->Send("k", 1);
+    }
+}
+
+/// Benchmark the network with the machine with ID `farAddr`, over a
+/// connection between mailboxes #3 with up to `window` segments in flight.
+void
+NetworkBenchmark(int farAddr, unsigned window)
+{
+    Connection *c = new Connection(3, farAddr, 3, window);
+
+    if (postOffice->GetAddress() < farAddr) {
+        for (unsigned s = 0; s < sizeof BENCH_SIZES / sizeof *BENCH_SIZES;
+             s++) {
+            BenchLatency(c, BENCH_SIZES[s], window);
+            BenchThroughput(c, BENCH_SIZES[s], window);
+        }
+    } else {
+        BenchServe(c);
+    }
+    c->Drain();
+    LingerAndHalt();
+}
+
+
+/// Remote procedure calls
+///
+/// The machine with the lower ID calls procedures served by the other, over
+/// a connection between mailboxes #4: first one call at a time, then the
+/// same calls pipelined, and then slow calls, that the workers of the
+/// server carry out at once.  Each part prints one line of `key=value`
+/// pairs, with the ticks it cost the client.
+
+enum {
+    PROC_DONE,   ///< The client is done; the server may halt.
+    PROC_ADD,    ///< Add two integers.
+    PROC_ECHO,   ///< Give a string back reversed.
+    PROC_SLEEP   ///< Sleep for the ticks given, and return them.
+};
+
+static const unsigned RPC_CALLS = 32;
+static const unsigned RPC_SLOW_CALLS = 4;
+static const int RPC_SLOW_TICKS = 20000;
+
+static Semaphore *rpcDone;
+
+static RpcStatus
+ProcDone(RpcArgs *, RpcArgs *)
+{
+    rpcDone->V();
+    return RPC_OK;
+}
+
+static RpcStatus
+ProcAdd(RpcArgs *args, RpcArgs *results)
+{
+    int a, b;
+    if (!args->GetInt(&a) || !args->GetInt(&b)) {
+        return RPC_BAD_ARGUMENTS;
+    }
+    results->PutInt(a + b);
+    return RPC_OK;
+}
+
+static RpcStatus
+ProcEcho(RpcArgs *args, RpcArgs *results)
+{
+    char s[RpcArgs::MAX_SIZE];
+    if (!args->GetString(s, sizeof s)) {
+        return RPC_BAD_ARGUMENTS;
+    }
+    unsigned n = strlen(s);
+    for (unsigned i = 0; i < n / 2; i++) {
+        char c = s[i];
+        s[i] = s[n - 1 - i];
+        s[n - 1 - i] = c;
+    }
+    results->PutString(s);
+    return RPC_OK;
+}
+
+static RpcStatus
+ProcSleep(RpcArgs *args, RpcArgs *results)
+{
+    int ticks;
+    if (!args->GetInt(&ticks) || ticks < 0) {
+        return RPC_BAD_ARGUMENTS;
+    }
+    alarmClock->WaitUntil(ticks);
+    results->PutInt(ticks);
+    return RPC_OK;
+}
+
+/// Call `PROC_ADD` `RPC_CALLS` times, `depth` calls outstanding at once,
+/// and report how long it took.
+static void
+RpcBenchAdd(RpcClient *client, unsigned depth)
+{
+    unsigned callIds[RpcClient::MAX_OUTSTANDING];
+    unsigned right = 0;
+    unsigned long start = stats->totalTicks;
+
+    for (unsigned i = 0; i < RPC_CALLS; i += depth) {
+        unsigned n = RPC_CALLS - i < depth ? RPC_CALLS - i : depth;
+        for (unsigned k = 0; k < n; k++) {
+            RpcArgs args;
+            args.PutInt(i + k);
+            args.PutInt(1000);
+            callIds[k] = client->Call(PROC_ADD, &args);
+        }
+        for (unsigned k = 0; k < n; k++) {
+            RpcArgs results;
+            int sum;
+            if (client->Wait(callIds[k], &results) == RPC_OK
+                  && results.GetInt(&sum) && sum == (int) (i + k + 1000)) {
+                right++;
+            }
+        }
+    }
+
+    unsigned long ticks = stats->totalTicks - start;
+    printf("rpcbench workload=add depth=%u calls=%u right=%u ticks=%lu "
+           "calls_per_mtick=%.1f\n",
+           depth, RPC_CALLS, right, ticks,
+           ticks == 0 ? 0.0 : RPC_CALLS * 1000000.0 / ticks);
+    fflush(stdout);
+}
+
+void
+RpcTest(int farAddr, unsigned workers)
+{
+    Connection *c = new Connection(4, farAddr, 4);
+
+    if (postOffice->GetAddress() > farAddr) {
+        rpcDone = new Semaphore("rpc done", 0);
+        RpcServer *server = new RpcServer(c, workers);
+        server->Register(PROC_DONE, ProcDone);
+        server->Register(PROC_ADD, ProcAdd);
+        server->Register(PROC_ECHO, ProcEcho);
+        server->Register(PROC_SLEEP, ProcSleep);
+        server->Start();
+        rpcDone->P();
+        c->Drain();
+        LingerAndHalt();
+    }
+
+    RpcClient *client = new RpcClient(c);
+
+    RpcArgs args, results;
+    char echo[RpcArgs::MAX_SIZE];
+    args.PutString("Hello there!");
+    bool ok = client->Invoke(PROC_ECHO, &args, &results) == RPC_OK
+              && results.GetString(echo, sizeof echo)
+              && strcmp(echo, "!ereht olleH") == 0;
+    args.Clear();
+    ok = ok && client->Invoke(RpcServer::MAX_PROCEDURES - 1, &args, &results)
+                 == RPC_NO_PROCEDURE;
+    printf("rpcbench workload=echo ok=%d\n", ok);
+
+    RpcBenchAdd(client, 1);
+    RpcBenchAdd(client, 8);
+
+    unsigned callIds[RPC_SLOW_CALLS];
+    unsigned long start = stats->totalTicks;
+    for (unsigned i = 0; i < RPC_SLOW_CALLS; i++) {
+        args.Clear();
+        args.PutInt(RPC_SLOW_TICKS);
+        callIds[i] = client->Call(PROC_SLEEP, &args);
+    }
+    unsigned right = 0;
+    for (unsigned i = 0; i < RPC_SLOW_CALLS; i++) {
+        int ticks;
+        if (client->Wait(callIds[i], &results) == RPC_OK
+              && results.GetInt(&ticks) && ticks == RPC_SLOW_TICKS) {
+            right++;
+        }
+    }
+    printf("rpcbench workload=sleep calls=%u right=%u call_ticks=%d "
+           "ticks=%lu\n",
+           RPC_SLOW_CALLS, right, RPC_SLOW_TICKS, stats->totalTicks - start);
+    fflush(stdout);
+
+    args.Clear();
+    client->Invoke(PROC_DONE, &args, &results);
+    c->Drain();
+    LingerAndHalt();
+}
+
+
+#ifdef FILESYS
+/// Remote files
+///
+/// A machine exports its file system with `-rx`, and another reads and
+/// writes its files with `-rp` and `-rcp`, as many times as given.  The
+/// client reaches the server the first time it is asked to, and halts once
+/// the commands are done, so that what its cache saved shows in the
+/// statistics.
+
+/// Bytes of a remote file read or written at once.
+static const unsigned REMOTE_TRANSFER_SIZE = 1024;
+
+static RemoteFileSystem *remoteFileSystem;
+
+/// The file system exported by `server`, reached the first time.
+static RemoteFileSystem *
+Mount(int server)
+{
+    if (remoteFileSystem == nullptr) {
+        SystemDep::Delay(2);  // Give the server time to start.
+        remoteFileSystem = new RemoteFileSystem(server);
+    }
+    return remoteFileSystem;
+}
+
+/// Print the contents of the file `name` of machine `server`.
+void
+RemotePrint(int server, const char *name)
+{
+    ASSERT(name != nullptr);
+
+    RemoteFile *file = Mount(server)->Open(name);
+    if (file == nullptr) {
+        fprintf(stderr, "RemotePrint: unable to open file %s\n", name);
+        return;
+    }
+
+    char *buffer = new char [REMOTE_TRANSFER_SIZE];
+    unsigned position = 0;
+    int amountRead;
+    while ((amountRead = file->ReadAt(buffer, REMOTE_TRANSFER_SIZE,
+                                      position)) > 0) {
+        fwrite(buffer, 1, amountRead, stdout);
+        position += amountRead;
+    }
+    fflush(stdout);
+
+    delete [] buffer;
+    delete file;
+}
+
+/// Copy the contents of the UNIX file `from` to the file `to` of machine
+/// `server`, which is created if it does not exist.
+void
+RemoteCopy(int server, const char *from, const char *to)
+{
+    ASSERT(from != nullptr);
+    ASSERT(to != nullptr);
+
+    FILE *fp = fopen(from, "r");
+    if (fp == nullptr) {
+        printf("RemoteCopy: could not open input file %s\n", from);
+        return;
+    }
+    RemoteFile *file = Mount(server)->Open(to, true);
+    if (file == nullptr) {
+        printf("RemoteCopy: could not open output file %s\n", to);
+        fclose(fp);
+        return;
+    }
+
+    char *buffer = new char [REMOTE_TRANSFER_SIZE];
+    unsigned position = 0;
+    int amountRead;
+    while ((amountRead = fread(buffer, sizeof(char),
+                               REMOTE_TRANSFER_SIZE, fp)) > 0) {
+        position += file->WriteAt(buffer, amountRead, position);
+    }
+
+    delete [] buffer;
+    delete file;
+    fclose(fp);
+}
+
+/// Halt, if a remote file system was reached.
+void
+RemoteFinish()
+{
+    if (remoteFileSystem != nullptr) {
+        LingerAndHalt();
+    }
+}
+
+#endif
@@ -19,43 +19,30 @@
 
 
 #include "post.hh"
+#include "threads/system.hh"
 
 #include <stdio.h>
 #include <string.h>
 
 
-/// Initialize a single mail message, by concatenating the headers to
-/// the data.
-///
-/// * `pktH` -- source, destination machine ID's.
-/// * `mailH` -- source, destination mailbox ID's.
-/// * `data` is the payload data.
-Mail::Mail(PacketHeader pktH, MailHeader mailH, const char *msgData)
-{
-    ASSERT(msgData != nullptr);
-    ASSERT(mailH.length <= MAX_MAIL_SIZE);
-
-    pktHdr  = pktH;
-    mailHdr = mailH;
-    memmove(data, msgData, mailHdr.length);
-}
-
 /// Initialize a single mail box within the post office, so that it can
 /// receive incoming messages.
 ///
 /// Just initialize a list of messages, representing the mailbox.
 MailBox::MailBox()
 {
-    messages = new SynchList<Mail *>;
+    lock    = new Lock("mailbox");
+    arrived = new Condition("mail arrived", lock);
 }
 
 /// De-allocate a single mail box within the post office.
 ///
-/// Just delete the mailbox, and throw away all the queued messages in the
-/// mailbox.
+/// The queued messages belong to the pool of the post office, which
+/// throws them away.
 MailBox::~MailBox()
 {
-    delete messages;
+    delete arrived;
+    delete lock;
 }
 
 /// Print the message header -- the destination machine ID and mailbox
@@ -74,51 +61,42 @@ PrintHeader(PacketHeader pktHdr, MailHeader mailHdr)
 ///
 /// If anyone is waiting for message arrival, wake them up!
 ///
-/// We need to reconstruct the `Mail` message (by concatenating the headers
-/// to the data), to simplify queueing the message on the `SynchList`.
-///
-/// * `pktHdr` -- source, destination machine ID's.
-/// * `mailHdr` -- source, destination mailbox ID's.
-/// * `data` is the payload message data.
+/// * `mail` is the message, taken from the pool of the post office.
 void
-MailBox::Put(PacketHeader pktHdr, MailHeader mailHdr, const char *data)
+MailBox::Put(Mail *mail)
 {
-    ASSERT(data != nullptr);
+    ASSERT(mail != nullptr);
 
-    Mail *mail = new Mail(pktHdr, mailHdr, data);
-    messages->Append(mail);  // Put on the end of the list of arrived
-                             // messages, and wake up any waiters.
+    lock->Acquire();
+    messages.Append(mail);  // Put on the end of the list of arrived
+                            // messages, and wake up any waiters.
+    arrived->Signal();
+    lock->Release();
 }
 
-/// Get a message from a mailbox, parsing it into the packet header, mailbox
-/// header, and data.
+/// Get a message from a mailbox.
 ///
 /// The calling thread waits if there are no messages in the mailbox.
-///
-/// * `pktHdr` is the address to put: source, destination machine ID's.
-/// * `mailHdr` is the address to put: source, destination mailbox ID's.
-/// * `data` is the address to put: payload message data.
-void
-MailBox::Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data)
+Mail *
+MailBox::Get()
 {
-    ASSERT(pktHdr != nullptr);
-    ASSERT(mailHdr != nullptr);
-    ASSERT(data != nullptr);
-
     DEBUG('n', "Waiting for mail in mailbox\n");
-    Mail *mail = messages->Pop();  // Remove message from list;
-                                   // will wait if list is empty.
-
-    *pktHdr  = mail->pktHdr;
-    *mailHdr = mail->mailHdr;
-    if (debug.IsEnabled('n')) {
-        printf("Got mail from mailbox: ");
-        PrintHeader(*pktHdr, *mailHdr);
+    lock->Acquire();
+    while (messages.IsEmpty()) {
+        arrived->Wait();
     }
-    memmove(data, mail->data, mail->mailHdr.length);
-      // Copy the message data into the caller's buffer.
-    delete mail;  // We have copied out the stuff we need, we can now discard
-                  // the message.
+    Mail *mail = messages.Pop();
+    lock->Release();
+    return mail;
+}
+
+Mail *
+MailBox::TryGet()
+{
+    lock->Acquire();
+    Mail *mail = messages.Pop();
+    lock->Release();
+    return mail;
 }
 
 /// PostalHelper, ReadAvail, WriteDone
@@ -169,7 +147,8 @@ WriteDone(void *arg)
 ///   packets; `reliability = 0` means the network never delivers any
 ///   packets).
 /// * `nBoxes` is the number of mail boxes in this `PostOffice`.
-PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
+PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes,
+                       unsigned queueSize)
 {
     ASSERT(nBoxes > 0);
 
@@ -177,15 +156,27 @@ PostOffice::PostOffice(NetworkAddress addr, double reliability, int nBoxes)
     messageAvailable = new Semaphore("message available", 0);
     messageSent      = new Semaphore("message sent", 0);
     sendLock         = new Lock("message send lock");
+    waitersLock      = new Lock("mail waiters lock");
+
+    mailPool = new Mail [MAIL_POOL_SIZE];
+    for (unsigned i = 0; i < MAIL_POOL_SIZE; i++) {
+        freeMail.Append(&mailPool[i]);
+    }
+    poolLock = new Lock("mail pool lock");
 
     // Second, initialize the mailboxes.
     netAddr  = addr;
     numBoxes = nBoxes;
     boxes    = new MailBox[nBoxes];
+    boxOwners = new const void * [nBoxes];
+    for (int i = 0; i < nBoxes; i++) {
+        boxOwners[i] = nullptr;
+    }
 
     // Third, initialize the network; tell it which interrupt handlers to
     // call.
-    network = new Network(addr, reliability, ReadAvail, WriteDone, this);
+    network = new Network(addr, reliability, ReadAvail, WriteDone, this,
+                          queueSize);
 
     // Finally, create a thread whose sole job is to wait for incoming
     // messages, and put them in the right mailbox.
@@ -199,39 +190,108 @@ PostOffice::~PostOffice()
 {
     delete network;
     delete [] boxes;
+    delete [] boxOwners;
     delete messageAvailable;
     delete messageSent;
     delete sendLock;
+    delete waitersLock;
+
+    // Mails left in boxes are lost with `mailPool`, or leaked if the pool
+    // grew to make them.
+    for (Mail *m; (m = freeMail.Pop()) != nullptr; ) {
+        if (m < mailPool || m >= mailPool + MAIL_POOL_SIZE) {
+            delete m;
+        }
+    }
+    delete [] mailPool;
+    delete poolLock;
+}
+
+Mail *
+PostOffice::AllocateMail()
+{
+    poolLock->Acquire();
+    Mail *mail = freeMail.Pop();
+    poolLock->Release();
+    if (mail == nullptr) {
+        DEBUG('n', "Mail pool empty, making it grow\n");
+        mail = new Mail;
+    }
+    return mail;
+}
+
+void
+PostOffice::FreeMail(Mail *mail)
+{
+    ASSERT(mail != nullptr);
+
+    poolLock->Acquire();
+    freeMail.Prepend(mail);  // The last used is the likeliest in cache.
+    poolLock->Release();
+}
+
+/// Parse `mail`, taken from a mailbox, into the packet header, mailbox
+/// header, and data, and give it back to the pool.
+void
+PostOffice::Unpack(Mail *mail, PacketHeader *pktHdr, MailHeader *mailHdr,
+                   char *data)
+{
+    *pktHdr  = mail->pktHdr;
+    *mailHdr = mail->mailHdr;
+    if (debug.IsEnabled('n')) {
+        printf("Got mail from mailbox: ");
+        PrintHeader(*pktHdr, *mailHdr);
+    }
+    memcpy(data, mail->data, mail->mailHdr.length);
+      // Copy the message data into the caller's buffer.
+    FreeMail(mail);  // We have copied out the stuff we need, the mail can
+                     // take another message.
 }
 
 /// Wait for incoming messages, and put them in the right mailbox.
 ///
 /// Incoming messages have had the `PacketHeader` stripped off, but the
 /// `MailHeader` is still tacked on the front of the data.
+///
+/// The network tells of packets a batch at a time, so every packet waiting
+/// is taken on each turn; a later turn may then find none.
 void
 PostOffice::PostalDelivery()
 {
     PacketHeader pktHdr;
     MailHeader   mailHdr;
-    char        *buffer = new char [MAX_PACKET_SIZE];
+    char         buffer[MAX_PACKET_SIZE];
 
     for (;;) {
         // First, wait for a message.
         messageAvailable->P();
-        pktHdr = network->Receive(buffer);
 
-        mailHdr = *(MailHeader *) buffer;
-        if (debug.IsEnabled('n')) {
-            printf("Putting mail into mailbox: ");
-            PrintHeader(pktHdr, mailHdr);
+        for (;;) {
+            IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+            pktHdr = network->Receive(buffer);
+            interrupt->SetLevel(oldLevel);
+            if (pktHdr.length == 0) {
+                break;
+            }
+
+            mailHdr = *(MailHeader *) buffer;
+            if (debug.IsEnabled('n')) {
+                printf("Putting mail into mailbox: ");
+                PrintHeader(pktHdr, mailHdr);
+            }
+
+            // Check that arriving message is legal!
+            ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
+            ASSERT(mailHdr.length <= MAX_MAIL_SIZE);
+
+            // Put into mailbox.
+            Mail *mail = AllocateMail();
+            mail->pktHdr  = pktHdr;
+            mail->mailHdr = mailHdr;
+            memcpy(mail->data, buffer + sizeof (MailHeader), mailHdr.length);
+            boxes[mailHdr.to].Put(mail);
+            Notify(mailHdr.to);
         }
-
-        // Check that arriving message is legal!
-        ASSERT(0 <= mailHdr.to && mailHdr.to < numBoxes);
-        ASSERT(mailHdr.length <= MAX_MAIL_SIZE);
-
-        // Put into mailbox.
-        boxes[mailHdr.to].Put(pktHdr, mailHdr, buffer + sizeof (MailHeader));
     }
 }
 
@@ -249,8 +309,8 @@ PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, const char *data)
 {
     ASSERT(data != nullptr);
 
-    char *buffer = new char [MAX_PACKET_SIZE];  // Space to hold concatenated
-                                                // `mailHdr` + data.
+    char buffer[MAX_PACKET_SIZE];  // Space to hold concatenated `mailHdr` +
+                                   // data.
 
     if (debug.IsEnabled('n')) {
         printf("Post send: ");
@@ -273,9 +333,6 @@ PostOffice::Send(PacketHeader pktHdr, MailHeader mailHdr, const char *data)
     messageSent->P();  // Wait for interrupt to tell us ok to send the next
                        // message.
     sendLock->Release();
-
-    delete [] buffer;  // We have sent the message, so we can delete our
-                       // buffer.
 }
 
 /// Retrieve a message from a specific box if one is available, otherwise
@@ -297,10 +354,182 @@ PostOffice::Receive(int box, PacketHeader *pktHdr,
     ASSERT(data != nullptr);
     ASSERT(box >= 0 && box < numBoxes);
 
-    boxes[box].Get(pktHdr, mailHdr, data);
+    Unpack(boxes[box].Get(), pktHdr, mailHdr, data);
     ASSERT(mailHdr->length <= MAX_MAIL_SIZE);
 }
 
+NetworkAddress
+PostOffice::GetAddress() const
+{
+    return netAddr;
+}
+
+int
+PostOffice::GetNumBoxes() const
+{
+    return numBoxes;
+}
+
+/// The network looks at the groups it is in when packets arrive, in an
+/// interrupt handler, so they are changed with interrupts off.
+void
+PostOffice::JoinGroup(unsigned group)
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    network->JoinGroup(GroupAddress(group));
+    interrupt->SetLevel(oldLevel);
+}
+
+void
+PostOffice::LeaveGroup(unsigned group)
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    network->LeaveGroup(GroupAddress(group));
+    interrupt->SetLevel(oldLevel);
+}
+
+/// Binding is done with interrupts off rather than under a lock, as boxes
+/// are released when a thread is deleted, which may be with interrupts off.
+bool
+PostOffice::Bind(int box, const void *owner)
+{
+    ASSERT(owner != nullptr);
+
+    if (box < 0 || box >= numBoxes) {
+        return false;
+    }
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    bool bound = boxOwners[box] == nullptr || boxOwners[box] == owner;
+    if (bound) {
+        boxOwners[box] = owner;
+    }
+    interrupt->SetLevel(oldLevel);
+    return bound;
+}
+
+bool
+PostOffice::IsBoundBy(int box, const void *owner) const
+{
+    return box >= 0 && box < numBoxes && boxOwners[box] == owner;
+}
+
+void
+PostOffice::UnbindAll(const void *owner)
+{
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    for (int i = 0; i < numBoxes; i++) {
+        if (boxOwners[i] == owner) {
+            boxOwners[i] = nullptr;
+        }
+    }
+    interrupt->SetLevel(oldLevel);
+}
+
+/// Interrupt handler, called when a thread in `ReceiveAny` has waited long
+/// enough.
+///
+/// * `arg` is the `PostOffice::Waiter` of the thread.
+void
+ReceiveTimeout(void *arg)
+{
+    PostOffice::Waiter *w = (PostOffice::Waiter *) arg;
+    w->timerPending = false;
+    if (w->abandoned) {
+        delete w->ready;
+        delete w;
+        return;
+    }
+    w->timedOut = true;
+    w->ready->V();
+}
+
+void
+PostOffice::Notify(int box)
+{
+    waitersLock->Acquire();
+    for (Waiter *w = waiters.Head(); w != nullptr; w = waiters.Next(w)) {
+        for (unsigned i = 0; i < w->count; i++) {
+            if (w->boxSet[i] == box) {
+                w->ready->V();
+                break;
+            }
+        }
+    }
+    waitersLock->Release();
+}
+
+/// The boxes are looked at with the list of waiters locked, and the thread
+/// joins the list before letting go of it, so that no mail put in a box in
+/// between goes unnoticed.  A thread may be woken for mail another takes
+/// first, and then just waits again.
+///
+/// The timeout interrupt cannot be called off, so if it is still to come
+/// when the thread leaves, it is left to delete the waiter.
+int
+PostOffice::ReceiveAny(const int *boxSet, unsigned count,
+                       unsigned long timeout, PacketHeader *pktHdr,
+                       MailHeader *mailHdr, char *data)
+{
+    ASSERT(boxSet != nullptr);
+    ASSERT(pktHdr != nullptr);
+    ASSERT(mailHdr != nullptr);
+    ASSERT(data != nullptr);
+    for (unsigned i = 0; i < count; i++) {
+        ASSERT(boxSet[i] >= 0 && boxSet[i] < numBoxes);
+    }
+
+    Waiter *w = nullptr;
+    int found = -1;
+    for (;;) {
+        waitersLock->Acquire();
+        for (unsigned i = 0; i < count && found == -1; i++) {
+            Mail *mail = boxes[boxSet[i]].TryGet();
+            if (mail != nullptr) {
+                Unpack(mail, pktHdr, mailHdr, data);
+                found = boxSet[i];
+            }
+        }
+        if (found != -1 || timeout == 0 || (w != nullptr && w->timedOut)) {
+            break;
+        }
+        if (w == nullptr) {
+            w = new Waiter;
+            w->boxSet       = boxSet;
+            w->count        = count;
+            w->ready        = new Semaphore("mail waiter", 0);
+            w->timedOut     = false;
+            w->timerPending = false;
+            w->abandoned    = false;
+            waiters.Append(w);
+            if (timeout != NO_TIMEOUT) {
+                IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+                w->timerPending = true;
+                interrupt->Schedule(ReceiveTimeout, w, timeout, ALARM_INT);
+                interrupt->SetLevel(oldLevel);
+            }
+        }
+        waitersLock->Release();
+        w->ready->P();
+    }
+
+    if (w != nullptr) {
+        waiters.Remove(w);
+    }
+    waitersLock->Release();
+
+    if (w != nullptr) {
+        IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+        if (w->timerPending) {
+            w->abandoned = true;
+        } else {
+            delete w->ready;
+            delete w;
+        }
+        interrupt->SetLevel(oldLevel);
+    }
+    return found;
+}
+
 /// Interrupt handler, called when a packet arrives from the network.
 ///
 /// Signal the PostalDelivery routine that it is time to get to work!
@@ -28,8 +28,9 @@
 
 
 #include "network.hh"
+#include "lib/intrusive_list.hh"
+#include "threads/condition.hh"
 #include "threads/semaphore.hh"
-#include "threads/synch_list.hh"
 
 
 /// Mailbox address -- uniquely identifies a mailbox on a given machine.
@@ -60,17 +61,21 @@ const unsigned MAX_MAIL_SIZE = MAX_PACKET_SIZE - sizeof (MailHeader);
 /// 1. network header (`PacketHeader`);
 /// 2. post office header (`MailHeader`);
 /// 3. data.
+///
+/// Mails are not allocated for each message: the `PostOffice` keeps a pool
+/// of them, and each is either in the pool or in a mailbox, linked through
+/// `link`.
 class Mail {
 public:
-
-    /// Initialize a mail message by concatenating the headers to the data.
-    Mail(PacketHeader pktH, MailHeader mailH, const char *msgData);
-
     PacketHeader pktHdr;               ///< Header appended by `Network`.
     MailHeader   mailHdr;              ///< Header appended by `PostOffice`.
     char         data[MAX_MAIL_SIZE];  ///< Payload -- message data.
+
+    ListLink<Mail> link;
 };
 
+typedef IntrusiveList<Mail, &Mail::link> MailQueue;
+
 /// The following class defines a single mailbox, or temporary storage
 /// for messages.
 ///
@@ -87,16 +92,22 @@ public:
     ~MailBox();
 
     /// Atomically put a message into the mailbox.
-    void Put(PacketHeader pktHdr, MailHeader mailHdr, const char *data);
+    void Put(Mail *mail);
 
     /// Atomically get a message out of the mailbox (and wait if there is no
     /// message to get!).
-    void Get(PacketHeader *pktHdr, MailHeader *mailHdr, char *data);
+    Mail *Get();
+
+    /// Get a message out of the mailbox, as `Get` does; return null at once
+    /// if there is none.
+    Mail *TryGet();
 
 private:
 
     /// A mailbox is just a list of arrived messages.
-    SynchList<Mail *> *messages;
+    MailQueue messages;
+    Lock *lock;
+    Condition *arrived;  ///< Signalled when a message is put.
 
 };
 
@@ -117,7 +128,10 @@ public:
     ///
     /// * `reliability` is how many packets get dropped by the underlying
     ///   network.
-    PostOffice(NetworkAddress addr, double reliability, int nBoxes);
+    /// * `queueSize` is how many packets that arrived the network keeps
+    ///   until they are delivered.
+    PostOffice(NetworkAddress addr, double reliability, int nBoxes,
+               unsigned queueSize = Network::DEFAULT_QUEUE_SIZE);
 
     // De-allocate post office data.
     ~PostOffice();
@@ -133,6 +147,47 @@ public:
     void Receive(int box, PacketHeader *pktHdr,
                  MailHeader *mailHdr, char *data);
 
+    /// Network address of this machine.
+    NetworkAddress GetAddress() const;
+
+    /// Number of mailboxes, numbered from 0.
+    int GetNumBoxes() const;
+
+    /// Mail sent to `BROADCAST_ADDRESS` reaches the box it is addressed to
+    /// on every other machine, and mail sent to the `GroupAddress` of a
+    /// multicast group, on every other machine that joined it, with one
+    /// send.  Either is as unreliable as any other mail.
+
+    /// Join or leave multicast group `group`.
+    void JoinGroup(unsigned group);
+    void LeaveGroup(unsigned group);
+
+    /// Mailboxes can be bound by user processes, each to one `owner`, so
+    /// that no other process receives from them.  Kernel code does not
+    /// bind boxes.
+
+    /// Bind `box` to `owner`, and return true, unless another owner has it
+    /// or there is no such box.
+    bool Bind(int box, const void *owner);
+
+    /// Whether `box` is bound to `owner`.
+    bool IsBoundBy(int box, const void *owner) const;
+
+    /// Release every box bound to `owner`.
+    void UnbindAll(const void *owner);
+
+    /// `timeout` for `ReceiveAny` that waits as long as it takes.
+    static const unsigned long NO_TIMEOUT = ~0UL;
+
+    /// Retrieve a message from whichever of the `count` boxes in `boxSet`
+    /// has one first, and return the box, so that one thread can serve
+    /// several boxes.  Boxes earlier in the set are looked at first.
+    ///
+    /// Wait for up to `timeout` ticks if there is no message in any of
+    /// them, and return -1 if none arrives by then.
+    int ReceiveAny(const int *boxSet, unsigned count, unsigned long timeout,
+                   PacketHeader *pktHdr, MailHeader *mailHdr, char *data);
+
     // Wait for incoming messages, and then put them in the correct mailbox.
     void PostalDelivery();
 
@@ -158,6 +213,9 @@ private:
     // Number of mail boxes.
     int numBoxes;
 
+    /// Owner each box is bound to, or null.
+    const void **boxOwners;
+
     // `V`'ed when message has arrived from network.
     Semaphore *messageAvailable;
 
@@ -167,6 +225,52 @@ private:
     // Only one outgoing message at a time.
     Lock *sendLock;
 
+    /// Mails preallocated, when the post office starts.
+    static const unsigned MAIL_POOL_SIZE = 32;
+
+    /// Take a mail from the pool, or, if every mail is in a mailbox, make
+    /// the pool grow by one.
+    Mail *AllocateMail();
+
+    /// Give `mail` back to the pool.
+    void FreeMail(Mail *mail);
+
+    /// Take mail from a box into the caller's buffers, and give it back to
+    /// the pool.
+    void Unpack(Mail *mail, PacketHeader *pktHdr, MailHeader *mailHdr,
+                char *data);
+
+    /// Mails neither in a mailbox nor being filled or emptied.  Those made
+    /// after `mailPool` stay in the pool too, so that once the pool has
+    /// grown enough, delivering a message allocates nothing.
+    Mail *mailPool;
+    MailQueue freeMail;
+    Lock *poolLock;
+
+    /// A thread in `ReceiveAny`, waiting for mail in any box of its set.
+    class Waiter {
+    public:
+        ListLink<Waiter> link;
+        const int *boxSet;
+        unsigned count;
+        Semaphore *ready;  ///< `V`'ed when mail arrives in one of the
+                           ///< boxes, or the time is up.
+        bool timedOut;
+        bool timerPending;  ///< The timeout interrupt is yet to come.
+        bool abandoned;     ///< The thread is gone; the timeout interrupt
+                            ///< is to delete the waiter.
+    };
+
+    /// Wake up the waiters for box `box`, which just received mail.
+    void Notify(int box);
+
+    /// Threads in `ReceiveAny`, and the lock that keeps the list in step
+    /// with mail put in boxes.
+    IntrusiveList<Waiter, &Waiter::link> waiters;
+    Lock *waitersLock;
+
+    friend void ReceiveTimeout(void *arg);
+
 };
 
 
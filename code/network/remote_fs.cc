@@ -0,0 +1,517 @@
+/// Routines to reach the file system of another machine, keeping what is
+/// read of it.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#ifdef FILESYS
+
+
+#include "remote_fs.hh"
+#include "lib/table.hh"
+#include "machine/disk.hh"
+#include "threads/rw_lock.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+/// Procedures of an exported file system.
+enum {
+    FS_OPEN,   ///< Create flag, path -> handle, file, length, version.
+    FS_READ,   ///< Handle, block -> length, version, bytes of the block.
+    FS_WRITE,  ///< Handle, position, bytes -> length, version.
+    FS_STAT,   ///< Handle -> length, version.
+    FS_CLOSE   ///< Handle.
+};
+
+/// The serving end.  A file is identified by the sector of its header, and
+/// its version changes whenever it is written or created through the
+/// export.  Files are read under `exportLock` for reading, and written under
+/// it for writing, so that the version sent with what is read is that of
+/// the bytes sent.
+static Table<OpenFile *> *exportHandles;
+static Lock *handlesLock;
+static unsigned *exportVersions;
+static RWLock *exportLock;
+
+/// The file open as the handle in `args`, or null.
+static OpenFile *
+GetHandle(RpcArgs *args, int *handle)
+{
+    if (!args->GetInt(handle) || *handle < 0) {
+        return nullptr;
+    }
+    handlesLock->Acquire();
+    OpenFile *file = exportHandles->Get(*handle);
+    handlesLock->Release();
+    return file;
+}
+
+/// A handle of -1 is returned for a file that cannot be opened.
+static RpcStatus
+ServeOpen(RpcArgs *args, RpcArgs *results)
+{
+    int create;
+    char path[MAX_REMOTE_PATH + 1];
+    if (!args->GetInt(&create) || !args->GetString(path, sizeof path)) {
+        return RPC_BAD_ARGUMENTS;
+    }
+
+    exportLock->AcquireWrite();
+    OpenFile *file = fileSystem->Open(path);
+    if (file == nullptr && create && fileSystem->Create(path, 0)) {
+        file = fileSystem->Open(path);
+        if (file != nullptr) {
+            exportVersions[file->GetSector()]++;
+        }
+    }
+    int handle = -1;
+    if (file != nullptr) {
+        handlesLock->Acquire();
+        handle = exportHandles->Add(file);
+        handlesLock->Release();
+        if (handle == -1) {
+            delete file;
+            file = nullptr;
+        }
+    }
+    results->PutInt(handle);
+    if (file != nullptr) {
+        results->PutInt(file->GetSector());
+        results->PutInt(file->Length());
+        results->PutInt(exportVersions[file->GetSector()]);
+    }
+    exportLock->ReleaseWrite();
+    DEBUG('n', "Remote FS: %s open as %d\n", path, handle);
+    return RPC_OK;
+}
+
+static RpcStatus
+ServeRead(RpcArgs *args, RpcArgs *results)
+{
+    int handle, block;
+    OpenFile *file = GetHandle(args, &handle);
+    if (file == nullptr || !args->GetInt(&block) || block < 0) {
+        return RPC_BAD_ARGUMENTS;
+    }
+
+    char data[REMOTE_BLOCK_SIZE];
+    exportLock->AcquireRead();
+    unsigned length = file->Length();
+    unsigned position = block * REMOTE_BLOCK_SIZE;
+    int count = 0;
+    if (position < length) {
+        count = file->ReadAt(data, REMOTE_BLOCK_SIZE, position);
+    }
+    results->PutInt(length);
+    results->PutInt(exportVersions[file->GetSector()]);
+    exportLock->ReleaseRead();
+    results->PutBytes(data, count > 0 ? count : 0);
+    return RPC_OK;
+}
+
+static RpcStatus
+ServeWrite(RpcArgs *args, RpcArgs *results)
+{
+    int handle, position, count;
+    char data[REMOTE_BLOCK_SIZE];
+    OpenFile *file = GetHandle(args, &handle);
+    if (file == nullptr || !args->GetInt(&position) || position < 0
+          || !args->GetInt(&count) || count <= 0
+          || (unsigned) count > sizeof data
+          || !args->GetBytes(data, count)) {
+        return RPC_BAD_ARGUMENTS;
+    }
+
+    exportLock->AcquireWrite();
+    file->WriteAt(data, count, position);
+    unsigned version = ++exportVersions[file->GetSector()];
+    results->PutInt(file->Length());
+    results->PutInt(version);
+    exportLock->ReleaseWrite();
+    return RPC_OK;
+}
+
+static RpcStatus
+ServeStat(RpcArgs *args, RpcArgs *results)
+{
+    int handle;
+    OpenFile *file = GetHandle(args, &handle);
+    if (file == nullptr) {
+        return RPC_BAD_ARGUMENTS;
+    }
+
+    exportLock->AcquireRead();
+    results->PutInt(file->Length());
+    results->PutInt(exportVersions[file->GetSector()]);
+    exportLock->ReleaseRead();
+    return RPC_OK;
+}
+
+static RpcStatus
+ServeClose(RpcArgs *args, RpcArgs *)
+{
+    int handle;
+    if (!args->GetInt(&handle) || handle < 0) {
+        return RPC_BAD_ARGUMENTS;
+    }
+    handlesLock->Acquire();
+    OpenFile *file = exportHandles->Remove(handle);
+    handlesLock->Release();
+    delete file;
+    return file != nullptr ? RPC_OK : RPC_BAD_ARGUMENTS;
+}
+
+/// Every connection uses `REMOTE_FS_BOX`, so a machine exports its file
+/// system once.
+void
+ExportFileSystem(NetworkAddress client)
+{
+    ASSERT(exportHandles == nullptr);
+
+    exportHandles  = new Table<OpenFile *>;
+    handlesLock    = new Lock("export handles");
+    exportVersions = new unsigned [diskSectors];
+    memset(exportVersions, 0, diskSectors * sizeof *exportVersions);
+    exportLock     = new RWLock("export");
+
+    Connection *c = new Connection(REMOTE_FS_BOX, client, REMOTE_FS_BOX);
+    RpcServer *server = new RpcServer(c);
+    server->Register(FS_OPEN, ServeOpen);
+    server->Register(FS_READ, ServeRead);
+    server->Register(FS_WRITE, ServeWrite);
+    server->Register(FS_STAT, ServeStat);
+    server->Register(FS_CLOSE, ServeClose);
+    server->Start();
+}
+
+RemoteFileSystem::RemoteFileSystem(NetworkAddress server)
+{
+    Connection *c = new Connection(REMOTE_FS_BOX, server, REMOTE_FS_BOX);
+    client = new RpcClient(c);
+    for (unsigned i = 0; i < CACHE_FILES; i++) {
+        files[i].inUse = false;
+    }
+    for (unsigned i = 0; i < CACHE_BLOCKS; i++) {
+        blocks[i].inUse = false;
+    }
+    clock = 0;
+    lock  = new Lock("remote file system");
+}
+
+RemoteFile *
+RemoteFileSystem::Open(const char *name, bool create)
+{
+    ASSERT(name != nullptr);
+
+    RpcArgs args, results;
+    int handle, file, length, version;
+    if (strlen(name) > MAX_REMOTE_PATH || !args.PutInt(create)
+          || !args.PutString(name)
+          || client->Invoke(FS_OPEN, &args, &results) != RPC_OK
+          || !results.GetInt(&handle) || handle < 0
+          || !results.GetInt(&file) || !results.GetInt(&length)
+          || !results.GetInt(&version)) {
+        return nullptr;
+    }
+
+    lock->Acquire();
+    Heard(file, length, version);
+    lock->Release();
+    return new RemoteFile(this, handle, file);
+}
+
+RemoteFileSystem::Attributes *
+RemoteFileSystem::Find(unsigned file)
+{
+    for (unsigned i = 0; i < CACHE_FILES; i++) {
+        if (files[i].inUse && files[i].file == file) {
+            files[i].lastUsed = ++clock;
+            return &files[i];
+        }
+    }
+    return nullptr;
+}
+
+/// Versions are compared by their difference, so that they may wrap.
+RemoteFileSystem::Attributes *
+RemoteFileSystem::Heard(unsigned file, unsigned length, unsigned version)
+{
+    Attributes *a = Find(file);
+    if (a == nullptr) {
+        a = &files[0];
+        for (unsigned i = 0; i < CACHE_FILES && a->inUse; i++) {
+            if (!files[i].inUse || files[i].lastUsed < a->lastUsed) {
+                a = &files[i];
+            }
+        }
+        a->inUse    = true;
+        a->file     = file;
+        a->version  = version;
+        a->lastUsed = ++clock;
+    } else if ((int) (version - a->version) < 0) {
+        return a;
+    }
+    a->length   = length;
+    a->version  = version;
+    a->leaseEnd = stats->totalTicks + LEASE_TICKS;
+    return a;
+}
+
+unsigned
+RemoteFileSystem::Revalidate(int handle, unsigned file)
+{
+    lock->Acquire();
+    Attributes *a = Find(file);
+    if (a != nullptr && stats->totalTicks < a->leaseEnd) {
+        unsigned length = a->length;
+        lock->Release();
+        return length;
+    }
+    lock->Release();
+
+    RpcArgs args, results;
+    int length, version;
+    args.PutInt(handle);
+    if (client->Invoke(FS_STAT, &args, &results) != RPC_OK
+          || !results.GetInt(&length) || !results.GetInt(&version)) {
+        return 0;
+    }
+    lock->Acquire();
+    stats->numRemoteRevalidations++;
+    length = Heard(file, length, version)->length;
+    lock->Release();
+    return length;
+}
+
+RemoteFileSystem::Block *
+RemoteFileSystem::FindBlock(unsigned file, unsigned block)
+{
+    Attributes *a = Find(file);
+    if (a == nullptr) {
+        return nullptr;
+    }
+    for (unsigned i = 0; i < CACHE_BLOCKS; i++) {
+        Block *b = &blocks[i];
+        if (b->inUse && b->file == file && b->block == block
+              && b->version == a->version) {
+            b->lastUsed = ++clock;
+            return b;
+        }
+    }
+    return nullptr;
+}
+
+/// A block of a version older than the one kept could never be found, so
+/// it is not kept.
+void
+RemoteFileSystem::KeepBlock(unsigned file, unsigned block, unsigned version,
+                            const char *data, unsigned length)
+{
+    ASSERT(length <= REMOTE_BLOCK_SIZE);
+
+    Attributes *a = Find(file);
+    if (a == nullptr || a->version != version) {
+        return;
+    }
+    Block *b = &blocks[0];
+    for (unsigned i = 0; i < CACHE_BLOCKS; i++) {
+        Block *c = &blocks[i];
+        if (c->inUse && c->file == file && c->block == block) {
+            b = c;  // Another version of the same block.
+            break;
+        }
+        if (b->inUse && (!c->inUse || c->lastUsed < b->lastUsed)) {
+            b = c;
+        }
+    }
+    b->inUse    = true;
+    b->file     = file;
+    b->block    = block;
+    b->version  = version;
+    b->length   = length;
+    b->lastUsed = ++clock;
+    memcpy(b->data, data, length);
+}
+
+unsigned
+RemoteFileSystem::FinishRead(unsigned callId, unsigned file, unsigned block,
+                             char *into, unsigned offset, unsigned count)
+{
+    RpcArgs results;
+    int length, version;
+    if (client->Wait(callId, &results) != RPC_OK
+          || !results.GetInt(&length) || !results.GetInt(&version)) {
+        return 0;
+    }
+    unsigned start = block * REMOTE_BLOCK_SIZE;
+    unsigned got = 0;
+    if ((unsigned) length > start) {
+        got = (unsigned) length - start < REMOTE_BLOCK_SIZE
+              ? (unsigned) length - start : REMOTE_BLOCK_SIZE;
+    }
+    char data[REMOTE_BLOCK_SIZE];
+    if (!results.GetBytes(data, got)) {
+        return 0;
+    }
+
+    lock->Acquire();
+    stats->numRemoteMisses++;
+    Heard(file, length, version);
+    KeepBlock(file, block, version, data, got);
+    lock->Release();
+
+    if (offset >= got) {
+        return 0;
+    }
+    unsigned n = got - offset < count ? got - offset : count;
+    memcpy(into, data + offset, n);
+    return n;
+}
+
+RemoteFile::RemoteFile(RemoteFileSystem *fs_, int handle_, unsigned file_)
+{
+    fs     = fs_;
+    handle = handle_;
+    file   = file_;
+}
+
+RemoteFile::~RemoteFile()
+{
+    RpcArgs args, results;
+    args.PutInt(handle);
+    fs->client->Invoke(FS_CLOSE, &args, &results);
+}
+
+unsigned
+RemoteFile::Length()
+{
+    return fs->Revalidate(handle, file);
+}
+
+/// Blocks kept are copied at once; the rest are asked for up to
+/// `READ_PIPELINE` at a time, and only then waited for, so that reading
+/// them takes about one round trip rather than one each.
+int
+RemoteFile::ReadAt(char *into, unsigned numBytes, unsigned position)
+{
+    ASSERT(into != nullptr);
+
+    unsigned length = fs->Revalidate(handle, file);
+    if (position >= length) {
+        return 0;
+    }
+    if (numBytes > length - position) {
+        numBytes = length - position;
+    }
+    unsigned end = position + numBytes;
+
+    unsigned done = 0;
+    unsigned block = position / REMOTE_BLOCK_SIZE;
+    while (block * REMOTE_BLOCK_SIZE < end) {
+        unsigned pending[RemoteFileSystem::READ_PIPELINE];
+        unsigned callIds[RemoteFileSystem::READ_PIPELINE];
+        unsigned count = 0;
+        for (; block * REMOTE_BLOCK_SIZE < end
+                 && count < RemoteFileSystem::READ_PIPELINE; block++) {
+            unsigned start = block * REMOTE_BLOCK_SIZE;
+            unsigned from = position > start ? position : start;
+            unsigned to = end < start + REMOTE_BLOCK_SIZE
+                          ? end : start + REMOTE_BLOCK_SIZE;
+
+            fs->lock->Acquire();
+            RemoteFileSystem::Block *b = fs->FindBlock(file, block);
+            if (b != nullptr && b->length >= to - start) {
+                memcpy(into + from - position, b->data + from - start,
+                       to - from);
+                stats->numRemoteHits++;
+                fs->lock->Release();
+                done += to - from;
+                continue;
+            }
+            fs->lock->Release();
+
+            RpcArgs args;
+            args.PutInt(handle);
+            args.PutInt(block);
+            callIds[count] = fs->client->Call(FS_READ, &args);
+            pending[count] = block;
+            count++;
+        }
+        for (unsigned i = 0; i < count; i++) {
+            unsigned start = pending[i] * REMOTE_BLOCK_SIZE;
+            unsigned from = position > start ? position : start;
+            unsigned to = end < start + REMOTE_BLOCK_SIZE
+                          ? end : start + REMOTE_BLOCK_SIZE;
+            done += fs->FinishRead(callIds[i], file, pending[i],
+                                   into + from - position, from - start,
+                                   to - from);
+        }
+    }
+    return done;
+}
+
+/// The write is sent a block at a time.  If the server says that it made
+/// the version right after the one kept, nobody else wrote in between, so
+/// the blocks kept are still good once the write is applied to them; else
+/// they are left behind, with the old version.  A partial block is dropped,
+/// as the write may have made the file grow past it.
+int
+RemoteFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
+{
+    ASSERT(from != nullptr);
+
+    unsigned written = 0;
+    while (written < numBytes) {
+        unsigned at = position + written;
+        unsigned block = at / REMOTE_BLOCK_SIZE;
+        unsigned offset = at % REMOTE_BLOCK_SIZE;
+        unsigned count = REMOTE_BLOCK_SIZE - offset < numBytes - written
+                         ? REMOTE_BLOCK_SIZE - offset : numBytes - written;
+
+        RpcArgs args, results;
+        int length, version;
+        args.PutInt(handle);
+        args.PutInt(at);
+        args.PutInt(count);
+        args.PutBytes(from + written, count);
+        if (fs->client->Invoke(FS_WRITE, &args, &results) != RPC_OK
+              || !results.GetInt(&length) || !results.GetInt(&version)) {
+            break;
+        }
+
+        fs->lock->Acquire();
+        RemoteFileSystem::Attributes *a = fs->Find(file);
+        if (a != nullptr && a->version + 1 == (unsigned) version) {
+            for (unsigned i = 0; i < RemoteFileSystem::CACHE_BLOCKS; i++) {
+                RemoteFileSystem::Block *b = &fs->blocks[i];
+                if (!b->inUse || b->file != file || b->version != a->version) {
+                    continue;
+                }
+                if (b->block == block) {
+                    if (b->length < offset) {
+                        memset(b->data + b->length, 0, offset - b->length);
+                    }
+                    memcpy(b->data + offset, from + written, count);
+                    if (b->length < offset + count) {
+                        b->length = offset + count;
+                    }
+                } else if (b->length < REMOTE_BLOCK_SIZE) {
+                    b->inUse = false;
+                    continue;
+                }
+                b->version = version;
+            }
+        }
+        fs->Heard(file, length, version);
+        fs->lock->Release();
+        written += count;
+    }
+    return written;
+}
+
+
+#endif
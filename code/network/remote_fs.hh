@@ -0,0 +1,156 @@
+/// Data structures to reach the file system of another machine.
+///
+/// One machine exports its `FileSystem`, with `ExportFileSystem`, serving
+/// remote procedure calls to open, create, read and write its files; other
+/// machines reach them through a `RemoteFileSystem`.
+///
+/// Clients keep the blocks they read, and the length and version of each
+/// file, so that hot reads stay local.  The server gives each file a
+/// version, which every write through it changes, and every block kept is
+/// of a version.  What a client knows of a file is trusted for a lease of
+/// `LEASE_TICKS` from when it last heard of the file, measured by its own
+/// clock; once the lease runs out, the next read asks the server for the
+/// version again, and blocks of any other version are no longer used.  So
+/// a client may read data up to a lease old, but never older, and asks
+/// nothing of the server while the lease lasts.  Writes go straight to the
+/// server, and are applied to the blocks the writer keeps.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_NETWORK_REMOTEFS__HH
+#define NACHOS_NETWORK_REMOTEFS__HH
+
+
+#include "rpc.hh"
+#include "threads/lock.hh"
+
+
+/// Bytes of a file read from the server at once, and kept as a block.
+const unsigned REMOTE_BLOCK_SIZE = 256;
+
+/// Ticks for which a client trusts what it keeps of a file.
+const unsigned long LEASE_TICKS = 1000 * NETWORK_TIME;
+
+/// Longest path of a remote file.
+const unsigned MAX_REMOTE_PATH = 128;
+
+/// Mailbox of the connection to export a file system over, on both ends.
+const MailBoxAddress REMOTE_FS_BOX = 5;
+
+class RemoteFileSystem;
+
+/// A file of the server, open on a client.
+class RemoteFile {
+public:
+
+    /// Close the file on the server.
+    ~RemoteFile();
+
+    /// Read/write bytes from the file, as `OpenFile` does; writes past the
+    /// end make the file grow.  Return the number of bytes read/written.
+    int ReadAt(char *into, unsigned numBytes, unsigned position);
+    int WriteAt(const char *from, unsigned numBytes, unsigned position);
+
+    /// Length of the file, as of the lease.
+    unsigned Length();
+
+private:
+    friend class RemoteFileSystem;
+
+    RemoteFile(RemoteFileSystem *fs, int handle, unsigned file);
+
+    RemoteFileSystem *fs;
+    int handle;     ///< Of the file open on the server.
+    unsigned file;  ///< Identity of the file on the server.
+};
+
+/// The file system of the server, as seen from a client.
+class RemoteFileSystem {
+public:
+
+    /// Blocks kept, and files whose attributes are kept.
+    static const unsigned CACHE_BLOCKS = 64;
+    static const unsigned CACHE_FILES = 16;
+
+    /// Blocks missing from the cache asked for at once by a read, rather
+    /// than one round trip each.  Below `RpcClient::MAX_OUTSTANDING`.
+    static const unsigned READ_PIPELINE = 8;
+
+    /// Initialize a client for the file system exported by the machine with
+    /// ID `server`.
+    RemoteFileSystem(NetworkAddress server);
+
+    /// Open the file `name` of the server, creating it, empty, if `create`
+    /// and it does not exist; return null if it cannot be.
+    RemoteFile *Open(const char *name, bool create = false);
+
+private:
+    friend class RemoteFile;
+
+    /// What is kept of a file: its length and version, and until when they
+    /// are trusted.
+    class Attributes {
+    public:
+        bool inUse;
+        unsigned file;
+        unsigned length;
+        unsigned version;
+        unsigned long leaseEnd;
+        unsigned long lastUsed;
+    };
+
+    /// A block kept, of a version of a file.
+    class Block {
+    public:
+        bool inUse;
+        unsigned file;
+        unsigned block;
+        unsigned version;
+        unsigned length;  ///< Bytes of the file in the block.
+        unsigned long lastUsed;
+        char data[REMOTE_BLOCK_SIZE];
+    };
+
+    /// The attributes kept of `file`, or null.  The lock must be held.
+    Attributes *Find(unsigned file);
+
+    /// Record what the server said of `file`, renewing its lease, and
+    /// return the attributes kept.  What is older than what is kept is
+    /// ignored, as replies may come out of order.  The lock must be held.
+    Attributes *Heard(unsigned file, unsigned length, unsigned version);
+
+    /// Ask the server for the attributes of `file`, open as `handle`, if
+    /// their lease ran out, and return their length.
+    unsigned Revalidate(int handle, unsigned file);
+
+    /// Wait for call `callId`, which read block `block` of `file`, keep the
+    /// block, and copy up to `count` bytes of it, from `offset` on, into
+    /// `into`.  Return the bytes copied.
+    unsigned FinishRead(unsigned callId, unsigned file, unsigned block,
+                        char *into, unsigned offset, unsigned count);
+
+    /// The block kept of the current version of `file`, or null.  The lock
+    /// must be held.
+    Block *FindBlock(unsigned file, unsigned block);
+
+    /// Keep `length` bytes of `data` as block `block` of `file`, version
+    /// `version`.  The lock must be held.
+    void KeepBlock(unsigned file, unsigned block, unsigned version,
+                   const char *data, unsigned length);
+
+    RpcClient *client;
+
+    Attributes files[CACHE_FILES];
+    Block blocks[CACHE_BLOCKS];
+    unsigned long clock;  ///< Counts uses, to find the least recently used.
+    Lock *lock;
+};
+
+/// Serve the file system of this machine to the machine with ID `client`,
+/// with a connection of its own.
+void ExportFileSystem(NetworkAddress client);
+
+
+#endif
@@ -0,0 +1,361 @@
+/// Routines for remote procedure calls between machines.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "rpc.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+RpcArgs::RpcArgs()
+{
+    Clear();
+}
+
+void
+RpcArgs::Clear()
+{
+    length   = 0;
+    position = 0;
+}
+
+bool
+RpcArgs::PutBytes(const char *bytes, unsigned count)
+{
+    ASSERT(bytes != nullptr || count == 0);
+
+    if (count > MAX_SIZE - length) {
+        return false;
+    }
+    memcpy(&data[length], bytes, count);
+    length += count;
+    return true;
+}
+
+bool
+RpcArgs::PutInt(int value)
+{
+    return PutBytes((const char *) &value, sizeof value);
+}
+
+/// A string goes as its length, and then its bytes, without the null.
+bool
+RpcArgs::PutString(const char *string)
+{
+    ASSERT(string != nullptr);
+
+    int count = strlen(string);
+    if (sizeof count + count > MAX_SIZE - length) {
+        return false;
+    }
+    PutInt(count);
+    PutBytes(string, count);
+    return true;
+}
+
+bool
+RpcArgs::GetBytes(char *bytes, unsigned count)
+{
+    ASSERT(bytes != nullptr || count == 0);
+
+    if (count > length - position) {
+        return false;
+    }
+    memcpy(bytes, &data[position], count);
+    position += count;
+    return true;
+}
+
+bool
+RpcArgs::GetInt(int *value)
+{
+    ASSERT(value != nullptr);
+
+    return GetBytes((char *) value, sizeof *value);
+}
+
+bool
+RpcArgs::GetString(char *string, unsigned size)
+{
+    ASSERT(string != nullptr);
+    ASSERT(size > 0);
+
+    int count;
+    if (length - position < sizeof count) {
+        return false;
+    }
+    memcpy(&count, &data[position], sizeof count);
+    if (count < 0 || (unsigned) count >= size
+          || (unsigned) count > length - position - sizeof count) {
+        return false;
+    }
+    position += sizeof count;
+    GetBytes(string, count);
+    string[count] = '\0';
+    return true;
+}
+
+const char *
+RpcArgs::GetData() const
+{
+    return data;
+}
+
+unsigned
+RpcArgs::GetLength() const
+{
+    return length;
+}
+
+void
+RpcArgs::SetData(const char *data_, unsigned length_)
+{
+    ASSERT(data_ != nullptr || length_ == 0);
+    ASSERT(length_ <= MAX_SIZE);
+
+    memcpy(data, data_, length_);
+    length   = length_;
+    position = 0;
+}
+
+/// Put `header` and `args` together into `message`, which must hold
+/// `MAX_RPC_MESSAGE` bytes, and return its length.
+static unsigned
+Pack(const RpcHeader *header, const RpcArgs *args, char *message)
+{
+    memcpy(message, header, sizeof *header);
+    memcpy(message + sizeof *header, args->GetData(), args->GetLength());
+    return sizeof *header + args->GetLength();
+}
+
+/// Take `message`, of `length` bytes, apart into `header` and `args`, and
+/// return true, if it is long enough to be a call or reply.
+static bool
+Unpack(const char *message, unsigned length, RpcHeader *header,
+       RpcArgs *args)
+{
+    if (length < sizeof *header || length > MAX_RPC_MESSAGE) {
+        return false;
+    }
+    memcpy(header, message, sizeof *header);
+    args->SetData(message + sizeof *header, length - sizeof *header);
+    return true;
+}
+
+static void
+ClientReceiveHelper(void *client)
+{
+    ((RpcClient *) client)->ReceiveLoop();
+}
+
+RpcClient::RpcClient(Connection *connection_)
+{
+    ASSERT(connection_ != nullptr);
+
+    connection = connection_;
+    nextCallId = 0;
+    for (unsigned i = 0; i < MAX_OUTSTANDING; i++) {
+        calls[i].inUse = false;
+    }
+    lock     = new Lock("rpc client");
+    replied  = new Condition("rpc client replied", lock);
+    slotFree = new Condition("rpc client slot free", lock);
+
+    Thread *t = new Thread("rpc client receiver", false, PRIORITY_DEFAULT);
+    t->Fork(ClientReceiveHelper, this);
+}
+
+/// The call is sent without the lock held, as sending waits for the
+/// window; the slot taken for it before makes sure its reply finds it.
+unsigned
+RpcClient::Call(unsigned procedure, const RpcArgs *args)
+{
+    ASSERT(args != nullptr);
+
+    lock->Acquire();
+    unsigned slot;
+    for (;;) {
+        for (slot = 0; slot < MAX_OUTSTANDING && calls[slot].inUse; slot++) {
+            ;
+        }
+        if (slot < MAX_OUTSTANDING) {
+            break;
+        }
+        slotFree->Wait();
+    }
+    RpcHeader header;
+    header.callId    = nextCallId++;
+    header.procedure = procedure;
+    header.status    = RPC_OK;
+    calls[slot].inUse   = true;
+    calls[slot].callId  = header.callId;
+    calls[slot].replied = false;
+    lock->Release();
+
+    char message[MAX_RPC_MESSAGE];
+    unsigned length = Pack(&header, args, message);
+    DEBUG('n', "RPC: call %u to procedure %u\n", header.callId, procedure);
+    connection->Send(message, length);
+    return header.callId;
+}
+
+RpcStatus
+RpcClient::Wait(unsigned callId, RpcArgs *results)
+{
+    ASSERT(results != nullptr);
+
+    lock->Acquire();
+    unsigned slot;
+    for (slot = 0; slot < MAX_OUTSTANDING; slot++) {
+        if (calls[slot].inUse && calls[slot].callId == callId) {
+            break;
+        }
+    }
+    ASSERT(slot < MAX_OUTSTANDING);
+    while (!calls[slot].replied) {
+        replied->Wait();
+    }
+    RpcStatus status = calls[slot].status;
+    *results = calls[slot].results;
+    calls[slot].inUse = false;
+    slotFree->Signal();
+    lock->Release();
+    return status;
+}
+
+RpcStatus
+RpcClient::Invoke(unsigned procedure, const RpcArgs *args, RpcArgs *results)
+{
+    return Wait(Call(procedure, args), results);
+}
+
+/// A reply to no call outstanding is ignored.
+void
+RpcClient::ReceiveLoop()
+{
+    char message[MAX_RPC_MESSAGE];
+    RpcHeader header;
+    RpcArgs results;
+
+    for (;;) {
+        unsigned length = connection->Receive(message, sizeof message);
+        if (!Unpack(message, length, &header, &results)) {
+            continue;
+        }
+
+        lock->Acquire();
+        for (unsigned slot = 0; slot < MAX_OUTSTANDING; slot++) {
+            Outstanding *c = &calls[slot];
+            if (c->inUse && !c->replied && c->callId == header.callId) {
+                DEBUG('n', "RPC: reply to call %u\n", header.callId);
+                c->replied = true;
+                c->status  = (RpcStatus) header.status;
+                c->results = results;
+                replied->Broadcast();
+                break;
+            }
+        }
+        lock->Release();
+    }
+}
+
+static void
+ServerReceiveHelper(void *server)
+{
+    ((RpcServer *) server)->ReceiveLoop();
+}
+
+static void
+ServerWorkHelper(void *server)
+{
+    ((RpcServer *) server)->WorkLoop();
+}
+
+RpcServer::RpcServer(Connection *connection_, unsigned workers)
+{
+    ASSERT(connection_ != nullptr);
+    ASSERT(workers > 0);
+
+    connection = connection_;
+    numWorkers = workers;
+    for (unsigned i = 0; i < MAX_PROCEDURES; i++) {
+        procedures[i] = nullptr;
+    }
+    requests = new SynchList<Request *>;
+}
+
+void
+RpcServer::Register(unsigned procedure, RpcProcedure function)
+{
+    ASSERT(procedure < MAX_PROCEDURES);
+    ASSERT(function != nullptr);
+
+    procedures[procedure] = function;
+}
+
+void
+RpcServer::Start()
+{
+    Thread *t = new Thread("rpc server receiver", false, PRIORITY_DEFAULT);
+    t->Fork(ServerReceiveHelper, this);
+    for (unsigned i = 0; i < numWorkers; i++) {
+        t = new Thread("rpc server worker", false, PRIORITY_DEFAULT);
+        t->Fork(ServerWorkHelper, this);
+    }
+}
+
+void
+RpcServer::ReceiveLoop()
+{
+    char message[MAX_RPC_MESSAGE];
+    RpcHeader header;
+
+    for (;;) {
+        unsigned length = connection->Receive(message, sizeof message);
+        Request *r = new Request;
+        if (!Unpack(message, length, &header, &r->args)) {
+            delete r;
+            continue;
+        }
+        r->callId    = header.callId;
+        r->procedure = header.procedure;
+        requests->Append(r);
+    }
+}
+
+void
+RpcServer::WorkLoop()
+{
+    RpcArgs results;
+
+    for (;;) {
+        Request *r = requests->Pop();
+        results.Clear();
+        RpcStatus status = RPC_NO_PROCEDURE;
+        if (r->procedure < MAX_PROCEDURES
+              && procedures[r->procedure] != nullptr) {
+            DEBUG('n', "RPC: serving call %u to procedure %u\n",
+                  r->callId, r->procedure);
+            status = procedures[r->procedure](&r->args, &results);
+        }
+        Reply(r->callId, status, &results);
+        delete r;
+    }
+}
+
+void
+RpcServer::Reply(unsigned callId, RpcStatus status, const RpcArgs *results)
+{
+    RpcHeader header;
+    header.callId    = callId;
+    header.procedure = 0;
+    header.status    = status;
+
+    char message[MAX_RPC_MESSAGE];
+    unsigned length = Pack(&header, results, message);
+    connection->Send(message, length);
+}
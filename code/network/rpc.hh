@@ -0,0 +1,187 @@
+/// Data structures for remote procedure calls between machines, over a
+/// `Connection`.
+///
+/// A call is a message with a call id, the number of the procedure, and
+/// its arguments, marshalled in an `RpcArgs`; the reply carries the same
+/// call id, a status and the results.  As the connection is reliable, no
+/// call is lost or made twice.
+///
+/// The client need not wait for a reply before making the next call: up to
+/// `RpcClient::MAX_OUTSTANDING` calls can be in flight at once, and each is
+/// waited for by its id, so that a client is not held to one call per round
+/// trip.  The server hands calls to a pool of worker threads, so that a
+/// slow call does not hold up the rest; replies may then go back in another
+/// order than the calls came.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_NETWORK_RPC__HH
+#define NACHOS_NETWORK_RPC__HH
+
+
+#include "transport.hh"
+#include "threads/condition.hh"
+#include "threads/lock.hh"
+#include "threads/synch_list.hh"
+
+
+/// Status of a call.
+enum RpcStatus {
+    RPC_OK,
+    RPC_NO_PROCEDURE,  ///< The server has no such procedure.
+    RPC_BAD_ARGUMENTS  ///< The procedure could not make sense of them.
+};
+
+/// Arguments or results of a call, marshalled one after another, and read
+/// back in the same order.  Every `Put` and `Get` returns false, changing
+/// nothing, if there is no room left, or nothing of the kind left to get.
+class RpcArgs {
+public:
+
+    /// Most bytes that the arguments of a call can take.
+    static const unsigned MAX_SIZE = 512;
+
+    /// Initialize empty arguments.
+    RpcArgs();
+
+    /// Empty the arguments.
+    void Clear();
+
+    bool PutInt(int value);
+    bool PutBytes(const char *bytes, unsigned count);
+    bool PutString(const char *string);
+
+    bool GetInt(int *value);
+    bool GetBytes(char *bytes, unsigned count);
+
+    /// Get a string into `string`, which holds `size` bytes, null included.
+    bool GetString(char *string, unsigned size);
+
+    /// The marshalled arguments, and their size.
+    const char *GetData() const;
+    unsigned GetLength() const;
+
+    /// Replace the arguments by the `length` bytes at `data`, to be read
+    /// from the start.
+    void SetData(const char *data, unsigned length);
+
+private:
+    char data[MAX_SIZE];
+    unsigned length;    ///< Bytes put.
+    unsigned position;  ///< Bytes gotten.
+};
+
+/// The header of every call and reply.
+class RpcHeader {
+public:
+    unsigned callId;
+    unsigned procedure;
+    int status;  ///< For a reply, an `RpcStatus`.
+};
+
+/// Most bytes of a call or reply on the connection.
+const unsigned MAX_RPC_MESSAGE = sizeof (RpcHeader) + RpcArgs::MAX_SIZE;
+
+/// The calling end of a connection.  A thread of its own takes the replies
+/// and hands each to the thread waiting for it.
+class RpcClient {
+public:
+
+    /// Calls that can wait for a reply at once.
+    static const unsigned MAX_OUTSTANDING = 16;
+
+    /// Initialize a client that calls over `connection`, which nothing else
+    /// may use.
+    RpcClient(Connection *connection);
+
+    /// Call `procedure` with `args`, and return the id of the call, without
+    /// waiting for the reply.  Wait while `MAX_OUTSTANDING` calls are.
+    unsigned Call(unsigned procedure, const RpcArgs *args);
+
+    /// Wait for the reply to call `callId`, put its results in `results`,
+    /// and return its status.  Each call must be waited for once.
+    RpcStatus Wait(unsigned callId, RpcArgs *results);
+
+    /// Call and wait, as most callers want.
+    RpcStatus Invoke(unsigned procedure, const RpcArgs *args,
+                     RpcArgs *results);
+
+    /// Take replies, forever.  Run by the receiving thread.
+    void ReceiveLoop();
+
+private:
+
+    /// A call made and not yet waited for.
+    class Outstanding {
+    public:
+        bool inUse;
+        unsigned callId;
+        bool replied;
+        RpcStatus status;
+        RpcArgs results;
+    };
+
+    Connection *connection;
+    unsigned nextCallId;
+
+    Outstanding calls[MAX_OUTSTANDING];
+    Lock *lock;
+    Condition *replied;   ///< Signalled when a reply arrives.
+    Condition *slotFree;  ///< Signalled when a call is waited for.
+};
+
+/// A procedure served: read the arguments from `args`, and put the results
+/// in `results`.
+typedef RpcStatus (*RpcProcedure)(RpcArgs *args, RpcArgs *results);
+
+/// The serving end of a connection.  One thread takes the calls, and a pool
+/// of workers carries them out.
+class RpcServer {
+public:
+
+    /// Numbers of procedures are below this.
+    static const unsigned MAX_PROCEDURES = 32;
+
+    /// Workers unless told otherwise.
+    static const unsigned DEFAULT_WORKERS = 4;
+
+    /// Initialize a server for calls over `connection`, which nothing else
+    /// may use, with `workers` threads to carry them out.
+    RpcServer(Connection *connection, unsigned workers = DEFAULT_WORKERS);
+
+    /// Serve `procedure` with `function`.  Every procedure must be
+    /// registered before `Start`.
+    void Register(unsigned procedure, RpcProcedure function);
+
+    /// Start taking calls.
+    void Start();
+
+    /// Take calls, forever.  Run by the receiving thread.
+    void ReceiveLoop();
+
+    /// Carry out calls, forever.  Run by each worker.
+    void WorkLoop();
+
+private:
+
+    /// A call taken and not yet carried out.
+    class Request {
+    public:
+        unsigned callId;
+        unsigned procedure;
+        RpcArgs args;
+    };
+
+    /// Send the reply to call `callId`.
+    void Reply(unsigned callId, RpcStatus status, const RpcArgs *results);
+
+    Connection *connection;
+    unsigned numWorkers;
+    RpcProcedure procedures[MAX_PROCEDURES];
+    SynchList<Request *> *requests;
+};
+
+
+#endif
@@ -0,0 +1,262 @@
+/// Routines for reliable, ordered delivery of messages between two
+/// mailboxes.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "transport.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+static void
+ReceiveHelper(void *connection)
+{
+    ((Connection *) connection)->ReceiveLoop();
+}
+
+static void
+RetransmitHelper(void *connection)
+{
+    ((Connection *) connection)->RetransmitLoop();
+}
+
+Connection::Connection(MailBoxAddress localBox_, NetworkAddress farAddr_,
+                       MailBoxAddress farBox_, unsigned window_)
+{
+    ASSERT(window_ > 0);
+
+    localBox = localBox_;
+    farAddr  = farAddr_;
+    farBox   = farBox_;
+    window   = window_;
+
+    lock       = new Lock("connection");
+    sendLock   = new Lock("connection send");
+    sent       = new Segment [window];
+    base       = 0;
+    nextSeq    = 0;
+    timerStart = 0;
+    windowOpen = new Condition("connection window open", lock);
+    inFlight   = new Condition("connection in flight", lock);
+
+    expected  = 0;
+    early     = new Segment [window];
+    haveEarly = new bool [window];
+    for (unsigned i = 0; i < window; i++) {
+        haveEarly[i] = false;
+    }
+    delivered = new List<Segment *>;
+    arrived   = new Condition("connection arrived", lock);
+
+    Thread *t = new Thread("connection receiver", false, PRIORITY_DEFAULT);
+    t->Fork(ReceiveHelper, this);
+    t = new Thread("connection timer", false, PRIORITY_DEFAULT);
+    t->Fork(RetransmitHelper, this);
+}
+
+void
+Connection::Send(const char *data, unsigned length)
+{
+    ASSERT(data != nullptr || length == 0);
+
+    sendLock->Acquire();
+    do {
+        unsigned piece = length < MAX_SEGMENT_SIZE ? length
+                                                   : MAX_SEGMENT_SIZE;
+        SendSegment(piece < length, data, piece);
+        data   += piece;
+        length -= piece;
+    } while (length > 0);
+    sendLock->Release();
+}
+
+void
+Connection::SendSegment(bool more, const char *data, unsigned length)
+{
+    lock->Acquire();
+    while (nextSeq - base >= window) {
+        windowOpen->Wait();
+    }
+    unsigned seq = nextSeq++;
+    Segment *s = &sent[seq % window];
+    s->more   = more;
+    s->length = length;
+    if (length > 0) {
+        memcpy(s->data, data, length);
+    }
+    if (seq == base) {
+        timerStart = stats->totalTicks;
+        inFlight->Signal();
+    }
+    lock->Release();
+
+    Transmit(false, more, seq, data, length);
+}
+
+unsigned
+Connection::Receive(char *data, unsigned size)
+{
+    ASSERT(data != nullptr || size == 0);
+
+    unsigned length = 0;
+    bool more;
+    lock->Acquire();
+    do {
+        while (delivered->IsEmpty()) {
+            arrived->Wait();
+        }
+        Segment *s = delivered->Pop();
+        if (length < size) {
+            unsigned piece = size - length < s->length ? size - length
+                                                       : s->length;
+            memcpy(data + length, s->data, piece);
+        }
+        length += s->length;
+        more = s->more;
+        delete s;
+    } while (more);
+    lock->Release();
+    return length;
+}
+
+void
+Connection::Drain()
+{
+    lock->Acquire();
+    while (base != nextSeq) {
+        windowOpen->Wait();
+    }
+    lock->Release();
+}
+
+void
+Connection::Transmit(bool ack, bool more, unsigned seq, const char *data,
+                     unsigned length)
+{
+    char buffer[MAX_MAIL_SIZE];
+    SegmentHeader *header = (SegmentHeader *) buffer;
+    header->ack    = ack;
+    header->more   = more;
+    header->seq    = seq;
+    header->length = length;
+    if (length > 0) {
+        memcpy(buffer + sizeof *header, data, length);
+    }
+
+    PacketHeader pktHdr;
+    MailHeader   mailHdr;
+    pktHdr.to      = farAddr;
+    mailHdr.to     = farBox;
+    mailHdr.from   = localBox;
+    mailHdr.length = sizeof *header + length;
+    postOffice->Send(pktHdr, mailHdr, buffer);
+}
+
+void
+Connection::ReceiveLoop()
+{
+    PacketHeader pktHdr;
+    MailHeader   mailHdr;
+    char buffer[MAX_MAIL_SIZE];
+
+    for (;;) {
+        postOffice->Receive(localBox, &pktHdr, &mailHdr, buffer);
+        const SegmentHeader *header = (const SegmentHeader *) buffer;
+        if (pktHdr.from != farAddr || mailHdr.length < sizeof *header
+              || header->length > mailHdr.length - sizeof *header) {
+            continue;  // Not for this connection.
+        }
+        if (header->ack) {
+            HandleAck(header);
+        } else {
+            HandleData(header, buffer + sizeof *header);
+        }
+    }
+}
+
+/// An ACK for segments not in flight is stale, and ignored.
+void
+Connection::HandleAck(const SegmentHeader *header)
+{
+    lock->Acquire();
+    unsigned acked = header->seq - base;
+    if (acked > 0 && acked <= nextSeq - base) {
+        DEBUG('n', "Connection: segments up to %u acknowledged\n",
+              header->seq - 1);
+        base = header->seq;
+        timerStart = stats->totalTicks;
+        windowOpen->Broadcast();
+    }
+    lock->Release();
+}
+
+/// Every segment is answered with an ACK, even one already received, as
+/// the ACK sent for it before may have been lost.
+void
+Connection::HandleData(const SegmentHeader *header, const char *data)
+{
+    lock->Acquire();
+    unsigned ahead = header->seq - expected;
+    if (ahead < window && !haveEarly[header->seq % window]) {
+        Segment *s = &early[header->seq % window];
+        s->more   = header->more;
+        s->length = header->length;
+        memcpy(s->data, data, header->length);
+        haveEarly[header->seq % window] = true;
+    }
+    while (haveEarly[expected % window]) {
+        Segment *s = new Segment;
+        *s = early[expected % window];
+        haveEarly[expected % window] = false;
+        delivered->Append(s);
+        expected++;
+        arrived->Signal();
+    }
+    unsigned next = expected;
+    lock->Release();
+
+    Transmit(true, false, next, nullptr, 0);
+}
+
+/// The thread sleeps until the oldest segment in flight is due; if it is
+/// still not acknowledged by then, the whole window goes out again, and
+/// its timer starts over.
+void
+Connection::RetransmitLoop()
+{
+    Segment *copies = new Segment [window];
+
+    for (;;) {
+        lock->Acquire();
+        while (base == nextSeq) {
+            inFlight->Wait();
+        }
+        unsigned long due = timerStart + RETRANSMIT_TICKS;
+        if (stats->totalTicks < due) {
+            unsigned long wait = due - stats->totalTicks;
+            lock->Release();
+            alarmClock->WaitUntil(wait);
+            continue;
+        }
+
+        unsigned first = base;
+        unsigned count = nextSeq - base;
+        for (unsigned i = 0; i < count; i++) {
+            copies[i] = sent[(first + i) % window];
+        }
+        timerStart = stats->totalTicks;
+        stats->numRetransmissions += count;
+        lock->Release();
+
+        DEBUG('n', "Connection: sending segments %u to %u again\n",
+              first, first + count - 1);
+        for (unsigned i = 0; i < count; i++) {
+            Transmit(false, copies[i].more, first + i, copies[i].data,
+                     copies[i].length);
+        }
+    }
+}
@@ -0,0 +1,145 @@
+/// Data structures for reliable, ordered delivery of messages between two
+/// mailboxes, on top of the unreliable `PostOffice`.
+///
+/// A message is carried by as many segments as it takes, numbered in the
+/// order they were sent, so that messages of any size can be sent; all but
+/// the last segment of a message are marked as having more to follow.  As
+/// segments are delivered reliably and in order, a message is put back
+/// together just by appending them, and the fragments of a big message
+/// fill the window like any other segments.  The receiver acknowledges segments cumulatively: an ACK carries
+/// the number of the next segment it expects, so that a lost ACK is made up
+/// for by any later one.  The sender keeps up to a window of segments sent
+/// and not yet acknowledged, rather than waiting for each ACK in turn, so
+/// that on a lossy link the throughput is bounded by the window instead of
+/// by one round trip per message.  If the oldest of them is not
+/// acknowledged within `RETRANSMIT_TICKS`, every segment in the window is
+/// sent again (“go back N”).  The receiver keeps segments that arrive ahead
+/// of a missing one, within the window, so that they need not be sent
+/// again once it arrives.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_NETWORK_TRANSPORT__HH
+#define NACHOS_NETWORK_TRANSPORT__HH
+
+
+#include "post.hh"
+#include "lib/list.hh"
+#include "machine/statistics.hh"
+#include "threads/condition.hh"
+#include "threads/lock.hh"
+
+
+/// The part of the message header added by the transport, after the
+/// `MailHeader`.
+class SegmentHeader {
+public:
+    bool     ack;     ///< Whether this is an ACK rather than data.
+    bool     more;    ///< Whether more segments of the same message follow.
+    unsigned seq;     ///< Number of the segment, or, in an ACK, of the
+                      ///< next segment expected.
+    unsigned length;  ///< Bytes of message data.
+};
+
+/// Most bytes of a message carried by one segment.
+const unsigned MAX_SEGMENT_SIZE = MAX_MAIL_SIZE - sizeof (SegmentHeader);
+
+/// One end of a reliable connection between mailbox `localBox` on this
+/// machine and mailbox `farBox` on machine `farAddr`.  Both data and
+/// acknowledgements arrive in `localBox`, which nothing else may use.
+///
+/// Two threads of the connection run forever: one takes what arrives in
+/// the mailbox, and the other sends segments again when they time out.
+class Connection {
+public:
+
+    /// Segments in flight unless told otherwise.
+    static const unsigned DEFAULT_WINDOW = 8;
+
+    /// Ticks the oldest segment in flight waits for its ACK before the
+    /// window is sent again.  Machines keep their own clocks, and an idle
+    /// one runs its clock fast, so this is generous.
+    static const unsigned long RETRANSMIT_TICKS = 40 * NETWORK_TIME;
+
+    /// Initialize a connection with up to `window` segments in flight, and
+    /// start its threads.
+    Connection(MailBoxAddress localBox, NetworkAddress farAddr,
+               MailBoxAddress farBox, unsigned window = DEFAULT_WINDOW);
+
+    /// Send the `length` bytes of `data`, as many segments as it takes.
+    /// Wait while the window is full; return once the last segment is
+    /// sent, although it may not be acknowledged yet.
+    void Send(const char *data, unsigned length);
+
+    /// Wait for the next message, in order, and copy up to `size` bytes of
+    /// it into `data`; the rest of it is dropped.  Return its length.
+    unsigned Receive(char *data, unsigned size);
+
+    /// Wait until every segment sent is acknowledged.
+    void Drain();
+
+    /// Take what arrives in the mailbox, forever.  Run by the receiving
+    /// thread.
+    void ReceiveLoop();
+
+    /// Send segments again once they time out, forever.  Run by the
+    /// retransmitting thread.
+    void RetransmitLoop();
+
+private:
+
+    /// A segment kept by either end.
+    class Segment {
+    public:
+        bool more;
+        unsigned length;
+        char data[MAX_SEGMENT_SIZE];
+    };
+
+    /// Send one segment of a message, as `Send` does.
+    void SendSegment(bool more, const char *data, unsigned length);
+
+    /// Put a segment on the network.  The lock must not be held, as this
+    /// waits for the network.
+    void Transmit(bool ack, bool more, unsigned seq, const char *data,
+                  unsigned length);
+
+    /// Handle the ACK or the data in `header`, and the `data` following it.
+    void HandleAck(const SegmentHeader *header);
+    void HandleData(const SegmentHeader *header, const char *data);
+
+    MailBoxAddress localBox;
+    NetworkAddress farAddr;
+    MailBoxAddress farBox;
+    unsigned window;
+
+    Lock *lock;
+
+    /// Held while a message is sent, so that the segments of messages sent
+    /// by different threads do not mingle.
+    Lock *sendLock;
+
+    /// Sending end: segments `base` to `nextSeq - 1` are in flight, each in
+    /// `sent[seq % window]`; the oldest has been waiting since
+    /// `timerStart`.
+    Segment *sent;
+    unsigned base;
+    unsigned nextSeq;
+    unsigned long timerStart;
+    Condition *windowOpen;  ///< Signalled when segments are acknowledged.
+    Condition *inFlight;   ///< Signalled when the window stops being empty.
+
+    /// Receiving end: the next segment expected; segments after it that
+    /// arrived already, in `early[seq % window]` if `haveEarly` says so; and
+    /// messages waiting for `Receive`, in order.
+    unsigned expected;
+    Segment *early;
+    bool *haveEarly;
+    List<Segment *> *delivered;
+    Condition *arrived;  ///< Signalled when `delivered` grows.
+};
+
+
+#endif
@@ -0,0 +1,96 @@
+/// Routines to let threads sleep for a while.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "alarm.hh"
+#include "system.hh"
+
+
+/// Wake up the thread `arg`, whose time is up.
+static void
+AlarmHandler(void *arg)
+{
+    Thread *sleeper = (Thread *) arg;
+    DEBUG('t', "Waking up thread \"%s\"\n", sleeper->GetName());
+    scheduler->ReadyToRun(sleeper);
+}
+
+void
+Alarm::WaitUntil(unsigned long ticks)
+{
+    if (ticks == 0) {
+        currentThread->Yield();
+        return;
+    }
+
+    DEBUG('t', "Thread \"%s\" sleeping for %lu ticks\n",
+          currentThread->GetName(), ticks);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    interrupt->Schedule(AlarmHandler, currentThread, ticks, ALARM_INT);
+    currentThread->Sleep();
+    interrupt->SetLevel(oldLevel);
+}
+
+/// A timed wait, shared by the thread waiting and the interrupt set to end
+/// it, since the interrupt cannot be taken back.  Whichever of them is done
+/// with it last deletes it.
+struct TimedWait {
+    Thread *sleeper;  ///< Null once the thread went on.
+    ThreadQueue *queue;
+    bool fired;
+    bool timedOut;
+};
+
+/// Take the thread waiting in `arg` out of its queue, if it is still there.
+///
+/// It may have been woken already, and even be in a ready queue, through
+/// the same link: only the queue it waited in is looked into.
+static void
+TimeoutHandler(void *arg)
+{
+    TimedWait *wait = (TimedWait *) arg;
+    if (wait->sleeper == nullptr) {
+        delete wait;
+        return;
+    }
+    wait->fired = true;
+    if (wait->queue->Has(wait->sleeper)) {
+        DEBUG('t', "Time is up for thread \"%s\"\n",
+              wait->sleeper->GetName());
+        wait->queue->Remove(wait->sleeper);
+        wait->timedOut = true;
+        scheduler->ReadyToRun(wait->sleeper);
+    }
+}
+
+bool
+Alarm::WaitOn(ThreadQueue *queue, unsigned long ticks)
+{
+    ASSERT(queue != nullptr);
+    ASSERT(interrupt->GetLevel() == INT_OFF);
+
+    if (ticks == 0) {
+        return false;
+    }
+
+    TimedWait *wait = new TimedWait;
+    wait->sleeper  = currentThread;
+    wait->queue    = queue;
+    wait->fired    = false;
+    wait->timedOut = false;
+    queue->Append(currentThread);
+    interrupt->Schedule(TimeoutHandler, wait, ticks, ALARM_INT);
+    currentThread->Sleep();
+
+    bool woken = !wait->timedOut;
+    if (wait->fired) {
+        delete wait;
+    } else {
+        wait->sleeper = nullptr;
+    }
+    return woken;
+}
@@ -0,0 +1,34 @@
+/// Data structures to let threads sleep for a while.
+///
+/// A sleeping thread is not on the ready list at all: each sleeper has an
+/// interrupt scheduled for when it is due, whose handler puts it back on the
+/// ready list.  Meanwhile, if nobody else can run, `Interrupt::Idle` jumps
+/// the clock straight to the next pending interrupt.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_ALARM__HH
+#define NACHOS_THREADS_ALARM__HH
+
+
+#include "thread.hh"
+
+
+class Alarm {
+public:
+
+    /// Put the current thread to sleep until at least `ticks` ticks of
+    /// simulated time have gone by.  Zero ticks just yields.
+    void WaitUntil(unsigned long ticks);
+
+    /// Put the current thread to sleep in `queue`, with interrupts off,
+    /// until whoever keeps the queue wakes it, or until `ticks` ticks go by,
+    /// whichever comes first.  Return false if the time ran out: the thread
+    /// is then taken out of the queue.
+    bool WaitOn(ThreadQueue *queue, unsigned long ticks);
+};
+
+
+#endif
@@ -1,26 +1,159 @@
-#ifndef NACHOS_CHANNEL__HH
-#define NACHOS_CHANNEL__HH
+/// Channels, a synchronization primitive to pass messages between threads.
+///
+/// A channel keeps up to `capacity` messages in a ring buffer.  Senders
+/// only wait while it is full, and receivers only while it is empty, so
+/// that a producer can get ahead of its consumer by a whole buffer before
+/// either of them has to give up the CPU.  A channel of capacity 1 is just
+/// a mailbox: the sender of a single message never waits for its receiver.
+///
+/// `SendN` and `ReceiveN` move several messages while holding the channel
+/// once, instead of once per message.  Messages of a batch that does not
+/// fit in the buffer may be interleaved with those of other senders.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
 
-#include "lock.hh"
+#ifndef NACHOS_THREADS_CHANNEL__HH
+#define NACHOS_THREADS_CHANNEL__HH
 
-class Channel
-{
+
+#include "condition.hh"
+
+
+template <class T>
+class Channel {
 public:
-  Channel(const char *debugName);
 
-  ~Channel();
+    /// Constructor: set up an empty channel with room for `capacity`
+    /// messages.
+    Channel(const char *debugName, unsigned capacity = 1);
+
+    ~Channel();
+
+    const char *GetName() const;
+
+    /// Put `message` in the channel, waiting for room if it is full.
+    void Send(T message);
+
+    /// Take the oldest message out of the channel into `message`, waiting
+    /// for one to arrive if it is empty.
+    void Receive(T *message);
 
-  void Send(int message);
+    /// Send the `n` messages in `messages`, in order.
+    void SendN(const T *messages, unsigned n);
 
-  void Receive(int *message);
+    /// Receive `n` messages into `messages`, in order.
+    void ReceiveN(T *messages, unsigned n);
 
 private:
-  const char *name;
 
-  int buffer;
+    const char *name;
 
-  Lock *lock4send, *lock4receive;
+    /// Ring buffer of `capacity` messages; `count` of them, starting at
+    /// `head`, are waiting to be received.
+    T *buffer;
+    unsigned capacity;
+    unsigned head;
+    unsigned count;
 
-  Semaphore *semaphore4send, *semaphore4receive;
+    Lock *lock;
+    Condition *notFull;
+    Condition *notEmpty;
 };
+
+
+template <class T>
+Channel<T>::Channel(const char *debugName, unsigned capacity_)
+{
+    ASSERT(capacity_ > 0);
+
+    name     = debugName;
+    buffer   = new T [capacity_];
+    capacity = capacity_;
+    head     = 0;
+    count    = 0;
+    lock     = new Lock(debugName);
+    notFull  = new Condition(debugName, lock);
+    notEmpty = new Condition(debugName, lock);
+}
+
+template <class T>
+Channel<T>::~Channel()
+{
+    delete notEmpty;
+    delete notFull;
+    delete lock;
+    delete [] buffer;
+}
+
+template <class T>
+const char *
+Channel<T>::GetName() const
+{
+    return name;
+}
+
+template <class T>
+void
+Channel<T>::Send(T message)
+{
+    SendN(&message, 1);
+}
+
+template <class T>
+void
+Channel<T>::Receive(T *message)
+{
+    ReceiveN(message, 1);
+}
+
+template <class T>
+void
+Channel<T>::SendN(const T *messages, unsigned n)
+{
+    ASSERT(messages != nullptr || n == 0);
+
+    lock->Acquire();
+    while (n > 0) {
+        while (count == capacity) {
+            notFull->Wait();
+        }
+
+        // Every message put in wakes at most one receiver, which takes at
+        // least that message; so no receiver sleeps while there is any.
+        do {
+            buffer[(head + count) % capacity] = *messages++;
+            count++;
+            n--;
+            notEmpty->Signal();
+        } while (n > 0 && count < capacity);
+    }
+    lock->Release();
+}
+
+template <class T>
+void
+Channel<T>::ReceiveN(T *messages, unsigned n)
+{
+    ASSERT(messages != nullptr || n == 0);
+
+    lock->Acquire();
+    while (n > 0) {
+        while (count == 0) {
+            notEmpty->Wait();
+        }
+
+        do {
+            *messages++ = buffer[head];
+            head = (head + 1) % capacity;
+            count--;
+            n--;
+            notFull->Signal();
+        } while (n > 0 && count > 0);
+    }
+    lock->Release();
+}
+
+
 #endif
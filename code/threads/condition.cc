@@ -16,6 +16,7 @@
 
 
 #include "condition.hh"
+#include "system.hh"
 
 
 /// Dummy functions -- so we can compile our later assignments.
@@ -26,14 +27,11 @@
 Condition::Condition(const char *debugName, Lock* conditionLock)
 {
     name = debugName;
-    waitQueue = new List<Semaphore*>;
     lock = conditionLock;
 }
 
 Condition::~Condition()
-{
-    delete waitQueue;
-}
+{}
 
 const char *
 Condition::GetName() const
@@ -46,13 +44,17 @@ Condition::Wait()
 {
     ASSERT(lock->IsHeldByCurrentThread());
 
-    Semaphore *semaphore = new Semaphore("condition", 0);
-    waitQueue->Append(semaphore);
+    // Queueing, releasing the lock and going to sleep must be atomic, so
+    // that no `Signal` can come in between and get lost.
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    waitQueue.Append(currentThread);
     lock->Release();
-    semaphore->P();
-    lock->Acquire();
+    currentThread->Sleep();
+    interrupt->SetLevel(oldLevel);
 
-    delete semaphore;
+    // `Signal` moved us to the queue of the lock, which was then handed to
+    // us by `Lock::Release`.
+    ASSERT(lock->IsHeldByCurrentThread());
 }
 
 void
@@ -60,14 +62,18 @@ Condition::Signal()
 {
     ASSERT(lock->IsHeldByCurrentThread());
 
-    if (!waitQueue->IsEmpty()) {
-        Semaphore *semaphore = waitQueue->Pop();
-        semaphore->V();
+    // Rather than waking the thread up just to have it wait for the lock
+    // we hold, make it wait for the lock right away.
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Thread *thread = waitQueue.Pop();
+    if (thread != nullptr) {
+        lock->AddWaiter(thread);
     }
+    interrupt->SetLevel(oldLevel);
 }
 
 void
 Condition::Broadcast()
 {
-    while (!waitQueue->IsEmpty()) Signal();
+    while (!waitQueue.IsEmpty()) Signal();
 }
@@ -79,7 +79,8 @@ private:
 
     // Other needed fields are to be added here.
 
-    List<Semaphore*> *waitQueue;
+    /// Threads waiting to be signalled.
+    ThreadQueue waitQueue;
     Lock* lock;
 };
 
@@ -0,0 +1,132 @@
+/// Routines to record the inputs of a run, and to replay them.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "input_log.hh"
+#include "system.hh"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/// First word of every log.
+static const unsigned INPUT_LOG_MAGIC = 0x494E4C47;
+
+InputLog::InputLog(const char *fileName, bool replaying_)
+{
+    ASSERT(fileName != nullptr);
+
+    replaying = replaying_;
+    for (unsigned k = 0; k < NUM_INPUT_KINDS; k++) {
+        next[k] = nullptr;
+    }
+
+    file = fopen(fileName, replaying ? "rb" : "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Could not open the input log %s.\n", fileName);
+        exit(1);
+    }
+
+    if (!replaying) {
+        fwrite(&INPUT_LOG_MAGIC, sizeof INPUT_LOG_MAGIC, 1, file);
+        return;
+    }
+
+    // Read the whole log now, so that replaying does no host I/O.
+    unsigned magic;
+    if (fread(&magic, sizeof magic, 1, file) != 1
+          || magic != INPUT_LOG_MAGIC) {
+        fprintf(stderr, "%s is not an input log.\n", fileName);
+        exit(1);
+    }
+    InputRecord **last[NUM_INPUT_KINDS];
+    for (unsigned k = 0; k < NUM_INPUT_KINDS; k++) {
+        last[k] = &next[k];
+    }
+    RawRecord raw;
+    while (fread(&raw, sizeof raw, 1, file) == 1) {
+        ASSERT(raw.kind < NUM_INPUT_KINDS);
+        InputRecord *r = new InputRecord;
+        r->when   = raw.when;
+        r->length = raw.length;
+        r->data   = new char [raw.length];
+        r->next   = nullptr;
+        ASSERT(fread(r->data, 1, raw.length, file) == raw.length);
+        *last[raw.kind] = r;
+        last[raw.kind]  = &r->next;
+    }
+    fclose(file);
+    file = nullptr;
+}
+
+InputLog::~InputLog()
+{
+    if (file != nullptr) {
+        fclose(file);
+    }
+    for (unsigned k = 0; k < NUM_INPUT_KINDS; k++) {
+        while (next[k] != nullptr) {
+            InputRecord *r = next[k];
+            next[k] = r->next;
+            delete [] r->data;
+            delete r;
+        }
+    }
+}
+
+bool
+InputLog::IsRecording() const
+{
+    return !replaying;
+}
+
+bool
+InputLog::IsReplaying() const
+{
+    return replaying;
+}
+
+void
+InputLog::Record(InputKind kind, const void *data, unsigned length)
+{
+    ASSERT(!replaying);
+    ASSERT(kind < NUM_INPUT_KINDS);
+    ASSERT(data != nullptr || length == 0);
+
+    RawRecord raw;
+    raw.when   = stats->totalTicks;
+    raw.kind   = kind;
+    raw.length = length;
+    fwrite(&raw, sizeof raw, 1, file);
+    fwrite(data, 1, length, file);
+    fflush(file);  // So that a run that crashes can be replayed, too.
+}
+
+bool
+InputLog::Replay(InputKind kind, void *buffer, unsigned size,
+                 unsigned *length)
+{
+    ASSERT(replaying);
+    ASSERT(kind < NUM_INPUT_KINDS);
+    ASSERT(buffer != nullptr);
+    ASSERT(length != nullptr);
+
+    InputRecord *r = next[kind];
+    if (r == nullptr
+          || (kind != INPUT_TIMER && r->when > stats->totalTicks)) {
+        return false;
+    }
+    ASSERT(r->length <= size);
+
+    DEBUG('i', "Replaying input of kind %u, %u bytes, logged at %lu\n",
+          kind, r->length, r->when);
+    memcpy(buffer, r->data, r->length);
+    *length = r->length;
+    next[kind] = r->next;
+    delete [] r->data;
+    delete r;
+    return true;
+}
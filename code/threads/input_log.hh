@@ -0,0 +1,84 @@
+/// Data structures to record the inputs of a run, and to replay them.
+///
+/// Nachos is deterministic but for what comes from outside the simulated
+/// machine: characters typed at the console, packets from other machines,
+/// and the intervals of the timer when `-rs` makes them random.  Recording
+/// writes each of these to a log as it is taken, stamped with
+/// `stats->totalTicks`.  Replaying reads the log back and hands over each
+/// input in place of the host, instead of reading the keyboard or the
+/// socket: console input and packets at the first time the device looks
+/// for them at or after their tick, timer intervals in the order they were
+/// taken.  A run replayed with the same flags then does exactly what the
+/// recorded one did, whether the other machines are there or not, so that
+/// captured workloads can be profiled again and again.
+///
+/// The log is a UNIX file of records, each a header followed by its bytes.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_INPUTLOG__HH
+#define NACHOS_THREADS_INPUTLOG__HH
+
+
+#include <stdio.h>
+
+
+/// Kinds of inputs logged.
+enum InputKind {
+    INPUT_TIMER,    ///< An interval of the timer, as an `int`.
+    INPUT_CONSOLE,  ///< Bytes read from the console; none at its end.
+    INPUT_PACKET,   ///< A packet read from the network, header included.
+    NUM_INPUT_KINDS
+};
+
+/// One input, as kept while replaying.
+class InputRecord {
+public:
+    unsigned long when;  ///< When it was taken, in ticks.
+    unsigned length;
+    char *data;
+    InputRecord *next;   ///< The next one of the same kind.
+};
+
+class InputLog {
+public:
+
+    /// Start recording into `fileName`, or, if `replaying`, read the log
+    /// in it to replay.  Abort if it cannot be opened.
+    InputLog(const char *fileName, bool replaying);
+
+    /// Write out what is still buffered, if recording.
+    ~InputLog();
+
+    bool IsRecording() const;
+    bool IsReplaying() const;
+
+    /// Log an input of `kind`: `length` bytes at `data`.
+    void Record(InputKind kind, const void *data, unsigned length);
+
+    /// If the next input of `kind` logged is due, copy it into `buffer`,
+    /// which has room for `size` bytes, set `*length` to its length, and
+    /// return true.  Timer intervals are always due.
+    bool Replay(InputKind kind, void *buffer, unsigned size,
+                unsigned *length);
+
+private:
+
+    /// What precedes the bytes of each input in the file.
+    struct RawRecord {
+        unsigned long when;
+        unsigned kind;
+        unsigned length;
+    };
+
+    FILE *file;
+    bool replaying;
+
+    /// Inputs still to replay, the oldest first, by kind.
+    InputRecord *next[NUM_INPUT_KINDS];
+};
+
+
+#endif
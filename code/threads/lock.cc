@@ -25,14 +25,14 @@
 Lock::Lock(const char *debugName)
 {
     name = debugName;
-    semaphore = new Semaphore(name, 1);
     thread_lock = nullptr;
+    nextHeld = nullptr;
+    counts = nullptr;
+    heldSince = 0;
 }
 
 Lock::~Lock()
-{
-    delete semaphore;
-}
+{}
 
 const char *
 Lock::GetName() const
@@ -45,14 +45,33 @@ Lock::Acquire()
 {
     ASSERT(!IsHeldByCurrentThread());
 
-    if (thread_lock && thread_lock->GetPriority() < currentThread->GetPriority()) {
-        unsigned temp = thread_lock->GetPriority();
-        thread_lock->SetPriority(currentThread->GetPriority());
-        scheduler->UpdatePriority(thread_lock, temp);
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    // Counts are found on first use, since locks may be made before
+    // counting starts.
+    if (lockStats != nullptr && counts == nullptr) {
+        counts = lockStats->Find(name);
+    }
+
+    if (thread_lock == nullptr) {
+        Take(currentThread);
+    } else {
+        unsigned long start = stats->totalTicks;
+        AddWaiter(currentThread);
+        currentThread->Sleep();
+        // `Release` gave us the lock before waking us up.
+        ASSERT(IsHeldByCurrentThread());
+        if (counts != nullptr) {
+            unsigned long waited = stats->totalTicks - start;
+            counts->contended++;
+            counts->waitTicks += waited;
+            if (waited > counts->maxWaitTicks) {
+                counts->maxWaitTicks = waited;
+            }
+        }
     }
 
-    semaphore->P();
-    thread_lock = currentThread;
+    interrupt->SetLevel(oldLevel);
 }
 
 void
@@ -60,9 +79,108 @@ Lock::Release()
 {
     ASSERT(IsHeldByCurrentThread());
 
-    currentThread->RestorePriority();
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+
+    Lock **link = &currentThread->heldLocks;
+    while (*link != this) {
+        link = &(*link)->nextHeld;
+    }
+    *link = nextHeld;
+    nextHeld = nullptr;
     thread_lock = nullptr;
-    semaphore->V();
+    if (counts != nullptr) {
+        counts->holdTicks += stats->totalTicks - heldSince;
+    }
+
+    // Give back what the waiters of this lock lent.
+    unsigned priority = InheritedPriority(currentThread);
+    if (priority != currentThread->GetPriority()) {
+        unsigned previous = currentThread->GetPriority();
+        currentThread->SetPriority(priority);
+        scheduler->UpdatePriority(currentThread, previous);
+    }
+
+    Thread *next = waiters.Pop();
+    if (next != nullptr) {
+        next->waitingOn = nullptr;
+        Take(next);
+        scheduler->ReadyToRun(next);
+    }
+
+    interrupt->SetLevel(oldLevel);
+}
+
+void
+Lock::AddWaiter(Thread *thread)
+{
+    ASSERT(thread != nullptr);
+    ASSERT(thread_lock != nullptr && thread_lock != thread);
+
+    thread->waitingOn = this;
+    waiters.Append(thread);
+    Donate(thread->GetPriority());
+}
+
+void
+Lock::Take(Thread *thread)
+{
+    ASSERT(thread != nullptr);
+    ASSERT(thread_lock == nullptr);
+
+    thread_lock = thread;
+    nextHeld = thread->heldLocks;
+    thread->heldLocks = this;
+    heldSince = stats->totalTicks;
+    if (counts != nullptr) {
+        counts->acquisitions++;
+    }
+
+    // Whoever is still waiting now waits for `thread`.
+    unsigned priority = InheritedPriority(thread);
+    if (priority != thread->GetPriority()) {
+        unsigned previous = thread->GetPriority();
+        thread->SetPriority(priority);
+        scheduler->UpdatePriority(thread, previous);
+    }
+}
+
+unsigned
+Lock::InheritedPriority(const Thread *thread)
+{
+    ASSERT(thread != nullptr);
+
+    unsigned priority = thread->GetBasePriority();
+    for (const Lock *l = thread->heldLocks; l != nullptr; l = l->nextHeld) {
+        for (const Thread *t = l->waiters.Head(); t != nullptr;
+             t = l->waiters.Next(t)) {
+            if (t->GetPriority() > priority) {
+                priority = t->GetPriority();
+            }
+        }
+    }
+    return priority;
+}
+
+/// Chains are bounded by the number of threads; a cycle would be a
+/// deadlock, which stops the walk as soon as nobody gains anything.
+void
+Lock::Donate(unsigned priority)
+{
+    for (Lock *l = this; l != nullptr && l->thread_lock != nullptr;
+         l = l->thread_lock->waitingOn) {
+        Thread *holder = l->thread_lock;
+        if (holder->GetPriority() >= priority) {
+            break;
+        }
+        DEBUG('t', "Lending priority %u to \"%s\"\n",
+              priority, holder->GetName());
+        if (l->counts != nullptr) {
+            l->counts->donations++;
+        }
+        unsigned previous = holder->GetPriority();
+        holder->SetPriority(priority);
+        scheduler->UpdatePriority(holder, previous);
+    }
 }
 
 bool
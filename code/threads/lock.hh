@@ -18,6 +18,7 @@
 #define NACHOS_THREADS_LOCK__HH
 
 #include "semaphore.hh"
+#include "lock_stats.hh"
 
 /// This class defines a â€œlockâ€.
 ///
@@ -30,6 +31,16 @@
 ///
 /// For convenience, nobody but the thread that holds the lock can free it.
 /// There is no operation for reading the state of the lock.
+///
+/// A thread waiting for a lock lends its priority to the holder, and, if
+/// the holder is itself waiting for another lock, to the holder of that
+/// one, and so on down the chain.  A thread runs at the highest of its own
+/// priority and those of the threads waiting for any lock it holds; this is
+/// worked out again every time it acquires or releases one.
+///
+/// A released lock is handed straight to the first thread waiting for it,
+/// which then wakes up already holding it: no other thread can grab the
+/// lock meanwhile and send it back to sleep.
 class Lock {
 public:
 
@@ -53,16 +64,41 @@ public:
     /// Useful for checks in `Release` and in condition variables.
     bool IsHeldByCurrentThread() const;
 
+    /// Return the priority `thread` is to run at, given the locks it holds.
+    static unsigned InheritedPriority(const Thread *thread);
+
 private:
 
+    /// `Condition` queues the threads it signals here, to be woken one by
+    /// one as the lock is released.
+    friend class Condition;
+
+    /// Make `thread`, which is blocked, wait for the lock.
+    void AddWaiter(Thread *thread);
+
+    /// Give the lock, which must be free, to `thread`.
+    void Take(Thread *thread);
+
+    /// Give `priority` to the holder of this lock, and along the chain of
+    /// locks it is waiting for.
+    void Donate(unsigned priority);
+
     /// For debugging.
     const char *name;
 
-    // Add other needed fields here.
-    Semaphore *semaphore;
-
     // The current thread with the lock
     Thread* thread_lock;
+
+    /// Threads waiting for the lock, in order of arrival.
+    ThreadQueue waiters;
+
+    /// Next lock held by `thread_lock`, from `Thread::heldLocks`.
+    Lock *nextHeld;
+
+    /// What locks of this name did, if counting, or null; and when
+    /// `thread_lock` took the lock.
+    LockCounts *counts;
+    unsigned long heldSince;
 };
 
 
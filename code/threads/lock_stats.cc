@@ -0,0 +1,82 @@
+/// Routines to profile contention on locks.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "lock_stats.hh"
+#include "lib/utility.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+LockStats::LockStats()
+{
+    memset(counts, 0, sizeof counts);
+    numNames = 0;
+}
+
+/// Names are compared as kept, cut short, so that a long name finds the
+/// counts it was given.  The last slot is kept for "other".
+LockCounts *
+LockStats::Find(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    for (unsigned i = 0; i < numNames; i++) {
+        if (strncmp(counts[i].name, name, LockCounts::NAME_SIZE - 1) == 0) {
+            return &counts[i];
+        }
+    }
+
+    LockCounts *c = &counts[numNames];
+    if (numNames == MAX_NAMES - 1) {
+        name = "other";
+        if (c->name[0] != '\0') {
+            return c;
+        }
+    } else {
+        numNames++;
+    }
+    strncpy(c->name, name, LockCounts::NAME_SIZE);
+    c->name[LockCounts::NAME_SIZE - 1] = '\0';
+    return c;
+}
+
+static int
+CompareWaits(const void *a, const void *b)
+{
+    const LockCounts *x = *(const LockCounts * const *) a;
+    const LockCounts *y = *(const LockCounts * const *) b;
+    if (x->waitTicks != y->waitTicks) {
+        return x->waitTicks > y->waitTicks ? -1 : 1;
+    }
+    if (x->contended != y->contended) {
+        return x->contended > y->contended ? -1 : 1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+void
+LockStats::Print() const
+{
+    const LockCounts *sorted[MAX_NAMES];
+    unsigned n = 0;
+    for (unsigned i = 0; i < MAX_NAMES; i++) {
+        if (counts[i].acquisitions > 0) {
+            sorted[n++] = &counts[i];
+        }
+    }
+    qsort(sorted, n, sizeof sorted[0], CompareWaits);
+
+    for (unsigned i = 0; i < n; i++) {
+        const LockCounts *c = sorted[i];
+        printf("Lock %s: acquisitions %lu, contended %lu, wait ticks %lu, "
+               "max wait %lu, hold ticks %lu, donations %lu\n",
+               c->name, c->acquisitions, c->contended, c->waitTicks,
+               c->maxWaitTicks, c->holdTicks, c->donations);
+    }
+}
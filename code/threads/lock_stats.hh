@@ -0,0 +1,60 @@
+/// Data structures to profile contention on locks.
+///
+/// With `-lst`, every `Lock` counts how it is used: how many times it is
+/// acquired, and how many of those it was busy, for how long the threads
+/// waited for it and held it, and how many times a waiting thread lent its
+/// priority to the holder.  Locks of the same name are counted together,
+/// so that, say, the locks of every pipe show up as one.  When Nachos
+/// halts, the locks are listed by the ticks spent waiting for them, the
+/// first ones being where concurrency is lost.
+///
+/// Without `-lst`, a lock only checks that nobody is counting.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_LOCKSTATS__HH
+#define NACHOS_THREADS_LOCKSTATS__HH
+
+
+/// What the locks of one name did.
+class LockCounts {
+public:
+
+    /// Longest name kept, including the terminating null.
+    static const unsigned NAME_SIZE = 24;
+
+    char name[NAME_SIZE];
+    unsigned long acquisitions;
+    unsigned long contended;  ///< Acquisitions that had to wait.
+    unsigned long waitTicks;
+    unsigned long maxWaitTicks;
+    unsigned long holdTicks;
+    unsigned long donations;  ///< Priorities lent to holders.
+};
+
+class LockStats {
+public:
+
+    /// Most names counted; locks of any other name are counted together
+    /// under "other".
+    static const unsigned MAX_NAMES = 128;
+
+    LockStats();
+
+    /// Return the counts of locks named `name`, made if need be.
+    LockCounts *Find(const char *name);
+
+    /// Print the counts of the locks ever acquired, those waited for the
+    /// longest first.
+    void Print() const;
+
+private:
+
+    LockCounts counts[MAX_NAMES];
+    unsigned numNames;
+};
+
+
+#endif
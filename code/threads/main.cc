@@ -10,13 +10,33 @@
 /// Usage
 /// =====
 ///
-///     nachos [-d <debugflags>] [-do <debugopts>] [-p]
-///            [-rs <random seed #>] [-z] [-tt]
-///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
-///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
-///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
-///            [-n <network reliability>] [-id <machine id>]
-///            [-tn <other machine id>]
+///     nachos [-d <debugflags>] [-do <debugopts>] [-p] [-cpus <count>]
+///            [-rs <random seed #>] [-tr <trace file>]
+///            [-rec <input log>] [-replay <input log>]
+///            [-sj <statistics file>] [-sji <ticks>] [-lst] [-z]
+///            [-q] [-tt]
+///            [-s] [-x <nachos file>] [-restore <nachos file>]
+///            [-wl <workload file>]
+///            [-tc <consoleIn> <consoleOut>] [-cl] [-cb] [-cs <script>]
+///            [-tm] [-gang]
+///            [-tlb <entries>] [-tlbw <ways>] [-tlbp <policy>]
+///            [-m <pages>] [-ss <bytes>] [-ra <pages>] [-vp <policy>] [-zf]
+///            [-lim <limits>]
+///            [-prof <profile file>]
+///            [-l1i <geometry>] [-l1d <geometry>] [-l2 <geometry>]
+///            [-f] [-dk <tracks>] [-dc <sectors>] [-pc <blocks>]
+///            [-dp <policy>] [-dm] [-dr]
+///            [-dt <timing>] [-db <requests>]
+///            [-cp <unix file> <nachos file>]
+///            [-pr <nachos file>] [-rm <nachos file>] [-md <nachos dir>]
+///            [-im <unix dir> <nachos dir>] [-ex <nachos dir> <unix dir>]
+///            [-ls] [-D] [-c] [-ci] [-defrag] [-tf]
+///            [-n <network reliability>] [-id <machine id>] [-nq <packets>]
+///            [-tn <other machine id>] [-tw <other machine id> <window>]
+///            [-tb <other machine id> <window>] [-tg <machines>]
+///            [-tp <other machine id> <workers>]
+///            [-rx <client machine id>] [-rp <server machine id> <file>]
+///            [-rcp <server machine id> <unix file> <file>]
 ///
 /// General options
 /// ---------------
@@ -26,8 +46,24 @@
 /// * `-do` -- enables options that modify the behavior when printing
 ///            debugging messages.
 /// * `-p`  -- enables preemptive multitasking for kernel threads.
+/// * `-cpus` -- sets the number of simulated CPUs (1 by default).
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
+/// * `-tr` -- traces kernel events, and writes them to the given file at
+///            halt, for `chrome://tracing` or Perfetto.
+/// * `-rec` -- records the console input, packets received and random timer
+///            intervals in the given file (see `threads/input_log.hh`).
+/// * `-replay` -- takes them from a log recorded by `-rec`, instead of the
+///            host, so that the run does just what the recorded one did.
+/// * `-sj` -- writes the statistics, what each thread used, and snapshots
+///            of the main counters, to the given file as JSON at halt.
+/// * `-sji` -- sets the ticks between snapshots (10000 by default; 0 takes
+///            none).
+/// * `-lst` -- counts how every lock is acquired, waited for and held, and
+///            prints the counts at halt (see `threads/lock_stats.hh`).
 /// * `-z`  -- prints version and copyright information, and exits.
+/// * `-q`  -- halts once the options before it are done, rather than
+///            waiting for the console forever, so that the statistics are
+///            printed and written after, say, `-tf`.
 ///
 /// *THREADS* options
 /// -----------------
@@ -38,28 +74,132 @@
 /// *USER_PROGRAM* options
 /// ----------------------
 ///
-/// * `-s`  -- causes user programs to be executed in single-step mode.
+/// * `-s`  -- causes user programs to be executed in single-step mode, in
+///   the debugger, which can also stop them at breakpoints.
 /// * `-x`  -- runs a user program.
+/// * `-wl` -- runs the jobs of a workload script, a UNIX file, and reports
+///            their turnaround and response times (see
+///            `userprog/workload.hh`).
+/// * `-restore` -- resumes a user program from a checkpoint written by its
+///                 `Checkpoint` system call.  Statistics count from the
+///                 resumption on.
 /// * `-tc` -- tests the console.
+/// * `-tm` -- tests the multiplication of the simulated processor against
+///            the shift-and-add algorithm, and prints whether it passed.
+/// * `-cl` -- reads the console a line at a time, as a terminal does.
+/// * `-cb` -- writes the console in batches of characters, with one
+///            interrupt for each batch rather than for each character.
+/// * `-cs` -- types a scripted session, a UNIX file, at the console, in
+///            place of the keyboard, and prints the percentiles of the
+///            ticks taken to echo each key and to answer each line at halt
+///            (see `userprog/console_script.hh`).
+/// * `-gang` -- with several CPUs, runs the threads of a program together
+///             on as many CPUs as they can take (see `threads/scheduler.hh`).
+/// * `-tlb` -- sets the number of TLB entries.
+/// * `-tlbw` -- sets the associativity of the TLB (entries per set; 0, the
+///             default, means fully associative).
+/// * `-tlbp` -- sets the TLB replacement policy: `fifo` (the default),
+///             `lru`, `random` or `clock`.
+/// * `-m`  -- sets the number of pages of physical memory (128 by default).
+/// * `-ss` -- sets the bytes of stack given to each user program (1024 by
+///            default).
+/// * `-lim` -- limits every user program, as `<pages>:<files>:<rate>` or
+///            `<pages>:<files>:<rate>:<burst>`: to `pages` pages in memory,
+///            `files` open files and pipe ends, and `rate` sectors of disk
+///            I/O every `DISK_RATE_TICKS` ticks, `burst` of them at once; 0
+///            stands for no limit (see `userprog/resource_limits.hh`).
+/// * `-ra` -- sets the most pages loaded ahead of a page fault, with demand
+///            loading (0 disables read-ahead).
+/// * `-vp` -- sets the page replacement policy, with swap: `eclock`
+///            (enhanced second chance, the default), `clock`, `fifo`,
+///            `aging` or `random`.
+/// * `-zf` -- clears free frames while the CPU is idle, with virtual
+///            memory, so that pages starting out as zeros need not be
+///            cleared when they are brought in.
+/// * `-prof` -- samples the program counter of user programs, and writes
+///             the samples to the given file at halt, for `bin/profile`.
+/// * `-l1i`, `-l1d`, `-l2` -- with `-DCACHE_MODEL`, model first level
+///            caches for instructions and data, and a second level behind
+///            both, of the geometry `<bytes>[:<ways>[:<line bytes>]]`, and
+///            charge user programs for their misses (see
+///            `machine/cache_model.hh`).
 ///
 /// *FILESYS* options
 /// -----------------
 ///
 /// * `-f`  -- causes the physical disk to be formatted.
+/// * `-dk` -- sets the number of tracks of the disk (32 by default, of 32
+///            sectors each).  A disk formatted with another number has to
+///            be formatted again.
+/// * `-dc` -- sets the number of sectors kept in the disk cache (0 disables
+///            it).
+/// * `-pc` -- sets the number of blocks of files kept in the page cache (0
+///            disables it).
+/// * `-dp` -- sets the order in which requests waiting for the disk are
+///            served: `fifo`, `sstf`, `scan` or `clook` (the default).
+/// * `-dm` -- maps the UNIX file that holds the disk into memory, so that
+///            sectors are copied rather than read and written with system
+///            calls.
+/// * `-dr` -- keeps the disk in memory rather than in the UNIX file
+///            `DISK`: a RAM disk, formatted when Nachos starts and lost when
+///            it halts, for files that need not outlive the run.  Its
+///            requests take the next tick, unless `-dt` says otherwise.
+/// * `-dt` -- sets how long disk requests take: `accurate` (the default)
+///            for seek, rotation and transfer; `fixed`, for the same time
+///            per sector wherever it is; or `immediate`, for the next tick.
+///            Requests end with an interrupt either way.
+/// * `-db` -- hands requests that waited for the disk to it in batches of
+///            up to the given number (1, the default, to 16), with one
+///            interrupt for each batch.
 /// * `-cp` -- copies a file from UNIX to Nachos.
 /// * `-pr` -- prints a Nachos file to standard output.
-/// * `-rm` -- removes a Nachos file from the file system.
+/// * `-rm` -- removes a Nachos file, or an empty directory, from the file
+///            system.
+/// * `-md` -- makes a Nachos directory.  Nachos files are named by paths
+///            such as `dir/file`.
+/// * `-im` -- copies every file and directory in a UNIX directory into a
+///            Nachos directory, made if need be, in one run.
+/// * `-ex` -- copies every file and directory in a Nachos directory into a
+///            UNIX directory, made if need be.
 /// * `-ls` -- lists the contents of the Nachos directory.
 /// * `-D`  -- prints the contents of the entire file system.
 /// * `-c`  -- checks the filesystem integrity.
-/// * `-tf` -- tests the performance of the Nachos file system.
+/// * `-ci` -- checks the filesystem integrity, looking only at the files
+///            changed since the last check.
+/// * `-defrag` -- checks the filesystem, then moves every file to
+///                 consecutive sectors after its header, and prints how
+///                 many pieces the files were in before and after.  Nothing
+///                 else should be using the disk meanwhile.
+/// * `-tf` -- tests the performance of the Nachos file system, printing a
+///            line of `key=value` pairs for each workload.
 ///
 /// *NETWORK* options
 /// -----------------
 ///
 /// * `-n`  -- sets the network reliability.
 /// * `-id` -- sets this machine's host id (needed for the network).
+/// * `-nq` -- sets how many packets that arrived the network keeps until
+///            they are delivered (16 by default).
 /// * `-tn` -- runs a simple test of the Nachos network software.
+/// * `-tw` -- tests the reliable transport with the other machine, with the
+///            window given.
+/// * `-tg` -- tests broadcast and multicast among the machines given, with
+///            IDs from 0 on, all run with `-tg`; machine 0 is to be started
+///            last.
+/// * `-tb` -- benchmarks round trips and throughput with the other machine,
+///            run with `-tb` too, over the reliable transport with the
+///            window given, printing a line of `key=value` pairs for each
+///            workload.
+/// * `-tp` -- tests remote procedure calls with the other machine, run with
+///            `-tp` too, the one with the higher ID serving them with the
+///            worker threads given.
+/// * `-rx` -- exports the file system to the client machine given, and
+///            keeps serving it.
+/// * `-rp` -- prints a file of the server machine given, which must run
+///            with `-rx`, keeping the blocks read for later commands.
+/// * `-rcp` -- copies a file from UNIX to the server machine given.  Once
+///            the commands are done, a machine that ran `-rp` or `-rcp`
+///            halts.
 ///
 /// ----
 ///
@@ -90,10 +230,23 @@
 
 void Copy(const char *unixFile, const char *nachosFile);
 void Print(const char *file);
+void Import(const char *unixDir, const char *nachosDir);
+void Export(const char *nachosDir, const char *unixDir);
 void PerformanceTest(void);
 void StartProcess(const char *file);
+void RestoreProcess(const char *file);
+void RunWorkload(const char *script);
 void ConsoleTest(const char *in, const char *out);
+void MultTest();
 void MailTest(int networkID);
+void TransportTest(int networkID, unsigned window);
+void MulticastTest(unsigned numMachines);
+void NetworkBenchmark(int networkID, unsigned window);
+void RpcTest(int networkID, unsigned workers);
+void ExportFileSystem(int networkID);
+void RemotePrint(int networkID, const char *file);
+void RemoteCopy(int networkID, const char *unixFile, const char *file);
+void RemoteFinish();
 
 static inline void
 PrintVersion()
@@ -132,6 +285,9 @@ main(int argc, char **argv)
             PrintVersion();
             return 0;
         }
+        if (!strcmp(*argv, "-q")) {          // Halt once done.
+            interrupt->Halt();
+        }
 #ifdef THREADS
         if (!strcmp(*argv, "-tt")) {         // Test the threading subsystem.
             ThreadTest();
@@ -143,6 +299,14 @@ main(int argc, char **argv)
             ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-wl")) {  // Run a workload.
+            ASSERT(argc > 1);
+            RunWorkload(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-restore")) {  // Resume a checkpoint.
+            ASSERT(argc > 1);
+            RestoreProcess(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-tc")) {  // Test the console.
             if (argc == 1) {
                 ConsoleTest(nullptr, nullptr);
@@ -154,6 +318,8 @@ main(int argc, char **argv)
             interrupt->Halt();  // Once we start the console, then Nachos
                                 // will loop forever waiting for console
                                 // input.
+        } else if (!strcmp(*argv, "-tm")) {  // Test multiplication.
+            MultTest();
         }
 #endif
 #ifdef FILESYS
@@ -170,6 +336,18 @@ main(int argc, char **argv)
             ASSERT(argc > 1);
             fileSystem->Remove(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-md")) {  // Make Nachos directory.
+            ASSERT(argc > 1);
+            fileSystem->MakeDirectory(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-im")) {  // Import a UNIX directory.
+            ASSERT(argc > 2);
+            Import(*(argv + 1), *(argv + 2));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-ex")) {  // Export a Nachos directory.
+            ASSERT(argc > 2);
+            Export(*(argv + 1), *(argv + 2));
+            argCount = 3;
         } else if (!strcmp(*argv, "-ls")) {  // List Nachos directory.
             fileSystem->List();
             printf("\n");
@@ -179,6 +357,11 @@ main(int argc, char **argv)
         } else if (!strcmp(*argv, "-c")) {   // Check the filesystem.
             bool result = fileSystem->Check();
             printf("Filesystem check %s.\n", result ? "succeeded" : "failed");
+        } else if (!strcmp(*argv, "-ci")) {  // Check what changed.
+            bool result = fileSystem->Check(true);
+            printf("Filesystem check %s.\n", result ? "succeeded" : "failed");
+        } else if (!strcmp(*argv, "-defrag")) {  // Defragment the disk.
+            fileSystem->Defragment();
         } else if (!strcmp(*argv, "-tf")) {  // Performance test.
             PerformanceTest();
         }
@@ -190,10 +373,55 @@ main(int argc, char **argv)
                                   // time to start up another nachos.
             MailTest(atoi(*(argv + 1)));
             argCount = 2;
+        } else if (!strcmp(*argv, "-tw")) {
+            ASSERT(argc > 2);
+            SystemDep::Delay(2);
+            TransportTest(atoi(*(argv + 1)), atoi(*(argv + 2)));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-tg")) {
+            ASSERT(argc > 1);
+            SystemDep::Delay(2);
+            MulticastTest(atoi(*(argv + 1)));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tb")) {
+            ASSERT(argc > 2);
+            SystemDep::Delay(2);
+            NetworkBenchmark(atoi(*(argv + 1)), atoi(*(argv + 2)));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-tp")) {
+            ASSERT(argc > 2);
+            SystemDep::Delay(2);
+            RpcTest(atoi(*(argv + 1)), atoi(*(argv + 2)));
+            argCount = 3;
         }
 #endif // NETWORK
+#if defined(NETWORK) && defined(FILESYS)
+        if (!strcmp(*argv, "-rx")) {         // Export the file system.
+            ASSERT(argc > 1);
+            ExportFileSystem(atoi(*(argv + 1)));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-rp")) {  // Print a remote file.
+            ASSERT(argc > 2);
+            RemotePrint(atoi(*(argv + 1)), *(argv + 2));
+            argCount = 3;
+        } else if (!strcmp(*argv, "-rcp")) {  // Copy to a remote file.
+            ASSERT(argc > 3);
+            RemoteCopy(atoi(*(argv + 1)), *(argv + 2), *(argv + 3));
+            argCount = 4;
+        }
+#endif
     }
 
+#ifdef FILESYS
+    // Nachos may never halt, with the console waiting for input, so what
+    // the commands above wrote is to reach the disk now.
+    journal->Commit();
+    synchDisk->Flush();
+#endif
+#if defined(NETWORK) && defined(FILESYS)
+    RemoteFinish();
+#endif
+
     currentThread->Finish(0);
       // NOTE: if the procedure `main` returns, then the program `nachos`
       // will exit (as any other normal program would).  But there may be
@@ -26,6 +26,18 @@ static void LetMeBeMonitored();
 
 static bool inContextSwitch = false;
 
+/// Slices granted to the running thread, and dispatches so far; read by the
+/// monitor process.
+static long sliceUnits = 1;
+static long dispatches = 0;
+
+void
+PreemptiveScheduler::SetSliceUnits(unsigned units)
+{
+    sliceUnits = units;
+    dispatches++;
+}
+
 /// Set up the preemptive scheduler.
 ///
 /// * `timeSliceLength` means how many machine instructions will last the
@@ -71,6 +83,11 @@ MonitorProcess(int childPid, unsigned long timeSliceLength)
     // Machine instruction counter.
     long long instructionCounter = 1;
 
+    // Slices the running thread has been through, and the dispatch count
+    // when it was last looked at.
+    long unitsUsed = 0;
+    long lastDispatches = -1;
+
     while (true) {
 
         // Wait for child process.
@@ -89,8 +106,24 @@ MonitorProcess(int childPid, unsigned long timeSliceLength)
             // Get child value of `inContextSwitch`.
             long incs = ptrace(PTRACE_PEEKDATA, childPid,
                                (void *) &inContextSwitch, nullptr);
+            incs &= 0xFF;  // A whole word is read; keep the `bool` only.
+
+            // Only preempt a thread once it has been running for all the
+            // slices it was given.
+            long d = ptrace(PTRACE_PEEKDATA, childPid,
+                            (void *) &dispatches, nullptr);
+            long units = ptrace(PTRACE_PEEKDATA, childPid,
+                                (void *) &sliceUnits, nullptr);
+            if (d != lastDispatches) {
+                lastDispatches = d;
+                unitsUsed = 0;
+            }
+            if (++unitsUsed < units) {
+                incs = 1;
+            }
 
             if (incs == 0) {
+                unitsUsed = 0;
                 DEBUG('p', "Preemptive scheduler: "
                            "forcing a context switch at instruction %lld\n",
                       instructionCounter);
@@ -150,6 +183,7 @@ ContextSwitch(void)
 #endif
 
     inContextSwitch = true;
+    scheduler->SliceExpired(currentThread);
 
     // Make a context switch if interrupts are enabled.
     if (interrupt->GetLevel() == INT_ON) {
@@ -28,6 +28,13 @@ public:
     ///   x86 machine instructions.
     void SetUp(unsigned long timeSliceLength);
 
+    /// Give the thread just dispatched `units` time slices before it is
+    /// preempted.
+    ///
+    /// The monitor looks at this once per time slice, along with a count
+    /// of dispatches, to tell how long the same thread has been running.
+    static void SetSliceUnits(unsigned units);
+
 };
 
 
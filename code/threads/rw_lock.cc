@@ -0,0 +1,86 @@
+/// Routines for reader-writer locks.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "rw_lock.hh"
+#include "system.hh"
+
+
+RWLock::RWLock(const char *debugName)
+{
+    name        = debugName;
+    writeLock   = new Lock(debugName);
+    readersLock = new Lock(debugName);
+    noReaders   = new Condition(debugName, readersLock);
+    readers     = 0;
+}
+
+RWLock::~RWLock()
+{
+    ASSERT(readers == 0);
+
+    delete noReaders;
+    delete readersLock;
+    delete writeLock;
+}
+
+const char *
+RWLock::GetName() const
+{
+    return name;
+}
+
+/// The write lock is only held while passing through, so a reader waits
+/// exactly while some writer holds the lock or waits for it.
+void
+RWLock::AcquireRead()
+{
+    ASSERT(!IsWrittenByCurrentThread());
+
+    writeLock->Acquire();
+    readersLock->Acquire();
+    readers++;
+    readersLock->Release();
+    writeLock->Release();
+}
+
+void
+RWLock::ReleaseRead()
+{
+    readersLock->Acquire();
+    ASSERT(readers > 0);
+    if (--readers == 0) {
+        noReaders->Broadcast();
+    }
+    readersLock->Release();
+}
+
+void
+RWLock::AcquireWrite()
+{
+    writeLock->Acquire();
+
+    // No new reader gets past `writeLock` now; wait for the current ones.
+    readersLock->Acquire();
+    while (readers > 0) {
+        noReaders->Wait();
+    }
+    readersLock->Release();
+}
+
+void
+RWLock::ReleaseWrite()
+{
+    ASSERT(IsWrittenByCurrentThread());
+
+    writeLock->Release();
+}
+
+bool
+RWLock::IsWrittenByCurrentThread() const
+{
+    return writeLock->IsHeldByCurrentThread();
+}
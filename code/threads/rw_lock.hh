@@ -0,0 +1,71 @@
+/// Reader-writer locks, a synchronization primitive.
+///
+/// All synchronization objects have a `name` parameter in the constructor;
+/// its only aim is to ease debugging the program.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_RWLOCK__HH
+#define NACHOS_THREADS_RWLOCK__HH
+
+
+#include "condition.hh"
+
+
+/// This class defines a “reader-writer lock”.
+///
+/// Any number of readers can hold the lock at once, but a writer holds it
+/// alone:
+///
+/// * `AcquireRead` -- wait until no writer holds or waits for the lock, and
+///   join the readers.
+/// * `ReleaseRead` -- leave the readers.
+/// * `AcquireWrite` -- wait until nobody else holds the lock, and take it.
+/// * `ReleaseWrite` -- free the lock.
+///
+/// Writers are preferred: once a writer waits, new readers wait behind it,
+/// so that writers cannot starve.  Writers take a `Lock` to get in, and
+/// keep it until they are done; readers wait on that same `Lock`
+/// whenever a writer holds it.  Waiting readers and writers thus lend their
+/// priority to the writer ahead of them, just as with `Lock`.
+class RWLock {
+public:
+
+    /// Constructor: set up the lock as free.
+    RWLock(const char *debugName);
+
+    ~RWLock();
+
+    /// For debugging.
+    const char *GetName() const;
+
+    void AcquireRead();
+    void ReleaseRead();
+
+    void AcquireWrite();
+    void ReleaseWrite();
+
+    /// Returns `true` if the current thread is the writer holding the lock.
+    bool IsWrittenByCurrentThread() const;
+
+private:
+
+    /// For debugging.
+    const char *name;
+
+    /// Held by the writer, from the moment it starts waiting for the
+    /// readers to finish until it is done.
+    Lock *writeLock;
+
+    /// Protects `readers`, and lets the writer wait for it to drop to 0.
+    Lock *readersLock;
+    Condition *noReaders;
+
+    /// Number of threads holding the lock for reading.
+    unsigned readers;
+};
+
+
+#endif
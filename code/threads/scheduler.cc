@@ -9,8 +9,7 @@
 /// needed to wait for a lock, and the lock was busy, we would end up calling
 /// `FindNextToRun`, and that would put us in an infinite loop.
 ///
-/// Very simple implementation -- no priorities, straight FIFO.  Might need
-/// to be improved in later assignments.
+/// Threads of the same level are served FIFO.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -24,69 +23,415 @@
 #include <stdio.h>
 
 
-/// Initialize the list of ready but not running threads to empty.
-Scheduler::Scheduler()
+/// Initialize the lists of ready but not running threads to empty.
+Scheduler::Scheduler(unsigned numCPUs_)
 {
-    readyList = new List <Thread*>*[QUEUES];
-    for (unsigned i = 0; i < QUEUES; i++) {
-        readyList[i] = new List<Thread *>;
+    ASSERT(QUEUES <= Statistics::MAX_READY_QUEUES);
+    ASSERT(numCPUs_ > 0 && numCPUs_ <= Statistics::MAX_CPUS);
+
+    for (unsigned c = 0; c < numCPUs_; c++) {
+        cpus[c].nonEmpty   = 0;
+        cpus[c].numReady   = 0;
+        cpus[c].running    = nullptr;
+        cpus[c].sliceUnits = 1;
+        cpus[c].sliceTicks = 0;
     }
+    numCPUs            = numCPUs_;
+    cpu                = 0;
+    cpuSwitchRequested = false;
+    lastAging          = 0;
+#ifdef USER_PROGRAM
+    gangScheduling     = false;
+    gang               = nullptr;
+#endif
 }
 
 /// De-allocate the list of ready threads.
 Scheduler::~Scheduler()
+{}
+
+unsigned
+Scheduler::GetNumCPUs() const
 {
-    for (int i = 0; i < QUEUES; i++) {
-        delete readyList[i];
-    }
-    delete readyList;
+    return numCPUs;
+}
+
+unsigned
+Scheduler::GetCPU() const
+{
+    return cpu;
+}
+
+unsigned
+Scheduler::GetNumReady() const
+{
+    return cpus[cpu].numReady;
 }
 
 /// Mark a thread as ready, but not running.
 /// Put it on the ready list, for later scheduling onto the CPU.
 ///
+/// A thread that was blocked gets back the levels it lost for using up its
+/// time slices, and one more.
+///
+/// A thread put on an idle CPU other than the one being simulated wakes it
+/// up with an interprocessor interrupt.
+///
 /// * `thread` is the thread to be put on the ready list.
 void
 Scheduler::ReadyToRun(Thread *thread)
 {
     ASSERT(thread != nullptr);
 
-    DEBUG('t', "Putting thread %s on ready list with priority %d\n", thread->GetName(), thread->GetPriority());
+    unsigned target = PlaceOf(thread);
+    if (thread->cpu != NO_CPU && thread->cpu != target) {
+        stats->numMigrations++;
+    }
+    if (target != cpu && LoadOf(target) == 0) {
+        stats->numIPIs++;
+    }
+    thread->cpu = target;
 
+    if (thread->status == BLOCKED && thread->bonus < WAKEUP_BONUS) {
+        thread->bonus = thread->bonus < 0 ? 0 : thread->bonus + 1;
+    }
     thread->SetStatus(READY);
+    thread->readySince = thread->agedSince = stats->totalTicks;
+    Enqueue(thread);
 
-    ASSERT(thread->GetPriority() < QUEUES);
-    readyList[QUEUES - 1 - thread->GetPriority()]->Append(thread);
+    DEBUG('t', "Putting thread %s on ready list with priority %d, queue %u\n",
+          thread->GetName(), thread->GetPriority(), thread->queue);
 }
 
 /// Return the next thread to be scheduled onto the CPU.
 ///
-/// If there are no ready threads, return null.
+/// If there are no ready threads, return null.  A CPU with none of its own
+/// steals from the others.
 ///
 /// Side effect: thread is removed from the ready list.
 Thread *
 Scheduler::FindNextToRun()
 {
-    Thread* next = nullptr;
+    if (stats->totalTicks - lastAging >= AGING_TICKS) {
+        Age();
+    }
+    if (cpus[cpu].nonEmpty != 0) {
+        return Dequeue(cpu);
+    }
+    return Steal();
+}
+
+/// The victim is the busy CPU with the most threads waiting; an idle one
+/// is to be woken up by whoever put them there.  The thief runs the thread
+/// the victim would have run next, the one that waited longest at the top
+/// level, and takes more, from the bottom of the victim's queues, as long
+/// as the victim keeps more than one more waiting than the thief.  Taking
+/// a batch saves coming back for every thread; taking the least urgent
+/// ones leaves the victim what it would soon run.
+Thread *
+Scheduler::Steal()
+{
+    unsigned victim = NO_CPU;
+    for (unsigned c = 0; c < numCPUs; c++) {
+        if (c != cpu && cpus[c].running != nullptr && cpus[c].numReady > 0
+              && (victim == NO_CPU
+                  || cpus[c].numReady > cpus[victim].numReady)) {
+            victim = c;
+        }
+    }
+    if (victim == NO_CPU) {
+        return nullptr;
+    }
+
+    Thread *next = Dequeue(victim);
+    next->cpu = cpu;
+    stats->numMigrations++;
+    stats->numSteals++;
+
+    CPUState *from = &cpus[victim];
+    while (from->numReady > cpus[cpu].numReady + 1) {
+        Thread *t = Take(victim, 31 - __builtin_clz(from->nonEmpty));
+        t->cpu = cpu;
+        Enqueue(t);
+        stats->numMigrations++;
+        stats->numSteals++;
+    }
+
+    DEBUG('t', "CPU %u stole %s and %u more from CPU %u\n",
+          cpu, next->GetName(), cpus[cpu].numReady, victim);
+    return next;
+}
+
+Thread *
+Scheduler::FindNextCPU()
+{
+    for (unsigned i = 1; i < numCPUs; i++) {
+        unsigned c = (cpu + i) % numCPUs;
+        if (cpus[c].running != nullptr) {
+            DEBUG('t', "Moving on to CPU %u, running %s\n",
+                  c, cpus[c].running->GetName());
+            return cpus[c].running;
+        }
+        if (cpus[c].nonEmpty != 0) {
+            return Dequeue(c);
+        }
+    }
+    return nullptr;
+}
+
+void
+Scheduler::RequestCPUSwitch()
+{
+    cpuSwitchRequested = true;
+}
+
+bool
+Scheduler::TakeCPUSwitch()
+{
+    bool requested = cpuSwitchRequested;
+    cpuSwitchRequested = false;
+    return requested;
+}
 
-    unsigned i = 0;
-    while(i < QUEUES && !next) {
-        if(readyList[i]->IsEmpty()) i++;
-        else next = readyList[i]->Pop();
+/// With gang scheduling, a thread of another space becomes the gang when
+/// it is dispatched with no thread of the gang running.
+Thread *
+Scheduler::Dequeue(unsigned c)
+{
+    ASSERT(cpus[c].nonEmpty != 0);
+
+#ifdef USER_PROGRAM
+    if (gangScheduling && gang != nullptr) {
+        Thread *member = TakeGangMember(c);
+        if (member != nullptr) {
+            stats->RecordReadyWait(member->queue,
+                                   stats->totalTicks - member->readySince);
+            DEBUG('t', "Found next thread of the gang to run: %s\n",
+                  member->GetName());
+            return member;
+        }
     }
+#endif
 
-    if (next) DEBUG('t', "Found next thread to run: %s\n", next->GetName());
+    unsigned i = __builtin_ctz(cpus[c].nonEmpty);
+    Thread *next = Take(c, i);
+    stats->RecordReadyWait(i, stats->totalTicks - next->readySince);
+#ifdef USER_PROGRAM
+    if (gangScheduling && next->space != nullptr && next->space != gang
+          && !IsGangRunning()) {
+        DEBUG('t', "Thread %s starts a new gang\n", next->GetName());
+        gang = next->space;
+        stats->numGangSwitches++;
+    }
+#endif
 
+    DEBUG('t', "Found next thread to run: %s\n", next->GetName());
     return next;
 }
 
+Thread *
+Scheduler::Take(unsigned c, unsigned i)
+{
+    CPUState *state = &cpus[c];
+    ASSERT(!state->readyList[i].IsEmpty());
+
+    Thread *t = state->readyList[i].Pop();
+    if (state->readyList[i].IsEmpty()) {
+        state->nonEmpty &= ~(1U << i);
+    }
+    state->numReady--;
+    return t;
+}
+
+/// A thread stays on the CPU it ran on, which keeps its TLB entries, unless
+/// that one is busy and another is idle.  A new thread goes to the CPU with
+/// the fewest threads.
+unsigned
+Scheduler::PlaceOf(const Thread *thread) const
+{
+    unsigned last = thread->cpu;
+    if (last != NO_CPU) {
+        if (LoadOf(last) > 0) {
+            for (unsigned c = 0; c < numCPUs; c++) {
+                if (LoadOf(c) == 0) {
+                    return c;
+                }
+            }
+        }
+        return last;
+    }
+
+    unsigned best = 0;
+    for (unsigned c = 1; c < numCPUs; c++) {
+        if (LoadOf(c) < LoadOf(best)) {
+            best = c;
+        }
+    }
+    return best;
+}
+
+/// The thread on the CPU being simulated is `currentThread`, as long as it
+/// has not blocked.
+unsigned
+Scheduler::LoadOf(unsigned c) const
+{
+    bool busy = c == cpu ? currentThread->status == RUNNING
+                         : cpus[c].running != nullptr;
+    return cpus[c].numReady + (busy ? 1 : 0);
+}
+
+#ifdef USER_PROGRAM
+void
+Scheduler::SetGangScheduling(bool enabled)
+{
+    gangScheduling = enabled;
+    gang = nullptr;
+}
+
+/// A member counts as picked out of turn if some other thread was ahead
+/// of it.
+Thread *
+Scheduler::TakeGangMember(unsigned c)
+{
+    CPUState *state = &cpus[c];
+    bool ahead = false;
+    for (unsigned i = 0; i < QUEUES; i++) {
+        for (Thread *t = state->readyList[i].Head(); t != nullptr;
+             t = state->readyList[i].Next(t)) {
+            if (t->space == nullptr) {
+                return nullptr;
+            }
+            if (t->space != gang) {
+                ahead = true;
+                continue;
+            }
+            state->readyList[i].Remove(t);
+            if (state->readyList[i].IsEmpty()) {
+                state->nonEmpty &= ~(1U << i);
+            }
+            state->numReady--;
+            if (ahead) {
+                stats->numGangPicks++;
+            }
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+bool
+Scheduler::IsGangRunning() const
+{
+    for (unsigned c = 0; c < numCPUs; c++) {
+        if (c != cpu && cpus[c].running != nullptr
+              && cpus[c].running->space == gang) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+unsigned
+Scheduler::QueueOf(const Thread *thread)
+{
+    int level = (int) thread->priority + thread->bonus;
+    if (level < 0) {
+        level = 0;
+    } else if (level > PRIORITY_MAX) {
+        level = PRIORITY_MAX;
+    }
+    return PRIORITY_MAX - level;
+}
+
+void
+Scheduler::Enqueue(Thread *thread)
+{
+    ASSERT(thread->priority < QUEUES);
+
+    ASSERT(thread->cpu < numCPUs);
+
+    CPUState *state = &cpus[thread->cpu];
+    thread->queue = QueueOf(thread);
+    state->readyList[thread->queue].Append(thread);
+    state->nonEmpty |= 1U << thread->queue;
+    state->numReady++;
+}
+
+/// Threads enter each queue in order of arrival, so those waiting the
+/// longest are at the front.
+void
+Scheduler::Age()
+{
+    lastAging = stats->totalTicks;
+
+    // The top queue has nowhere to go.
+    for (unsigned c = 0; c < numCPUs; c++) {
+        CPUState *state = &cpus[c];
+        for (unsigned i = 1; i < QUEUES; i++) {
+            while (!state->readyList[i].IsEmpty()) {
+                Thread *t = state->readyList[i].Head();
+                if (stats->totalTicks - t->agedSince < AGING_TICKS) {
+                    break;
+                }
+                state->readyList[i].Pop();
+                state->numReady--;
+                if (t->bonus < PRIORITY_MAX) {
+                    t->bonus++;
+                }
+                t->agedSince = stats->totalTicks;
+                Enqueue(t);
+                DEBUG('t', "Aging thread %s to queue %u\n",
+                      t->GetName(), t->queue);
+            }
+            if (state->readyList[i].IsEmpty()) {
+                state->nonEmpty &= ~(1U << i);
+            }
+        }
+    }
+}
+
+unsigned
+Scheduler::SliceUnitsOf(const Thread *thread)
+{
+    return 1 + QueueOf(thread) * (MAX_SLICE_UNITS - 1) / (QUEUES - 1);
+}
+
+bool
+Scheduler::TimerTick()
+{
+    ++cpus[cpu].sliceTicks;
+    return IsSliceOver();
+}
+
+bool
+Scheduler::IsSliceOver() const
+{
+    return cpus[cpu].sliceTicks >= cpus[cpu].sliceUnits;
+}
+
+void
+Scheduler::SliceExpired(Thread *thread)
+{
+    ASSERT(thread != nullptr);
+
+    stats->numSlicesExpired++;
+    if (stats->totalTicks - thread->runSince >= FULL_SLICE_TICKS
+          && thread->bonus > -PRIORITY_MAX) {
+        thread->bonus--;
+        DEBUG('t', "Thread %s used up its slice, bonus now %d\n",
+              thread->GetName(), thread->bonus);
+    }
+}
+
 /// Dispatch the CPU to `nextThread`.
 ///
 /// Save the state of the old thread, and load the state of the new thread,
 /// by calling the machine dependent context switch routine, `SWITCH`.
 ///
 /// Note: we assume the state of the previously running thread has already
-/// been changed from running to blocked or ready (depending).
+/// been changed from running to blocked or ready (depending), unless the
+/// simulation is moving on to another CPU, whose thread still runs there.
 ///
 /// Side effect: the global variable `currentThread` becomes `nextThread`.
 ///
@@ -95,13 +440,19 @@ void
 Scheduler::Run(Thread *nextThread)
 {
     ASSERT(nextThread != nullptr);
+    ASSERT(nextThread->cpu < numCPUs);
 
     Thread *oldThread = currentThread;
+    unsigned fromCPU = cpu;
+
+    // A thread left running on its CPU just goes on with its slice.
+    bool resuming = nextThread->status == RUNNING;
 
 #ifdef USER_PROGRAM  // Ignore until running user programs.
     if (currentThread->space != nullptr) {
-        // If this thread is a user program, save the user's CPU registers.
-        currentThread->SaveUserState();
+        // If this thread is a user program, its CPU registers stay in the
+        // machine until another user program needs them.
+        currentThread->LeaveUserState();
         currentThread->space->SaveState();
     }
 #endif
@@ -109,12 +460,57 @@ Scheduler::Run(Thread *nextThread)
     oldThread->CheckOverflow();  // Check if the old thread had an undetected
                                  // stack overflow.
 
+    oldThread->cpuTicks += stats->totalTicks - oldThread->runSince;
+    stats->cpuBusyTicks[fromCPU] += stats->totalTicks - oldThread->runSince;
+
+    // A thread put back on a ready list is left on the CPU it went to.
+    if (oldThread->status != READY) {
+        oldThread->cpu = fromCPU;
+    }
+    cpus[fromCPU].running = oldThread->status == RUNNING ? oldThread
+                                                         : nullptr;
+    cpu = nextThread->cpu;
+    cpus[cpu].running = nextThread;
+
     currentThread = nextThread;  // Switch to the next thread.
     currentThread->SetStatus(RUNNING);  // `nextThread` is now running.
+    currentThread->runSince = stats->totalTicks;
+    if (oldThread != nextThread) {
+        if (!resuming) {
+            stats->numContextSwitches++;
+            nextThread->usage.switches++;
+        }
+        if (tracer != nullptr) {
+            tracer->RecordSwitch(nextThread->GetName());
+        }
+    }
+
+    // A new slice starts, as long as the thread's current level deserves.
+    if (!resuming) {
+        cpus[cpu].sliceUnits = SliceUnitsOf(nextThread);
+        cpus[cpu].sliceTicks = 0;
+        if (preemptiveScheduler != nullptr) {
+            PreemptiveScheduler::SetSliceUnits(cpus[cpu].sliceUnits);
+        }
+    }
 
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
           oldThread->GetName(), nextThread->GetName());
 
+#ifdef USER_PROGRAM
+    if (cpu != fromCPU) {
+        machine->SelectCPU(cpu);
+    }
+
+    // If there is an address space to restore, do it, unless no other
+    // user program ran on this CPU since this one did: then the registers
+    // and the MMU are just as it left them.  This is done before switching,
+    // so that a thread starting afresh gets its state as well.
+    if (nextThread->space != nullptr && nextThread->LoadUserState()) {
+        nextThread->space->RestoreState();
+    }
+#endif
+
     // This is a machine-dependent assembly language routine defined in
     // `switch.s`.  You may have to think a bit to figure out what happens
     // after this, both from the point of view of the thread and from the
@@ -124,6 +520,12 @@ Scheduler::Run(Thread *nextThread)
 
     DEBUG('t', "Now in thread \"%s\"\n", currentThread->GetName());
 
+#ifdef USER_PROGRAM
+    if (currentThread->space != nullptr) {
+        currentThread->space->UpdateInfoPage();
+    }
+#endif
+
     // If the old thread gave up the processor because it was finishing, we
     // need to delete its carcass.  Note we cannot delete the thread before
     // now (for example, in `Thread::Finish`), because up to this point, we
@@ -133,40 +535,60 @@ Scheduler::Run(Thread *nextThread)
         threadToBeDestroyed = nullptr;
     }
 
-#ifdef USER_PROGRAM
-    if (currentThread->space != nullptr) {
-        // If there is an address space to restore, do it.
-        currentThread->RestoreUserState();
-        currentThread->space->RestoreState();
-    }
-#endif
 }
 
-/// Print the scheduler state -- in other words, the contents of the ready
-/// list.
+/// Print the scheduler state -- in other words, the running thread and the
+/// contents of the ready list, with the ticks each thread has run for.
 ///
 /// For debugging.
-static void
-ThreadPrint(Thread *t)
-{
-    ASSERT(t != nullptr);
-    t->Print();
-}
-
 void
 Scheduler::Print()
 {
-    printf("Ready list contents:\n");
-
-    for(unsigned i=0; i < QUEUES; i++)
-        readyList[i]->Apply(ThreadPrint);
+    unsigned long now = stats->totalTicks;
 
-    printf("\n");
+    printf("Running: %s, cpu %lu ticks\n", currentThread->GetName(),
+           currentThread->cpuTicks + now - currentThread->runSince);
+    for (unsigned c = 0; c < numCPUs; c++) {
+        const CPUState *state = &cpus[c];
+        if (numCPUs == 1) {
+            printf("Ready list contents:\n");
+        } else if (c != cpu && state->running != nullptr) {
+            printf("CPU %u, running %s, cpu %lu ticks; ready:\n",
+                   c, state->running->GetName(), state->running->cpuTicks);
+        } else {
+            printf("CPU %u%s; ready:\n", c, c == cpu ? ", simulated" : "");
+        }
+        for (unsigned i = 0; i < QUEUES; i++) {
+            for (Thread *t = state->readyList[i].Head(); t != nullptr;
+                 t = state->readyList[i].Next(t)) {
+                printf("  %s: queue %u, waiting %lu ticks, cpu %lu ticks\n",
+                       t->GetName(), i, now - t->readySince, t->cpuTicks);
+            }
+        }
+    }
 }
 
+/// A thread whose priority was raised also loses any penalty, so that it
+/// does get to run ahead of those it is holding up.  Only ready threads
+/// move; any other thread is queued by its new priority when it becomes
+/// ready.
 void
 Scheduler::UpdatePriority(Thread* thread, unsigned prevPriority)
 {
-    readyList[QUEUES - 1 - prevPriority]->Remove(thread);
-    ReadyToRun(thread);
+    ASSERT(thread != nullptr);
+
+    if (thread->GetPriority() > prevPriority && thread->bonus < 0) {
+        thread->bonus = 0;
+    }
+    if (thread->status != READY) {
+        return;
+    }
+
+    CPUState *state = &cpus[thread->cpu];
+    state->readyList[thread->queue].Remove(thread);
+    state->numReady--;
+    if (state->readyList[thread->queue].IsEmpty()) {
+        state->nonEmpty &= ~(1U << thread->queue);
+    }
+    Enqueue(thread);
 }
\ No newline at end of file
@@ -12,29 +12,88 @@
 
 
 #include "thread.hh"
-#include "lib/list.hh"
+#include "machine/statistics.hh"
 
 #define QUEUES 10
-#define PRIORITY_MAX QUEUES-1
+#define PRIORITY_MAX (QUEUES - 1)
+
+/// Ticks a thread must run without interruption for its slice to count as
+/// used up, and ticks a ready thread waits before it is promoted.
+const unsigned long FULL_SLICE_TICKS = 100;
+const unsigned long AGING_TICKS      = 500;
+
+/// Most a thread is raised above its priority for having blocked.
+const int WAKEUP_BONUS = 1;
+
+/// Most time slices a thread runs for before being preempted.  Threads in
+/// the top queue get one slice, those in the bottom one this many, and
+/// those in between something in between: the lower a thread has sunk for
+/// using up its slices, the fewer times it is interrupted.
+const unsigned MAX_SLICE_UNITS = 4;
 
 /// The following class defines the scheduler/dispatcher abstraction --
 /// the data structures and operations needed to keep track of which
 /// thread is running, and which threads are ready but not running.
+///
+/// Threads are served by priority, as a multi-level feedback queue: each
+/// thread runs at its priority plus a bonus, which drops by one every time
+/// the thread uses up a time slice, comes back up when it blocks, and rises
+/// by one for every `AGING_TICKS` the thread waits ready, so that no thread
+/// starves.
+///
+/// With several CPUs, each has its own ready queues, and the simulation
+/// runs one CPU at a time, the others keeping their threads on hold.  A
+/// thread goes back to the CPU it ran on, unless that one is busy and some
+/// other idle; a CPU with nothing to run steals from the busy one with the
+/// most threads waiting, enough of them to even out their queues.
+///
+/// With gang scheduling, the threads of one address space, the *gang*, are
+/// run together on as many CPUs as they can take: a CPU picks a thread of
+/// the gang before any other user thread, whatever its level, so that
+/// threads waiting for each other find each other running.  Kernel threads
+/// of a higher level still go first.  Another space becomes the gang once
+/// no CPU runs a thread of the current one.
 class Scheduler {
 public:
 
-    /// Initialize list of ready threads.
-    Scheduler();
+    /// CPU of a thread that never ran.
+    static const unsigned NO_CPU = (unsigned) -1;
+
+    /// Initialize the lists of ready threads of `numCPUs` CPUs.
+    Scheduler(unsigned numCPUs = 1);
 
     /// De-allocate ready list.
     ~Scheduler();
 
+    /// Number of CPUs, and the one being simulated, which `currentThread`
+    /// runs on.
+    unsigned GetNumCPUs() const;
+    unsigned GetCPU() const;
+
+    /// Return the number of threads ready to run on the CPU being
+    /// simulated.
+    unsigned GetNumReady() const;
+
     /// Thread can be dispatched.
     void ReadyToRun(Thread *thread);
 
-    /// Dequeue first thread on the ready list, if any, and return thread.
+    /// Dequeue the first thread ready on the CPU being simulated or, if
+    /// there is none, one waiting for a busy CPU; return null if none.
     Thread *FindNextToRun();
 
+    /// Return the thread of the next CPU, after the one being simulated,
+    /// that has something to run: the thread it was left running, or the
+    /// first one ready on it.  Return null if there is none.  Running the
+    /// thread moves the simulation to its CPU.
+    Thread *FindNextCPU();
+
+    /// Ask for the next `Thread::Yield` to hand the simulation over to the
+    /// next CPU, rather than the CPU over to another thread.
+    void RequestCPUSwitch();
+
+    /// Return whether that was asked since the last time, and forget it.
+    bool TakeCPUSwitch();
+
     /// Cause `nextThread` to start running.
     void Run(Thread *nextThread);
 
@@ -43,10 +102,106 @@ public:
 
     void UpdatePriority(Thread* thread, unsigned prevPriority);
 
+    /// Count a timer interrupt on the CPU being simulated; return whether
+    /// its thread has been through all of its slices, and so is to be
+    /// preempted.
+    bool TimerTick();
+
+    /// Return whether the thread on the CPU being simulated has been
+    /// through all of its slices.
+    bool IsSliceOver() const;
+
+    /// Tell that the time slices of `thread`, which is running, are over.
+    /// If it ran that long without interruption, it goes down one level.
+    void SliceExpired(Thread *thread);
+
+#ifdef USER_PROGRAM
+    /// Run the threads of an address space together, or not.
+    void SetGangScheduling(bool enabled);
+#endif
+
 private:
 
-    // Queue of threads that are ready to run, but not running.
-    List<Thread*> **readyList;
+    /// Return the queue `thread` belongs in.
+    static unsigned QueueOf(const Thread *thread);
+
+    /// Return the number of slices `thread` gets when dispatched.
+    static unsigned SliceUnitsOf(const Thread *thread);
+
+    /// Put `thread` at the end of its queue, on its CPU.
+    void Enqueue(Thread *thread);
+
+    /// Take the first thread off the queues of `cpu`.
+    Thread *Dequeue(unsigned cpu);
+
+    /// Take the first thread off `readyList[queue]` of `cpu`.
+    Thread *Take(unsigned cpu, unsigned queue);
+
+    /// Take threads waiting for another CPU for the one being simulated,
+    /// which has nothing to run; return the one to run now, or null if no
+    /// busy CPU has any waiting.
+    Thread *Steal();
+
+    /// Promote the threads that have been ready for `AGING_TICKS`.
+    void Age();
+
+    /// Return the CPU a thread becoming ready is to run on.
+    unsigned PlaceOf(const Thread *thread) const;
+
+    /// Return the threads running and ready on `cpu`.
+    unsigned LoadOf(unsigned cpu) const;
+
+#ifdef USER_PROGRAM
+    /// Take the first thread of the gang off the queues of `cpu`, unless
+    /// some kernel thread comes before it; return null if none is taken.
+    Thread *TakeGangMember(unsigned cpu);
+
+    /// Return whether a CPU other than the one being simulated runs a
+    /// thread of the gang.
+    bool IsGangRunning() const;
+#endif
+
+    /// What the scheduler keeps for every CPU.
+    class CPUState {
+    public:
+
+        // Queue of threads that are ready to run, but not running.
+        ThreadQueue readyList[QUEUES];
+
+        /// Bit `i` is set if `readyList[i]` is not empty.
+        unsigned nonEmpty;
+
+        /// Number of threads in `readyList`.
+        unsigned numReady;
+
+        /// Thread the CPU was left running when the simulation moved to
+        /// another CPU, or null if it was left idle.
+        Thread *running;
+
+        /// Slices the running thread gets, and timer interrupts it has
+        /// seen.
+        unsigned sliceUnits;
+        unsigned sliceTicks;
+    };
+
+    CPUState cpus[Statistics::MAX_CPUS];
+    unsigned numCPUs;
+
+    /// CPU being simulated.
+    unsigned cpu;
+
+    /// Whether a timer interrupt asked to move on to the next CPU.
+    bool cpuSwitchRequested;
+
+    /// When `Age` last ran.
+    unsigned long lastAging;
+
+#ifdef USER_PROGRAM
+    /// Whether gang scheduling is on, and the space whose threads run
+    /// together, or null.
+    bool gangScheduling;
+    AddressSpace *gang;
+#endif
 
 };
 
@@ -33,16 +33,13 @@ Semaphore::Semaphore(const char *debugName, int initialValue)
 {
     name  = debugName;
     value = initialValue;
-    queue = new List<Thread *>;
 }
 
 /// De-allocate semaphore, when no longer needed.
 ///
 /// Assume no one is still waiting on the semaphore!
 Semaphore::~Semaphore()
-{
-    delete queue;
-}
+{}
 
 const char *
 Semaphore::GetName() const
@@ -50,7 +47,7 @@ Semaphore::GetName() const
     return name;
 }
 
-/// Wait until semaphore `value > 0`, then decrement.
+/// Wait until semaphore `value >= units`, then take them.
 ///
 /// Checking the value and decrementing must be done atomically, so we need
 /// to disable interrupts before checking the value.
@@ -58,40 +55,51 @@ Semaphore::GetName() const
 /// Note that `Thread::Sleep` assumes that interrupts are disabled when it is
 /// called.
 void
-Semaphore::P()
+Semaphore::P(unsigned units)
 {
-    DEBUG('s', "Semaphore %s->P()\n", name);
+    ASSERT(units > 0);
+    DEBUG('s', "Semaphore %s->P(%u)\n", name, units);
 
     IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
       // Disable interrupts.
 
-    while (value == 0) {  // Semaphore not available.
-        queue->Append(currentThread);  // So go to sleep.
-        currentThread->Sleep();
+    if (queue.IsEmpty() && (unsigned) value >= units) {
+        value -= units;  // Semaphore available, consume its value.
+    } else {
+        // `V` takes the units off for us before waking us up.
+        currentThread->semaphoreUnits = units;
+        queue.Append(currentThread);  // So go to sleep.
+        while (currentThread->semaphoreUnits != 0) {
+            currentThread->Sleep();
+        }
     }
-    value--;  // Semaphore available, consume its value.
 
     interrupt->SetLevel(oldLevel);  // Re-enable interrupts.
 }
 
-/// Increment semaphore value, waking up a waiter if necessary.
+/// Add `units` to the semaphore value, handing them to waiters as far as
+/// they go.
 ///
 /// As with `P`, this operation must be atomic, so we need to disable
 /// interrupts.  `Scheduler::ReadyToRun` assumes that threads are disabled
 /// when it is called.
 void
-Semaphore::V()
+Semaphore::V(unsigned units)
 {
-    DEBUG('s', "Semaphore %s->V()\n", name);
+    DEBUG('s', "Semaphore %s->V(%u)\n", name, units);
 
     IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
 
-    Thread *thread = queue->Pop();
-    if (thread != nullptr) {
-        // Make thread ready, consuming the `V` immediately.
+    value += units;
+    Thread *thread;
+    while ((thread = queue.Head()) != nullptr
+           && thread->semaphoreUnits <= (unsigned) value) {
+        // Make thread ready, consuming what it waits for immediately.
+        queue.Pop();
+        value -= thread->semaphoreUnits;
+        thread->semaphoreUnits = 0;
         scheduler->ReadyToRun(thread);
     }
-    value++;
 
     interrupt->SetLevel(oldLevel);
 }
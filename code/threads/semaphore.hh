@@ -21,7 +21,6 @@
 
 
 #include "thread.hh"
-#include "lib/list.hh"
 
 
 /// This class defines a “semaphore”, which has a positive integer as its
@@ -32,6 +31,12 @@
 /// * `P` -- wait until `value > 0`, then decrement `value`.
 /// * `V` -- increment `value`, awaken a waiting thread if any.
 ///
+/// Both take a number of units, one by default, to wait for or to add at
+/// once.  Units are handed straight to the threads waiting, in the order
+/// they came, as far as they go: a thread woken up has what it waited for
+/// already, and need not contend for it again.  A thread never gets ahead
+/// of another waiting, even if there are units enough for it alone.
+///
 /// Observe that this interface does *not* allow to read the semaphore value
 /// directly -- even if you were able to read it, it would serve for nothing,
 /// because meanwhile another thread could have modified the semaphore, in
@@ -52,8 +57,8 @@ public:
     /// The only public operations on the semaphore.
     ///
     /// Both of them must be *atomic*.
-    void P();
-    void V();
+    void P(unsigned units = 1);
+    void V(unsigned units = 1);
 
 private:
 
@@ -63,8 +68,9 @@ private:
     /// Semaphore value, it is always `>= 0`.
     int value;
 
-    /// Queue of threads waiting on `P` because the value is zero.
-    List<Thread *> *queue;
+    /// Queue of threads waiting on `P` because the value is too low, each
+    /// for the units in its `Thread::semaphoreUnits`.
+    ThreadQueue queue;
 
 };
 
@@ -0,0 +1,148 @@
+/// Routines to export statistics in a machine-readable form.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "stats_export.hh"
+#include "system.hh"
+#include "tracer.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+StatsExporter::StatsExporter(unsigned long interval_)
+{
+    interval       = interval_;
+    nextSnapshot   = interval;
+    snapshots      = new StatsSnapshot [MAX_SNAPSHOTS];
+    numSnapshots   = 0;
+    threads        = new ThreadRecord [MAX_THREADS];
+    numThreads     = 0;
+    droppedThreads = 0;
+}
+
+StatsExporter::~StatsExporter()
+{
+    delete [] snapshots;
+    delete [] threads;
+}
+
+/// With no room left, every other snapshot goes, starting from the second,
+/// and the interval doubles, so that those left are evenly spaced still.
+void
+StatsExporter::Tick()
+{
+    if (interval == 0 || stats->totalTicks < nextSnapshot) {
+        return;
+    }
+
+    if (numSnapshots == MAX_SNAPSHOTS) {
+        for (unsigned i = 0; 2 * i < MAX_SNAPSHOTS; i++) {
+            snapshots[i] = snapshots[2 * i];
+        }
+        numSnapshots = (MAX_SNAPSHOTS + 1) / 2;
+        interval *= 2;
+    }
+
+    StatsSnapshot *s = &snapshots[numSnapshots++];
+    s->totalTicks      = stats->totalTicks;
+    s->idleTicks       = stats->idleTicks;
+    s->systemTicks     = stats->systemTicks;
+    s->userTicks       = stats->userTicks;
+    s->contextSwitches = stats->numContextSwitches;
+    s->diskReads       = stats->numDiskReads;
+    s->diskWrites      = stats->numDiskWrites;
+    s->pageFaults      = stats->numPageFaults;
+    s->tlbMisses       = stats->tlbMisses;
+    s->packetsSent     = stats->numPacketsSent;
+    s->packetsReceived = stats->numPacketsRecvd;
+    nextSnapshot = s->totalTicks + interval;
+}
+
+void
+StatsExporter::RecordThread(const Thread *thread)
+{
+    ASSERT(thread != nullptr);
+
+    Record(thread, true);
+}
+
+void
+StatsExporter::Record(const Thread *thread, bool finished)
+{
+    if (numThreads == MAX_THREADS) {
+        droppedThreads++;
+        return;
+    }
+    ThreadRecord *r = &threads[numThreads++];
+    strncpy(r->name, thread->GetName(), ThreadRecord::NAME_SIZE - 1);
+    r->name[ThreadRecord::NAME_SIZE - 1] = '\0';
+    r->finished = finished;
+    r->usage    = thread->usage;
+}
+
+/// The file holds one object, with the statistics, the threads and the
+/// snapshots, in the order they were taken.
+bool
+StatsExporter::Dump(const char *fileName)
+{
+    ASSERT(fileName != nullptr);
+
+    Record(currentThread, false);
+#ifdef USER_PROGRAM
+    for (unsigned pid = 0; pid < processTable->Capacity(); pid++) {
+        Thread *t = processTable->Get(pid);
+        if (t != nullptr && t != currentThread) {
+            Record(t, false);
+        }
+    }
+#endif
+
+    FILE *f = fopen(fileName, "w");
+    if (f == nullptr) {
+        return false;
+    }
+
+    fprintf(f, "{\"statistics\":");
+    stats->PrintJSON(f);
+
+    fprintf(f, ",\n\"droppedThreads\":%lu,\n\"threads\":[", droppedThreads);
+    for (unsigned i = 0; i < numThreads; i++) {
+        const ThreadRecord *r = &threads[i];
+        fprintf(f, "%s\n{\"name\":", i == 0 ? "" : ",");
+        PrintJSONString(f, r->name);
+        fprintf(f, ",\"finished\":%s,\"userTicks\":%lu,\"systemTicks\":%lu,"
+                   "\"switches\":%lu,\"pageFaults\":%lu,\"tlbMisses\":%lu,"
+                   "\"sectorsRead\":%lu,\"sectorsWritten\":%lu",
+                r->finished ? "true" : "false",
+                r->usage.userTicks, r->usage.systemTicks, r->usage.switches,
+                r->usage.pageFaults, r->usage.tlbMisses,
+                r->usage.sectorsRead, r->usage.sectorsWritten);
+#ifdef CACHE_MODEL
+        fprintf(f, ",\"cacheAccesses\":%lu,\"cacheMisses\":%lu",
+                r->usage.cacheAccesses, r->usage.cacheMisses);
+#endif
+        fprintf(f, "}");
+    }
+
+    fprintf(f, "],\n\"snapshotInterval\":%lu,\n\"snapshots\":[", interval);
+    for (unsigned i = 0; i < numSnapshots; i++) {
+        const StatsSnapshot *s = &snapshots[i];
+        fprintf(f, "%s\n{\"ticks\":%lu,\"idleTicks\":%lu,\"systemTicks\":%lu,"
+                   "\"userTicks\":%lu,\"contextSwitches\":%lu,"
+                   "\"diskReads\":%lu,\"diskWrites\":%lu,\"pageFaults\":%lu,"
+                   "\"tlbMisses\":%lu,\"packetsSent\":%lu,"
+                   "\"packetsReceived\":%lu}",
+                i == 0 ? "" : ",", s->totalTicks, s->idleTicks,
+                s->systemTicks, s->userTicks, s->contextSwitches,
+                s->diskReads, s->diskWrites, s->pageFaults, s->tlbMisses,
+                s->packetsSent, s->packetsReceived);
+    }
+    fprintf(f, "]}\n");
+
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
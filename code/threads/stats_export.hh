@@ -0,0 +1,97 @@
+/// Data structures to export statistics in a machine-readable form.
+///
+/// `Statistics::Print` is meant to be read by people.  The exporter writes
+/// the same statistics as JSON instead, when Nachos halts, so that runs can
+/// be compared by scripts, together with what each thread used, and with
+/// snapshots of the main counters taken every `interval` ticks, so that a
+/// long run can be charted over time.
+///
+/// Snapshots are taken by the timer interrupt, and kept in a fixed-size
+/// array: once it is full, every other snapshot is dropped, and the
+/// interval doubled, so that the whole run stays covered.  Threads are
+/// recorded as they finish; those still alive at the halt are recorded
+/// then.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_STATSEXPORT__HH
+#define NACHOS_THREADS_STATSEXPORT__HH
+
+
+#include "thread.hh"
+
+
+/// The main counters, at some point of the run.
+class StatsSnapshot {
+public:
+    unsigned long totalTicks;
+    unsigned long idleTicks;
+    unsigned long systemTicks;
+    unsigned long userTicks;
+    unsigned long contextSwitches;
+    unsigned long diskReads;
+    unsigned long diskWrites;
+    unsigned long pageFaults;
+    unsigned long tlbMisses;
+    unsigned long packetsSent;
+    unsigned long packetsReceived;
+};
+
+/// What a thread used, copied since threads come and go.
+class ThreadRecord {
+public:
+
+    /// Longest thread name kept, including the terminating null.
+    static const unsigned NAME_SIZE = 32;
+
+    char name[NAME_SIZE];
+    bool finished;
+    ThreadUsage usage;
+};
+
+class StatsExporter {
+public:
+
+    /// Ticks between snapshots, unless told otherwise.
+    static const unsigned long DEFAULT_INTERVAL = 10000;
+
+    /// Snapshots, and threads, kept at most.
+    static const unsigned MAX_SNAPSHOTS = 1024;
+    static const unsigned MAX_THREADS = 1024;
+
+    /// Initialize an exporter taking a snapshot every `interval` ticks;
+    /// none if `interval` is 0.
+    StatsExporter(unsigned long interval = DEFAULT_INTERVAL);
+
+    ~StatsExporter();
+
+    /// Take a snapshot if one is due.  Called on every timer interrupt.
+    void Tick();
+
+    /// Record what `thread`, which is finishing, used.
+    void RecordThread(const Thread *thread);
+
+    /// Write the statistics, threads and snapshots into `fileName`.
+    /// Return false if the file cannot be written.
+    bool Dump(const char *fileName);
+
+private:
+
+    /// Record `thread`, as finished or not.
+    void Record(const Thread *thread, bool finished);
+
+    unsigned long interval;
+    unsigned long nextSnapshot;  ///< When the next snapshot is due.
+
+    StatsSnapshot *snapshots;
+    unsigned numSnapshots;
+
+    ThreadRecord *threads;
+    unsigned numThreads;
+    unsigned long droppedThreads;  ///< Not recorded, for lack of room.
+};
+
+
+#endif
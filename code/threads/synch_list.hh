@@ -36,10 +36,19 @@ public:
     /// remove.
     void Append(Item item);
 
+    /// Insert item after every other item with a key not greater than
+    /// `sortKey`, and wake up any thread waiting in remove.  A list filled
+    /// only this way is popped in order of key.
+    void SortedInsert(Item item, int sortKey);
+
     /// Remove the first item from the front of the list, waiting if the list
     /// is empty.
     Item Pop();
 
+    /// Remove the first item into `item`, and return true, if the list is
+    /// not empty; return false without waiting if it is.
+    bool TryPop(Item *item);
+
     /// Apply function to every item in the list.
     void Apply(void (*func)(Item));
 
@@ -93,6 +102,16 @@ SynchList<Item>::Append(Item item)
     lock->Release();
 }
 
+template <class Item>
+void
+SynchList<Item>::SortedInsert(Item item, int sortKey)
+{
+    lock->Acquire();
+    list->SortedInsert(item, sortKey);
+    listEmpty->Signal();
+    lock->Release();
+}
+
 /// Remove an “item” from the beginning of the list.  Wait if the list is
 /// empty.
 ///
@@ -114,6 +133,21 @@ SynchList<Item>::Pop()
     return item;
 }
 
+template <class Item>
+bool
+SynchList<Item>::TryPop(Item *item)
+{
+    ASSERT(item != nullptr);
+
+    lock->Acquire();
+    bool found = !list->IsEmpty();
+    if (found) {
+        *item = list->Pop();
+    }
+    lock->Release();
+    return found;
+}
+
 /// Apply function to every item on the list.
 ///
 /// Obey mutual exclusion constraints.
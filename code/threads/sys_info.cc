@@ -43,6 +43,23 @@ void SysInfo()
 #endif
       ;
 
+    // The sizes chosen when Nachos started, where the device is simulated.
+#ifdef USER_PROGRAM
+    unsigned numPages = numPhysPages;
+#else
+    unsigned numPages = DEFAULT_NUM_PHYS_PAGES;
+#endif
+#ifdef FILESYS
+    unsigned numSectors = diskSectors;
+#else
+    unsigned numSectors = DEFAULT_NUM_TRACKS * SECTORS_PER_TRACK;
+#endif
+#ifdef FILESYS_STUB
+    unsigned freeMapSize = FreeMapFileSize();
+#else
+    unsigned freeMapSize = numSectors / BITS_IN_BYTE;
+#endif
+
     printf("System information.\n");
     printf("\n\
 General:\n\
@@ -55,7 +72,7 @@ Memory:\n\
   Number of pages: %u.\n\
   Number of TLB entries: %u.\n\
   Memory size: %u bytes.\n",
-      PAGE_SIZE, NUM_PHYS_PAGES, TLB_SIZE, MEMORY_SIZE);
+      PAGE_SIZE, numPages, TLB_SIZE, numPages * PAGE_SIZE);
     printf("\n\
 Disk:\n\
   Sector size: %u bytes.\n\
@@ -63,15 +80,16 @@ Disk:\n\
   Number of tracks: %u.\n\
   Number of sectors: %u.\n\
   Disk size: %u bytes.\n",
-      SECTOR_SIZE, SECTORS_PER_TRACK, NUM_TRACKS, NUM_SECTORS, SECTOR_SIZE * NUM_SECTORS);
+      SECTOR_SIZE, SECTORS_PER_TRACK, numSectors / SECTORS_PER_TRACK,
+      numSectors, SECTOR_SIZE * numSectors);
     printf("\n\
 Filesystem:\n\
-  Sectors per header: %u.\n\
+  Extents per file: %u.\n\
   Maximum file size: %u bytes.\n\
   File name maximum length: %u.\n\
   Free sectors map size: %u bytes.\n\
   Maximum number of dir-entries: %u.\n\
   Directory file size: %u bytes.\n",
-      NUM_DIRECT, MAX_FILE_SIZE, FILE_NAME_MAX_LEN,
-      FREE_MAP_FILE_SIZE, NUM_DIR_ENTRIES, DIRECTORY_FILE_SIZE);
+      NUM_EXTENTS, numSectors * SECTOR_SIZE, FILE_NAME_MAX_LEN,
+      freeMapSize, NUM_DIR_ENTRIES, DIRECTORY_FILE_SIZE);
 }
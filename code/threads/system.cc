@@ -10,10 +10,15 @@
 #include "preemptive.hh"
 
 #ifdef USER_PROGRAM
+#include "userprog/address_space.hh"
 #include "userprog/debugger.hh"
 #include "userprog/exception.hh"
 #endif
 
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -29,6 +34,16 @@ Interrupt *interrupt;         ///< Interrupt status.
 Statistics *stats;            ///< Performance metrics.
 Timer *timer;                 ///< The hardware timer device, for invoking
                               ///< context switches.
+Alarm *alarmClock;            ///< Sleeping threads.
+WorkQueue *workQueue;         ///< Deferred kernel work.
+
+Tracer *tracer = nullptr;     ///< Kernel events, if tracing.
+static const char *traceFile;  ///< Where to write them at halt.
+InputLog *inputLog = nullptr;  ///< Inputs recorded or replayed, if any.
+LockStats *lockStats = nullptr;  ///< Contention on locks, if counting.
+
+StatsExporter *statsExporter = nullptr;  ///< Statistics as JSON, if asked.
+static const char *statsFile;            ///< Where to write them at halt.
 
 // 2007, Jose Miguel Santos Espino
 PreemptiveScheduler *preemptiveScheduler = nullptr;
@@ -40,6 +55,10 @@ FileSystem *fileSystem;
 
 #ifdef FILESYS
 SynchDisk *synchDisk;
+InodeTable *inodeTable;
+PageCache *pageCache;
+Journal *journal;
+DirtyMap *dirtyMap;
 #endif
 
 #ifdef USER_PROGRAM  // Requires either *FILESYS* or *FILESYS_STUB*.
@@ -47,6 +66,27 @@ Machine *machine;  ///< User program memory and registers.
 SynchConsole *gSynchConsole;
 Bitmap *memoryBitmap;
 Table<Thread*> *processTable;
+ImageCache *imageCache;
+Profiler *profiler = nullptr;    ///< Samples of user programs, if profiling.
+static const char *profileFile;  ///< Where to write them at halt.
+unsigned userStackSize = DEFAULT_USER_STACK_SIZE;
+ResourceLimits defaultLimits;  ///< None, unless given with `-lim`.
+ConsoleScript *consoleScript = nullptr;  ///< Typed at the console, if any.
+#ifdef USE_TLB
+Bitmap *asidBitmap;
+#endif
+#endif
+
+#ifdef DEMAND_LOADING
+unsigned readAheadPages = 4;
+#endif
+
+#ifdef VMEM
+CoreMap *coreMap;
+MemoryScheduler *memoryScheduler;
+TextTable *textTable;
+SharedFileTable *sharedFileTable;
+SegmentTable *segmentTable;
 #endif
 
 #ifdef NETWORK
@@ -70,14 +110,63 @@ extern void Cleanup();
 ///
 /// * `dummy` is because every interrupt handler takes one argument, whether
 ///   it needs it or not.
+///
+/// With several CPUs, every tick also hands the simulation over to the next
+/// CPU, so that all of them progress.
 static void
 TimerInterruptHandler(void *dummy)
 {
-    if (interrupt->GetStatus() != IDLE_MODE) {
+    if (statsExporter != nullptr) {
+        statsExporter->Tick();
+    }
+    if (interrupt->GetStatus() == IDLE_MODE) {
+        return;
+    }
+    if (scheduler->TimerTick()) {
+        scheduler->SliceExpired(currentThread);
+        interrupt->YieldOnReturn();
+    }
+    if (scheduler->GetNumCPUs() > 1) {
+        scheduler->RequestCPUSwitch();
         interrupt->YieldOnReturn();
     }
 }
 
+#if defined(USER_PROGRAM) || defined(FILESYS)
+/// Report that `value` is not something `option` takes, telling what it
+/// takes instead, and stop.
+static void
+BadOptionValue(const char *option, const char *value, const char *expected)
+{
+    fprintf(stderr, "Invalid value `%s` for %s: expected %s.\n",
+            value, option, expected);
+    exit(1);
+}
+#endif
+
+#ifdef DEMAND_LOADING
+/// Read `s`, a whole decimal number that is not negative, into `out`;
+/// return false if `s` is anything else.
+static bool
+ParseCount(const char *s, unsigned *out)
+{
+    ASSERT(s != nullptr);
+    ASSERT(out != nullptr);
+
+    if (!isdigit((unsigned char) s[0])) {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    unsigned long n = strtoul(s, &end, 10);
+    if (*end != '\0' || errno != 0 || n > UINT_MAX) {
+        return false;
+    }
+    *out = n;
+    return true;
+}
+#endif
+
 static bool
 ParseDebugOpts(char *s, DebugOpts *out)
 {
@@ -132,6 +221,10 @@ Initialize(int argc, char **argv)
     const char *debugFlags = "";
     DebugOpts debugOpts;
     bool randomYield = false;
+    const char *inputLogFile = nullptr;
+    bool replayInputs = false;
+    unsigned numCPUs = 1;
+    unsigned long statsInterval = StatsExporter::DEFAULT_INTERVAL;
 
     // 2007, Jose Miguel Santos Espino
     bool preemptiveScheduling = false;
@@ -139,13 +232,35 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
+    unsigned tlbSize = TLB_SIZE;
+    unsigned tlbWays = 0;  // Fully associative.
+    TLBPolicy tlbPolicy = TLB_FIFO;
+    bool cookedConsole = false;
+    bool batchedConsole = false;
+    const char *consoleScriptFile = nullptr;
+    bool gangScheduling = false;
+#endif
+#ifdef VMEM
+    FramePolicy framePolicy = FRAME_ECLOCK;
+    bool idleZeroing = false;
 #endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
 #endif
+#ifdef FILESYS
+    unsigned diskCacheSize = SynchDisk::DEFAULT_CACHE_SIZE;
+    unsigned pageCacheSize = PageCache::DEFAULT_SIZE;
+    DiskPolicy diskPolicy = DISK_CLOOK;
+    bool diskMapped = false;
+    bool ramDisk = false;
+    DiskTiming diskTiming = DISK_ACCURATE;
+    bool timingGiven = false;
+    unsigned diskBatch = 1;
+#endif
 #ifdef NETWORK
     double rely = 1;  // Network reliability.
     int netname = 0;  // UNIX socket name.
+    unsigned netQueue = Network::DEFAULT_QUEUE_SIZE;  // Packets kept.
 #endif
 
     for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
@@ -168,6 +283,35 @@ Initialize(int argc, char **argv)
               // Initialize pseudo-random number generator.
             randomYield = true;
             argCount = 2;
+        } else if (!strcmp(*argv, "-rec")) {
+            ASSERT(argc > 1);
+            inputLogFile = *(argv + 1);
+            replayInputs = false;
+            argCount = 2;
+        } else if (!strcmp(*argv, "-replay")) {
+            ASSERT(argc > 1);
+            inputLogFile = *(argv + 1);
+            replayInputs = true;
+            argCount = 2;
+        } else if (!strcmp(*argv, "-cpus")) {
+            ASSERT(argc > 1);
+            numCPUs = atoi(*(argv + 1));
+            ASSERT(numCPUs > 0 && numCPUs <= Statistics::MAX_CPUS);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tr")) {
+            ASSERT(argc > 1);
+            traceFile = *(argv + 1);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-sj")) {
+            ASSERT(argc > 1);
+            statsFile = *(argv + 1);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-sji")) {
+            ASSERT(argc > 1);
+            statsInterval = atol(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-lst")) {
+            lockStats = new LockStats;
         }
         // 2007, Jose Miguel Santos Espino
         else if (!strcmp(*argv, "-p")) {
@@ -182,13 +326,141 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s")) {
             debugUserProg = true;
+        } else if (!strcmp(*argv, "-cl")) {
+            cookedConsole = true;
+        } else if (!strcmp(*argv, "-cb")) {
+            batchedConsole = true;
+        } else if (!strcmp(*argv, "-cs")) {
+            ASSERT(argc > 1);
+            consoleScriptFile = *(argv + 1);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-gang")) {
+            gangScheduling = true;
+        } else if (!strcmp(*argv, "-tlb")) {
+            ASSERT(argc > 1);
+            tlbSize = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlbw")) {
+            ASSERT(argc > 1);
+            tlbWays = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlbp")) {
+            ASSERT(argc > 1);
+            if (!ParseTLBPolicy(*(argv + 1), &tlbPolicy)) {
+                BadOptionValue(*argv, *(argv + 1),
+                               "`fifo`, `lru`, `random` or `clock`");
+            }
+            argCount = 2;
+        } else if (!strcmp(*argv, "-m")) {
+            ASSERT(argc > 1);
+            numPhysPages = atoi(*(argv + 1));
+            ASSERT(numPhysPages > 0
+                     && numPhysPages < TranslationEntry::MAX_FRAMES);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ss")) {
+            ASSERT(argc > 1);
+            userStackSize = atoi(*(argv + 1));
+            ASSERT(userStackSize > 0);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-lim")) {
+            ASSERT(argc > 1);
+            if (!ParseResourceLimits(*(argv + 1), &defaultLimits)) {
+                BadOptionValue(*argv, *(argv + 1),
+                               "`<pages>:<files>:<rate>[:<burst>]`");
+            }
+            argCount = 2;
+        } else if (!strcmp(*argv, "-prof")) {
+            ASSERT(argc > 1);
+            profileFile = *(argv + 1);
+            argCount = 2;
+        }
+#ifdef CACHE_MODEL
+        else if (!strcmp(*argv, "-l1i") || !strcmp(*argv, "-l1d")
+                 || !strcmp(*argv, "-l2")) {
+            ASSERT(argc > 1);
+            CacheLevelId level = !strcmp(*argv, "-l1i") ? CACHE_L1I
+                               : !strcmp(*argv, "-l1d") ? CACHE_L1D
+                               : CACHE_L2;
+            if (!ParseCacheGeometry(*(argv + 1), &cacheGeometries[level])) {
+                BadOptionValue(*argv, *(argv + 1),
+                               "`<bytes>[:<ways>[:<line bytes>]]`, in whole "
+                               "sets of a power of two lines");
+            }
+            argCount = 2;
+        }
+#endif
+#ifdef DEMAND_LOADING
+        else if (!strcmp(*argv, "-ra")) {
+            ASSERT(argc > 1);
+            if (!ParseCount(*(argv + 1), &readAheadPages)) {
+                BadOptionValue(*argv, *(argv + 1), "a number of pages");
+            }
+            argCount = 2;
+        }
+#endif
+#ifdef VMEM
+        else if (!strcmp(*argv, "-zf")) {
+            idleZeroing = true;
+        }
+#endif
+#ifdef SWAP
+        else if (!strcmp(*argv, "-vp")) {
+            ASSERT(argc > 1);
+            if (!ParseFramePolicy(*(argv + 1), &framePolicy)) {
+                BadOptionValue(*argv, *(argv + 1),
+                               "`eclock`, `clock`, `fifo`, `aging` or "
+                               "`random`");
+            }
+            argCount = 2;
         }
 #endif
+#endif
 #ifdef FILESYS_NEEDED
         if (!strcmp(*argv, "-f")) {
             format = true;
         }
 #endif
+#ifdef FILESYS
+        if (!strcmp(*argv, "-dc")) {
+            ASSERT(argc > 1);
+            diskCacheSize = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-pc")) {
+            ASSERT(argc > 1);
+            pageCacheSize = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-dp")) {
+            ASSERT(argc > 1);
+            if (!ParseDiskPolicy(*(argv + 1), &diskPolicy)) {
+                BadOptionValue(*argv, *(argv + 1),
+                               "`fifo`, `sstf`, `scan` or `clook`");
+            }
+            argCount = 2;
+        } else if (!strcmp(*argv, "-dk")) {
+            ASSERT(argc > 1);
+            unsigned tracks = atoi(*(argv + 1));
+            ASSERT(tracks > 0);
+            diskSectors = tracks * SECTORS_PER_TRACK;
+            argCount = 2;
+        } else if (!strcmp(*argv, "-dm")) {
+            diskMapped = true;
+        } else if (!strcmp(*argv, "-dr")) {
+            ramDisk = true;
+        } else if (!strcmp(*argv, "-dt")) {
+            ASSERT(argc > 1);
+            if (!ParseDiskTiming(*(argv + 1), &diskTiming)) {
+                BadOptionValue(*argv, *(argv + 1),
+                               "`accurate`, `fixed` or `immediate`");
+            }
+            timingGiven = true;
+            argCount = 2;
+        } else if (!strcmp(*argv, "-db")) {
+            ASSERT(argc > 1);
+            diskBatch = atoi(*(argv + 1));
+            ASSERT(diskBatch > 0 && diskBatch <= SynchDisk::MAX_BATCH);
+            argCount = 2;
+        }
+#endif
 #ifdef NETWORK
         if (!strcmp(*argv, "-n")) {
             ASSERT(argc > 1);
@@ -198,6 +470,11 @@ Initialize(int argc, char **argv)
             ASSERT(argc > 1);
             netname = atoi(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-nq")) {
+            ASSERT(argc > 1);
+            netQueue = atoi(*(argv + 1));
+            ASSERT(netQueue > 0);
+            argCount = 2;
         }
 #endif
     }
@@ -205,14 +482,26 @@ Initialize(int argc, char **argv)
     debug.SetFlags(debugFlags);  // Initialize `DEBUG` messages.
     debug.SetOpts(debugOpts);    // Set debugging behavior.
     stats = new Statistics;      // Collect statistics.
+    stats->numCPUs = numCPUs;
+    if (traceFile != nullptr) {
+        tracer = new Tracer;     // Trace kernel events.
+    }
+    if (statsFile != nullptr) {  // Export statistics.
+        statsExporter = new StatsExporter(statsInterval);
+    }
+    if (inputLogFile != nullptr) {  // Record or replay inputs.
+        inputLog = new InputLog(inputLogFile, replayInputs);
+    }
     interrupt = new Interrupt;   // Start up interrupt handling.
-    scheduler = new Scheduler;   // Initialize the ready queue.
+    scheduler = new Scheduler(numCPUs);  // Initialize the ready queues.
     // if (randomYield) {           // Start the timer (if needed).
     //     timer = new Timer(TimerInterruptHandler, 0, randomYield);
     // }
     // Always start timer to force time-slicing and context switches
     // If randomYield is true, they are random. Otherwise every TIMER_TICKS
     timer = new Timer(TimerInterruptHandler, 0, randomYield);
+    alarmClock = new Alarm;
+    workQueue = new WorkQueue("kernel worker");
 
     threadToBeDestroyed = nullptr;
 
@@ -233,15 +522,55 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     Debugger *d = debugUserProg ? new Debugger : nullptr;
-    machine = new Machine(d);  // This must come first.
+    machine = new Machine(d, tlbSize, tlbWays, tlbPolicy, numCPUs);
+      // This must come first.
     SetExceptionHandlers();
-    gSynchConsole = new SynchConsole("gSynchConsole");
-    memoryBitmap = new Bitmap(NUM_PHYS_PAGES);
+    scheduler->SetGangScheduling(gangScheduling);
+    if (consoleScriptFile != nullptr) {  // Before any console is made.
+        consoleScript = new ConsoleScript(consoleScriptFile);
+    }
+    gSynchConsole = new SynchConsole("gSynchConsole", cookedConsole,
+                                     batchedConsole);
+    memoryBitmap = new Bitmap(numPhysPages);
     processTable = new Table<Thread*>();
+    // No process gets 0, which `Fork` returns to the child; a null entry is
+    // joined by nobody.
+    processTable->AddAt(0, nullptr);
+    imageCache = new ImageCache;
+    if (profileFile != nullptr) {
+        profiler = new Profiler;
+    }
+#ifdef USE_TLB
+    asidBitmap = new Bitmap(NUM_ASIDS);
+#endif
+#endif
+
+#ifdef VMEM
+    coreMap = new CoreMap(numPhysPages, memoryBitmap, framePolicy);
+    stats->framePolicy = FramePolicyToString(framePolicy);
+    if (idleZeroing) {
+        coreMap->StartZeroing();
+    }
+    memoryScheduler = new MemoryScheduler(numPhysPages);
+    textTable = new TextTable;
+    sharedFileTable = new SharedFileTable;
+    segmentTable = new SegmentTable;
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    if (ramDisk) {
+        // A RAM disk starts blank, and has no head to move.
+        format = true;
+        if (!timingGiven) {
+            diskTiming = DISK_IMMEDIATE;
+        }
+    }
+    synchDisk = new SynchDisk(ramDisk ? nullptr : "DISK", diskCacheSize,
+                              diskPolicy, diskMapped, diskTiming, diskBatch);
+    inodeTable = new InodeTable;
+    pageCache = new PageCache(pageCacheSize);
+    journal = new Journal;
+    dirtyMap = new DirtyMap;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -249,7 +578,7 @@ Initialize(int argc, char **argv)
 #endif
 
 #ifdef NETWORK
-    postOffice = new PostOffice(netname, rely, 10);
+    postOffice = new PostOffice(netname, rely, 10, netQueue);
 #endif
 }
 
@@ -259,6 +588,24 @@ Cleanup()
 {
     DEBUG('i', "Cleaning up...\n");
 
+#ifdef FILESYS
+    // Commit the journal and write back the disk cache while threads can
+    // still wait for the disk.
+    journal->Commit();
+    synchDisk->Flush();
+#endif
+
+    // From here on, nothing is to run but this thread: what is deleted may
+    // still use locks, and those must not let a timer interrupt switch to
+    // another thread.
+    interrupt->SetLevel(INT_OFF);
+
+    if (statsExporter != nullptr && !statsExporter->Dump(statsFile)) {
+        fprintf(stderr, "Could not write the statistics to %s.\n",
+                statsFile);
+    }
+    delete statsExporter;
+
     // 2007, Jose Miguel Santos Espino
     delete preemptiveScheduler;
 
@@ -269,8 +616,26 @@ Cleanup()
 #ifdef USER_PROGRAM
     delete machine;
     delete gSynchConsole;
+    delete consoleScript;  // After the consoles it types at.
     delete memoryBitmap;
     delete processTable;
+    if (profiler != nullptr && !profiler->Dump(profileFile)) {
+        fprintf(stderr, "Could not write the profile to %s.\n",
+                profileFile);
+    }
+    delete profiler;  // Before the images its profiles hold.
+    delete imageCache;
+#ifdef USE_TLB
+    delete asidBitmap;
+#endif
+#endif
+
+#ifdef VMEM
+    delete coreMap;
+    delete memoryScheduler;
+    delete textTable;
+    delete sharedFileTable;
+    delete segmentTable;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -278,10 +643,23 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete dirtyMap;
+    delete journal;
+    delete pageCache;
+    delete inodeTable;
     delete synchDisk;
 #endif
 
+    if (tracer != nullptr && !tracer->Dump(traceFile)) {
+        fprintf(stderr, "Could not write the trace to %s.\n", traceFile);
+    }
+    delete tracer;
+    delete inputLog;
+    delete lockStats;
+
     delete timer;
+    delete workQueue;
+    delete alarmClock;
     delete scheduler;
     delete interrupt;
 
@@ -10,7 +10,14 @@
 
 
 #include "thread.hh"
+#include "alarm.hh"
+#include "preemptive.hh"
 #include "scheduler.hh"
+#include "input_log.hh"
+#include "lock_stats.hh"
+#include "stats_export.hh"
+#include "tracer.hh"
+#include "work_queue.hh"
 #include "lib/utility.hh"
 #include "machine/interrupt.hh"
 #include "machine/statistics.hh"
@@ -32,16 +39,52 @@ extern Scheduler *scheduler;         ///< The ready list.
 extern Interrupt *interrupt;         ///< Interrupt status.
 extern Statistics *stats;            ///< Performance metrics.
 extern Timer *timer;                 ///< The hardware alarm clock.
+extern Alarm *alarmClock;            ///< Sleeping threads.
+extern WorkQueue *workQueue;         ///< Deferred kernel work.
+extern PreemptiveScheduler *preemptiveScheduler;  ///< Host time slicing.
+extern Tracer *tracer;               ///< Kernel events, if tracing.
+extern StatsExporter *statsExporter;  ///< Statistics as JSON, if exporting.
+extern InputLog *inputLog;           ///< Inputs recorded or replayed, if any.
+extern LockStats *lockStats;         ///< Contention on locks, if counting.
 
 #ifdef USER_PROGRAM
 #include "machine/machine.hh"
 #include "machine/synch_console.hh"
 #include "lib/bitmap.hh"
+#include "userprog/console_script.hh"
+#include "userprog/image_cache.hh"
+#include "userprog/profiler.hh"
+#include "userprog/resource_limits.hh"
 
 extern Machine *machine;  // User program memory and registers.
 extern SynchConsole *gSynchConsole; // Global SynchConsole
 extern Bitmap *memoryBitmap; // memoryBitmap for used physical pages
-extern Table<Thread*> *processTable; // process table, NOTE: maybe use a custom class?
+extern Table<Thread*> *processTable; // process table, grows on demand
+extern ImageCache *imageCache;  // Executables loaded recently.
+extern Profiler *profiler;  // Samples of user programs, if profiling.
+extern unsigned userStackSize;  // Bytes of stack for each user program.
+extern ResourceLimits defaultLimits;  // Limits of the first program.
+extern ConsoleScript *consoleScript;  // Typed at the console, if any.
+#ifdef USE_TLB
+extern Bitmap *asidBitmap;  // Address space identifiers in use.
+#endif
+#endif
+
+#ifdef DEMAND_LOADING
+extern unsigned readAheadPages;  // Most pages to load ahead on a fault.
+#endif
+
+#ifdef VMEM
+#include "vmem/core_map.hh"
+#include "vmem/memory_scheduler.hh"
+#include "vmem/shared_file.hh"
+#include "vmem/shared_memory.hh"
+#include "vmem/shared_text.hh"
+extern CoreMap *coreMap;  // Owners of the physical frames.
+extern MemoryScheduler *memoryScheduler;  // Admits programs that fit.
+extern TextTable *textTable;  // Code pages shared between processes.
+extern SharedFileTable *sharedFileTable;  // Pages of files mapped read-only.
+extern SegmentTable *segmentTable;  // Memory shared between processes.
 #endif
 
 #ifdef FILESYS_NEEDED  // *FILESYS* or *FILESYS_STUB*.
@@ -50,8 +93,16 @@ extern FileSystem *fileSystem;
 #endif
 
 #ifdef FILESYS
+#include "filesys/dirty_map.hh"
+#include "filesys/inode_table.hh"
+#include "filesys/journal.hh"
+#include "filesys/page_cache.hh"
 #include "filesys/synch_disk.hh"
 extern SynchDisk *synchDisk;
+extern InodeTable *inodeTable;
+extern PageCache *pageCache;
+extern Journal *journal;  // Opened by the file system.
+extern DirtyMap *dirtyMap;  // Likewise.
 #endif
 
 #ifdef NETWORK
@@ -19,15 +19,31 @@
 #include "thread.hh"
 #include "switch.h"
 #include "system.hh"
-#include "channel.hh"
+#include "lib/slab.hh"
+
+#ifdef USER_PROGRAM
+#include "userprog/file_description.hh"
+#include "userprog/pipe.hh"
+#endif
 
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 /// This is put at the top of the execution stack, for detecting stack
 /// overflows.
 const unsigned STACK_FENCEPOST = 0xDEADBEEF;
 
+/// Most stacks kept for reuse.  Programs that keep forking short lived
+/// threads then recycle the same few, instead of allocating and faulting in
+/// new host memory every time.  Thread control blocks come from a slab.
+static const unsigned POOL_SIZE = 16;
+
+static uintptr_t *freeStacks[POOL_SIZE];
+static unsigned numFreeStacks = 0;
+
+static Slab threadSlab("Thread", sizeof (Thread), 8);
+
 static inline bool
 IsThreadStatus(ThreadStatus s)
 {
@@ -47,12 +63,30 @@ Thread::Thread(const char *threadName, bool isJoinable, unsigned initialPriority
     stack = nullptr;
     status = JUST_CREATED;
     joinable = isJoinable;
-    if (joinable) joinChannel = new Channel("joinChannel");
+    finished = false;
+    exitValue = 0;
+    parent = joinable ? currentThread : nullptr;
+    if (parent != nullptr) {
+        parent->children.Append(this);
+    }
     priority = initialPriority;
-    prevPriority = initialPriority;
+    basePriority = initialPriority;
+    heldLocks = nullptr;
+    waitingOn = nullptr;
+    semaphoreUnits = 0;
+    bonus = 0;
+    queue = 0;
+    cpu = Scheduler::NO_CPU;
+    readySince = agedSince = runSince = cpuTicks = 0;
+    memset(&usage, 0, sizeof usage);
 #ifdef USER_PROGRAM
     space = nullptr;
-    openFiles = new Table<OpenFile*>();
+    userStack = -1;
+    openFiles = new Table<FileDescription *>();
+    pipeEnds = new Table<PipeEnd*>();
+    consoleInput  = nullptr;
+    consoleOutput = nullptr;
+    ioRing = nullptr;
 #endif
 }
 
@@ -69,18 +103,56 @@ Thread::~Thread()
     DEBUG('t', "Deleting thread \"%s\"\n", name);
 
     ASSERT(this != currentThread);
+    ASSERT(joinWaiters.IsEmpty());
+    LeaveParent();  // If never started.
+    OrphanChildren();
     if (stack != nullptr)
     {
-        SystemDep::DeallocBoundedArray((char *)stack,
-                                       STACK_SIZE * sizeof *stack);
+        if (numFreeStacks < POOL_SIZE) {
+            freeStacks[numFreeStacks++] = stack;
+        } else {
+            SystemDep::DeallocBoundedArray((char *)stack,
+                                           STACK_SIZE * sizeof *stack);
+        }
     }
 
 #ifdef USER_PROGRAM
-    if (space) delete space;
+    CloseAllOpenFiles(this);  // Unless done at exit already.
+    if (space) {
+        // Other threads may still run in it.
+        if (userStack != -1) space->FreeStack(userStack);
+        if (space->Detach()) delete space;
+    }
     delete openFiles;
+    CloseAllPipeEnds(this);  // Unless done at exit already.
+    delete pipeEnds;
+    for (unsigned c = 0; c < Statistics::MAX_CPUS; c++) {
+        if (userStateOwner[c] == this) {
+            userStateOwner[c] = nullptr;
+        }
+    }
+#ifdef NETWORK
+    postOffice->UnbindAll(this);
+#endif
 #endif
 }
 
+void *
+Thread::operator new(size_t size)
+{
+    ASSERT(size == sizeof (Thread));
+
+    return threadSlab.Allocate();
+}
+
+void
+Thread::operator delete(void *p)
+{
+    if (p != nullptr) {
+        threadSlab.Free(p);
+    }
+}
+
 /// Invoke `(*func)(arg)`, allowing caller and callee to execute
 /// concurrently.
 ///
@@ -112,19 +184,116 @@ void Thread::Fork(VoidFunctionPtr func, void *arg)
     interrupt->SetLevel(oldLevel);
 }
 
-int Thread::Join()
+/// Wake every thread in `queue`.  Interrupts must be off.
+static void
+WakeAll(ThreadQueue *queue)
+{
+    Thread *t;
+    while ((t = queue->Pop()) != nullptr) {
+        scheduler->ReadyToRun(t);
+    }
+}
+
+/// Wait in `queue` until woken, or until `deadline`, unless it is
+/// `Thread::FOREVER`.  Return false once the deadline is past.
+static bool
+WaitIn(ThreadQueue *queue, unsigned long deadline)
+{
+    if (deadline == Thread::FOREVER) {
+        queue->Append(currentThread);
+        currentThread->Sleep();
+        return true;
+    }
+    if (stats->totalTicks >= deadline) {
+        return false;
+    }
+    return alarmClock->WaitOn(queue, deadline - stats->totalTicks);
+}
+
+/// Return the tick `ticks` ticks from now, or `Thread::FOREVER`.
+static unsigned long
+Deadline(unsigned long ticks)
+{
+    if (ticks >= Thread::FOREVER - stats->totalTicks) {
+        return Thread::FOREVER;
+    }
+    return stats->totalTicks + ticks;
+}
+
+int
+Thread::Join()
+{
+    int value;
+    Join(FOREVER, &value);
+    return value;
+}
+
+bool
+Thread::Join(unsigned long ticks, int *value)
 {
     ASSERT(this != currentThread);
     ASSERT(joinable);
+    ASSERT(value != nullptr);
 
-    int exitValue;
-    joinChannel->Receive(&exitValue);
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    unsigned long deadline = Deadline(ticks);
+    while (!finished) {
+        if (!WaitIn(&joinWaiters, deadline)) {
+            interrupt->SetLevel(oldLevel);
+            return false;
+        }
+    }
+    LeaveParent();
+    *value = exitValue;
+    threadToBeDestroyed = this;
+    interrupt->SetLevel(oldLevel);
+    return true;
+}
 
-    delete joinChannel;
+Thread *
+Thread::WaitForChild(unsigned long ticks)
+{
+    ASSERT(this == currentThread);
 
-    threadToBeDestroyed = this;
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    unsigned long deadline = Deadline(ticks);
+    while (finishedChildren.IsEmpty() && !children.IsEmpty()) {
+        if (!WaitIn(&childWaiters, deadline)) {
+            break;
+        }
+    }
+    Thread *child = finishedChildren.Pop();
+    if (child != nullptr) {
+        child->parent = nullptr;
+    }
+    interrupt->SetLevel(oldLevel);
+    return child;
+}
 
-    return exitValue;
+void
+Thread::LeaveParent()
+{
+    if (parent == nullptr) {
+        return;
+    }
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    parent->children.Remove(this);
+    parent->finishedChildren.Remove(this);
+    WakeAll(&parent->childWaiters);
+    parent = nullptr;
+    interrupt->SetLevel(oldLevel);
+}
+
+void
+Thread::OrphanChildren()
+{
+    Thread *child;
+    while ((child = children.Pop()) != nullptr) {
+        child->parent = nullptr;
+    }
+    while ((child = finishedChildren.Pop()) != nullptr) {
+        child->parent = nullptr;
+    }
 }
 
 /// Check a thread's stack to see if it has overrun the space that has been
@@ -153,6 +322,12 @@ void Thread::SetStatus(ThreadStatus st)
     status = st;
 }
 
+ThreadStatus
+Thread::GetStatus() const
+{
+    return status;
+}
+
 const char *
 Thread::GetName() const
 {
@@ -164,6 +339,20 @@ void Thread::Print() const
     printf("%s, ", name);
 }
 
+void Thread::PrintUsage() const
+{
+    printf("%s: user %lu, system %lu ticks, %lu switches, "
+           "%lu page faults, %lu TLB misses, "
+           "%lu sectors read, %lu written\n",
+           name, usage.userTicks, usage.systemTicks, usage.switches,
+           usage.pageFaults, usage.tlbMisses,
+           usage.sectorsRead, usage.sectorsWritten);
+#ifdef CACHE_MODEL
+    printf("%s: cache accesses %lu, misses %lu\n",
+           name, usage.cacheAccesses, usage.cacheMisses);
+#endif
+}
+
 /// Called by `ThreadRoot` when a thread is done executing the forked
 /// procedure.
 ///
@@ -181,9 +370,30 @@ void Thread::Finish(int returnValue)
     ASSERT(this == currentThread);
 
     DEBUG('t', "Finishing thread \"%s\"\n", GetName());
+    if (debug.IsEnabled('u')) {
+        PrintUsage();
+    }
+    if (statsExporter != nullptr) {
+        statsExporter->RecordThread(this);
+    }
 
-    if (joinable) joinChannel->Send(returnValue);
-    else threadToBeDestroyed = currentThread;
+    // The thread waits, finished, to be joined, and is reported to its
+    // parent unless somebody is joining it already.
+    if (joinable) {
+        finished  = true;
+        exitValue = returnValue;
+        if (parent != nullptr) {
+            parent->children.Remove(this);
+            if (joinWaiters.IsEmpty()) {
+                parent->finishedChildren.Append(this);
+                WakeAll(&parent->childWaiters);
+            }
+        }
+        WakeAll(&joinWaiters);
+    } else {
+        threadToBeDestroyed = currentThread;
+    }
+    OrphanChildren();
 
     Sleep(); // Invokes `SWITCH`.
     // Not reached.
@@ -212,9 +422,16 @@ void Thread::Yield()
 
     DEBUG('t', "Yielding thread \"%s\"\n", GetName());
 
-    Thread *nextThread = scheduler->FindNextToRun();
-    if (nextThread != nullptr)
-    {
+    // If the timer asked so, this thread stays on its CPU while the next
+    // CPU with something to run gets simulated for a while.  Once back, it
+    // only gives up its CPU if its slice is over.
+    Thread *nextThread;
+    bool switchCPU = scheduler->TakeCPUSwitch();
+    if (switchCPU && (nextThread = scheduler->FindNextCPU()) != nullptr) {
+        scheduler->Run(nextThread);
+    }
+    if ((!switchCPU || scheduler->IsSliceOver())
+          && (nextThread = scheduler->FindNextToRun()) != nullptr) {
         scheduler->ReadyToRun(this);
         scheduler->Run(nextThread);
     }
@@ -243,10 +460,19 @@ void Thread::Sleep()
 
     DEBUG('t', "Sleeping thread \"%s\"\n", GetName());
 
+    // If this CPU has nothing else to run, it is left idle, and the
+    // simulation moves on to another CPU.  With idle zeroing, the time is
+    // first given to clearing free frames.
     Thread *nextThread;
     status = BLOCKED;
-    while ((nextThread = scheduler->FindNextToRun()) == nullptr)
+    while ((nextThread = scheduler->FindNextToRun()) == nullptr
+             && (nextThread = scheduler->FindNextCPU()) == nullptr)
     {
+#ifdef VMEM
+        if (coreMap != nullptr && coreMap->WakeZeroer()) {
+            continue;
+        }
+#endif
         interrupt->Idle(); // No one to run, wait for an interrupt.
     }
 
@@ -272,6 +498,9 @@ InterruptEnable()
 
 /// Allocate and initialize an execution stack.
 ///
+/// A stack left by a destroyed thread is reused if there is one; only the
+/// fencepost and the initial frame need to be set up again.
+///
 /// The stack is initialized with an initial stack frame for `ThreadRoot`,
 /// which:
 /// 1. enables interrupts;
@@ -284,8 +513,12 @@ void Thread::StackAllocate(VoidFunctionPtr func, void *arg)
 {
     ASSERT(func != nullptr);
 
-    stack = (uintptr_t *)
-        SystemDep::AllocBoundedArray(STACK_SIZE * sizeof *stack);
+    if (numFreeStacks > 0) {
+        stack = freeStacks[--numFreeStacks];
+    } else {
+        stack = (uintptr_t *)
+            SystemDep::AllocBoundedArray(STACK_SIZE * sizeof *stack);
+    }
 
     // Stacks in x86 work from high addresses to low addresses.
     stackTop = stack + STACK_SIZE - 4; // -4 to be on the safe side!
@@ -305,19 +538,28 @@ void Thread::StackAllocate(VoidFunctionPtr func, void *arg)
 }
 
 unsigned
-Thread::GetPriority() {
+Thread::GetPriority() const {
     return priority;
 }
 
+unsigned
+Thread::GetBasePriority() const {
+    return basePriority;
+}
+
 void
 Thread::SetPriority(unsigned priority_) {
-    prevPriority = priority;
     priority = priority_;
 }
 
+/// A priority lent by the waiters of a lock held is kept until the lock is
+/// released, which takes the thread back to the new one.
 void
-Thread::RestorePriority() {
-    priority = prevPriority;
+Thread::SetBasePriority(unsigned priority_) {
+    basePriority = priority_;
+    if (heldLocks == nullptr || priority_ > priority) {
+        priority = priority_;
+    }
 }
 
 #ifdef USER_PROGRAM
@@ -349,4 +591,40 @@ void Thread::RestoreUserState()
     }
 }
 
+Thread *Thread::userStateOwner[Statistics::MAX_CPUS];
+
+/// A thread given an address space while running did not load its state,
+/// but the registers are its own all the same.
+void Thread::LeaveUserState()
+{
+    unsigned c = machine->GetCPU();
+    ASSERT(userStateOwner[c] == nullptr || userStateOwner[c] == this);
+
+    userStateOwner[c] = this;
+}
+
+/// A thread that moved from another CPU may have left its latest state in
+/// the registers there.
+bool Thread::LoadUserState()
+{
+    unsigned c = machine->GetCPU();
+    if (userStateOwner[c] == this) {
+        return false;
+    }
+    if (userStateOwner[c] != nullptr) {
+        userStateOwner[c]->SaveUserState();
+    }
+    for (unsigned other = 0; other < machine->GetNumCPUs(); other++) {
+        if (userStateOwner[other] == this) {
+            machine->SelectCPU(other);
+            SaveUserState();
+            machine->SelectCPU(c);
+            userStateOwner[other] = nullptr;
+        }
+    }
+    RestoreUserState();
+    userStateOwner[c] = this;
+    return true;
+}
+
 #endif
@@ -39,6 +39,8 @@
 #define NACHOS_THREADS_THREAD__HH
 
 #include "lib/utility.hh"
+#include "lib/intrusive_list.hh"
+#include "lib/list.hh"
 
 #ifdef USER_PROGRAM
 #include "machine/machine.hh"
@@ -46,11 +48,15 @@
 #include "lib/table.hh"
 #endif
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define PRIORITY_DEFAULT 0
 
-class Channel;
+class AsyncRing;
+class FileDescription;
+class Lock;
+class PipeEnd;
 
 /// CPU register state to be saved on context switch.
 ///
@@ -75,6 +81,21 @@ enum ThreadStatus
     NUM_THREAD_STATUS
 };
 
+/// Resources used by a thread, counted where they are used, so that it can
+/// be told which threads, and so which programs, use what.
+class ThreadUsage {
+public:
+    unsigned long userTicks;
+    unsigned long systemTicks;
+    unsigned long pageFaults;
+    unsigned long tlbMisses;
+    unsigned long sectorsRead;     ///< Asked of the disk, cached or not.
+    unsigned long sectorsWritten;
+    unsigned long switches;        ///< Times the thread was switched to.
+    unsigned long cacheAccesses;   ///< First level lookups, and misses,
+    unsigned long cacheMisses;     ///< with `-DCACHE_MODEL`.
+};
+
 /// The following class defines a “thread control block” -- which represents
 /// a single thread of execution.
 ///
@@ -108,13 +129,39 @@ public:
     /// called.
     ~Thread();
 
+    /// Thread control blocks come from a slab of their own (see
+    /// `lib/slab.hh`), like stacks are kept for reuse once deleted,
+    /// instead of going back to the host allocator.
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     /// Basic thread operations.
 
     /// Make thread run `(*func)(arg)`.
     void Fork(VoidFunctionPtr func, void *arg);
 
+    /// Ticks to wait for, in `Join` and `WaitForChild`, never to give up.
+    static const unsigned long FOREVER = (unsigned long) -1;
+
+    /// Wait until the thread, which must be joinable, finishes, and return
+    /// the value it finished with.  The thread is then deleted.
     int Join();
 
+    /// Like `Join`, but wait `ticks` ticks at most, and leave the value at
+    /// `exitValue`.  Return false if the thread did not finish by then; it
+    /// can still be joined later.
+    bool Join(unsigned long ticks, int *exitValue);
+
+    /// Return a child of the current thread that has finished and not been
+    /// joined yet, the first to finish, waiting `ticks` ticks at most for
+    /// one.  Its children are the joinable threads it created.  Return null
+    /// if the time ran out, or if it has no children left; those being
+    /// joined by some other thread are not waited for.
+    ///
+    /// The child still has to be joined, which returns at once, before
+    /// another thread may: called with interrupts off, it cannot.
+    Thread *WaitForChild(unsigned long ticks);
+
     /// Relinquish the CPU if any other thread is runnable.
     void Yield();
 
@@ -129,13 +176,46 @@ public:
 
     void SetStatus(ThreadStatus st);
 
+    ThreadStatus GetStatus() const;
+
     const char *GetName() const;
 
     void Print() const;
 
-    unsigned GetPriority();
+    /// Print the resources the thread used so far.
+    void PrintUsage() const;
+
+    /// Return the priority the thread runs at, which may be raised above
+    /// its own by threads waiting for its locks.
+    unsigned GetPriority() const;
+
+    /// Return the priority the thread was created with.
+    unsigned GetBasePriority() const;
+
+    /// Set the priority the thread runs at; for `Lock` to lend and take
+    /// back priorities.
     void SetPriority(unsigned priority);
-    void RestorePriority();
+
+    /// Set the priority the thread runs at when it is lent none; for a
+    /// `WorkQueue` worker to take on the priority of its work.
+    void SetBasePriority(unsigned priority);
+
+    /// Locks held, linked through `Lock::nextHeld`, and the lock the thread
+    /// is waiting for, if any.  Kept by `Lock`.
+    Lock *heldLocks;
+    Lock *waitingOn;
+
+    /// Units the thread waits for in `Semaphore::P`, until `Semaphore::V`
+    /// hands them over.  Kept by `Semaphore`.
+    unsigned semaphoreUnits;
+
+    /// Link in the queue the thread waits in: a ready queue, or that of a
+    /// semaphore, lock or condition variable.  A thread is never in more
+    /// than one of them at a time.
+    ListLink<Thread> queueLink;
+
+    /// Resources used so far.
+    ThreadUsage usage;
 
 private:
     // Some of the private data for this class is listed above.
@@ -154,10 +234,48 @@ private:
     void StackAllocate(VoidFunctionPtr func, void *arg);
 
     bool joinable;
-    Channel* joinChannel;
+
+    /// Whether the thread has finished, and what with; kept until it is
+    /// joined.
+    bool finished;
+    int exitValue;
+
+    /// Threads waiting in `Join` for this one.
+    IntrusiveList<Thread, &Thread::queueLink> joinWaiters;
+
+    /// Thread that created this one, if joinable, until it is joined or
+    /// its parent finishes first.
+    Thread *parent;
+
+    /// Children running, or being joined, and children finished and left
+    /// for `WaitForChild`, in the order they finished; and threads waiting
+    /// for the latter.
+    List<Thread*> children;
+    List<Thread*> finishedChildren;
+    IntrusiveList<Thread, &Thread::queueLink> childWaiters;
+
+    /// Stop being a child of `parent`, and let it check again whether it
+    /// still has children to wait for.
+    void LeaveParent();
+
+    /// Stop being the parent of any thread.
+    void OrphanChildren();
 
     unsigned priority;
-    unsigned prevPriority;
+    unsigned basePriority;
+
+    /// Scheduling state, kept by `Scheduler`: levels above or below
+    /// `priority` the thread runs at, queue it is in while ready, when it
+    /// last became ready, was last promoted and started running, ticks it
+    /// has run for so far, and CPU it runs, or last ran or is ready, on.
+    friend class Scheduler;
+    int bonus;
+    unsigned queue;
+    unsigned cpu;
+    unsigned long readySince;
+    unsigned long agedSince;
+    unsigned long runSince;
+    unsigned long cpuTicks;
 
 #ifdef USER_PROGRAM
     /// User-level CPU register state.
@@ -167,6 +285,14 @@ private:
     /// state while executing kernel code.
     int userRegisters[NUM_TOTAL_REGS];
 
+    /// Thread whose user-level state the registers of each CPU hold, if
+    /// any.
+    ///
+    /// Registers are only saved when some other user program needs them,
+    /// so that switching to kernel threads and straight back costs no
+    /// copying.
+    static Thread *userStateOwner[Statistics::MAX_CPUS];
+
 public:
     // Save user-level register state.
     void SaveUserState();
@@ -174,13 +300,42 @@ public:
     // Restore user-level register state.
     void RestoreUserState();
 
+    /// Leave the user-level state of the thread, which is being switched
+    /// out, in the registers of the selected CPU.
+    void LeaveUserState();
+
+    /// Get the user-level state of the thread, which is being switched in,
+    /// back into the registers of the selected CPU, saving that of their
+    /// owner first, and taking it from another CPU's if it was left there.
+    /// Return false if the registers held it already, in which case no
+    /// other user program ran meanwhile.
+    bool LoadUserState();
+
     // User code this thread is running.
     AddressSpace *space;
 
-    Table<OpenFile*>* openFiles;
+    /// Top of the stack of a thread made by `ThreadFork`, handed back to
+    /// `space` at its end; -1 for the first thread of a program.
+    int userStack;
+
+    /// Open files of this process, by identifier minus 2.
+    Table<FileDescription *> *openFiles;
+
+    /// Pipe ends of this process, and those its console input and output
+    /// go to instead of the console, if any.
+    Table<PipeEnd*> *pipeEnds;
+    PipeEnd *consoleInput;
+    PipeEnd *consoleOutput;
+
+    /// Ring of asynchronous I/O set up by the thread, if any; stopped at
+    /// exit.
+    AsyncRing *ioRing;
 #endif
 };
 
+/// A queue of threads, linked through `Thread::queueLink`.
+typedef IntrusiveList<Thread, &Thread::queueLink> ThreadQueue;
+
 /// Magical machine-dependent routines, defined in `switch.s`.
 
 extern "C"
@@ -11,10 +11,12 @@
 /// limitation of liability and disclaimer of warranty provisions.
 
 
+#include "thread_test_bench.hh"
 #include "thread_test_garden.hh"
 #include "thread_test_prod_cons.hh"
 #include "thread_test_simple.hh"
 #include "thread_test_garden_sem.hh"
+#include "thread_test_preempt.hh"
 #include "lib/utility.hh"
 
 #include <stdio.h>
@@ -32,7 +34,9 @@ static const Test TESTS[] = {
     { &ThreadTestSimple,   "simple",   "Simple thread interleaving" },
     { &ThreadTestGarden,   "garden",   "Ornamental garden" },
     { &ThreadTestGardenSem, "garden_sem", "Ornamental garden with Semaphore" },
-    { &ThreadTestProdCons, "prodcons", "Producer/Consumer" }
+    { &ThreadTestProdCons, "prodcons", "Producer/Consumer" },
+    { &ThreadTestBench,    "bench",    "Synchronization benchmarks" },
+    { &ThreadTestPreempt,  "preempt",  "Threads that never yield (-p)" }
 };
 static const unsigned NUM_TESTS = sizeof TESTS / sizeof TESTS[0];
 
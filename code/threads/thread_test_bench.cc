@@ -0,0 +1,179 @@
+/// Benchmarks of the synchronization primitives.
+///
+/// Every workload has a number of threads go through the same primitive
+/// over and over, holding it for `csLength` yields each time, so that the
+/// others contend for it.  Workloads run with every thread at the same
+/// priority, and with priorities spread over the whole range, which brings
+/// priority inheritance into play.  For each, the ticks and context
+/// switches per operation are reported, to compare between versions of the
+/// primitives.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "thread_test_bench.hh"
+#include "channel.hh"
+#include "system.hh"
+
+#include <stdio.h>
+
+
+/// Operations each thread carries out in every workload.
+static const unsigned OPS_PER_THREAD = 50;
+
+/// Parameters tried.
+static const unsigned THREAD_COUNTS[] = { 2, 4, 8 };
+static const unsigned CS_LENGTHS[] = { 0, 2 };
+static const unsigned MAX_THREADS = 8;
+
+static const char *THREAD_NAMES[MAX_THREADS] = {
+    "bench 0", "bench 1", "bench 2", "bench 3",
+    "bench 4", "bench 5", "bench 6", "bench 7"
+};
+
+/// State shared by the threads of the workload running.
+static unsigned numThreads;
+static unsigned csLength;
+static Lock *lock;
+static Semaphore *semaphore;
+static Condition *condition;
+static Channel<int> *channel;
+static unsigned turn;
+
+static void
+CriticalSection()
+{
+    for (unsigned i = 0; i < csLength; i++) {
+        currentThread->Yield();
+    }
+}
+
+static void
+LockWorker(void *)
+{
+    for (unsigned i = 0; i < OPS_PER_THREAD; i++) {
+        lock->Acquire();
+        CriticalSection();
+        lock->Release();
+        currentThread->Yield();
+    }
+}
+
+static void
+SemaphoreWorker(void *)
+{
+    for (unsigned i = 0; i < OPS_PER_THREAD; i++) {
+        semaphore->P();
+        CriticalSection();
+        semaphore->V();
+        currentThread->Yield();
+    }
+}
+
+/// Threads take turns in order, each waiting on the condition for its own.
+static void
+ConditionWorker(void *n_)
+{
+    unsigned n = (unsigned) (uintptr_t) n_;
+
+    for (unsigned i = 0; i < OPS_PER_THREAD; i++) {
+        lock->Acquire();
+        while (turn != n) {
+            condition->Wait();
+        }
+        CriticalSection();
+        turn = (turn + 1) % numThreads;
+        condition->Broadcast();
+        lock->Release();
+    }
+}
+
+/// Even threads send, odd threads receive.
+static void
+ChannelWorker(void *n_)
+{
+    unsigned n = (unsigned) (uintptr_t) n_;
+
+    for (unsigned i = 0; i < OPS_PER_THREAD; i++) {
+        if (n % 2 == 0) {
+            channel->Send(i);
+        } else {
+            int message;
+            channel->Receive(&message);
+        }
+        CriticalSection();
+    }
+}
+
+typedef struct {
+    const char    *name;
+    VoidFunctionPtr worker;
+} Workload;
+
+static const Workload WORKLOADS[] = {
+    { "lock",      &LockWorker },
+    { "semaphore", &SemaphoreWorker },
+    { "condition", &ConditionWorker },
+    { "channel",   &ChannelWorker }
+};
+
+/// Run `w` with `threads` threads, at the same priority unless `mixed`,
+/// and print what each operation cost.
+static void
+RunWorkload(const Workload *w, unsigned threads, unsigned cs, bool mixed)
+{
+    ASSERT(threads <= MAX_THREADS);
+
+    numThreads = threads;
+    csLength   = cs;
+    turn       = 0;
+    lock       = new Lock("bench lock");
+    semaphore  = new Semaphore("bench semaphore", 1);
+    condition  = new Condition("bench condition", lock);
+    channel    = new Channel<int>("bench channel");
+
+    unsigned long ticks    = stats->totalTicks;
+    unsigned long switches = stats->numContextSwitches;
+
+    Thread *t[MAX_THREADS];
+    for (unsigned i = 0; i < threads; i++) {
+        unsigned priority = mixed ? i * PRIORITY_MAX / (threads - 1)
+                                  : PRIORITY_DEFAULT;
+        t[i] = new Thread(THREAD_NAMES[i], true, priority);
+        t[i]->Fork(w->worker, (void *) (uintptr_t) i);
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        t[i]->Join();
+    }
+
+    ticks    = stats->totalTicks - ticks;
+    switches = stats->numContextSwitches - switches;
+    unsigned ops = threads * OPS_PER_THREAD;
+    printf("%-9s threads %u, cs %u, %-7s: ticks/op %7.2f, switches/op %5.2f\n",
+           w->name, threads, cs, mixed ? "mixed" : "uniform",
+           (double) ticks / ops, (double) switches / ops);
+
+    delete channel;
+    delete condition;
+    delete semaphore;
+    delete lock;
+}
+
+void
+ThreadTestBench()
+{
+    for (unsigned w = 0; w < sizeof WORKLOADS / sizeof *WORKLOADS; w++) {
+        for (unsigned n = 0; n < sizeof THREAD_COUNTS / sizeof *THREAD_COUNTS;
+             n++) {
+            for (unsigned c = 0; c < sizeof CS_LENGTHS / sizeof *CS_LENGTHS;
+                 c++) {
+                RunWorkload(&WORKLOADS[w], THREAD_COUNTS[n], CS_LENGTHS[c],
+                            false);
+                RunWorkload(&WORKLOADS[w], THREAD_COUNTS[n], CS_LENGTHS[c],
+                            true);
+            }
+        }
+    }
+}
@@ -0,0 +1,77 @@
+/// Threads that never yield, to check the preemptive scheduler (`-p`).
+///
+/// Each spinner counts up without calling `Yield`, and notes how often the
+/// count of the other one moved meanwhile: only a preemption lets that
+/// happen.  With `-p`, both must have seen the other run, and some time
+/// slices must have been used up; without it, each runs to the end in turn.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "thread_test_preempt.hh"
+#include "system.hh"
+
+#include <stdio.h>
+
+
+static const unsigned NUM_SPINNERS = 2;
+static const unsigned SPINS = 40000;
+static volatile unsigned spins[NUM_SPINNERS];
+static unsigned switches[NUM_SPINNERS];
+static bool done[NUM_SPINNERS];
+
+static void
+Spinner(void *n_)
+{
+    unsigned *n = (unsigned *) n_;
+    unsigned other = (*n + 1) % NUM_SPINNERS;
+
+    unsigned seen = spins[other];
+    for (unsigned i = 0; i < SPINS; i++) {
+        spins[*n]++;
+        if (spins[other] != seen) {
+            seen = spins[other];
+            switches[*n]++;
+        }
+    }
+    printf("Spinner %u finished, having been preempted %u times.\n",
+           *n, switches[*n]);
+    done[*n] = true;
+    delete n;
+}
+
+void
+ThreadTestPreempt()
+{
+    unsigned long slicesBefore = stats->numSlicesExpired;
+
+    for (unsigned i = 0; i < NUM_SPINNERS; i++) {
+        printf("Launching spinner %u.\n", i);
+        char *name = new char [16];
+        sprintf(name, "Spinner %u", i);
+        unsigned *n = new unsigned;
+        *n = i;
+        Thread *t = new Thread(name, false, PRIORITY_DEFAULT);
+        t->Fork(Spinner, (void *) n);
+    }
+
+    for (unsigned i = 0; i < NUM_SPINNERS; i++) {
+        while (!done[i]) {
+            currentThread->Yield();
+        }
+    }
+
+    unsigned long slices = stats->numSlicesExpired - slicesBefore;
+    printf("All spinners finished; %lu time slices used up.\n", slices);
+    if (preemptiveScheduler == nullptr) {
+        printf("No preemption without -p.\n");
+        return;
+    }
+    for (unsigned i = 0; i < NUM_SPINNERS; i++) {
+        ASSERT(switches[i] > 0);
+    }
+    ASSERT(slices > 0);
+    printf("Spinners were preempted, as expected with -p.\n");
+}
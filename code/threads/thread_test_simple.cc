@@ -19,7 +19,10 @@ Semaphore *sem = new Semaphore("Semaphore", 3);
 
 #ifdef CHANNEL_TEST
 #include "channel.hh"
-Channel *channel = new Channel("test channel");
+// Messages are buffered, so each direction needs a channel of its own: a
+// thread receiving from the channel it just sent to gets its own message.
+Channel<int> *ping = new Channel<int>("ping channel");
+Channel<int> *pong = new Channel<int>("pong channel");
 #endif
 
 /// Loop 10 times, yielding the CPU to another ready thread each iteration.
@@ -55,11 +58,11 @@ void channel_thread_1(void* arg) {
     int number = 10;
 
     DEBUG('c', "thread_1 quiere enviar %d\n", number);
-    channel->Send(number);
+    ping->Send(number);
     DEBUG('c', "thread_1 consiguio enviar el dato\n");
 
     DEBUG('c', "thread_1 quiere recibir un dato\n");
-    channel->Receive(&number);
+    pong->Receive(&number);
     DEBUG('c', "thread_1 consiguio recibir el dato: %d\n", number);
 
 }
@@ -68,12 +71,12 @@ void channel_thread_2(void* arg) {
     int number;
 
     DEBUG('c', "thread_2 quiere recibir un dato\n");
-    channel->Receive(&number);
+    ping->Receive(&number);
     DEBUG('c', "thread_2 consiguio recibir el dato: %d\n", number);
 
     number = 5;
     DEBUG('c', "thread_2 quiere enviar %d\n", number);
-    channel->Send(number);
+    pong->Send(number);
     DEBUG('c', "thread_2 consiguio enviar el dato\n");
 }
 #endif
@@ -0,0 +1,194 @@
+/// Routines to trace kernel events.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "tracer.hh"
+#include "system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/// Tracks the events are shown in, by kind.
+static const char *TRACK_NAMES[] = {
+    "threads", "interrupts", "system calls", "page faults", "disk"
+};
+
+Tracer::Tracer(unsigned capacity_)
+{
+    ASSERT(capacity_ > 0);
+
+    events   = new TraceEvent [capacity_];
+    capacity = capacity_;
+    recorded = 0;
+}
+
+Tracer::~Tracer()
+{
+    delete [] events;
+}
+
+TraceEvent *
+Tracer::Add(TraceKind kind, unsigned long when, const char *label, int arg)
+{
+    TraceEvent *e = &events[recorded % capacity];
+    recorded++;
+
+    e->when     = when;
+    e->duration = 0;
+    e->kind     = kind;
+    e->label    = label;
+    e->arg      = arg;
+    if (currentThread != nullptr) {
+        strncpy(e->thread, currentThread->GetName(), TraceEvent::NAME_SIZE);
+        e->thread[TraceEvent::NAME_SIZE - 1] = '\0';
+    } else {
+        e->thread[0] = '\0';
+    }
+    return e;
+}
+
+void
+Tracer::RecordSwitch(const char *threadName)
+{
+    ASSERT(threadName != nullptr);
+
+    TraceEvent *e = Add(TRACE_SWITCH, stats->totalTicks, nullptr, -1);
+    strncpy(e->thread, threadName, TraceEvent::NAME_SIZE);
+    e->thread[TraceEvent::NAME_SIZE - 1] = '\0';
+}
+
+void
+Tracer::RecordInterrupt(const char *typeName)
+{
+    Add(TRACE_INTERRUPT, stats->totalTicks, typeName, -1);
+}
+
+void
+Tracer::RecordSyscall(const char *name, unsigned long start)
+{
+    TraceEvent *e = Add(TRACE_SYSCALL, start, name, -1);
+    e->duration = stats->totalTicks - start;
+}
+
+void
+Tracer::RecordPageFault(int virtualAddress)
+{
+    Add(TRACE_PAGE_FAULT, stats->totalTicks, "page fault", virtualAddress);
+}
+
+void
+Tracer::RecordDisk(bool writing, int sector, unsigned long start)
+{
+    TraceEvent *e = Add(TRACE_DISK, start, writing ? "write" : "read",
+                        sector);
+    e->duration = stats->totalTicks - start;
+}
+
+void
+PrintJSONString(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; s != nullptr && *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(f, "\\%c", *s);
+        } else if ((unsigned char) *s < ' ') {
+            fprintf(f, "\\u%04x", (unsigned char) *s);
+        } else {
+            fputc(*s, f);
+        }
+    }
+    fputc('"', f);
+}
+
+/// Write the start of an event of `kind` in the track of its kind.
+static void
+PrintEvent(FILE *f, const char *name, char phase, TraceKind kind,
+           unsigned long when)
+{
+    fprintf(f, ",\n{\"name\":");
+    PrintJSONString(f, name);
+    fprintf(f, ",\"ph\":\"%c\",\"pid\":0,\"tid\":%u,\"ts\":%lu",
+            phase, (unsigned) kind, when);
+}
+
+/// A thread runs from one switch to the next; the last one, until Nachos
+/// halts.
+bool
+Tracer::Dump(const char *fileName) const
+{
+    ASSERT(fileName != nullptr);
+
+    FILE *f = fopen(fileName, "w");
+    if (f == nullptr) {
+        return false;
+    }
+
+    unsigned long kept    = recorded < capacity ? recorded : capacity;
+    unsigned long dropped = recorded - kept;
+
+    fprintf(f, "{\"otherData\":{\"dropped\":%lu},\n\"traceEvents\":[\n",
+            dropped);
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+               "\"args\":{\"name\":\"nachos\"}}");
+    for (unsigned k = 0; k < sizeof TRACK_NAMES / sizeof *TRACK_NAMES; k++) {
+        fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                   "\"tid\":%u,\"args\":{\"name\":", k);
+        PrintJSONString(f, TRACK_NAMES[k]);
+        fprintf(f, "}}");
+    }
+
+    const TraceEvent *running = nullptr;
+    for (unsigned long i = dropped; i < recorded; i++) {
+        const TraceEvent *e = &events[i % capacity];
+        switch (e->kind) {
+            case TRACE_SWITCH:
+                if (running != nullptr) {
+                    PrintEvent(f, running->thread, 'X', TRACE_SWITCH,
+                               running->when);
+                    fprintf(f, ",\"dur\":%lu}", e->when - running->when);
+                }
+                running = e;
+                break;
+
+            case TRACE_INTERRUPT:
+                PrintEvent(f, e->label, 'i', e->kind, e->when);
+                fprintf(f, ",\"s\":\"t\",\"args\":{\"thread\":");
+                PrintJSONString(f, e->thread);
+                fprintf(f, "}}");
+                break;
+
+            case TRACE_SYSCALL:
+                PrintEvent(f, e->label, 'X', e->kind, e->when);
+                fprintf(f, ",\"dur\":%lu,\"args\":{\"thread\":", e->duration);
+                PrintJSONString(f, e->thread);
+                fprintf(f, "}}");
+                break;
+
+            case TRACE_PAGE_FAULT:
+                PrintEvent(f, e->label, 'i', e->kind, e->when);
+                fprintf(f, ",\"s\":\"t\",\"args\":{\"thread\":");
+                PrintJSONString(f, e->thread);
+                fprintf(f, ",\"address\":%d}}", e->arg);
+                break;
+
+            case TRACE_DISK:
+                PrintEvent(f, e->label, 'X', e->kind, e->when);
+                fprintf(f, ",\"dur\":%lu,\"args\":{\"thread\":", e->duration);
+                PrintJSONString(f, e->thread);
+                fprintf(f, ",\"sector\":%d}}", e->arg);
+                break;
+        }
+    }
+    if (running != nullptr) {
+        PrintEvent(f, running->thread, 'X', TRACE_SWITCH, running->when);
+        fprintf(f, ",\"dur\":%lu}", stats->totalTicks - running->when);
+    }
+    fprintf(f, "\n]}\n");
+
+    bool ok = ferror(f) == 0;
+    return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,106 @@
+/// Data structures to trace kernel events.
+///
+/// `DEBUG` messages are formatted and printed as they happen, which slows
+/// Nachos down and, under a preemptive scheduler, changes what it does.  The
+/// tracer instead keeps a fixed-size record of every event, stamped with
+/// `stats->totalTicks`, in a ring buffer: once it is full, the oldest
+/// events are dropped to make room.  Recording an event copies a few words
+/// and nothing else.
+///
+/// When Nachos halts, the events left are written out in the trace event
+/// format read by `chrome://tracing` and Perfetto, where one tick is shown
+/// as one microsecond.  The running thread, interrupts, system calls,
+/// page faults and disk requests are each shown in their own track.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_TRACER__HH
+#define NACHOS_THREADS_TRACER__HH
+
+
+#include <stdio.h>
+
+
+/// Kinds of events traced.
+enum TraceKind {
+    TRACE_SWITCH,      ///< A thread starts running.
+    TRACE_INTERRUPT,   ///< An interrupt handler is called.
+    TRACE_SYSCALL,     ///< A system call returns.
+    TRACE_PAGE_FAULT,  ///< A page fault is taken.
+    TRACE_DISK         ///< A disk request completes.
+};
+
+/// One event, as kept in the ring buffer.
+class TraceEvent {
+public:
+
+    /// Longest thread name kept, including the terminating null.
+    static const unsigned NAME_SIZE = 24;
+
+    unsigned long when;      ///< Start of the event, in ticks.
+    unsigned long duration;  ///< Length of the event, 0 for instants.
+    TraceKind kind;
+
+    /// What the event is about: the system call or interrupt type, disk
+    /// request direction; a string that outlives the tracer.
+    const char *label;
+
+    /// Faulting address, or sector number; `-1` if not used.
+    int arg;
+
+    /// Thread the event happened in, copied since threads come and go.
+    char thread[NAME_SIZE];
+};
+
+class Tracer {
+public:
+
+    /// Number of events kept, unless told otherwise.
+    static const unsigned DEFAULT_CAPACITY = 1 << 16;
+
+    /// Initialize an empty trace with room for `capacity` events.
+    Tracer(unsigned capacity = DEFAULT_CAPACITY);
+
+    ~Tracer();
+
+    /// Record that `threadName` starts running.
+    void RecordSwitch(const char *threadName);
+
+    /// Record that the handler for an interrupt of type `typeName` is being
+    /// called.
+    void RecordInterrupt(const char *typeName);
+
+    /// Record that system call `name`, started at `start`, returned.
+    void RecordSyscall(const char *name, unsigned long start);
+
+    /// Record a page fault at `virtualAddress`.
+    void RecordPageFault(int virtualAddress);
+
+    /// Record that a request to read, or write, `sector`, issued at
+    /// `start`, is done.
+    void RecordDisk(bool writing, int sector, unsigned long start);
+
+    /// Write the events kept into `fileName` as a JSON trace.  Return
+    /// false if the file cannot be written.
+    bool Dump(const char *fileName) const;
+
+private:
+
+    /// Take the next slot in the ring, stamped with the current thread.
+    TraceEvent *Add(TraceKind kind, unsigned long when, const char *label,
+                    int arg);
+
+    TraceEvent *events;
+    unsigned capacity;
+
+    /// Total number of events recorded; the last `capacity` are kept.
+    unsigned long recorded;
+};
+
+/// Write `s` to `f` as a JSON string, escaping what needs to be.
+void PrintJSONString(FILE *f, const char *s);
+
+
+#endif
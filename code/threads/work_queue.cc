@@ -0,0 +1,108 @@
+/// Routines to run deferred kernel work on a pool of threads.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "work_queue.hh"
+#include "system.hh"
+
+
+WorkQueue::WorkQueue(const char *name_, unsigned maxWorkers_)
+{
+    ASSERT(name_ != nullptr);
+    ASSERT(maxWorkers_ > 0 && maxWorkers_ <= MAX_WORKERS);
+
+    name       = name_;
+    items      = new SynchList<WorkItem>;
+    numWorkers = 0;
+    maxWorkers = maxWorkers_;
+}
+
+WorkQueue::~WorkQueue()
+{
+    delete items;
+}
+
+/// Idle workers are raised with interrupts off, so that none of them stops
+/// being idle halfway; the one woken finds the item first thing, and the
+/// rest take the priority of whatever they run next.
+///
+/// A worker started here starts at the priority of the item, for the same
+/// reason.
+void
+WorkQueue::Schedule(VoidFunctionPtr func, void *arg, unsigned priority)
+{
+    ASSERT(func != nullptr);
+    ASSERT(priority <= PRIORITY_MAX);
+
+    DEBUG('t', "Queueing work for \"%s\" at priority %u\n", name, priority);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    bool anyIdle = false;
+    for (unsigned i = 0; i < numWorkers; i++) {
+        if (idle[i]) {
+            anyIdle = true;
+            unsigned previous = workers[i]->GetPriority();
+            if (workers[i]->GetBasePriority() < priority) {
+                workers[i]->SetBasePriority(priority);
+                scheduler->UpdatePriority(workers[i], previous);
+            }
+        }
+    }
+    if (!anyIdle && numWorkers < maxWorkers) {
+        unsigned i = numWorkers++;
+        workers[i] = new Thread(name, false, priority);
+        idle[i]    = false;
+        workers[i]->Fork(WorkerHelper, this);
+    }
+    interrupt->SetLevel(oldLevel);
+
+    WorkItem item = { func, arg, priority };
+    items->SortedInsert(item, PRIORITY_MAX - priority);
+}
+
+unsigned
+WorkQueue::GetNumWorkers() const
+{
+    return numWorkers;
+}
+
+void
+WorkQueue::WorkerHelper(void *queue)
+{
+    ASSERT(queue != nullptr);
+    ((WorkQueue *) queue)->WorkerLoop();
+}
+
+/// The rest of a batch is whatever is queued by the time the first item is
+/// taken; items queued meanwhile wait for the next batch, or for another
+/// worker.
+void
+WorkQueue::WorkerLoop()
+{
+    unsigned self = 0;
+    while (workers[self] != currentThread) {
+        self++;
+        ASSERT(self < numWorkers);
+    }
+
+    WorkItem batch[BATCH_SIZE];
+    for (;;) {
+        idle[self] = true;
+        batch[0] = items->Pop();
+        idle[self] = false;
+        unsigned count = 1;
+        while (count < BATCH_SIZE && items->TryPop(&batch[count])) {
+            count++;
+        }
+
+        DEBUG('t', "Worker \"%s\" running %u items\n", name, count);
+        for (unsigned i = 0; i < count; i++) {
+            currentThread->SetBasePriority(batch[i].priority);
+            batch[i].func(batch[i].arg);
+        }
+        currentThread->SetBasePriority(PRIORITY_DEFAULT);
+    }
+}
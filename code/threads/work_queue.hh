@@ -0,0 +1,85 @@
+/// Data structures to run deferred kernel work on a pool of threads.
+///
+/// Work that the kernel wants done, but not by the thread that finds it,
+/// is queued here as a function and its argument, rather than given a
+/// thread of its own; a few workers, each with one stack, serve it all.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_WORKQUEUE__HH
+#define NACHOS_THREADS_WORKQUEUE__HH
+
+
+#include "synch_list.hh"
+#include "lib/utility.hh"
+
+
+/// A queue of work items, served by a pool of kernel threads.
+///
+/// Items are served in order of priority, and in the order they came among
+/// items of the same priority.  Workers are only started as work finds
+/// none idle, up to `maxWorkers`, so that a queue nobody uses costs no
+/// thread at all.  A worker takes up to `BATCH_SIZE` items at once, so that
+/// a burst of work is run without waking a thread for each item.
+///
+/// Every item runs at the priority it was queued with.  An idle worker is
+/// raised to the priority of new work before it is woken, so that urgent
+/// work does not wait behind the threads that queued it.
+///
+/// Items may block, but a worker blocked in one holds up the rest of its
+/// batch.  Work that never ends, like the loop of a daemon, still deserves
+/// a thread of its own.  Items cannot be queued from interrupt handlers.
+class WorkQueue {
+public:
+
+    /// Most items a worker takes at once.
+    static const unsigned BATCH_SIZE = 4;
+
+    /// Most workers of a queue.
+    static const unsigned MAX_WORKERS = 8;
+
+    /// Workers of the kernel queue, by default.
+    static const unsigned DEFAULT_WORKERS = 2;
+
+    /// Set up an empty queue, to be served by up to `maxWorkers` threads
+    /// called `name`.
+    WorkQueue(const char *name, unsigned maxWorkers = DEFAULT_WORKERS);
+
+    /// Workers are left waiting for work that never comes.
+    ~WorkQueue();
+
+    /// Have `func` called with `arg` by a worker, at `priority`.
+    void Schedule(VoidFunctionPtr func, void *arg,
+                  unsigned priority = PRIORITY_DEFAULT);
+
+    /// Return the number of workers started so far.
+    unsigned GetNumWorkers() const;
+
+private:
+
+    struct WorkItem {
+        VoidFunctionPtr func;
+        void *arg;
+        unsigned priority;
+    };
+
+    static void WorkerHelper(void *queue);
+
+    /// Serve items, forever.  Run by every worker.
+    void WorkerLoop();
+
+    const char *name;
+
+    SynchList<WorkItem> *items;
+
+    /// Workers started so far, and whether each is waiting for work.
+    Thread *workers[MAX_WORKERS];
+    bool idle[MAX_WORKERS];
+    unsigned numWorkers;
+    unsigned maxWorkers;
+};
+
+
+#endif
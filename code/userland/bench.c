@@ -0,0 +1,85 @@
+/// Run the benchmark suite, and tabulate what each benchmark took.
+///
+/// `bench [<directory>]` runs the benchmark programs found in `<directory>`,
+/// the current one by default, one after the other, and prints for each the
+/// ticks it took in all, and how many of them the machine spent in user
+/// mode, in the kernel and idle, as counted by `GetTicks`.  Nothing else
+/// should be running meanwhile.  The status is what the benchmark
+/// returned: a checksum of its results, the same from run to run unless
+/// something is broken.
+///
+/// Simulated time does not depend on the host, so the same kernel gives the
+/// same numbers every time, and a change to the simulator or kernel can be
+/// measured by running the suite before and after it.
+
+#include "lib.c"
+
+
+#define MAX_PATH  64
+
+/// Each benchmark, with its argument.
+static const char *BENCHMARKS[][2] = {
+    { "bmatmult", "8" },
+    { "bmatmult", "16" },
+    { "bmatmult", "32" },
+    { "bsort",    "512" },
+    { "bstring",  "100" },
+    { "bfile",    "16" },
+    { "bspawn",   "8" },
+    { "bsyscall", "1000" },
+};
+
+#define NUM_BENCHMARKS  (sizeof BENCHMARKS / sizeof BENCHMARKS[0])
+
+int
+main(int argc, char *argv[])
+{
+    const char *directory = argc > 1 ? argv[1] : "";
+    unsigned directoryLength = strlen(directory);
+
+    bprintf(CONSOLE_OUTPUT, "%-10s %6s %10s %10s %10s %10s %8s\n",
+            "benchmark", "arg", "total", "user", "system", "idle",
+            "status");
+
+    TickCounts suiteStart, suiteEnd;
+    GetTicks(&suiteStart);
+    int failed = 0;
+    for (unsigned b = 0; b < NUM_BENCHMARKS; b++) {
+        const char *name = BENCHMARKS[b][0];
+        unsigned nameLength = strlen(name);
+        char path[MAX_PATH];
+        if (directoryLength + nameLength >= MAX_PATH) {
+            bprintf(CONSOLE_OUTPUT, "%-10s: path too long\n", name);
+            failed++;
+            continue;
+        }
+        memcpy(path, directory, directoryLength);
+        memcpy(path + directoryLength, name, nameLength + 1);
+        char *args[] = { path, (char *) BENCHMARKS[b][1], NULL };
+
+        TickCounts start, end;
+        GetTicks(&start);
+        SpaceId child = Exec(path, args);
+        if (child < 0) {
+            bprintf(CONSOLE_OUTPUT, "%-10s %6s: cannot run %s\n",
+                    name, args[1], path);
+            failed++;
+            continue;
+        }
+        int status = Join(child);
+        GetTicks(&end);
+
+        bprintf(CONSOLE_OUTPUT, "%-10s %6s %10d %10d %10d %10d %8d\n",
+                name, args[1], end.total - start.total,
+                end.user - start.user, end.system - start.system,
+                end.idle - start.idle, status);
+    }
+    GetTicks(&suiteEnd);
+
+    bprintf(CONSOLE_OUTPUT, "%-17s %10d %10d %10d %10d\n", "all",
+            suiteEnd.total - suiteStart.total, suiteEnd.user - suiteStart.user,
+            suiteEnd.system - suiteStart.system,
+            suiteEnd.idle - suiteStart.idle);
+    bflushall();
+    return failed;
+}
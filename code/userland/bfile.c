@@ -0,0 +1,46 @@
+/// Benchmark: write a file through the buffered library, read it back and
+/// remove it.
+///
+/// `bfile [<blocks>]` takes 16 blocks of 128 bytes by default.  It returns
+/// the number of bytes read back wrong or missing, 0 unless something is
+/// wrong, or -1 if the file cannot be made.
+
+#include "lib.c"
+
+
+#define DEFAULT_BLOCKS  16
+#define BLOCK_SIZE      128
+#define FILE_NAME       "bench.tmp"
+
+int
+main(int argc, char *argv[])
+{
+    int blocks = argc > 1 ? atoi(argv[1]) : DEFAULT_BLOCKS;
+    char block[BLOCK_SIZE];
+
+    if (Create(FILE_NAME) < 0) {
+        return -1;
+    }
+    OpenFileId file = Open(FILE_NAME);
+    if (file < 0) {
+        return -1;
+    }
+    for (int i = 0; i < blocks; i++) {
+        // No null bytes, which would end the writes.
+        memset(block, 'A' + i % 26, BLOCK_SIZE);
+        bwrite(block, BLOCK_SIZE, file);
+    }
+    bclose(file);
+
+    int wrong = blocks * BLOCK_SIZE;
+    if ((file = Open(FILE_NAME)) >= 0) {
+        for (int i = 0; bread(block, BLOCK_SIZE, file) == BLOCK_SIZE; i++) {
+            for (int j = 0; j < BLOCK_SIZE; j++) {
+                wrong -= block[j] == 'A' + i % 26;
+            }
+        }
+        bclose(file);
+    }
+    Remove(FILE_NAME);
+    return wrong;
+}
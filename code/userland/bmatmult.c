@@ -0,0 +1,50 @@
+/// Benchmark: multiply two `n` by `n` matrices, kept in the heap.
+///
+/// `bmatmult [<n>]` takes 16 for `n` by default.  It returns the sum of the
+/// elements of the product, so that a wrong result shows, or -1 if `n` is
+/// too big or there is no memory for the matrices.
+
+#include "lib.c"
+
+
+#define DEFAULT_DIM  16
+#define MAX_DIM      64
+
+int
+main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_DIM;
+    if (n <= 0 || n > MAX_DIM) {
+        return -1;
+    }
+
+    int *a = malloc(n * n * sizeof (int));
+    int *b = malloc(n * n * sizeof (int));
+    int *c = malloc(n * n * sizeof (int));
+    if (a == NULL || b == NULL || c == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            a[i * n + j] = i + j;
+            b[i * n + j] = i - j;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            int sum = 0;
+            for (int k = 0; k < n; k++) {
+                sum += a[i * n + k] * b[k * n + j];
+            }
+            c[i * n + j] = sum;
+        }
+    }
+
+    int total = 0;
+    for (int i = 0; i < n * n; i++) {
+        total += c[i];
+    }
+    return total;
+}
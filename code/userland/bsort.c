@@ -0,0 +1,63 @@
+/// Benchmark: heapsort `n` pseudo-random integers, kept in the heap.
+///
+/// `bsort [<n>]` takes 512 for `n` by default.  It returns the number of
+/// pairs left out of order, 0 unless something is wrong, or -1 if there is
+/// no memory for the array.
+
+#include "lib.c"
+
+
+#define DEFAULT_COUNT  512
+
+/// Move `a[i]` down the heap of the first `n` elements of `a`, until it is
+/// no smaller than its children.
+static void
+SiftDown(int *a, int i, int n)
+{
+    int value = a[i];
+    for (int child = 2 * i + 1; child < n; child = 2 * i + 1) {
+        if (child + 1 < n && a[child + 1] > a[child]) {
+            child++;
+        }
+        if (a[child] <= value) {
+            break;
+        }
+        a[i] = a[child];
+        i = child;
+    }
+    a[i] = value;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_COUNT;
+    int *a = n > 0 ? malloc(n * sizeof (int)) : NULL;
+    if (a == NULL) {
+        return -1;
+    }
+
+    unsigned seed = 12345;
+    for (int i = 0; i < n; i++) {
+        seed = seed * 1103515245 + 12345;
+        a[i] = seed >> 8;
+    }
+
+    for (int i = n / 2 - 1; i >= 0; i--) {
+        SiftDown(a, i, n);
+    }
+    for (int end = n - 1; end > 0; end--) {
+        int top = a[0];
+        a[0] = a[end];
+        a[end] = top;
+        SiftDown(a, 0, end);
+    }
+
+    int unordered = 0;
+    for (int i = 0; i < n - 1; i++) {
+        if (a[i] > a[i + 1]) {
+            unordered++;
+        }
+    }
+    return unordered;
+}
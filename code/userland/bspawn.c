@@ -0,0 +1,35 @@
+/// Benchmark: start and join many processes.
+///
+/// `bspawn [<n>]` takes 8 for `n` by default.  It runs itself `n` times with
+/// `n` set to 0, which returns at once, and then forks `n` children that
+/// exit at once; kernels without `Fork` skip that.  It returns the number
+/// of processes that could not be started or did not exit with 0.
+
+#include "lib.c"
+
+
+#define DEFAULT_COUNT  8
+
+int
+main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_COUNT;
+    char *args[] = { argv[0], "0", NULL };
+
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        SpaceId child = Exec(argv[0], args);
+        failed += child < 0 || Join(child) != 0;
+    }
+    for (int i = 0; i < n; i++) {
+        SpaceId child = Fork();
+        if (child == 0) {
+            Exit(0);
+        }
+        if (child < 0) {
+            break;
+        }
+        failed += Join(child) != 0;
+    }
+    return failed;
+}
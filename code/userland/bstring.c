@@ -0,0 +1,35 @@
+/// Benchmark: the string and memory routines of the library.
+///
+/// `bstring [<rounds>]` takes 100 rounds by default.  Each fills, copies,
+/// measures and compares buffers, aligned and not.  It returns a checksum
+/// of the lengths and comparisons.
+
+#include "lib.c"
+
+
+#define DEFAULT_ROUNDS  100
+#define BUFFER_SIZE     256
+
+static char a[BUFFER_SIZE];
+static char b[BUFFER_SIZE];
+
+int
+main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : DEFAULT_ROUNDS;
+
+    int checksum = 0;
+    for (int r = 0; r < rounds; r++) {
+        int length = BUFFER_SIZE - 1 - r % 64;
+        memset(a, 'a' + r % 26, length);
+        a[length] = '\0';
+
+        memcpy(b, a, length + 1);
+        checksum += strlen(b) + (strcmp(a, b) == 0);
+
+        // Unaligned on both sides.
+        memcpy(b + 1, a + 3, length - 3);
+        checksum += strlen(b + 1 + r % 4) + (strcmp(a, b) != 0);
+    }
+    return checksum;
+}
@@ -0,0 +1,21 @@
+/// Benchmark: the cost of entering and leaving the kernel.
+///
+/// `bsyscall [<n>]` makes `n` calls, 1000 by default, to `GetTicks`, about
+/// the cheapest system call there is, and returns 0.
+
+#include "lib.c"
+
+
+#define DEFAULT_CALLS  1000
+
+int
+main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_CALLS;
+
+    TickCounts ticks;
+    for (int i = 0; i < n; i++) {
+        GetTicks(&ticks);
+    }
+    return 0;
+}
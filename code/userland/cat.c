@@ -13,13 +13,14 @@ int main(int argc, char *argv[])
     return 1;
   }
 
-  char buf[128];
-  while (Read(buf, sizeof(buf), file) > 0) {
-    puts2(buf);
+  int c;
+  while ((c = bgetc(file)) != -1) {
+    bputc(c, CONSOLE_OUTPUT);
   }
-  puts2("\n");
+  bputc('\n', CONSOLE_OUTPUT);
 
-  Close(file);
+  bclose(file);
+  bflushall();
 
   return 0;
 }
\ No newline at end of file
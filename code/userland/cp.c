@@ -8,7 +8,7 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    OpenFileId origen = Open(argv[1]);
+    OpenFileId origen = OpenDirect(argv[1]);
     if (origen == -1) {
         puts2("Error: el archivo de origen no existe.\n");
         return 1;
@@ -19,14 +19,15 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    OpenFileId destino = Open(argv[2]);
+    OpenFileId destino = OpenDirect(argv[2]);
 
     char buf[128];
-    while (Read(buf, sizeof(buf), origen) > 0)
-        Write(buf, strlen(buf), destino);
+    int n;
+    while ((n = bread(buf, sizeof(buf), origen)) > 0)
+        bwrite(buf, n, destino);
 
-    Close(origen);
-    Close(destino);
+    bclose(origen);
+    bclose(destino);
 
     return 0;
 }
\ No newline at end of file
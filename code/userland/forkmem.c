@@ -0,0 +1,36 @@
+/// Test: pages shared since `Fork` can still be evicted.
+///
+/// `forkmem` touches a new page of a buffer in each of 40 rounds, and forks
+/// a child that exits with what the page holds.  Every page of the parent
+/// is shared with each child in turn, so in less memory than the parent
+/// takes, as with `vmem/nachos -m 24 -x forkmem`, shared pages have to be
+/// evicted, and pages the child left behind have to be evictable again.  It
+/// returns 0 if every child and the parent saw what the parent wrote.
+
+#include "lib.c"
+
+
+#define PAGE_BYTES  128
+#define NUM_ROUNDS  40
+
+static char pages[(NUM_ROUNDS + 1) * PAGE_BYTES];
+
+int
+main(void)
+{
+    int failed = 0;
+    for (int i = 1; i <= NUM_ROUNDS; i++) {
+        pages[i * PAGE_BYTES] = i;
+        SpaceId child = Fork();
+        if (child == 0) {
+            Exit(pages[i * PAGE_BYTES]);
+        }
+        failed += child < 0 || Join(child) != i;
+    }
+    for (int i = 1; i <= NUM_ROUNDS; i++) {
+        failed += pages[i * PAGE_BYTES] != i;
+    }
+
+    puts2(failed ? "forkmem: FAIL\n" : "forkmem: ok\n");
+    return failed;
+}
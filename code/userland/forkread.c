@@ -0,0 +1,51 @@
+/// Test: the kernel writes into memory shared with a child since `Fork`.
+///
+/// `forkread` brings in more pages of a buffer than the TLB holds, forks a
+/// child that exits at once, and then has the kernel write into those
+/// pages: the exit status of the child, with `WaitAny`, and the contents of
+/// a file, with `Read`.  Each write takes a TLB miss on a page still shared
+/// with the child, and then a read-only fault to copy it.  It returns 0 if
+/// both writes landed.  Run it with `vmem/nachos -x forkread`.
+
+#include "lib.c"
+
+
+#define FILE_NAME   "forkread.txt"
+#define PAGE_BYTES  128
+#define NUM_PAGES   16
+#define STATUS      7
+
+static char pages[NUM_PAGES * PAGE_BYTES];
+
+int
+main(void)
+{
+    Create(FILE_NAME);
+    OpenFileId id = Open(FILE_NAME);
+    if (id < 0) {
+        puts2("forkread: cannot create " FILE_NAME "\n");
+        return 1;
+    }
+    Write("ab", 2, id);
+    Close(id);
+
+    for (int i = 0; i < NUM_PAGES; i++) {
+        pages[i * PAGE_BYTES] = 'x';
+    }
+
+    SpaceId child = Fork();
+    if (child == 0) {
+        Exit(STATUS);
+    }
+
+    int *status = (int *) &pages[PAGE_BYTES];
+    int failed = WaitAny(status, -1) != child || *status != STATUS;
+
+    id = Open(FILE_NAME);
+    failed += Read(pages, 2, id) != 2 || pages[0] != 'a' || pages[1] != 'b';
+    Close(id);
+    Remove(FILE_NAME);
+
+    puts2(failed ? "forkread: FAIL\n" : "forkread: ok\n");
+    return failed;
+}
@@ -0,0 +1,31 @@
+/// Test: `Fork` from the first program tells the parent from the child.
+///
+/// `forktest [<n>]` forks `n` children, 4 by default, each exiting with its
+/// round number, and joins each before forking the next, so that every
+/// child may take the identifier the one before left free.  The parent must
+/// never be returned 0, which only the child gets.  It returns the number
+/// of children that could not be forked or joined with their status.  Run
+/// it as the first program, with `vmem/nachos -x forktest`.
+
+#include "lib.c"
+
+
+#define DEFAULT_COUNT  4
+
+int
+main(int argc, char *argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : DEFAULT_COUNT;
+
+    int failed = 0;
+    for (int i = 1; i <= n; i++) {
+        SpaceId child = Fork();
+        if (child == 0) {
+            Exit(i);
+        }
+        failed += child < 0 || Join(child) != i;
+    }
+
+    puts2(failed ? "forktest: FAIL\n" : "forktest: ok\n");
+    return failed;
+}
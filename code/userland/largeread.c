@@ -0,0 +1,45 @@
+/// Test: the kernel writes into a clean page of a large page.
+///
+/// `largeread` reads a group of pages that may be mapped by one large TLB
+/// entry, which stays read-only until every page of the group is written,
+/// reads other pages to push that entry out of the TLB, and then has the
+/// kernel `Read` a file into the group.  The copy takes a page fault and
+/// then a read-only fault on the same address.  It returns 0 if the data
+/// landed.  Run it with `vmem/nachos -x largeread`.
+
+#include "lib.c"
+
+
+#define FILE_NAME   "largeread.txt"
+#define PAGE_BYTES  128
+#define NUM_PAGES   32
+
+static char pages[NUM_PAGES * PAGE_BYTES];
+
+int
+main(void)
+{
+    Create(FILE_NAME);
+    OpenFileId id = Open(FILE_NAME);
+    if (id < 0) {
+        puts2("largeread: cannot create " FILE_NAME "\n");
+        return 1;
+    }
+    Write("ab", 2, id);
+    Close(id);
+
+    int sum = 0;
+    for (int i = 0; i < NUM_PAGES; i++) {
+        sum += pages[i * PAGE_BYTES];
+    }
+
+    char *buffer = &pages[NUM_PAGES / 2 * PAGE_BYTES];
+    id = Open(FILE_NAME);
+    int failed = sum != 0 || Read(buffer, 2, id) != 2
+                 || buffer[0] != 'a' || buffer[1] != 'b';
+    Close(id);
+    Remove(FILE_NAME);
+
+    puts2(failed ? "largeread: FAIL\n" : "largeread: ok\n");
+    return failed;
+}
@@ -1,10 +1,92 @@
 #include "../userprog/syscall.h"
 
-unsigned strlen(const char *s)
-{
-  unsigned i;
-  for (i = 0; s[i] != '\0'; i++);
-  return i;
+#ifndef NULL
+#define NULL ((void *) 0)
+#endif
+
+/// String and memory routines.
+///
+/// Every simulated instruction costs, so these move a word at a time, with
+/// `lw` and `sw`, wherever the data lines up, and bytes only at the ends.
+/// A word with a null byte in it is told by `HAS_ZERO`, without looking at
+/// each byte.  Reading the whole aligned word that holds the end of a
+/// string is safe: it never crosses into another page.
+
+#define WORD_SIZE     sizeof (unsigned)
+#define WORD_ALIGNED(p)  (((unsigned) (p) & (WORD_SIZE - 1)) == 0)
+#define HAS_ZERO(w)   (((w) - 0x01010101u) & ~(w) & 0x80808080u)
+
+void *memcpy(void *dst, const void *src, unsigned n) {
+  char *d = dst;
+  const char *s = src;
+
+  if (((unsigned) d & (WORD_SIZE - 1)) == ((unsigned) s & (WORD_SIZE - 1))) {
+    for (; n > 0 && !WORD_ALIGNED(d); n--)
+      *d++ = *s++;
+    unsigned *dw = (unsigned *) d;
+    const unsigned *sw = (const unsigned *) s;
+    for (; n >= 4 * WORD_SIZE; n -= 4 * WORD_SIZE) {
+      dw[0] = sw[0];
+      dw[1] = sw[1];
+      dw[2] = sw[2];
+      dw[3] = sw[3];
+      dw += 4;
+      sw += 4;
+    }
+    for (; n >= WORD_SIZE; n -= WORD_SIZE)
+      *dw++ = *sw++;
+    d = (char *) dw;
+    s = (const char *) sw;
+  }
+  while (n-- > 0)
+    *d++ = *s++;
+  return dst;
+}
+
+void *memset(void *dst, int c, unsigned n) {
+  unsigned char *d = dst;
+
+  for (; n > 0 && !WORD_ALIGNED(d); n--)
+    *d++ = c;
+  unsigned w = (unsigned char) c * 0x01010101u;
+  unsigned *dw = (unsigned *) d;
+  for (; n >= 4 * WORD_SIZE; n -= 4 * WORD_SIZE) {
+    dw[0] = dw[1] = dw[2] = dw[3] = w;
+    dw += 4;
+  }
+  for (; n >= WORD_SIZE; n -= WORD_SIZE)
+    *dw++ = w;
+  d = (unsigned char *) dw;
+  while (n-- > 0)
+    *d++ = c;
+  return dst;
+}
+
+unsigned strlen(const char *s) {
+  const char *p = s;
+
+  for (; !WORD_ALIGNED(p); p++)
+    if (*p == '\0')
+      return p - s;
+  const unsigned *w = (const unsigned *) p;
+  while (!HAS_ZERO(*w))
+    w++;
+  for (p = (const char *) w; *p != '\0'; p++);
+  return p - s;
+}
+
+int strcmp(const char *a, const char *b) {
+  if (WORD_ALIGNED(a) && WORD_ALIGNED(b)) {
+    const unsigned *wa = (const unsigned *) a, *wb = (const unsigned *) b;
+    while (*wa == *wb && !HAS_ZERO(*wa)) {
+      wa++;
+      wb++;
+    }
+    a = (const char *) wa;
+    b = (const char *) wb;
+  }
+  for (; *a != '\0' && *a == *b; a++, b++);
+  return (unsigned char) *a - (unsigned char) *b;
 }
 
 void puts2(const char *s) {
@@ -38,3 +120,364 @@ void itoa(int n, char str[]) {
 
   reverse(str);
 }
+
+int atoi(const char *s) {
+  int n = 0, sign = 1;
+
+  if (*s == '-') {
+    sign = -1;
+    s++;
+  }
+  while (*s >= '0' && *s <= '9') n = n * 10 + *s++ - '0';
+
+  return sign * n;
+}
+
+/// Buffered input and output.
+///
+/// Each descriptor below `MAX_STREAMS` gets a read and a write buffer, so
+/// that a program reading or writing a character at a time makes a system
+/// call only every `STREAM_BUF_SIZE` characters.  The console output is
+/// flushed at each newline, and before reading the console, so that prompts
+/// show up.  Whatever is written must be flushed with `bflush`, `bclose` or
+/// `bflushall` before the program exits.  Descriptors from `MAX_STREAMS` on
+/// are not buffered.
+
+#include <stdarg.h>
+
+#define MAX_STREAMS     8
+#define STREAM_BUF_SIZE 128
+
+typedef struct {
+  char in[STREAM_BUF_SIZE];
+  int inPos, inLen;
+  char out[STREAM_BUF_SIZE];
+  int outLen;
+} Stream;
+
+static Stream streams[MAX_STREAMS];
+
+int bflush(OpenFileId fd) {
+  if (fd < 0 || fd >= MAX_STREAMS || streams[fd].outLen == 0)
+    return 0;
+
+  Stream *s = &streams[fd];
+  int n = Write(s->out, s->outLen, fd);
+  s->outLen = 0;
+  return n < 0 ? -1 : 0;
+}
+
+void bflushall(void) {
+  for (int fd = 0; fd < MAX_STREAMS; fd++)
+    bflush(fd);
+}
+
+int bclose(OpenFileId fd) {
+  bflush(fd);
+  if (fd >= 0 && fd < MAX_STREAMS)
+    streams[fd].inPos = streams[fd].inLen = 0;
+  return Close(fd);
+}
+
+int bwrite(const char *buf, int n, OpenFileId fd) {
+  if (fd < 0 || fd >= MAX_STREAMS)
+    return Write(buf, n, fd);
+
+  Stream *s = &streams[fd];
+  if (fd != CONSOLE_OUTPUT) {
+    for (int i = 0; i < n;) {
+      if (s->outLen == STREAM_BUF_SIZE && bflush(fd) < 0)
+        return -1;
+      int chunk = STREAM_BUF_SIZE - s->outLen;
+      if (chunk > n - i)
+        chunk = n - i;
+      memcpy(&s->out[s->outLen], &buf[i], chunk);
+      s->outLen += chunk;
+      i += chunk;
+    }
+    return n;
+  }
+  for (int i = 0; i < n; i++) {
+    if (s->outLen == STREAM_BUF_SIZE && bflush(fd) < 0)
+      return -1;
+    s->out[s->outLen++] = buf[i];
+    if (buf[i] == '\n' && bflush(fd) < 0)
+      return -1;
+  }
+  return n;
+}
+
+int bputc(char c, OpenFileId fd) {
+  return bwrite(&c, 1, fd) == 1 ? (unsigned char) c : -1;
+}
+
+int bputs(const char *str, OpenFileId fd) {
+  return bwrite(str, strlen(str), fd);
+}
+
+/// Fill the read buffer of `fd`; return false at the end of the input.
+static int fill(OpenFileId fd) {
+  Stream *s = &streams[fd];
+  if (fd == CONSOLE_INPUT)
+    bflush(CONSOLE_OUTPUT);
+  int n = Read(s->in, STREAM_BUF_SIZE, fd);
+  s->inPos = 0;
+  s->inLen = n > 0 ? n : 0;
+  return s->inLen > 0;
+}
+
+/// Return the next character of `fd`, or -1 at the end of the input.
+int bgetc(OpenFileId fd) {
+  if (fd < 0 || fd >= MAX_STREAMS) {
+    char c;
+    return Read(&c, 1, fd) == 1 ? (unsigned char) c : -1;
+  }
+
+  Stream *s = &streams[fd];
+  if (s->inPos == s->inLen && !fill(fd))
+    return -1;
+  return (unsigned char) s->in[s->inPos++];
+}
+
+int bread(char *buf, int n, OpenFileId fd) {
+  if (fd < 0 || fd >= MAX_STREAMS)
+    return Read(buf, n, fd);
+
+  Stream *s = &streams[fd];
+  int i = 0;
+  while (i < n) {
+    if (s->inPos == s->inLen && (i > 0 || !fill(fd)))
+      break;  // Return what there is rather than wait for more.
+    int chunk = s->inLen - s->inPos;
+    if (chunk > n - i)
+      chunk = n - i;
+    memcpy(&buf[i], &s->in[s->inPos], chunk);
+    i += chunk;
+    s->inPos += chunk;
+  }
+  return i;
+}
+
+/// Read a line of `fd`, newline included, into `buf`, of `size` bytes, and
+/// end it with a null.  Return its length, or -1 at the end of the input.
+int getline(char *buf, int size, OpenFileId fd) {
+  int i = 0, c = 0;
+  while (i < size - 1 && c != '\n' && (c = bgetc(fd)) != -1)
+    buf[i++] = c;
+  buf[i] = '\0';
+  return i == 0 && c == -1 ? -1 : i;
+}
+
+/// Put the digits of `n` in `base` right before `end`, and return where
+/// they start.
+static char *formatunsigned(unsigned n, unsigned base, char *end) {
+  do {
+    *--end = "0123456789abcdef"[n % base];
+  } while ((n /= base) > 0);
+  return end;
+}
+
+/// Formatted output to `fd`: `%d`, `%u`, `%x`, `%c`, `%s` and `%%`.  A
+/// width may come after the `%`, to pad with spaces on the left, or, after
+/// a `-`, on the right.
+void bprintf(OpenFileId fd, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  for (const char *p = format; *p != '\0'; p++) {
+    if (*p != '%' || p[1] == '\0') {
+      bputc(*p, fd);
+      continue;
+    }
+    int left = 0, width = 0;
+    if (*++p == '-') {
+      left = 1;
+      p++;
+    }
+    while (*p >= '0' && *p <= '9')
+      width = width * 10 + *p++ - '0';
+    if (*p == '\0')
+      break;
+
+    char buf[12];
+    char *end = buf + sizeof buf;
+    const char *s = buf;
+    int len = 1;
+    switch (*p) {
+      case 'd': {
+        int n = va_arg(args, int);
+        char *d = formatunsigned(n < 0 ? -(unsigned) n : (unsigned) n, 10, end);
+        if (n < 0)
+          *--d = '-';
+        s = d;
+        len = end - d;
+        break;
+      }
+      case 'u':
+      case 'x':
+        s = formatunsigned(va_arg(args, unsigned), *p == 'u' ? 10 : 16, end);
+        len = end - s;
+        break;
+      case 'c': buf[0] = va_arg(args, int); break;
+      case 's':
+        s = va_arg(args, const char *);
+        len = strlen(s);
+        break;
+      default:  buf[0] = *p; break;
+    }
+    if (!left)
+      for (int pad = width - len; pad > 0; pad--)
+        bputc(' ', fd);
+    bwrite(s, len, fd);
+    if (left)
+      for (int pad = width - len; pad > 0; pad--)
+        bputc(' ', fd);
+  }
+  va_end(args);
+}
+
+/// Heap allocation.
+///
+/// Blocks have a header with their size in front of them.  Those up to
+/// `MAX_CLASS_SIZE`, header included, come in powers of two from
+/// `MIN_CLASS_SIZE` up, and a freed one goes to the free list of its size
+/// class, to be handed out again as is.  They are cut from memory taken
+/// from `Sbrk` at least `HEAP_CHUNK` bytes at a time.  Larger blocks are
+/// taken from `Sbrk` just as big as asked, and kept in one list once
+/// freed, from which the first big enough is reused.  Memory is never given
+/// back to the kernel.
+
+#define MIN_CLASS_SIZE 16
+#define MAX_CLASS_SIZE 2048
+#define NUM_CLASSES    8
+#define HEAP_CHUNK     1024
+
+typedef struct BlockHeader {
+  unsigned size;              // Of the whole block, header included.
+  struct BlockHeader *next;   // In a free list.
+} BlockHeader;
+
+static BlockHeader *freeClasses[NUM_CLASSES];
+static BlockHeader *freeLarge;
+static char *chunkNext, *chunkEnd;
+
+/// Take `size` bytes, a multiple of 8, from the current chunk, taking a new
+/// one if it has not got them.
+static void *carve(unsigned size) {
+  if (chunkNext == 0 || (unsigned) (chunkEnd - chunkNext) < size) {
+    unsigned grow = size > HEAP_CHUNK ? size : HEAP_CHUNK;
+    char *more = Sbrk(grow);
+    if (more == (char *) -1)
+      return 0;
+    if (more != chunkEnd)
+      chunkNext = more;  // Not contiguous: the rest of the old chunk is lost.
+    chunkEnd = more + grow;
+  }
+  void *block = chunkNext;
+  chunkNext += size;
+  return block;
+}
+
+void *malloc(unsigned n) {
+  if (n == 0)
+    return 0;
+  unsigned size = (n + sizeof (BlockHeader) + 7) & ~7u;
+
+  BlockHeader *h;
+  if (size <= MAX_CLASS_SIZE) {
+    unsigned c = 0, classSize = MIN_CLASS_SIZE;
+    while (classSize < size) {
+      classSize *= 2;
+      c++;
+    }
+    h = freeClasses[c];
+    if (h != 0) {
+      freeClasses[c] = h->next;
+    } else if ((h = carve(classSize)) == 0) {
+      return 0;
+    }
+    h->size = classSize;
+  } else {
+    BlockHeader **link = &freeLarge;
+    while (*link != 0 && (*link)->size < size)
+      link = &(*link)->next;
+    if (*link != 0) {
+      h = *link;
+      *link = h->next;
+    } else {
+      if ((h = carve(size)) == 0)
+        return 0;
+      h->size = size;
+    }
+  }
+  return h + 1;
+}
+
+void free(void *p) {
+  if (p == 0)
+    return;
+
+  BlockHeader *h = (BlockHeader *) p - 1;
+  if (h->size > MAX_CLASS_SIZE) {
+    h->next = freeLarge;
+    freeLarge = h;
+    return;
+  }
+  unsigned c = 0;
+  for (unsigned classSize = MIN_CLASS_SIZE; classSize < h->size;
+       classSize *= 2)
+    c++;
+  h->next = freeClasses[c];
+  freeClasses[c] = h;
+}
+
+void *calloc(unsigned count, unsigned n) {
+  if (n != 0 && count > ~0u / n)
+    return 0;
+  void *p = malloc(count * n);
+  if (p != 0)
+    memset(p, 0, count * n);
+  return p;
+}
+
+void *realloc(void *p, unsigned n) {
+  if (p == 0)
+    return malloc(n);
+  if (n == 0) {
+    free(p);
+    return 0;
+  }
+
+  BlockHeader *h = (BlockHeader *) p - 1;
+  unsigned room = h->size - sizeof (BlockHeader);
+  if (n <= room)
+    return p;
+  void *q = malloc(n);
+  if (q != 0) {
+    memcpy(q, p, room);
+    free(p);
+  }
+  return q;
+}
+
+/// The info page.
+///
+/// Reading what the kernel left there costs a load, not a system call; see
+/// `InfoPage` for how current it is.
+
+#define INFO_PAGE ((const volatile InfoPage *) INFO_PAGE_ADDR)
+
+int infoticks(void) {
+  return INFO_PAGE->total;
+}
+
+int getpid(void) {
+  return INFO_PAGE->pid;
+}
+
+int getcpu(void) {
+  return INFO_PAGE->cpu;
+}
+
+int readythreads(void) {
+  return INFO_PAGE->ready;
+}
@@ -0,0 +1,59 @@
+/// List directories, as told by `ReadDir`.
+///
+/// `ls [<directory>...]` prints the files and directories in each
+/// `directory`, the root by default, one per line with its length in
+/// bytes; directories end in `/`.  A file given instead of a directory is
+/// printed by itself.
+
+#include "lib.c"
+
+
+static FileStat entries[MAX_READ_DIR];
+
+static void
+print(const FileStat *e)
+{
+    bprintf(CONSOLE_OUTPUT, "%8d %s%s\n", e->length, e->name,
+            e->isDirectory ? "/" : "");
+}
+
+static int
+list(const char *name)
+{
+    FileStat stat;
+    if (Stat(name, &stat) < 0) {
+        bprintf(CONSOLE_OUTPUT, "Error: `%s` not found.\n", name);
+        return 1;
+    }
+    if (!stat.isDirectory) {
+        print(&stat);
+        return 0;
+    }
+
+    int n = ReadDir(name, entries, MAX_READ_DIR);
+    if (n < 0) {
+        bprintf(CONSOLE_OUTPUT, "Error: could not read `%s`.\n", name);
+        return 1;
+    }
+    for (int i = 0; i < n; i++) {
+        print(&entries[i]);
+    }
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int status = 0;
+    if (argc < 2) {
+        status = list("");
+    }
+    for (int i = 1; i < argc; i++) {
+        if (argc > 2) {
+            bprintf(CONSOLE_OUTPUT, "%s:\n", argv[i]);
+        }
+        status |= list(argv[i]);
+    }
+    bflushall();
+    return status;
+}
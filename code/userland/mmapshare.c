@@ -0,0 +1,91 @@
+/// Test: processes mapping a file read-only share its frames.
+///
+/// `mmapshare` writes a file of two pages, maps it read-only and reads
+/// both pages, then runs itself as `mmapshare child`, which maps the same
+/// file read-only and checks what it reads, and that both pages are in
+/// frames another process maps too.  It returns 0 if the child found the
+/// data and the sharing it expected.  Read-only mappings need virtual
+/// memory: run it with `vmem/nachos -x mmapshare`.
+
+#include "lib.c"
+
+
+#define FILE_NAME   "mmapshare.txt"
+#define PAGE_BYTES  128
+#define FILE_SIZE   (2 * PAGE_BYTES)
+
+static char contents[FILE_SIZE];
+
+/// Map the file read-only; return where, or null on error.
+static char *
+MapFile(void)
+{
+    OpenFileId id = Open(FILE_NAME);
+    if (id < 0) {
+        puts2("mmapshare: cannot open " FILE_NAME "\n");
+        return NULL;
+    }
+    char *page = MmapReadOnly(id, FILE_SIZE);
+    Close(id);
+    if (page == (char *) -1) {
+        puts2("mmapshare: cannot map " FILE_NAME "\n");
+        return NULL;
+    }
+    return page;
+}
+
+static int
+Child(void)
+{
+    char *page = MapFile();
+    if (page == NULL) {
+        return 1;
+    }
+    int failed = 0;
+    for (int i = 0; i < FILE_SIZE; i++) {
+        failed += page[i] != (i < PAGE_BYTES ? 'a' : 'b');
+    }
+
+    ProcessInfo self;
+    GetProcesses(&self, 1);
+    if (self.sharedPages != 2) {
+        puts2("mmapshare: pages not shared\n");
+        failed++;
+    }
+    Munmap(page);
+    return failed;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc > 1) {
+        return Child();
+    }
+
+    memset(contents, 'a', PAGE_BYTES);
+    memset(contents + PAGE_BYTES, 'b', PAGE_BYTES);
+    Create(FILE_NAME);
+    OpenFileId id = Open(FILE_NAME);
+    if (id < 0) {
+        puts2("mmapshare: cannot create " FILE_NAME "\n");
+        return 1;
+    }
+    Write(contents, FILE_SIZE, id);
+    Close(id);
+
+    char *page = MapFile();
+    if (page == NULL) {
+        return 1;
+    }
+    int failed = page[0] != 'a' || page[PAGE_BYTES] != 'b';
+
+    char *args[] = { argv[0], "child", NULL };
+    SpaceId child = Exec(argv[0], args);
+    failed += child < 0 || Join(child) != 0;
+    Munmap(page);
+    Remove(FILE_NAME);
+
+    puts2(failed ? "mmapshare: FAIL\n" : "mmapshare: ok\n");
+    return failed;
+}
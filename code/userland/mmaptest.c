@@ -0,0 +1,49 @@
+/// Test: changes made through `Mmap` reach the file.
+///
+/// `mmaptest` writes a file, maps it, changes its first bytes through the
+/// mapping, unmaps it, and reads the file back.  Mapped pages live above
+/// the rest of the address space, so this runs the faults that bring them
+/// in, and with swap, the checks that tell them from swapped pages.  It
+/// returns 0 if the file holds what was written through the mapping.
+
+#include "lib.c"
+
+
+#define FILE_NAME  "mmaptest.txt"
+#define FILE_SIZE  16
+
+int
+main(void)
+{
+    if (Create(FILE_NAME) < 0) {
+        puts2("mmaptest: cannot create " FILE_NAME "\n");
+        return 1;
+    }
+    OpenFileId id = Open(FILE_NAME);
+    if (id < 0) {
+        puts2("mmaptest: cannot open " FILE_NAME "\n");
+        return 1;
+    }
+    Write("AAAAAAAAAAAAAAAA", FILE_SIZE, id);
+
+    char *page = Mmap(id, FILE_SIZE);
+    if (page == (char *) -1) {
+        puts2("mmaptest: cannot map " FILE_NAME "\n");
+        return 1;
+    }
+    int failed = page[0] != 'A' || page[FILE_SIZE - 1] != 'A';
+    page[0] = 'B';
+    page[1] = 'B';
+    Munmap(page);
+    Close(id);
+
+    char buffer[FILE_SIZE];
+    id = Open(FILE_NAME);
+    failed += Read(buffer, FILE_SIZE, id) != FILE_SIZE
+              || buffer[0] != 'B' || buffer[1] != 'B' || buffer[2] != 'A';
+    Close(id);
+    Remove(FILE_NAME);
+
+    puts2(failed ? "mmaptest: FAIL\n" : "mmaptest: ok\n");
+    return failed;
+}
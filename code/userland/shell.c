@@ -5,6 +5,7 @@
 #define MAX_LINE_SIZE  60
 #define MAX_ARG_COUNT  32
 #define ARG_SEPARATOR  ' '
+#define MAX_PIPELINE   8
 
 #define NULL  ((void *) 0)
 
@@ -45,14 +46,16 @@ ReadLine(char *buffer, unsigned size, OpenFileId input)
 
     unsigned i;
 
-    for (i = 0; i < size; i++) {
+    // `Read` does not end what it reads with a null byte; leave room for
+    // one.
+    for (i = 0; i < size - 1; i++) {
         Read(&buffer[i], 1, input);
         // TODO: what happens when the input ends?
         if (buffer[i] == '\n') {
-            buffer[i] = '\0';
             break;
         }
     }
+    buffer[i] = '\0';
     return i;
 }
 
@@ -99,6 +102,60 @@ PrepareArguments(char *line, char **argv, unsigned argvSize)
     return parallel;
 }
 
+/// Run the commands of `argv`, split by `|` arguments, each with its output
+/// piped to the input of the next; wait for them all unless `parallel`.
+static void
+RunPipeline(char **argv, int parallel, OpenFileId output)
+{
+    char   **commands[MAX_PIPELINE];
+    unsigned n = 1;
+
+    commands[0] = argv;
+    for (unsigned i = 0; argv[i] != NULL; i++) {
+        if (strcmp(argv[i], "|") != 0) {
+            continue;
+        }
+        if (n == MAX_PIPELINE || argv[i + 1] == NULL || i == 0
+              || argv[i - 1] == NULL) {
+            WriteError("bad pipeline.", output);
+            return;
+        }
+        argv[i] = NULL;
+        commands[n++] = &argv[i + 1];
+    }
+
+    SpaceId   processes[MAX_PIPELINE];
+    OpenFileId input = CONSOLE_INPUT;
+    for (unsigned c = 0; c < n; c++) {
+        OpenFileId ends[2] = { CONSOLE_INPUT, CONSOLE_OUTPUT };
+        if (c < n - 1 && Pipe(ends) == -1) {
+            WriteError("cannot make a pipe.", output);
+            n = c;
+            break;
+        }
+
+        processes[c] = ExecIO(commands[c][0], commands[c], input, ends[1]);
+
+        // Only the programs keep their ends open.
+        if (input != CONSOLE_INPUT) {
+            Close(input);
+        }
+        if (ends[1] != CONSOLE_OUTPUT) {
+            Close(ends[1]);
+        }
+        input = ends[0];
+    }
+    if (input != CONSOLE_INPUT) {
+        Close(input);
+    }
+
+    for (unsigned c = 0; !parallel && c < n; c++) {
+        if (processes[c] != -1) {
+            Join(processes[c]);
+        }
+    }
+}
+
 int
 main(void)
 {
@@ -119,22 +176,13 @@ main(void)
             WriteError("too many arguments.", OUTPUT);
             continue;
         }
+        if (parallel) {
+            argv[0] = line + 1;
+        }
 
-        // Comment and uncomment according to whether command line arguments
-        // are given in the system call or not.
-        // const SpaceId newProc = Exec(line);
-        // const SpaceId newProc = Exec(line, argv);
-        const SpaceId newProc = Exec(parallel ? line + 1 : line, argv);
-
-        // TODO: check for errors when calling `Exec`; this depends on how
+        // TODO: check for errors when calling `ExecIO`; this depends on how
         //       errors are reported.
-
-        if (!parallel & newProc != -1) Join(newProc);
-        // TODO: is it necessary to check for errors after `Join` too, or
-        //       can you be sure that, with the implementation of the system
-        //       call handler you made, it will never give an error?; what
-        //       happens if tomorrow the implementation changes and new
-        //       error conditions appear?
+        RunPipeline(argv, parallel, OUTPUT);
     }
 
     // Never reached.
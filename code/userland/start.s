@@ -26,6 +26,14 @@ __start:
         jal     Exit
         .end    __start
 
+/// Where the function of a thread made by `ThreadFork` returns to: invoke
+/// `Exit` with its return value, like `__start` does.
+        .ent    __threadexit
+__threadexit:
+        move    $4, $2
+        jal     Exit
+        .end    __threadexit
+
 /// System call stubs
 ///
 /// Assembly language assist to make system calls to the Nachos kernel.
@@ -69,6 +77,22 @@ Join:
         j       $31
         .end    Join
 
+        .globl  WaitAny
+        .ent    WaitAny
+WaitAny:
+        addiu   $2, $0, SC_WAIT_ANY
+        syscall
+        j       $31
+        .end    WaitAny
+
+        .globl  JoinTimeout
+        .ent    JoinTimeout
+JoinTimeout:
+        addiu   $2, $0, SC_JOIN_TIMEOUT
+        syscall
+        j       $31
+        .end    JoinTimeout
+
         .globl  Fork
         .ent    Fork
 Fork:
@@ -85,6 +109,14 @@ Yield:
         j       $31
         .end    Yield
 
+        .globl  Sleep
+        .ent    Sleep
+Sleep:
+        addiu   $2, $0, SC_SLEEP
+        syscall
+        j       $31
+        .end    Sleep
+
         .globl  Create
         .ent    Create
 Create:
@@ -109,6 +141,46 @@ Open:
         j       $31
         .end    Open
 
+        .globl  OpenDirect
+        .ent    OpenDirect
+OpenDirect:
+        addiu   $2, $0, SC_OPEN_DIRECT
+        syscall
+        j       $31
+        .end    OpenDirect
+
+        .globl  Dup
+        .ent    Dup
+Dup:
+        addiu   $2, $0, SC_DUP
+        syscall
+        j       $31
+        .end    Dup
+
+        .globl  Dup2
+        .ent    Dup2
+Dup2:
+        addiu   $2, $0, SC_DUP2
+        syscall
+        j       $31
+        .end    Dup2
+
+        .globl  Stat
+        .ent    Stat
+Stat:
+        addiu   $2, $0, SC_STAT
+        syscall
+        j       $31
+        .end    Stat
+
+        .globl  ReadDir
+        .ent    ReadDir
+ReadDir:
+        addiu   $2, $0, SC_READ_DIR
+        syscall
+        j       $31
+        .end    ReadDir
+
         .globl  Read
         .ent    Read
 Read:
@@ -133,6 +205,46 @@ Close:
         j       $31
         .end    Close
 
+        .globl  Fsync
+        .ent    Fsync
+Fsync:
+        addiu   $2, $0, SC_FSYNC
+        syscall
+        j       $31
+        .end    Fsync
+
+        .globl  PunchHole
+        .ent    PunchHole
+PunchHole:
+        addiu   $2, $0, SC_PUNCH_HOLE
+        syscall
+        j       $31
+        .end    PunchHole
+
+        .globl  Bind
+        .ent    Bind
+Bind:
+        addiu   $2, $0, SC_BIND
+        syscall
+        j       $31
+        .end    Bind
+
+        .globl  Send
+        .ent    Send
+Send:
+        addiu   $2, $0, SC_SEND
+        syscall
+        j       $31
+        .end    Send
+
+        .globl  Receive
+        .ent    Receive
+Receive:
+        addiu   $2, $0, SC_RECEIVE
+        syscall
+        j       $31
+        .end    Receive
+
         .globl PrintScheduler
         .ent PrintScheduler
 PrintScheduler:
@@ -141,6 +253,217 @@ PrintScheduler:
         j       $31
         .end    PrintScheduler
 
+        .globl  GetDiskStats
+        .ent    GetDiskStats
+GetDiskStats:
+        addiu   $2, $0, SC_DISK_STATS
+        syscall
+        j       $31
+        .end    GetDiskStats
+
+        .globl  GetTicks
+        .ent    GetTicks
+GetTicks:
+        addiu   $2, $0, SC_GET_TICKS
+        syscall
+        j       $31
+        .end    GetTicks
+
+        .globl  GetProcesses
+        .ent    GetProcesses
+GetProcesses:
+        addiu   $2, $0, SC_GET_PROCESSES
+        syscall
+        j       $31
+        .end    GetProcesses
+
+        .globl  GetLimits
+        .ent    GetLimits
+GetLimits:
+        addiu   $2, $0, SC_GET_LIMITS
+        syscall
+        j       $31
+        .end    GetLimits
+
+        .globl  SetLimits
+        .ent    SetLimits
+SetLimits:
+        addiu   $2, $0, SC_SET_LIMITS
+        syscall
+        j       $31
+        .end    SetLimits
+
+        .globl  Checkpoint
+        .ent    Checkpoint
+Checkpoint:
+        addiu   $2, $0, SC_CHECKPOINT
+        syscall
+        j       $31
+        .end    Checkpoint
+
+        .globl  Sbrk
+        .ent    Sbrk
+Sbrk:
+        addiu   $2, $0, SC_SBRK
+        syscall
+        j       $31
+        .end    Sbrk
+
+        .globl  Pipe
+        .ent    Pipe
+Pipe:
+        addiu   $2, $0, SC_PIPE
+        syscall
+        j       $31
+        .end    Pipe
+
+        .globl  ExecIO
+        .ent    ExecIO
+ExecIO:
+        addiu   $2, $0, SC_EXEC_IO
+        syscall
+        j       $31
+        .end    ExecIO
+
+/// `ThreadFork` also passes the kernel, in r6, where the thread is to
+/// return to.
+        .globl  ThreadFork
+        .ent    ThreadFork
+ThreadFork:
+        la      $6, __threadexit
+        addiu   $2, $0, SC_THREAD_FORK
+        syscall
+        j       $31
+        .end    ThreadFork
+
+        .globl  LockCreate
+        .ent    LockCreate
+LockCreate:
+        addiu   $2, $0, SC_LOCK_CREATE
+        syscall
+        j       $31
+        .end    LockCreate
+
+        .globl  LockAcquire
+        .ent    LockAcquire
+LockAcquire:
+        addiu   $2, $0, SC_LOCK_ACQUIRE
+        syscall
+        j       $31
+        .end    LockAcquire
+
+        .globl  LockRelease
+        .ent    LockRelease
+LockRelease:
+        addiu   $2, $0, SC_LOCK_RELEASE
+        syscall
+        j       $31
+        .end    LockRelease
+
+        .globl  SemCreate
+        .ent    SemCreate
+SemCreate:
+        addiu   $2, $0, SC_SEM_CREATE
+        syscall
+        j       $31
+        .end    SemCreate
+
+        .globl  SemWait
+        .ent    SemWait
+SemWait:
+        addiu   $2, $0, SC_SEM_WAIT
+        syscall
+        j       $31
+        .end    SemWait
+
+        .globl  SemSignal
+        .ent    SemSignal
+SemSignal:
+        addiu   $2, $0, SC_SEM_SIGNAL
+        syscall
+        j       $31
+        .end    SemSignal
+
+        .globl  Mmap
+        .ent    Mmap
+Mmap:
+        addiu   $2, $0, SC_MMAP
+        syscall
+        j       $31
+        .end    Mmap
+
+        .globl  MmapReadOnly
+        .ent    MmapReadOnly
+MmapReadOnly:
+        addiu   $2, $0, SC_MMAP_READ_ONLY
+        syscall
+        j       $31
+        .end    MmapReadOnly
+
+        .globl  Munmap
+        .ent    Munmap
+Munmap:
+        addiu   $2, $0, SC_MUNMAP
+        syscall
+        j       $31
+        .end    Munmap
+
+        .globl  ShmCreate
+        .ent    ShmCreate
+ShmCreate:
+        addiu   $2, $0, SC_SHM_CREATE
+        syscall
+        j       $31
+        .end    ShmCreate
+
+        .globl  ShmAttach
+        .ent    ShmAttach
+ShmAttach:
+        addiu   $2, $0, SC_SHM_ATTACH
+        syscall
+        j       $31
+        .end    ShmAttach
+
+        .globl  ShmDetach
+        .ent    ShmDetach
+ShmDetach:
+        addiu   $2, $0, SC_SHM_DETACH
+        syscall
+        j       $31
+        .end    ShmDetach
+
+        .globl  IoRingSetup
+        .ent    IoRingSetup
+IoRingSetup:
+        addiu   $2, $0, SC_IO_RING_SETUP
+        syscall
+        j       $31
+        .end    IoRingSetup
+
+        .globl  IoRingEnter
+        .ent    IoRingEnter
+IoRingEnter:
+        addiu   $2, $0, SC_IO_RING_ENTER
+        syscall
+        j       $31
+        .end    IoRingEnter
+
+        .globl  ReadV
+        .ent    ReadV
+ReadV:
+        addiu   $2, $0, SC_READV
+        syscall
+        j       $31
+        .end    ReadV
+
+        .globl  WriteV
+        .ent    WriteV
+WriteV:
+        addiu   $2, $0, SC_WRITEV
+        syscall
+        j       $31
+        .end    WriteV
+
 /// Dummy function to keep gcc happy.
         .globl  __main
         .ent    __main
@@ -0,0 +1,60 @@
+/// Show what the processes are doing, as told by `GetProcesses`.
+///
+/// `top [<samples> [<interval>]]` prints a table of the processes
+/// `samples` times, once by default, sleeping `interval` ticks in between,
+/// 10000 by default.  Ticks and counts are those since each process
+/// started.  The program started first has no identifier, shown as `-`.
+
+#include "lib.c"
+
+
+#define MAX_PROCESSES     32
+#define DEFAULT_INTERVAL  10000
+
+static const char *STATES[] = { "new", "run", "ready", "block" };
+
+static ProcessInfo processes[MAX_PROCESSES];
+
+int
+main(int argc, char *argv[])
+{
+    int samples  = argc > 1 ? atoi(argv[1]) : 1;
+    int interval = argc > 2 ? atoi(argv[2]) : DEFAULT_INTERVAL;
+
+    for (int s = 0; s < samples; s++) {
+        if (s > 0) {
+            Sleep(interval);
+        }
+        int n = GetProcesses(processes, MAX_PROCESSES);
+        if (n < 0) {
+            puts2("Error: could not get the processes.\n");
+            return 1;
+        }
+
+        bprintf(CONSOLE_OUTPUT, "%4s %-15s %-5s %3s %8s %8s %5s %5s %5s "
+                "%6s %6s %6s %6s\n", "pid", "name", "state", "pri", "user",
+                "system", "pages", "res", "wset", "faults", "tlb", "read",
+                "write");
+        for (int i = 0; i < n && i < MAX_PROCESSES; i++) {
+            const ProcessInfo *p = &processes[i];
+            char pid[12];
+            if (p->pid < 0) {
+                pid[0] = '-';
+                pid[1] = '\0';
+            } else {
+                itoa(p->pid, pid);
+            }
+            bprintf(CONSOLE_OUTPUT, "%4s %-15s %-5s %3d %8u %8u %5d %5d "
+                    "%5d %6u %6u %6u %6u\n", pid, p->name,
+                    STATES[p->state & 3], p->priority, p->userTicks,
+                    p->systemTicks, p->pages, p->residentPages,
+                    p->workingSet, p->pageFaults, p->tlbMisses,
+                    p->sectorsRead, p->sectorsWritten);
+        }
+        if (n > MAX_PROCESSES) {
+            bprintf(CONSOLE_OUTPUT, "and %d more\n", n - MAX_PROCESSES);
+        }
+        bflushall();
+    }
+    return 0;
+}
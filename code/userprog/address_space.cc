@@ -8,33 +8,97 @@
 
 #include "address_space.hh"
 #include "executable.hh"
+#include "image_cache.hh"
+#include "syscall.h"
+#include "tlb_shootdown.hh"
+#include "threads/lock.hh"
+#include "threads/semaphore.hh"
 #include "threads/system.hh"
+#include "machine/endianness.hh"
 
+#include <stdio.h>
 #include <string.h>
 
 
 /// First, set up the translation from program memory to physical memory.
 /// For now, this is really simple (1:1), since we are only uniprogramming,
 /// and we have a single unsegmented page table.
-AddressSpace::AddressSpace(OpenFile *executable_file)
+///
+/// With *VMEM*, pages covered by the code segment are read-only, and are
+/// shared with other address spaces of the executable called `name`.
+AddressSpace::AddressSpace(OpenFile *executable_file, const char *name)
 {
   ASSERT(executable_file != nullptr);
 
-  Executable exe (executable_file);
-  ASSERT(exe.CheckMagic());
+  // Repeated runs of a program find it already read and checked; the
+  // image is kept for as long as the space, for its symbols.
+  image = imageCache->Acquire(executable_file, name);
+  ASSERT(image != nullptr);
+  Executable exe (executable_file, image);
+  imageCache->Attach(image);
 
 #ifdef DEMAND_LOADING
   exec_file = executable_file;
+  executable = new Executable(exe);  // Keep the parsed header.
+#endif
+
+#ifdef USE_TLB
+  InitASID();
+  memset(workingSet, 0, sizeof workingSet);
 #endif
 
   // How big is address space?
-  unsigned size = exe.GetSize() + USER_STACK_SIZE;
+  unsigned size = exe.GetSize() + userStackSize;
     // We need to increase the size to leave room for the stack.
   numPages = DivRoundUp(size, PAGE_SIZE);
   size = numPages * PAGE_SIZE;
+  heapBreak = size;
+  users     = 1;
+  ready     = true;
+  pid       = -1;
+  limits    = currentThread->space != nullptr ? currentThread->space->limits
+                                              : defaultLimits;
+  limitEvictions = 0;
+
+  codeStart = exe.GetCodeAddr();
+  codeEnd   = codeStart + exe.GetCodeSize();
+  dataStart = exe.GetInitDataAddr();
+  dataEnd   = dataStart + exe.GetInitDataSize();
+  profile = profiler == nullptr ? nullptr
+                                : profiler->Open(name, codeStart, codeEnd,
+                                                 image);
+
+#ifdef VMEM
+  // Wait, if need be, for the program to fit with those running.
+  memoryScheduler->Admit(this, numPages);
+#endif
+
+#ifndef SWAP
+  ASSERT(numPages + 1 <= memoryBitmap->CountClear());  // With the info page.
+  // Every page is kept in memory, so a program over its limit cannot run.
+  if (limits.residentPages > 0 && numPages > limits.residentPages) {
+    DEBUG('a', "%u pages are over the limit of %u\n",
+          numPages, limits.residentPages);
+    ready = false;
+  }
+#else
+  ready = InitSwap();
+#endif
+
+#ifdef VMEM
+  copyOnWrite = new Bitmap(numPages);
+  text = name == nullptr ? nullptr : AttachText(&exe, name);
+#endif
 
-  // TODO: only if no demand loading / swap
-  ASSERT(numPages <= memoryBitmap->CountClear());
+#ifdef DEMAND_LOADING
+  prefetched      = new Bitmap(numPages);
+  nextFault       = 0;
+  readAheadWindow = 1;
+  traceLength     = 0;
+  tracing         = image->traceLength == 0;
+  prefetchLock    = new Lock("prefetch");
+  loadingPage     = -1;
+#endif
 
   DEBUG('a', "Initializing address space, num pages %u, size %u\n",
         numPages, size);
@@ -43,75 +107,304 @@ AddressSpace::AddressSpace(OpenFile *executable_file)
 
   // First, set up the translation.
 
-  pageTable = new TranslationEntry[numPages];
+#ifdef VMEM
+  ASSERT(numPages <= MAP_FIRST_PAGE);
+  InitMappings();
+  InitAttachments();
+#endif
   for (unsigned i = 0; i < numPages; i++) {
-#ifdef DEMAND_LOADING
-    pageTable[i].virtualPage  = -1;
-    pageTable[i].physicalPage = -1;
+    pageTable[i].use          = false;
+    pageTable[i].dirty        = false;
+    pageTable[i].large        = false;
+#ifdef VMEM
+    pageTable[i].readOnly     = IsText(i);
 #else
-    int free = memoryBitmap->Find();
+    // In page-aligned executables, code pages hold nothing else.
+    pageTable[i].readOnly     = exe.IsCodeReadOnly()
+                                && i * PAGE_SIZE >= codeStart
+                                && i * PAGE_SIZE < codeEnd;
+#endif
 
-    if (free < 0) {
-      DEBUG('a', "Error: could not find a free physical page");
-      break;
+#ifndef DEMAND_LOADING
+    if (!IsZeroFill(i)) {
+      bool zeroed = false;
+#ifdef VMEM
+      int shared = IsText(i) ? text->GetFrame(i) : -1;
+      unsigned free;
+      if (shared != -1) {
+        free = shared;
+        coreMap->Share(free, this, i);
+      } else {
+        free = coreMap->Allocate(this, i, PreferredFrame(i), &zeroed);
+        if (IsText(i)) {
+          text->SetFrame(i, free);
+        }
+      }
+#else
+      int free = AllocateFrame(i);
 
-      // TODO: swap???
+      if (free < 0) {
+        DEBUG('a', "Error: could not find a free physical page");
+        break;
+      }
+#endif
+      pageTable[i].virtualPage  = i;
+      pageTable[i].physicalPage = free;
+      pageTable[i].valid        = true;
+#ifdef VMEM
+      if (shared == -1)
+#endif
+      {
+        if (!zeroed) {
+          ZeroUnbacked(i, mainMemory + free * PAGE_SIZE);
+        }
+        InvalidateFrameCode(free);
+      }
+      continue;
     }
-    pageTable[i].virtualPage  = i;
-    pageTable[i].physicalPage = free;
-    memset(mainMemory + free * PAGE_SIZE, 0, PAGE_SIZE);
 #endif
-    pageTable[i].valid        = true;
-    pageTable[i].use          = false;
-    pageTable[i].dirty        = false;
-    pageTable[i].readOnly     = false;
-      // If the code segment was entirely on a separate page, we could
-      // set its pages to be read-only.
 
-    }
+    // Loaded, or just cleared, when first touched.
+    pageTable[i].virtualPage  = -1;
+    pageTable[i].physicalPage = TranslationEntry::NO_FRAME;
+    pageTable[i].valid        = false;
+  }
+
+#ifndef VMEM
+  for (unsigned base = 0; base < numPages;
+       base += TranslationEntry::LARGE_PAGE_PAGES) {
+    MapLargePage(base);
+  }
+#endif
+  InitInfoPage();
 
 #ifndef DEMAND_LOADING
+#ifdef VMEM
+    // Shared code pages found in memory need not be read again; the ones
+    // this space brought itself are read below like any other.
+    Bitmap loaded(numPages);
+    for (unsigned i = 0; i < numPages; i++) {
+      if (IsText(i) && coreMap->GetRefCount(pageTable[i].physicalPage) > 1) {
+        loaded.Mark(i);
+      }
+    }
+    const Bitmap *skip = &loaded;
+#else
+    const Bitmap *skip = nullptr;
+#endif
+
     // Then, copy in the code and data segments into memory.
-    uint32_t codeSize = exe.GetCodeSize();
-    uint32_t initDataSize = exe.GetInitDataSize();
-    if (codeSize > 0) {
-        uint32_t virtualAddr = exe.GetCodeAddr();
-        DEBUG('a', "Initializing code segment. Size: %u.\n", codeSize);
-
-        for (uint32_t i = 0; i < codeSize; i++) {
-          uint32_t frame = pageTable[DivRoundDown(virtualAddr + i, PAGE_SIZE)].physicalPage;
-          uint32_t offset = (virtualAddr + i) % PAGE_SIZE;
-          uint32_t physAddr = frame * PAGE_SIZE + offset;
-
-          exe.ReadCodeBlock(&(mainMemory[physAddr]), 1, i);
-        }
+    if (codeEnd > codeStart) {
+        DEBUG('a', "Initializing code segment. Size: %u.\n",
+              codeEnd - codeStart);
+        LoadSegment(&exe, true, skip);
     }
-    if (initDataSize > 0) {
-        uint32_t virtualAddr = exe.GetInitDataAddr();
-        DEBUG('a', "Initializing data segment. Size %u\n", initDataSize);
+    if (dataEnd > dataStart) {
+        DEBUG('a', "Initializing data segment. Size %u\n",
+              dataEnd - dataStart);
+        LoadSegment(&exe, false, nullptr);
+    }
+#endif
+}
+
+#ifdef VMEM
+/// Create a copy of `parent`, for `Fork`.
+///
+/// No page is copied: both spaces map the same frames, and every writable
+/// page becomes read-only in both until one of them writes to it; see
+/// `HandleReadOnlyFault`.
+///
+/// The child has no executable to load pages from, so every page of the
+/// parent is brought into memory first, and every page of the child, code
+/// included, is marked dirty, so that it is evicted to swap rather than
+/// dropped, whether still shared or private again.
+AddressSpace::AddressSpace(AddressSpace *parent)
+{
+  ASSERT(parent != nullptr);
 
-        for (uint32_t i = 0; i < initDataSize; i++) {
-          uint32_t frame = pageTable[DivRoundDown(virtualAddr + i, PAGE_SIZE)].physicalPage;
-          uint32_t offset = (virtualAddr + i) % PAGE_SIZE;
-          uint32_t physAddr = frame * PAGE_SIZE + offset;
+  numPages  = parent->numPages;
+  heapBreak = parent->heapBreak;
+  users     = 1;  // Only the thread that forked is copied.
+  ready     = true;
+  pid       = -1;
+  limits    = parent->limits;
+  limitEvictions = 0;
+  codeStart = parent->codeStart;
+  codeEnd   = parent->codeEnd;
+  dataStart = parent->dataStart;
+  dataEnd   = parent->dataEnd;
+  image     = parent->image;
+  imageCache->Attach(image);
+  profile = profiler == nullptr
+            ? nullptr
+            : profiler->Open(parent->profile == nullptr
+                               ? nullptr : parent->profile->program,
+                             codeStart, codeEnd, image);
 
-          exe.ReadDataBlock(&(mainMemory[physAddr]), 1, i);
-        }
-   }
+#ifdef DEMAND_LOADING
+  exec_file = nullptr;
+  executable = nullptr;
+  prefetched = new Bitmap(numPages);
+  nextFault  = 0;
+  readAheadWindow = 1;
+  traceLength  = 0;
+  tracing      = false;  // Not a run of the program from its start.
+  prefetchLock = new Lock("prefetch");
+  loadingPage  = -1;
+#endif
+
+#ifdef USE_TLB
+  InitASID();
+  memset(workingSet, 0, sizeof workingSet);
+#endif
+
+#ifdef SWAP
+  ready = InitSwap();
+#endif
+
+  // No frame is taken until either space writes to a page.
+  memoryScheduler->Admit(this, 0);
+
+  text = parent->text;
+  if (text != nullptr) {
+    textTable->Attach(text);
+  }
+
+  DEBUG('a', "Forking address space, num pages %u\n", numPages);
+
+  // Mapped files are not inherited.
+  copyOnWrite = new Bitmap(numPages);
+  InitMappings();
+  InitAttachments();
+  for (unsigned i = 0; i < numPages; i++) {
+    TranslationEntry *entry = &parent->pageTable[i];
+    if (entry->virtualPage != i) {
+      parent->LoadPage(i);
+      entry->virtualPage = i;
+    }
+    CollectFrameBits(entry->physicalPage, entry);
+    coreMap->Share(entry->physicalPage, this, i);
+    if (!entry->readOnly) {
+      entry->readOnly = true;
+      entry->dirty    = true;
+      parent->copyOnWrite->Mark(i);
+      copyOnWrite->Mark(i);
+    }
+
+    pageTable[i] = *entry;
+    pageTable[i].use   = false;
+    pageTable[i].dirty = true;
+  }
+
+#ifdef USE_TLB
+  // The parent's TLB entries still allow writing to the shared pages.
+  ShootdownASID(parent->asid);
 #endif
+
+  InitInfoPage();
+
+  // Shared segments are, at the same addresses.
+  for (unsigned i = 0; i < MAX_ATTACHMENTS; i++) {
+    const AttachedSegment *a = &parent->attachments[i];
+    if (a->id == -1) {
+      continue;
+    }
+    attachments[i] = *a;
+    segmentTable->Attach(a->id);
+    for (unsigned vpn = a->firstPage; vpn < a->firstPage + a->numPages;
+         vpn++) {
+      coreMap->Share(parent->pageTable[vpn].physicalPage);
+      pageTable[vpn] = parent->pageTable[vpn];
+      pageTable[vpn].use = false;
+    }
+  }
 }
+#endif
 
 /// Deallocate an address space.
 ///
-/// Nothing for now!
+/// Frames still mapped by another address space are left alone.  Freed
+/// frames are not cleared: whoever takes them next writes every byte.
 AddressSpace::~AddressSpace()
 {
+#ifdef VMEM
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    if (mappings[i].file != nullptr) {
+      Unmap(mappings[i].firstPage * PAGE_SIZE);
+    }
+  }
+  for (unsigned i = 0; i < MAX_ATTACHMENTS; i++) {
+    if (attachments[i].id != -1) {
+      DetachSegment(attachments[i].firstPage * PAGE_SIZE);
+    }
+  }
+#endif
+
+  ShootdownFrame(infoFrame);
+#ifdef VMEM
+  coreMap->Free(infoFrame);
+#else
+  memoryBitmap->Clear(infoFrame);
+#endif
+
   for (unsigned int i = 0; i < numPages; i++) {
-    memoryBitmap->Clear(pageTable[i].physicalPage);
-    memset(&machine->GetMMU()->mainMemory[pageTable[i].physicalPage * PAGE_SIZE], 0, PAGE_SIZE);
+    unsigned frame = pageTable[i].physicalPage;
+    if (frame >= numPhysPages) {
+      continue;  // Never loaded.
+    }
+#ifdef VMEM
+    if (!coreMap->Free(frame, this, i)) {
+      continue;
+    }
+    if (IsText(i)) {
+      text->SetFrame(i, -1);
+    }
+    ShootdownFrame(frame);
+#else
+    memoryBitmap->Clear(frame);
+#endif
+    InvalidateFrameCode(frame);
+  }
+
+#ifdef DEMAND_LOADING
+  SaveTrace();  // A run shorter than the trace.
+  delete prefetchLock;
+  delete executable;
+  delete prefetched;
+  delete exec_file;
+#endif
+  imageCache->Release(image);
+
+  for (unsigned i = 0; i < userLocks.Capacity(); i++) {
+    delete userLocks.Remove(i);
+  }
+  for (unsigned i = 0; i < userSemaphores.Capacity(); i++) {
+    delete userSemaphores.Remove(i);
+  }
+
+#ifdef SWAP
+#ifndef FILESYS_STUB
+  if (swapFile != nullptr) {
+    fileSystem->Remove(swapName);
+  }
+#endif
+  delete swapFile;
+  delete swapped;
+#endif
+
+#ifdef VMEM
+  delete copyOnWrite;
+  if (text != nullptr) {
+    textTable->Detach(text);
   }
+  memoryScheduler->Leave(this);
+#endif
 
-  delete [] pageTable;
+#ifdef USE_TLB
+  if (asid != NO_ASID) {
+    asidBitmap->Clear(asid);
+  }
+#endif
 }
 
 /// Set the initial values for the user-level register set.
@@ -140,76 +433,1501 @@ AddressSpace::InitRegisters()
     machine->WriteRegister(STACK_REG, numPages * PAGE_SIZE - 16);
     DEBUG('a', "Initializing stack register to %u\n",
           numPages * PAGE_SIZE - 16);
+
+#ifdef DEMAND_LOADING
+    // The program starts here: load ahead the pages it faulted first the
+    // last times it ran.
+    StartPrefetch();
+#endif
 }
 
 /// On a context switch, save any machine state, specific to this address
 /// space, that needs saving.
 ///
-/// For now, nothing!
+/// With a TLB, take note of the pages used while the space ran, to load
+/// them back when it runs again.
 void
 AddressSpace::SaveState()
-{}
+{
+#ifdef USE_TLB
+  SampleWorkingSet();
+#endif
+#ifdef SWAP
+  unsigned workingSetSize = GetWorkingSetSize();
+  if (workingSetSize > 0) {
+    memoryScheduler->Update(this, workingSetSize);
+  }
+#endif
+}
 
 /// On a context switch, restore the machine state so that this address space
 /// can run.
 ///
-/// For now, tell the machine where to find the page table.
+/// Tell the machine where to find the page table or, with a TLB, which
+/// address space identifier to match.
 void
 AddressSpace::RestoreState()
 {
 #ifndef USE_TLB
-    machine->GetMMU()->pageTable     = pageTable;
-    machine->GetMMU()->pageTableSize = numPages;
+    machine->GetMMU()->pageTable = &pageTable;
+#else
+    // Entries of other spaces stay in the TLB, tagged with their own
+    // identifiers; only spaces without one have to start cold.
+    MMU *mmu = machine->GetMMU();
+    if (asid == NO_ASID) {
+      mmu->InvalidateASID(NO_ASID);
+    }
+    mmu->SetASID(asid);
+    PreloadTLB();
+#endif
+}
+
+void
+AddressSpace::SetPid(int newPid)
+{
+  pid = newPid;
+}
+
+void
+AddressSpace::UpdateInfoPage()
+{
+  // Laid out as `InfoPage`.
+  unsigned words[5];
+  words[0] = WordToMachine(stats->totalTicks);
+  words[1] = WordToMachine(pid);
+  words[2] = WordToMachine(scheduler->GetCPU());
+  words[3] = WordToMachine(scheduler->GetNumReady());
+  words[4] = WordToMachine(currentThread->GetPriority());
+  memcpy(&machine->GetMMU()->mainMemory[infoFrame * PAGE_SIZE],
+         words, sizeof words);
+}
+
+/// The frame is one nobody owns, so that it is never evicted.
+void
+AddressSpace::InitInfoPage()
+{
+  ASSERT(INFO_PAGE * PAGE_SIZE == INFO_PAGE_ADDR);
+
+  bool zeroed = false;
+#ifdef VMEM
+  infoFrame = coreMap->Allocate(nullptr, 0, -1, &zeroed);
+#else
+  int frame = memoryBitmap->Find();
+  ASSERT(frame != -1);
+  infoFrame = frame;
+#endif
+  if (!zeroed) {
+    memset(&machine->GetMMU()->mainMemory[infoFrame * PAGE_SIZE], 0,
+           PAGE_SIZE);
+  }
+
+  TranslationEntry *entry = &pageTable[INFO_PAGE];
+  entry->virtualPage  = INFO_PAGE;
+  entry->physicalPage = infoFrame;
+  entry->valid        = true;
+  entry->readOnly     = true;
+  entry->use          = false;
+  entry->dirty        = false;
+  entry->large        = false;
+}
+
+TranslationEntry *
+AddressSpace::GetPageEntry(unsigned vpn)
+{
+  return &pageTable[vpn];
+}
+
+unsigned
+AddressSpace::GetNumPages() const
+{
+  return numPages;
+}
+
+unsigned
+AddressSpace::GetNumResidentPages() const
+{
+  unsigned resident = 0;
+  for (unsigned vpn = 0; vpn < numPages; vpn++) {
+    const TranslationEntry *entry = pageTable.Find(vpn);
+    if (entry != nullptr && entry->valid) {
+      resident++;
+    }
+  }
+  return resident;
+}
+
+bool
+AddressSpace::IsAtLimit() const
+{
+  return limits.residentPages > 0
+         && GetNumResidentPages() >= limits.residentPages;
+}
+
+unsigned
+AddressSpace::GetWorkingSetSize() const
+{
+#ifdef USE_TLB
+  unsigned size = 0;
+  for (unsigned i = 0; i < WORKING_SET_SLOTS; i++) {
+    if (workingSet[i].history != 0) {
+      size++;
+    }
+  }
+  return size;
 #else
-    MMU* mmu = machine->GetMMU();
-    for (unsigned i = 0; i < TLB_SIZE; i++) {
-      mmu->tlb[i].valid = false;
+  return GetNumResidentPages();
+#endif
+}
+
+/// Shared memory segments are left out: their frames belong to no space.
+unsigned
+AddressSpace::GetNumSharedPages() const
+{
+#ifdef VMEM
+  unsigned shared = 0;
+  for (unsigned vpn = 0; vpn < numPages; vpn++) {
+    const TranslationEntry *entry = pageTable.Find(vpn);
+    if (entry != nullptr && entry->valid
+        && coreMap->GetRefCount(entry->physicalPage) > 1) {
+      shared++;
+    }
+  }
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    const MappedFile *m = &mappings[i];
+    for (unsigned p = 0; m->file != nullptr && p < m->numPages; p++) {
+      const TranslationEntry *entry = pageTable.Find(m->firstPage + p);
+      if (entry != nullptr && entry->valid
+          && coreMap->GetRefCount(entry->physicalPage) > 1) {
+        shared++;
+      }
     }
+  }
+  return shared;
+#else
+  return 0;
 #endif
 }
 
-TranslationEntry*
-AddressSpace::GetPageTable() {
-  return pageTable;
+#if defined(VMEM) || defined(DEMAND_LOADING)
+/// Copy `old`, of `oldSize` bits, into a new bitmap of `newSize`.
+static Bitmap *
+GrowBitmap(Bitmap *old, unsigned oldSize, unsigned newSize)
+{
+  ASSERT(old != nullptr);
+  ASSERT(newSize >= oldSize);
+
+  Bitmap *bigger = new Bitmap(newSize);
+  for (unsigned i = 0; i < oldSize; i++) {
+    if (old->Test(i)) {
+      bigger->Mark(i);
+    }
+  }
+  delete old;
+  return bigger;
 }
+#endif
 
+/// New pages are made like those of the stack: cleared when first touched.
+/// Without swapping, there must be a free frame for each of them now, as
+/// they cannot be evicted later to make room.
+int
+AddressSpace::Sbrk(int increment)
+{
+  if (increment < 0) {
+    return -1;
+  }
+
+  uint32_t newBreak = heapBreak + increment;
+  unsigned newPages = DivRoundUp(newBreak, PAGE_SIZE);
+#ifdef VMEM
+  unsigned maxPages = MAP_FIRST_PAGE;
+#else
+  unsigned maxPages = INFO_PAGE;
+#endif
+  if (newBreak < heapBreak || newPages > maxPages) {
+    return -1;
+  }
+#ifndef SWAP
+  if (newPages - numPages > memoryBitmap->CountClear()
+        || (limits.residentPages > 0 && newPages > limits.residentPages)) {
+    return -1;
+  }
+#endif
+
+  if (newPages > numPages) {
+    DEBUG('a', "Growing the heap to page %u\n", newPages - 1);
+    for (unsigned vpn = numPages; vpn < newPages; vpn++) {
+      pageTable[vpn].virtualPage  = -1;
+      pageTable[vpn].physicalPage = TranslationEntry::NO_FRAME;
+      pageTable[vpn].valid        = false;
+      pageTable[vpn].readOnly     = false;
+      pageTable[vpn].use          = false;
+      pageTable[vpn].dirty        = false;
+      pageTable[vpn].large        = false;
+    }
+#ifdef VMEM
+    copyOnWrite = GrowBitmap(copyOnWrite, numPages, newPages);
+#endif
 #ifdef DEMAND_LOADING
-void AddressSpace::LoadPage(unsigned vpn) {
-  int free = memoryBitmap->Find();
+    prefetched = GrowBitmap(prefetched, numPages, newPages);
+#endif
+#ifdef SWAP
+    swapped = GrowBitmap(swapped, numPages, newPages);
+#endif
+    numPages = newPages;
+  }
+
+  int oldBreak = heapBreak;
+  heapBreak = newBreak;
+  return oldBreak;
+}
+
+void
+AddressSpace::Attach()
+{
+  users++;
+}
+
+bool
+AddressSpace::Detach()
+{
+  ASSERT(users > 0);
+  return --users == 0;
+}
+
+bool
+AddressSpace::IsReady() const
+{
+  return ready;
+}
+
+unsigned
+AddressSpace::GetNumUsers() const
+{
+  return users;
+}
+
+/// Stacks are `userStackSize` bytes, like that of the first thread, and
+/// aligned like it.
+int
+AddressSpace::NewStack()
+{
+  if (!freeStacks.IsEmpty()) {
+    return freeStacks.Pop();
+  }
+
+  unsigned size = DivRoundUp(userStackSize, 16u) * 16;
+  unsigned pad  = (16 - heapBreak % 16) % 16;
+  int bottom = Sbrk(pad + size);
+  if (bottom == -1) {
+    return -1;
+  }
+  DEBUG('a', "New thread stack at 0x%X, %u bytes\n", bottom + pad, size);
+  return bottom + pad + size;
+}
+
+void
+AddressSpace::FreeStack(int top)
+{
+  ASSERT(top > 0 && (unsigned) top <= heapBreak);
+  freeStacks.Append(top);
+}
+
+void
+AddressSpace::ReleaseHeldLocks()
+{
+  for (unsigned i = 0; i < userLocks.Capacity(); i++) {
+    Lock *lock = userLocks.Get(i);
+    if (lock != nullptr && lock->IsHeldByCurrentThread()) {
+      lock->Release();
+    }
+  }
+}
+
+ProcessProfile *
+AddressSpace::GetProfile() const
+{
+  return profile;
+}
+
+const SymbolTable *
+AddressSpace::GetSymbols() const
+{
+  return image->symbols;
+}
+
+/// Bring page `vpn` into memory.
+///
+/// Only the bytes not read from the swap file or the executable are
+/// cleared, so a page is written once rather than cleared and then read
+/// over.
+void
+AddressSpace::LoadPage(unsigned vpn)
+{
+  ASSERT(IsValidPage(vpn));
+
+#ifdef VMEM
+  if (IsText(vpn) && text->GetFrame(vpn) != -1) {
+    DEBUG('a', "Sharing code page %u in frame %u\n",
+          vpn, text->GetFrame(vpn));
+    coreMap->Share(text->GetFrame(vpn), this, vpn);
+    pageTable[vpn].physicalPage = text->GetFrame(vpn);
+    pageTable[vpn].valid = true;
+    pageTable[vpn].use   = false;
+    pageTable[vpn].dirty = false;
+    return;
+  }
+
+  const MappedFile *m = FindMapping(vpn);
+  if (m != nullptr && m->shared != nullptr
+      && m->shared->GetFrame(vpn - m->firstPage) != -1) {
+    unsigned frame = m->shared->GetFrame(vpn - m->firstPage);
+    DEBUG('a', "Sharing mapped page %u in frame %u\n", vpn, frame);
+    coreMap->Share(frame, this, vpn);
+    pageTable[vpn].physicalPage = frame;
+    pageTable[vpn].valid    = true;
+    pageTable[vpn].readOnly = true;
+    pageTable[vpn].use      = false;
+    pageTable[vpn].dirty    = false;
+    return;
+  }
+
+  // Pages read whole from swap, or from a mapped file, need no zeros.
+  bool zeroed = false;
+  bool *zeros = m == nullptr ? &zeroed : nullptr;
+#ifdef SWAP
+  if (m == nullptr && swapped->Test(vpn)) {
+    zeros = nullptr;
+  }
+  // A space at its limit makes room among its own pages, not others'.
+  if (limits.residentPages > 0) {
+    limitEvictions += coreMap->Trim(this, limits.residentPages);
+  }
+#endif
+  unsigned free = coreMap->Allocate(this, vpn, PreferredFrame(vpn), zeros);
+  coreMap->Pin(free);  // Not to be evicted while we fill it.
+#else
+  bool zeroed = false;
+  int free = AllocateFrame(vpn);
   if (free < 0) {
     DEBUG('e', "Error: could not find a free physical page\n");
-    // TODO: swap???
   }
+  ASSERT(free >= 0);
+#endif
 
-  char *mainMemory = machine->GetMMU()->mainMemory;
-  memset(mainMemory + free * PAGE_SIZE, 0, PAGE_SIZE);
+  char *page = &machine->GetMMU()->mainMemory[free * PAGE_SIZE];
+  InvalidateFrameCode(free);
+
+  pageTable[vpn].use   = false;
+  pageTable[vpn].dirty = false;
+
+#ifdef VMEM
+  if (m != nullptr) {
+    // Bytes past the end of the file read as zeros.  A shared page is read
+    // whole, whatever the size of the mapping that reads it first, so that
+    // it holds the same for every mapping of the file.
+    unsigned offset = (vpn - m->firstPage) * PAGE_SIZE;
+    unsigned count  = m->shared != nullptr || m->size - offset >= PAGE_SIZE
+                      ? PAGE_SIZE : m->size - offset;
+    int read = m->file->ReadAt(page, count, offset);
+    if (read < 0) {
+      read = 0;
+    }
+    memset(page + read, 0, PAGE_SIZE - read);
+    DEBUG('v', "Reading mapped page %u to frame %u\n", vpn, free);
 
-  Executable exe (exec_file);
+    // Another mapping of the file may have read the page meanwhile; this
+    // copy is then kept private.
+    if (m->shared != nullptr
+        && m->shared->GetFrame(vpn - m->firstPage) == -1) {
+      m->shared->SetFrame(vpn - m->firstPage, free);
+    }
+    pageTable[vpn].physicalPage = free;
+    pageTable[vpn].valid    = true;
+    pageTable[vpn].readOnly = m->readOnly;
+    coreMap->Unpin(free);
+    return;
+  }
+#endif
 
-  unsigned physAddr = free * PAGE_SIZE;
-  unsigned virtualAddr = vpn * PAGE_SIZE;
-  uint32_t codeSize = exe.GetCodeSize();
+#ifdef SWAP
+  if (swapped->Test(vpn)) {
+    DEBUG('v', "Swapping in page %u to frame %u\n", vpn, free);
+    swapFile->ReadAt(page, PAGE_SIZE, vpn * PAGE_SIZE);
+    stats->numSwapIns++;
 
-  unsigned read = 0;
-  if (codeSize > 0 && virtualAddr < codeSize) {
-    unsigned size = codeSize - virtualAddr < PAGE_SIZE ? codeSize - virtualAddr : PAGE_SIZE;
-    exe.ReadCodeBlock(&mainMemory[physAddr], size, virtualAddr);
+    pageTable[vpn].physicalPage = free;
+    pageTable[vpn].valid = true;
+    coreMap->Unpin(free);
+    return;
+  }
+#endif
 
-    read += size;
+  if (!zeroed) {
+    ZeroUnbacked(vpn, page);
   }
 
-  uint32_t initDataSize = exe.GetInitDataSize();
-  uint32_t initDataAddr = exe.GetInitDataAddr();
-  if (read < PAGE_SIZE && initDataSize > 0 && virtualAddr + read < initDataAddr + initDataSize) {
-    unsigned size = (initDataSize - virtualAddr < PAGE_SIZE ? initDataSize - virtualAddr : PAGE_SIZE) - read;
-    exe.ReadDataBlock(&mainMemory[physAddr + read], size, virtualAddr + read);
+#ifdef DEMAND_LOADING
+  // Read the parts of the code and initialized data segments that fall
+  // in this page.
+  ASSERT(executable != nullptr || IsZeroFill(vpn));
+  uint32_t pageStart = vpn * PAGE_SIZE;
+  uint32_t pageEnd   = pageStart + PAGE_SIZE;
 
-    read += size;
+  if (codeStart < pageEnd && codeEnd > pageStart) {
+    uint32_t from = codeStart > pageStart ? codeStart : pageStart;
+    uint32_t to   = codeEnd < pageEnd ? codeEnd : pageEnd;
+    executable->ReadCodeBlock(page + (from - pageStart), to - from,
+                              from - codeStart);
   }
 
-  ASSERT(read <= PAGE_SIZE);
+  if (dataStart < pageEnd && dataEnd > pageStart) {
+    uint32_t from = dataStart > pageStart ? dataStart : pageStart;
+    uint32_t to   = dataEnd < pageEnd ? dataEnd : pageEnd;
+    executable->ReadDataBlock(page + (from - pageStart), to - from,
+                              from - dataStart);
+  }
+#else
+  // Every other page was loaded with the program.
+  ASSERT(IsZeroFill(vpn));
+#endif
 
   pageTable[vpn].physicalPage = free;
   pageTable[vpn].valid = true;
+#ifdef VMEM
+  if (IsText(vpn)) {
+    text->SetFrame(vpn, free);
+  }
+  coreMap->Unpin(free);
+#endif
+}
+
+bool
+AddressSpace::IsValidPage(unsigned vpn) const
+{
+  if (vpn < numPages || vpn == INFO_PAGE) {
+    return true;
+  }
+#ifdef VMEM
+  return FindMapping(vpn) != nullptr || FindAttachment(vpn) != nullptr;
+#else
+  return false;
+#endif
+}
+
+/// Pages that were never touched have no entry yet; those of the program
+/// are made when it is loaded, so they are mapped files or segments.
+bool
+AddressSpace::IsWritablePage(unsigned vpn) const
+{
+  if (!IsValidPage(vpn) || vpn == INFO_PAGE) {
+    return false;
+  }
+  const TranslationEntry *entry = pageTable.Find(vpn);
+  if (entry == nullptr || !entry->readOnly) {
+    return true;
+  }
+#ifdef VMEM
+  return vpn < numPages && copyOnWrite->Test(vpn);
+#else
+  return false;
+#endif
+}
+
+/// Only pages of the program itself are grouped: mapped files come and go
+/// a page at a time.
+bool
+AddressSpace::IsLargeGroup(unsigned base) const
+{
+  const unsigned span = TranslationEntry::LARGE_PAGE_PAGES;
+  ASSERT(base % span == 0);
+
+  if (base + span > numPages) {
+    return false;
+  }
+  const TranslationEntry *first = pageTable.Find(base);
+  if (first == nullptr || first->physicalPage % span != 0) {
+    return false;
+  }
+  for (unsigned k = 0; k < span; k++) {
+    const TranslationEntry *e = pageTable.Find(base + k);
+    if (e == nullptr || !e->valid || e->virtualPage != base + k
+          || e->physicalPage != first->physicalPage + k
+          || e->readOnly != first->readOnly) {
+      return false;
+    }
+#ifdef DEMAND_LOADING
+    if (prefetched->Test(base + k)) {
+      return false;  // Its first touch is to count as a fault saved.
+    }
+#endif
+  }
+  return true;
+}
+
+/// That is the frame as far from the frame of any other page of the group
+/// in memory as the pages are apart, or else the one as far from the start
+/// of an aligned run of free frames.  Once some page of the group is out
+/// of line, nothing is preferred.
+int
+AddressSpace::PreferredFrame(unsigned vpn) const
+{
+  const unsigned span = TranslationEntry::LARGE_PAGE_PAGES;
+  unsigned base = TranslationEntry::LargeBase(vpn);
+  if (base + span > numPages) {
+    return -1;
+  }
+
+  for (unsigned page = base; page < base + span; page++) {
+    const TranslationEntry *e = pageTable.Find(page);
+    if (page == vpn || e == nullptr || !e->valid
+          || e->virtualPage != page || e->physicalPage >= numPhysPages) {
+      continue;
+    }
+    unsigned distance = page - base;
+    if (e->physicalPage < distance
+          || (e->physicalPage - distance) % span != 0) {
+      return -1;
+    }
+    return e->physicalPage - distance + (vpn - base);
+  }
+
+  int run = memoryBitmap->FindAlignedRun(span);
+  return run < 0 ? -1 : run + (vpn - base);
+}
+
+#ifndef VMEM
+int
+AddressSpace::AllocateFrame(unsigned vpn)
+{
+  int preferred = PreferredFrame(vpn);
+  if (preferred < 0 || memoryBitmap->Test(preferred)) {
+    return memoryBitmap->Find();
+  }
+  memoryBitmap->Mark(preferred);
+  return preferred;
+}
+
+/// Pages are never taken away from a space without *VMEM*, so the large
+/// entry stays right for as long as the space.
+void
+AddressSpace::MapLargePage(unsigned vpn)
+{
+  unsigned base = TranslationEntry::LargeBase(vpn);
+  if (!pageTable[base].large && IsLargeGroup(base)) {
+    DEBUG('a', "Mapping pages %u to %u with a large entry\n",
+          base, base + TranslationEntry::LARGE_PAGE_PAGES - 1);
+    pageTable[base].large = true;
+    stats->numLargePages++;
+  }
+}
+#endif
+
+#ifdef VMEM
+void
+AddressSpace::InitMappings()
+{
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    mappings[i].file     = nullptr;
+    mappings[i].readOnly = false;
+    mappings[i].shared   = nullptr;
+  }
+}
+
+const MappedFile *
+AddressSpace::FindMapping(unsigned vpn) const
+{
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    const MappedFile *m = &mappings[i];
+    if (m->file != nullptr && vpn >= m->firstPage
+        && vpn - m->firstPage < m->numPages) {
+      return m;
+    }
+  }
+  return nullptr;
+}
+
+/// Mappings are placed at the lowest pages of the window where they fit.
+int
+AddressSpace::Map(OpenFile *file, unsigned size, bool readOnly)
+{
+  ASSERT(file != nullptr);
+
+  unsigned pages = DivRoundUp(size, PAGE_SIZE);
+  if (pages == 0 || pages > MAP_PAGES) {
+    return -1;
+  }
+
+  MappedFile *slot = nullptr;
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    if (mappings[i].file == file) {
+      return -1;
+    }
+    if (mappings[i].file == nullptr && slot == nullptr) {
+      slot = &mappings[i];
+    }
+  }
+  if (slot == nullptr) {
+    return -1;
+  }
+
+  // Move past every mapping in the way, until none is.
+  unsigned first = MAP_FIRST_PAGE;
+  bool moved = true;
+  while (moved && first + pages <= MAP_FIRST_PAGE + MAP_PAGES) {
+    moved = false;
+    for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+      const MappedFile *m = &mappings[i];
+      if (m->file != nullptr && m->firstPage < first + pages
+          && first < m->firstPage + m->numPages) {
+        first = m->firstPage + m->numPages;
+        moved = true;
+      }
+    }
+  }
+  if (first + pages > MAP_FIRST_PAGE + MAP_PAGES) {
+    return -1;
+  }
+
+  DEBUG('a', "Mapping %u bytes of a file at pages %u to %u\n",
+        size, first, first + pages - 1);
+  slot->file      = file;
+  slot->firstPage = first;
+  slot->numPages  = pages;
+  slot->size      = size;
+  slot->closed    = false;
+  slot->readOnly  = readOnly;
+  slot->shared    = readOnly ? AttachSharedFile(file, pages) : nullptr;
+  return first * PAGE_SIZE;
+}
+
+/// A file the stub file system opened without a name cannot be told apart
+/// from others, and is not shared.
+SharedFile *
+AddressSpace::AttachSharedFile(const OpenFile *file, unsigned pages)
+{
+#ifdef FILESYS_STUB
+  const char *name = file->GetName();
+  if (name == nullptr) {
+    return nullptr;
+  }
+  return sharedFileTable->Attach(name, -1, pages);
+#else
+  return sharedFileTable->Attach(nullptr, file->GetSector(), pages);
+#endif
+}
+
+void
+AddressSpace::ForgetSharedPage(const MappedFile *m, unsigned vpn,
+                               unsigned frame)
+{
+  ASSERT(m != nullptr);
+
+  unsigned page = vpn - m->firstPage;
+  if (m->shared != nullptr && m->shared->GetFrame(page) == (int) frame) {
+    m->shared->SetFrame(page, -1);
+  }
+}
+
+bool
+AddressSpace::Unmap(unsigned addr)
+{
+  MappedFile *m = nullptr;
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    if (mappings[i].file != nullptr
+        && mappings[i].firstPage * PAGE_SIZE == addr) {
+      m = &mappings[i];
+    }
+  }
+  if (m == nullptr) {
+    return false;
+  }
+
+  for (unsigned vpn = m->firstPage; vpn < m->firstPage + m->numPages; vpn++) {
+    TranslationEntry *entry = &pageTable[vpn];
+    unsigned frame = entry->physicalPage;
+    if (frame >= numPhysPages) {
+      continue;  // Never touched, or evicted already.
+    }
+
+    ShootdownFrame(frame, entry);
+    coreMap->Pin(frame);  // Writing back may block.
+    WriteBack(m, vpn);
+    coreMap->Unpin(frame);
+    if (coreMap->Free(frame, this, vpn)) {
+      ForgetSharedPage(m, vpn, frame);
+    }
+    InvalidateFrameCode(frame);
+
+    entry->virtualPage  = -1;
+    entry->physicalPage = TranslationEntry::NO_FRAME;
+    entry->valid        = false;
+    entry->use          = false;
+    entry->dirty        = false;
+  }
+
+  if (m->shared != nullptr) {
+    sharedFileTable->Detach(m->shared);
+  }
+  if (m->closed) {
+    delete m->file;
+  }
+  m->file = nullptr;
+  return true;
+}
+
+bool
+AddressSpace::AdoptFile(OpenFile *file)
+{
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    if (mappings[i].file == file) {
+      mappings[i].closed = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+AddressSpace::IsMapped(const OpenFile *file) const
+{
+  for (unsigned i = 0; i < MAX_MAPPINGS; i++) {
+    if (mappings[i].file == file) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+AddressSpace::InitAttachments()
+{
+  for (unsigned i = 0; i < MAX_ATTACHMENTS; i++) {
+    attachments[i].id = -1;
+  }
+}
+
+const AttachedSegment *
+AddressSpace::FindAttachment(unsigned vpn) const
+{
+  for (unsigned i = 0; i < MAX_ATTACHMENTS; i++) {
+    const AttachedSegment *a = &attachments[i];
+    if (a->id != -1 && vpn >= a->firstPage
+        && vpn - a->firstPage < a->numPages) {
+      return a;
+    }
+  }
+  return nullptr;
+}
+
+/// Segments are placed at the lowest pages of the window where they fit,
+/// like mappings.  Their pages are mapped right away, as the frames are
+/// there already, and marked dirty, as nothing is ever written back.
+int
+AddressSpace::AttachSegment(int id)
+{
+  const SharedSegment *s = segmentTable->Get(id);
+  if (s == nullptr) {
+    return -1;
+  }
+
+  AttachedSegment *slot = nullptr;
+  for (unsigned i = 0; i < MAX_ATTACHMENTS; i++) {
+    if (attachments[i].id == id) {
+      return attachments[i].firstPage * PAGE_SIZE;
+    }
+    if (attachments[i].id == -1 && slot == nullptr) {
+      slot = &attachments[i];
+    }
+  }
+  if (slot == nullptr || s->numPages > SHM_PAGES) {
+    return -1;
+  }
+
+  // Move past every attachment in the way, until none is.
+  unsigned first = SHM_FIRST_PAGE;
+  bool moved = true;
+  while (moved && first + s->numPages <= SHM_FIRST_PAGE + SHM_PAGES) {
+    moved = false;
+    for (unsigned i = 0; i < MAX_ATTACHMENTS; i++) {
+      const AttachedSegment *a = &attachments[i];
+      if (a->id != -1 && a->firstPage < first + s->numPages
+          && first < a->firstPage + a->numPages) {
+        first = a->firstPage + a->numPages;
+        moved = true;
+      }
+    }
+  }
+  if (first + s->numPages > SHM_FIRST_PAGE + SHM_PAGES) {
+    return -1;
+  }
+
+  DEBUG('a', "Attaching shared segment %d at pages %u to %u\n",
+        id, first, first + s->numPages - 1);
+  segmentTable->Attach(id);
+  for (unsigned k = 0; k < s->numPages; k++) {
+    TranslationEntry *entry = &pageTable[first + k];
+    coreMap->Share(s->frames[k]);
+    entry->virtualPage  = first + k;
+    entry->physicalPage = s->frames[k];
+    entry->valid        = true;
+    entry->readOnly     = false;
+    entry->use          = false;
+    entry->dirty        = true;
+    entry->large        = false;
+  }
+  slot->id        = id;
+  slot->firstPage = first;
+  slot->numPages  = s->numPages;
+  return first * PAGE_SIZE;
+}
+
+bool
+AddressSpace::DetachSegment(unsigned addr)
+{
+  AttachedSegment *a = nullptr;
+  for (unsigned i = 0; i < MAX_ATTACHMENTS; i++) {
+    if (attachments[i].id != -1
+        && attachments[i].firstPage * PAGE_SIZE == addr) {
+      a = &attachments[i];
+    }
+  }
+  if (a == nullptr) {
+    return false;
+  }
+
+  DEBUG('a', "Detaching shared segment %d\n", a->id);
+  for (unsigned vpn = a->firstPage; vpn < a->firstPage + a->numPages; vpn++) {
+    TranslationEntry *entry = &pageTable[vpn];
+    ShootdownFrame(entry->physicalPage, entry);
+    coreMap->Free(entry->physicalPage);  // The segment keeps a reference.
+
+    entry->virtualPage  = -1;
+    entry->physicalPage = TranslationEntry::NO_FRAME;
+    entry->valid        = false;
+    entry->use          = false;
+    entry->dirty        = false;
+  }
+  segmentTable->Detach(a->id);
+  a->id = -1;
+  return true;
+}
+
+/// Only the bytes that are part of the mapping are written, so that the
+/// file does not grow past the mapped size.
+void
+AddressSpace::WriteBack(const MappedFile *m, unsigned vpn)
+{
+  ASSERT(m != nullptr);
+
+  TranslationEntry *entry = &pageTable[vpn];
+  if (!entry->dirty) {
+    return;
+  }
+
+  unsigned offset = (vpn - m->firstPage) * PAGE_SIZE;
+  unsigned count  = m->size - offset < PAGE_SIZE ? m->size - offset
+                                                 : PAGE_SIZE;
+  DEBUG('v', "Writing back mapped page %u from frame %u\n",
+        vpn, entry->physicalPage);
+  m->file->WriteAt(&machine->GetMMU()->mainMemory[entry->physicalPage
+                                                  * PAGE_SIZE],
+                   count, offset);
+  entry->dirty = false;
+}
+#endif
+
+#ifndef DEMAND_LOADING
+/// Every read covers a run of pages mapped to consecutive frames, which is
+/// how frames come out of a fresh allocator, so that most segments take a
+/// single read from the file instead of one per page.
+void
+AddressSpace::LoadSegment(Executable *exe, bool code, const Bitmap *skip)
+{
+  ASSERT(exe != nullptr);
+
+  char *mainMemory = machine->GetMMU()->mainMemory;
+  uint32_t start = code ? codeStart : dataStart;
+  uint32_t end   = code ? codeEnd   : dataEnd;
+
+  uint32_t addr = start;
+  while (addr < end) {
+    unsigned vpn = addr / PAGE_SIZE;
+    uint32_t runEnd = (vpn + 1) * PAGE_SIZE;
+    if (skip != nullptr && skip->Test(vpn)) {
+      addr = runEnd;
+      continue;
+    }
+
+    unsigned frame = pageTable[vpn].physicalPage;
+    ASSERT(frame < numPhysPages);
+    while (runEnd < end) {
+      unsigned next = runEnd / PAGE_SIZE;
+      if ((skip != nullptr && skip->Test(next))
+          || pageTable[next].physicalPage != frame + (next - vpn)) {
+        break;
+      }
+      runEnd += PAGE_SIZE;
+    }
+    if (runEnd > end) {
+      runEnd = end;
+    }
+
+    char *dest = &mainMemory[frame * PAGE_SIZE + addr % PAGE_SIZE];
+    if (code) {
+      exe->ReadCodeBlock(dest, runEnd - addr, addr - start);
+    } else {
+      exe->ReadDataBlock(dest, runEnd - addr, addr - start);
+    }
+    addr = runEnd;
+  }
+}
+#endif
+
+bool
+AddressSpace::IsZeroFill(unsigned vpn) const
+{
+  uint32_t pageStart = vpn * PAGE_SIZE;
+  uint32_t pageEnd   = pageStart + PAGE_SIZE;
+
+  return !(codeStart < pageEnd && codeEnd > pageStart)
+         && !(dataStart < pageEnd && dataEnd > pageStart);
+}
+
+void
+AddressSpace::ZeroUnbacked(unsigned vpn, char *page) const
+{
+  ASSERT(page != nullptr);
+
+  uint32_t pageStart = vpn * PAGE_SIZE;
+  uint32_t pageEnd   = pageStart + PAGE_SIZE;
+
+  // Walk the page, skipping over the segments and clearing the gaps.
+  uint32_t addr = pageStart;
+  while (addr < pageEnd) {
+    if (addr >= codeStart && addr < codeEnd) {
+      addr = codeEnd;
+    } else if (addr >= dataStart && addr < dataEnd) {
+      addr = dataEnd;
+    } else {
+      uint32_t next = pageEnd;
+      if (codeStart > addr && codeStart < next) {
+        next = codeStart;
+      }
+      if (dataStart > addr && dataStart < next) {
+        next = dataStart;
+      }
+      memset(page + (addr - pageStart), 0, next - addr);
+      addr = next;
+    }
+  }
+}
+
+#ifdef DEMAND_LOADING
+/// Read-ahead, for programs that walk their pages in order.
+///
+/// Faults on consecutive pages double the read-ahead window, up to
+/// `readAheadPages`; any other fault shrinks it back to one page.  With a
+/// TLB, touching a page loaded ahead still causes a fault (a TLB miss),
+/// which keeps the sequence going.  Only pages backed by the executable
+/// are read ahead, and only into free frames: nothing is evicted for
+/// them.
+bool
+AddressSpace::ReadAhead(unsigned vpn, bool loaded)
+{
+  if (vpn >= numPages) {
+    return false;  // Mapped files are not read ahead.
+  }
+
+  bool saved = !loaded && prefetched->Test(vpn);
+  if (saved) {
+    prefetched->Clear(vpn);
+    stats->numFaultsSaved++;
+  }
+  if (loaded || saved) {
+    RecordFault(vpn);
+  }
+  if ((!loaded && !saved) || readAheadPages == 0) {
+    return saved;
+  }
+
+  if (vpn == nextFault) {
+    readAheadWindow *= 2;
+    if (readAheadWindow > readAheadPages) {
+      readAheadWindow = readAheadPages;
+    }
+  } else {
+    readAheadWindow = 1;
+  }
+  nextFault = vpn + 1;
+
+  if (executable == nullptr) {
+    return saved;  // Forked: no pages come from a file.
+  }
+
+  unsigned lastPage = DivRoundUp(codeEnd > dataEnd ? codeEnd : dataEnd,
+                                 PAGE_SIZE);
+  if (lastPage > numPages) {
+    lastPage = numPages;
+  }
+
+  for (unsigned next = vpn + 1;
+       next <= vpn + readAheadWindow && next < lastPage; next++) {
+    if (pageTable[next].virtualPage == next) {
+      continue;  // Already in memory.
+    }
+#ifdef SWAP
+    if (swapped->Test(next)) {
+      continue;  // Not what the executable holds anymore.
+    }
+#endif
+    if (memoryBitmap->CountClear() == 0 || IsAtLimit()) {
+      break;
+    }
+
+    DEBUG('a', "Reading ahead page %u\n", next);
+    LoadPage(next);
+    pageTable[next].virtualPage = next;
+    prefetched->Mark(next);
+    stats->numReadAheads++;
+  }
+  return saved;
+}
+
+void
+AddressSpace::RecordFault(unsigned vpn)
+{
+  if (!tracing || IsZeroFill(vpn)) {
+    return;  // Pages of zeros cost nothing to load.
+  }
+  for (unsigned i = 0; i < traceLength; i++) {
+    if (trace[i] == vpn) {
+      return;  // Evicted and loaded again.
+    }
+  }
+  trace[traceLength++] = vpn;
+  if (traceLength == MAX_TRACE_PAGES) {
+    SaveTrace();
+  }
+}
+
+/// Runs of a program started at the same time may all record its faults;
+/// the first to be done is kept.
+void
+AddressSpace::SaveTrace()
+{
+  if (tracing && traceLength > 0 && image->traceLength == 0) {
+    DEBUG('a', "Recording the first %u page faults\n", traceLength);
+    memcpy(image->trace, trace, traceLength * sizeof trace[0]);
+    image->traceLength = traceLength;
+  }
+  tracing = false;
+}
+
+/// The work is handed to a kernel worker.  It holds the space with
+/// `Attach`, so that it outlives the program if need be, and runs at the
+/// priority of the program, which lets it go first: the program runs again
+/// as soon as the prefetcher waits for the disk, or is done.
+void
+AddressSpace::StartPrefetch()
+{
+  if (executable == nullptr || image->traceLength == 0) {
+    return;
+  }
+  Attach();
+  workQueue->Schedule(PrefetchHelper, this, currentThread->GetPriority());
+  currentThread->Yield();
+}
+
+void
+AddressSpace::PrefetchHelper(void *space)
+{
+  ASSERT(space != nullptr);
+  ((AddressSpace *) space)->Prefetch();
+}
+
+/// Like read-ahead, pages are only loaded into free frames, and a page
+/// already being loaded by a fault, which marks it valid first, is left
+/// to it.  A fault on the page being prefetched waits for it in
+/// `WaitForPrefetch`, and then finds it loaded ahead of time.
+void
+AddressSpace::Prefetch()
+{
+  for (unsigned i = 0; i < image->traceLength && users > 1; i++) {
+    unsigned vpn = image->trace[i];
+    if (vpn >= numPages) {
+      continue;
+    }
+
+    prefetchLock->Acquire();
+    TranslationEntry *entry = &pageTable[vpn];
+    bool skip = entry->valid || entry->virtualPage != (unsigned) -1;
+#ifdef SWAP
+    skip = skip || swapped->Test(vpn);
+#endif
+    if (!skip && (memoryBitmap->CountClear() == 0 || IsAtLimit())) {
+      prefetchLock->Release();
+      break;
+    }
+    if (!skip) {
+      DEBUG('a', "Prefetching page %u\n", vpn);
+      loadingPage = vpn;
+      LoadPage(vpn);
+      entry->virtualPage = vpn;
+      prefetched->Mark(vpn);
+      stats->numTracePrefetches++;
+      loadingPage = -1;
+    }
+    prefetchLock->Release();
+  }
+
+  if (Detach()) {
+    delete this;
+  }
+}
+
+void
+AddressSpace::WaitForPrefetch(unsigned vpn)
+{
+  if (loadingPage == (int) vpn) {
+    prefetchLock->Acquire();
+    prefetchLock->Release();
+  }
+}
+#endif
+
+#ifdef SWAP
+void
+AddressSpace::EvictPage(unsigned vpn)
+{
+  ASSERT(IsValidPage(vpn));
+
+  TranslationEntry *entry = &pageTable[vpn];
+  unsigned frame = entry->physicalPage;
+  ASSERT(frame < numPhysPages);
+
+  // The TLB may hold the only record of recent writes, and must not keep
+  // translating to a frame that is about to change hands.
+  ShootdownFrame(frame, entry);
+  if (entry->dirty) {
+    stats->numDirtyEvictions++;
+  }
+
+  if (IsText(vpn)) {
+    text->SetFrame(vpn, -1);
+  }
+
+  const MappedFile *m = FindMapping(vpn);
+  if (m != nullptr) {
+    // Mapped pages go back to their file rather than to swap.
+    WriteBack(m, vpn);
+    ForgetSharedPage(m, vpn, frame);
+  } else {
+    prefetched->Clear(vpn);
+
+    // A clean page is either unchanged since it was read from the swap
+    // file, or can be loaded again from the executable.
+    if (entry->dirty) {
+      DEBUG('v', "Swapping out page %u from frame %u\n", vpn, frame);
+      swapFile->WriteAt(&machine->GetMMU()->mainMemory[frame * PAGE_SIZE],
+                        PAGE_SIZE, vpn * PAGE_SIZE);
+      swapped->Mark(vpn);
+      stats->numSwapOuts++;
+    }
+  }
+
+  entry->virtualPage  = -1;
+  entry->physicalPage = TranslationEntry::NO_FRAME;
+  entry->valid        = false;
+  entry->use          = false;
+  entry->dirty        = false;
+
+  InvalidateFrameCode(frame);
+}
+
+/// The page is copied and marked clean at once, with interrupts off, so
+/// that a write made while the copy is being written out marks it dirty
+/// again, rather than being lost.  A dirty bit still in the TLB is merged
+/// back later, and only makes the page be written once more.
+bool
+AddressSpace::CleanPage(unsigned vpn)
+{
+  ASSERT(IsValidPage(vpn));
+
+  TranslationEntry *entry = &pageTable[vpn];
+  unsigned frame = entry->physicalPage;
+  ASSERT(frame < numPhysPages);
+
+  char page[PAGE_SIZE];
+  IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+  if (!entry->dirty || FindMapping(vpn) != nullptr) {
+    interrupt->SetLevel(oldLevel);
+    return false;
+  }
+  memcpy(page, &machine->GetMMU()->mainMemory[frame * PAGE_SIZE],
+         PAGE_SIZE);
+  entry->dirty = false;
+  interrupt->SetLevel(oldLevel);
+
+  DEBUG('v', "Cleaning page %u in frame %u\n", vpn, frame);
+  swapFile->WriteAt(page, PAGE_SIZE, vpn * PAGE_SIZE);
+  swapped->Mark(vpn);
+  stats->numSwapOuts++;
+  return true;
+}
+#endif
+
+#ifdef VMEM
+/// Handle a write to the read-only page `vpn`.
+///
+/// If the page is only read-only because it is shared copy-on-write, give
+/// this space a private, writable copy (or just make the frame writable,
+/// if nobody else maps it anymore) and return true.  A writable page can
+/// only fault through a large TLB entry, loaded read-only until its group
+/// is dirty; see `LoadTranslation`.  Return false if the page is really
+/// read-only.
+bool
+AddressSpace::HandleReadOnlyFault(unsigned vpn)
+{
+  if (vpn >= numPages) {
+    return false;  // The info page.
+  }
+  if (!copyOnWrite->Test(vpn)) {
+#ifdef USE_TLB
+    if (!pageTable[vpn].readOnly) {
+      // Written through a large entry loaded read-only: the whole group
+      // counts as written from now on.
+      unsigned base = TranslationEntry::LargeBase(vpn);
+      for (unsigned k = 0; k < TranslationEntry::LARGE_PAGE_PAGES; k++) {
+        pageTable[base + k].dirty = true;
+      }
+      ShootdownFrame(pageTable[vpn].physicalPage);
+      return true;
+    }
+#endif
+    return false;
+  }
+
+  TranslationEntry *entry = &pageTable[vpn];
+  unsigned frame = entry->physicalPage;
+  MMU *mmu = machine->GetMMU();
+
+  if (coreMap->GetRefCount(frame) > 1) {
+    unsigned copy = coreMap->Allocate(this, vpn, PreferredFrame(vpn));
+    DEBUG('a', "Copying page %u from frame %u to frame %u\n",
+          vpn, frame, copy);
+    memcpy(&mmu->mainMemory[copy * PAGE_SIZE],
+           &mmu->mainMemory[frame * PAGE_SIZE], PAGE_SIZE);
+    InvalidateFrameCode(copy);
+    coreMap->Free(frame, this, vpn);
+    entry->physicalPage = copy;
+  } else {
+    coreMap->SetOwner(frame, this, vpn);
+  }
+
+  // Drop the read-only translation to the old frame.
+  ShootdownFrame(frame);
+
+  copyOnWrite->Clear(vpn);
+  entry->readOnly = false;
+  entry->dirty    = true;
+  return true;
+}
+#endif
+
+#ifdef VMEM
+/// Find the pages of `exe` that can be shared with other address spaces of
+/// the executable `name`: those entirely covered by the code segment, which
+/// in page-aligned executables is all of them.
+SharedText *
+AddressSpace::AttachText(Executable *exe, const char *name)
+{
+  ASSERT(exe != nullptr);
+  ASSERT(name != nullptr);
+
+  uint32_t textEnd = exe->GetCodeAddr() + exe->GetCodeSize();
+  if (exe->IsPageAligned()) {
+    if (!exe->IsCodeReadOnly()) {
+      return nullptr;
+    }
+    // The rest of the last code page is padding, so it is shared too.
+    textEnd = DivRoundUp(textEnd, PAGE_SIZE) * PAGE_SIZE;
+  }
+  if ((exe->GetInitDataSize() > 0 && exe->GetInitDataAddr() < textEnd)
+      || (exe->GetUninitDataSize() > 0
+          && exe->GetUninitDataAddr() < textEnd)) {
+    return nullptr;  // Data mixed with the code.
+  }
+
+  unsigned firstPage = DivRoundUp(exe->GetCodeAddr(), PAGE_SIZE);
+  unsigned endPage   = DivRoundDown(textEnd, PAGE_SIZE);
+  if (endPage <= firstPage) {
+    return nullptr;
+  }
+  return textTable->Attach(name, image->sector, firstPage,
+                           endPage - firstPage);
+}
+
+bool
+AddressSpace::IsText(unsigned vpn) const
+{
+  return text != nullptr && text->Has(vpn);
+}
+#endif
+
+#ifdef USE_TLB
+void
+AddressSpace::InitASID()
+{
+  // Entries left in the TLB by the previous owner of the identifier must
+  // not be seen by this space.
+  int freeAsid = asidBitmap->Find();
+  asid = freeAsid < 0 ? NO_ASID : freeAsid;
+  if (asid != NO_ASID) {
+    ShootdownASID(asid);
+  }
+}
+
+void
+AddressSpace::LoadTranslation(unsigned vpn)
+{
+  TranslationEntry *entry = pageTable.Find(vpn);
+  ASSERT(entry != nullptr);
+
+  TranslationEntry loaded = *entry;
+  loaded.large = false;
+  unsigned base = TranslationEntry::LargeBase(vpn);
+  if (IsLargeGroup(base)) {
+    loaded = *pageTable.Find(base);
+    loaded.large = true;
+#ifdef VMEM
+    // Writes are caught until every page of the group is dirty, as the
+    // dirty bit of the entry could not tell which of them were written.
+    // A kernel copy into a clean page thus takes a page fault and then a
+    // read-only fault, which `transfer.cc` allows for.
+    for (unsigned k = 0; k < TranslationEntry::LARGE_PAGE_PAGES; k++) {
+      if (!pageTable.Find(base + k)->dirty) {
+        loaded.readOnly = true;
+      }
+    }
+#endif
+    stats->numLargePages++;
+  }
+
+#ifdef VMEM
+  // The replaced TLB entry may carry the only record of writes to its
+  // page.
+  TranslationEntry evicted;
+  machine->GetMMU()->LoadTLBEntry(loaded, &evicted);
+  coreMap->UpdateBits(&evicted);
+#else
+  machine->GetMMU()->LoadTLBEntry(loaded);
+#endif
+}
+
+/// Only entries of this space are looked at: at switch-out, the current
+/// identifier is still ours.  When the working set is full, the page used
+/// least lately gives its slot up.  A large entry counts as used for every
+/// page of its group.
+void
+AddressSpace::SampleWorkingSet()
+{
+  for (unsigned i = 0; i < WORKING_SET_SLOTS; i++) {
+    workingSet[i].history >>= 1;
+  }
+
+  MMU *mmu = machine->GetMMU();
+  for (unsigned slot = 0; slot < mmu->GetTLBSize(); slot++) {
+    TranslationEntry *e = &mmu->tlb[slot];
+    if (!e->valid || !e->use || mmu->GetTLBEntryASID(slot) != asid) {
+      continue;
+    }
+#ifdef VMEM
+    coreMap->UpdateBits(e);
+#endif
+    e->use = false;
+
+    unsigned span = e->large ? TranslationEntry::LARGE_PAGE_PAGES : 1;
+    for (unsigned vpn = e->virtualPage; vpn < e->virtualPage + span; vpn++) {
+#ifndef VMEM
+      pageTable[vpn].use = true;
+#endif
+      unsigned chosen = 0;
+      for (unsigned i = 0; i < WORKING_SET_SLOTS; i++) {
+        if (workingSet[i].history != 0 && workingSet[i].vpn == vpn) {
+          chosen = i;
+          break;
+        }
+        if (workingSet[i].history < workingSet[chosen].history) {
+          chosen = i;
+        }
+      }
+      workingSet[chosen].vpn = vpn;
+      workingSet[chosen].history |= 1 << (WORKING_SET_HISTORY - 1);
+    }
+  }
+}
+
+/// The hottest pages are loaded last, so that they are the last to be
+/// replaced.  No more pages are loaded than the TLB holds.
+void
+AddressSpace::PreloadTLB()
+{
+  MMU *mmu = machine->GetMMU();
+  unsigned order[WORKING_SET_SLOTS];
+  unsigned count = 0;
+  for (unsigned i = 0; i < WORKING_SET_SLOTS; i++) {
+    if (workingSet[i].history == 0) {
+      continue;
+    }
+    // Insert by history, hottest first.
+    unsigned j = count++;
+    for (; j > 0 && workingSet[order[j - 1]].history
+                      < workingSet[i].history; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+  if (count > mmu->GetTLBSize()) {
+    count = mmu->GetTLBSize();
+  }
+
+  for (unsigned k = count; k-- > 0;) {
+    unsigned vpn = workingSet[order[k]].vpn;
+    const TranslationEntry *entry = pageTable.Find(vpn);
+    if (entry == nullptr || !entry->valid
+          || entry->virtualPage != vpn || mmu->ProbeTLB(vpn)) {
+      continue;  // Evicted, or never loaded, or in the TLB already.
+    }
+    LoadTranslation(vpn);
+    stats->numTLBPreloads++;
+  }
+}
+#endif
+
+#ifdef SWAP
+/// With the stub file system, the UNIX file is unlinked as soon as it is
+/// open, so that no swap file is left behind by a Nachos that does not
+/// get to delete its spaces.
+bool
+AddressSpace::InitSwap()
+{
+  // Pages that do not fit in memory are evicted to a swap file of our own.
+  static unsigned swapCount = 0;
+  snprintf(swapName, sizeof swapName, "SWAP.%u", swapCount++);
+  swapped  = new Bitmap(numPages);
+  swapFile = fileSystem->Create(swapName, numPages * PAGE_SIZE)
+             ? fileSystem->Open(swapName) : nullptr;
+  if (swapFile == nullptr) {
+    DEBUG('v', "Could not create swap file %s\n", swapName);
+    return false;
+  }
+  // Pages go straight between their frames and the disk: the caches of
+  // the file system would only keep a second copy of them.
+  swapFile->SetDirect(true);
+#ifdef FILESYS_STUB
+  fileSystem->Remove(swapName);
+#endif
+  return true;
 }
 #endif
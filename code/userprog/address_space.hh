@@ -15,10 +15,99 @@
 
 
 #include "filesys/file_system.hh"
-#include "machine/translation_entry.hh"
+#include "machine/page_table.hh"
+#include "lib/bitmap.hh"
+#include "lib/list.hh"
+#include "lib/table.hh"
+#include "userprog/image_cache.hh"
+#include "userprog/profiler.hh"
+#include "userprog/resource_limits.hh"
 
+#ifdef VMEM
+#include "vmem/shared_file.hh"
+#include "vmem/shared_text.hh"
+#endif
+
+#include <stdint.h>
+
+
+class SymbolTable;
+
+
+class Executable;
+class Lock;
+class Semaphore;
+
+
+#if defined(SWAP) && !defined(DEMAND_LOADING)
+    #error "Swapping requires demand loading."
+#endif
+
+/// Bytes of stack for user programs, unless `-ss` says otherwise.
+const unsigned DEFAULT_USER_STACK_SIZE = 1024;
+
+/// Virtual page where the kernel maps the info page, read-only: the last
+/// one the page table can map, out of the way of the heap (see
+/// `INFO_PAGE_ADDR` in `syscall.h`).
+const unsigned INFO_PAGE = PageTable::MAX_PAGES - 1;
+
+#ifdef VMEM
+/// First virtual page, well above the stack, and number of pages where
+/// files can be mapped.  Only the page table entries of the pages mapped are
+/// made, so the gap costs nothing.
+const unsigned MAP_FIRST_PAGE = 4096;
+const unsigned MAP_PAGES = 64;
 
-const unsigned USER_STACK_SIZE = 1024;  ///< Increase this as necessary!
+/// Most files that one address space can have mapped at once.
+const unsigned MAX_MAPPINGS = 8;
+
+/// A file mapped into an address space, by `Mmap`.
+class MappedFile {
+public:
+
+    /// The file, or null if this mapping is not in use.
+    OpenFile *file;
+
+    /// Virtual pages `firstPage` to `firstPage + numPages - 1` map the
+    /// first `size` bytes of the file.
+    unsigned firstPage;
+    unsigned numPages;
+    unsigned size;
+
+    /// Whether the file was closed while mapped; it is then deleted when
+    /// unmapped.
+    bool closed;
+
+    /// Whether the mapping is read-only, and then the frames it shares
+    /// with every other read-only mapping of the file, if the file can be
+    /// told apart from others.
+    bool readOnly;
+    SharedFile *shared;
+};
+
+/// First virtual page, right past the mapping window, and number of pages
+/// where shared memory segments are attached.
+const unsigned SHM_FIRST_PAGE = MAP_FIRST_PAGE + MAP_PAGES;
+const unsigned SHM_PAGES = 64;
+
+/// Most shared memory segments that one address space can have attached
+/// at once.
+const unsigned MAX_ATTACHMENTS = 4;
+
+/// A shared memory segment attached to an address space, by `ShmAttach`.
+class AttachedSegment {
+public:
+
+    /// Identifier of the segment in `segmentTable`, or -1 if this
+    /// attachment is not in use.
+    int id;
+
+    /// Virtual pages `firstPage` to `firstPage + numPages - 1` map the
+    /// frames of the segment.
+    unsigned firstPage;
+    unsigned numPages;
+};
+#endif
 
 
 class AddressSpace {
@@ -34,12 +123,22 @@ public:
     /// Parameters:
     /// * `executable_file` is the open file that corresponds to the
     ///   program; it contains the object code to load into memory.
-    AddressSpace(OpenFile *executable_file);
+    /// * `name` is the name of the executable, used to share its code with
+    ///   other address spaces; null disables sharing.
+    AddressSpace(OpenFile *executable_file, const char *name = nullptr);
+
+#ifdef VMEM
+    /// Create a copy-on-write copy of `parent`, for `Fork`.
+    AddressSpace(AddressSpace *parent);
+#endif
 
     /// De-allocate an address space.
     ~AddressSpace();
 
     /// Initialize user-level CPU registers, before jumping to user code.
+    ///
+    /// With demand loading, also start loading the pages that earlier runs
+    /// of the program faulted in first.
     void InitRegisters();
 
     /// Save/restore address space-specific info on a context switch.
@@ -47,22 +146,383 @@ public:
     void SaveState();
     void RestoreState();
 
-    TranslationEntry* GetPageTable();
+    /// Return the page table entry of `vpn`.
+    TranslationEntry *GetPageEntry(unsigned vpn);
 
-#ifdef DEMAND_LOADING
+    /// Number of pages of the program, stack and heap included; mapped
+    /// files are not counted.
+    unsigned GetNumPages() const;
+
+    /// Number of those pages that are in memory now.
+    unsigned GetNumResidentPages() const;
+
+    /// Number of pages the program used lately, for deciding how much
+    /// memory it needs.  With a TLB, these are the pages seen used at any
+    /// of the last `WORKING_SET_HISTORY` switches out of the space, which
+    /// may be fewer than are resident; without one, every resident page.
+    unsigned GetWorkingSetSize() const;
+
+    /// Number of pages in memory, those of mapped files included, whose
+    /// frames other address spaces map too.
+    unsigned GetNumSharedPages() const;
+
+#ifdef USE_TLB
+    /// Load the translation of `vpn` into the TLB, keeping the `use` and
+    /// `dirty` bits of the entry it replaces.  A large entry is loaded
+    /// instead when the group of `vpn` can be mapped by one.
+    void LoadTranslation(unsigned vpn);
+#endif
+
+#ifndef VMEM
+    /// Map the group of `vpn` with a large page table entry, if it can be,
+    /// now that `vpn` is in memory.
+    void MapLargePage(unsigned vpn);
+#endif
+
+    /// Move the break, the end of the heap, `increment` bytes up, adding
+    /// pages to the space as needed.  Return the old break, or -1 if
+    /// `increment` is negative or there is no room.
+    int Sbrk(int increment);
+
+    /// Count one more thread running in this space, for `ThreadFork`, or
+    /// one less; `Detach` returns whether it was the last, so that the
+    /// space is to be deleted.
+    void Attach();
+    bool Detach();
+
+    /// Return the number of threads running in this space.
+    unsigned GetNumUsers() const;
+
+    /// Return whether the space could be set up, with a swap file if it
+    /// needs one.  A space that could not must be deleted without running
+    /// it.
+    bool IsReady() const;
+
+    /// Record the identifier the process was given, for the info page.
+    void SetPid(int pid);
+
+    /// Write the time, and what the scheduler knows about the current
+    /// thread, to the info page.  Called whenever the kernel returns to
+    /// the program.
+    void UpdateInfoPage();
+
+    /// Return the top of a new stack for a thread, taken from the heap,
+    /// or -1 if there is no room for it.  `FreeStack` keeps a stack, once
+    /// its thread is done, for the next one.
+    int NewStack();
+    void FreeStack(int top);
+
+    /// Release the user locks held by the current thread, as it exits.
+    void ReleaseHeldLocks();
+
+    /// Locks and semaphores made by the threads of this space, through
+    /// `LockCreate` and `SemCreate`.  They last as long as the space.
+    Table<Lock*> userLocks;
+    Table<Semaphore*> userSemaphores;
+
+    /// Limits of the process, taken from the space of the thread that made
+    /// it, or from `defaultLimits` for the first; the sectors it may still
+    /// move; and the pages it evicted for being at its resident limit.
+    ResourceLimits limits;
+    DiskBucket diskBucket;
+    unsigned long limitEvictions;
+
+    /// Samples of the program counter taken by the profiler, or null if
+    /// not profiling.
+    ProcessProfile *GetProfile() const;
+
+    /// Procedures of the program, if its executable carries them, or null.
+    const SymbolTable *GetSymbols() const;
+
+    /// Bring page `vpn` into memory.
+    ///
+    /// Pages come from the swap file if they were evicted, and otherwise
+    /// from the executable.  Pages the executable does not cover at all,
+    /// those of uninitialized data and of the stack, are not loaded with
+    /// the rest of the program even without demand loading; they are only
+    /// cleared when first touched.
     void LoadPage(unsigned vpn);
+
+    /// Return whether `vpn` may be touched by the program: it lies in the
+    /// program's own pages, in a mapped file, or in an attached segment.
+    bool IsValidPage(unsigned vpn) const;
+
+    /// Return whether `vpn` may also be written to by the program, maybe
+    /// after a copy on write.
+    bool IsWritablePage(unsigned vpn) const;
+
+#ifdef DEMAND_LOADING
+    /// Note a page fault on `vpn`, and load some of the pages after it if
+    /// accesses look sequential.  `loaded` tells whether the fault had to
+    /// load `vpn` itself.  Return whether `vpn` was loaded ahead of time.
+    bool ReadAhead(unsigned vpn, bool loaded);
+
+    /// Wait until the prefetcher, if it is loading `vpn`, is done with it.
+    /// Called on a page fault before looking at the page.
+    void WaitForPrefetch(unsigned vpn);
+#endif
+
+#ifdef VMEM
+    /// Map the first `size` bytes of `file` into unused pages of the
+    /// mapping window.  Pages are read when first touched, and written
+    /// back when unmapped or evicted if they were modified.  Return the
+    /// virtual address of the mapping, or -1 if there is no room for it
+    /// or `file` is mapped already.
+    ///
+    /// A `readOnly` mapping cannot be written, and its pages are shared
+    /// with every other read-only mapping of the same file (see
+    /// `vmem/shared_file.hh`).
+    int Map(OpenFile *file, unsigned size, bool readOnly = false);
+
+    /// Remove the mapping starting at virtual address `addr`, writing its
+    /// modified pages back to the file.  Return false if no mapping starts
+    /// there.
+    bool Unmap(unsigned addr);
+
+    /// Return whether `file` is mapped, for closing it.  If so, deleting
+    /// the file is left to this space, which does it once unmapped.
+    bool AdoptFile(OpenFile *file);
+
+    /// Return whether `file` is mapped.
+    bool IsMapped(const OpenFile *file) const;
+
+    /// Map the frames of shared memory segment `id` into unused pages of
+    /// the attachment window, unless the segment is attached already.
+    /// Return the virtual address where it is attached, or -1 if there is
+    /// no such segment or no room for it.
+    int AttachSegment(int id);
+
+    /// Detach the segment attached at virtual address `addr`.  Return
+    /// false if none is attached there.
+    bool DetachSegment(unsigned addr);
+
+    /// Handle a write to the read-only page `vpn`.  Return false if the
+    /// page is really read-only, rather than shared copy-on-write, or
+    /// mapped by a large entry catching the first write to its group.
+    bool HandleReadOnlyFault(unsigned vpn);
+#endif
+
+#ifdef SWAP
+    /// Give up the frame holding page `vpn`, writing the page to the swap
+    /// file first if it is dirty.  Called by the core map, which then
+    /// hands the frame to its new owner.
+    void EvictPage(unsigned vpn);
+
+    /// Write page `vpn`, if dirty and backed by swap, to the swap file,
+    /// leaving it in its frame but clean, so that evicting it later needs
+    /// no writeback.  Return whether it was written.  Called by the page
+    /// cleaner, with the frame pinned.
+    bool CleanPage(unsigned vpn);
 #endif
 
 private:
 
-    /// Assume linear page table translation for now!
-    TranslationEntry *pageTable;
+    /// Return whether the space has as many pages in memory as its limit
+    /// allows, so that pages not asked for are better not loaded.
+    bool IsAtLimit() const;
+
+    /// Return whether no byte of `vpn` comes from the executable.
+    bool IsZeroFill(unsigned vpn) const;
+
+    /// Clear the bytes of page `vpn`, held at `page`, that do not come
+    /// from the executable; the others are about to be read over anyway.
+    void ZeroUnbacked(unsigned vpn, char *page) const;
+
+    /// Return whether the pages from `base` on can be mapped by one large
+    /// translation: they must all be in memory, in an aligned run of
+    /// frames, with the same protection.
+    bool IsLargeGroup(unsigned base) const;
+
+    /// Return the frame `vpn` is best loaded in for its group to end up
+    /// in an aligned run, or -1 if there is none.
+    int PreferredFrame(unsigned vpn) const;
+
+#ifndef VMEM
+    /// Take a free frame for `vpn`, the preferred one if it is free.
+    /// Return -1 if there is none.
+    int AllocateFrame(unsigned vpn);
+#endif
+
+#ifndef DEMAND_LOADING
+    /// Read the code segment of `exe` if `code`, or else its initialized
+    /// data, into the frames already mapped for it, leaving alone the pages
+    /// marked in `skip`, if given.
+    void LoadSegment(Executable *exe, bool code, const Bitmap *skip);
+#else
+    /// Note that `vpn` was faulted in, if recording the first faults.
+    void RecordFault(unsigned vpn);
+
+    /// Give the pages recorded to the image, unless some other run did
+    /// first, and stop recording.
+    void SaveTrace();
+
+    /// Start a kernel thread loading the pages the image recorded, if
+    /// any, while the program starts.
+    void StartPrefetch();
+
+    /// Body of that thread: load the recorded pages not loaded yet, into
+    /// free frames, until the program exits.
+    static void PrefetchHelper(void *space);
+    void Prefetch();
+#endif
+
+#ifdef VMEM
+    /// Clear the mapping window.
+    void InitMappings();
+
+    /// Return the mapping containing `vpn`, or null.
+    const MappedFile *FindMapping(unsigned vpn) const;
+
+    /// Write page `vpn` of mapping `m` back to the file if it is dirty.
+    void WriteBack(const MappedFile *m, unsigned vpn);
+
+    /// Return the shared pages of `file`, mapped read-only for its first
+    /// `pages` pages, or null if it cannot be shared.
+    SharedFile *AttachSharedFile(const OpenFile *file, unsigned pages);
+
+    /// Forget that page `vpn` of mapping `m` is shared in `frame`, which
+    /// is leaving memory.
+    void ForgetSharedPage(const MappedFile *m, unsigned vpn, unsigned frame);
+
+    /// Clear the attachment window.
+    void InitAttachments();
+
+    /// Return the attachment containing `vpn`, or null.
+    const AttachedSegment *FindAttachment(unsigned vpn) const;
+
+    /// Find the shareable code pages of `exe`, and the entry recording
+    /// them.
+    SharedText *AttachText(Executable *exe, const char *name);
+
+    /// Return whether `vpn` is a shared code page.
+    bool IsText(unsigned vpn) const;
+#endif
+
+#ifdef USE_TLB
+    /// Take an unused address space identifier, if there is one.
+    void InitASID();
 
-    /// Number of pages in the virtual address space.
+    /// Age the working set, and add the pages whose TLB entries were used
+    /// since the last time, clearing their `use` bits after passing them
+    /// on to the page table.
+    void SampleWorkingSet();
+
+    /// Load the pages of the working set, the most used last, into the
+    /// TLB, unless they are there already or not in memory.
+    void PreloadTLB();
+#endif
+
+#ifdef SWAP
+    /// Create the swap file.  Return false if it could not be.
+    bool InitSwap();
+#endif
+
+    /// Take a frame for the info page, and map it.
+    void InitInfoPage();
+
+    /// Entries are only made for the parts of the address space in use:
+    /// the program, and the pages where files are mapped.
+    PageTable pageTable;
+
+    /// Number of pages in the virtual address space.  The last ones, past
+    /// the stack, are the heap.
     unsigned numPages;
 
+    /// End of the heap.  It starts at the end of the stack, and is always
+    /// in the last page.
+    uint32_t heapBreak;
+
+    /// Threads running in this space.
+    unsigned users;
+
+    /// Whether the space could be set up; see `IsReady`.
+    bool ready;
+
+    /// Identifier of the process, -1 if it has none, and frame holding
+    /// its info page.
+    int pid;
+    unsigned infoFrame;
+
+    /// Tops of the stacks of threads that are done.
+    List<int> freeStacks;
+
+    /// Virtual addresses of the code and initialized data segments, for
+    /// telling which bytes of a page come from the executable.
+    uint32_t codeStart, codeEnd;
+    uint32_t dataStart, dataEnd;
+
+    ProcessProfile *profile;
+
+    /// The image the program was loaded from, kept for its symbols.
+    CachedImage *image;
+
 #ifdef DEMAND_LOADING
     OpenFile* exec_file;
+
+    /// The executable, with its header already read and checked, so that
+    /// page faults only read the page contents.
+    Executable *executable;
+
+    /// Pages loaded ahead of time and not touched yet.
+    Bitmap *prefetched;
+
+    /// Pages faulted in so far, if this space records the first faults of
+    /// its image, as `tracing` tells; see `CachedImage::trace`.
+    unsigned trace[MAX_TRACE_PAGES];
+    unsigned traceLength;
+    bool tracing;
+
+    /// Held by the prefetcher while it loads `loadingPage`, or -1.
+    Lock *prefetchLock;
+    int loadingPage;
+
+    /// Page expected to fault next if accesses are sequential, and number
+    /// of pages to load ahead when it does.
+    unsigned nextFault;
+    unsigned readAheadWindow;
+#endif
+
+#ifdef VMEM
+    /// Pages shared copy-on-write with some other address space.
+    Bitmap *copyOnWrite;
+
+    /// Code pages shared with other address spaces of the same
+    /// executable, or null.
+    SharedText *text;
+
+    /// Files mapped into the window of `MAP_PAGES` pages from
+    /// `MAP_FIRST_PAGE` on.
+    MappedFile mappings[MAX_MAPPINGS];
+
+    /// Shared memory segments attached in the window of `SHM_PAGES` pages
+    /// from `SHM_FIRST_PAGE` on.
+    AttachedSegment attachments[MAX_ATTACHMENTS];
+#endif
+
+#ifdef SWAP
+    /// Backing store for the pages of this space that were evicted.
+    OpenFile *swapFile;
+    char swapName[16];
+
+    /// Pages whose latest contents are in the swap file.
+    Bitmap *swapped;
+#endif
+
+#ifdef USE_TLB
+    /// Identifier tagging this space's entries in the TLB, or `NO_ASID` if
+    /// none was available.
+    unsigned asid;
+
+    /// Pages used lately.  The `history` of each has a bit for each of
+    /// the last switches out of the space, the highest for the latest, set
+    /// if the page was used before it; slots with no bits set are free.
+    struct WorkingSetPage {
+        unsigned vpn;
+        unsigned char history;
+    };
+    static const unsigned WORKING_SET_HISTORY = 8;
+    static const unsigned WORKING_SET_SLOTS = 32;
+    WorkingSetPage workingSet[WORKING_SET_SLOTS];
 #endif
 
 };
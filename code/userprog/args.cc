@@ -4,6 +4,7 @@
 
 
 #include "transfer.hh"
+#include "machine/endianness.hh"
 #include "machine/machine.hh"
 #include "threads/system.hh"
 
@@ -13,73 +14,74 @@
 static const unsigned MAX_ARG_COUNT  = 32;
 static const unsigned MAX_ARG_LENGTH = 128;
 
-/// Count the number of arguments up to a null (which is not counted).
+/// Read the pointers of the `argv`-like array at `address` into `pointers`,
+/// up to the null, a page of them at a time, so that no page past the one
+/// holding the null is touched.
 ///
-/// Returns true if the number fit in the established limits and false if
-/// too many arguments were provided.
-static inline
-bool CountArgsToSave(int address, unsigned *count)
+/// Returns the number of pointers, not counting the null, or -1 if there
+/// are too many.
+static int
+ReadArgPointers(int address, int *pointers)
 {
     ASSERT(address != 0);
-    ASSERT(count != nullptr);
+    ASSERT(pointers != nullptr);
 
-    int val;
     unsigned c = 0;
-    do {
-        if (!machine->ReadMem(address + 4 * c, 4, &val));
-#ifdef USE_TLB
-            ASSERT(machine->ReadMem(address + 4 * c, 4, &val));
-#else
-            ASSERT(false);
-#endif
-        c++;
-    } while (c < MAX_ARG_COUNT && val != 0);
-    if (c == MAX_ARG_COUNT && val != 0) {
-        // The maximum number of arguments was reached but the last is not
-        // null.
-        return false;
+    while (c < MAX_ARG_COUNT) {
+        unsigned inPage = (PAGE_SIZE - (address + 4 * c) % PAGE_SIZE) / 4;
+        unsigned n = inPage < MAX_ARG_COUNT - c ? inPage
+                                                : MAX_ARG_COUNT - c;
+        if (n == 0) {
+            n = 1;  // A misaligned pointer across pages.
+        }
+        ReadBufferFromUser(address + 4 * c, (char *) &pointers[c], 4 * n);
+        for (unsigned i = c; i < c + n; i++) {
+            pointers[i] = WordToHost(pointers[i]);
+            if (pointers[i] == 0) {
+                return i;
+            }
+        }
+        c += n;
     }
-
-    *count = c - 1;
-    return true;
+    return -1;
 }
 
+/// The array and the strings are kept in one block, the strings right
+/// after the pointers to them, so that they take one allocation and one
+/// copy each way.
 char **
 SaveArgs(int address)
 {
     ASSERT(address != 0);
 
-    unsigned count;
-    if (!CountArgsToSave(address, &count)) {
+    int pointers[MAX_ARG_COUNT];
+    int count = ReadArgPointers(address, pointers);
+    if (count == -1) {
         return nullptr;
     }
 
-    DEBUG('e', "Saving %u command line arguments from parent process.\n",
+    DEBUG('e', "Saving %d command line arguments from parent process.\n",
           count);
 
-    // Allocate an array of `count` pointers.  We know that `count` will
-    // always be at least 1.
-    char **args = new char * [count + 1];
-
-    for (unsigned i = 0; i < count; i++) {
-        args[i] = new char [MAX_ARG_LENGTH];
-        int strAddr;
-        // For each pointer, read the corresponding string.
-        machine->ReadMem(address + i * 4, 4, &strAddr);
-
-        if (!machine->ReadMem(address + i * 4, 4, &strAddr))
-#ifdef USE_TLB
-            ASSERT(machine->ReadMem(address + i * 4, 4, &strAddr));
-#else
-            ASSERT(false);
-#endif
-        ReadStringFromUser(strAddr, args[i], MAX_ARG_LENGTH);
+    unsigned arraySize = (count + 1) * sizeof (char *);
+    char *block = new char [arraySize + count * MAX_ARG_LENGTH];
+    char **args = (char **) block;
+    char *next = block + arraySize;
+    for (int i = 0; i < count; i++) {
+        args[i] = next;
+        // Longer strings are cut short.
+        if (!ReadStringFromUser(pointers[i], next, MAX_ARG_LENGTH)) {
+            next[MAX_ARG_LENGTH - 1] = '\0';
+        }
+        next += strlen(next) + 1;
     }
     args[count] = nullptr;  // Write the trailing null.
 
     return args;
 }
 
+/// The strings, the padding and `argv` are laid out in a kernel buffer
+/// first, just as they go on the stack, and copied there at once.
 unsigned
 WriteArgs(char **args)
 {
@@ -87,42 +89,35 @@ WriteArgs(char **args)
 
     DEBUG('e', "Writing command line arguments into child process.\n");
 
-    // Start writing the strings where the current SP points.  Write them in
-    // reverse order (i.e. the string from the first argument will be in a
-    // higher memory address than the string from the second argument).
-    int argsAddress[MAX_ARG_COUNT];
     unsigned c;
-    int sp = machine->ReadRegister(STACK_REG);
-    for (c = 0; c < MAX_ARG_COUNT; c++) {
-        if (args[c] == nullptr) {   // If the last was reached, terminate.
-            break;
-        }
-        sp -= strlen(args[c]) + 1;  // Decrease SP (leave one byte for \0).
-        WriteStringToUser(args[c], sp);  // Write the string there.
-        argsAddress[c] = sp;        // Save the argument's address.
-        delete args[c];             // Free the string.
+    unsigned stringsSize = 0;
+    for (c = 0; args[c] != nullptr; c++) {
+        stringsSize += strlen(args[c]) + 1;
     }
-    delete args;  // Free the array.
     ASSERT(c < MAX_ARG_COUNT);
 
-    sp -= sp % 4;     // Align the stack to a multiple of four.
+    // The strings go in reverse order (i.e. the string from the first
+    // argument will be in a higher memory address than the string from the
+    // second argument), below the current SP.
+    int top = machine->ReadRegister(STACK_REG);
+    int stringsAddr = top - stringsSize;
+    int sp = stringsAddr - stringsAddr % 4;  // Align to a multiple of four.
     sp -= c * 4 + 4;  // Make room for `argv`, including the trailing null.
-    // Write each argument's address.
+
+    unsigned size = top - sp;
+    char *image = new char [size];
+    memset(image, 0, size);  // The padding, and the last null of `argv`.
+    unsigned *argv = (unsigned *) image;
+    int argAddr = top;
     for (unsigned i = 0; i < c; i++) {
-        if (!machine->WriteMem(sp + 4 * i, 4, argsAddress[i]))
-#ifdef USE_TLB
-            ASSERT(machine->WriteMem(sp + 4 * i, 4, argsAddress[i]));
-#else
-            ASSERT(false);
-#endif
+        unsigned length = strlen(args[i]) + 1;
+        argAddr -= length;
+        memcpy(image + (argAddr - sp), args[i], length);
+        argv[i] = WordToMachine(argAddr);
     }
-
-    if (!machine->WriteMem(sp + 4 * c, 4, 0)) // The last is null.
-#ifdef USE_TLB
-        ASSERT(machine->WriteMem(sp + 4 * c, 4, 0));
-#else
-        ASSERT(false);
-#endif
+    WriteBufferToUser(image, sp, size);
+    delete [] image;
+    delete [] (char *) args;  // Strings and all.
 
     machine->WriteRegister(STACK_REG, sp);
     return c;
@@ -0,0 +1,276 @@
+/// Routines to serve asynchronous I/O rings.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "async_ring.hh"
+#include "file_description.hh"
+#include "syscall.h"
+#include "transfer.hh"
+#include "filesys/directory_entry.hh"
+#include "machine/endianness.hh"
+#include "threads/system.hh"
+
+
+/// Layout of an `IoRing` in user memory, where pointers are 32 bits wide,
+/// unlike the kernel's: every field is a word.
+static const unsigned REQUEST_WORDS    = 5;
+static const unsigned COMPLETION_WORDS = 2;
+static const unsigned SUBMIT_HEAD   = 0;
+static const unsigned SUBMIT_TAIL   = 4;
+static const unsigned REQUESTS      = 8;
+static const unsigned COMPLETE_HEAD = REQUESTS
+                                      + IO_RING_SIZE * REQUEST_WORDS * 4;
+static const unsigned COMPLETE_TAIL = COMPLETE_HEAD + 4;
+static const unsigned COMPLETIONS   = COMPLETE_HEAD + 8;
+static const unsigned RING_BYTES    = COMPLETIONS
+                                      + IO_RING_SIZE * COMPLETION_WORDS * 4;
+
+/// Return whether the `size` bytes at `addr` lie in pages the current
+/// thread may touch, or write to if `writing`.
+static bool
+IsValidRange(int addr, int size, bool writing)
+{
+    if (addr <= 0 || size <= 0 || addr + size < addr) {
+        return false;
+    }
+    AddressSpace *space = currentThread->space;
+    for (unsigned vpn = addr / PAGE_SIZE;
+         vpn <= (unsigned) (addr + size - 1) / PAGE_SIZE; vpn++) {
+        if (writing ? !space->IsWritablePage(vpn)
+                    : !space->IsValidPage(vpn)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Functions for `TransferUser`, moving data as it is between user memory
+/// and an open file.
+
+static unsigned
+ReadChunk(char *chunk, unsigned count, void *file)
+{
+    int read = ((OpenFile *) file)->Read(chunk, count);
+    return read > 0 ? read : 0;
+}
+
+static unsigned
+WriteChunk(char *chunk, unsigned count, void *file)
+{
+    int written = ((OpenFile *) file)->Write(chunk, count);
+    return written > 0 ? written : 0;
+}
+
+bool
+AsyncRing::IsValidRing(int ringAddr)
+{
+    return IsValidRange(ringAddr, RING_BYTES, true);
+}
+
+/// Workers are kernel threads given the space and the open file table of
+/// the current thread, which outlive them: the destructor waits for them.
+/// They run at its priority, so that they neither starve it nor are
+/// starved by it.
+AsyncRing::AsyncRing(int addr)
+{
+    ringAddr = addr;
+    lock     = new Lock("io ring");
+    work     = new Condition("io ring work", lock);
+    done     = new Condition("io ring done", lock);
+    stopped  = new Semaphore("io ring stopped", 0);
+    taken    = ReadWord(SUBMIT_HEAD);
+    posted   = ReadWord(COMPLETE_TAIL);
+    inFlight = 0;
+    stopping = false;
+
+    for (unsigned i = 0; i < NUM_WORKERS; i++) {
+        Thread *t = new Thread("io worker", false,
+                               currentThread->GetPriority());
+        delete t->openFiles;
+        t->openFiles = currentThread->openFiles;
+        t->space     = currentThread->space;
+        t->Fork(WorkerHelper, this);
+    }
+}
+
+AsyncRing::~AsyncRing()
+{
+    lock->Acquire();
+    stopping = true;
+    work->Broadcast();
+    lock->Release();
+
+    for (unsigned i = 0; i < NUM_WORKERS; i++) {
+        stopped->P();
+    }
+    delete stopped;
+    delete done;
+    delete work;
+    delete lock;
+}
+
+unsigned
+AsyncRing::Enter(unsigned minComplete)
+{
+    if (minComplete > IO_RING_SIZE) {
+        minComplete = IO_RING_SIZE;
+    }
+
+    lock->Acquire();
+    work->Broadcast();
+    unsigned ready = CountReady();
+    while (ready < minComplete && (inFlight > 0 || CanTake())) {
+        done->Wait();
+        ready = CountReady();
+    }
+    lock->Release();
+    return ready;
+}
+
+void
+AsyncRing::WorkerHelper(void *ring)
+{
+    ASSERT(ring != nullptr);
+    ((AsyncRing *) ring)->Work();
+}
+
+/// Requests are taken in order, but may complete out of order: a worker
+/// does not hold the lock while carrying one out.
+void
+AsyncRing::Work()
+{
+    lock->Acquire();
+    for (;;) {
+        while (!stopping && !CanTake()) {
+            work->Wait();
+        }
+        if (stopping) {
+            break;
+        }
+
+        int request[REQUEST_WORDS];
+        unsigned offset = REQUESTS
+                          + taken % IO_RING_SIZE * sizeof request;
+        ReadBufferFromUser(ringAddr + offset, (char *) request,
+                           sizeof request);
+        WriteWord(SUBMIT_HEAD, ++taken);
+        inFlight++;
+        lock->Release();
+
+        int result = Perform(WordToHost(request[0]), WordToHost(request[1]),
+                             WordToHost(request[2]), WordToHost(request[3]));
+
+        lock->Acquire();
+        int completion[COMPLETION_WORDS] = {
+            request[4], (int) WordToMachine((unsigned) result)
+        };
+        offset = COMPLETIONS + posted % IO_RING_SIZE * sizeof completion;
+        WriteBufferToUser((char *) completion, ringAddr + offset,
+                          sizeof completion);
+        WriteWord(COMPLETE_TAIL, ++posted);
+        inFlight--;
+        done->Broadcast();
+    }
+    lock->Release();
+
+    // What the worker was lent is not its own to free.
+    currentThread->openFiles = nullptr;
+    currentThread->space = nullptr;
+    stopped->V();
+}
+
+int
+AsyncRing::Perform(int op, int id, int bufferAddr, int size)
+{
+    if (op == IO_OP_OPEN) {
+        char name[FILE_NAME_MAX_LEN + 1];
+        if (!IsValidRange(bufferAddr, 1, false)
+              || !ReadStringFromUser(bufferAddr, name, sizeof name)) {
+            DEBUG('e', "Error: bad file name in ring request.\n");
+            return -1;
+        }
+        OpenFile *file = fileSystem->Open(name);
+        if (file == nullptr) {
+            DEBUG('e', "Error: file %s not found.\n", name);
+            return -1;
+        }
+        FileDescription *description = new FileDescription(file);
+        int fid = currentThread->openFiles->Add(description);
+        if (fid == -1) {
+            description->Release(currentThread->space);
+            return -1;
+        }
+        DEBUG('e', "Ring opened file %s with id %d.\n", name, fid + 2);
+        return fid + 2;
+    }
+
+    bool reading = op == IO_OP_READ;
+    if (!reading && op != IO_OP_WRITE) {
+        DEBUG('e', "Error: unknown ring operation %d.\n", op);
+        return -1;
+    }
+    FileDescription *description = FindOpenFile(id);
+    if (description == nullptr) {
+        DEBUG('e', "Error: file with id %d is not open.\n", id);
+        return -1;
+    }
+    // A bad buffer would end the worker rather than the program: check it
+    // fully beforehand.
+    if (!IsValidRange(bufferAddr, size, reading)) {
+        DEBUG('e', "Error: bad buffer in ring request.\n");
+        return -1;
+    }
+
+    DEBUG('e', "Ring %s %d bytes, file %d.\n",
+          reading ? "reading" : "writing", size, id);
+    return TransferUser(bufferAddr, size, reading,
+                        reading ? ReadChunk : WriteChunk,
+                        description->GetFile());
+}
+
+unsigned
+AsyncRing::ReadWord(unsigned offset) const
+{
+    unsigned word;
+    ReadBufferFromUser(ringAddr + offset, (char *) &word, sizeof word);
+    return WordToHost(word);
+}
+
+void
+AsyncRing::WriteWord(unsigned offset, unsigned value) const
+{
+    unsigned word = WordToMachine(value);
+    WriteBufferToUser((char *) &word, ringAddr + offset, sizeof word);
+}
+
+/// A program queueing more than the ring holds is ignored until it puts
+/// `submitTail` right.
+unsigned
+AsyncRing::CountQueued() const
+{
+    unsigned queued = ReadWord(SUBMIT_TAIL) - taken;
+    if (queued > IO_RING_SIZE) {
+        DEBUG('e', "Error: %u requests queued in ring.\n", queued);
+        return 0;
+    }
+    return queued;
+}
+
+/// Likewise with a `completeHead` past `completeTail`.
+unsigned
+AsyncRing::CountReady() const
+{
+    unsigned ready = posted - ReadWord(COMPLETE_HEAD);
+    return ready <= IO_RING_SIZE ? ready : 0;
+}
+
+/// Every request taken is promised a completion slot.
+bool
+AsyncRing::CanTake() const
+{
+    unsigned pending = posted + inFlight - ReadWord(COMPLETE_HEAD);
+    return CountQueued() > 0 && pending < IO_RING_SIZE;
+}
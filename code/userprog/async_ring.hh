@@ -0,0 +1,92 @@
+/// Asynchronous I/O through rings in user memory.
+///
+/// A program sets up an `IoRing` in its own memory with `IoRingSetup`, and
+/// queues requests in its submission ring without any system call.  A few
+/// kernel threads, the workers of the ring, take the requests in order,
+/// carry them out, and post their results to the completion ring, where
+/// the program picks them up, again without a system call.  `IoRingEnter`
+/// is only needed to wake the workers and wait for results.
+///
+/// Workers run in the address space of the program, so that they reach
+/// its memory as system calls do, and use the open files of the thread
+/// that set the ring up.  There are several of them, so that a request
+/// waiting for the disk does not hold back those after it.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_ASYNCRING__HH
+#define NACHOS_USERPROG_ASYNCRING__HH
+
+
+#include "threads/condition.hh"
+
+
+class AsyncRing {
+public:
+
+    /// Threads serving each ring.
+    static const unsigned NUM_WORKERS = 2;
+
+    /// Return whether an `IoRing` at `ringAddr` would lie in writable
+    /// memory of the current thread's address space.
+    static bool IsValidRing(int ringAddr);
+
+    /// Start serving the ring at `addr` for the current thread.
+    AsyncRing(int addr);
+
+    /// Stop the workers, each once done with the request it took, if any.
+    /// Called by the thread that set the ring up, which waits for them.
+    ~AsyncRing();
+
+    /// Wake the workers for the requests queued, and wait until there are
+    /// `minComplete` completions to read, or nothing more is to complete.
+    /// Return the completions there are to read.
+    unsigned Enter(unsigned minComplete);
+
+private:
+
+    static void WorkerHelper(void *ring);
+
+    /// Take requests and carry them out, until stopped.
+    void Work();
+
+    /// Carry out a request, and return its result.
+    int Perform(int op, int id, int bufferAddr, int size);
+
+    /// Words of the ring in user memory, by byte offset.
+    unsigned ReadWord(unsigned offset) const;
+    void WriteWord(unsigned offset, unsigned value) const;
+
+    /// Number of requests queued and not taken yet, number of completions
+    /// not read yet, and whether the next request can be taken.  Called
+    /// with `lock` held.
+    unsigned CountQueued() const;
+    unsigned CountReady() const;
+    bool CanTake() const;
+
+    int ringAddr;
+
+    /// Held while looking at the ring.  Workers wait for requests on
+    /// `work`, and `Enter` for completions on `done`.
+    Lock *lock;
+    Condition *work;
+    Condition *done;
+
+    /// Signalled by each worker as it stops.
+    Semaphore *stopped;
+
+    /// The kernel's own `submitHead` and `completeTail`: what the program
+    /// writes there is not to be trusted.
+    unsigned taken;
+    unsigned posted;
+
+    /// Requests taken and not completed yet.
+    unsigned inFlight;
+
+    bool stopping;
+};
+
+
+#endif
@@ -0,0 +1,148 @@
+/// Routines to save a user process to a file, and to resume it from there.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "checkpoint.hh"
+#include "address_space.hh"
+#include "transfer.hh"
+#include "bin/noff.h"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+static const unsigned CHECKPOINT_MAGIC = 0x43484B50;
+
+/// What follows the memory image in a checkpoint.
+struct RawRegisters {
+    unsigned magic;  ///< Should be `CHECKPOINT_MAGIC`.
+    int registers[NUM_TOTAL_REGS];
+};
+
+/// Where the memory image is being written.
+struct ImageWriter {
+    OpenFile *file;
+    unsigned position;
+};
+
+/// Write a piece of the memory image straight from the frame holding it.
+static unsigned
+WriteChunk(char *chunk, unsigned count, void *arg)
+{
+    ASSERT(chunk != nullptr);
+    ASSERT(arg != nullptr);
+
+    ImageWriter *w = (ImageWriter *) arg;
+    if (w->file->WriteAt(chunk, count, w->position) != (int) count) {
+        return 0;
+    }
+    w->position += count;
+    return count;
+}
+
+bool
+TakeCheckpoint(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    AddressSpace *space = currentThread->space;
+    ASSERT(space != nullptr);
+    unsigned size = space->GetNumPages() * PAGE_SIZE;
+
+    noffHeader header;
+    memset(&header, 0, sizeof header);
+    header.noffMagic           = NOFF_MAGIC;
+    header.initData.inFileAddr = sizeof header;
+    header.initData.size       = size;
+
+    // The registers after the system call returns 1: see `IncrementPC`.
+    RawRegisters raw;
+    raw.magic = CHECKPOINT_MAGIC;
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        raw.registers[i] = machine->ReadRegister(i);
+    }
+    raw.registers[2]           = 1;
+    raw.registers[PREV_PC_REG] = raw.registers[PC_REG];
+    raw.registers[PC_REG]      = raw.registers[NEXT_PC_REG];
+    raw.registers[NEXT_PC_REG] = raw.registers[PC_REG] + 4;
+
+    if (!fileSystem->Create(name, 0)) {
+        return false;
+    }
+    OpenFile *file = fileSystem->Open(name);
+    if (file == nullptr) {
+        return false;
+    }
+
+    ImageWriter w = { file, sizeof header };
+    bool success
+      = file->WriteAt((const char *) &header, sizeof header, 0)
+          == (int) sizeof header
+        && TransferUser(0, size, false, WriteChunk, &w) == size
+        && file->WriteAt((const char *) &raw, sizeof raw, w.position)
+             == (int) sizeof raw;
+    DEBUG('a', "Checkpoint of %u bytes written to `%s`: %s\n",
+          size, name, success ? "done" : "failed");
+
+#ifdef FILESYS
+    file->Sync();
+    synchDisk->Flush();
+#endif
+    delete file;
+    return success;
+}
+
+void
+RestoreProcess(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    OpenFile *file = fileSystem->Open(name);
+    if (file == nullptr) {
+        printf("Unable to open file %s\n", name);
+        return;
+    }
+
+    noffHeader header;
+    RawRegisters raw;
+    if (file->ReadAt((char *) &header, sizeof header, 0)
+            != (int) sizeof header
+          || header.noffMagic != NOFF_MAGIC
+          || file->ReadAt((char *) &raw, sizeof raw,
+                          header.initData.inFileAddr + header.initData.size)
+               != (int) sizeof raw
+          || raw.magic != CHECKPOINT_MAGIC) {
+        printf("File %s is not a checkpoint\n", name);
+        delete file;
+        return;
+    }
+
+    // No name: the image is all data, so there is no code to share.
+    AddressSpace *space = new AddressSpace(file);
+    if (!space->IsReady()) {
+        printf("Unable to set up the address space of %s\n", name);
+        delete space;
+#ifndef DEMAND_LOADING
+        delete file;
+#endif
+        return;
+    }
+    currentThread->space = space;
+
+#ifndef DEMAND_LOADING
+    delete file;
+#endif
+
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, raw.registers[i]);
+    }
+    space->RestoreState();
+    space->UpdateInfoPage();
+
+    machine->Run();
+    ASSERT(false);  // The process exits by doing the system call `Exit`.
+}
@@ -0,0 +1,32 @@
+/// Routines to save a user process to a file, and to resume it from there.
+///
+/// A checkpoint is a NOFF executable whose only segment is initialized
+/// data.  That segment holds the whole memory of the process at virtual
+/// address 0, code and stack included.  The registers follow it.  This
+/// way the ordinary loader brings the memory back, with demand loading and
+/// swapping alike, and only the registers need special handling.
+///
+/// Repeated benchmarks can then take a checkpoint once their warm-up is
+/// done, and start every further run from it.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_CHECKPOINT__HH
+#define NACHOS_USERPROG_CHECKPOINT__HH
+
+
+/// Save the current process to the file `name`.  The saved registers are
+/// those the process has once its `Checkpoint` system call returns, with 1
+/// as the result.  With the real file system, everything modified in the
+/// disk cache is written back first, so that the disk matches the
+/// checkpoint.  Return false if the file cannot be written.
+bool TakeCheckpoint(const char *name);
+
+/// Resume the process saved in the file `name`, in the current thread.
+/// Only returns if the file is not a checkpoint.
+void RestoreProcess(const char *name);
+
+
+#endif
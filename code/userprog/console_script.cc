@@ -0,0 +1,308 @@
+/// Routines to type scripted sessions at the console, and to time how the
+/// console answers them.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "console_script.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+LatencySamples::LatencySamples()
+{
+    ticks = nullptr;
+    count = 0;
+    size  = 0;
+}
+
+LatencySamples::~LatencySamples()
+{
+    delete [] ticks;
+}
+
+void
+LatencySamples::Add(unsigned long t)
+{
+    if (count == size) {
+        size = size == 0 ? 64 : 2 * size;
+        unsigned long *bigger = new unsigned long [size];
+        if (count > 0) {
+            memcpy(bigger, ticks, count * sizeof *ticks);
+        }
+        delete [] ticks;
+        ticks = bigger;
+    }
+    ticks[count++] = t;
+}
+
+static int
+CompareTicks(const void *a, const void *b)
+{
+    unsigned long x = *(const unsigned long *) a;
+    unsigned long y = *(const unsigned long *) b;
+    return x < y ? -1 : x > y;
+}
+
+void
+LatencySamples::Print(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    printf("consolebench latency=%s samples=%u", name, count);
+    if (count > 0) {
+        qsort(ticks, count, sizeof *ticks, CompareTicks);
+        printf(" ticks_min=%lu ticks_p50=%lu ticks_p90=%lu ticks_p99=%lu "
+               "ticks_max=%lu", ticks[0], ticks[count / 2],
+               ticks[count * 9 / 10], ticks[count * 99 / 100],
+               ticks[count - 1]);
+    }
+    printf("\n");
+}
+
+/// Replace every `\s` in `text` by a blank.
+static void
+UnescapeBlanks(char *text)
+{
+    ASSERT(text != nullptr);
+
+    char *to = text;
+    for (const char *from = text; *from != '\0'; from++) {
+        if (from[0] == '\\' && from[1] == 's') {
+            *to++ = ' ';
+            from++;
+        } else {
+            *to++ = *from;
+        }
+    }
+    *to = '\0';
+}
+
+ConsoleScript::ConsoleScript(const char *fileName)
+{
+    ASSERT(fileName != nullptr);
+
+    console  = nullptr;
+    first    = nullptr;
+    keyTicks = DEFAULT_KEY_TICKS;
+    prompt   = nullptr;
+    promptLength = 0;
+
+    FILE *f = fopen(fileName, "r");
+    if (f == nullptr) {
+        fprintf(stderr, "Could not open the console script %s.\n",
+                fileName);
+        exit(1);
+    }
+
+    ScriptLine **link = &first;
+    char buffer[MAX_LINE];
+    for (unsigned n = 1; fgets(buffer, sizeof buffer, f); n++) {
+        char *newline = strchr(buffer, '\n');
+        if (newline != nullptr) {
+            *newline = '\0';
+        }
+        if (buffer[0] == '\0' || buffer[0] == '#') {
+            continue;
+        }
+
+        char *end;
+        bool ok;
+        if (!strncmp(buffer, "prompt ", 7)) {
+            delete [] prompt;
+            prompt = new char [strlen(buffer + 7) + 1];
+            strcpy(prompt, buffer + 7);
+            UnescapeBlanks(prompt);
+            promptLength = strlen(prompt);
+            ok = promptLength > 0;
+        } else if (!strncmp(buffer, "keys ", 5)) {
+            keyTicks = strtoul(buffer + 5, &end, 10);
+            ok = end != buffer + 5 && *end == '\0';
+        } else {
+            unsigned long think = strtoul(buffer, &end, 10);
+            ok = end != buffer && (*end == ' ' || *end == '\0');
+            if (ok) {
+                const char *text = *end == ' ' ? end + 1 : end;
+                ScriptLine *l = new ScriptLine;
+                l->think = think;
+                l->text  = new char [strlen(text) + 2];
+                strcpy(l->text, text);
+                strcat(l->text, "\n");
+                l->next  = nullptr;
+                *link = l;
+                link = &l->next;
+            }
+        }
+        if (!ok) {
+            fprintf(stderr, "Console script %s, line %u: expected "
+                    "`<think> <text>`, `keys <ticks>` or `prompt <text>`.\n",
+                    fileName, n);
+            exit(1);
+        }
+    }
+    fclose(f);
+
+    line     = first;
+    position = 0;
+    started  = false;
+    due      = 0;
+    waiting  = prompt != nullptr;
+    promptSeen     = 0;
+    pendingStart   = 0;
+    pendingCount   = 0;
+    commandPending = false;
+    commandArrived = 0;
+}
+
+ConsoleScript::~ConsoleScript()
+{
+    while (first != nullptr) {
+        ScriptLine *l = first;
+        first = l->next;
+        delete [] l->text;
+        delete l;
+    }
+    delete [] prompt;
+}
+
+/// The script starts with the first console it is typed at.
+void
+ConsoleScript::Attach(Console *console_)
+{
+    ASSERT(console_ != nullptr);
+
+    console = console_;
+    if (!started) {
+        started = true;
+        if (!waiting && line != nullptr) {
+            StartLine(stats->totalTicks);
+        }
+    }
+}
+
+void
+ConsoleScript::Detach(Console *console_)
+{
+    if (console == console_) {
+        console = nullptr;
+    }
+}
+
+bool
+ConsoleScript::IsAttached(const Console *console_) const
+{
+    return console_ != nullptr && console == console_;
+}
+
+void
+ConsoleScript::StartLine(unsigned long from)
+{
+    ASSERT(line != nullptr);
+
+    due = from + line->think;
+}
+
+/// Without a prompt, the next line is thought about from when the last key
+/// of this one was due, whether the console read it then or not, so that
+/// a slow console does not slow the typist down.
+int
+ConsoleScript::Type(char *buffer, unsigned size)
+{
+    ASSERT(buffer != nullptr);
+    ASSERT(size > 0);
+
+    if (line == nullptr) {
+        return commandPending ? -1 : 0;
+    }
+
+    unsigned long now = stats->totalTicks;
+    unsigned n = 0;
+    while (n < size && line != nullptr && !waiting && due <= now) {
+        char c = line->text[position++];
+        buffer[n++] = c;
+
+        if (pendingCount == MAX_PENDING) {  // Forget the oldest.
+            pendingStart = (pendingStart + 1) % MAX_PENDING;
+            pendingCount--;
+        }
+        unsigned i = (pendingStart + pendingCount++) % MAX_PENDING;
+        pending[i] = c;
+        arrived[i] = now;
+
+        if (line->text[position] != '\0') {
+            due += keyTicks;
+            continue;
+        }
+        line = line->next;
+        position = 0;
+        if (prompt != nullptr) {
+            commandPending = true;
+            commandArrived = now;
+            waiting = true;
+        } else if (line != nullptr) {
+            StartLine(due);
+        }
+    }
+    return n > 0 ? (int) n : -1;
+}
+
+/// Characters typed and never echoed are forgotten at the prompt answering
+/// them, so that those of a program that does not echo are not matched
+/// against what it prints later.
+void
+ConsoleScript::PromptSeen()
+{
+    unsigned long now = stats->totalTicks;
+    if (commandPending) {
+        responses.Add(now - commandArrived);
+        commandPending = false;
+        pendingCount = 0;
+    }
+    if (waiting) {
+        waiting = false;
+        if (line != nullptr) {
+            StartLine(now);
+        }
+    }
+}
+
+void
+ConsoleScript::Output(const char *chars, unsigned count)
+{
+    ASSERT(chars != nullptr);
+
+    unsigned long now = stats->totalTicks;
+    for (unsigned i = 0; i < count; i++) {
+        char c = chars[i];
+        if (pendingCount > 0 && pending[pendingStart] == c) {
+            echoes.Add(now - arrived[pendingStart]);
+            pendingStart = (pendingStart + 1) % MAX_PENDING;
+            pendingCount--;
+        }
+
+        if (prompt == nullptr) {
+            continue;
+        }
+        if (c == prompt[promptSeen]) {
+            promptSeen++;
+        } else {
+            promptSeen = c == prompt[0] ? 1 : 0;
+        }
+        if (promptSeen == promptLength) {
+            promptSeen = 0;
+            PromptSeen();
+        }
+    }
+}
+
+void
+ConsoleScript::Print()
+{
+    echoes.Print("echo");
+    responses.Print("response");
+}
@@ -0,0 +1,153 @@
+/// Data structures to type scripted sessions at the console, and to time
+/// how the console answers them.
+///
+/// A console script stands in for the person at the keyboard.  It has one
+/// line of input per line:
+///
+///     <think> <text>
+///
+/// `text` is typed, followed by a newline, a key every `keys` ticks, once
+/// `think` ticks went by since the line before was typed; the first line
+/// counts from when the script starts.  Lines starting with `#`, and empty
+/// ones, are skipped.  Two more lines set up the session:
+///
+///     keys <ticks>
+///     prompt <text>
+///
+/// With a prompt, the typist waits for the program to print it before
+/// thinking about the next line, the first line included, as a person at a
+/// shell does; without one, lines are typed on time whatever the program
+/// does.  The prompt is the rest of the line after the blank following
+/// `prompt`, where `\s` stands for a blank, so that one at the end shows:
+/// the prompt of the shell is written `-->\s`.
+///
+/// Two latencies are measured, from the tick each character arrives, when
+/// the console reads it, to the tick the program puts its answer:
+///
+/// * *echo*: to the output of the same character, when it is the oldest
+///   typed and not yet output; a program that does not echo hardly ever
+///   gives any.
+/// * *response*: from the newline ending a line to the next prompt, which
+///   is how long a command takes to run, seen from the keyboard.
+///
+/// When Nachos halts, the percentiles of both are printed.  The script is
+/// typed at the console made last, so that `-tc` takes it from the console
+/// of the kernel.  The input log records what is typed, as it does with the
+/// host keyboard.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_CONSOLESCRIPT__HH
+#define NACHOS_USERPROG_CONSOLESCRIPT__HH
+
+
+class Console;
+
+/// Latencies taken, in ticks.
+class LatencySamples {
+public:
+
+    LatencySamples();
+
+    ~LatencySamples();
+
+    void Add(unsigned long ticks);
+
+    /// Print a line of `key=value` pairs with the percentiles of the
+    /// samples, named `name`.
+    void Print(const char *name);
+
+private:
+
+    unsigned long *ticks;
+    unsigned count;
+    unsigned size;
+};
+
+class ConsoleScript {
+public:
+
+    /// Ticks between keys, unless the script says otherwise.
+    static const unsigned long DEFAULT_KEY_TICKS = 1000;
+
+    /// Read the script in the UNIX file `fileName`.  Abort if it cannot be
+    /// read, or a line is wrong.
+    ConsoleScript(const char *fileName);
+
+    ~ConsoleScript();
+
+    /// Type at `console` from now on, rather than at any made before it.
+    void Attach(Console *console);
+
+    /// Stop typing at `console`, if it was typed at.
+    void Detach(Console *console);
+
+    /// Return whether the script is typed at `console`.
+    bool IsAttached(const Console *console) const;
+
+    /// Copy into `buffer`, which has room for `size` characters, those
+    /// typed by now and not yet read, and return how many; return -1 if
+    /// none are, and 0 once the script is over.
+    int Type(char *buffer, unsigned size);
+
+    /// Take note of the `count` characters at `chars` put at the console.
+    void Output(const char *chars, unsigned count);
+
+    /// Print the latencies measured so far.
+    void Print();
+
+private:
+
+    /// Longest line of a script.
+    static const unsigned MAX_LINE = 256;
+
+    /// Most characters typed and not yet echoed that are remembered.
+    static const unsigned MAX_PENDING = 256;
+
+    /// A line to type.
+    struct ScriptLine {
+        unsigned long think;
+        char *text;  ///< Newline included.
+        ScriptLine *next;
+    };
+
+    /// Make the first key of `line` due its think time after `from`.
+    void StartLine(unsigned long from);
+
+    /// The prompt was put: the line sent was answered.
+    void PromptSeen();
+
+    Console *console;
+
+    ScriptLine *first;
+    ScriptLine *line;    ///< The line being typed, or null at the end.
+    unsigned position;   ///< Next character of it.
+    unsigned long keyTicks;
+    char *prompt;
+    unsigned promptLength;
+
+    bool started;
+    unsigned long due;   ///< When the next key is due.
+    bool waiting;        ///< Whether the typist waits for the prompt.
+    unsigned promptSeen; ///< Characters of the prompt matched so far.
+
+    /// Characters read and not yet echoed, oldest first, and when each
+    /// arrived.
+    char pending[MAX_PENDING];
+    unsigned long arrived[MAX_PENDING];
+    unsigned pendingStart;
+    unsigned pendingCount;
+
+    /// Whether a line was sent and its prompt not yet seen, and when its
+    /// newline arrived.
+    bool commandPending;
+    unsigned long commandArrived;
+
+    LatencySamples echoes;
+    LatencySamples responses;
+};
+
+
+#endif
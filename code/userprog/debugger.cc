@@ -4,6 +4,7 @@
 
 
 #include "debugger.hh"
+#include "symbol_table.hh"
 #include "lib/utility.hh"
 #include "machine/interrupt.hh"
 #include "machine/statistics.hh"
@@ -71,6 +72,22 @@ PrintGPRegister(const int *registers, unsigned i)
     }
 }
 
+/// Print the procedure `address` lies in, if the program has symbols.
+static void
+PrintProcedure(uint32_t address)
+{
+    if (currentThread->space == nullptr) {
+        return;
+    }
+    const SymbolTable *symbols = currentThread->space->GetSymbols();
+    uint32_t offset;
+    const char *name = symbols == nullptr
+                       ? nullptr : symbols->Lookup(address, &offset);
+    if (name != nullptr) {
+        printf("\tIn:\t%s+0x%X\n", name, (unsigned) offset);
+    }
+}
+
 /// Print the user program's CPU state.  We might print the contents of
 /// memory, but that seemed like overkill.
 static inline void
@@ -105,6 +122,7 @@ DumpMachineState(int *previousRegisters)
     printf("\tPC:\t0x%X",       registers[PC_REG]);
     printf("\tNextPC:\t0x%X",   registers[NEXT_PC_REG]);
     printf("\tPrevPC:\t0x%X\n", registers[PREV_PC_REG]);
+    PrintProcedure(registers[PC_REG]);
     printf("\tLoad:\t0x%X",     registers[LOAD_REG]);
     printf("\tLoadV:\t0x%X\n",  registers[LOAD_VALUE_REG]);
     printf("\n");
@@ -112,12 +130,79 @@ DumpMachineState(int *previousRegisters)
     memcpy(previousRegisters, registers, NUM_TOTAL_REGS * sizeof (int));
 }
 
+/// Parse `arg` as an address, in decimal, hexadecimal or octal.  Return
+/// false, with an error message, if it is not one.
+static bool
+ParseAddress(const char *arg, unsigned *address)
+{
+    ASSERT(address != nullptr);
+
+    if (arg == nullptr) {
+        fprintf(stderr, "ERROR: missing argument.\n");
+        return false;
+    }
+
+    char *end;
+    *address = strtoul(arg, &end, 0);
+    if (*end != '\0') {
+        fprintf(stderr, "ERROR: argument `%s` is not an address.\n", arg);
+        return false;
+    }
+    return true;
+}
+
+/// Without an argument, list the breakpoints set.
+static DCM::RunResult
+CommandBreak(char **args, void *extra)
+{
+    const char *arg = DCM::FetchArg(args);
+    if (arg == nullptr) {
+        unsigned n = machine->GetNumBreakpoints();
+        if (n == 0) {
+            printf("No breakpoints.\n");
+        }
+        for (unsigned i = 0; i < n; i++) {
+            printf("Breakpoint at 0x%X.\n", machine->GetBreakpoint(i));
+        }
+        return DCM::RUN_RESULT_STAY;
+    }
+
+    unsigned address;
+    if (!ParseAddress(arg, &address)) {
+        return DCM::RUN_RESULT_STAY;
+    }
+    if (address % 4 != 0) {
+        fprintf(stderr, "ERROR: address 0x%X is not aligned.\n", address);
+    } else if (!machine->SetBreakpoint(address)) {
+        fprintf(stderr, "ERROR: no more than %u breakpoints can be set.\n",
+                Machine::MAX_BREAKPOINTS);
+    } else {
+        printf("Breakpoint set at 0x%X.\n", address);
+    }
+    return DCM::RUN_RESULT_STAY;
+}
+
 static DCM::RunResult
 CommandContinue(char **args, void *extra)
 {
     return DCM::RUN_RESULT_NORMALIZE;
 }
 
+static DCM::RunResult
+CommandDelete(char **args, void *extra)
+{
+    unsigned address;
+    if (!ParseAddress(DCM::FetchArg(args), &address)) {
+        return DCM::RUN_RESULT_STAY;
+    }
+    if (machine->ClearBreakpoint(address)) {
+        printf("Breakpoint at 0x%X deleted.\n", address);
+    } else {
+        fprintf(stderr, "ERROR: no breakpoint at 0x%X.\n", address);
+    }
+    return DCM::RUN_RESULT_STAY;
+}
+
 static DCM::RunResult
 CommandDump(char **args, void *extra)
 {
@@ -133,8 +218,9 @@ CommandDump(char **args, void *extra)
         return DCM::RUN_RESULT_STAY;
     }
 
-    int rv = fwrite(machine->GetMMU()->mainMemory, 1, MEMORY_SIZE, f);
-    if (rv != MEMORY_SIZE) {
+    unsigned size = numPhysPages * PAGE_SIZE;
+    unsigned rv = fwrite(machine->GetMMU()->mainMemory, 1, size, f);
+    if (rv != size) {
         fprintf(stderr, "ERROR: write to file `%s` did not succeed.\n",
                 path);
         return DCM::RUN_RESULT_STAY;
@@ -162,7 +248,11 @@ CommandHelp(char **args, void *extra)
 {
     printf("\
 Debugger commands:\n\
-    continue, c             Run until completion.\n\
+    break, b [<address>]    Stop before running the instruction at a\n\
+                            virtual address, or list the breakpoints.\n\
+    continue, c             Run until a breakpoint or watchpoint, or until\n\
+                            completion.\n\
+    delete, d <address>     Delete a breakpoint.\n\
     dump <path>             Dump the simulated machine's main memory into\n\
                             a file.\n\
     flags, f                Show current flags for debug output.\n\
@@ -176,7 +266,13 @@ Debugger commands:\n\
                             (with the prefix `0`).\n\
     step, s, <return>       Execute one instruction.\n\
     setflags, setf <flags>  Set flags for debug output.\n\
-    tick, t <number>        Run for a number of timer ticks.\n\
+    tick, t <number>        Run for a number of timer ticks, or until a\n\
+                            breakpoint or watchpoint.\n\
+    unwatch, u <address>    Delete a watchpoint.\n\
+    watch, w [<address> [<size>]]\n\
+                            Stop after writing to the bytes at a virtual\n\
+                            address (4 of them by default), or list the\n\
+                            watchpoints.\n\
     quit, q                 Exit.\n\n");
     return DCM::RUN_RESULT_STAY;
 }
@@ -213,7 +309,7 @@ CommandPrint(char **args, void *extra)
             }
 
         } else if (strcmp(end, "@p") == 0) {
-            if (address >= MEMORY_SIZE) {
+            if (address >= numPhysPages * PAGE_SIZE) {
                 fprintf(stderr, "ERROR: address %u is too big.\n", address);
                 return DCM::RUN_RESULT_STAY;
             }
@@ -285,6 +381,62 @@ CommandTick(char **args, void *runUntilTime_)
     return DCM::RUN_RESULT_STEP;
 }
 
+static DCM::RunResult
+CommandUnwatch(char **args, void *extra)
+{
+    unsigned address;
+    if (!ParseAddress(DCM::FetchArg(args), &address)) {
+        return DCM::RUN_RESULT_STAY;
+    }
+    if (machine->ClearWatchpoint(address)) {
+        printf("Watchpoint at 0x%X deleted.\n", address);
+    } else {
+        fprintf(stderr, "ERROR: no watchpoint at 0x%X.\n", address);
+    }
+    return DCM::RUN_RESULT_STAY;
+}
+
+/// Without an argument, list the watchpoints set.
+static DCM::RunResult
+CommandWatch(char **args, void *extra)
+{
+    const char *arg = DCM::FetchArg(args);
+    if (arg == nullptr) {
+        const MMU *mmu = machine->GetMMU();
+        unsigned n = mmu->GetNumWatchpoints();
+        if (n == 0) {
+            printf("No watchpoints.\n");
+        }
+        for (unsigned i = 0; i < n; i++) {
+            unsigned address, size;
+            mmu->GetWatchpoint(i, &address, &size);
+            printf("Watchpoint at 0x%X, %u bytes.\n", address, size);
+        }
+        return DCM::RUN_RESULT_STAY;
+    }
+
+    unsigned address, size = 4;
+    if (!ParseAddress(arg, &address)) {
+        return DCM::RUN_RESULT_STAY;
+    }
+    const char *size_s = DCM::FetchArg(args);
+    if (size_s != nullptr) {
+        char *end;
+        size = strtoul(size_s, &end, 0);
+        if (*end != '\0' || size == 0) {
+            fprintf(stderr, "ERROR: argument `%s` is not a size.\n", size_s);
+            return DCM::RUN_RESULT_STAY;
+        }
+    }
+    if (!machine->SetWatchpoint(address, size)) {
+        fprintf(stderr, "ERROR: no more than %u watchpoints can be set.\n",
+                MMU::MAX_WATCHPOINTS);
+    } else {
+        printf("Watchpoint set at 0x%X, %u bytes.\n", address, size);
+    }
+    return DCM::RUN_RESULT_STAY;
+}
+
 static DCM::RunResult
 HandleEmpty()
 {
@@ -302,8 +454,12 @@ Debugger::Debugger()
 {
     runUntilTime = 0;
     memset(previousRegisters, 0, sizeof previousRegisters);
+    manager.AddCommand("break",    &CommandBreak,    nullptr);
+    manager.AddCommand("b",        &CommandBreak,    nullptr);
     manager.AddCommand("continue", &CommandContinue, nullptr);
     manager.AddCommand("c",        &CommandContinue, nullptr);
+    manager.AddCommand("delete",   &CommandDelete,   nullptr);
+    manager.AddCommand("d",        &CommandDelete,   nullptr);
     manager.AddCommand("dump",     &CommandDump,     nullptr);
     manager.AddCommand("flags",    &CommandFlags,    nullptr);
     manager.AddCommand("f",        &CommandFlags,    nullptr);
@@ -320,6 +476,10 @@ Debugger::Debugger()
     manager.AddCommand("s",        &CommandStep,     nullptr);
     manager.AddCommand("tick",     &CommandTick,     &runUntilTime);
     manager.AddCommand("t",        &CommandTick,     &runUntilTime);
+    manager.AddCommand("unwatch",  &CommandUnwatch,  nullptr);
+    manager.AddCommand("u",        &CommandUnwatch,  nullptr);
+    manager.AddCommand("watch",    &CommandWatch,    nullptr);
+    manager.AddCommand("w",        &CommandWatch,    nullptr);
     manager.SetEmpty(&HandleEmpty);
     manager.SetUnknown(&HandleUnknown);
 
@@ -338,17 +498,28 @@ Debugger::~Debugger()
 /// but you would have to implement *a lot* more system calls to get it to
 /// work!
 ///
-/// So just allow single-stepping, and printing the contents of memory.
+/// So just allow single-stepping, breakpoints, watchpoints, and printing
+/// the contents of memory.  Between breakpoints, and writes to watched
+/// memory, the machine does not call this at all.
 bool
 Debugger::Step()
 {
+    MMU *mmu = machine->GetMMU();
+
     // Wait until the indicated number of ticks has been reached.
-    if (runUntilTime > stats->totalTicks) {
+    if (runUntilTime > stats->totalTicks && !mmu->HasWatchHit()
+          && !machine->IsBreakpoint(machine->ReadRegister(PC_REG))) {
         return true;
     }
 
     runUntilTime = 0;
 
+    if (mmu->HasWatchHit()) {
+        printf("Watched memory written at 0x%X, by the instruction at "
+               "0x%X.\n", mmu->TakeWatchHit(),
+               machine->ReadRegister(PREV_PC_REG));
+    }
+
     interrupt->DumpState();
     DumpMachineState(previousRegisters);
 
@@ -31,7 +31,7 @@ public:
     RunResult Run(char *line);
 
 private:
-    static const unsigned CAPACITY = 20;
+    static const unsigned CAPACITY = 28;
 
     struct Command {
         const char *name;
@@ -22,13 +22,21 @@
 /// limitation of liability and disclaimer of warranty provisions.
 
 
+#include "async_ring.hh"
+#include "checkpoint.hh"
+#include "file_description.hh"
+#include "pipe.hh"
 #include "transfer.hh"
 #include "syscall.h"
 #include "filesys/directory_entry.hh"
+#include "threads/lock.hh"
+#include "threads/semaphore.hh"
 #include "threads/system.hh"
+#include "machine/endianness.hh"
 #include "args.hh"
 
 #include <stdio.h>
+#include <string.h>
 
 static void
 IncrementPC()
@@ -65,6 +73,7 @@ void
 ExecProcess(void* args) {
     currentThread->space->InitRegisters();
     currentThread->space->RestoreState();
+    currentThread->space->UpdateInfoPage();
 
     if (args) {
         machine->WriteRegister(4, WriteArgs((char**) args));
@@ -77,369 +86,2000 @@ ExecProcess(void* args) {
     ASSERT(false); // machine->Run() never returns
 }
 
-/// Handle a system call exception.
-///
-/// * `et` is the kind of exception.  The list of possible exceptions is in
-///   `machine/exception_type.hh`.
+/// Start a process created by `Fork`, where its parent left off, or a
+/// thread created by `ThreadFork`.
 ///
-/// The calling convention is the following:
+/// * `args` is the register set the child starts with.
+static void
+ForkProcess(void *args) {
+    int *registers = (int *) args;
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, registers[i]);
+    }
+    delete [] registers;
+
+    currentThread->space->RestoreState();
+    currentThread->space->UpdateInfoPage();
+
+    machine->Run();
+    ASSERT(false); // machine->Run() never returns
+}
+
+/// Functions for `TransferUser`, moving data between user memory and
+/// open files or the console.  As before, writes stop at the first null
+/// byte; console reads stop after a newline, or at the end of the input,
+/// and store nothing past what they read, not even a null byte.
+
+static unsigned
+ReadFileChunk(char *chunk, unsigned count, void *file)
+{
+    int read = ((OpenFile *) file)->Read(chunk, count);
+    return read > 0 ? read : 0;
+}
+
+static unsigned
+WriteFileChunk(char *chunk, unsigned count, void *file)
+{
+    const char *nul = (const char *) memchr(chunk, '\0', count);
+    unsigned length = nul == nullptr ? count : nul - chunk;
+    if (length == 0) {
+        return 0;
+    }
+
+    int written = ((OpenFile *) file)->Write(chunk, length);
+    return written > 0 ? written : 0;
+}
+
+/// Functions for `TransferUserPages`, moving whole pages between user
+/// memory and a file open for direct I/O.
+
+static unsigned
+ReadFilePages(char *const *pages, unsigned count, void *file)
+{
+    ASSERT(PAGE_SIZE == SECTOR_SIZE);
+    return ((OpenFile *) file)->ReadScattered(pages, count) / PAGE_SIZE;
+}
+
+/// Pages from the one with a null byte on are left to `WriteFileChunk`.
+static unsigned
+WriteFilePages(char *const *pages, unsigned count, void *file)
+{
+    ASSERT(PAGE_SIZE == SECTOR_SIZE);
+    unsigned n = 0;
+    while (n < count && memchr(pages[n], '\0', PAGE_SIZE) == nullptr) {
+        n++;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    return ((OpenFile *) file)->WriteGathered(pages, n) / PAGE_SIZE;
+}
+
+/// A console read ends with the line; `ended` tells the chunks after it.
+static unsigned
+ReadConsoleChunk(char *chunk, unsigned count, void *ended)
+{
+    if (*(bool *) ended) {
+        return 0;
+    }
+    unsigned read = gSynchConsole->ReadLine(chunk, count);
+    if (read < count || chunk[read - 1] == '\n') {
+        *(bool *) ended = true;
+    }
+    return read;
+}
+
+static unsigned
+WriteConsoleChunk(char *chunk, unsigned count, void *)
+{
+    const char *nul = (const char *) memchr(chunk, '\0', count);
+    unsigned length = nul == nullptr ? count : nul - chunk;
+    gSynchConsole->WriteBuffer(chunk, length);
+    return length;
+}
+
+/// Move `size` bytes between user memory at `bufferAddr` and `file`,
+/// reading from it if `reading`.  A file open for direct I/O moves the
+/// whole pages of a buffer starting a page a batch at a time, so that the
+/// disk moves them straight to or from their frames, in one request for
+/// each run of sectors; what is left, a page at a time.
+static int
+TransferOpenFile(OpenFile *file, int bufferAddr, int size, bool reading)
+{
+    ASSERT(file != nullptr);
+    ASSERT(size > 0);
+
+    unsigned done = 0;
+    if (file->IsDirect() && bufferAddr % PAGE_SIZE == 0) {
+        done = TransferUserPages(bufferAddr, size / PAGE_SIZE, reading,
+                                 reading ? ReadFilePages : WriteFilePages,
+                                 file);
+    }
+    if (done < (unsigned) size) {
+        done += TransferUser(bufferAddr + done, size - done, reading,
+                             reading ? ReadFileChunk : WriteFileChunk,
+                             file);
+    }
+    return done;
+}
+
+/// Move `size` bytes between user memory at `bufferAddr` and the console
+/// or the open file `fid`, reading from it if `reading`.  Return the
+/// number of bytes moved, or -1 if `fid` cannot be used that way.
+static int
+TransferFile(OpenFileId fid, int bufferAddr, int size, bool reading)
+{
+    ASSERT(size > 0);
+
+    PipeEnd *pipe = FindPipeEnd(fid);
+    if (pipe != nullptr) {
+        return pipe->Transfer(bufferAddr, size, reading);
+    }
+    if (fid == CONSOLE_INPUT) {
+        bool ended = false;
+        return reading ? TransferUser(bufferAddr, size, true,
+                                      ReadConsoleChunk, &ended)
+                       : -1;
+    }
+    if (fid == CONSOLE_OUTPUT) {
+        return reading ? -1
+                       : TransferUser(bufferAddr, size, false,
+                                      WriteConsoleChunk, nullptr);
+    }
+
+    FileDescription *description = FindOpenFile(fid);
+    if (description == nullptr) {
+        return -1;
+    }
+    return TransferOpenFile(description->GetFile(), bufferAddr, size,
+                            reading);
+}
+
+/// End the current process with `status`, letting go of its pipe ends
+/// first, so that the programs on the other side see it is gone, and of
+/// the locks it holds, so that the other threads of its space can go on.
+/// Its I/O ring, which uses its open files, is stopped before anything.
+static void
+ExitProcess(int status)
+{
+    delete currentThread->ioRing;
+    currentThread->ioRing = nullptr;
+    CloseAllPipeEnds(currentThread);
+    CloseAllOpenFiles(currentThread);
+    currentThread->space->ReleaseHeldLocks();
+#ifdef VMEM
+    // The space is not deleted until the process is joined: there is no
+    // need to keep the frames it was counted for until then.
+    if (currentThread->space->GetNumUsers() == 1) {
+        memoryScheduler->Leave(currentThread->space);
+    }
+#endif
+    currentThread->Finish(status);
+}
+
+/// System call handlers, one per system call.  Each takes its arguments
+/// from the registers and leaves its result in `r2`; the program counter
+/// is advanced by `SyscallHandler`.
+
+/// void Halt();
+static void
+SyscallHalt()
+{
+    DEBUG('e', "Shutdown, initiated by user program.\n");
+    interrupt->Halt();
+}
+
+/// void Exit(int status);
+static void
+SyscallExit()
+{
+    int status = machine->ReadRegister(4);
+    DEBUG('e', "Thead `%s` exiting. Status: %d.\n", currentThread->GetName(), status);
+
+    ExitProcess(status);
+}
+
+/// Start the program named at `filenameAddr`, with the arguments at
+/// `argsAddr`, and its console input and output on `input` and `output`,
+/// or on the console if null; both are copied for it.  It inherits the
+/// open files of the current thread.
+static void
+StartProgram(int filenameAddr, int argsAddr, const PipeEnd *input,
+             const PipeEnd *output)
+{
+    if (filenameAddr == 0) {
+        DEBUG('e', "Error: address to filename string is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    char *filename = new char[FILE_NAME_MAX_LEN + 1];
+    if (!ReadStringFromUser(filenameAddr, filename, FILE_NAME_MAX_LEN + 1)) {
+        DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n",  FILE_NAME_MAX_LEN);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    OpenFile *executable = fileSystem->Open(filename);
+    if (executable == nullptr) {
+        DEBUG('e', "Error: unable to open file %s.\n", filename);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    AddressSpace *space = new AddressSpace(executable, filename);
+    if (!space->IsReady()) {
+        DEBUG('e', "Error: could not set up the address space of %s.\n",
+              filename);
+        delete space;
+#ifndef DEMAND_LOADING
+        delete executable;  // Otherwise the space deleted it.
+#endif
+        delete [] filename;
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    Thread *newThread = new Thread(filename, true, currentThread->GetPriority());
+    newThread->space = space;
+    newThread->consoleInput  = input == nullptr ? nullptr
+                                                : input->Duplicate();
+    newThread->consoleOutput = output == nullptr ? nullptr
+                                                 : output->Duplicate();
+
+#ifndef DEMAND_LOADING
+    delete executable;  // With demand loading, the space keeps it.
+#endif
+
+    if (!InheritOpenFiles(newThread)) {
+        DEBUG('e', "Error: no memory left for the open files of %s.\n",
+              filename);
+        delete newThread;  // Deletes the space too.
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    int pid = processTable->Add(newThread);
+    if (pid == -1) {
+        DEBUG('e', "Error: no memory left for the process table.\n");
+        delete newThread;  // Deletes the space too.
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    space->SetPid(pid);
+    machine->WriteRegister(2, pid);
+
+    char** args = SaveArgs(argsAddr);
+    newThread->Fork(ExecProcess, args);
+}
+
+/// SpaceId Exec(char *name, char **argv);
+static void
+SyscallExec()
+{
+    DEBUG('e', "Exec, initiated by user program.\n");
+
+    int filenameAddr = machine->ReadRegister(4);
+    int argsAddr = machine->ReadRegister(5);
+
+    // The console of the new program goes where this one's does.
+    StartProgram(filenameAddr, argsAddr, FindPipeEnd(CONSOLE_INPUT),
+                 FindPipeEnd(CONSOLE_OUTPUT));
+}
+
+/// SpaceId ExecIO(char *name, char **argv, OpenFileId input,
+///                OpenFileId output);
+static void
+SyscallExecIO()
+{
+    DEBUG('e', "ExecIO, initiated by user program.\n");
+
+    int filenameAddr = machine->ReadRegister(4);
+    int argsAddr = machine->ReadRegister(5);
+    int inputId  = machine->ReadRegister(6);
+    int outputId = machine->ReadRegister(7);
+
+    PipeEnd *input  = FindPipeEnd(inputId);
+    PipeEnd *output = FindPipeEnd(outputId);
+    if ((inputId != CONSOLE_INPUT && (input == nullptr || input->IsWriting()))
+          || (outputId != CONSOLE_OUTPUT
+              && (output == nullptr || !output->IsWriting()))) {
+        DEBUG('e', "Error: input %d or output %d is not a pipe end that "
+              "goes that way.\n", inputId, outputId);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    StartProgram(filenameAddr, argsAddr, input, output);
+}
+
+/// SpaceId Fork(void);
+static void
+SyscallFork()
+{
+    DEBUG('e', "Fork, initiated by user program.\n");
+
+#ifdef VMEM
+    char *name = new char[strlen(currentThread->GetName()) + 1];
+    strcpy(name, currentThread->GetName());
+
+    AddressSpace *space = new AddressSpace(currentThread->space);
+    if (!space->IsReady()) {
+        DEBUG('e', "Error: could not set up the address space of the "
+                   "child.\n");
+        delete space;
+        delete [] name;
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    Thread *newThread = new Thread(name, true, currentThread->GetPriority());
+    newThread->space = space;
+
+    int pid = processTable->Add(newThread);
+    if (pid == -1) {
+        DEBUG('e', "Error: no memory left for the process table.\n");
+        delete newThread;
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    // The child returns from the system call too, with 0.
+    int *registers = new int[NUM_TOTAL_REGS];
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        registers[i] = machine->ReadRegister(i);
+    }
+    registers[2] = 0;
+    registers[PREV_PC_REG] = registers[PC_REG];
+    registers[PC_REG] = registers[NEXT_PC_REG];
+    registers[NEXT_PC_REG] += 4;
+
+    space->SetPid(pid);
+    machine->WriteRegister(2, pid);
+    newThread->Fork(ForkProcess, registers);
+#else
+    DEBUG('e', "Error: Fork needs copy-on-write, which requires VMEM.\n");
+    machine->WriteRegister(2, -1);
+#endif
+}
+
+/// int Join(SpaceId id);
+static void
+SyscallJoin()
+{
+    DEBUG('e', "Join, initiated by user program.\n");
+
+    SpaceId id = (SpaceId) machine->ReadRegister(4);
+
+    // An entry left null is being joined by `JoinTimeout`.
+    if (id < 0 || processTable->Get(id) == nullptr) {
+        DEBUG('e', "Error: invalid space id %d.\n", id);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    Thread* threadToJoin = processTable->Remove(id);
+    int exitValue = threadToJoin->Join();
+    DEBUG('e', "Thread successfully joined.\n");
+
+    machine->WriteRegister(2, exitValue);
+}
+
+/// Return the ticks to wait for that `ticks`, as passed by a user program,
+/// stands for.
+static unsigned long
+TimeoutTicks(int ticks)
+{
+    return ticks < 0 ? Thread::FOREVER : (unsigned long) ticks;
+}
+
+/// SpaceId WaitAny(int *status, int ticks);
 ///
-/// * system call identifier in `r2`;
-/// * 1st argument in `r4`;
-/// * 2nd argument in `r5`;
-/// * 3rd argument in `r6`;
-/// * 4th argument in `r7`;
-/// * the result of the system call, if any, must be put back into `r2`.
+/// Interrupts stay off from the child being handed over until it is out of
+/// the process table, so that nobody else joins it meanwhile.  A child not
+/// in the table is being joined by `JoinTimeout`, which gave up waiting
+/// just before it finished: it is left to that, and the wait starts over.
+static void
+SyscallWaitAny()
+{
+    DEBUG('e', "WaitAny, initiated by user program.\n");
+
+    int statusAddr = machine->ReadRegister(4);
+    int ticks = machine->ReadRegister(5);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Thread *child;
+    int id;
+    do {
+        child = currentThread->WaitForChild(TimeoutTicks(ticks));
+        id = -1;
+        for (unsigned pid = 0; child != nullptr
+                               && pid < processTable->Capacity(); pid++) {
+            if (processTable->Get(pid) == child) {
+                id = pid;
+            }
+        }
+    } while (child != nullptr && id == -1);
+    if (child != nullptr) {
+        processTable->Remove(id);
+    }
+    interrupt->SetLevel(oldLevel);
+
+    if (child == nullptr) {
+        DEBUG('e', "No child finished.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    int exitValue = child->Join();
+    DEBUG('e', "Child %d joined, with status %d.\n", id, exitValue);
+    if (statusAddr != 0) {
+        WriteBufferToUser((const char *) &exitValue, statusAddr,
+                          sizeof exitValue);
+    }
+    machine->WriteRegister(2, id);
+}
+
+/// int JoinTimeout(SpaceId id, int *status, int ticks);
 ///
-/// And do not forget to increment the program counter before returning. (Or
-/// else you will loop making the same system call forever!)
+/// The entry of `id` is left null while waiting, so that nobody else joins
+/// it meanwhile, and is put back if the time runs out.
+static void
+SyscallJoinTimeout()
+{
+    DEBUG('e', "JoinTimeout, initiated by user program.\n");
+
+    SpaceId id = (SpaceId) machine->ReadRegister(4);
+    int statusAddr = machine->ReadRegister(5);
+    int ticks = machine->ReadRegister(6);
+
+    Thread *threadToJoin = id < 0 ? nullptr : processTable->Get(id);
+    if (threadToJoin == nullptr) {
+        DEBUG('e', "Error: invalid space id %d.\n", id);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    processTable->Update(id, nullptr);
+    int exitValue;
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    bool joined = threadToJoin->Join(TimeoutTicks(ticks), &exitValue);
+    if (joined) {
+        processTable->Remove(id);
+    } else {
+        processTable->Update(id, threadToJoin);
+    }
+    interrupt->SetLevel(oldLevel);
+
+    if (!joined) {
+        DEBUG('e', "Space %d did not finish in time.\n", id);
+        machine->WriteRegister(2, 1);
+        return;
+    }
+    DEBUG('e', "Thread successfully joined.\n");
+    if (statusAddr != 0) {
+        WriteBufferToUser((const char *) &exitValue, statusAddr,
+                          sizeof exitValue);
+    }
+    machine->WriteRegister(2, 0);
+}
+
+/// SpaceId ThreadFork(int (*func)(int), int arg);
+static void
+SyscallThreadFork()
+{
+    DEBUG('e', "ThreadFork, initiated by user program.\n");
+
+    int funcAddr = machine->ReadRegister(4);
+    int arg = machine->ReadRegister(5);
+    int returnAddr = machine->ReadRegister(6);  // Put there by the stub.
+
+    if (funcAddr == 0) {
+        DEBUG('e', "Error: address of the function is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    AddressSpace *space = currentThread->space;
+    int stack = space->NewStack();
+    if (stack == -1) {
+        DEBUG('e', "Error: no room for the stack of a new thread.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    char *name = new char[strlen(currentThread->GetName()) + 1];
+    strcpy(name, currentThread->GetName());
+
+    Thread *newThread = new Thread(name, true, currentThread->GetPriority());
+    newThread->space = space;
+    newThread->userStack = stack;
+    space->Attach();
+    const PipeEnd *input  = FindPipeEnd(CONSOLE_INPUT);
+    const PipeEnd *output = FindPipeEnd(CONSOLE_OUTPUT);
+    newThread->consoleInput  = input == nullptr ? nullptr
+                                                : input->Duplicate();
+    newThread->consoleOutput = output == nullptr ? nullptr
+                                                 : output->Duplicate();
+
+    int tid = processTable->Add(newThread);
+    if (tid == -1) {
+        DEBUG('e', "Error: no memory left for the process table.\n");
+        delete newThread;  // Gives the stack back.
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    int *registers = new int[NUM_TOTAL_REGS];
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        registers[i] = 0;
+    }
+    registers[4]            = arg;
+    registers[28]           = machine->ReadRegister(28);  // Global pointer.
+    registers[STACK_REG]    = stack - 16;
+    registers[RET_ADDR_REG] = returnAddr;
+    registers[PC_REG]       = funcAddr;
+    registers[NEXT_PC_REG]  = funcAddr + 4;
+
+    DEBUG('e', "Thread %d starts at 0x%X, stack at 0x%X.\n",
+          tid, funcAddr, stack);
+    machine->WriteRegister(2, tid);
+    newThread->Fork(ForkProcess, registers);
+}
+
+/// void Yield();
+static void
+SyscallYield()
+{
+    currentThread->Yield();
+}
+
+/// Return the user lock or semaphore `id` of the current address space,
+/// or null if there is none.
+static Lock *
+FindUserLock(int id)
+{
+    return id < 0 ? nullptr : currentThread->space->userLocks.Get(id);
+}
+
+static Semaphore *
+FindUserSemaphore(int id)
+{
+    return id < 0 ? nullptr : currentThread->space->userSemaphores.Get(id);
+}
+
+/// int LockCreate(void);
+static void
+SyscallLockCreate()
+{
+    Lock *lock = new Lock("user lock");
+    int id = currentThread->space->userLocks.Add(lock);
+    if (id == -1) {
+        DEBUG('e', "Error: no room for another lock.\n");
+        delete lock;
+    }
+    machine->WriteRegister(2, id);
+}
+
+/// int LockAcquire(int lock);
+static void
+SyscallLockAcquire()
+{
+    int id = machine->ReadRegister(4);
+    Lock *lock = FindUserLock(id);
+    if (lock == nullptr || lock->IsHeldByCurrentThread()) {
+        DEBUG('e', "Error: no lock %d, or it is held already.\n", id);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    lock->Acquire();
+    machine->WriteRegister(2, 0);
+}
+
+/// int LockRelease(int lock);
+static void
+SyscallLockRelease()
+{
+    int id = machine->ReadRegister(4);
+    Lock *lock = FindUserLock(id);
+    if (lock == nullptr || !lock->IsHeldByCurrentThread()) {
+        DEBUG('e', "Error: no lock %d, or it is not held.\n", id);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    lock->Release();
+    machine->WriteRegister(2, 0);
+}
+
+/// int SemCreate(int initialValue);
+static void
+SyscallSemCreate()
+{
+    int value = machine->ReadRegister(4);
+    if (value < 0) {
+        DEBUG('e', "Error: negative initial value %d.\n", value);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    Semaphore *semaphore = new Semaphore("user semaphore", value);
+    int id = currentThread->space->userSemaphores.Add(semaphore);
+    if (id == -1) {
+        DEBUG('e', "Error: no room for another semaphore.\n");
+        delete semaphore;
+    }
+    machine->WriteRegister(2, id);
+}
+
+/// int SemWait(int semaphore);
+static void
+SyscallSemWait()
+{
+    Semaphore *semaphore = FindUserSemaphore(machine->ReadRegister(4));
+    if (semaphore != nullptr) {
+        semaphore->P();
+    }
+    machine->WriteRegister(2, semaphore != nullptr ? 0 : -1);
+}
+
+/// int SemSignal(int semaphore);
+static void
+SyscallSemSignal()
+{
+    Semaphore *semaphore = FindUserSemaphore(machine->ReadRegister(4));
+    if (semaphore != nullptr) {
+        semaphore->V();
+    }
+    machine->WriteRegister(2, semaphore != nullptr ? 0 : -1);
+}
+
+/// void Sleep(int ticks);
+static void
+SyscallSleep()
+{
+    int ticks = machine->ReadRegister(4);
+    DEBUG('e', "`Sleep` requested for %d ticks.\n", ticks);
+
+    alarmClock->WaitUntil(ticks > 0 ? ticks : 0);
+}
+
+/// int Create(const char *name);
+static void
+SyscallCreate()
+{
+    int filenameAddr = machine->ReadRegister(4);
+    if (filenameAddr == 0) {
+        DEBUG('e', "Error: address to filename string is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    char filename[FILE_NAME_MAX_LEN + 1];
+    if (!ReadStringFromUser(filenameAddr, filename, sizeof filename)) {
+        DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n",  FILE_NAME_MAX_LEN);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    DEBUG('e', "`Create` requested for file `%s`.\n", filename);
+
+    if(fileSystem->Create(filename, 0)) {
+        DEBUG('e', "File `%s` successfully created.\n", filename);
+        machine->WriteRegister(2, 0);
+    } else {
+        DEBUG('e', "Error: file `%s` could not be created.\n", filename);
+        machine->WriteRegister(2, -1);
+    }
+}
+
+/// int Remove(const char *name);
+static void
+SyscallRemove()
+{
+    int filenameAddr = machine->ReadRegister(4);
+    if (filenameAddr == 0) {
+        DEBUG('e', "Error: address to filename string is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    char filename[FILE_NAME_MAX_LEN + 1];
+    if (!ReadStringFromUser(filenameAddr,
+                            filename, sizeof filename)) {
+        DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n",
+              FILE_NAME_MAX_LEN);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    DEBUG('e', "`Remove` requested for file `%s`.\n", filename);
+
+    if(fileSystem->Remove(filename)) {
+        DEBUG('e', "File `%s` successfully removed.\n", filename);
+        machine->WriteRegister(2, 0);
+    } else {
+        DEBUG('e', "Error: file `%s` could not be removed.\n", filename);
+        machine->WriteRegister(2, -1);
+    }
+}
+
+/// Return the number of open files and pipe ends of `t`.
+static unsigned
+CountOpenIds(const Thread *t)
+{
+    ASSERT(t != nullptr);
+
+    unsigned count = 0;
+    if (t->openFiles != nullptr) {
+        for (unsigned i = 0; i < t->openFiles->Capacity(); i++) {
+            count += t->openFiles->HasKey(i);
+        }
+    }
+    for (unsigned i = 0; i < t->pipeEnds->Capacity(); i++) {
+        count += t->pipeEnds->HasKey(i);
+    }
+    return count;
+}
+
+/// Return whether the current thread may take `more` identifiers, for open
+/// files or pipe ends, within the limit of its process.
+static bool
+MayOpen(unsigned more)
+{
+    unsigned limit = currentThread->space->limits.openFiles;
+    if (limit == 0 || CountOpenIds(currentThread) + more <= limit) {
+        return true;
+    }
+    DEBUG('e', "Error: <%s> is at its limit of %u open files.\n",
+          currentThread->GetName(), limit);
+    return false;
+}
+
+/// Open the file named by the first argument, for direct I/O if `direct`.
+static void
+OpenFromUser(bool direct)
+{
+    int filenameAddr = machine->ReadRegister(4);
+
+    if (filenameAddr == 0) {
+        DEBUG('e', "Error: address to filename is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    char filename[FILE_NAME_MAX_LEN + 1];
+    if (!ReadStringFromUser(filenameAddr, filename, sizeof filename)) {
+        DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n", FILE_NAME_MAX_LEN);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    DEBUG('e', "Opening file %s.\n", filename);
+
+    if (!MayOpen(1)) {
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    OpenFile* file = fileSystem->Open(filename);
+    if (file == nullptr) {
+        DEBUG('e', "Error: file not found.\n");
+        machine->WriteRegister(2, -1);
+    } else {
+        file->SetDirect(direct);
+        FileDescription *description = new FileDescription(file);
+        int id = currentThread->openFiles->Add(description);
+        if (id == -1) {
+            DEBUG('e', "Error: thread <%s> already has too many open files.\n");
+            description->Release(currentThread->space);
+            machine->WriteRegister(2, -1);
+        } else {
+            id += 2;
+            DEBUG('e', "Adding file %s to <%s>'s open file table with id %d.\n", filename, currentThread->GetName(), id);
+            machine->WriteRegister(2, id);
+        }
+    }
+}
+
+/// OpenFileId Open(const char *name);
+static void
+SyscallOpen()
+{
+    OpenFromUser(false);
+}
+
+/// OpenFileId OpenDirect(const char *name);
+static void
+SyscallOpenDirect()
+{
+    OpenFromUser(true);
+}
+
+/// Lay a file named `name` out as a `FileStat` at `*next`, and move
+/// `*next` past it.
+static void
+WriteFileStat(const char *name, bool isDirectory, unsigned length, int *next)
+{
+    ASSERT(name != nullptr);
+    ASSERT(next != nullptr);
+
+    int words[2];
+    words[0] = isDirectory;
+    words[1] = length;
+    char padded[FILE_NAME_SIZE];
+    memset(padded, 0, sizeof padded);
+    strncpy(padded, name, sizeof padded - 1);
+
+    WriteBufferToUser((const char *) words, *next, sizeof words);
+    WriteBufferToUser(padded, *next + sizeof words, sizeof padded);
+    *next += sizeof words + sizeof padded;
+}
+
+/// int Stat(const char *name, FileStat *stat);
+static void
+SyscallStat()
+{
+    int filenameAddr = machine->ReadRegister(4);
+    int statAddr = machine->ReadRegister(5);
+
+    if (filenameAddr == 0 || statAddr == 0) {
+        DEBUG('e', "Error: address to filename or record is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    char filename[FILE_NAME_MAX_LEN + 1];
+    if (!ReadStringFromUser(filenameAddr, filename, sizeof filename)) {
+        DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n",
+              FILE_NAME_MAX_LEN);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    bool isDirectory;
+    unsigned length;
+    if (!fileSystem->Stat(filename, &isDirectory, &length)) {
+        DEBUG('e', "Error: file `%s` not found.\n", filename);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    const char *last = strrchr(filename, '/');
+    WriteFileStat(last != nullptr ? last + 1 : filename, isDirectory, length,
+                  &statAddr);
+    machine->WriteRegister(2, 0);
+}
+
+/// int ReadDir(const char *name, FileStat *entries, int count);
+static void
+SyscallReadDir()
+{
+    int filenameAddr = machine->ReadRegister(4);
+    int entriesAddr = machine->ReadRegister(5);
+    int count = machine->ReadRegister(6);
+
+    if (filenameAddr == 0 || count < 0 || (entriesAddr == 0 && count != 0)) {
+        DEBUG('e', "Error: no directory name, or no room for entries.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    char filename[FILE_NAME_MAX_LEN + 1];
+    if (!ReadStringFromUser(filenameAddr, filename, sizeof filename)) {
+        DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n",
+              FILE_NAME_MAX_LEN);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    if (count > MAX_READ_DIR) {
+        count = MAX_READ_DIR;
+    }
+    DirectoryEntry entries[MAX_READ_DIR];
+    unsigned lengths[MAX_READ_DIR];
+    int found = fileSystem->ReadDirectory(filename, entries, count, lengths);
+    if (found < 0) {
+        DEBUG('e', "Error: directory `%s` not found.\n", filename);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    DEBUG('e', "`ReadDir` of `%s` found %d entries.\n", filename, found);
+
+    int next = entriesAddr;
+    for (int i = 0; i < found; i++) {
+        WriteFileStat(entries[i].name, entries[i].isDirectory, lengths[i],
+                      &next);
+    }
+    machine->WriteRegister(2, found);
+}
+
+/// int Close(OpenFileId id);
+static void
+SyscallClose()
+{
+    int fid = machine->ReadRegister(4);
+    DEBUG('e', "`Close` requested for id %u.\n", fid);
+
+    if (fid == CONSOLE_INPUT || fid == CONSOLE_OUTPUT) {
+        DEBUG('e', "Error: file with id %d can't be closed.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    if (fid < 0) {
+        DEBUG('e', "Error: invalid OpenFileId.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    if (fid >= FIRST_PIPE_ID) {
+        PipeEnd *pipe = currentThread->pipeEnds->Remove(fid - FIRST_PIPE_ID);
+        DEBUG('e', "Pipe end %d %s.\n", fid,
+              pipe != nullptr ? "closed" : "was not open");
+        delete pipe;
+        machine->WriteRegister(2, pipe != nullptr ? 0 : -1);
+        return;
+    }
+
+    if (currentThread->openFiles->HasKey(fid - 2)) {
+        DEBUG('e', "File %u closed successfully.\n", fid);
+
+        FileDescription *description
+          = currentThread->openFiles->Remove(fid - 2);
+        description->Release(currentThread->space);
+
+        machine->WriteRegister(2, 0);
+    } else {
+        DEBUG('e', "File %u was not open.\n", fid);
+        machine->WriteRegister(2, 0);
+    }
+}
+
+/// int Pipe(OpenFileId *ends);
+static void
+SyscallPipe()
+{
+    int endsAddr = machine->ReadRegister(4);
+    if (endsAddr == 0) {
+        DEBUG('e', "Error: address of the pipe ends is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    if (!MayOpen(2)) {
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    PipeBuffer *pipe = new PipeBuffer;
+    PipeEnd *readEnd  = new PipeEnd(pipe, false);
+    PipeEnd *writeEnd = new PipeEnd(pipe, true);
+    int ids[2] = { currentThread->pipeEnds->Add(readEnd),
+                   currentThread->pipeEnds->Add(writeEnd) };
+    if (ids[0] == -1 || ids[1] == -1) {
+        DEBUG('e', "Error: <%s> has too many pipe ends.\n",
+              currentThread->GetName());
+        for (unsigned i = 0; i < 2; i++) {
+            if (ids[i] != -1) {
+                currentThread->pipeEnds->Remove(ids[i]);
+            }
+        }
+        delete readEnd;
+        delete writeEnd;  // The last end deletes the pipe.
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    ids[0] += FIRST_PIPE_ID;
+    ids[1] += FIRST_PIPE_ID;
+    DEBUG('e', "Pipe made, read end %d, write end %d.\n", ids[0], ids[1]);
+    WriteBufferToUser((const char *) ids, endsAddr, sizeof ids);
+    machine->WriteRegister(2, 0);
+}
+
+/// Identifiers of each kind `Dup2` may give, from the first on, so that a
+/// wild one does not make the tables grow without end.
+static const int DUP2_IDS = 4096;
+
+/// Make the pipe end `pipe` stand for `newId` too, or for a free
+/// identifier if `newId` is -1, closing whatever `newId` stood for.
+/// Return the identifier, or -1 if `newId` cannot stand for it.
+static int
+DuplicatePipeEnd(const PipeEnd *pipe, int newId)
+{
+    ASSERT(pipe != nullptr);
+
+    if (newId == CONSOLE_INPUT || newId == CONSOLE_OUTPUT) {
+        if (pipe->IsWriting() != (newId == CONSOLE_OUTPUT)) {
+            return -1;
+        }
+        PipeEnd **console = newId == CONSOLE_INPUT
+                              ? &currentThread->consoleInput
+                              : &currentThread->consoleOutput;
+        delete *console;
+        *console = pipe->Duplicate();
+        return newId;
+    }
+
+    PipeEnd *copy = pipe->Duplicate();
+    if (newId == -1) {
+        int id = currentThread->pipeEnds->Add(copy);
+        if (id == -1) {
+            delete copy;
+            return -1;
+        }
+        return id + FIRST_PIPE_ID;
+    }
+    if (newId < FIRST_PIPE_ID || newId - FIRST_PIPE_ID >= DUP2_IDS) {
+        delete copy;
+        return -1;
+    }
+    delete currentThread->pipeEnds->Remove(newId - FIRST_PIPE_ID);
+    if (!currentThread->pipeEnds->AddAt(newId - FIRST_PIPE_ID, copy)) {
+        delete copy;
+        return -1;
+    }
+    return newId;
+}
+
+/// Like `DuplicatePipeEnd`, for the open file `description`.
+static int
+DuplicateOpenFile(FileDescription *description, int newId)
+{
+    ASSERT(description != nullptr);
+
+    if (newId != -1 && (newId < 2 || newId - 2 >= DUP2_IDS)) {
+        return -1;
+    }
+
+    description->Duplicate();
+    if (newId == -1) {
+        int id = currentThread->openFiles->Add(description);
+        if (id == -1) {
+            description->Release(currentThread->space);
+            return -1;
+        }
+        return id + 2;
+    }
+    FileDescription *previous = currentThread->openFiles->Remove(newId - 2);
+    if (previous != nullptr) {
+        previous->Release(currentThread->space);
+    }
+    if (!currentThread->openFiles->AddAt(newId - 2, description)) {
+        description->Release(currentThread->space);
+        return -1;
+    }
+    return newId;
+}
+
+/// Make `newId` stand for what `fid` does, or a free identifier if `newId`
+/// is -1, and leave it in `r2`.
+static void
+DuplicateId(int fid, int newId)
+{
+    if (fid == newId) {
+        bool open = FindPipeEnd(fid) != nullptr
+                    || FindOpenFile(fid) != nullptr;
+        machine->WriteRegister(2, open ? fid : -1);
+        return;
+    }
+    // Taking the place of what `newId` stands for takes no more.
+    bool taken = newId == CONSOLE_INPUT || newId == CONSOLE_OUTPUT
+                 || FindPipeEnd(newId) != nullptr
+                 || FindOpenFile(newId) != nullptr;
+    if (!taken && !MayOpen(1)) {
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    int id = -1;
+    PipeEnd *pipe = FindPipeEnd(fid);
+    FileDescription *description = FindOpenFile(fid);
+    if (pipe != nullptr) {
+        id = DuplicatePipeEnd(pipe, newId);
+    } else if (description != nullptr) {
+        id = DuplicateOpenFile(description, newId);
+    } else {
+        DEBUG('e', "Error: id %d is neither an open file nor a pipe end.\n",
+              fid);
+    }
+    if (id == -1) {
+        DEBUG('e', "Error: cannot give id %d to what %d stands for.\n",
+              newId, fid);
+    } else {
+        DEBUG('e', "Id %d now stands for what %d does.\n", id, fid);
+    }
+    machine->WriteRegister(2, id);
+}
+
+/// OpenFileId Dup(OpenFileId id);
+static void
+SyscallDup()
+{
+    DuplicateId(machine->ReadRegister(4), -1);
+}
+
+/// OpenFileId Dup2(OpenFileId id, OpenFileId newId);
+static void
+SyscallDup2()
+{
+    int newId = machine->ReadRegister(5);
+    if (newId < 0) {
+        DEBUG('e', "Error: invalid OpenFileId.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    DuplicateId(machine->ReadRegister(4), newId);
+}
+
+/// int Fsync(OpenFileId id);
+static void
+SyscallFsync()
+{
+    int fid = machine->ReadRegister(4);
+    DEBUG('e', "`Fsync` requested for id %d.\n", fid);
+
+    FileDescription *description = FindOpenFile(fid);
+    if (description == nullptr) {
+        DEBUG('e', "Error: file with id %d is not an open file.\n", fid);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    description->GetFile()->Sync();
+    machine->WriteRegister(2, 0);
+}
+
+/// int PunchHole(OpenFileId id, int position, int size);
+static void
+SyscallPunchHole()
+{
+    int fid = machine->ReadRegister(4);
+    int position = machine->ReadRegister(5);
+    int size = machine->ReadRegister(6);
+    DEBUG('e', "`PunchHole` requested for id %d, %d bytes at %d.\n",
+          fid, size, position);
+
+    FileDescription *description = FindOpenFile(fid);
+    if (description == nullptr) {
+        DEBUG('e', "Error: file with id %d is not an open file.\n", fid);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    if (position < 0 || size < 0) {
+        DEBUG('e', "Error: position or size is negative.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    OpenFile *file = description->GetFile();
+    machine->WriteRegister(2, file->PunchHole(position, size) ? 0 : -1);
+}
+
+/// int Read(char *buffer, int size, OpenFileId id);
+static void
+SyscallRead()
+{
+    int bufferAddr = machine->ReadRegister(4);
+    int size = machine->ReadRegister(5);
+    int fid = machine->ReadRegister(6);
+
+    if (bufferAddr == 0) {
+        DEBUG('e', "Error: address to buffer is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    if (size <= 0) {
+        DEBUG('e', "Error: size is not positive.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    PipeEnd *pipe = FindPipeEnd(fid);
+    if (pipe != nullptr) {
+        DEBUG('e', "Reading %d bytes from pipe end %d.\n", size, fid);
+        machine->WriteRegister(2, pipe->Transfer(bufferAddr, size, true));
+        return;
+    }
+
+    switch(fid) {
+        case CONSOLE_INPUT: {
+            DEBUG('e', "Reading %d bytes from stdin.\n", size);
+
+            bool ended = false;
+            int i = TransferUser(bufferAddr, size, true,
+                                 ReadConsoleChunk, &ended);
+
+            machine->WriteRegister(2, i - 1); // return number of read bytes
+            break;
+        }
+
+        case CONSOLE_OUTPUT: {
+            DEBUG('e', "Error: tried to read from stdout.\n");
+            machine->WriteRegister(2, -1);
+            break;
+        }
+
+        default:
+            if (FindOpenFile(fid) != nullptr) {
+                OpenFile* file = FindOpenFile(fid)->GetFile();
+
+                int read = TransferOpenFile(file, bufferAddr, size, true);
+                machine->WriteRegister(2, read);
+            } else {
+                machine->WriteRegister(2, -1);
+            }
+
+    }
+}
+
+/// int Write(const char *buffer, int size, OpenFileId id);
+static void
+SyscallWrite()
+{
+    int bufferAddr = machine->ReadRegister(4);
+    int size = machine->ReadRegister(5);
+    int fid = machine->ReadRegister(6);
+
+    if (bufferAddr == 0) {
+        DEBUG('e', "Error: address to buffer is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    if (size <= 0) {
+        DEBUG('e', "Error: size is not positive.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+
+    PipeEnd *pipe = FindPipeEnd(fid);
+    if (pipe != nullptr) {
+        DEBUG('e', "Writing %d bytes to pipe end %d.\n", size, fid);
+        machine->WriteRegister(2, pipe->Transfer(bufferAddr, size, false));
+        return;
+    }
+
+    switch(fid) {
+        case CONSOLE_INPUT: {
+            DEBUG('e', "Error: tried to write to stdin.\n");
+            machine->WriteRegister(2, -1);
+            break;
+        }
+
+        case CONSOLE_OUTPUT: {
+            DEBUG('e', "Writing %d bytes to stdout.\n", size);
+
+            int i = TransferUser(bufferAddr, size, false,
+                                 WriteConsoleChunk, nullptr);
+
+            machine->WriteRegister(2, i - 1); // return number of written bytes
+            break;
+        }
+
+        default:
+            if (FindOpenFile(fid) != nullptr) {
+                OpenFile* file = FindOpenFile(fid)->GetFile();
+
+                int written = TransferOpenFile(file, bufferAddr, size,
+                                               false);
+                machine->WriteRegister(2, written);
+            } else {
+                machine->WriteRegister(2, -1);
+            }
+            machine->WriteRegister(2, 0);
+    }
+}
+
+/// void PrintScheduler();
 static void
-SyscallHandler(ExceptionType _et)
+SyscallPrintScheduler()
 {
-    int scid = machine->ReadRegister(2);
-
-    switch (scid) {
-
-        case SC_HALT:
-            DEBUG('e', "Shutdown, initiated by user program.\n");
-            interrupt->Halt();
-            break;
+    scheduler->Print();
+    stats->PrintScheduling();
+
+    printf("Resources used:\n");
+    currentThread->PrintUsage();
+    for (unsigned pid = 0; pid < processTable->Capacity(); pid++) {
+        Thread *t = processTable->Get(pid);
+        if (t != nullptr && t != currentThread) {
+            t->PrintUsage();
+        }
+    }
+}
 
-        case SC_EXIT: {
-            int status = machine->ReadRegister(4);
-            DEBUG('e', "Thead `%s` exiting. Status: %d.\n", currentThread->GetName(), status);
+/// int GetDiskStats(DiskStats *stats);
+static void
+SyscallGetDiskStats()
+{
+    int statsAddr = machine->ReadRegister(4);
 
-            currentThread->Finish(status);
+    if (statsAddr == 0) {
+        DEBUG('e', "Error: address to disk statistics is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            break;
-        }
+    // Laid out as `DiskStats`, with the 32-bit words user programs have.
+    ASSERT(DISK_STATS_BUCKETS == Statistics::LATENCY_BUCKETS);
+    int words[5 + 2 * DISK_STATS_BUCKETS];
+    words[0] = stats->numDiskRequests;
+    words[1] = stats->numDiskSectors;
+    words[2] = stats->diskRequestTicks;
+    words[3] = stats->diskRotationTicks;
+    words[4] = stats->numTrackBufferHits;
+    for (unsigned b = 0; b < DISK_STATS_BUCKETS; b++) {
+        words[5 + b] = stats->diskLatency[b];
+        words[5 + DISK_STATS_BUCKETS + b] = stats->diskSeekTracks[b];
+    }
+    WriteBufferToUser((const char *) words, statsAddr, sizeof words);
+    machine->WriteRegister(2, 0);
+}
 
-        case SC_EXEC: {
+/// int GetTicks(TickCounts *ticks);
+static void
+SyscallGetTicks()
+{
+    int ticksAddr = machine->ReadRegister(4);
 
-            DEBUG('e', "Exec, initiated by user program.\n");
+    if (ticksAddr == 0) {
+        DEBUG('e', "Error: address to tick counts is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            int filenameAddr = machine->ReadRegister(4);
-            int argsAddr = machine->ReadRegister(5);
+    // Laid out as `TickCounts`.
+    int words[6];
+    words[0] = stats->totalTicks;
+    words[1] = stats->idleTicks;
+    words[2] = stats->systemTicks;
+    words[3] = stats->userTicks;
+    words[4] = currentThread->usage.userTicks;
+    words[5] = currentThread->usage.systemTicks;
+    WriteBufferToUser((const char *) words, ticksAddr, sizeof words);
+    machine->WriteRegister(2, 0);
+}
 
-            if (filenameAddr == 0) {
-                DEBUG('e', "Error: address to filename string is null.\n");
-                machine->WriteRegister(2, -1);
-                break;
-            }
+/// Lay `limits` out as a `ProcessLimits` in `words`.
+static void
+LimitsToWords(const ResourceLimits &limits, int *words)
+{
+    ASSERT(words != nullptr);
 
-            char *filename = new char[FILE_NAME_MAX_LEN + 1];
-            if (!ReadStringFromUser(filenameAddr, filename, FILE_NAME_MAX_LEN + 1)) {
-                DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n",  FILE_NAME_MAX_LEN);
-                machine->WriteRegister(2, -1);
-                break;
-            }
+    words[0] = limits.residentPages;
+    words[1] = limits.openFiles;
+    words[2] = limits.diskRate;
+    words[3] = limits.diskBurst;
+}
 
-            OpenFile *executable = fileSystem->Open(filename);
-            if (executable == nullptr) {
-                DEBUG('e', "Error: unable to open file %s.\n", filename);
-                machine->WriteRegister(2, -1);
-                break;
-            }
+/// Lay `t`, with identifier `pid`, out as a `ProcessInfo` at `*next`, and
+/// move `*next` past it.
+static void
+WriteProcessInfo(Thread *t, int pid, int *next)
+{
+    ASSERT(t != nullptr);
+    ASSERT(next != nullptr);
+
+    const AddressSpace *space = t->space;
+    int words[21];
+    words[0]  = pid;
+    words[1]  = t->GetStatus();
+    words[2]  = t->GetPriority();
+    words[3]  = t->usage.userTicks;
+    words[4]  = t->usage.systemTicks;
+    words[5]  = t->space != nullptr ? t->space->GetNumPages() : 0;
+    words[6]  = t->space != nullptr ? t->space->GetNumResidentPages() : 0;
+    words[7]  = t->space != nullptr ? t->space->GetWorkingSetSize() : 0;
+    words[8]  = t->space != nullptr ? t->space->GetNumSharedPages() : 0;
+    words[9]  = t->usage.pageFaults;
+    words[10] = t->usage.tlbMisses;
+    words[11] = t->usage.sectorsRead;
+    words[12] = t->usage.sectorsWritten;
+    words[13] = t->usage.switches;
+    words[14] = CountOpenIds(t);
+    words[15] = space != nullptr ? space->diskBucket.throttledTicks : 0;
+    words[16] = space != nullptr ? space->limitEvictions : 0;
+    LimitsToWords(space != nullptr ? space->limits : ResourceLimits(),
+                  &words[17]);
+    char name[PROCESS_NAME_SIZE];
+    strncpy(name, t->GetName(), sizeof name - 1);
+    name[sizeof name - 1] = '\0';
+
+    WriteBufferToUser((const char *) words, *next, sizeof words);
+    WriteBufferToUser(name, *next + sizeof words, sizeof name);
+    *next += sizeof words + sizeof name;
+}
 
-            AddressSpace *space = new AddressSpace(executable);
-            Thread *newThread = new Thread(filename, true, currentThread->GetPriority());
-            newThread->space = space;
+/// int GetProcesses(ProcessInfo *info, int count);
+static void
+SyscallGetProcesses()
+{
+    int infoAddr = machine->ReadRegister(4);
+    int count    = machine->ReadRegister(5);
 
-            delete executable;
+    if (count < 0 || (infoAddr == 0 && count != 0)) {
+        DEBUG('e', "Error: no room for process records.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            int pid = processTable->Add(newThread);
-            if (pid == -1) {
-                DEBUG('e', "Error: too many processes are already running (maximum is %d).\n", processTable->SIZE);
-                delete newThread;
-                delete space;
-                machine->WriteRegister(2, -1);
-                break;
+    ASSERT(PROCESS_CREATED == JUST_CREATED && PROCESS_RUNNING == RUNNING
+           && PROCESS_READY == READY && PROCESS_BLOCKED == BLOCKED);
+    int next = infoAddr;
+    int found = 1;
+    if (count > 0) {
+        int self = -1;
+        for (unsigned pid = 0; pid < processTable->Capacity(); pid++) {
+            if (processTable->Get(pid) == currentThread) {
+                self = pid;
             }
-
-            machine->WriteRegister(2, pid);
-
-            char** args = SaveArgs(argsAddr);
-            newThread->Fork(ExecProcess, args);
-            break;
         }
+        WriteProcessInfo(currentThread, self, &next);
+    }
+    for (unsigned pid = 0; pid < processTable->Capacity(); pid++) {
+        Thread *t = processTable->Get(pid);
+        if (t == nullptr || t == currentThread) {
+            continue;
+        }
+        if (found < count) {
+            WriteProcessInfo(t, pid, &next);
+        }
+        found++;
+    }
+    machine->WriteRegister(2, found);
+}
 
-        case SC_JOIN: {
-            DEBUG('e', "Join, initiated by user program.\n");
-
-            SpaceId id = (SpaceId) machine->ReadRegister(4);
+/// int GetLimits(ProcessLimits *limits);
+static void
+SyscallGetLimits()
+{
+    int limitsAddr = machine->ReadRegister(4);
+    if (limitsAddr == 0) {
+        DEBUG('e', "Error: address of the limits is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            if (id < 0 || !processTable->HasKey(id)) {
-                DEBUG('e', "Error: invalid space id %s.\n", id);
-                machine->WriteRegister(2, -1);
-                break;
-            }
+    int words[4];
+    LimitsToWords(currentThread->space->limits, words);
+    WriteBufferToUser((const char *) words, limitsAddr, sizeof words);
+    machine->WriteRegister(2, 0);
+}
 
-            Thread* threadToJoin = processTable->Remove(id);
-            int exitValue = threadToJoin->Join();
-            DEBUG('e', "Thread successfully joined.\n");
+/// int SetLimits(const ProcessLimits *limits);
+static void
+SyscallSetLimits()
+{
+    int limitsAddr = machine->ReadRegister(4);
+    if (limitsAddr == 0) {
+        DEBUG('e', "Error: address of the limits is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            machine->WriteRegister(2, exitValue);
-            break;
+    int words[4];
+    ReadBufferFromUser(limitsAddr, (char *) words, sizeof words);
+    for (unsigned i = 0; i < 4; i++) {
+        if (words[i] < 0) {
+            DEBUG('e', "Error: limit %d is negative.\n", words[i]);
+            machine->WriteRegister(2, -1);
+            return;
         }
+    }
+    ResourceLimits limits;
+    limits.residentPages = words[0];
+    limits.openFiles     = words[1];
+    limits.diskRate      = words[2];
+    limits.diskBurst     = words[3];
+
+    AddressSpace *space = currentThread->space;
+    if (!limits.IsWithin(space->limits)) {
+        DEBUG('e', "Error: limits can only be tightened.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    DEBUG('e', "Limits set to %u pages, %u files, %u sectors (%u at once).\n",
+          limits.residentPages, limits.openFiles, limits.diskRate,
+          limits.GetDiskBurst());
+    space->limits = limits;
+    machine->WriteRegister(2, 0);
+}
 
-        case SC_CREATE: {
-            int filenameAddr = machine->ReadRegister(4);
-            if (filenameAddr == 0) {
-                DEBUG('e', "Error: address to filename string is null.\n");
-                machine->WriteRegister(2, -1);
-                break;
-            }
+/// Hold the current thread back, on its way back to user mode, for as long
+/// as its process is over its rate of disk I/O.
+static void
+SettleDiskDebt()
+{
+    AddressSpace *space = currentThread->space;
+    unsigned long wait = space->diskBucket.Settle(space->limits);
+    if (wait > 0) {
+        DEBUG('e', "Holding <%s> back %lu ticks, over its disk rate.\n",
+              currentThread->GetName(), wait);
+        alarmClock->WaitUntil(wait);
+    }
+}
 
-            char filename[FILE_NAME_MAX_LEN + 1];
-            if (!ReadStringFromUser(filenameAddr, filename, sizeof filename)) {
-                DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n",  FILE_NAME_MAX_LEN);
-                machine->WriteRegister(2, -1);
-                break;
-            }
+#ifdef NETWORK
+/// Functions for `TransferUser`, moving messages between user memory and a
+/// kernel buffer, which `arg` points to the next byte of.
 
-            DEBUG('e', "`Create` requested for file `%s`.\n", filename);
+static unsigned
+CopyFromUserChunk(char *chunk, unsigned count, void *arg)
+{
+    char **next = (char **) arg;
+    memcpy(*next, chunk, count);
+    *next += count;
+    return count;
+}
 
-            if(fileSystem->Create(filename, 0)) {
-                DEBUG('e', "File `%s` successfully created.\n", filename);
-                machine->WriteRegister(2, 0);
-            } else {
-                DEBUG('e', "Error: file `%s` could not be created.\n", filename);
-                machine->WriteRegister(2, -1);
-            }
+static unsigned
+CopyToUserChunk(char *chunk, unsigned count, void *arg)
+{
+    const char **next = (const char **) arg;
+    memcpy(chunk, *next, count);
+    *next += count;
+    return count;
+}
 
-            break;
-        }
+/// int Bind(int box);
+static void
+SyscallBind()
+{
+    int box = machine->ReadRegister(4);
+    DEBUG('e', "`Bind` requested for box %d.\n", box);
 
-        case SC_REMOVE: {
-            int filenameAddr = machine->ReadRegister(4);
-            if (filenameAddr == 0) {
-                DEBUG('e', "Error: address to filename string is null.\n");
-                machine->WriteRegister(2, -1);
-                break;
-            }
+    machine->WriteRegister(2, postOffice->Bind(box, currentThread) ? 0 : -1);
+}
 
-            char filename[FILE_NAME_MAX_LEN + 1];
-            if (!ReadStringFromUser(filenameAddr,
-                                    filename, sizeof filename)) {
-                DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n",
-                      FILE_NAME_MAX_LEN);
-                machine->WriteRegister(2, -1);
-                break;
-            }
+/// int Send(const MailAddress *to, int fromBox, const char *buffer,
+///          int size);
+static void
+SyscallSend()
+{
+    int toAddr = machine->ReadRegister(4);
+    int fromBox = machine->ReadRegister(5);
+    int bufferAddr = machine->ReadRegister(6);
+    int size = machine->ReadRegister(7);
+
+    if (toAddr == 0 || bufferAddr == 0) {
+        DEBUG('e', "Error: address to address or buffer is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    if (size < 0 || size > (int) MAX_MAIL_SIZE) {
+        DEBUG('e', "Error: message size %d (maximum is %u).\n",
+              size, MAX_MAIL_SIZE);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    if (!postOffice->IsBoundBy(fromBox, currentThread)) {
+        DEBUG('e', "Error: box %d is not bound by the process.\n", fromBox);
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            DEBUG('e', "`Remove` requested for file `%s`.\n", filename);
+    int to[2];  // Laid out as `MailAddress`.
+    ReadBufferFromUser(toAddr, (char *) to, sizeof to);
+    if (to[1] < 0 || to[1] >= postOffice->GetNumBoxes()) {
+        DEBUG('e', "Error: there is no box %d.\n", to[1]);
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            if(fileSystem->Remove(filename)) {
-                DEBUG('e', "File `%s` successfully removed.\n", filename);
-                machine->WriteRegister(2, 0);
-            } else {
-                DEBUG('e', "Error: file `%s` could not be removed.\n", filename);
-                machine->WriteRegister(2, -1);
-            }
+    char data[MAX_MAIL_SIZE];
+    char *next = data;
+    if (size > 0) {
+        TransferUser(bufferAddr, size, false, CopyFromUserChunk, &next);
+    }
 
-            break;
-        }
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    pktHdr.to = to[0];
+    mailHdr.to = to[1];
+    mailHdr.from = fromBox;
+    mailHdr.length = size;
+    DEBUG('e', "Sending %d bytes to box %d of machine %d.\n",
+          size, to[1], to[0]);
+    postOffice->Send(pktHdr, mailHdr, data);
+    machine->WriteRegister(2, 0);
+}
+
+/// int Receive(int box, char *buffer, int size, MailAddress *from);
+static void
+SyscallReceive()
+{
+    int box = machine->ReadRegister(4);
+    int bufferAddr = machine->ReadRegister(5);
+    int size = machine->ReadRegister(6);
+    int fromAddr = machine->ReadRegister(7);
+
+    if (bufferAddr == 0) {
+        DEBUG('e', "Error: address to buffer is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    if (size < 0) {
+        DEBUG('e', "Error: size is negative.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    if (!postOffice->IsBoundBy(box, currentThread)) {
+        DEBUG('e', "Error: box %d is not bound by the process.\n", box);
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-        case SC_OPEN: { // OpenFileId Open(const char *name);
-            int filenameAddr = machine->ReadRegister(4);
+    PacketHeader pktHdr;
+    MailHeader mailHdr;
+    char data[MAX_MAIL_SIZE];
+    postOffice->Receive(box, &pktHdr, &mailHdr, data);
+    DEBUG('e', "Received %u bytes in box %d.\n", mailHdr.length, box);
+
+    unsigned count = (unsigned) size < mailHdr.length ? size
+                                                      : mailHdr.length;
+    const char *next = data;
+    if (count > 0) {
+        TransferUser(bufferAddr, count, true, CopyToUserChunk, &next);
+    }
+    if (fromAddr != 0) {
+        int from[2] = { pktHdr.from, mailHdr.from };
+        WriteBufferToUser((const char *) from, fromAddr, sizeof from);
+    }
+    machine->WriteRegister(2, mailHdr.length);
+}
+#endif
 
-            if (filenameAddr == 0) {
-                DEBUG('e', "Error: address to filename is null.\n");
-                machine->WriteRegister(2, -1);
-                break;
-            }
+/// Carry out `ReadV` if `reading`, or else `WriteV`.
+static void
+TransferVector(bool reading)
+{
+    int vectorAddr = machine->ReadRegister(4);
+    int count = machine->ReadRegister(5);
+    int fid = machine->ReadRegister(6);
+
+    if (vectorAddr == 0) {
+        DEBUG('e', "Error: address to vector is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            char filename[FILE_NAME_MAX_LEN + 1];
-            if (!ReadStringFromUser(filenameAddr, filename, sizeof filename)) {
-                DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n", FILE_NAME_MAX_LEN);
-                machine->WriteRegister(2, -1);
-                break;
-            }
+    if (count <= 0 || count > MAX_IOVEC) {
+        DEBUG('e', "Error: %d buffers (maximum is %d).\n", count, MAX_IOVEC);
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            DEBUG('e', "Opening file %s.\n", filename);
+    // User pointers are 32 bits wide, unlike the kernel's: take
+    // the vector as pairs of words.
+    int vector[2 * MAX_IOVEC];
+    ReadBufferFromUser(vectorAddr, (char *) vector, count * 2 * 4);
 
-            OpenFile* file = fileSystem->Open(filename);
-            if (file == nullptr) {
-                DEBUG('e', "Error: file not found.\n");
-                machine->WriteRegister(2, -1);
-            } else {
-                int id = currentThread->openFiles->Add(file);
-                if (id == -1) {
-                    DEBUG('e', "Error: thread <%s> already has too many open files.\n");
-                    machine->WriteRegister(2, -1);
-                } else {
-                    id += 2;
-                    DEBUG('e', "Adding file %s to <%s>'s open file table with id %d.\n", filename, currentThread->GetName(), id);
-                    machine->WriteRegister(2, id);
-                }
-            }
+    DEBUG('e', "%s %d buffers, file %d.\n", reading ? "Reading" : "Writing", count, fid);
 
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        int bufferAddr = WordToHost(vector[2 * i]);
+        int size = WordToHost(vector[2 * i + 1]);
+        if (size == 0) {
+            continue;
+        }
+        if (bufferAddr == 0 || size < 0) {
+            DEBUG('e', "Error: invalid buffer %d.\n", i);
+            total = total > 0 ? total : -1;
             break;
         }
 
-        case SC_CLOSE: {
-            int fid = machine->ReadRegister(4);
-            DEBUG('e', "`Close` requested for id %u.\n", fid);
+        int moved = TransferFile(fid, bufferAddr, size, reading);
+        if (moved < 0) {
+            DEBUG('e', "Error: file with id %d cannot be used.\n", fid);
+            total = total > 0 ? total : -1;
+            break;
+        }
+        total += moved;
+        if (moved < size) {
+            break;
+        }
+    }
+    machine->WriteRegister(2, total);
+}
 
-            if (fid == CONSOLE_INPUT || fid == CONSOLE_OUTPUT) {
-                DEBUG('e', "Error: file with id %d can't be closed.\n");
-                machine->WriteRegister(2, -1);
-                break;
-            }
+/// int ReadV(const IoVec *vector, int count, OpenFileId id);
+static void
+SyscallReadV()
+{
+    TransferVector(true);
+}
 
-            if (fid < 0) {
-                DEBUG('e', "Error: invalid OpenFileId.\n");
-                machine->WriteRegister(2, -1);
-            }
+/// int WriteV(const IoVec *vector, int count, OpenFileId id);
+static void
+SyscallWriteV()
+{
+    TransferVector(false);
+}
 
-            if (currentThread->openFiles->HasKey(fid - 2)) {
-                DEBUG('e', "File %u closed successfully.\n", fid);
+/// Map the file and the number of bytes in registers 4 and 5, for `Mmap`
+/// and `MmapReadOnly`.
+static void
+MapFile(bool readOnly)
+{
+    int fid = machine->ReadRegister(4);
+    int size = machine->ReadRegister(5);
+
+#ifdef VMEM
+    if (size <= 0) {
+        DEBUG('e', "Error: size is not positive.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-                OpenFile *file = currentThread->openFiles->Remove(fid - 2);
-                delete file;
+    FileDescription *description = FindOpenFile(fid);
+    if (description == nullptr) {
+        DEBUG('e', "Error: file with id %d is not open.\n", fid);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    // Whoever closed it last would not know to leave it to this space.
+    if (description->IsShared()) {
+        DEBUG('e', "Error: file with id %d is shared, and cannot be "
+              "mapped.\n", fid);
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-                machine->WriteRegister(2, 0);
-            } else {
-                DEBUG('e', "File %u was not open.\n", fid);
-                machine->WriteRegister(2, 0);
-            }
+    OpenFile *file = description->GetFile();
+    int addr = currentThread->space->Map(file, size, readOnly);
+    if (addr == -1) {
+        DEBUG('e', "Error: cannot map file with id %d.\n", fid);
+    } else {
+        DEBUG('e', "Mapped %d bytes of file %d at 0x%X%s.\n", size, fid, addr,
+              readOnly ? ", read-only" : "");
+    }
+    machine->WriteRegister(2, addr);
+#else
+    DEBUG('e', "Error: Mmap of file %d (%d bytes) requires VMEM.\n", fid, size);
+    machine->WriteRegister(2, -1);
+#endif
+}
 
-            break;
-        }
+/// char *Mmap(OpenFileId id, int size);
+static void
+SyscallMmap()
+{
+    MapFile(false);
+}
 
-        case SC_READ: { // int Read(char *buffer, int size, OpenFileId id)
-            int bufferAddr = machine->ReadRegister(4);
-            int size = machine->ReadRegister(5);
-            int fid = machine->ReadRegister(6);
+/// char *MmapReadOnly(OpenFileId id, int size);
+static void
+SyscallMmapReadOnly()
+{
+    MapFile(true);
+}
 
-            if (bufferAddr == 0) {
-                DEBUG('e', "Error: address to buffer is null.\n");
-                machine->WriteRegister(2, -1);
-                break;
-            }
+/// int Munmap(char *addr);
+static void
+SyscallMunmap()
+{
+    int addr = machine->ReadRegister(4);
+
+#ifdef VMEM
+    if (currentThread->space->Unmap(addr)) {
+        machine->WriteRegister(2, 0);
+    } else {
+        DEBUG('e', "Error: nothing mapped at 0x%X.\n", addr);
+        machine->WriteRegister(2, -1);
+    }
+#else
+    DEBUG('e', "Error: Munmap of 0x%X requires VMEM.\n", addr);
+    machine->WriteRegister(2, -1);
+#endif
+}
 
-            if (size <= 0) {
-                DEBUG('e', "Error: size is not positive.\n");
-                machine->WriteRegister(2, -1);
-                break;
-            }
+/// int ShmCreate(int size);
+static void
+SyscallShmCreate()
+{
+    int size = machine->ReadRegister(4);
 
-            switch(fid) {
-                case CONSOLE_INPUT: {
-                    DEBUG('e', "Reading %d bytes from stdin.\n", size);
+#ifdef VMEM
+    if (size <= 0) {
+        DEBUG('e', "Error: size is not positive.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-                    char buffer[size + 1];
+    unsigned pages = DivRoundUp((unsigned) size, PAGE_SIZE);
+    int id = pages <= SHM_PAGES ? segmentTable->Create(pages) : -1;
+    if (id == -1) {
+        DEBUG('e', "Error: no room for a shared segment of %d bytes.\n",
+              size);
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    if (currentThread->space->AttachSegment(id) == -1) {
+        DEBUG('e', "Error: cannot attach shared segment %d.\n", id);
+        segmentTable->Detach(id);  // Nobody else can have attached it.
+        machine->WriteRegister(2, -1);
+        return;
+    }
+    DEBUG('e', "Created shared segment %d of %d bytes.\n", id, size);
+    machine->WriteRegister(2, id);
+#else
+    DEBUG('e', "Error: ShmCreate of %d bytes requires VMEM.\n", size);
+    machine->WriteRegister(2, -1);
+#endif
+}
 
-                    int i;
-                    for(i = 0; i < size; i++) {
-                        buffer[i] = gSynchConsole->ReadChar();
-                        if(buffer[i] == EOF) break;
-                    }
-                    buffer[i] = '\0';
+/// char *ShmAttach(int id);
+static void
+SyscallShmAttach()
+{
+    int id = machine->ReadRegister(4);
+
+#ifdef VMEM
+    int addr = currentThread->space->AttachSegment(id);
+    if (addr == -1) {
+        DEBUG('e', "Error: cannot attach shared segment %d.\n", id);
+    } else {
+        DEBUG('e', "Attached shared segment %d at 0x%X.\n", id, addr);
+    }
+    machine->WriteRegister(2, addr);
+#else
+    DEBUG('e', "Error: ShmAttach of segment %d requires VMEM.\n", id);
+    machine->WriteRegister(2, -1);
+#endif
+}
 
-                    WriteStringToUser(buffer, bufferAddr);
+/// int ShmDetach(char *addr);
+static void
+SyscallShmDetach()
+{
+    int addr = machine->ReadRegister(4);
+
+#ifdef VMEM
+    if (currentThread->space->DetachSegment(addr)) {
+        machine->WriteRegister(2, 0);
+    } else {
+        DEBUG('e', "Error: no shared segment at 0x%X.\n", addr);
+        machine->WriteRegister(2, -1);
+    }
+#else
+    DEBUG('e', "Error: ShmDetach of 0x%X requires VMEM.\n", addr);
+    machine->WriteRegister(2, -1);
+#endif
+}
 
-                    machine->WriteRegister(2, i - 1); // return number of read bytes
-                    break;
-                }
+/// int IoRingSetup(IoRing *ring);
+static void
+SyscallIoRingSetup()
+{
+    int ringAddr = machine->ReadRegister(4);
 
-                case CONSOLE_OUTPUT: {
-                    DEBUG('e', "Error: tried to read from stdout.\n");
-                    machine->WriteRegister(2, -1);
-                    break;
-                }
+    if (currentThread->ioRing != nullptr) {
+        DEBUG('e', "Error: thread <%s> has a ring already.\n", currentThread->GetName());
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-                default:
-                    if (currentThread->openFiles->HasKey(fid - 2)) {
-                        OpenFile* file = currentThread->openFiles->Get(fid - 2);
+    if (!AsyncRing::IsValidRing(ringAddr)) {
+        DEBUG('e', "Error: ring at 0x%X is not in writable memory.\n", ringAddr);
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-                        char buffer[size + 1];
-                        int read = file->Read(buffer, sizeof buffer);
-                        if (read > 0) WriteBufferToUser(buffer, bufferAddr, read);
-                        machine->WriteRegister(2, read);
-                    } else {
-                        machine->WriteRegister(2, -1);
-                    }
+    DEBUG('e', "Setting up ring at 0x%X for <%s>.\n", ringAddr, currentThread->GetName());
+    currentThread->ioRing = new AsyncRing(ringAddr);
+    machine->WriteRegister(2, 0);
+}
 
-            }
+/// int IoRingEnter(int minComplete);
+static void
+SyscallIoRingEnter()
+{
+    int minComplete = machine->ReadRegister(4);
 
-            break;
-        }
+    if (currentThread->ioRing == nullptr) {
+        DEBUG('e', "Error: thread <%s> has no ring.\n", currentThread->GetName());
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-        case SC_WRITE: { // int Write(const char *buffer, int size, OpenFileId id);
-            int bufferAddr = machine->ReadRegister(4);
-            int size = machine->ReadRegister(5);
-            int fid = machine->ReadRegister(6);
+    unsigned ready = currentThread->ioRing->Enter(minComplete > 0 ? minComplete : 0);
+    machine->WriteRegister(2, ready);
+}
 
-            if (bufferAddr == 0) {
-                DEBUG('e', "Error: address to buffer is null.\n");
-                machine->WriteRegister(2, -1);
-                break;
-            }
+/// int Checkpoint(const char *name);
+static void
+SyscallCheckpoint()
+{
+    int filenameAddr = machine->ReadRegister(4);
+    if (filenameAddr == 0) {
+        DEBUG('e', "Error: address to filename string is null.\n");
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            if (size <= 0) {
-                DEBUG('e', "Error: size is not positive.\n");
-                machine->WriteRegister(2, -1);
-                break;
-            }
+    char filename[FILE_NAME_MAX_LEN + 1];
+    if (!ReadStringFromUser(filenameAddr, filename, sizeof filename)) {
+        DEBUG('e', "Error: filename string too long (maximum is %u bytes).\n",
+              FILE_NAME_MAX_LEN);
+        machine->WriteRegister(2, -1);
+        return;
+    }
 
-            switch(fid) {
-                case CONSOLE_INPUT: {
-                    DEBUG('e', "Error: tried to write to stdin.\n");
-                    machine->WriteRegister(2, -1);
-                    break;
-                }
-
-                case CONSOLE_OUTPUT: {
-                    DEBUG('e', "Writing %d bytes to stdout.\n", size);
-
-                    char buffer[size + 1];
-                    buffer[size] = '\0';
-                    ReadStringFromUser(bufferAddr, buffer, size + 1);
-
-                    int i;
-                    for (i = 0; buffer[i] != '\0'; i++)
-                        gSynchConsole->WriteChar(buffer[i]);
-
-                    machine->WriteRegister(2, i - 1); // return number of written bytes
-                    break;
-                }
-
-                default:
-                    if (currentThread->openFiles->HasKey(fid - 2)) {
-                        OpenFile* file = currentThread->openFiles->Get(fid - 2);
-
-                        char buffer[size + 1];
-                        buffer[size] = '\0';
-                        ReadStringFromUser(bufferAddr, buffer, size + 1);
-
-                        int i;
-                        for (i = 0; buffer[i] != '\0'; i++);
-
-                        int written = file->Write(buffer, i);
-                        machine->WriteRegister(2, written);
-                    } else {
-                        machine->WriteRegister(2, -1);
-                    }
-                    machine->WriteRegister(2, 0);
-            }
+    if (TakeCheckpoint(filename)) {
+        machine->WriteRegister(2, 0);
+    } else {
+        DEBUG('e', "Error: checkpoint `%s` could not be written.\n",
+              filename);
+        machine->WriteRegister(2, -1);
+    }
+}
 
-            break;
-        }
+/// char *Sbrk(int increment);
+static void
+SyscallSbrk()
+{
+    int increment = machine->ReadRegister(4);
+    int oldBreak = currentThread->space->Sbrk(increment);
+    if (oldBreak == -1) {
+        DEBUG('e', "Error: no room to move the break %d bytes.\n",
+              increment);
+    }
+    machine->WriteRegister(2, oldBreak);
+}
 
-        case SC_PS: {
-            scheduler->Print();
+typedef void (*SyscallFunction)();
 
-            break;
-        }
+/// Handlers of the system calls, indexed by system call code.
+static SyscallFunction syscallTable[Statistics::MAX_SYSCALLS];
 
-        default:
-            fprintf(stderr, "Unexpected system call: id %d.\n", scid);
-            ASSERT(false);
+static void
+RegisterSyscall(unsigned scid, const char *name, SyscallFunction function)
+{
+    ASSERT(scid < Statistics::MAX_SYSCALLS);
+    ASSERT(syscallTable[scid] == nullptr);
+    ASSERT(function != nullptr);
+
+    syscallTable[scid] = function;
+    stats->syscallNames[scid] = name;
+}
+
+/// Handle a system call exception.
+///
+/// * `et` is the kind of exception.  The list of possible exceptions is in
+///   `machine/exception_type.hh`.
+///
+/// The calling convention is the following:
+///
+/// * system call identifier in `r2`;
+/// * 1st argument in `r4`;
+/// * 2nd argument in `r5`;
+/// * 3rd argument in `r6`;
+/// * 4th argument in `r7`;
+/// * the result of the system call, if any, must be put back into `r2`.
+///
+/// And do not forget to increment the program counter before returning. (Or
+/// else you will loop making the same system call forever!)
+///
+/// Every call is counted, and the simulated time it took recorded, in
+/// `stats`.  Calls that never return, like `Exit`, are only counted.
+static void
+SyscallHandler(ExceptionType _et)
+{
+    int scid = machine->ReadRegister(2);
+
+    if (scid < 0 || (unsigned) scid >= Statistics::MAX_SYSCALLS
+          || syscallTable[scid] == nullptr) {
+        fprintf(stderr, "Unexpected system call: id %d.\n", scid);
+        ASSERT(false);
+    }
 
+    unsigned long start = stats->totalTicks;
+    stats->numSyscalls[scid]++;
+    syscallTable[scid]();
+    stats->RecordSyscall(scid, stats->totalTicks - start);
+    if (tracer != nullptr) {
+        tracer->RecordSyscall(stats->syscallNames[scid], start);
     }
 
     IncrementPC();
+    SettleDiskDebt();
+    currentThread->space->UpdateInfoPage();
 }
 
 static void
@@ -447,28 +2087,68 @@ PageFaultHandler(ExceptionType _et) {
     int virtualAddress = machine->ReadRegister(BAD_VADDR_REG);
     int page = virtualAddress / PAGE_SIZE;
 
-    TranslationEntry *entry = &currentThread->space->GetPageTable()[page];
-    entry->valid = true;
+    if (tracer != nullptr) {
+        tracer->RecordPageFault(virtualAddress);
+    }
+
+    if (!currentThread->space->IsValidPage(page)) {
+        fprintf(stderr, "Invalid memory access at address %d. Terminating thread <%s>\n", virtualAddress, currentThread->GetName());
+        ExitProcess(-1);
+    }
 
+    TranslationEntry *entry = currentThread->space->GetPageEntry(page);
+#ifdef SWAP
+    // A page is about to be taken: this is where a space is suspended, if
+    // too many are competing for memory.
+    if (entry->virtualPage == (unsigned) -1) {
+        memoryScheduler->CheckPressure(currentThread->space);
+    }
+#endif
 #ifdef DEMAND_LOADING
-    if (entry->virtualPage == -1) {
+    currentThread->space->WaitForPrefetch(page);
+#endif
+    entry->valid = true;
+
+    // Without demand loading, only pages of zeros are left to load.
+    bool loaded = entry->virtualPage == (unsigned) -1;
+    if (loaded) {
         currentThread->space->LoadPage(page);
         entry->virtualPage = page;
-        stats->tlbMisses--;
+        stats->numPageFaults++;
+        currentThread->usage.pageFaults++;
     }
+#ifdef DEMAND_LOADING
+    currentThread->space->ReadAhead(page, loaded);
 #endif
 
-    stats->tlbMisses++;
-
     DEBUG('e', "Page Fault in thread <%s> VPN: %d\n", currentThread->GetName(), page);
 
-    machine->GetMMU()->LoadTLBEntry(*entry);
+#ifndef VMEM
+    if (loaded) {
+        currentThread->space->MapLargePage(page);
+    }
+#endif
+#ifdef USE_TLB
+    currentThread->space->LoadTranslation(page);
+#endif
 }
 
 static void
 ReadOnlyHandler(ExceptionType _et) {
+#ifdef VMEM
+    unsigned page = machine->ReadRegister(BAD_VADDR_REG) / PAGE_SIZE;
+    if (currentThread->space->HandleReadOnlyFault(page)) {
+#ifdef USE_TLB
+        // Load the writable translation right away, so that a kernel copy
+        // to user memory can resume without faulting again.
+        currentThread->space->LoadTranslation(page);
+#endif
+        return;
+    }
+#endif
+
     fprintf(stderr, "Cannot write on readonly memory. Terminating thread <%s>\n", currentThread->GetName());
-    currentThread->Finish(-1);
+    ExitProcess(-1);
 }
 
 /// By default, only system calls have their own handler.  All other
@@ -476,6 +2156,62 @@ ReadOnlyHandler(ExceptionType _et) {
 void
 SetExceptionHandlers()
 {
+    RegisterSyscall(SC_HALT,   "Halt",           &SyscallHalt);
+    RegisterSyscall(SC_EXIT,   "Exit",           &SyscallExit);
+    RegisterSyscall(SC_EXEC,   "Exec",           &SyscallExec);
+    RegisterSyscall(SC_JOIN,   "Join",           &SyscallJoin);
+    RegisterSyscall(SC_WAIT_ANY,     "WaitAny",     &SyscallWaitAny);
+    RegisterSyscall(SC_JOIN_TIMEOUT, "JoinTimeout", &SyscallJoinTimeout);
+    RegisterSyscall(SC_FORK,   "Fork",           &SyscallFork);
+    RegisterSyscall(SC_YIELD,  "Yield",          &SyscallYield);
+    RegisterSyscall(SC_CREATE, "Create",         &SyscallCreate);
+    RegisterSyscall(SC_REMOVE, "Remove",         &SyscallRemove);
+    RegisterSyscall(SC_OPEN,   "Open",           &SyscallOpen);
+    RegisterSyscall(SC_OPEN_DIRECT, "OpenDirect", &SyscallOpenDirect);
+    RegisterSyscall(SC_STAT,   "Stat",           &SyscallStat);
+    RegisterSyscall(SC_READ_DIR, "ReadDir",      &SyscallReadDir);
+    RegisterSyscall(SC_CLOSE,  "Close",          &SyscallClose);
+    RegisterSyscall(SC_DUP,    "Dup",            &SyscallDup);
+    RegisterSyscall(SC_DUP2,   "Dup2",           &SyscallDup2);
+    RegisterSyscall(SC_READ,   "Read",           &SyscallRead);
+    RegisterSyscall(SC_WRITE,  "Write",          &SyscallWrite);
+    RegisterSyscall(SC_PS,     "PrintScheduler", &SyscallPrintScheduler);
+    RegisterSyscall(SC_MMAP,   "Mmap",           &SyscallMmap);
+    RegisterSyscall(SC_MUNMAP, "Munmap",         &SyscallMunmap);
+    RegisterSyscall(SC_MMAP_READ_ONLY, "MmapReadOnly", &SyscallMmapReadOnly);
+    RegisterSyscall(SC_SHM_CREATE, "ShmCreate",    &SyscallShmCreate);
+    RegisterSyscall(SC_SHM_ATTACH, "ShmAttach",    &SyscallShmAttach);
+    RegisterSyscall(SC_SHM_DETACH, "ShmDetach",    &SyscallShmDetach);
+    RegisterSyscall(SC_IO_RING_SETUP, "IoRingSetup", &SyscallIoRingSetup);
+    RegisterSyscall(SC_IO_RING_ENTER, "IoRingEnter", &SyscallIoRingEnter);
+    RegisterSyscall(SC_READV,  "ReadV",          &SyscallReadV);
+    RegisterSyscall(SC_WRITEV, "WriteV",         &SyscallWriteV);
+    RegisterSyscall(SC_SLEEP,  "Sleep",          &SyscallSleep);
+    RegisterSyscall(SC_FSYNC,  "Fsync",          &SyscallFsync);
+    RegisterSyscall(SC_DISK_STATS, "GetDiskStats", &SyscallGetDiskStats);
+    RegisterSyscall(SC_GET_TICKS,  "GetTicks",     &SyscallGetTicks);
+    RegisterSyscall(SC_GET_PROCESSES, "GetProcesses", &SyscallGetProcesses);
+    RegisterSyscall(SC_GET_LIMITS, "GetLimits",    &SyscallGetLimits);
+    RegisterSyscall(SC_SET_LIMITS, "SetLimits",    &SyscallSetLimits);
+    RegisterSyscall(SC_PUNCH_HOLE, "PunchHole",    &SyscallPunchHole);
+    RegisterSyscall(SC_CHECKPOINT, "Checkpoint",   &SyscallCheckpoint);
+    RegisterSyscall(SC_SBRK,   "Sbrk",           &SyscallSbrk);
+    RegisterSyscall(SC_PIPE,   "Pipe",           &SyscallPipe);
+    RegisterSyscall(SC_EXEC_IO, "ExecIO",        &SyscallExecIO);
+    RegisterSyscall(SC_THREAD_FORK,  "ThreadFork",  &SyscallThreadFork);
+    RegisterSyscall(SC_LOCK_CREATE,  "LockCreate",  &SyscallLockCreate);
+    RegisterSyscall(SC_LOCK_ACQUIRE, "LockAcquire", &SyscallLockAcquire);
+    RegisterSyscall(SC_LOCK_RELEASE, "LockRelease", &SyscallLockRelease);
+    RegisterSyscall(SC_SEM_CREATE,   "SemCreate",   &SyscallSemCreate);
+    RegisterSyscall(SC_SEM_WAIT,     "SemWait",     &SyscallSemWait);
+    RegisterSyscall(SC_SEM_SIGNAL,   "SemSignal",   &SyscallSemSignal);
+#ifdef NETWORK
+    ASSERT(MAX_MESSAGE_SIZE == MAX_MAIL_SIZE);
+    RegisterSyscall(SC_BIND,   "Bind",           &SyscallBind);
+    RegisterSyscall(SC_SEND,   "Send",           &SyscallSend);
+    RegisterSyscall(SC_RECEIVE, "Receive",       &SyscallReceive);
+#endif
+
     machine->SetHandler(NO_EXCEPTION,            &DefaultHandler);
     machine->SetHandler(SYSCALL_EXCEPTION,       &SyscallHandler);
     machine->SetHandler(PAGE_FAULT_EXCEPTION,    &PageFaultHandler);
@@ -13,5 +13,10 @@
 /// call, or generates an addressing or arithmetic exception.
 void SetExceptionHandlers();
 
+/// Start the user program of the current thread, whose address space is
+/// already made, passing it `args`: a kernel `argv`-like array, freed here,
+/// or null for no arguments.  Never returns.
+void ExecProcess(void *args);
+
 
 #endif
@@ -5,7 +5,12 @@
 
 
 #include "executable.hh"
+#include "image_cache.hh"
+#include "bin/noff_lz.h"
 #include "machine/endianness.hh"
+#include "threads/system.hh"
+
+#include <string.h>
 
 
 /// Do little endian to big endian conversion on the bytes in the object file
@@ -26,6 +31,32 @@ SwapHeader(noffHeader *h)
     h->uninitData.size        = WordToHost(h->uninitData.size);
     h->uninitData.virtualAddr = WordToHost(h->uninitData.virtualAddr);
     h->uninitData.inFileAddr  = WordToHost(h->uninitData.inFileAddr);
+    h->pageSize               = WordToHost(h->pageSize);
+    h->codePerms              = WordToHost(h->codePerms);
+    h->initDataPerms          = WordToHost(h->initDataPerms);
+    h->uninitDataPerms        = WordToHost(h->uninitDataPerms);
+    h->symbolsInFileAddr      = WordToHost(h->symbolsInFileAddr);
+    h->numSymbols             = WordToHost(h->numSymbols);
+    h->stringsSize            = WordToHost(h->stringsSize);
+    h->compressed             = WordToHost(h->compressed);
+}
+
+/// Files made before the latest fields of the header have their first
+/// segment right after the fields they know of; whatever was read past
+/// them is not part of the header.
+static void
+ClearHeaderTail(noffHeader *h)
+{
+    ASSERT(h != nullptr);
+
+    uint32_t end = sizeof *h;
+    if (h->code.size > 0 && h->code.inFileAddr < end) {
+        end = h->code.inFileAddr;
+    }
+    if (h->initData.size > 0 && h->initData.inFileAddr < end) {
+        end = h->initData.inFileAddr;
+    }
+    memset((char *) h + end, 0, sizeof *h - end);
 }
 
 Executable::Executable(OpenFile *new_file)
@@ -33,17 +64,99 @@ Executable::Executable(OpenFile *new_file)
     ASSERT(new_file != nullptr);
 
     file = new_file;
+    memset(&header, 0, sizeof header);
     file->ReadAt((char *) &header, sizeof header, 0);
+    image = nullptr;
+    blockTables[0] = blockTables[1] = nullptr;
+    block        = nullptr;
+    blockSegment = -1;
+    blockIndex   = 0;
+}
+
+Executable::Executable(OpenFile *new_file, CachedImage *image_)
+{
+    ASSERT(new_file != nullptr);
+    ASSERT(image_ != nullptr);
+
+    file   = new_file;
+    header = image_->header;
+    image  = image_;
+    blockTables[0] = blockTables[1] = nullptr;
+    block        = nullptr;
+    blockSegment = -1;
+    blockIndex   = 0;
+}
+
+Executable::Executable(const Executable &other)
+{
+    file   = other.file;
+    header = other.header;
+    image  = other.image;
+    if (image != nullptr) {
+        imageCache->Attach(image);
+    }
+    blockTables[0] = blockTables[1] = nullptr;
+    block        = nullptr;
+    blockSegment = -1;
+    blockIndex   = 0;
+}
+
+Executable::~Executable()
+{
+    if (image != nullptr) {
+        imageCache->Release(image);
+    }
+    delete [] blockTables[0];
+    delete [] blockTables[1];
+    delete [] block;
 }
 
 bool
 Executable::CheckMagic()
 {
-    if (header.noffMagic != NOFF_MAGIC &&
-          WordToHost(header.noffMagic) == NOFF_MAGIC) {
+    uint32_t swapped = WordToHost(header.noffMagic);
+    if (header.noffMagic != NOFF_MAGIC && header.noffMagic != NOFF_MAGIC_PAGED
+          && (swapped == NOFF_MAGIC || swapped == NOFF_MAGIC_PAGED)) {
         SwapHeader(&header);
     }
-    return header.noffMagic == NOFF_MAGIC;
+    if (header.noffMagic != NOFF_MAGIC
+          && header.noffMagic != NOFF_MAGIC_PAGED) {
+        return false;
+    }
+    ClearHeaderTail(&header);
+    return true;
+}
+
+/// Segments aligned to pages of another size are no better than packed.
+bool
+Executable::IsPageAligned() const
+{
+    return header.noffMagic == NOFF_MAGIC_PAGED
+           && header.pageSize == PAGE_SIZE;
+}
+
+bool
+Executable::IsCodeReadOnly() const
+{
+    return IsPageAligned() && !(header.codePerms & NOFF_WRITE);
+}
+
+bool
+Executable::HasSymbols() const
+{
+    return header.numSymbols > 0;
+}
+
+bool
+Executable::IsCompressed() const
+{
+    return header.compressed != 0;
+}
+
+const noffHeader *
+Executable::GetHeader() const
+{
+    return &header;
 }
 
 uint32_t
@@ -82,6 +195,12 @@ Executable::GetInitDataAddr() const
     return header.initData.virtualAddr;
 }
 
+uint32_t
+Executable::GetUninitDataAddr() const
+{
+    return header.uninitData.virtualAddr;
+}
+
 int
 Executable::ReadCodeBlock(char *dest, uint32_t size, uint32_t offset)
 {
@@ -89,6 +208,16 @@ Executable::ReadCodeBlock(char *dest, uint32_t size, uint32_t offset)
     ASSERT(size != 0);
     ASSERT(offset < header.code.size);
 
+    if (image != nullptr && image->code != nullptr) {
+        if (size > header.code.size - offset) {
+            size = header.code.size - offset;
+        }
+        memcpy(dest, image->code + offset, size);
+        return size;
+    }
+    if (IsCompressed()) {
+        return ReadCompressed(0, dest, size, offset);
+    }
     return file->ReadAt(dest, size, header.code.inFileAddr + offset);
 }
 
@@ -99,5 +228,104 @@ Executable::ReadDataBlock(char *dest, uint32_t size, uint32_t offset)
     ASSERT(size != 0);
     ASSERT(offset < header.initData.size);
 
+    if (image != nullptr && image->data != nullptr) {
+        if (size > header.initData.size - offset) {
+            size = header.initData.size - offset;
+        }
+        memcpy(dest, image->data + offset, size);
+        return size;
+    }
+    if (IsCompressed()) {
+        return ReadCompressed(1, dest, size, offset);
+    }
     return file->ReadAt(dest, size, header.initData.inFileAddr + offset);
 }
+
+int
+Executable::ReadSymbolBlock(char *dest, uint32_t size, uint32_t offset)
+{
+    ASSERT(dest != nullptr);
+    ASSERT(size != 0);
+
+    return file->ReadAt(dest, size, header.symbolsInFileAddr + offset);
+}
+
+/// The offsets must grow, and no block may take more than it expands to.
+const uint32_t *
+Executable::GetBlockTable(unsigned segment)
+{
+    ASSERT(segment < 2);
+
+    if (blockTables[segment] != nullptr) {
+        return blockTables[segment];
+    }
+    const noffSegment *s = segment == 0 ? &header.code : &header.initData;
+    unsigned numBlocks = NoffBlockCount(s->size);
+    uint32_t *table = new uint32_t [numBlocks + 1];
+    unsigned tableSize = (numBlocks + 1) * sizeof *table;
+    if (file->ReadAt((char *) table, tableSize, s->inFileAddr)
+          != (int) tableSize) {
+        delete [] table;
+        return nullptr;
+    }
+    for (unsigned b = 0; b <= numBlocks; b++) {
+        table[b] = WordToHost(table[b]);
+        if (b > 0 && (table[b] < table[b - 1]
+                      || table[b] - table[b - 1] > NOFF_BLOCK_SIZE)) {
+            delete [] table;
+            return nullptr;
+        }
+    }
+    blockTables[segment] = table;
+    return table;
+}
+
+/// Whatever cannot be expanded is left as zeroes, and not counted as read.
+int
+Executable::ReadCompressed(unsigned segment, char *dest, uint32_t size,
+                           uint32_t offset)
+{
+    ASSERT(segment < 2);
+
+    const noffSegment *s = segment == 0 ? &header.code : &header.initData;
+    if (size > s->size - offset) {
+        size = s->size - offset;
+    }
+    memset(dest, 0, size);
+    const uint32_t *table = GetBlockTable(segment);
+    if (table == nullptr) {
+        DEBUG('a', "Damaged block table in a compressed segment.\n");
+        return 0;
+    }
+    if (block == nullptr) {
+        block = new char [NOFF_BLOCK_SIZE];
+    }
+
+    uint32_t done = 0;
+    while (done < size) {
+        unsigned b     = (offset + done) / NOFF_BLOCK_SIZE;
+        unsigned start = b * NOFF_BLOCK_SIZE;
+        unsigned length = s->size - start < NOFF_BLOCK_SIZE
+                          ? s->size - start : NOFF_BLOCK_SIZE;
+        if (blockSegment != (int) segment || blockIndex != b) {
+            char stored[NOFF_BLOCK_SIZE];
+            unsigned n = table[b + 1] - table[b];
+            blockSegment = -1;
+            if (file->ReadAt(n == length ? block : stored, n,
+                             s->inFileAddr + table[b]) != (int) n
+                  || (n != length
+                      && !NoffLzExpand(stored, n, block, length))) {
+                DEBUG('a', "Damaged block %u in a compressed segment.\n", b);
+                return done;
+            }
+            blockSegment = segment;
+            blockIndex   = b;
+        }
+        unsigned from = offset + done - start;
+        unsigned count = length - from < size - done
+                         ? length - from : size - done;
+        memcpy(dest + done, block + from, count);
+        done += count;
+    }
+    return done;
+}
@@ -20,11 +20,25 @@
 #include "filesys/open_file.hh"
 
 
+class CachedImage;
+
+
 /// Assumes that the object code file is in NOFF format.
 class Executable {
 public:
+    /// Read the header of `new_file`.
     Executable(OpenFile *new_file);
 
+    /// Use `image`, already acquired from the image cache, for the header
+    /// and, if present, the contents of `new_file`; nothing is read until
+    /// the image turns out not to hold the segments.  The image is
+    /// released with the executable.
+    Executable(OpenFile *new_file, CachedImage *image);
+
+    Executable(const Executable &other);
+
+    ~Executable();
+
     /// Check if the executable is valid and fix endianness if necessary.
     ///
     /// Check if the executable conforms to the NOFF file format by checking
@@ -33,6 +47,26 @@ public:
     /// entire header.
     bool CheckMagic();
 
+    /// Return the header; only meaningful after `CheckMagic`.
+    const noffHeader *GetHeader() const;
+
+    /// Return whether the segments start on page boundaries, in memory and
+    /// in the file, as laid out by `coff2noff -p`.
+    bool IsPageAligned() const;
+
+    /// Return whether the code pages hold nothing but code, and may not
+    /// be written, so that they can be mapped read-only and shared.
+    bool IsCodeReadOnly() const;
+
+    /// Return whether the file carries a symbol table, as embedded by
+    /// `coff2noff -s`.
+    bool HasSymbols() const;
+
+    /// Return whether the code and initialized data segments are stored
+    /// compressed, as by `coff2noff -z`.  Reading them is the same either
+    /// way: blocks are expanded as they are read.
+    bool IsCompressed() const;
+
     uint32_t GetSize() const;
     uint32_t GetCodeSize() const;
     uint32_t GetInitDataSize() const;
@@ -62,9 +96,33 @@ public:
     int ReadCodeBlock(char *dest, uint32_t size, uint32_t offset);
     int ReadDataBlock(char *dest, uint32_t size, uint32_t offset);
 
+    /// Read a block of the symbol table, its entries followed by their
+    /// names, in the byte order of the file.
+    int ReadSymbolBlock(char *dest, uint32_t size, uint32_t offset);
+
 private:
     OpenFile *file;
     noffHeader header;
+
+    /// Where the segments were cached, or null.
+    CachedImage *image;
+
+    /// For compressed segments, the table of each, code and data, once
+    /// read, and the block expanded last, so that the pages of a block
+    /// loaded piecemeal expand it only once.
+    uint32_t *blockTables[2];
+    char *block;
+    int blockSegment;  ///< Which segment `block` holds one of, or -1.
+    unsigned blockIndex;
+
+    /// Read the table of `segment`; return null if it is damaged.
+    const uint32_t *GetBlockTable(unsigned segment);
+
+    /// Like `ReadCodeBlock` and `ReadDataBlock`, for a compressed segment.
+    int ReadCompressed(unsigned segment, char *dest, uint32_t size,
+                       uint32_t offset);
+
+    Executable &operator=(const Executable &);
 };
 
 
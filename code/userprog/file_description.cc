@@ -0,0 +1,107 @@
+/// Routines for open files as held by user programs.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "file_description.hh"
+#include "address_space.hh"
+#include "threads/system.hh"
+
+
+FileDescription::FileDescription(OpenFile *file_)
+{
+    ASSERT(file_ != nullptr);
+
+    file       = file_;
+    references = 1;
+}
+
+FileDescription::~FileDescription()
+{
+    ASSERT(references == 0);
+}
+
+FileDescription *
+FileDescription::Duplicate()
+{
+    references++;
+    return this;
+}
+
+void
+FileDescription::Release(AddressSpace *space)
+{
+    ASSERT(references > 0);
+
+    if (--references > 0) {
+        return;
+    }
+#ifdef VMEM
+    // A mapped file stays open until unmapped.
+    if (space == nullptr || !space->AdoptFile(file))
+#endif
+    delete file;
+    delete this;
+}
+
+OpenFile *
+FileDescription::GetFile() const
+{
+    return file;
+}
+
+bool
+FileDescription::IsShared() const
+{
+    return references > 1;
+}
+
+FileDescription *
+FindOpenFile(int fid)
+{
+    if (fid < 2 || !currentThread->openFiles->HasKey(fid - 2)) {
+        return nullptr;
+    }
+    return currentThread->openFiles->Get(fid - 2);
+}
+
+bool
+InheritOpenFiles(Thread *child)
+{
+    ASSERT(child != nullptr);
+
+    const Table<FileDescription *> *files = currentThread->openFiles;
+    for (unsigned i = 0; i < files->Capacity(); i++) {
+        if (!files->HasKey(i)) {
+            continue;
+        }
+        FileDescription *description = files->Get(i);
+#ifdef VMEM
+        if (currentThread->space->IsMapped(description->GetFile())) {
+            continue;
+        }
+#endif
+        if (!child->openFiles->AddAt(i, description->Duplicate())) {
+            description->Release(currentThread->space);  // Not the last.
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+CloseAllOpenFiles(Thread *thread)
+{
+    ASSERT(thread != nullptr);
+
+    if (thread->openFiles == nullptr) {
+        return;  // Lent by another thread, as to the workers of a ring.
+    }
+    for (unsigned i = 0; i < thread->openFiles->Capacity(); i++) {
+        if (thread->openFiles->HasKey(i)) {
+            thread->openFiles->Remove(i)->Release(thread->space);
+        }
+    }
+}
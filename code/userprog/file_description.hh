@@ -0,0 +1,65 @@
+/// Data structures for open files as held by user programs.
+///
+/// An open file has a position, which every read and write moves along.
+/// Each process tells its open files by identifiers from 2 on, but what an
+/// identifier stands for is a `FileDescription`, which several identifiers
+/// may share, in one process or in several: those made by `Dup` and
+/// `Dup2`, and those a program started by `Exec` inherits.  They all read
+/// and write through the same `OpenFile`, at the same position, and it is
+/// closed once the last of them is.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_FILEDESCRIPTION__HH
+#define NACHOS_USERPROG_FILEDESCRIPTION__HH
+
+
+class AddressSpace;
+class OpenFile;
+class Thread;
+
+/// An open file, shared by the identifiers that stand for it.
+class FileDescription {
+public:
+
+    /// Stand for `file`, for one identifier.
+    FileDescription(OpenFile *file);
+
+    /// Count one more identifier for the file; return the description.
+    FileDescription *Duplicate();
+
+    /// Let go of one identifier, of a process running in `space`.  The
+    /// last one closes the file, unless `space` has it mapped, in which
+    /// case the space closes it once unmapped.
+    void Release(AddressSpace *space);
+
+    OpenFile *GetFile() const;
+
+    /// Whether more than one identifier stands for the file.
+    bool IsShared() const;
+
+private:
+    /// Only `Release` deletes descriptions.
+    ~FileDescription();
+
+    OpenFile *file;
+    unsigned references;
+};
+
+/// Return the open file `fid` stands for in the current thread, or null if
+/// it stands for none.
+FileDescription *FindOpenFile(int fid);
+
+/// Give `child` the open files of the current thread, with the same
+/// identifiers, for `Exec`.  Files mapped by the current thread's space
+/// are left out: closing them is up to that space.  Return false if there
+/// is no memory left for them.
+bool InheritOpenFiles(Thread *child);
+
+/// Close every open file of `thread`, for its exit.
+void CloseAllOpenFiles(Thread *thread);
+
+
+#endif
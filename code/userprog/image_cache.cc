@@ -0,0 +1,202 @@
+/// Routines to keep executables read and parsed between `Exec`s.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "image_cache.hh"
+#include "executable.hh"
+#include "symbol_table.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+ImageCache::ImageCache()
+{
+    list      = nullptr;
+    numImages = 0;
+}
+
+/// Images still in use belong to executables that are never destroyed,
+/// because the machine halted under them.
+ImageCache::~ImageCache()
+{
+    while (list != nullptr) {
+        CachedImage *image = list;
+        list = image->next;
+        Delete(image);
+    }
+}
+
+CachedImage *
+ImageCache::Acquire(OpenFile *file, const char *name)
+{
+    ASSERT(file != nullptr);
+
+    int sector = file->GetSector();
+    if (name != nullptr) {
+        for (CachedImage **link = &list; *link != nullptr;
+             link = &(*link)->next) {
+            CachedImage *image = *link;
+            if (image->sector == sector && strcmp(image->name, name) == 0) {
+                // Move it to the front.
+                *link = image->next;
+                image->next = list;
+                list = image;
+                image->users++;
+                stats->numImageHits++;
+                DEBUG('a', "Executable `%s` found in the image cache\n", name);
+                return image;
+            }
+        }
+    }
+
+    CachedImage *image = Read(file);
+    if (image == nullptr || name == nullptr) {
+        return image;
+    }
+    stats->numImageMisses++;
+
+    image->name = new char [strlen(name) + 1];
+    strcpy(image->name, name);
+    image->sector = sector;
+    image->next = list;
+    list = image;
+    numImages++;
+
+    // Forget the least recently used image if there are too many.
+    if (numImages > MAX_IMAGES) {
+        CachedImage **link = &list;
+        while ((*link)->next != nullptr) {
+            link = &(*link)->next;
+        }
+        CachedImage *last = *link;
+        *link = nullptr;
+        numImages--;
+        delete [] last->name;
+        last->name = nullptr;
+        if (last->users == 0) {
+            Delete(last);
+        }
+    }
+    return image;
+}
+
+void
+ImageCache::Attach(CachedImage *image)
+{
+    ASSERT(image != nullptr);
+    ASSERT(image->users > 0);
+
+    image->users++;
+}
+
+void
+ImageCache::Release(CachedImage *image)
+{
+    ASSERT(image != nullptr);
+    ASSERT(image->users > 0);
+
+    // Cached images stay around after their last user, for the next one.
+    if (--image->users == 0 && image->name == nullptr) {
+        Delete(image);
+    }
+}
+
+void
+ImageCache::Invalidate(const char *name, int sector)
+{
+    CachedImage **link = &list;
+    while (*link != nullptr) {
+        CachedImage *image = *link;
+        if ((sector != -1 && image->sector == sector)
+              || (name != nullptr && strcmp(image->name, name) == 0)) {
+            DEBUG('a', "Dropping executable `%s` from the image cache\n",
+                  image->name);
+            *link = image->next;
+            numImages--;
+            delete [] image->name;
+            image->name = nullptr;
+            if (image->users == 0) {
+                Delete(image);
+            }
+        } else {
+            link = &image->next;
+        }
+    }
+}
+
+CachedImage *
+ImageCache::Read(OpenFile *file)
+{
+    Executable exe (file);
+    if (!exe.CheckMagic()) {
+        return nullptr;
+    }
+
+    CachedImage *image = new CachedImage;
+    image->name    = nullptr;
+    image->sector  = -1;
+    image->header  = *exe.GetHeader();
+    image->code    = nullptr;
+    image->data    = nullptr;
+    image->symbols = SymbolTable::Read(&exe);
+    image->traceLength = 0;
+    image->users   = 1;
+    image->next    = nullptr;
+
+#ifdef FILESYS
+    // The segments are read through the page cache, with every other file.
+    return image;
+#else
+    uint32_t codeSize = exe.GetCodeSize();
+    uint32_t dataSize = exe.GetInitDataSize();
+    if (codeSize > MAX_IMAGE_SIZE || dataSize > MAX_IMAGE_SIZE - codeSize) {
+        return image;
+    }
+
+    // Whatever a truncated file lacks reads as zeros, as it would from
+    // `exe` itself into freshly cleared pages.
+    if (codeSize > 0) {
+        image->code = new char [codeSize];
+        memset(image->code, 0, codeSize);
+        exe.ReadCodeBlock(image->code, codeSize, 0);
+    }
+    if (dataSize > 0) {
+        image->data = new char [dataSize];
+        memset(image->data, 0, dataSize);
+        exe.ReadDataBlock(image->data, dataSize, 0);
+    }
+    return image;
+#endif
+}
+
+void
+ImageCache::Delete(CachedImage *image)
+{
+    ASSERT(image != nullptr);
+
+    delete [] image->name;
+    delete [] image->code;
+    delete [] image->data;
+    delete image->symbols;
+    delete image;
+}
+
+void
+InvalidateImage(const char *name, int sector)
+{
+    if (imageCache != nullptr) {
+        imageCache->Invalidate(name, sector);
+    }
+#ifdef VMEM
+    if (sharedFileTable != nullptr) {
+        sharedFileTable->Invalidate(name, sector);
+    }
+    if (textTable != nullptr) {
+        textTable->Invalidate(name, sector);
+    }
+#endif
+}
@@ -0,0 +1,121 @@
+/// Data structures to keep executables read and parsed between `Exec`s.
+///
+/// Programs are often run over and over again, and each run would read the
+/// NOFF header, check it, and read the code and initialized data segments
+/// from the file once more.  Instead, the kernel keeps the parsed header and
+/// a copy of both segments of the latest executables it loaded, and serves
+/// further loads of the same file from memory.
+///
+/// With the real file system, only the header is kept: the segments are
+/// read through the page cache, which keeps the blocks of executables and
+/// of every other file alike, for loading and page faults.
+///
+/// Images are identified by file name and, with the real file system, by
+/// the sector of the file header.  The file system forgets the image of a
+/// file whenever that file is written, created again or removed, through
+/// `InvalidateImage`; address spaces still being loaded from it keep their
+/// now stale copy until they release it.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_IMAGECACHE__HH
+#define NACHOS_USERPROG_IMAGECACHE__HH
+
+
+#include "bin/noff.h"
+
+
+class OpenFile;
+class SymbolTable;
+
+/// Most executable images kept at once.
+const unsigned MAX_IMAGES = 8;
+
+/// Largest code plus initialized data kept in memory for one executable;
+/// bigger ones only have their header kept.
+const unsigned MAX_IMAGE_SIZE = 64 * 1024;
+
+/// Most pages recorded of the first page faults of an executable.
+const unsigned MAX_TRACE_PAGES = 16;
+
+/// The parsed contents of one executable.
+class CachedImage {
+public:
+
+    /// Name the executable was opened with, or null if it is not in the
+    /// cache.
+    char *name;
+
+    /// Sector of the file header, or -1 with the stub file system.
+    int sector;
+
+    /// Header, already checked and in host byte order.
+    noffHeader header;
+
+    /// Contents of the code and initialized data segments, or null if the
+    /// executable is too big to be kept, or with the real file system.
+    char *code;
+    char *data;
+
+    /// Procedures of the program, or null if the file carries none.
+    SymbolTable *symbols;
+
+    /// Pages backed by the executable that the first run from this image
+    /// faulted in, in order, so that later runs can load them ahead of
+    /// time; `traceLength` is 0 until that run has recorded them.
+    unsigned trace[MAX_TRACE_PAGES];
+    unsigned traceLength;
+
+    /// Number of executables using this image.
+    unsigned users;
+
+    CachedImage *next;
+};
+
+class ImageCache {
+public:
+
+    ImageCache();
+
+    ~ImageCache();
+
+    /// Return the image of `file`, opened as `name`, reading and caching it
+    /// if necessary, or null if the file is not a NOFF executable.
+    ///
+    /// A null `name` reads an image that is not cached.  The image must be
+    /// given back with `Release`.
+    CachedImage *Acquire(OpenFile *file, const char *name);
+
+    /// Start using `image` once more.
+    void Attach(CachedImage *image);
+
+    /// Stop using `image`; if it is no longer cached, it goes away with its
+    /// last user.
+    void Release(CachedImage *image);
+
+    /// Forget the images of the file called `name`, and of the file whose
+    /// header is at `sector`; either may be null or -1.
+    void Invalidate(const char *name, int sector);
+
+private:
+
+    /// Read the image of `file` anew.
+    static CachedImage *Read(OpenFile *file);
+
+    static void Delete(CachedImage *image);
+
+    /// Cached images, the most recently used first.
+    CachedImage *list;
+    unsigned numImages;
+};
+
+/// Tell the image cache, if there is one, that the file called `name`, or
+/// the one whose header is at `sector`, has changed.  So are the pages of
+/// the file shared by read-only mappings, and the code shared by the
+/// processes running it.
+void InvalidateImage(const char *name, int sector);
+
+
+#endif
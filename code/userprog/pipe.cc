@@ -0,0 +1,212 @@
+/// Routines for pipes between user programs.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "pipe.hh"
+#include "syscall.h"
+#include "transfer.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+PipeBuffer::PipeBuffer()
+{
+    head    = 0;
+    count   = 0;
+    readers = 0;
+    writers = 0;
+
+    lock     = new Lock("pipe");
+    notEmpty = new Condition("pipe not empty", lock);
+    notFull  = new Condition("pipe not full", lock);
+}
+
+PipeBuffer::~PipeBuffer()
+{
+    ASSERT(readers == 0 && writers == 0);
+
+    delete notFull;
+    delete notEmpty;
+    delete lock;
+}
+
+/// What is read is taken in at most two copies, one for each side of the
+/// wrap of the ring.
+unsigned
+PipeBuffer::Read(char *into, unsigned size, bool wait)
+{
+    ASSERT(into != nullptr);
+
+    lock->Acquire();
+    while (wait && count == 0 && writers > 0) {
+        notEmpty->Wait();
+    }
+
+    unsigned n = count < size ? count : size;
+    unsigned first = SIZE - head < n ? SIZE - head : n;
+    memcpy(into, &buffer[head], first);
+    memcpy(into + first, buffer, n - first);
+    head   = (head + n) % SIZE;
+    count -= n;
+    if (n > 0) {
+        notFull->Broadcast();
+    }
+    lock->Release();
+    return n;
+}
+
+unsigned
+PipeBuffer::Write(const char *from, unsigned size)
+{
+    ASSERT(from != nullptr);
+
+    lock->Acquire();
+    unsigned done = 0;
+    while (done < size && readers > 0) {
+        if (count == SIZE) {
+            notFull->Wait();
+            continue;
+        }
+        unsigned tail = (head + count) % SIZE;
+        unsigned room = SIZE - count;
+        unsigned n = size - done < room ? size - done : room;
+        unsigned first = SIZE - tail < n ? SIZE - tail : n;
+        memcpy(&buffer[tail], from + done, first);
+        memcpy(buffer, from + done + first, n - first);
+        count += n;
+        done  += n;
+        notEmpty->Broadcast();
+    }
+    lock->Release();
+    return done;
+}
+
+void
+PipeBuffer::OpenEnd(bool writing)
+{
+    lock->Acquire();
+    if (writing) {
+        writers++;
+    } else {
+        readers++;
+    }
+    lock->Release();
+}
+
+/// Whoever waits for the other side is woken up to find it gone.
+bool
+PipeBuffer::CloseEnd(bool writing)
+{
+    lock->Acquire();
+    if (writing) {
+        ASSERT(writers > 0);
+        if (--writers == 0) {
+            notEmpty->Broadcast();
+        }
+    } else {
+        ASSERT(readers > 0);
+        if (--readers == 0) {
+            notFull->Broadcast();
+        }
+    }
+    bool last = readers == 0 && writers == 0;
+    lock->Release();
+    return last;
+}
+
+PipeEnd::PipeEnd(PipeBuffer *pipe_, bool writing_)
+{
+    ASSERT(pipe_ != nullptr);
+
+    pipe    = pipe_;
+    writing = writing_;
+    pipe->OpenEnd(writing);
+}
+
+PipeEnd::~PipeEnd()
+{
+    if (pipe->CloseEnd(writing)) {
+        delete pipe;
+    }
+}
+
+PipeEnd *
+PipeEnd::Duplicate() const
+{
+    return new PipeEnd(pipe, writing);
+}
+
+bool
+PipeEnd::IsWriting() const
+{
+    return writing;
+}
+
+/// Where a transfer from a pipe is; a read only waits for its first byte.
+struct PipeTransfer {
+    PipeBuffer *pipe;
+    unsigned done;
+};
+
+static unsigned
+ReadPipeChunk(char *chunk, unsigned count, void *arg)
+{
+    PipeTransfer *t = (PipeTransfer *) arg;
+    unsigned n = t->pipe->Read(chunk, count, t->done == 0);
+    t->done += n;
+    return n;
+}
+
+static unsigned
+WritePipeChunk(char *chunk, unsigned count, void *arg)
+{
+    return ((PipeTransfer *) arg)->pipe->Write(chunk, count);
+}
+
+int
+PipeEnd::Transfer(int userAddress, unsigned size, bool reading)
+{
+    if (reading == writing) {
+        return -1;
+    }
+
+    PipeTransfer t = { pipe, 0 };
+    return TransferUser(userAddress, size, !reading,
+                        reading ? ReadPipeChunk : WritePipeChunk, &t);
+}
+
+PipeEnd *
+FindPipeEnd(int fid)
+{
+    if (fid == CONSOLE_INPUT) {
+        return currentThread->consoleInput;
+    }
+    if (fid == CONSOLE_OUTPUT) {
+        return currentThread->consoleOutput;
+    }
+    if (fid < FIRST_PIPE_ID
+          || !currentThread->pipeEnds->HasKey(fid - FIRST_PIPE_ID)) {
+        return nullptr;
+    }
+    return currentThread->pipeEnds->Get(fid - FIRST_PIPE_ID);
+}
+
+void
+CloseAllPipeEnds(Thread *thread)
+{
+    ASSERT(thread != nullptr);
+
+    for (unsigned i = 0; i < thread->pipeEnds->Capacity(); i++) {
+        if (thread->pipeEnds->HasKey(i)) {
+            delete thread->pipeEnds->Remove(i);
+        }
+    }
+    delete thread->consoleInput;
+    delete thread->consoleOutput;
+    thread->consoleInput  = nullptr;
+    thread->consoleOutput = nullptr;
+}
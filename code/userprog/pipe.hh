@@ -0,0 +1,105 @@
+/// Data structures for pipes between user programs.
+///
+/// A pipe is a bounded ring buffer in the kernel, with a read end and a
+/// write end.  Reading waits until there is something to read, and returns
+/// what there is; writing waits for room until everything is written.
+/// Once every write end is closed, reads of an empty pipe return 0, the end
+/// of the input; once every read end is closed, writes fail.  Data moves
+/// straight between the ring and the frames of the programs, so streaming
+/// through a pipe never touches the disk.
+///
+/// Each process keeps its pipe ends in a table of its own, apart from its
+/// open files, and tells them by identifiers from `FIRST_PIPE_ID` on.  A
+/// process may also have pipe ends standing for its console input and
+/// output, given to it by `ExecIO`.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_PIPE__HH
+#define NACHOS_USERPROG_PIPE__HH
+
+
+#include "threads/condition.hh"
+#include "threads/lock.hh"
+
+
+class Thread;
+
+/// First identifier of a pipe end, well past those of open files.
+const int FIRST_PIPE_ID = 1 << 20;
+
+/// The buffer of a pipe, shared by its ends.
+class PipeBuffer {
+public:
+
+    /// Bytes a pipe holds.
+    static const unsigned SIZE = 512;
+
+    /// Create a pipe with no ends.
+    PipeBuffer();
+
+    ~PipeBuffer();
+
+    /// Copy up to `size` bytes into `buffer`; if `wait`, wait first until
+    /// there is at least one, unless no write end is left.  Return the
+    /// number of bytes read.
+    unsigned Read(char *buffer, unsigned size, bool wait);
+
+    /// Copy the `size` bytes of `buffer` in, waiting for room as needed.
+    /// Return the number of bytes written, fewer if no read end is left.
+    unsigned Write(const char *buffer, unsigned size);
+
+    /// Count an end more, or one less; return whether none is left.
+    void OpenEnd(bool writing);
+    bool CloseEnd(bool writing);
+
+private:
+    char buffer[SIZE];
+    unsigned head;   ///< Oldest byte.
+    unsigned count;  ///< Bytes held.
+
+    unsigned readers;
+    unsigned writers;
+
+    Lock *lock;
+    Condition *notEmpty;
+    Condition *notFull;
+};
+
+/// One end of a pipe, as held by a process.
+class PipeEnd {
+public:
+
+    /// Open the read end of `pipe`, or the write end if `writing`.
+    PipeEnd(PipeBuffer *pipe, bool writing);
+
+    /// Close the end, and delete the pipe if it was the last.
+    ~PipeEnd();
+
+    /// Open another end like this one, for another process.
+    PipeEnd *Duplicate() const;
+
+    bool IsWriting() const;
+
+    /// Move `size` bytes between user memory at `userAddress` and the pipe.
+    /// Return the number of bytes moved, or -1 if this end does not go that
+    /// way.
+    int Transfer(int userAddress, unsigned size, bool reading);
+
+private:
+    PipeBuffer *pipe;
+    bool writing;
+};
+
+/// Return the pipe end `fid` stands for in the current process: a pipe
+/// end of its own, or the one its console input or output goes to.
+/// Return null if `fid` is neither, or the console is not redirected.
+PipeEnd *FindPipeEnd(int fid);
+
+/// Close every pipe end of `thread`, for its exit.
+void CloseAllPipeEnds(Thread *thread);
+
+
+#endif
@@ -0,0 +1,135 @@
+/// Routines to profile user programs by sampling.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "profiler.hh"
+#include "image_cache.hh"
+#include "symbol_table.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+Profiler::Profiler(unsigned period_)
+{
+    ASSERT(period_ > 0);
+
+    period      = period_;
+    countdown   = period;
+    first       = nullptr;
+    last        = nullptr;
+    numProfiles = 0;
+}
+
+Profiler::~Profiler()
+{
+    while (first != nullptr) {
+        ProcessProfile *p = first;
+        first = p->next;
+        imageCache->Release(p->image);
+        delete [] p->counts;
+        delete p;
+    }
+}
+
+ProcessProfile *
+Profiler::Open(const char *program, uint32_t codeStart, uint32_t codeEnd,
+               CachedImage *image)
+{
+    ASSERT(codeStart <= codeEnd);
+    ASSERT(image != nullptr);
+
+    ProcessProfile *p = new ProcessProfile;
+    p->id = numProfiles++;
+    strncpy(p->program, program != nullptr ? program : "?",
+            ProcessProfile::NAME_SIZE - 1);
+    p->program[ProcessProfile::NAME_SIZE - 1] = '\0';
+    p->codeStart       = codeStart;
+    p->numInstructions = (codeEnd - codeStart) / 4;
+    p->counts          = new unsigned long [p->numInstructions];
+    memset(p->counts, 0, p->numInstructions * sizeof *p->counts);
+    p->samples = 0;
+    p->outside = 0;
+    p->image   = image;
+    p->next    = nullptr;
+    imageCache->Attach(image);
+
+    if (last == nullptr) {
+        first = p;
+    } else {
+        last->next = p;
+    }
+    last = p;
+    return p;
+}
+
+/// The program counter is that of the instruction to run next.  Ticks of
+/// threads without a profile, such as those of address spaces made before
+/// the profiler, are not counted.
+void
+Profiler::Sample()
+{
+    countdown = period;
+
+    if (currentThread->space == nullptr) {
+        return;
+    }
+    ProcessProfile *p = currentThread->space->GetProfile();
+    if (p == nullptr) {
+        return;
+    }
+
+    uint32_t pc = machine->ReadRegister(PC_REG);
+    p->samples++;
+    if (pc >= p->codeStart && (pc - p->codeStart) / 4 < p->numInstructions) {
+        p->counts[(pc - p->codeStart) / 4]++;
+    } else {
+        p->outside++;
+    }
+}
+
+/// Each process is written as a line
+///
+///     process <id> <samples> <outside code> <program>
+///
+/// followed by a line with the address and count of every instruction
+/// sampled, in hexadecimal and decimal respectively, and, if the program
+/// has symbols, the procedure and offset it lies at.
+bool
+Profiler::Dump(const char *fileName) const
+{
+    ASSERT(fileName != nullptr);
+
+    FILE *f = fopen(fileName, "w");
+    if (f == nullptr) {
+        return false;
+    }
+
+    fprintf(f, "# Nachos PC samples, one every %u user ticks.\n", period);
+    for (const ProcessProfile *p = first; p != nullptr; p = p->next) {
+        fprintf(f, "process %u %lu %lu %s\n",
+                p->id, p->samples, p->outside, p->program);
+        const SymbolTable *symbols = p->image->symbols;
+        for (unsigned i = 0; i < p->numInstructions; i++) {
+            if (p->counts[i] == 0) {
+                continue;
+            }
+            uint32_t address = p->codeStart + 4 * i;
+            fprintf(f, "%08X %lu", (unsigned) address, p->counts[i]);
+            uint32_t offset;
+            const char *name = symbols == nullptr
+                               ? nullptr : symbols->Lookup(address, &offset);
+            if (name != nullptr) {
+                fprintf(f, " %s+0x%X", name, (unsigned) offset);
+            }
+            fprintf(f, "\n");
+        }
+    }
+
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
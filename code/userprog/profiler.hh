@@ -0,0 +1,100 @@
+/// Data structures to profile user programs by sampling.
+///
+/// Every `period` user instructions, the program counter of the user
+/// program running is taken as a sample, and counted in a histogram of the
+/// code segment of its process, one bucket per instruction.  Each process
+/// has a histogram of its own, kept until Nachos halts even if the process
+/// is gone by then.  Counting a sample is a subtraction on every user tick,
+/// and an increment once per period.
+///
+/// When Nachos halts, the samples are written out with their addresses, and
+/// `bin/profile` maps them to the procedures of the COFF executable the
+/// programs were converted from, as a flat profile or as folded stacks.
+/// Executables carrying a symbol table have their samples written with the
+/// procedure they fall in, too, and can be given to `bin/profile` as well.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_PROFILER__HH
+#define NACHOS_USERPROG_PROFILER__HH
+
+
+#include <stdint.h>
+
+
+class CachedImage;
+
+/// The samples taken of one process.
+class ProcessProfile {
+public:
+
+    /// Longest program name kept, including the terminating null.
+    static const unsigned NAME_SIZE = 64;
+
+    unsigned id;  ///< Processes are numbered as they start.
+    char program[NAME_SIZE];
+
+    /// Addresses of the code segment, and samples of each instruction.
+    uint32_t codeStart;
+    unsigned numInstructions;
+    unsigned long *counts;
+
+    /// Samples taken, and those whose program counter was out of the
+    /// code segment.
+    unsigned long samples;
+    unsigned long outside;
+
+    /// The image of the program, kept for its symbols until the samples
+    /// are written.
+    CachedImage *image;
+
+    ProcessProfile *next;
+};
+
+class Profiler {
+public:
+
+    /// User instructions between samples, unless told otherwise.
+    static const unsigned DEFAULT_PERIOD = 100;
+
+    /// Initialize a profiler taking a sample every `period` user ticks.
+    Profiler(unsigned period = DEFAULT_PERIOD);
+
+    ~Profiler();
+
+    /// Start a histogram for a process running `program`, loaded from
+    /// `image`, whose code lies from `codeStart` to `codeEnd`.
+    ProcessProfile *Open(const char *program, uint32_t codeStart,
+                         uint32_t codeEnd, CachedImage *image);
+
+    /// Count a user tick, and take a sample if one is due.  Called by the
+    /// interrupt emulation on every user tick.
+    void Tick()
+    {
+        if (--countdown == 0) {
+            Sample();
+        }
+    }
+
+    /// Write the samples of every process into `fileName`.  Return false
+    /// if the file cannot be written.
+    bool Dump(const char *fileName) const;
+
+private:
+
+    /// Count the program counter of the running user program.
+    void Sample();
+
+    unsigned period;
+    unsigned countdown;  ///< User ticks left until the next sample.
+
+    /// Every process profiled, in the order they started.
+    ProcessProfile *first;
+    ProcessProfile *last;
+    unsigned numProfiles;
+};
+
+
+#endif
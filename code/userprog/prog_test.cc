@@ -1,7 +1,8 @@
 /// Test routines for demonstrating that Nachos can load a user program and
 /// execute it.
 ///
-/// Also, routines for testing the Console hardware device.
+/// Also, routines for testing the Console hardware device, and the
+/// multiplication of the simulated processor.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2021 Docentes de la Universidad Nacional de Rosario.
@@ -11,6 +12,7 @@
 
 #include "address_space.hh"
 #include "machine/console.hh"
+#include "machine/mips_core.hh"
 #include "threads/semaphore.hh"
 #include "threads/system.hh"
 
@@ -31,7 +33,15 @@ StartProcess(const char *filename)
         return;
     }
 
-    AddressSpace *space = new AddressSpace(executable);
+    AddressSpace *space = new AddressSpace(executable, filename);
+    if (!space->IsReady()) {
+        printf("Unable to set up the address space of %s\n", filename);
+        delete space;
+#ifndef DEMAND_LOADING
+        delete executable;
+#endif
+        return;
+    }
     currentThread->space = space;
 
 #ifndef DEMAND_LOADING
@@ -40,6 +50,7 @@ StartProcess(const char *filename)
 
     space->InitRegisters();  // Set the initial register values.
     space->RestoreState();   // Load page table register.
+    space->UpdateInfoPage();
 
     machine->Run();  // Jump to the user progam.
     ASSERT(false);   // `machine->Run` never returns; the address space
@@ -92,3 +103,122 @@ ConsoleTest(const char *in, const char *out)
         }
     }
 }
+
+/// Reference implementation of R2000 multiplication, computing the
+/// double-length product one bit at a time.
+///
+/// The simulator used to multiply this way; it is only kept to check
+/// `MipsMult` against it.
+static void
+MultShiftAdd(int a, int b, bool signedArith, int *hiPtr, int *loPtr)
+{
+    ASSERT(hiPtr != nullptr);
+    ASSERT(loPtr != nullptr);
+
+    if (a == 0 || b == 0) {
+        *hiPtr = *loPtr = 0;
+        return;
+    }
+
+    // Compute the sign of the result, then make everything positive so
+    // unsigned computation can be done in the main loop.
+    bool negative = false;
+    if (signedArith) {
+        if (a < 0) {
+            negative = !negative;
+            a = -a;
+        }
+        if (b < 0) {
+            negative = !negative;
+            b = -b;
+        }
+    }
+
+    // Compute the result in unsigned arithmetic (check `a`'s bits one at a
+    // time, and add in a shifted value of `b`).
+    unsigned bLo = b;
+    unsigned bHi = 0;
+    unsigned lo = 0;
+    unsigned hi = 0;
+    for (unsigned i = 0; i < 32; i++) {
+        if (a & 1) {
+            lo += bLo;
+            if (lo < bLo) {  // Carry out of the low bits?
+                hi += 1;
+            }
+            hi += bHi;
+            if ((a & 0xFFFFFFFE) == 0) {
+                break;
+            }
+        }
+        bHi <<= 1;
+        if (bLo & 0x80000000) {
+            bHi |= 1;
+        }
+
+        bLo <<= 1;
+        a >>= 1;
+    }
+
+    // If the result is supposed to be negative, compute the two's complement
+    // of the double-word result.
+    if (negative) {
+        hi = ~hi;
+        lo = ~lo;
+        lo++;
+        if (lo == 0) {
+            hi++;
+        }
+    }
+
+    *hiPtr = (int) hi;
+    *loPtr = (int) lo;
+}
+
+/// Check that `MipsMult`, which the simulator multiplies with, produces bit
+/// for bit the same `HI`/`LO` pair as the shift-and-add routine it
+/// replaced, and print how many operand pairs disagree.
+///
+/// Operands are corner cases (zero, one, sign boundaries) combined with
+/// each other, followed by a fixed pseudo-random sequence.
+void
+MultTest()
+{
+    static const int CORNERS[] = {
+        0, 1, -1, 2, -2, 3, 0x7FFF, 0x8000, 0xFFFF, 0x10000,
+        0x7FFFFFFF, (int) 0x80000000, (int) 0x80000001, (int) 0xFFFFFFFE,
+        0x55555555, (int) 0xAAAAAAAA, 12345678, -12345678
+    };
+    const unsigned NUM_CORNERS = sizeof CORNERS / sizeof CORNERS[0];
+    const unsigned NUM_RANDOM = 1024;
+
+    unsigned seed = 1;
+    unsigned checked = 0, failed = 0;
+    for (unsigned i = 0; i < NUM_CORNERS * NUM_CORNERS + NUM_RANDOM; i++) {
+        int a, b;
+        if (i < NUM_CORNERS * NUM_CORNERS) {
+            a = CORNERS[i / NUM_CORNERS];
+            b = CORNERS[i % NUM_CORNERS];
+        } else {
+            seed = seed * 1103515245 + 12345;
+            a = (int) seed;
+            seed = seed * 1103515245 + 12345;
+            b = (int) seed;
+        }
+
+        for (unsigned s = 0; s < 2; s++) {
+            int hi, lo, refHi, refLo;
+            MipsMult(a, b, s == 0, &hi, &lo);
+            MultShiftAdd(a, b, s == 0, &refHi, &refLo);
+            checked++;
+            if (hi != refHi || lo != refLo) {
+                printf("%s 0x%X * 0x%X: got 0x%X:0x%X, expected 0x%X:0x%X\n",
+                       s == 0 ? "MULT" : "MULTU", a, b,
+                       hi, lo, refHi, refLo);
+                failed++;
+            }
+        }
+    }
+    printf("Multiply test: %u products, %u wrong: %s\n",
+           checked, failed, failed == 0 ? "ok" : "FAIL");
+}
@@ -0,0 +1,126 @@
+/// Routines to keep each process within its share of the machine.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "resource_limits.hh"
+#include "syscall.h"
+#include "threads/system.hh"
+
+#include <stdlib.h>
+
+
+ResourceLimits::ResourceLimits()
+{
+    residentPages = 0;
+    openFiles     = 0;
+    diskRate      = 0;
+    diskBurst     = 0;
+}
+
+unsigned
+ResourceLimits::GetDiskBurst() const
+{
+    return diskBurst != 0 ? diskBurst : diskRate;
+}
+
+/// Whether `limit` is at least as tight as `other`, 0 being the loosest.
+static bool
+IsTighter(unsigned limit, unsigned other)
+{
+    return other == 0 || (limit != 0 && limit <= other);
+}
+
+bool
+ResourceLimits::IsWithin(const ResourceLimits &other) const
+{
+    return IsTighter(residentPages, other.residentPages)
+           && IsTighter(openFiles, other.openFiles)
+           && IsTighter(diskRate, other.diskRate)
+           && (diskRate == 0
+               || IsTighter(GetDiskBurst(), other.GetDiskBurst()));
+}
+
+bool
+ParseResourceLimits(const char *text, ResourceLimits *limits)
+{
+    ASSERT(text != nullptr);
+    ASSERT(limits != nullptr);
+
+    char *end;
+    unsigned pages = strtoul(text, &end, 10);
+    if (*end != ':') {
+        return false;
+    }
+    unsigned files = strtoul(end + 1, &end, 10);
+    if (*end != ':') {
+        return false;
+    }
+    unsigned rate  = strtoul(end + 1, &end, 10);
+    unsigned burst = 0;
+    if (*end == ':') {
+        burst = strtoul(end + 1, &end, 10);
+    }
+    if (*end != '\0') {
+        return false;
+    }
+
+    limits->residentPages = pages;
+    limits->openFiles     = files;
+    limits->diskRate      = rate;
+    limits->diskBurst     = burst;
+    return true;
+}
+
+DiskBucket::DiskBucket()
+{
+    throttledTicks = 0;
+    tokens         = 0;
+    lastRefill     = 0;
+    started        = false;
+}
+
+/// A process starts with a full bucket, so that it starts with a burst.
+void
+DiskBucket::Refill(const ResourceLimits &limits)
+{
+    long long full = (long long) limits.GetDiskBurst() * DISK_RATE_TICKS;
+    if (!started) {
+        tokens  = full;
+        started = true;
+    } else {
+        tokens += (long long) (stats->totalTicks - lastRefill)
+                  * limits.diskRate;
+        if (tokens > full) {
+            tokens = full;
+        }
+    }
+    lastRefill = stats->totalTicks;
+}
+
+void
+DiskBucket::Charge(const ResourceLimits &limits, unsigned sectors)
+{
+    if (limits.diskRate == 0) {
+        return;
+    }
+    Refill(limits);
+    tokens -= (long long) sectors * DISK_RATE_TICKS;
+}
+
+unsigned long
+DiskBucket::Settle(const ResourceLimits &limits)
+{
+    if (limits.diskRate == 0) {
+        return 0;
+    }
+    Refill(limits);
+    if (tokens >= 0) {
+        return 0;
+    }
+    unsigned long wait = (-tokens + limits.diskRate - 1) / limits.diskRate;
+    throttledTicks += wait;
+    return wait;
+}
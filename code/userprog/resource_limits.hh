@@ -0,0 +1,87 @@
+/// Data structures to keep each process within its share of the machine.
+///
+/// A process may be limited in the pages it keeps in memory, the files it
+/// keeps open and the rate at which it moves sectors to and from the disk,
+/// so that one running away cannot take the frames, or the disk, that the
+/// rest need.  Limits belong to an address space; a new space takes those
+/// of the space of the thread making it, and a process can tighten its own
+/// with `SetLimits`, never loosen them.
+///
+/// A process over its resident pages evicts pages of its own to bring in
+/// more, rather than taking frames from other processes.  One over its
+/// rate of disk I/O is let through, so that it is never held up with locks
+/// of the file system held, and waits its debt off before going back to
+/// user mode.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_RESOURCELIMITS__HH
+#define NACHOS_USERPROG_RESOURCELIMITS__HH
+
+
+/// Limits on what one process may use; 0 stands for no limit.
+class ResourceLimits {
+public:
+
+    /// Start with no limits at all.
+    ResourceLimits();
+
+    /// Pages of the space in memory at once.
+    unsigned residentPages;
+
+    /// Open files and pipe ends of each thread.
+    unsigned openFiles;
+
+    /// Sectors read or written every `DISK_RATE_TICKS` ticks, on average,
+    /// and at once, ahead of that rate; a burst of 0 stands for the rate.
+    unsigned diskRate;
+    unsigned diskBurst;
+
+    /// Return the burst in effect.
+    unsigned GetDiskBurst() const;
+
+    /// Return whether every limit is at least as tight as in `other`.
+    bool IsWithin(const ResourceLimits &other) const;
+};
+
+/// Parse limits written `<pages>:<files>:<rate>[:<burst>]` into `limits`;
+/// return false if `text` is malformed.
+bool ParseResourceLimits(const char *text, ResourceLimits *limits);
+
+/// Sectors a process may still move before it is over its rate, as a
+/// token bucket: tokens come in at the rate, up to the burst, and every
+/// sector takes one.
+class DiskBucket {
+public:
+
+    DiskBucket();
+
+    /// Take `sectors` tokens, going into debt if there are not as many.
+    void Charge(const ResourceLimits &limits, unsigned sectors);
+
+    /// Return the ticks to wait for the debt to be paid, if any, and count
+    /// them as throttled.
+    unsigned long Settle(const ResourceLimits &limits);
+
+    /// Ticks the process was held back for, so far.
+    unsigned long throttledTicks;
+
+private:
+
+    /// Add the tokens come in since last time.
+    void Refill(const ResourceLimits &limits);
+
+    /// Tokens, in `DISK_RATE_TICKS`ths of a sector, so that the rate comes
+    /// in whole every tick; negative when in debt.
+    long long tokens;
+
+    /// Tick of the last refill, and whether there was one; the bucket is
+    /// filled the first time, once the burst is known.
+    unsigned long lastRefill;
+    bool started;
+};
+
+
+#endif
@@ -0,0 +1,113 @@
+/// Routines for the symbol tables of executables.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "symbol_table.hh"
+#include "executable.hh"
+#include "machine/endianness.hh"
+#include "threads/system.hh"
+
+
+/// Bounds of a table believed, so that a damaged header is not trusted
+/// with the allocation.
+static const unsigned MAX_SYMBOLS = 64 * 1024;
+static const unsigned MAX_STRINGS_SIZE = 1024 * 1024;
+
+/// A name out of the block is taken as the empty one at its end, rather
+/// than trusted; entries out of order are not searchable, and make the
+/// whole table be dropped.
+SymbolTable *
+SymbolTable::Read(Executable *exe)
+{
+    ASSERT(exe != nullptr);
+
+    if (!exe->HasSymbols()) {
+        return nullptr;
+    }
+    const noffHeader *h = exe->GetHeader();
+    unsigned n = h->numSymbols;
+    // Every name takes one byte at least, for its null.
+    if (n > MAX_SYMBOLS || h->stringsSize < n
+          || h->stringsSize > MAX_STRINGS_SIZE) {
+        DEBUG('a', "Symbol table of the executable is damaged\n");
+        return nullptr;
+    }
+    uint32_t entriesSize = n * sizeof (noffSymbol);
+
+    noffSymbol *symbols = new noffSymbol [n];
+    char *strings = new char [h->stringsSize + 1];
+    if (exe->ReadSymbolBlock((char *) symbols, entriesSize, 0)
+              != (int) entriesSize
+          || exe->ReadSymbolBlock(strings, h->stringsSize, entriesSize)
+              != (int) h->stringsSize) {
+        DEBUG('a', "Symbol table of the executable is truncated\n");
+        delete [] symbols;
+        delete [] strings;
+        return nullptr;
+    }
+    strings[h->stringsSize] = '\0';
+
+    for (unsigned i = 0; i < n; i++) {
+        symbols[i].address = WordToHost(symbols[i].address);
+        symbols[i].name    = WordToHost(symbols[i].name);
+        if (symbols[i].name >= h->stringsSize) {
+            symbols[i].name = h->stringsSize;
+        }
+        if (i > 0 && symbols[i - 1].address > symbols[i].address) {
+            DEBUG('a', "Symbol table of the executable is not sorted\n");
+            delete [] symbols;
+            delete [] strings;
+            return nullptr;
+        }
+    }
+    DEBUG('a', "Read %u symbols of the executable\n", n);
+    return new SymbolTable(symbols, n, strings);
+}
+
+SymbolTable::SymbolTable(noffSymbol *symbols_, unsigned numSymbols_,
+                         char *strings_)
+{
+    ASSERT(symbols_ != nullptr);
+    ASSERT(strings_ != nullptr);
+
+    symbols    = symbols_;
+    numSymbols = numSymbols_;
+    strings    = strings_;
+}
+
+SymbolTable::~SymbolTable()
+{
+    delete [] symbols;
+    delete [] strings;
+}
+
+const char *
+SymbolTable::Lookup(uint32_t address, uint32_t *offset) const
+{
+    ASSERT(offset != nullptr);
+
+    unsigned low = 0, high = numSymbols;
+    while (low < high) {                 // Find the first one above it...
+        unsigned middle = (low + high) / 2;
+        if (symbols[middle].address <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == 0) {
+        return nullptr;
+    }
+    const noffSymbol *s = &symbols[low - 1];  // ...and take the previous.
+    *offset = address - s->address;
+    return &strings[s->name];
+}
+
+unsigned
+SymbolTable::GetCount() const
+{
+    return numSymbols;
+}
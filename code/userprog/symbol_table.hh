@@ -0,0 +1,48 @@
+/// Data structures for the symbol tables of executables.
+///
+/// `coff2noff -s` embeds the procedures of a program in its NOFF file, as
+/// entries sorted by address that point into a block of names.  The kernel
+/// reads them once per image, so that the profiler and the debugger can
+/// tell which procedure an address lies in with a binary search, without
+/// the COFF file the program came from.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_SYMBOLTABLE__HH
+#define NACHOS_USERPROG_SYMBOLTABLE__HH
+
+
+#include "bin/noff.h"
+
+
+class Executable;
+
+class SymbolTable {
+public:
+
+    /// Read the symbol table of `exe`, whose header is already checked.
+    /// Return null if it has none, or it cannot be read whole.
+    static SymbolTable *Read(Executable *exe);
+
+    ~SymbolTable();
+
+    /// Return the name of the procedure `address` lies in, the one with
+    /// the highest address not above it, and set `*offset` to the distance
+    /// from its start.  Return null if `address` is below every procedure.
+    const char *Lookup(uint32_t address, uint32_t *offset) const;
+
+    unsigned GetCount() const;
+
+private:
+
+    SymbolTable(noffSymbol *symbols, unsigned numSymbols, char *strings);
+
+    noffSymbol *symbols;  ///< In host byte order.
+    unsigned numSymbols;
+    char *strings;        ///< Names, each ended by a null.
+};
+
+
+#endif
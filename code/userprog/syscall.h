@@ -32,6 +32,85 @@
 #define SC_READ    14
 #define SC_WRITE   15
 #define SC_PS      16
+#define SC_MMAP    17
+#define SC_MUNMAP  18
+#define SC_READV   19
+#define SC_WRITEV  20
+#define SC_SLEEP   21
+#define SC_FSYNC   22
+#define SC_DISK_STATS 23
+#define SC_PUNCH_HOLE 24
+#define SC_BIND    25
+#define SC_SEND    26
+#define SC_RECEIVE 27
+#define SC_CHECKPOINT 28
+#define SC_SBRK    29
+#define SC_PIPE    30
+#define SC_EXEC_IO 31
+#define SC_THREAD_FORK   32
+#define SC_LOCK_CREATE   33
+#define SC_LOCK_ACQUIRE  34
+#define SC_LOCK_RELEASE  35
+#define SC_SEM_CREATE    36
+#define SC_SEM_WAIT      37
+#define SC_SEM_SIGNAL    38
+#define SC_GET_TICKS     39
+#define SC_GET_PROCESSES 40
+#define SC_WAIT_ANY      41
+#define SC_JOIN_TIMEOUT  42
+#define SC_SHM_CREATE    43
+#define SC_SHM_ATTACH    44
+#define SC_SHM_DETACH    45
+#define SC_IO_RING_SETUP 46
+#define SC_IO_RING_ENTER 47
+#define SC_OPEN_DIRECT   48
+#define SC_STAT          49
+#define SC_READ_DIR      50
+#define SC_DUP           51
+#define SC_DUP2          52
+#define SC_MMAP_READ_ONLY 53
+#define SC_GET_LIMITS    54
+#define SC_SET_LIMITS    55
+
+/// Bytes of the name in `FileStat`: room for the longest name of a file,
+/// 32 characters, and its null, rounded up to whole words.
+#define FILE_NAME_SIZE 36
+
+/// Most entries that `ReadDir` returns at once.
+#define MAX_READ_DIR 64
+
+/// Most buffers that `ReadV` and `WriteV` take at once.
+#define MAX_IOVEC  16
+
+/// Slots of each of the two rings of an `IoRing`.
+#define IO_RING_SIZE 8
+
+/// Operations of an `IoRequest`.
+#define IO_OP_READ  0
+#define IO_OP_WRITE 1
+#define IO_OP_OPEN  2
+
+/// Longest message for `Send` and `Receive`.
+#define MAX_MESSAGE_SIZE 40
+
+/// Buckets of the histograms in `DiskStats`.
+#define DISK_STATS_BUCKETS 20
+
+/// Bytes of the name in `ProcessInfo`, its null included.
+#define PROCESS_NAME_SIZE 16
+
+/// States of a process in `ProcessInfo`.
+#define PROCESS_CREATED 0
+#define PROCESS_RUNNING 1
+#define PROCESS_READY   2
+#define PROCESS_BLOCKED 3
+
+/// Ticks over which `ProcessLimits.diskRate` is counted.
+#define DISK_RATE_TICKS 10000
+
+/// Virtual address of the info page, the last page of every address
+/// space; see `InfoPage`.
+#define INFO_PAGE_ADDR 0x7FFF80
 
 
 #ifndef IN_ASM
@@ -49,7 +128,7 @@
 void Halt();
 
 
-/// Address space control operations: `Exit`, `Exec`, and `Join`.
+/// Address space control operations: `Exit`, `Exec`, `Join`, and `Fork`.
 
 /// This user program is done (`status = 0` means exited normally).
 void Exit(int status);
@@ -59,6 +138,11 @@ typedef int SpaceId;
 
 /// Run the executable, stored in the Nachos file `name`, and return the
 /// address space identifier.
+///
+/// The new program inherits the open files of the caller, with the same
+/// identifiers: each is shared, as by `Dup`, so that a file opened and
+/// positioned beforehand is read on from where it was.  Files the caller
+/// has mapped with `Mmap` are not inherited.
 SpaceId Exec(char *name, char** argv);
 
 /// Only return once the the user program `id` has finished.
@@ -66,18 +150,60 @@ SpaceId Exec(char *name, char** argv);
 /// Return the exit status.
 int Join(SpaceId id);
 
+/// Wait for whichever child of this thread finishes first, and join it:
+/// return its identifier, and leave its exit status at `status` unless it
+/// is null.  Children are the programs and threads started by the thread;
+/// those finished are reported in the order they finished.  Wait `ticks`
+/// ticks at most, or for as long as it takes if negative; return -1 if
+/// the time ran out, or if no child is left to wait for.
+SpaceId WaitAny(int *status, int ticks);
+
+/// Like `Join`, but wait `ticks` ticks at most, and leave the exit status
+/// at `status` unless it is null.  Return 0 once joined, 1 if `id` did not
+/// finish in time, in which case it can still be joined, or -1 if `id` is
+/// not a program or thread to join.
+int JoinTimeout(SpaceId id, int *status, int ticks);
+
+/// Create a copy of the running user program.
+///
+/// The child starts running right after the call, just like its parent,
+/// with a copy of its memory; pages are only actually copied when either
+/// process writes to them.  Return the address space identifier of the
+/// child in the parent, which is never 0, and 0 in the child.  The child
+/// does not inherit open files.
+SpaceId Fork(void);
 
-/// User-level thread operations: `Fork` and `Yield`.  To allow multiple
-/// threads to run within a user program.
 
-/// Fork a thread to run a procedure (`func`) in the *same* address space as
-/// the current thread.
-int Fork(void (*func)(void));
+/// User-level thread operations: `Yield` and `Sleep`.
 
 /// Yield the CPU to another runnable thread, whether in this address space
 /// or not.
 void Yield();
 
+/// Block for at least `ticks` ticks of simulated time, without using the
+/// CPU meanwhile.
+void Sleep(int ticks);
+
+/// Start a thread running `func(arg)` in this address space, on a stack of
+/// its own, and return an identifier to `Join` it by, or -1 on error.
+/// Returning from `func` is like calling `Exit` with what it returns.
+/// Threads share memory, locks and semaphores, and may run at once on
+/// different CPUs; each has its own open files, and `Exit` only ends the
+/// thread calling it.
+SpaceId ThreadFork(int (*func)(int), int arg);
+
+/// Locks and semaphores shared by the threads of an address space, by
+/// identifier.  Creating returns -1 on error; the others return 0, or -1
+/// if the identifier is wrong, or a lock is acquired by the thread that
+/// holds it already, or released by another.  Locks held by a thread are
+/// released when it exits.
+int LockCreate(void);
+int LockAcquire(int lock);
+int LockRelease(int lock);
+int SemCreate(int initialValue);
+int SemWait(int semaphore);
+int SemSignal(int semaphore);
+
 
 /// File system operations: `Create`, `Open`, `Read`, `Write`, `Close`.
 ///
@@ -109,6 +235,32 @@ int Remove(const char *name);
 /// to read and write to the file.
 OpenFileId Open(const char *name);
 
+/// Like `Open`, but whole sectors read and written through the file go
+/// straight between the buffer and the disk, past the caches of the file
+/// system, which keep what other programs use over and over.  Fit for data
+/// read or written once, as by a copy of a large file; reads and writes
+/// at multiples of 128 bytes, the size of a sector, get the most out of it.
+/// The bytes read and written are the same as through any other file;
+/// only where they are kept meanwhile changes.
+OpenFileId OpenDirect(const char *name);
+
+/// What a file or directory is.
+typedef struct FileStat {
+    int isDirectory;
+    int length;                ///< In bytes.
+    char name[FILE_NAME_SIZE];  ///< The last name in its path.
+} FileStat;
+
+/// Fill `*stat` for the file or directory `name`; return 0, or -1 if
+/// there is none.
+int Stat(const char *name, FileStat *stat);
+
+/// Fill `entries` with the files and directories in the directory `name`
+/// ("" for the root), up to `count` of them, or `MAX_READ_DIR`; return
+/// how many, or -1 if there is no such directory.  One call lists a whole
+/// directory with the lengths of everything in it, without opening any.
+int ReadDir(const char *name, FileStat *entries, int count);
+
 /// Write `size` bytes from `buffer` to the open file.
 int Write(const char *buffer, int size, OpenFileId id);
 
@@ -117,15 +269,314 @@ int Write(const char *buffer, int size, OpenFileId id);
 /// Return the number of bytes actually read -- if the open file is not long
 /// enough, or if it is an I/O device, and there are not enough characters to
 /// read, return whatever is available (for I/O devices, you should always
-/// wait until you can return at least one character).
+/// wait until you can return at least one character).  A read from the
+/// console returns after a newline, like a UNIX terminal.
+///
+/// Nothing is stored past the bytes read: in particular, they are not
+/// followed by a null byte, so a caller wanting a string must end it.
 int Read(char *buffer, int size, OpenFileId id);
 
 /// Close the file, we are done reading and writing to it.
 int Close(OpenFileId id);
 
+/// Make a pipe, and put the identifier of its read end in `ends[0]`, and
+/// of its write end in `ends[1]`; return 0, or -1 on error.
+///
+/// A pipe holds a few hundred bytes.  `Read` waits until there is anything
+/// to read, and returns what there is, or 0 once it is empty and every
+/// write end is closed.  `Write` waits for room until all is written, and
+/// fails once every read end is closed.  Ends are closed with `Close`, and
+/// at exit.  Pass them to `ExecIO` to connect programs.
+int Pipe(OpenFileId *ends);
+
+/// Return another identifier for the open file or pipe end `id`, the
+/// lowest free one of its kind, or -1 if `id` is neither.  Both stand for
+/// the same file, at the same position, which stays open until both are
+/// closed.  The console itself cannot be duplicated, only the pipe ends its
+/// identifiers stand for after `ExecIO` or `Dup2`.
+OpenFileId Dup(OpenFileId id);
+
+/// Like `Dup`, but make `newId` the other identifier, closing what it stood
+/// for first, unless it is `id` already.  Open files take identifiers from
+/// 2 on, and pipe ends from those `Pipe` gives on, up to 4096 of each; the
+/// read end of a pipe can also be given `CONSOLE_INPUT`, and the write end
+/// `CONSOLE_OUTPUT`, so that the console of the caller, and of programs it
+/// starts with `Exec`, goes to the pipe.  Return `newId`, or -1.
+OpenFileId Dup2(OpenFileId id, OpenFileId newId);
+
+/// Like `Exec`, but the console input and output of the new program go
+/// to `input` and `output` instead: pipe ends of the caller, or its own
+/// `CONSOLE_INPUT` and `CONSOLE_OUTPUT`.  `Exec` passes those, so that
+/// programs run by a program with its console on pipes use them too.
+/// Return -1 if `input` cannot be read, or `output` cannot be written.
+SpaceId ExecIO(char *name, char **argv, OpenFileId input, OpenFileId output);
+
+/// Return once everything written to the open file is on the disk, rather
+/// than only in the kernel's disk cache; return 0, or -1 if `id` is not an
+/// open file.
+int Fsync(OpenFileId id);
+
+/// Make `size` bytes of the open file from `position` on read as zeros,
+/// and give back the disk sectors of the blocks among them, without
+/// changing its length; return 0, or -1 if `id` is not an open file, or
+/// the arguments are negative, or the file system is out of room.
+int PunchHole(OpenFileId id, int position, int size);
+
+/// A buffer for `ReadV` and `WriteV`.
+typedef struct IoVec {
+    char *buffer;
+    int size;
+} IoVec;
+
+/// Read from the open file into the `count` buffers of `vector`, up to
+/// `MAX_IOVEC`, filling each in turn, in a single system call.
+///
+/// Return the total number of bytes read; a buffer left short ends the
+/// call, as does the end of the file.
+int ReadV(const IoVec *vector, int count, OpenFileId id);
+
+/// Write the `count` buffers of `vector`, in turn, to the open file in a
+/// single system call.  Return the total number of bytes written.
+int WriteV(const IoVec *vector, int count, OpenFileId id);
+
+/// Asynchronous I/O: `IoRingSetup` and `IoRingEnter`.
+///
+/// Requests are queued in the submission ring of an `IoRing`, in the
+/// program's own memory, and carried out by kernel threads meanwhile; the
+/// program finds their results in the completion ring, in the order they
+/// finished.  Queueing a request and picking up a result need no system
+/// call, so many requests can be in flight at once, for a single call.
+///
+/// The counters of both rings only grow: slot `n % IO_RING_SIZE` holds
+/// entry `n`.  The program fills `requests` and moves `submitTail` up,
+/// and the kernel moves `submitHead` up as it takes them; the kernel fills
+/// `completions` and moves `completeTail` up, and the program moves
+/// `completeHead` up as it reads them.  A request is only taken once its
+/// completion has a slot to go to.
+
+/// Read or write `size` bytes between `buffer` and the open file `id`, or
+/// open the file named at `buffer`.  The result is what `Read`, `Write` or
+/// `Open` would return; writes take the `size` bytes as they are, null
+/// bytes included.  Consoles and pipes cannot be used, and a file must not
+/// be closed while requests on it are in flight.
+typedef struct IoRequest {
+    int op;        ///< One of the `IO_OP_` operations above.
+    OpenFileId id;
+    char *buffer;
+    int size;
+    int tag;       ///< Copied to the completion, to tell it by.
+} IoRequest;
+
+typedef struct IoCompletion {
+    int tag;
+    int result;
+} IoCompletion;
+
+typedef struct IoRing {
+    unsigned submitHead;
+    unsigned submitTail;
+    IoRequest requests[IO_RING_SIZE];
+    unsigned completeHead;
+    unsigned completeTail;
+    IoCompletion completions[IO_RING_SIZE];
+} IoRing;
+
+/// Start serving `ring`, zeroed, for the calling thread, with its open
+/// files; return 0, or -1 if it already has a ring, or `ring` is not in
+/// writable memory.  The ring is served until the thread exits; requests
+/// not taken by then are dropped.
+int IoRingSetup(IoRing *ring);
+
+/// Let the kernel take the requests queued in the ring of the calling
+/// thread, and wait until there are at least `minComplete` completions to
+/// read, or nothing more is to complete.  Return how many completions
+/// there are to read, or -1 if the thread has no ring.
+int IoRingEnter(int minComplete);
+
+/// Memory-mapped files: `Mmap`, `MmapReadOnly` and `Munmap`.
+
+/// Map the first `size` bytes of the open file `id` into memory, and return
+/// the address where they start, or -1 on error.
+///
+/// Pages are read when first touched, and the ones written to are copied
+/// back to the file when unmapped.  Bytes past the end of the file read as
+/// zeros.  The file may be closed while mapped; it is only closed for good
+/// when unmapped.  Mappings are not inherited by `Fork`, and a file can be
+/// mapped only once at a time.
+char *Mmap(OpenFileId id, int size);
+
+/// Map the first `size` bytes of the open file `id` like `Mmap`, but for
+/// reading only: writing to the mapping kills the process.  Every process
+/// mapping the same file this way shares the pages in memory, so that many
+/// readers of a large file read it from the disk, and keep it in memory,
+/// once.  Writing to the file leaves the mappings already made with what
+/// they had.
+char *MmapReadOnly(OpenFileId id, int size);
+
+/// Remove the mapping starting at `addr`, as returned by `Mmap`; return 0,
+/// or -1 if there is none.
+int Munmap(char *addr);
+
+/// Shared memory: `ShmCreate`, `ShmAttach` and `ShmDetach`.
+
+/// Make a segment of `size` bytes of zeros, which any process can attach
+/// by its identifier, and attach it to the caller.  Return the identifier,
+/// or -1 on error.
+///
+/// Processes with a segment attached map the very same memory, so what
+/// one writes there the others read, without any copying.  Segments are
+/// inherited by `Fork`, at the same address, and detached at exit; a
+/// segment goes away once detached by every process.
+int ShmCreate(int size);
+
+/// Attach segment `id` to the caller, unless it is attached already, and
+/// return the address where it starts, or -1 on error.
+char *ShmAttach(int id);
+
+/// Detach the segment starting at `addr`, as returned by `ShmAttach`;
+/// return 0, or -1 if there is none.
+int ShmDetach(char *addr);
+
 /// Print the current status of the scheduler
 void PrintScheduler();
 
+/// What the disk has done since Nachos started.  In the histograms, bucket
+/// 0 counts requests that took no ticks, or sought no tracks, and bucket
+/// `b` those that took from `2^(b-1)` to `2^b - 1`; the last bucket also
+/// counts every larger one.
+typedef struct DiskStats {
+    int requests;
+    int sectors;
+    int ticks;
+    int rotationTicks;    ///< Waiting for the first sector of requests.
+    int trackBufferHits;  ///< Reads served from the track buffer.
+    int latency[DISK_STATS_BUCKETS];
+    int seekTracks[DISK_STATS_BUCKETS];
+} DiskStats;
+
+/// Fill `*stats`; return 0, or -1 if `stats` is null.
+int GetDiskStats(DiskStats *stats);
+
+/// Simulated time since Nachos started, in ticks: in all, and how it was
+/// spent by the whole machine; and how much of it the calling thread ran,
+/// in user mode and in the kernel.  Counts wrap around past 2^31.
+typedef struct TickCounts {
+    int total;
+    int idle;
+    int system;
+    int user;
+    int threadUser;
+    int threadSystem;
+} TickCounts;
+
+/// Fill `*ticks`; return 0, or -1 if `ticks` is null.
+int GetTicks(TickCounts *ticks);
+
+/// What the kernel keeps in the info page, mapped read-only at
+/// `INFO_PAGE_ADDR` in every process, so that it can be read with a load
+/// instead of a system call.  It is written every time the kernel returns
+/// to the process: after a system call, and when switching to it.  `total`
+/// is thus the time as of then, which lags behind by the ticks the process
+/// ran since; use `GetTicks` for the exact time.
+typedef struct InfoPage {
+    int total;     ///< Like `TickCounts.total`.
+    int pid;       ///< Identifier of the process, -1 for the first one.
+    int cpu;       ///< CPU the process runs on.
+    int ready;     ///< Threads waiting for that CPU.
+    int priority;  ///< Priority the thread the kernel returned to runs at.
+} InfoPage;
+
+/// Limits on what a process may use; 0 stands for no limit.
+typedef struct ProcessLimits {
+    int residentPages;  ///< Pages in memory at once.
+    int openFiles;      ///< Open files and pipe ends, of each thread.
+    int diskRate;       ///< Sectors moved every `DISK_RATE_TICKS` ticks.
+    int diskBurst;      ///< Sectors moved at once, ahead of the rate; 0
+                        ///< stands for `diskRate`.
+} ProcessLimits;
+
+/// What a process, or a thread of one, is and has used so far.  The
+/// program started first, which has no identifier, tells of itself with
+/// `pid` -1.  Counts wrap around past 2^31.
+typedef struct ProcessInfo {
+    int pid;
+    int state;          ///< One of the `PROCESS_` states above.
+    int priority;
+    int userTicks;
+    int systemTicks;
+    int pages;          ///< Pages of its address space, or 0 if it has none.
+    int residentPages;  ///< Of those, the ones in memory.
+    int workingSet;     ///< And the ones it used lately.
+    int sharedPages;    ///< Pages in memory, of mapped files too, that
+                        ///< other processes map as well.
+    int pageFaults;
+    int tlbMisses;
+    int sectorsRead;
+    int sectorsWritten;
+    int switches;       ///< Times it was switched to.
+    int openFiles;      ///< Open files and pipe ends.
+    int throttledTicks; ///< Ticks held back for going over its disk rate.
+    int limitEvictions; ///< Pages it evicted for being over its limit.
+    ProcessLimits limits;
+    char name[PROCESS_NAME_SIZE];  ///< Cut short if need be.
+} ProcessInfo;
+
+/// Fill `info` with up to `count` records, the calling process first and
+/// then every other by identifier, and return how many processes there
+/// are, which may be more than `count`; or return -1 if `info` is null and
+/// `count` is not 0.  Nothing is printed, so it can be called often.
+int GetProcesses(ProcessInfo *info, int count);
+
+/// Fill `limits` with those of the calling process; return 0, or -1 if
+/// `limits` is null.
+int GetLimits(ProcessLimits *limits);
+
+/// Set the limits of the calling process, which the processes it starts
+/// afterwards inherit.  Limits can only be tightened: return -1, changing
+/// nothing, if any is looser than it was, and 0 otherwise.  A process over
+/// its resident pages evicts its own pages to bring in more, one over its
+/// disk rate is held back, and one at its open files cannot open more.
+int SetLimits(const ProcessLimits *limits);
+
+/// Save this process to the file `name`: its memory and registers, as they
+/// will be once the call returns.  Return 0, or -1 on error.  Running
+/// Nachos with `-restore name` resumes the process right there, with 1
+/// returned instead.  Only memory is saved.  Open files, mapped files and
+/// other processes are not.
+int Checkpoint(const char *name);
+
+/// Move the end of the heap, the *break*, `increment` bytes up, and return
+/// where it was, or -1 if there is no room.  The heap starts right after
+/// the stack, and its new pages read as zeros; they take memory only once
+/// touched.  `Sbrk(0)` tells the break.  The heap never shrinks.
+char *Sbrk(int increment);
+
+/// Messages between machines, each a Nachos of its own, for kernels built
+/// with the network.  Messages go to a mailbox on a machine, and may be
+/// lost on the way.
+
+/// Where a message goes to, or came from.
+typedef struct MailAddress {
+    int machine;
+    int box;
+} MailAddress;
+
+/// Take mailbox `box` of this machine for this process, so that it can
+/// receive from it and send from it; return 0, or -1 if there is no such
+/// box or another process has it.  Boxes are given back at exit.
+int Bind(int box);
+
+/// Send the `size` bytes of `buffer`, up to `MAX_MESSAGE_SIZE`, from box
+/// `fromBox`, bound by this process, to the address `*to`; replies go to
+/// `fromBox`.  Return 0, or -1 on error.
+int Send(const MailAddress *to, int fromBox, const char *buffer, int size);
+
+/// Wait for a message in box `box`, bound by this process, and copy up to
+/// `size` bytes of it into `buffer`, and where it came from into `*from`,
+/// unless `from` is null.  Return the length of the message, or -1 on
+/// error.
+int Receive(int box, char *buffer, int size, MailAddress *from);
+
 #endif
 
 
@@ -0,0 +1,64 @@
+/// Routines to keep the translations cached by every CPU consistent.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "tlb_shootdown.hh"
+#include "threads/system.hh"
+
+
+/// Account for asking every CPU but the one running to do something.
+static void
+SendIPIs()
+{
+    stats->numIPIs += machine->GetNumCPUs() - 1;
+}
+
+void
+ShootdownFrame(unsigned frame, TranslationEntry *entry)
+{
+    for (unsigned c = 0; c < machine->GetNumCPUs(); c++) {
+        MMU *mmu = machine->GetMMU(c);
+        if (entry != nullptr) {
+            mmu->CollectTLBBits(frame, entry);
+        }
+        mmu->InvalidateTLBFrame(frame);
+    }
+    if (machine->GetNumCPUs() > 1) {
+        stats->numShootdowns++;
+        SendIPIs();
+    }
+}
+
+void
+ShootdownASID(unsigned asid)
+{
+    for (unsigned c = 0; c < machine->GetNumCPUs(); c++) {
+        machine->GetMMU(c)->InvalidateASID(asid);
+    }
+    if (machine->GetNumCPUs() > 1) {
+        stats->numShootdowns++;
+        SendIPIs();
+    }
+}
+
+void
+CollectFrameBits(unsigned frame, TranslationEntry *entry)
+{
+    ASSERT(entry != nullptr);
+
+    for (unsigned c = 0; c < machine->GetNumCPUs(); c++) {
+        machine->GetMMU(c)->CollectTLBBits(frame, entry);
+    }
+    SendIPIs();
+}
+
+void
+InvalidateFrameCode(unsigned frame)
+{
+    for (unsigned c = 0; c < machine->GetNumCPUs(); c++) {
+        machine->GetMMU(c)->InvalidateFrame(frame);
+    }
+}
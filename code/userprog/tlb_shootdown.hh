@@ -0,0 +1,38 @@
+/// Routines to keep the translations cached by every CPU consistent.
+///
+/// Each CPU has a TLB of its own, which may hold entries of any address
+/// space that ran on it.  When the kernel takes a mapping away, the CPU
+/// doing it invalidates its own entries, and sends every other CPU an
+/// interprocessor interrupt to invalidate theirs: a TLB shootdown.  The use
+/// and dirty bits of a frame are likewise spread over every TLB.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_TLBSHOOTDOWN__HH
+#define NACHOS_USERPROG_TLBSHOOTDOWN__HH
+
+
+#include "machine/translation_entry.hh"
+
+
+/// Invalidate the TLB entries that map `frame`, on every CPU.  If `entry`
+/// is given, their use and dirty bits are merged into it first.
+void ShootdownFrame(unsigned frame, TranslationEntry *entry = nullptr);
+
+/// Invalidate the TLB entries loaded under `asid`, on every CPU.
+void ShootdownASID(unsigned asid);
+
+/// Merge into `entry` the use and dirty bits that the TLB of any CPU has
+/// for `frame`, and clear them there.
+void CollectFrameBits(unsigned frame, TranslationEntry *entry);
+
+/// Tell every CPU that the contents of `frame` were changed by the kernel,
+/// so that instructions decoded from it are discarded.  Decoded
+/// instructions are an artifact of the simulation, so no interrupt is
+/// counted.
+void InvalidateFrameCode(unsigned frame);
+
+
+#endif
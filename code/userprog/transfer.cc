@@ -7,22 +7,64 @@
 #include "lib/utility.hh"
 #include "threads/system.hh"
 
+#include <string.h>
+
+
+/// Faults an access may take in a row on the same address: a write may
+/// take a page fault, which loads a read-only translation of a page shared
+/// on copy on write, or of a clean large page, and then a read-only fault,
+/// which makes it writable.  Any more means the handlers could not resolve
+/// the fault.
+static const unsigned MAX_FAULTS = 2;
+
+/// Copy up to `count` bytes from user memory, a page at a time.
+///
+/// A copy may be interrupted by a page fault, on a TLB miss or on a page
+/// not loaded yet; the exception handler resolves it, and the copy resumes
+/// where it stopped.  Return the number of bytes copied.
+static unsigned
+CopyFromUser(int userAddress, char *buffer, unsigned count, bool stopAtNul)
+{
+    unsigned done = 0;
+    unsigned faults = 0;
+    while (done < count) {
+        unsigned copied;
+        if (machine->ReadBuffer(userAddress + done, buffer + done,
+                                count - done, stopAtNul, &copied)) {
+            return done + copied;
+        }
+        faults = copied > 0 ? 1 : faults + 1;
+        ASSERT(faults <= MAX_FAULTS);
+        done += copied;
+    }
+    return done;
+}
+
+/// Copy `count` bytes to user memory, a page at a time.  Faults are dealt
+/// with as in `CopyFromUser`.
+static void
+CopyToUser(const char *buffer, int userAddress, unsigned count)
+{
+    unsigned done = 0;
+    unsigned faults = 0;
+    while (done < count) {
+        unsigned copied;
+        if (machine->WriteBuffer(userAddress + done, buffer + done,
+                                 count - done, &copied)) {
+            return;
+        }
+        faults = copied > 0 ? 1 : faults + 1;
+        ASSERT(faults <= MAX_FAULTS);
+        done += copied;
+    }
+}
+
 void ReadBufferFromUser(int userAddress, char *outBuffer, unsigned byteCount) {
     ASSERT(userAddress != 0);
     ASSERT(outBuffer != nullptr);
     ASSERT(byteCount != 0);
 
-    for(unsigned i = 0; i < byteCount; i++) {
-        int temp;
-        if (!machine->ReadMem(userAddress++, 1, &temp))
-#ifdef USE_TLB
-            ASSERT(machine->ReadMem(userAddress - 1, 1, &temp));
-#else
-            ASSERT(false);
-#endif
-        *outBuffer = (unsigned char) temp;
-        outBuffer++;
-    }
+    CopyFromUser(userAddress, outBuffer, byteCount, false);
 }
 
 bool ReadStringFromUser(int userAddress, char *outString, unsigned maxByteCount){
@@ -30,20 +72,8 @@ bool ReadStringFromUser(int userAddress, char *outString, unsigned maxByteCount)
     ASSERT(outString != nullptr);
     ASSERT(maxByteCount != 0);
 
-    unsigned count = 0;
-    do {
-        int temp;
-        count++;
-        if (!machine->ReadMem(userAddress++, 1, &temp))
-#ifdef USE_TLB
-            ASSERT(machine->ReadMem(userAddress - 1, 1, &temp));
-#else
-            ASSERT(false);
-#endif
-        *outString = (unsigned char) temp;
-    } while (*outString++ != '\0' && count < maxByteCount);
-
-    return *(outString - 1) == '\0';
+    unsigned count = CopyFromUser(userAddress, outString, maxByteCount, true);
+    return outString[count - 1] == '\0';
 }
 
 void WriteBufferToUser(const char *buffer, int userAddress, unsigned byteCount) {
@@ -51,27 +81,108 @@ void WriteBufferToUser(const char *buffer, int userAddress, unsigned byteCount)
     ASSERT(buffer != nullptr);
     ASSERT(byteCount != 0);
 
-    for(unsigned i = 0; i < byteCount; i++) {
-        if (!machine->WriteMem(userAddress++, 1, buffer[i]))
-#ifdef USE_TLB
-            ASSERT(machine->WriteMem(userAddress - 1, 1, buffer[i]));
-#else
-            ASSERT(false);
-#endif
-    }
+    CopyToUser(buffer, userAddress, byteCount);
 }
 
 void WriteStringToUser(const char *string, int userAddress) {
     ASSERT(string != nullptr);
     ASSERT(userAddress != 0);
 
-    unsigned i = 0;
-    do {
-        if (!machine->WriteMem(userAddress++, 1, (int) string[i]))
-#ifdef USE_TLB
-            ASSERT(machine->WriteMem(userAddress - 1, 1, (int) string[i]));
-#else
-            ASSERT(false);
+    CopyToUser(string, userAddress, strlen(string) + 1);
+}
+
+unsigned
+TransferUser(int userAddress, unsigned byteCount, bool writing,
+             UserChunkFunction function, void *arg)
+{
+    ASSERT(function != nullptr);
+
+    MMU *mmu = machine->GetMMU();
+    unsigned done = 0;
+    unsigned faults = 0;
+    while (done < byteCount) {
+        unsigned physAddr;
+        if (!machine->TranslateAddress(userAddress + done, writing,
+                                       &physAddr)) {
+            // The handler resolved the fault; try again.
+            faults++;
+            ASSERT(faults <= MAX_FAULTS);
+            continue;
+        }
+        faults = 0;
+
+        unsigned count = PAGE_SIZE - (userAddress + done) % PAGE_SIZE;
+        if (count > byteCount - done) {
+            count = byteCount - done;
+        }
+
+        unsigned frame = physAddr / PAGE_SIZE;
+#ifdef VMEM
+        coreMap->Pin(frame);  // `function` may block on the disk.
 #endif
-    } while (*string++ != '\0');
+        unsigned n = function(&mmu->mainMemory[physAddr], count, arg);
+        if (writing) {
+            mmu->InvalidateFrame(frame);
+        }
+#ifdef VMEM
+        coreMap->Unpin(frame);
+#endif
+
+        done += n;
+        if (n < count) {
+            break;
+        }
+    }
+    return done;
+}
+
+/// A fault on a later page of a batch may evict frames, but not those of
+/// the batch, which are pinned as soon as they are found.
+unsigned
+TransferUserPages(int userAddress, unsigned numPages, bool writing,
+                  UserPagesFunction function, void *arg)
+{
+    ASSERT(userAddress % PAGE_SIZE == 0);
+    ASSERT(function != nullptr);
+
+    MMU *mmu = machine->GetMMU();
+    unsigned done = 0;
+    while (done < numPages) {
+        unsigned frames[MAX_TRANSFER_PAGES];
+        char *pages[MAX_TRANSFER_PAGES];
+        unsigned count = 0;
+        unsigned faults = 0;
+        while (count < MAX_TRANSFER_PAGES && done + count < numPages) {
+            unsigned physAddr;
+            if (!machine->TranslateAddress(
+                  userAddress + (done + count) * PAGE_SIZE, writing,
+                  &physAddr)) {
+                faults++;
+                ASSERT(faults <= MAX_FAULTS);
+                continue;
+            }
+            faults = 0;
+            frames[count] = physAddr / PAGE_SIZE;
+#ifdef VMEM
+            coreMap->Pin(frames[count]);
+#endif
+            pages[count++] = &mmu->mainMemory[physAddr];
+        }
+
+        unsigned n = function(pages, count, arg);
+        for (unsigned i = 0; i < count; i++) {
+            if (writing) {
+                mmu->InvalidateFrame(frames[i]);
+            }
+#ifdef VMEM
+            coreMap->Unpin(frames[i]);
+#endif
+        }
+
+        done += n;
+        if (n < count) {
+            break;
+        }
+    }
+    return done * PAGE_SIZE;
 }
@@ -22,5 +22,39 @@ void WriteBufferToUser(const char *buffer, int userAddress,
 /// Copy a C string from host to virtual machine.
 void WriteStringToUser(const char *string, int userAddress);
 
+/// Work on a piece of user memory in place: `count` bytes at `chunk`,
+/// within one page.  Return the number of bytes dealt with; fewer than
+/// `count` ends the transfer.
+typedef unsigned (*UserChunkFunction)(char *chunk, unsigned count,
+                                      void *arg);
+
+/// Apply `function` to the `byteCount` bytes of user memory at
+/// `userAddress`, a page at a time, right in the frames that hold them, so
+/// that no kernel buffer is needed.  `writing` tells whether `function`
+/// modifies the memory.  Frames stay pinned while `function` runs, so it
+/// may block.  Return the number of bytes dealt with.
+///
+/// Address 0 is taken as any other, so that the whole memory of a program
+/// can be walked; system calls reject null pointers themselves.
+unsigned TransferUser(int userAddress, unsigned byteCount, bool writing,
+                      UserChunkFunction function, void *arg);
+
+/// Work on `count` whole pages of user memory in place, given by the
+/// frames that hold them, wherever those are.  Return the number of pages
+/// dealt with; fewer than `count` ends the transfer.
+typedef unsigned (*UserPagesFunction)(char *const *pages, unsigned count,
+                                      void *arg);
+
+/// Most pages handed to a `UserPagesFunction` at once.  They are all
+/// pinned meanwhile, so this is kept well below the frames there are.
+const unsigned MAX_TRANSFER_PAGES = 8;
+
+/// Like `TransferUser`, for the `numPages` whole pages from `userAddress`
+/// on, which must be the start of a page, handed to `function` up to
+/// `MAX_TRANSFER_PAGES` at a time, so that a device can move them all in
+/// one request.  Return the number of bytes dealt with.
+unsigned TransferUserPages(int userAddress, unsigned numPages, bool writing,
+                           UserPagesFunction function, void *arg);
+
 
 #endif
@@ -0,0 +1,280 @@
+/// Routines to run a workload of many user programs in one boot.
+///
+/// Each run of jobs one after the other, a *chain*, is started by a kernel
+/// thread of its own: it waits for the arrival of the first job, then starts
+/// each job and joins it in turn.  Chains run at the highest priority, so
+/// that jobs arrive on time whatever the priority of the jobs running.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "workload.hh"
+#include "address_space.hh"
+#include "exception.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/// Longest line of a script, and most arguments of a job, the program
+/// included.
+static const unsigned MAX_LINE = 256;
+static const unsigned MAX_JOB_ARGS = 16;
+
+/// A program to run, and what became of it.
+class Job {
+public:
+    unsigned line;          ///< Line of the script.
+    bool after;             ///< Whether it waits for the job before.
+    unsigned long arrival;  ///< Ticks after the start, unless `after`.
+    unsigned priority;
+    char *args[MAX_JOB_ARGS + 1];  ///< Program and arguments, null-ended.
+
+    unsigned long arrived;  ///< When it was started.
+    unsigned long started;  ///< When it first ran.
+    unsigned long finished;
+    bool ran;               ///< Whether it could be started.
+    int status;             ///< Exit status.
+    unsigned long userTicks;
+    unsigned long systemTicks;
+
+    Job *next;
+};
+
+/// When the workload started.
+static unsigned long workloadStart;
+
+/// Read the jobs of `script`; return null, and print why, if it cannot be
+/// read or a line is wrong.
+static Job *
+ReadScript(const char *script)
+{
+    ASSERT(script != nullptr);
+
+    FILE *f = fopen(script, "r");
+    if (f == nullptr) {
+        printf("Unable to open workload %s\n", script);
+        return nullptr;
+    }
+
+    Job *first = nullptr;
+    Job **link = &first;
+    char buffer[MAX_LINE];
+    bool error = false;
+    for (unsigned line = 1; !error && fgets(buffer, sizeof buffer, f);
+         line++) {
+        const char *arrival = strtok(buffer, " \t\n");
+        if (arrival == nullptr || arrival[0] == '#') {
+            continue;
+        }
+        const char *priority = strtok(nullptr, " \t\n");
+        const char *program  = strtok(nullptr, " \t\n");
+        char *end = nullptr;
+        unsigned long p = program == nullptr ? 0
+                                             : strtoul(priority, &end, 10);
+        if (program == nullptr || *end != '\0' || p > PRIORITY_MAX) {
+            printf("Workload %s, line %u: expected `<arrival> <priority "
+                   "0-%u> <program> [<argument>...]`\n",
+                   script, line, PRIORITY_MAX);
+            error = true;
+            break;
+        }
+
+        Job *job = new Job;
+        memset(job, 0, sizeof *job);
+        job->line     = line;
+        job->after    = strcmp(arrival, "after") == 0;
+        job->priority = p;
+        if (!job->after) {
+            job->arrival = strtoul(arrival, &end, 10);
+            error = *end != '\0';
+        }
+        unsigned n = 0;
+        const char *a = program;
+        for (; a != nullptr && n < MAX_JOB_ARGS;
+             a = strtok(nullptr, " \t\n")) {
+            job->args[n] = new char [strlen(a) + 1];
+            strcpy(job->args[n++], a);
+        }
+        if (a != nullptr) {
+            error = true;  // Too many arguments.
+        }
+        if (error) {
+            printf("Workload %s, line %u: bad arrival, or more than %u "
+                   "arguments\n", script, line, MAX_JOB_ARGS - 1);
+        }
+        *link = job;
+        link = &job->next;
+    }
+    fclose(f);
+
+    if (error) {
+        for (Job *job = first; job != nullptr;) {
+            Job *next = job->next;
+            for (unsigned i = 0; job->args[i] != nullptr; i++) {
+                delete [] job->args[i];
+            }
+            delete job;
+            job = next;
+        }
+        return nullptr;
+    }
+    return first;
+}
+
+/// Start the program of a job, in the thread made for it.
+static void
+StartJob(void *job_)
+{
+    ASSERT(job_ != nullptr);
+
+    Job *job = (Job *) job_;
+    job->started = stats->totalTicks;
+
+    // `ExecProcess` frees its arguments.
+    char **args = new char * [MAX_JOB_ARGS + 1];
+    unsigned n;
+    for (n = 0; job->args[n] != nullptr; n++) {
+        args[n] = new char [strlen(job->args[n]) + 1];
+        strcpy(args[n], job->args[n]);
+    }
+    args[n] = nullptr;
+    ExecProcess(args);
+}
+
+/// Load the program of `job` and start it; return its thread, or null if
+/// the program cannot be opened or its address space set up.
+static Thread *
+LaunchJob(Job *job)
+{
+    ASSERT(job != nullptr);
+
+    const char *program = job->args[0];
+    OpenFile *executable = fileSystem->Open(program);
+    if (executable == nullptr) {
+        printf("Unable to open file %s\n", program);
+        return nullptr;
+    }
+
+    AddressSpace *space = new AddressSpace(executable, program);
+    if (!space->IsReady()) {
+        printf("Unable to set up the address space of %s\n", program);
+        delete space;
+#ifndef DEMAND_LOADING
+        delete executable;
+#endif
+        return nullptr;
+    }
+    Thread *thread = new Thread(program, true, job->priority);
+    thread->space = space;
+
+#ifndef DEMAND_LOADING
+    delete executable;  // With demand loading, the space keeps it.
+#endif
+
+    job->arrived = stats->totalTicks;
+    thread->Fork(StartJob, job);
+    return thread;
+}
+
+/// Run the chain of jobs starting at `first_`: that job, when it arrives,
+/// and those after it that wait for the one before.
+static void
+RunChain(void *first_)
+{
+    ASSERT(first_ != nullptr);
+
+    Job *job = (Job *) first_;
+    do {
+        unsigned long now = stats->totalTicks - workloadStart;
+        if (!job->after && job->arrival > now) {
+            alarmClock->WaitUntil(job->arrival - now);
+        }
+
+        Thread *thread = LaunchJob(job);
+        if (thread != nullptr) {
+            job->status = thread->Join();
+            job->finished = stats->totalTicks;
+            job->ran = true;
+            // Joined, but not destroyed until the next switch.
+            job->userTicks   = thread->usage.userTicks;
+            job->systemTicks = thread->usage.systemTicks;
+        }
+        job = job->next;
+    } while (job != nullptr && job->after);
+}
+
+/// Print what each job took, and their averages.
+static void
+PrintReport(const char *script, const Job *first)
+{
+    ASSERT(script != nullptr);
+
+    printf("Workload %s: %lu ticks.\n", script,
+           stats->totalTicks - workloadStart);
+    printf("%-5s %-16s %4s %10s %10s %10s %10s %10s %6s\n",
+           "line", "program", "prio", "arrival", "response", "turnaround",
+           "user", "system", "status");
+
+    unsigned numRan = 0;
+    unsigned long totalResponse = 0, totalTurnaround = 0;
+    for (const Job *job = first; job != nullptr; job = job->next) {
+        if (!job->ran) {
+            printf("%-5u %-16s %4u %10s\n", job->line, job->args[0],
+                   job->priority, "not run");
+            continue;
+        }
+        unsigned long response   = job->started - job->arrived;
+        unsigned long turnaround = job->finished - job->arrived;
+        printf("%-5u %-16s %4u %10lu %10lu %10lu %10lu %10lu %6d\n",
+               job->line, job->args[0], job->priority,
+               job->arrived - workloadStart, response, turnaround,
+               job->userTicks, job->systemTicks, job->status);
+        numRan++;
+        totalResponse   += response;
+        totalTurnaround += turnaround;
+    }
+    if (numRan > 0) {
+        printf("Average of %u jobs: response %lu, turnaround %lu ticks.\n",
+               numRan, totalResponse / numRan, totalTurnaround / numRan);
+    }
+}
+
+void
+RunWorkload(const char *script)
+{
+    ASSERT(script != nullptr);
+
+    Job *first = ReadScript(script);
+    if (first == nullptr) {
+        return;
+    }
+
+    unsigned numChains = 0;
+    for (const Job *job = first; job != nullptr; job = job->next) {
+        if (job == first || !job->after) {
+            numChains++;
+        }
+    }
+
+    workloadStart = stats->totalTicks;
+    Thread **chains = new Thread * [numChains];
+    unsigned c = 0;
+    for (Job *job = first; job != nullptr; job = job->next) {
+        if (job == first || !job->after) {
+            chains[c] = new Thread("workload chain", true, PRIORITY_MAX);
+            chains[c++]->Fork(RunChain, job);
+        }
+    }
+    for (c = 0; c < numChains; c++) {
+        chains[c]->Join();
+    }
+    delete [] chains;
+
+    PrintReport(script, first);
+    interrupt->Halt();
+}
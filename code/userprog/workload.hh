@@ -0,0 +1,33 @@
+/// Routines to run a workload of many user programs in one boot.
+///
+/// A workload script has one job per line:
+///
+///     <arrival> <priority> <program> [<argument>...]
+///
+/// `arrival` is the tick at which the job is started, counted from when
+/// the workload starts, or `after` to start it once the job on the line
+/// before is done.  Jobs with an arrival time run concurrently with any
+/// others running then.  Jobs that follow with `after` run one after the
+/// other, as a shell script would run them.  `priority` is the scheduling
+/// priority of the job, from 0 to `PRIORITY_MAX`.  `program` gets itself as
+/// its first argument, and then the arguments on the line.  Empty lines,
+/// and lines starting with `#`, are skipped.
+///
+/// Once every job is done, the turnaround and response times of each are
+/// printed, and Nachos halts.  The turnaround time of a job runs from its
+/// arrival until it exits.  Its response time runs until it first runs.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_WORKLOAD__HH
+#define NACHOS_USERPROG_WORKLOAD__HH
+
+
+/// Run the jobs of the UNIX file `script`, report how long each took, and
+/// halt.  Returns only if the script cannot be read.
+void RunWorkload(const char *script);
+
+
+#endif
@@ -0,0 +1,839 @@
+/// Routines to manage the core map.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "core_map.hh"
+#include "userprog/address_space.hh"
+#include "userprog/tlb_shootdown.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+#ifdef SWAP
+static void
+CleanHelper(void *arg)
+{
+    ASSERT(arg != nullptr);
+    CoreMap *map = (CoreMap *) arg;
+    map->CleanLoop();
+}
+#endif
+
+static void
+ZeroHelper(void *arg)
+{
+    ASSERT(arg != nullptr);
+    CoreMap *map = (CoreMap *) arg;
+    map->ZeroLoop();
+}
+
+
+static const char *FRAME_POLICY_NAMES[] = {
+    "fifo", "clock", "eclock", "aging", "random"
+};
+
+bool
+ParseFramePolicy(const char *name, FramePolicy *policy)
+{
+    ASSERT(name != nullptr);
+    ASSERT(policy != nullptr);
+
+    for (unsigned i = 0; i < NUM_FRAME_POLICIES; i++) {
+        if (strcmp(name, FRAME_POLICY_NAMES[i]) == 0) {
+            *policy = (FramePolicy) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *
+FramePolicyToString(FramePolicy policy)
+{
+    ASSERT(policy < NUM_FRAME_POLICIES);
+    return FRAME_POLICY_NAMES[policy];
+}
+
+
+CoreMap::CoreMap(unsigned numFrames_, Bitmap *frameBitmap_,
+                 FramePolicy policy_)
+{
+    ASSERT(numFrames_ > 0);
+    ASSERT(policy_ < NUM_FRAME_POLICIES);
+
+    numFrames   = numFrames_;
+    frames      = new FrameInfo [numFrames];
+    frameBitmap = frameBitmap_;
+    policy      = policy_;
+    hand        = 0;
+    numLoads    = 0;
+
+    // Link the free frames in increasing order, so that frames are handed
+    // out in the same order as `Bitmap::Find` would.
+    for (unsigned i = 0; i < numFrames; i++) {
+        frames[i].owner      = nullptr;
+        frames[i].sharers    = nullptr;
+        frames[i].pinCount   = 0;
+        frames[i].refCount   = 0;
+        frames[i].referenced = false;
+        frames[i].age        = 0;
+        frames[i].nextFree   = i + 1 < numFrames ? (int) i + 1 : -1;
+        frames[i].zeroed     = false;
+    }
+    freeHead  = 0;
+    zeroHead  = -1;
+    numFree   = numFrames;
+    numZeroed = 0;
+
+    stats->minFreeFrames = numFree;
+
+#ifdef SWAP
+    cleanThreshold  = numFrames / 8 > 0 ? numFrames / 8 : 1;
+    cleanScheduled  = false;
+    numDirtyVictims = 0;
+    cleanPending    = new Semaphore("page cleaner", 0);
+
+    Thread *t = new Thread("page cleaner", false, PRIORITY_DEFAULT);
+    t->Fork(CleanHelper, this);
+#endif
+
+    zeroer        = nullptr;
+    zeroScheduled = false;
+    zeroPending   = nullptr;
+}
+
+CoreMap::~CoreMap()
+{
+#ifdef SWAP
+    delete cleanPending;
+#endif
+    delete zeroPending;
+    for (unsigned i = 0; i < numFrames; i++) {
+        ClearSharers(&frames[i]);
+    }
+    delete [] frames;
+}
+
+unsigned
+CoreMap::Allocate(AddressSpace *space, unsigned vpn, int preferred,
+                  bool *zeroed)
+{
+    unsigned frame;
+#ifdef SWAP
+    bool wakeCleaner;
+#endif
+    if (numFree > 0) {
+        frame = TakeFree(preferred, zeroed != nullptr);
+        numFree--;
+        if (numFree < stats->minFreeFrames) {
+            stats->minFreeFrames = numFree;
+        }
+        if (frameBitmap != nullptr) {
+            frameBitmap->Mark(frame);
+        }
+#ifdef SWAP
+        wakeCleaner = numFree < cleanThreshold;
+#endif
+    } else {
+#ifdef SWAP
+        // Collecting reference bits may let other threads run, and free
+        // or clean frames under the clock hand.
+        IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+        frame = ChooseVictim();
+        DEBUG('v', "Evicting page %u from frame %u\n",
+              frames[frame].virtualPage, frame);
+        // Dirty victims mean the clean ones ran out.
+        if (CollectBits(frame)->dirty) {
+            numDirtyVictims++;
+        }
+        wakeCleaner = numDirtyVictims >= CLEAN_BATCH;
+
+        // Eviction may block writing the page out; keep anybody else from
+        // choosing the same frame meanwhile.
+        Pin(frame);
+        Evict(frame, oldLevel);
+        Unpin(frame);
+        stats->numEvictions++;
+#else
+        ASSERT(false);  // Nowhere to evict pages to.
+        return 0;
+#endif
+    }
+
+    frames[frame].owner       = space;
+    frames[frame].virtualPage = vpn;
+    frames[frame].referenced  = true;
+    frames[frame].refCount    = 1;
+    frames[frame].loadOrder   = numLoads++;
+    frames[frame].age         = 0;
+
+    if (zeroed != nullptr) {
+        *zeroed = frames[frame].zeroed;
+        if (*zeroed) {
+            stats->numZeroedFramesUsed++;
+        }
+    }
+    frames[frame].zeroed = false;  // Whoever gets it writes it.
+
+#ifdef SWAP
+    // Waking the cleaner may let other threads run: keep them from taking
+    // the frame before the caller gets to fill it.
+    if (wakeCleaner && !cleanScheduled) {
+        cleanScheduled = true;
+        Pin(frame);
+        cleanPending->V();
+        Unpin(frame);
+    }
+#endif
+    return frame;
+}
+
+#ifdef SWAP
+unsigned
+CoreMap::EvictAll(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    unsigned freed = 0;
+    for (unsigned frame = 0; frame < numFrames; frame++) {
+        if (frames[frame].owner != space || frames[frame].pinCount > 0) {
+            continue;
+        }
+        Pin(frame);
+        space->EvictPage(frames[frame].virtualPage);
+        Unpin(frame);
+        Free(frame);
+        stats->numEvictions++;
+        freed++;
+    }
+    return freed;
+}
+
+/// Victims are chosen by second chance among the frames of `space` alone,
+/// from the clock hand on, without moving it.  Pinned and shared frames
+/// are not evicted; if they are all the space has left, it is let go over
+/// its limit rather than made to wait.
+unsigned
+CoreMap::Trim(AddressSpace *space, unsigned limit)
+{
+    ASSERT(space != nullptr);
+    ASSERT(limit > 0);
+
+    unsigned evicted = 0;
+    for (;;) {
+        IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+        unsigned owned    = 0;
+        unsigned victim   = numFrames;
+        unsigned fallback = numFrames;
+        for (unsigned n = 0; n < numFrames; n++) {
+            unsigned frame = (hand + n) % numFrames;
+            if (frames[frame].refCount == 0 || frames[frame].owner != space) {
+                continue;
+            }
+            owned++;
+            if (victim < numFrames || !IsEvictable(frame)) {
+                continue;
+            }
+            CollectBits(frame);
+            if (!frames[frame].referenced) {
+                victim = frame;
+            } else {
+                frames[frame].referenced = false;
+                if (fallback == numFrames) {
+                    fallback = frame;
+                }
+            }
+        }
+        if (victim == numFrames) {
+            victim = fallback;
+        }
+        if (owned < limit || victim == numFrames) {
+            interrupt->SetLevel(oldLevel);
+            return evicted;
+        }
+
+        DEBUG('v', "Evicting page %u from frame %u, at the limit of %u\n",
+              frames[victim].virtualPage, victim, limit);
+        Pin(victim);
+        interrupt->SetLevel(oldLevel);
+        space->EvictPage(frames[victim].virtualPage);
+        Unpin(victim);
+        Free(victim);
+        stats->numEvictions++;
+        evicted++;
+    }
+}
+
+void
+CoreMap::CleanLoop()
+{
+    for (;;) {
+        cleanPending->P();
+        cleanScheduled  = false;
+        numDirtyVictims = 0;
+        unsigned cleaned = Clean(CLEAN_BATCH);
+        DEBUG('v', "Cleaned %u pages\n", cleaned);
+    }
+}
+
+/// Frames are looked at from the last one the clock hand passed backwards,
+/// so that the pages cleaned are the last to be reached by the hand: those
+/// ahead of it, about to be chosen if clean, may still be in use.
+///
+/// Pages are chosen all at once, with interrupts off, and then written.
+/// The bits kept by the TLB are left alone, since working sets are sampled
+/// from them: a page the TLB has seen lately is in use anyway.
+/// The space of each is attached to meanwhile, so that it is not deleted
+/// under the cleaner, and deleted here instead if its last thread went
+/// away.
+unsigned
+CoreMap::Clean(unsigned count)
+{
+    unsigned *batch = new unsigned [count];
+    unsigned numChosen = 0;
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    for (unsigned n = 0; n < numFrames && numChosen < count; n++) {
+        unsigned frame = (hand + numFrames - 1 - n) % numFrames;
+        if (frames[frame].refCount == 0 || !IsEvictable(frame)
+              || frames[frame].owner == nullptr) {
+            continue;  // Shared pages are clean.
+        }
+        const TranslationEntry *e = frames[frame].owner->GetPageEntry(
+                                        frames[frame].virtualPage);
+        if (frames[frame].referenced || e->use || !e->dirty) {
+            continue;
+        }
+        Pin(frame);
+        frames[frame].owner->Attach();
+        batch[numChosen++] = frame;
+    }
+    interrupt->SetLevel(oldLevel);
+
+    unsigned cleaned = 0;
+    for (unsigned i = 0; i < numChosen; i++) {
+        unsigned frame = batch[i];
+        AddressSpace *space = frames[frame].owner;
+        if (space->CleanPage(frames[frame].virtualPage)) {
+            stats->numPagesCleaned++;
+            cleaned++;
+        }
+        Unpin(frame);
+        if (space->Detach()) {
+            delete space;
+        }
+    }
+    delete [] batch;
+    return cleaned;
+}
+#endif
+
+bool
+CoreMap::Free(unsigned frame, AddressSpace *space, unsigned vpn)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(frames[frame].refCount > 0);
+
+    FrameInfo *f = &frames[frame];
+    if (space != nullptr) {
+        RemoveSharer(f, space, vpn);
+    }
+    if (--f->refCount > 0) {
+        // Still mapped by somebody else; if by a single page, that page is
+        // the owner from now on.
+        if (f->refCount == 1 && f->owner == nullptr && f->sharers != nullptr
+              && f->sharers->next == nullptr) {
+            f->owner       = f->sharers->space;
+            f->virtualPage = f->sharers->virtualPage;
+            ClearSharers(f);
+        }
+        return false;
+    }
+
+    ASSERT(frames[frame].pinCount == 0);
+    ClearSharers(f);
+    frames[frame].owner    = nullptr;
+    frames[frame].nextFree = freeHead;
+    frames[frame].zeroed   = false;
+    freeHead = frame;
+    numFree++;
+    if (frameBitmap != nullptr) {
+        frameBitmap->Clear(frame);
+    }
+    return true;
+}
+
+/// The free lists are not ordered, so finding `preferred` in one takes a
+/// walk; it is as long as there are free frames, which are few when it
+/// matters.
+unsigned
+CoreMap::TakeFree(int preferred, bool wantZeros)
+{
+    ASSERT(numFree > 0);
+
+    int *link;
+    if (preferred >= 0 && (unsigned) preferred < numFrames
+          && frames[preferred].refCount == 0) {
+        link = frames[preferred].zeroed ? &zeroHead : &freeHead;
+        while (*link != preferred) {
+            ASSERT(*link != -1);
+            link = &frames[*link].nextFree;
+        }
+    } else if (wantZeros) {
+        link = zeroHead != -1 ? &zeroHead : &freeHead;
+    } else {
+        link = freeHead != -1 ? &freeHead : &zeroHead;
+    }
+    unsigned frame = *link;
+    *link = frames[frame].nextFree;
+    if (frames[frame].zeroed) {
+        numZeroed--;
+    }
+    return frame;
+}
+
+void
+CoreMap::StartZeroing()
+{
+    ASSERT(zeroer == nullptr);
+
+    zeroPending = new Semaphore("frame zeroer", 0);
+    zeroer = new Thread("frame zeroer", false, PRIORITY_DEFAULT);
+    zeroer->Fork(ZeroHelper, this);
+}
+
+/// The zeroer itself may be the thread going to sleep; it is never woken
+/// from there, lest it be switched to from its own stack.
+bool
+CoreMap::WakeZeroer()
+{
+    if (zeroer == nullptr || zeroScheduled || currentThread == zeroer
+          || numZeroed == numFree) {
+        return false;
+    }
+    zeroScheduled = true;
+    zeroPending->V();
+    return true;
+}
+
+/// Frames are cleared one at a time, letting the clock tick after each, so
+/// that the zeroer takes time like any other thread, and gives up as soon
+/// as an interrupt has made some other thread ready: it only ever runs on
+/// time nobody else wanted.
+void
+CoreMap::ZeroLoop()
+{
+    char *mainMemory = machine->GetMMU()->mainMemory;
+
+    for (;;) {
+        zeroPending->P();
+        unsigned cleared = 0;
+        for (;;) {
+            IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+            if (freeHead == -1 || scheduler->GetNumReady() > 0) {
+                interrupt->SetLevel(oldLevel);
+                break;
+            }
+            unsigned frame = freeHead;
+            freeHead = frames[frame].nextFree;
+            memset(&mainMemory[frame * PAGE_SIZE], 0, PAGE_SIZE);
+            frames[frame].zeroed   = true;
+            frames[frame].nextFree = zeroHead;
+            zeroHead = frame;
+            numZeroed++;
+            stats->numFramesZeroed++;
+            cleared++;
+            interrupt->SetLevel(oldLevel);
+        }
+        DEBUG('v', "Zeroed %u free frames\n", cleared);
+        zeroScheduled = false;
+    }
+}
+
+void
+CoreMap::Share(unsigned frame, AddressSpace *space, unsigned vpn)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(frames[frame].refCount > 0);
+
+    FrameInfo *f = &frames[frame];
+    if (f->owner != nullptr) {
+        AddSharer(f, f->owner, f->virtualPage);
+        f->owner = nullptr;
+    }
+    if (space != nullptr) {
+        AddSharer(f, space, vpn);
+    }
+    f->refCount++;
+}
+
+void
+CoreMap::SetOwner(unsigned frame, AddressSpace *space, unsigned vpn)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(frames[frame].refCount == 1);
+    ASSERT(space != nullptr);
+
+    ClearSharers(&frames[frame]);
+    frames[frame].owner       = space;
+    frames[frame].virtualPage = vpn;
+}
+
+void
+CoreMap::AddSharer(FrameInfo *f, AddressSpace *space, unsigned vpn)
+{
+    ASSERT(f != nullptr);
+    ASSERT(space != nullptr);
+
+    FrameSharer *s = new FrameSharer;
+    s->space       = space;
+    s->virtualPage = vpn;
+    s->next        = f->sharers;
+    f->sharers = s;
+}
+
+void
+CoreMap::RemoveSharer(FrameInfo *f, AddressSpace *space, unsigned vpn)
+{
+    ASSERT(f != nullptr);
+
+    for (FrameSharer **link = &f->sharers; *link != nullptr;
+         link = &(*link)->next) {
+        FrameSharer *s = *link;
+        if (s->space == space && s->virtualPage == vpn) {
+            *link = s->next;
+            delete s;
+            return;
+        }
+    }
+}
+
+void
+CoreMap::ClearSharers(FrameInfo *f)
+{
+    ASSERT(f != nullptr);
+
+    while (f->sharers != nullptr) {
+        FrameSharer *s = f->sharers;
+        f->sharers = s->next;
+        delete s;
+    }
+}
+
+unsigned
+CoreMap::GetRefCount(unsigned frame) const
+{
+    ASSERT(frame < numFrames);
+
+    return frames[frame].refCount;
+}
+
+void
+CoreMap::Pin(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(frames[frame].refCount > 0);
+
+    frames[frame].pinCount++;
+}
+
+void
+CoreMap::Unpin(unsigned frame)
+{
+    ASSERT(frame < numFrames);
+    ASSERT(frames[frame].pinCount > 0);
+
+    frames[frame].pinCount--;
+}
+
+void
+CoreMap::UpdateBits(const TranslationEntry *entry)
+{
+    ASSERT(entry != nullptr);
+
+    if (!entry->valid) {
+        return;
+    }
+
+    unsigned span = entry->large ? TranslationEntry::LARGE_PAGE_PAGES : 1;
+    for (unsigned k = 0; k < span; k++) {
+        unsigned frame = entry->physicalPage + k;
+        if (frame >= numFrames || frames[frame].owner == nullptr
+              || frames[frame].virtualPage != entry->virtualPage + k) {
+            continue;  // Stale entry: the page is gone already.
+        }
+
+        TranslationEntry *e = frames[frame].owner->GetPageEntry(
+                                  frames[frame].virtualPage);
+        e->dirty = e->dirty || entry->dirty;
+        frames[frame].referenced = frames[frame].referenced || entry->use;
+    }
+}
+
+AddressSpace *
+CoreMap::GetOwner(unsigned frame, unsigned *vpn) const
+{
+    ASSERT(frame < numFrames);
+
+    if (vpn != nullptr) {
+        *vpn = frames[frame].virtualPage;
+    }
+    return frames[frame].owner;
+}
+
+unsigned
+CoreMap::CountClear() const
+{
+    return numFree;
+}
+
+unsigned
+CoreMap::CountPinned() const
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < numFrames; i++) {
+        if (frames[i].pinCount > 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/// A shared frame may be evicted if every page mapping it is known, to be
+/// evicted along with it.
+bool
+CoreMap::IsEvictable(unsigned frame) const
+{
+    const FrameInfo *f = &frames[frame];
+    ASSERT(f->refCount > 0);
+
+    if (f->pinCount > 0) {
+        return false;
+    }
+    if (f->owner != nullptr) {
+        return true;
+    }
+    unsigned known = 0;
+    for (const FrameSharer *s = f->sharers; s != nullptr; s = s->next) {
+        known++;
+    }
+    return known == f->refCount;
+}
+
+#ifdef SWAP
+/// The spaces mapping the frame are attached to meanwhile, as in `Clean`,
+/// so that none is deleted under the eviction, which may block.  A page
+/// sharing the frame meanwhile is evicted as well, and one that left it
+/// for a copy of its own is left alone.  The count of references is left
+/// for `Allocate` to reset, so that no sharer going away can free the
+/// frame.
+void
+CoreMap::Evict(unsigned frame, IntStatus oldLevel)
+{
+    FrameInfo *f = &frames[frame];
+    ASSERT(f->pinCount > 0);
+
+    for (;;) {
+        FrameSharer *evicted = f->sharers;
+        f->sharers = nullptr;
+        if (f->owner != nullptr) {
+            evicted = new FrameSharer;
+            evicted->space       = f->owner;
+            evicted->virtualPage = f->virtualPage;
+            evicted->next        = nullptr;
+            f->owner = nullptr;
+        }
+        if (evicted == nullptr) {
+            break;
+        }
+        for (FrameSharer *s = evicted; s != nullptr; s = s->next) {
+            s->space->Attach();
+        }
+        interrupt->SetLevel(oldLevel);
+
+        for (FrameSharer *s = evicted; s != nullptr; s = s->next) {
+            const TranslationEntry *e = s->space->GetPageEntry(s->virtualPage);
+            if (e->physicalPage == frame) {
+                s->space->EvictPage(s->virtualPage);
+            }
+        }
+        while (evicted != nullptr) {
+            FrameSharer *s = evicted;
+            evicted = s->next;
+            if (s->space->Detach()) {
+                delete s->space;
+            }
+            delete s;
+        }
+        oldLevel = interrupt->SetLevel(INT_OFF);
+    }
+    interrupt->SetLevel(oldLevel);
+}
+#endif
+
+unsigned
+CoreMap::ChooseVictim()
+{
+    switch (policy) {
+        case FRAME_FIFO:
+            return ChooseFIFO();
+        case FRAME_CLOCK:
+            return ChooseClock();
+        case FRAME_AGING:
+            return ChooseAging();
+        case FRAME_RANDOM:
+            return ChooseRandom();
+        default:
+            return ChooseEnhancedClock();
+    }
+}
+
+unsigned
+CoreMap::ChooseFIFO()
+{
+    unsigned victim = numFrames;
+    for (unsigned frame = 0; frame < numFrames; frame++) {
+        if (IsEvictable(frame) && (victim == numFrames
+              || frames[frame].loadOrder < frames[victim].loadOrder)) {
+            victim = frame;
+        }
+    }
+    ASSERT(victim < numFrames);
+    return victim;
+}
+
+/// Second chance.
+///
+/// The first sweep clears the reference bit of every page it skips, so a
+/// victim is found at most in the second one.
+unsigned
+CoreMap::ChooseClock()
+{
+    for (unsigned n = 0; n < 2 * numFrames; n++) {
+        unsigned frame = hand;
+        hand = (hand + 1) % numFrames;
+
+        if (!IsEvictable(frame)) {
+            continue;
+        }
+        CollectBits(frame);
+        if (!frames[frame].referenced) {
+            return frame;
+        }
+        frames[frame].referenced = false;
+    }
+
+    ASSERT(false);
+    return 0;
+}
+
+/// Enhanced second chance.
+///
+/// Even sweeps look for a page neither referenced nor dirty.  Odd sweeps
+/// look for a page not referenced but dirty, clearing the reference bit of
+/// every page they skip.  After the second sweep every reference bit is
+/// clear, so a victim is found at most in the fourth one, unless every
+/// frame is pinned or shared.
+unsigned
+CoreMap::ChooseEnhancedClock()
+{
+    for (unsigned sweep = 0; sweep < 4; sweep++) {
+        for (unsigned n = 0; n < numFrames; n++) {
+            unsigned frame = hand;
+            hand = (hand + 1) % numFrames;
+
+            if (!IsEvictable(frame)) {
+                continue;
+            }
+
+            const TranslationEntry *e = CollectBits(frame);
+            if (!frames[frame].referenced
+                  && e->dirty == (sweep % 2 == 1)) {
+                return frame;
+            }
+            if (sweep % 2 == 1) {
+                frames[frame].referenced = false;
+            }
+        }
+    }
+
+    ASSERT(false);
+    return 0;
+}
+
+/// Aging.
+///
+/// There is no clock interrupt of its own to age pages by, so they are
+/// aged every time a victim is needed, which is when the ages matter.
+/// Among equal ages, the clock hand breaks the tie.
+unsigned
+CoreMap::ChooseAging()
+{
+    unsigned victim = numFrames;
+    for (unsigned n = 0; n < numFrames; n++) {
+        unsigned frame = (hand + n) % numFrames;
+        if (!IsEvictable(frame)) {
+            continue;
+        }
+
+        FrameInfo *f = &frames[frame];
+        CollectBits(frame);
+        f->age = (f->age >> 1) | (f->referenced ? 0x80 : 0);
+        f->referenced = false;
+        if (victim == numFrames || f->age < frames[victim].age) {
+            victim = frame;
+        }
+    }
+    ASSERT(victim < numFrames);
+    hand = (victim + 1) % numFrames;
+    return victim;
+}
+
+unsigned
+CoreMap::ChooseRandom()
+{
+    unsigned start = SystemDep::Random() % numFrames;
+    for (unsigned n = 0; n < numFrames; n++) {
+        unsigned frame = (start + n) % numFrames;
+        if (IsEvictable(frame)) {
+            return frame;
+        }
+    }
+
+    ASSERT(false);
+    return 0;
+}
+
+/// The bits of a shared frame are those of every page mapping it; the
+/// entry returned is a dirty one, if any is.
+TranslationEntry *
+CoreMap::CollectBits(unsigned frame)
+{
+    FrameInfo *f = &frames[frame];
+    if (f->owner == nullptr) {
+        TranslationEntry *chosen = nullptr;
+        for (FrameSharer *s = f->sharers; s != nullptr; s = s->next) {
+            TranslationEntry *e = s->space->GetPageEntry(s->virtualPage);
+            CollectFrameBits(frame, e);
+            f->referenced = f->referenced || e->use;
+            e->use = false;
+            if (chosen == nullptr || e->dirty) {
+                chosen = e;
+            }
+        }
+        ASSERT(chosen != nullptr);
+        return chosen;
+    }
+
+    TranslationEntry *e = f->owner->GetPageEntry(f->virtualPage);
+    CollectFrameBits(frame, e);
+
+    f->referenced = f->referenced || e->use;
+    e->use = false;
+    return e;
+}
@@ -0,0 +1,299 @@
+/// Data structures to keep track of the owner of every physical frame.
+///
+/// The core map is indexed by frame number, and records which page of
+/// which address space lives in each frame.  This is what lets a frame be
+/// taken away from its page without scanning every page table: a victim is
+/// chosen here, and its owner asked to give it up.
+///
+/// Victims are chosen by one of several policies, picked at boot.  The
+/// default is enhanced second chance, looking at the reference bit of each
+/// frame and the `dirty` bit of its page: a page that was not referenced
+/// recently is evicted before one that was, and among those a clean page,
+/// which needs no writeback, before a dirty one.  Whatever the policy,
+/// pinned frames, which the kernel is filling or reading, are never chosen.
+/// A frame shared by several address spaces is evicted from all of them at
+/// once, as long as the core map knows every page mapping it.
+///
+/// With swap, a page cleaner thread writes dirty pages that were not
+/// referenced lately to swap ahead of time, once free frames run low, so
+/// that the next victims are likely clean and a fault takes a single read
+/// instead of a write and a read.
+///
+/// With idle zeroing, a frame zeroer thread clears free frames whenever a
+/// CPU would otherwise sit idle, and the cleared frames are kept on a list
+/// of their own.  A page that has to start out as zeros is given one of
+/// those, and need not be cleared on the fault or `Exec` that brings it.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_COREMAP__HH
+#define NACHOS_VMEM_COREMAP__HH
+
+
+#include "machine/interrupt.hh"
+#include "machine/translation_entry.hh"
+#include "lib/bitmap.hh"
+#include "threads/semaphore.hh"
+
+
+class AddressSpace;
+
+/// Page replacement policies, used by `CoreMap::Allocate` to choose the
+/// frame to evict once none is free.
+enum FramePolicy {
+    FRAME_FIFO,    ///< The page loaded first.
+    FRAME_CLOCK,   ///< Second chance, using the reference bit.
+    FRAME_ECLOCK,  ///< Second chance, preferring clean pages.
+    FRAME_AGING,   ///< The lowest aging counter, approximating LRU.
+    FRAME_RANDOM,  ///< Any frame, at random.
+    NUM_FRAME_POLICIES
+};
+
+/// Parse a policy name (`fifo`, `clock`, `eclock`, `aging` or `random`).
+/// Return false if the name is not known.
+bool ParseFramePolicy(const char *name, FramePolicy *policy);
+
+/// Return the name of a policy.
+const char *FramePolicyToString(FramePolicy policy);
+
+/// A page of some address space mapping a shared frame.
+class FrameSharer {
+public:
+    AddressSpace *space;
+    unsigned virtualPage;
+    FrameSharer *next;
+};
+
+/// What the core map knows about one frame.
+class FrameInfo {
+public:
+
+    /// Address space owning the frame, or null if it is free or shared.
+    AddressSpace *owner;
+
+    /// Pages mapping the frame while it is shared, as told to `Share`, so
+    /// that they can be evicted together, and that the one left once the
+    /// others are gone can own the frame again.
+    FrameSharer *sharers;
+
+    /// Virtual page of `owner` held by the frame.
+    unsigned virtualPage;
+
+    /// Number of outstanding `Pin` calls.
+    unsigned pinCount;
+
+    /// Number of address spaces mapping the frame; 0 if it is free.
+    unsigned refCount;
+
+    /// Whether the page was referenced since the clock hand last passed,
+    /// or since the frame was last aged.
+    bool referenced;
+
+    /// Order in which the page was loaded, for `FRAME_FIFO`.
+    unsigned long loadOrder;
+
+    /// Reference history, for `FRAME_AGING`: shifted right every time a
+    /// victim is chosen, with the reference bit going in at the top.
+    unsigned char age;
+
+    /// Next free frame, or -1; only meaningful while the frame is free.
+    int nextFree;
+
+    /// Whether the frame is known to hold only zeros; only meaningful
+    /// while the frame is free.
+    bool zeroed;
+};
+
+class CoreMap {
+public:
+
+#ifdef SWAP
+    /// Most pages the cleaner writes each time it is woken, and dirty
+    /// victims after which it is woken again.
+    static const unsigned CLEAN_BATCH = 8;
+#endif
+
+    /// Create a core map for `numFrames` free frames, replaced by
+    /// `policy`.
+    ///
+    /// `frameBitmap`, if not null, is kept marking the frames in use, so
+    /// that it stays accurate for code that still looks at it.
+    CoreMap(unsigned numFrames, Bitmap *frameBitmap = nullptr,
+            FramePolicy policy = FRAME_ECLOCK);
+
+    ~CoreMap();
+
+    /// Give a frame to page `vpn` of `space`, evicting some other page if
+    /// none is free.  Return the frame number.
+    ///
+    /// If `preferred` is a free frame, it is the one given, so that pages
+    /// can be laid out for large translations.  A null `space` gives a
+    /// frame nobody owns, which is never evicted, for a shared segment.
+    ///
+    /// If `zeroed` is not null, the page has to start out as zeros: a
+    /// cleared frame is given if there is one, and `*zeroed` tells whether
+    /// it was.  Otherwise cleared frames are left for those who need them.
+    unsigned Allocate(AddressSpace *space, unsigned vpn, int preferred = -1,
+                      bool *zeroed = nullptr);
+
+    /// Drop one reference to `frame`, whose page is no longer needed by
+    /// some address space: page `vpn` of `space`, if not null.  Return
+    /// true if the frame became free.
+    ///
+    /// Once a shared frame is down to one reference, held by a page given
+    /// to `Share`, that page owns the frame again, and it can be evicted.
+    bool Free(unsigned frame, AddressSpace *space = nullptr,
+              unsigned vpn = 0);
+
+    /// Add a reference to `frame`, now mapped by one more address space:
+    /// by page `vpn` of `space`, if not null.
+    ///
+    /// A shared frame has no single owner: it is evicted from every page
+    /// sharing it, which is only done if all of them were given.  Pages of
+    /// a shared segment, which belongs to no address space, are shared
+    /// without a `space`, and never evicted.
+    void Share(unsigned frame, AddressSpace *space = nullptr,
+               unsigned vpn = 0);
+
+    /// Make page `vpn` of `space` the owner of `frame`, which must have a
+    /// single reference.
+    void SetOwner(unsigned frame, AddressSpace *space, unsigned vpn);
+
+    /// Return the number of address spaces mapping `frame`.
+    unsigned GetRefCount(unsigned frame) const;
+
+    /// Keep `frame` from being evicted until the matching `Unpin`.
+    void Pin(unsigned frame);
+    void Unpin(unsigned frame);
+
+    /// Write the `use` and `dirty` bits of `entry`, which was just dropped
+    /// from the TLB, back into the core map and page table of the page it
+    /// maps, or of every page, if it is large.
+    void UpdateBits(const TranslationEntry *entry);
+
+#ifdef SWAP
+    /// Evict every page of `space` held in a frame of its own, freeing
+    /// the frames; pinned and shared frames are left alone.  Return the
+    /// number of frames freed.
+    unsigned EvictAll(AddressSpace *space);
+
+    /// Evict pages of `space` held in frames of its own until it holds
+    /// fewer than `limit`, so that it can take one more.  Return the
+    /// number of pages evicted.
+    unsigned Trim(AddressSpace *space, unsigned limit);
+
+    /// Clean pages, forever.  Run by the page cleaner thread.
+    void CleanLoop();
+#endif
+
+    /// Start the frame zeroer thread.
+    void StartZeroing();
+
+    /// Wake the zeroer, if it is enabled and there are free frames to
+    /// clear.  Called when a CPU has no thread to run; return true if the
+    /// zeroer was made ready to run instead.
+    bool WakeZeroer();
+
+    /// Clear free frames, forever.  Run by the frame zeroer thread.
+    void ZeroLoop();
+
+    /// Return the owner of `frame`, or null if it is free or shared, and
+    /// the page it holds.
+    AddressSpace *GetOwner(unsigned frame, unsigned *vpn = nullptr) const;
+
+    /// Return the number of free, and of pinned, frames.
+    unsigned CountClear() const;
+    unsigned CountPinned() const;
+
+private:
+
+    /// Choose a frame to evict; every frame must be in use.  Pinned frames,
+    /// and shared ones not known to be evictable, are skipped.
+    unsigned ChooseVictim();
+
+    /// Choose a victim by each policy.
+    unsigned ChooseFIFO();
+    unsigned ChooseClock();
+    unsigned ChooseEnhancedClock();
+    unsigned ChooseAging();
+    unsigned ChooseRandom();
+
+    /// Return whether `frame` may be evicted.
+    bool IsEvictable(unsigned frame) const;
+
+#ifdef SWAP
+    /// Evict the page in `frame`, which must be pinned, or every page
+    /// sharing it.  Called with interrupts off; they are set back to
+    /// `oldLevel` while pages are written out, and on return.
+    void Evict(unsigned frame, IntStatus oldLevel);
+#endif
+
+#ifdef SWAP
+    /// Write up to `count` dirty pages, not referenced lately, to swap,
+    /// looking back from the clock hand.  Return how many were written.
+    unsigned Clean(unsigned count);
+#endif
+
+    /// Fold the reference bits of the page in `frame`, from its page table
+    /// entry and the TLB, into `frames[frame].referenced`, and return the
+    /// page table entry.
+    TranslationEntry *CollectBits(unsigned frame);
+
+    /// Record page `vpn` of `space` as mapping the shared frame `f`, or
+    /// forget it.
+    static void AddSharer(FrameInfo *f, AddressSpace *space, unsigned vpn);
+    static void RemoveSharer(FrameInfo *f, AddressSpace *space,
+                             unsigned vpn);
+
+    /// Forget every page recorded as mapping `f`.
+    static void ClearSharers(FrameInfo *f);
+
+    /// Take `preferred` off the free lists if it is there, or else the
+    /// first free frame, cleared if `wantZeros` and there is one, and
+    /// return it.
+    unsigned TakeFree(int preferred, bool wantZeros);
+
+    unsigned numFrames;
+    FrameInfo *frames;
+
+    /// First free frame, or -1; free frames are linked through `nextFree`.
+    /// Cleared ones are linked apart from the rest, from `zeroHead`.
+    int freeHead;
+    int zeroHead;
+    unsigned numFree;
+    unsigned numZeroed;
+
+    Bitmap *frameBitmap;
+
+    FramePolicy policy;
+
+    /// Next frame to be considered by the clock algorithms.
+    unsigned hand;
+
+    /// Pages loaded so far, to number them for `FRAME_FIFO`.
+    unsigned long numLoads;
+
+#ifdef SWAP
+    /// Free frames below which the cleaner is woken.
+    unsigned cleanThreshold;
+
+    /// Dirty pages evicted since the cleaner last ran.
+    unsigned numDirtyVictims;
+
+    /// Whether the cleaner has been woken and not yet started cleaning.
+    bool cleanScheduled;
+    Semaphore *cleanPending;
+#endif
+
+    /// The frame zeroer, or null if idle zeroing is off, and whether it has
+    /// been woken and not yet gone back to sleep.
+    Thread *zeroer;
+    bool zeroScheduled;
+    Semaphore *zeroPending;
+};
+
+
+#endif
@@ -0,0 +1,238 @@
+/// Routines to admit and suspend address spaces by the memory they need.
+///
+/// Like semaphores, the scheduler is made atomic by turning interrupts
+/// off, rather than with a lock: spaces leave from `Scheduler::Run`, as the
+/// thread that was using them is destroyed, where nothing may block.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "memory_scheduler.hh"
+#include "threads/system.hh"
+
+
+MemoryScheduler::MemoryScheduler(unsigned numFrames_)
+{
+    numFrames  = numFrames_;
+    first      = nullptr;
+    committed  = 0;
+    numActive  = 0;
+    numBlocked = 0;
+    numUpdates = 0;
+}
+
+MemoryScheduler::~MemoryScheduler()
+{
+    while (first != nullptr) {
+        Commitment *c = first;
+        first = c->next;
+        delete c;
+    }
+}
+
+MemoryScheduler::Commitment *
+MemoryScheduler::Find(const AddressSpace *space) const
+{
+    for (Commitment *c = first; c != nullptr; c = c->next) {
+        if (c->space == space) {
+            return c;
+        }
+    }
+    return nullptr;
+}
+
+bool
+MemoryScheduler::Fits(unsigned pages) const
+{
+    if (numActive == 0) {
+        return true;
+    }
+#ifdef SWAP
+    return committed + pages <= numFrames;
+#else
+    // Pages are never taken away: they must be free already.
+    return pages <= coreMap->CountClear();
+#endif
+}
+
+void
+MemoryScheduler::WakeWaiters()
+{
+    Thread *t;
+    while ((t = waiters.Pop()) != nullptr) {
+        scheduler->ReadyToRun(t);
+    }
+}
+
+/// The space of the calling thread, if admitted, counts as blocked while it
+/// waits, so that two parents waiting for each other to make room do not
+/// wait forever.
+void
+MemoryScheduler::Admit(AddressSpace *space, unsigned numPages)
+{
+    ASSERT(space != nullptr);
+    ASSERT(Find(space) == nullptr);
+
+#ifdef SWAP
+    unsigned pages = numPages < FIRST_ESTIMATE ? numPages : FIRST_ESTIMATE;
+#else
+    unsigned pages = numPages;
+#endif
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Commitment *own = currentThread->space == nullptr
+                      ? nullptr : Find(currentThread->space);
+    bool ownActive = own != nullptr && !own->suspended;
+    if (ownActive) {
+        numBlocked++;
+    }
+    if (!Fits(pages) && numActive > numBlocked) {
+        DEBUG('v', "Deferring a space of %u pages, %u committed\n",
+              pages, committed);
+        stats->numAdmissionWaits++;
+        do {
+            waiters.Append(currentThread);
+            currentThread->Sleep();
+        } while (!Fits(pages) && numActive > numBlocked);
+    }
+    if (ownActive) {
+        numBlocked--;
+    }
+
+    Commitment *c = new Commitment;
+    c->space     = space;
+    c->pages     = pages;
+    c->suspended = false;
+    c->next      = nullptr;
+    Commitment **last = &first;
+    while (*last != nullptr) {
+        last = &(*last)->next;
+    }
+    *last = c;
+    committed += pages;
+    numActive++;
+    interrupt->SetLevel(oldLevel);
+}
+
+void
+MemoryScheduler::Leave(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    for (Commitment **link = &first; *link != nullptr;
+         link = &(*link)->next) {
+        Commitment *c = *link;
+        if (c->space != space) {
+            continue;
+        }
+        *link = c->next;
+        if (!c->suspended) {
+            committed -= c->pages;
+            numActive--;
+        }
+        delete c;
+        WakeWaiters();
+        break;
+    }
+    interrupt->SetLevel(oldLevel);
+}
+
+#ifdef SWAP
+void
+MemoryScheduler::Update(AddressSpace *space, unsigned pages)
+{
+    ASSERT(space != nullptr);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Commitment *c = Find(space);
+    if (c != nullptr && !c->suspended) {
+        numUpdates++;
+        committed = committed - c->pages + pages;
+        bool shrank = pages < c->pages;
+        c->pages = pages;
+        if (shrank) {
+            WakeWaiters();
+        }
+    }
+    interrupt->SetLevel(oldLevel);
+}
+
+/// Pages are swapped out with interrupts on, since writing them may block;
+/// the space is no longer counted by then, so nobody waits for it.
+///
+/// A suspended space checks again every `SUSPENSION_POLL_TICKS`, rather
+/// than waiting to be woken: it must also resume if the others stopped
+/// running, which is told by their working sets no longer being updated,
+/// as happens whenever one of their threads is switched out.
+void
+MemoryScheduler::CheckPressure(AddressSpace *space)
+{
+    ASSERT(space != nullptr);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Commitment *c = Find(space);
+    if (c == nullptr) {
+        interrupt->SetLevel(oldLevel);
+        return;
+    }
+    if (c->suspended) {
+        // Another thread of the space is swapping it out, or waiting.
+        while (c->suspended) {
+            waiters.Append(currentThread);
+            currentThread->Sleep();
+        }
+        interrupt->SetLevel(oldLevel);
+        return;
+    }
+
+    Commitment *youngest = nullptr;
+    for (Commitment *d = first; d != nullptr; d = d->next) {
+        if (!d->suspended) {
+            youngest = d;
+        }
+    }
+    if (committed <= numFrames || numActive <= 1 || youngest != c) {
+        interrupt->SetLevel(oldLevel);
+        return;
+    }
+
+    DEBUG('v', "Suspending a space of %u pages, %u committed\n",
+          c->pages, committed);
+    c->suspended = true;
+    committed -= c->pages;
+    numActive--;
+    stats->numSuspensions++;
+    WakeWaiters();
+    interrupt->SetLevel(oldLevel);
+
+    unsigned evicted = coreMap->EvictAll(space);
+    DEBUG('v', "Swapped %u pages out\n", evicted);
+
+    // Resume with room to spare, not to be suspended again right away.
+    // The spaces left may never shrink, if instead of exiting they wait
+    // for this one: give up waiting once none of them runs.
+    interrupt->SetLevel(INT_OFF);
+    unsigned long lastUpdates;
+    do {
+        lastUpdates = numUpdates;
+        alarmClock->WaitUntil(SUSPENSION_POLL_TICKS);
+    } while (!Fits(c->pages + numFrames / 8) && numActive > numBlocked
+             && numUpdates != lastUpdates);
+    DEBUG('v', "Resuming a space of %u pages, %u committed\n",
+          c->pages, committed);
+    c->suspended = false;
+    committed += c->pages;
+    numActive++;
+    WakeWaiters();  // Other threads of the space.
+    interrupt->SetLevel(oldLevel);
+}
+#endif
+
+unsigned
+MemoryScheduler::GetCommitted() const
+{
+    return committed;
+}
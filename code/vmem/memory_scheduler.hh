@@ -0,0 +1,116 @@
+/// Data structures to keep the memory programs need within what there is.
+///
+/// Every address space is counted in, or *admitted*, by the memory
+/// scheduler before it takes any frame, and waits until what it needs fits
+/// along with the spaces admitted before it.  Without swap, that is every
+/// page of the program, which must all be free.  With swap, it is the
+/// working set of each space, as told by `AddressSpace::GetWorkingSetSize`:
+/// spaces may take more frames than that, and give them up to evictions.
+///
+/// An estimate can only be checked once a program runs, so with swap the
+/// sum of the working sets may grow past the frames there are.  Processes
+/// would then keep taking frames away from each other.  Instead, the space
+/// admitted last is suspended the next time it faults: its pages are all
+/// swapped out, and it waits, as if it were being admitted again, until
+/// it fits with the others, or until none of them runs: they may be
+/// waiting for it.
+///
+/// A space is always let in, or resumed, when no other is counted, so that
+/// a program larger than memory still runs as it did before.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_MEMORYSCHEDULER__HH
+#define NACHOS_VMEM_MEMORYSCHEDULER__HH
+
+
+#include "threads/thread.hh"
+
+
+class AddressSpace;
+
+class MemoryScheduler {
+public:
+
+    /// Pages a space is taken to need, with swap, until its working set
+    /// is known.
+    static const unsigned FIRST_ESTIMATE = 8;
+
+    /// How often a suspended space checks whether it fits.
+    static const unsigned long SUSPENSION_POLL_TICKS = 1000;
+
+    /// Create a scheduler for `numFrames` frames.
+    MemoryScheduler(unsigned numFrames);
+
+    ~MemoryScheduler();
+
+    /// Count `space` in, about to take `numPages` pages, once they fit;
+    /// wait until then.  Called by the thread creating the space.
+    ///
+    /// The wait is skipped if no space that could give frames back is
+    /// running: that is, every space admitted is waiting here too, or is
+    /// that of the calling thread.
+    void Admit(AddressSpace *space, unsigned numPages);
+
+    /// Stop counting `space`, which is being deleted, and let the spaces
+    /// waiting check again whether they fit.  Never blocks.
+    void Leave(AddressSpace *space);
+
+#ifdef SWAP
+    /// Take `pages` as the working set of `space`.  Never blocks.
+    void Update(AddressSpace *space, unsigned pages);
+
+    /// Called by a thread of `space` about to load a page.  If the spaces
+    /// counted need more frames than there are, and `space` is the one
+    /// admitted last, swap all of its pages out and wait until it fits
+    /// again, or until no other space runs.  Other threads of a suspended
+    /// space wait as well.
+    void CheckPressure(AddressSpace *space);
+#endif
+
+    /// Return the pages the spaces counted in are taken to need.
+    unsigned GetCommitted() const;
+
+private:
+
+    /// What is known of an admitted space.  Kept in the order spaces were
+    /// admitted.
+    struct Commitment {
+        AddressSpace *space;
+        unsigned pages;
+        bool suspended;
+        Commitment *next;
+    };
+
+    /// Return the commitment of `space`, or null.
+    Commitment *Find(const AddressSpace *space) const;
+
+    /// Return whether `pages` more pages fit with those counted in.
+    bool Fits(unsigned pages) const;
+
+    /// Wake every thread waiting to fit, to check again.
+    void WakeWaiters();
+
+    unsigned numFrames;
+
+    Commitment *first;
+
+    /// Pages of the spaces counted in, and not suspended.
+    unsigned committed;
+
+    /// Spaces counted in and not suspended, and how many of those are
+    /// waiting in `Admit` for another space to be let in.
+    unsigned numActive;
+    unsigned numBlocked;
+
+    /// Number of calls to `Update` for spaces not suspended.
+    unsigned long numUpdates;
+
+    /// Threads waiting to fit.
+    ThreadQueue waiters;
+};
+
+
+#endif
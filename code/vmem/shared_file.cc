@@ -0,0 +1,141 @@
+/// Routines to share the pages of files mapped read-only.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "shared_file.hh"
+#include "lib/utility.hh"
+
+#include <string.h>
+
+
+int
+SharedFile::GetFrame(unsigned page) const
+{
+    ASSERT(page < numPages);
+
+    return frames[page];
+}
+
+void
+SharedFile::SetFrame(unsigned page, int frame)
+{
+    ASSERT(page < numPages);
+
+    frames[page] = frame;
+}
+
+SharedFileTable::SharedFileTable()
+{
+    list = nullptr;
+}
+
+/// Entries still in use belong to address spaces that are never destroyed,
+/// because the machine halted under them.
+SharedFileTable::~SharedFileTable()
+{
+    while (list != nullptr) {
+        SharedFile *f = list;
+        list = f->next;
+        Delete(f);
+    }
+}
+
+/// A mapping longer than any before it makes the entry grow; the pages
+/// past the old end are in memory for nobody yet.
+SharedFile *
+SharedFileTable::Attach(const char *name, int sector, unsigned numPages)
+{
+    ASSERT(name != nullptr || sector != -1);
+    ASSERT(numPages > 0);
+
+    SharedFile *f = list;
+    while (f != nullptr
+           && !(sector != -1 ? f->sector == sector
+                             : f->name != nullptr
+                               && strcmp(f->name, name) == 0)) {
+        f = f->next;
+    }
+
+    if (f == nullptr) {
+        f = new SharedFile;
+        f->name = nullptr;
+        if (name != nullptr) {
+            f->name = new char [strlen(name) + 1];
+            strcpy(f->name, name);
+        }
+        f->sector   = sector;
+        f->numPages = 0;
+        f->frames   = nullptr;
+        f->users    = 0;
+        f->stale    = false;
+        f->next     = list;
+        list = f;
+    }
+
+    if (numPages > f->numPages) {
+        int *frames = new int [numPages];
+        for (unsigned i = 0; i < numPages; i++) {
+            frames[i] = i < f->numPages ? f->frames[i] : -1;
+        }
+        delete [] f->frames;
+        f->frames   = frames;
+        f->numPages = numPages;
+    }
+    f->users++;
+    return f;
+}
+
+void
+SharedFileTable::Detach(SharedFile *file)
+{
+    ASSERT(file != nullptr);
+    ASSERT(file->users > 0);
+
+    if (--file->users > 0) {
+        return;
+    }
+
+    if (!file->stale) {
+        for (SharedFile **link = &list; *link != nullptr;
+             link = &(*link)->next) {
+            if (*link == file) {
+                *link = file->next;
+                break;
+            }
+        }
+    }
+    Delete(file);
+}
+
+void
+SharedFileTable::Invalidate(const char *name, int sector)
+{
+    SharedFile **link = &list;
+    while (*link != nullptr) {
+        SharedFile *f = *link;
+        if ((sector != -1 && f->sector == sector)
+              || (name != nullptr && f->name != nullptr
+                  && strcmp(f->name, name) == 0)) {
+            *link = f->next;
+            f->stale = true;
+            if (f->users == 0) {
+                Delete(f);
+            }
+        } else {
+            link = &f->next;
+        }
+    }
+}
+
+void
+SharedFileTable::Delete(SharedFile *file)
+{
+    ASSERT(file != nullptr);
+
+    delete [] file->name;
+    delete [] file->frames;
+    delete file;
+}
@@ -0,0 +1,82 @@
+/// Data structures to share the pages of files mapped read-only.
+///
+/// Processes reading the same file through read-only mappings see the same
+/// bytes, and none of them writes to them.  The frame holding each page of
+/// such a file is recorded here, so that further mappings of the file map
+/// the frame instead of reading a copy of their own: however many readers
+/// there are, every page is read from the file once, and kept in memory
+/// once.  The core map counts the references to every frame.
+///
+/// Files are identified by the sector of their header with the real file
+/// system, and by name otherwise.  Writing to a file, creating it again or
+/// removing it makes the file system forget its entry, through
+/// `InvalidateImage`: later mappings read the new contents, while those
+/// already made keep the pages they had.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_SHAREDFILE__HH
+#define NACHOS_VMEM_SHAREDFILE__HH
+
+
+/// The pages of one file mapped read-only.
+class SharedFile {
+public:
+
+    /// Name of the file, or null with the real file system.
+    char *name;
+
+    /// Sector of the header of the file, or -1 without the real file
+    /// system.
+    int sector;
+
+    /// Frame holding each of the first `numPages` pages of the file, or -1
+    /// if no address space has it in memory.
+    unsigned numPages;
+    int *frames;
+
+    /// Number of mappings using this entry.
+    unsigned users;
+
+    /// Whether the file changed since the entry was made; it is then out
+    /// of the table, and goes away with its last user.
+    bool stale;
+
+    SharedFile *next;
+
+    /// Return the frame holding page `page` of the file, or -1.
+    int GetFrame(unsigned page) const;
+
+    /// Record that page `page` is in `frame`; -1 forgets it.
+    void SetFrame(unsigned page, int frame);
+};
+
+class SharedFileTable {
+public:
+
+    SharedFileTable();
+
+    ~SharedFileTable();
+
+    /// Start mapping the first `numPages` pages of the file called `name`,
+    /// or whose header is at `sector`.
+    SharedFile *Attach(const char *name, int sector, unsigned numPages);
+
+    /// Stop using `file`; it goes away with its last user.
+    void Detach(SharedFile *file);
+
+    /// Forget the pages of the file called `name`, or whose header is at
+    /// `sector`, which changed.
+    void Invalidate(const char *name, int sector);
+
+private:
+
+    static void Delete(SharedFile *file);
+
+    SharedFile *list;
+};
+
+
+#endif
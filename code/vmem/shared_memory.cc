@@ -0,0 +1,104 @@
+/// Routines to manage memory shared between processes.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "shared_memory.hh"
+#include "threads/system.hh"
+#include "userprog/tlb_shootdown.hh"
+
+#include <string.h>
+
+
+SegmentTable::SegmentTable()
+{}
+
+/// Segments still in use belong to address spaces that are never
+/// destroyed, because the machine halted under them.
+SegmentTable::~SegmentTable()
+{
+    for (unsigned i = 0; i < segments.Capacity(); i++) {
+        SharedSegment *s = segments.Remove(i);
+        if (s != nullptr) {
+            delete [] s->frames;
+            delete s;
+        }
+    }
+}
+
+/// Frames of a segment cannot be evicted, so a segment may not take more
+/// than half of the machine's memory, and without swap its frames must be
+/// free already.
+int
+SegmentTable::Create(unsigned numPages)
+{
+    ASSERT(numPages > 0);
+
+    if (numPages > numPhysPages / 2) {
+        return -1;
+    }
+#ifndef SWAP
+    if (numPages > coreMap->CountClear()) {
+        return -1;
+    }
+#endif
+
+    SharedSegment *s = new SharedSegment;
+    int id = segments.Add(s);
+    if (id == -1) {
+        delete s;
+        return -1;
+    }
+
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    s->numPages = numPages;
+    s->frames   = new unsigned [numPages];
+    s->users    = 0;
+    for (unsigned i = 0; i < numPages; i++) {
+        bool zeroed;  // Nobody owns the frame.
+        s->frames[i] = coreMap->Allocate(nullptr, 0, -1, &zeroed);
+        if (!zeroed) {
+            memset(&mainMemory[s->frames[i] * PAGE_SIZE], 0, PAGE_SIZE);
+        }
+    }
+    DEBUG('a', "Created shared segment %d of %u pages\n", id, numPages);
+    return id;
+}
+
+SharedSegment *
+SegmentTable::Get(int id) const
+{
+    return segments.HasKey(id) ? segments.Get(id) : nullptr;
+}
+
+void
+SegmentTable::Attach(int id)
+{
+    SharedSegment *s = Get(id);
+    ASSERT(s != nullptr);
+
+    s->users++;
+}
+
+void
+SegmentTable::Detach(int id)
+{
+    SharedSegment *s = Get(id);
+    ASSERT(s != nullptr);
+
+    if (s->users > 0 && --s->users > 0) {
+        return;
+    }
+
+    DEBUG('a', "Removing shared segment %d\n", id);
+    for (unsigned i = 0; i < s->numPages; i++) {
+        if (coreMap->Free(s->frames[i])) {
+            InvalidateFrameCode(s->frames[i]);
+        }
+    }
+    segments.Remove(id);
+    delete [] s->frames;
+    delete s;
+}
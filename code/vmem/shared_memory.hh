@@ -0,0 +1,64 @@
+/// Data structures for memory shared between processes.
+///
+/// A shared memory segment is a set of frames that several address spaces
+/// map at once, through `ShmAttach`, so that whatever one process writes
+/// there the others see right away, without copying anything.  The core
+/// map counts the references to every frame: the segment holds one, and
+/// every address space attaching it one more.  Frames of a segment have no
+/// single owner, so they are never evicted.
+///
+/// Segments are identified by number, kernel-wide.  A segment goes away,
+/// and its frames are freed, once the last address space detaches it.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_SHAREDMEMORY__HH
+#define NACHOS_VMEM_SHAREDMEMORY__HH
+
+
+#include "lib/table.hh"
+
+
+/// The frames of one segment.
+class SharedSegment {
+public:
+
+    /// Number of pages, and the frame holding each of them.
+    unsigned numPages;
+    unsigned *frames;
+
+    /// Number of address spaces attaching the segment.
+    unsigned users;
+};
+
+class SegmentTable {
+public:
+
+    SegmentTable();
+
+    ~SegmentTable();
+
+    /// Make a segment of `numPages` pages of zeros, and return its
+    /// identifier, or -1 if there is no memory for it.  It has no users
+    /// until attached.
+    int Create(unsigned numPages);
+
+    /// Return segment `id`, or null if there is no such segment.
+    SharedSegment *Get(int id) const;
+
+    /// Start using segment `id`, which must exist.
+    void Attach(int id);
+
+    /// Stop using segment `id`, or give it up if it was never attached; it
+    /// goes away with its last user.
+    void Detach(int id);
+
+private:
+
+    Table<SharedSegment*> segments;
+};
+
+
+#endif
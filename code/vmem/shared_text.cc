@@ -0,0 +1,147 @@
+/// Routines to share the code of an executable between processes.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "shared_text.hh"
+#include "lib/utility.hh"
+
+#include <string.h>
+
+
+bool
+SharedText::Has(unsigned vpn) const
+{
+    return vpn >= firstPage && vpn - firstPage < numPages;
+}
+
+int
+SharedText::GetFrame(unsigned vpn) const
+{
+    ASSERT(Has(vpn));
+
+    return frames[vpn - firstPage];
+}
+
+void
+SharedText::SetFrame(unsigned vpn, int frame)
+{
+    ASSERT(Has(vpn));
+
+    frames[vpn - firstPage] = frame;
+}
+
+TextTable::TextTable()
+{
+    list = nullptr;
+}
+
+/// Entries still in use belong to address spaces that are never destroyed,
+/// because the machine halted under them.
+TextTable::~TextTable()
+{
+    while (list != nullptr) {
+        SharedText *t = list;
+        list = t->next;
+        Delete(t);
+    }
+}
+
+SharedText *
+TextTable::Attach(const char *name, int sector, unsigned firstPage,
+                  unsigned numPages)
+{
+    ASSERT(name != nullptr || sector != -1);
+
+    for (SharedText *t = list; t != nullptr; t = t->next) {
+        bool same = sector != -1 ? t->sector == sector
+                                 : t->name != nullptr
+                                   && strcmp(t->name, name) == 0;
+        // Any other layout means the file changed since; do not share with
+        // the copies already running.
+        if (same && t->firstPage == firstPage && t->numPages == numPages) {
+            t->users++;
+            return t;
+        }
+    }
+
+    SharedText *t = new SharedText;
+    t->name = nullptr;
+    if (sector == -1) {
+        t->name = new char [strlen(name) + 1];
+        strcpy(t->name, name);
+    }
+    t->sector    = sector;
+    t->firstPage = firstPage;
+    t->numPages  = numPages;
+    t->frames    = new int [numPages];
+    for (unsigned i = 0; i < numPages; i++) {
+        t->frames[i] = -1;
+    }
+    t->users = 1;
+    t->stale = false;
+    t->next  = list;
+    list = t;
+    return t;
+}
+
+void
+TextTable::Attach(SharedText *text)
+{
+    ASSERT(text != nullptr);
+    ASSERT(text->users > 0);
+
+    text->users++;
+}
+
+void
+TextTable::Detach(SharedText *text)
+{
+    ASSERT(text != nullptr);
+    ASSERT(text->users > 0);
+
+    if (--text->users > 0) {
+        return;
+    }
+
+    if (!text->stale) {
+        for (SharedText **link = &list; *link != nullptr;
+             link = &(*link)->next) {
+            if (*link == text) {
+                *link = text->next;
+                break;
+            }
+        }
+    }
+    Delete(text);
+}
+
+void
+TextTable::Invalidate(const char *name, int sector)
+{
+    SharedText **link = &list;
+    while (*link != nullptr) {
+        SharedText *t = *link;
+        if ((sector != -1 && t->sector == sector)
+              || (name != nullptr && t->name != nullptr
+                  && strcmp(t->name, name) == 0)) {
+            *link = t->next;
+            t->stale = true;
+        } else {
+            link = &t->next;
+        }
+    }
+}
+
+void
+TextTable::Delete(SharedText *text)
+{
+    ASSERT(text != nullptr);
+
+    delete [] text->name;
+    delete [] text->frames;
+    delete text;
+}
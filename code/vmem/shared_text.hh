@@ -0,0 +1,96 @@
+/// Data structures to share the code of an executable between processes.
+///
+/// Address spaces loaded from the same executable have identical code
+/// pages, and user programs never write to them.  Those pages are mapped
+/// read-only, and the frame holding each of them is recorded here, so that
+/// further address spaces of the same executable map the frame instead of
+/// loading a copy of their own.  The core map counts the references to
+/// every frame.
+///
+/// Executables are identified by the sector of their header with the real
+/// file system, and by name otherwise, along with the layout of their code.
+/// Writing to an executable, creating it again or removing it makes the
+/// file system forget its entry, through `InvalidateImage`: later address
+/// spaces load the new code, while those already running keep the pages
+/// they had.  Only pages entirely covered by the code segment are shared; a
+/// page that also holds data is private to each address space, as before.
+///
+/// Copyright (c) 1992-1993 The Regents of the University of California.
+///               2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_SHAREDTEXT__HH
+#define NACHOS_VMEM_SHAREDTEXT__HH
+
+
+/// The code pages of one executable.
+class SharedText {
+public:
+
+    /// Name of the executable, or null with the real file system.
+    char *name;
+
+    /// Sector of the header of the executable, or -1 without the real file
+    /// system.
+    int sector;
+
+    /// Virtual pages `firstPage` to `firstPage + numPages - 1` are shared.
+    unsigned firstPage;
+    unsigned numPages;
+
+    /// Frame holding each shared page, or -1 if no address space has it in
+    /// memory.
+    int *frames;
+
+    /// Number of address spaces using this entry.
+    unsigned users;
+
+    /// Whether the executable changed since the entry was made; it is then
+    /// out of the table, and goes away with its last user.
+    bool stale;
+
+    SharedText *next;
+
+    /// Return whether virtual page `vpn` is shared.
+    bool Has(unsigned vpn) const;
+
+    /// Return the frame holding `vpn`, or -1.
+    int GetFrame(unsigned vpn) const;
+
+    /// Record that `vpn` is in `frame`; -1 forgets it.
+    void SetFrame(unsigned vpn, int frame);
+};
+
+class TextTable {
+public:
+
+    TextTable();
+
+    ~TextTable();
+
+    /// Start using the code of the executable called `name`, or whose
+    /// header is at `sector`, of which pages `firstPage` to `firstPage +
+    /// numPages - 1` can be shared.
+    SharedText *Attach(const char *name, int sector, unsigned firstPage,
+                       unsigned numPages);
+
+    /// Start using `text` once more, for a forked address space.
+    void Attach(SharedText *text);
+
+    /// Stop using `text`; it goes away with its last user.
+    void Detach(SharedText *text);
+
+    /// Forget the code of the executable called `name`, or whose header is
+    /// at `sector`, which changed.
+    void Invalidate(const char *name, int sector);
+
+private:
+
+    static void Delete(SharedText *text);
+
+    SharedText *list;
+};
+
+
+#endif